@@ -465,6 +465,76 @@ namespace NNModel
 			context.nodeInferenceTempDataSize = inferenceTempSlotSize[0] + inferenceTempSlotSize[1];
 			mInferenceTempDataSize = context.nodeInferenceTempDataSize;
 			mInferenceOffset = inferenceTempSlotSize[0];
+			mPassOutputNum = passOutputOffset;
+			mOutputLength = GetLength(context.nodeOutputSize);
+		}
+
+		int getPassOutputNum() const { return mPassOutputNum; }
+		int getOutputLength() const { return mOutputLength; }
+
+		// The forward outputs and loss gradients of all samples in a batch. A sample only uses the buffers of its index
+		// so the samples of a batch can be fitted on different threads , the buffers are allocated when the batch size changes
+		struct BatchBuffer
+		{
+			void init(Sequence const& sequence, int inBatchSize)
+			{
+				if (batchSize == inBatchSize && passOutputNum == sequence.getPassOutputNum() && outputLength == sequence.getOutputLength())
+					return;
+
+				batchSize = inBatchSize;
+				passOutputNum = sequence.getPassOutputNum();
+				outputLength = sequence.getOutputLength();
+				outputs.resize(batchSize * passOutputNum);
+				lossGrads.resize(batchSize * passOutputNum);
+				outputLossGrads.resize(batchSize * outputLength);
+			}
+
+			NNScalar* getOutputs(int index) { return outputs.data() + index * passOutputNum; }
+			NNScalar* getLossGrads(int index) { return lossGrads.data() + index * passOutputNum; }
+			NNScalar* getOutputLossGrads(int index) { return outputLossGrads.data() + index * outputLength; }
+
+			int batchSize = 0;
+			int passOutputNum = 0;
+			int outputLength = 0;
+			TArray< NNScalar > outputs;
+			TArray< NNScalar > lossGrads;
+			TArray< NNScalar > outputLossGrads;
+		};
+
+		// Forward and backward of the sample at the index of the batch , the parameter gradients are added to inoutParameterGrads.
+		// NNScalar LossFunc(NNScalar const* outputs, NNScalar* outLossGrads) write the loss gradients of the outputs and return the loss
+		template< typename TLossFunc >
+		NNScalar fitBatchSample(
+			BatchBuffer& buffer, int index,
+			IntVector3 const& inputSize,
+			NNScalar const* parameters,
+			NNScalar const* inputs,
+			NNScalar* inoutParameterGrads,
+			TLossFunc&& lossFunc)
+		{
+			CHECK(index < buffer.batchSize);
+
+			ForwardContext forwardContext;
+			forwardContext.inputSize = inputSize;
+			forwardContext.parameters = parameters;
+			forwardContext.inputs = inputs;
+			forwardContext.outputs = buffer.getOutputs(index);
+			NNScalar const* pOutputs = forward(forwardContext);
+
+			NNScalar* pOutputLossGrads = buffer.getOutputLossGrads(index);
+			NNScalar loss = lossFunc(pOutputs, pOutputLossGrads);
+
+			BackwardContext backwardContext;
+			backwardContext.inputSize = inputSize;
+			backwardContext.parameters = parameters;
+			backwardContext.inputs = inputs;
+			backwardContext.outputs = buffer.getOutputs(index);
+			backwardContext.parameterGrads = inoutParameterGrads;
+			backwardContext.lossGradsInput = pOutputLossGrads;
+			backwardContext.lossGrads = buffer.getLossGrads(index);
+			backwardContext.lossGradsOutput = nullptr;
+			backward(backwardContext);
+			return loss;
 		}
 
 		NNScalar* inference(InferenceContext& context)
@@ -548,6 +618,8 @@ namespace NNModel
 		TArray< Node > mNodes;
 		int mInferenceOffset;
 		int mInferenceTempDataSize = 0;
+		int mPassOutputNum = 0;
+		int mOutputLength = 0;
 	};
 
 }
@@ -2,7 +2,9 @@
 #ifndef NNTrain_H_E17423EA_82CC_446C_8A7F_2CAAB54D7F6D
 #define NNTrain_H_E17423EA_82CC_446C_8A7F_2CAAB54D7F6D
 
+#include "NeuralNetwork.h"
 #include "Math/SIMD.h"
+#include "Async/AsyncWork.h"
 
 struct AdamOptimizer
 {
@@ -108,6 +110,136 @@ struct RMSProp
 	TArray<NNScalar> mRMSPropSquare;
 };
 
+// Parameter gradients of a minibatch computed on a thread pool. The batch is split in contiguous ranges , one for each
+// worker , and a worker adds the gradients of its samples to its own buffer. The buffers are summed as a binary tree ,
+// the result only depends on the batch and the worker count and not on the order the threads run.
+class NNBatchGradient
+{
+public:
+	void init(int numParameters, int numWorker)
+	{
+		CHECK(numWorker > 0);
+		mNumParameter = numParameters;
+		mWorkerGrads.resize(numWorker);
+		for (auto& grads : mWorkerGrads)
+		{
+			grads.resize(numParameters);
+		}
+		mWorkerLosses.resize(numWorker);
+	}
+
+	int getWorkerNum() const { return (int)mWorkerGrads.size(); }
+
+	//The summed gradients of the last batch
+	TArrayView<NNScalar> getParameterGrads() { return mWorkerGrads[0]; }
+
+	// NNScalar FitFunc(int workerIndex, int sampleIndex, NNScalar* inoutParameterGrads)
+	// add the gradients of the sample and return its loss , the worker index selects the buffers owned by the worker.
+	// Return the summed loss of the batch
+	template< typename TFitFunc >
+	NNScalar compute(QueueThreadPool* pool, int batchSize, TFitFunc&& fitFunc)
+	{
+		CHECK(!mWorkerGrads.empty());
+		int const numWorker = Math::Min(getWorkerNum(), batchSize);
+		if (numWorker <= 0)
+		{
+			std::fill_n(mWorkerGrads[0].data(), mNumParameter, NNScalar(0));
+			return 0;
+		}
+
+		auto FitRange = [this, batchSize, numWorker, &fitFunc](int workerIndex)
+		{
+			NNScalar* parameterGrads = mWorkerGrads[workerIndex].data();
+			std::fill_n(parameterGrads, mNumParameter, NNScalar(0));
+
+			NNScalar loss = 0;
+			int const indexEnd = batchSize * (workerIndex + 1) / numWorker;
+			for (int index = batchSize * workerIndex / numWorker; index < indexEnd; ++index)
+			{
+				loss += fitFunc(workerIndex, index, parameterGrads);
+			}
+			mWorkerLosses[workerIndex] = loss;
+		};
+
+		if (pool && numWorker > 1)
+		{
+			//Only wait the works of the batch , the caller can be a worker of the pool
+			QueuedWorkGroup group;
+			for (int workerIndex = 0; workerIndex < numWorker; ++workerIndex)
+			{
+				pool->addFunctionWork(group, [&FitRange, workerIndex]()
+				{
+					FitRange(workerIndex);
+				});
+			}
+			pool->waitWorkGroup(group);
+		}
+		else
+		{
+			for (int workerIndex = 0; workerIndex < numWorker; ++workerIndex)
+			{
+				FitRange(workerIndex);
+			}
+		}
+
+		reduce(pool, numWorker);
+
+		NNScalar loss = 0;
+		for (int workerIndex = 0; workerIndex < numWorker; ++workerIndex)
+		{
+			loss += mWorkerLosses[workerIndex];
+		}
+		return loss;
+	}
+
+private:
+	void reduce(QueueThreadPool* pool, int numWorker)
+	{
+		if (numWorker <= 1)
+			return;
+
+		//Every parameter is summed in the same pairwise order , a block of the buffers stays in cache for all levels of the tree
+		constexpr int BlockSize = 2048;
+		auto ReduceRange = [this, numWorker](int start, int end)
+		{
+			for (int blockStart = start; blockStart < end; blockStart += BlockSize)
+			{
+				int const num = Math::Min(BlockSize, end - blockStart);
+				for (int stride = 1; stride < numWorker; stride *= 2)
+				{
+					for (int index = 0; index + stride < numWorker; index += 2 * stride)
+					{
+						FNNMath::VectorAdd(num, mWorkerGrads[index].data() + blockStart, mWorkerGrads[index + stride].data() + blockStart);
+					}
+				}
+			}
+		};
+
+		int const numTask = pool ? Math::Min(pool->getAllThreadNum(), (mNumParameter + BlockSize - 1) / BlockSize) : 1;
+		if (numTask <= 1)
+		{
+			ReduceRange(0, mNumParameter);
+			return;
+		}
+
+		QueuedWorkGroup group;
+		for (int taskIndex = 0; taskIndex < numTask; ++taskIndex)
+		{
+			int const start = mNumParameter * taskIndex / numTask;
+			int const end = mNumParameter * (taskIndex + 1) / numTask;
+			pool->addFunctionWork(group, [&ReduceRange, start, end]()
+			{
+				ReduceRange(start, end);
+			});
+		}
+		pool->waitWorkGroup(group);
+	}
+
+	int mNumParameter = 0;
+	TArray< TArray<NNScalar> > mWorkerGrads;
+	TArray< NNScalar > mWorkerLosses;
+};
+
 
 class FRMSELoss
 {
@@ -2,10 +2,12 @@
 
 #include "Math/Base.h"
 #include "CompilerConfig.h"
+#include "PlatformConfig.h"
 #include "MacroCommon.h"
 #include <cstdlib>
 
 #define NN_USE_SIMD 1
+#define NN_USE_GEMM_AVX2 TARGET_PLATFORM_64BITS
 
 #if NN_USE_SIMD
 #include "Math/SIMD.h"
@@ -15,6 +17,15 @@ using IntVector = TIntVector<FloatVector::Size>;
 constexpr int NumLanes = FloatVector::Size;
 #endif
 
+#if NN_USE_GEMM_AVX2
+#include <immintrin.h>
+#if SYS_PLATFORM_WIN
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
 #if CPP_COMPILER_MSVC
 #define ALLOCA _alloca
 #else
@@ -764,6 +775,301 @@ void FNNMath::DeConv(int dimX, int dimY, NNScalar const* RESTRICT m, int dimXW,
 #endif
 }
 
+// Blocked matrix multiply out(M x N) = A(M x K) * B(K x N)
+// The blocks of A and B are packed in panels of GemmMR rows and GemmNR columns in the order the kernel reads them,
+// the panel of B stays in L1 , the block of A in L2 and the block of B in L3. The kernel keeps a GemmMR x GemmNR
+// tile of the output in registers.
+namespace
+{
+	constexpr int GemmMR = 6;
+	constexpr int GemmNR = 16;
+	constexpr int GemmKC = 256;
+	constexpr int GemmMC = 96;
+	constexpr int GemmNC = 2048;
+	//Max length of the cols of the transposed convolution
+	constexpr int MaxColsLength = 1 << 20;
+	static_assert(GemmMC % GemmMR == 0 && GemmNC % GemmNR == 0, "Block size must be a multiple of the kernel size");
+
+	struct GemmStridedMatrix
+	{
+		NNScalar const* data;
+		int rowStride;
+		int colStride;
+
+		FORCEINLINE NNScalar get(int row, int col) const { return data[row * rowStride + col * colStride]; }
+	};
+
+	//The offset of a element is the sum of a row offset and a column offset , the convolution reads the inputs as a im2col matrix by it
+	struct GemmOffsetMatrix
+	{
+		NNScalar const* data;
+		int const* rowOffsets;
+		int const* colOffsets;
+
+		FORCEINLINE NNScalar get(int row, int col) const { return data[rowOffsets[row] + colOffsets[col]]; }
+	};
+
+	template< class TMatrix >
+	void GemmPackA(TMatrix const& a, int rowStart, int numRow, int colStart, int numCol, NNScalar* RESTRICT outPacked)
+	{
+		for (int ir = 0; ir < numRow; ir += GemmMR)
+		{
+			int mr = Math::Min(GemmMR, numRow - ir);
+			for (int k = 0; k < numCol; ++k)
+			{
+				int i = 0;
+				for (; i < mr; ++i)
+					outPacked[i] = a.get(rowStart + ir + i, colStart + k);
+				for (; i < GemmMR; ++i)
+					outPacked[i] = 0;
+				outPacked += GemmMR;
+			}
+		}
+	}
+
+	template< class TMatrix >
+	void GemmPackB(TMatrix const& b, int rowStart, int numRow, int colStart, int numCol, NNScalar* RESTRICT outPacked)
+	{
+		for (int jr = 0; jr < numCol; jr += GemmNR)
+		{
+			int nr = Math::Min(GemmNR, numCol - jr);
+			for (int k = 0; k < numRow; ++k)
+			{
+				int j = 0;
+				for (; j < nr; ++j)
+					outPacked[j] = b.get(rowStart + k, colStart + jr + j);
+				for (; j < GemmNR; ++j)
+					outPacked[j] = 0;
+				outPacked += GemmNR;
+			}
+		}
+	}
+
+	using GemmKernelFunc = void (*)(int kc, NNScalar const* RESTRICT a, NNScalar const* RESTRICT b, NNScalar* RESTRICT out, int outRowStride, bool bAccumulate);
+
+	void GemmKernelScalar(int kc, NNScalar const* RESTRICT a, NNScalar const* RESTRICT b, NNScalar* RESTRICT out, int outRowStride, bool bAccumulate)
+	{
+		NNScalar acc[GemmMR][GemmNR] = {};
+		for (int k = 0; k < kc; ++k)
+		{
+			for (int i = 0; i < GemmMR; ++i)
+			{
+				for (int j = 0; j < GemmNR; ++j)
+				{
+					acc[i][j] += a[i] * b[j];
+				}
+			}
+			a += GemmMR;
+			b += GemmNR;
+		}
+
+		for (int i = 0; i < GemmMR; ++i)
+		{
+			NNScalar* RESTRICT pOut = out + i * outRowStride;
+			for (int j = 0; j < GemmNR; ++j)
+			{
+				pOut[j] = bAccumulate ? pOut[j] + acc[i][j] : acc[i][j];
+			}
+		}
+	}
+
+#if NN_USE_GEMM_AVX2
+
+	static_assert(std::is_same_v< NNScalar, float >, "AVX2 kernel need float scalar");
+
+	bool IsGemmAVX2Supported()
+	{
+		static bool const bSupported = []() -> bool
+		{
+			// CPUID.1:ECX FMA(12) OSXSAVE(27) AVX(28) , CPUID.7:EBX AVX2(5) , XCR0 must enable the XMM(1) and YMM(2) states
+			uint32 ecx;
+			uint32 ebx7;
+			uint64 xcr0;
+#if SYS_PLATFORM_WIN
+			int info[4];
+			__cpuid(info, 1);
+			ecx = uint32(info[2]);
+			if ((ecx & (1 << 27)) == 0)
+				return false;
+			__cpuidex(info, 7, 0);
+			ebx7 = uint32(info[1]);
+			xcr0 = _xgetbv(0);
+#else
+			uint32 eax, ebx, ecx7, edx;
+			if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+				return false;
+			if ((ecx & (1 << 27)) == 0)
+				return false;
+			if (!__get_cpuid_count(7, 0, &eax, &ebx7, &ecx7, &edx))
+				return false;
+			uint32 xcr0Low, xcr0High;
+			__asm__ volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+			xcr0 = (uint64(xcr0High) << 32) | xcr0Low;
+#endif
+			return (ecx & (1 << 12)) != 0 && (ecx & (1 << 28)) != 0 && (ebx7 & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+		}();
+		return bSupported;
+	}
+
+#if CPP_COMPILER_MSVC
+#define GEMM_TARGET_AVX2
+#else
+#define GEMM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+	GEMM_TARGET_AVX2
+	void GemmKernelAVX2(int kc, NNScalar const* RESTRICT a, NNScalar const* RESTRICT b, NNScalar* RESTRICT out, int outRowStride, bool bAccumulate)
+	{
+		static_assert(GemmMR == 6 && GemmNR == 16, "AVX2 kernel is written for 6 x 16 tile");
+
+#define GEMM_ROW_OP(OP) OP(0) OP(1) OP(2) OP(3) OP(4) OP(5)
+
+#define DEFINE_ACC(I) __m256 acc##I##0 = _mm256_setzero_ps(); __m256 acc##I##1 = _mm256_setzero_ps();
+		GEMM_ROW_OP(DEFINE_ACC);
+#undef DEFINE_ACC
+
+		for (int k = 0; k < kc; ++k)
+		{
+			__m256 b0 = _mm256_loadu_ps(b);
+			__m256 b1 = _mm256_loadu_ps(b + 8);
+#define MUL_ADD_ROW(I)\
+			{\
+				__m256 ai = _mm256_broadcast_ss(a + I);\
+				acc##I##0 = _mm256_fmadd_ps(ai, b0, acc##I##0);\
+				acc##I##1 = _mm256_fmadd_ps(ai, b1, acc##I##1);\
+			}
+			GEMM_ROW_OP(MUL_ADD_ROW);
+#undef MUL_ADD_ROW
+			a += GemmMR;
+			b += GemmNR;
+		}
+
+		if (bAccumulate)
+		{
+#define STORE_ROW(I)\
+			{\
+				NNScalar* pOut = out + I * outRowStride;\
+				_mm256_storeu_ps(pOut, _mm256_add_ps(_mm256_loadu_ps(pOut), acc##I##0));\
+				_mm256_storeu_ps(pOut + 8, _mm256_add_ps(_mm256_loadu_ps(pOut + 8), acc##I##1));\
+			}
+			GEMM_ROW_OP(STORE_ROW);
+#undef STORE_ROW
+		}
+		else
+		{
+#define STORE_ROW(I)\
+			{\
+				NNScalar* pOut = out + I * outRowStride;\
+				_mm256_storeu_ps(pOut, acc##I##0);\
+				_mm256_storeu_ps(pOut + 8, acc##I##1);\
+			}
+			GEMM_ROW_OP(STORE_ROW);
+#undef STORE_ROW
+		}
+#undef GEMM_ROW_OP
+	}
+
+#undef GEMM_TARGET_AVX2
+
+#endif //NN_USE_GEMM_AVX2
+
+	GemmKernelFunc GetGemmKernel()
+	{
+#if NN_USE_GEMM_AVX2
+		if (IsGemmAVX2Supported())
+			return GemmKernelAVX2;
+#endif
+		return GemmKernelScalar;
+	}
+
+	template< class TMatrixA, class TMatrixB >
+	void GemmBlocked(int dimM, int dimK, int dimN, TMatrixA const& a, TMatrixB const& b, NNScalar* RESTRICT out, int outRowStride, bool bAccumulate)
+	{
+		if (dimK == 0)
+		{
+			if (!bAccumulate)
+			{
+				for (int i = 0; i < dimM; ++i)
+					FNNMath::Fill(dimN, out + i * outRowStride, 0);
+			}
+			return;
+		}
+
+		static thread_local TArray< NNScalar > PackedA;
+		static thread_local TArray< NNScalar > PackedB;
+		PackedA.resize(GemmMC * GemmKC);
+		PackedB.resize(GemmKC * GemmNC);
+
+		static GemmKernelFunc const Kernel = GetGemmKernel();
+		NNScalar tile[GemmMR * GemmNR];
+
+		for (int jc = 0; jc < dimN; jc += GemmNC)
+		{
+			int nc = Math::Min(GemmNC, dimN - jc);
+			for (int pc = 0; pc < dimK; pc += GemmKC)
+			{
+				int kc = Math::Min(GemmKC, dimK - pc);
+				bool bAccumulateBlock = bAccumulate || pc > 0;
+				GemmPackB(b, pc, kc, jc, nc, PackedB.data());
+
+				for (int ic = 0; ic < dimM; ic += GemmMC)
+				{
+					int mc = Math::Min(GemmMC, dimM - ic);
+					GemmPackA(a, ic, mc, pc, kc, PackedA.data());
+
+					for (int jr = 0; jr < nc; jr += GemmNR)
+					{
+						int nr = Math::Min(GemmNR, nc - jr);
+						NNScalar const* pPackedB = PackedB.data() + jr * kc;
+						for (int ir = 0; ir < mc; ir += GemmMR)
+						{
+							int mr = Math::Min(GemmMR, mc - ir);
+							NNScalar const* pPackedA = PackedA.data() + ir * kc;
+							NNScalar* pOut = out + (ic + ir) * outRowStride + jc + jr;
+							if (mr == GemmMR && nr == GemmNR)
+							{
+								Kernel(kc, pPackedA, pPackedB, pOut, outRowStride, bAccumulateBlock);
+								continue;
+							}
+
+							//The edge tile is computed in the temp tile and only the valid part is written
+							Kernel(kc, pPackedA, pPackedB, tile, GemmNR, false);
+							for (int i = 0; i < mr; ++i)
+							{
+								NNScalar* pOutRow = pOut + i * outRowStride;
+								NNScalar const* pTileRow = tile + i * GemmNR;
+								if (bAccumulateBlock)
+									FNNMath::VectorAdd(nr, pOutRow, pTileRow);
+								else
+									FNNMath::VectorCopy(nr, pTileRow, pOutRow);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void FNNMath::GEMM(int dimRow, int dimCol, int dimCol2,
+	NNScalar const* RESTRICT m, int rowStride, int colStride,
+	NNScalar const* RESTRICT m2, int rowStride2, int colStride2,
+	NNScalar* RESTRICT out, int outRowStride, bool bAccumulate)
+{
+	GemmStridedMatrix a{ m, rowStride, colStride };
+	GemmStridedMatrix b{ m2, rowStride2, colStride2 };
+	GemmBlocked(dimRow, dimCol, dimCol2, a, b, out, outRowStride, bAccumulate);
+}
+
+bool FNNMath::IsGEMMUseAVX2()
+{
+#if NN_USE_GEMM_AVX2
+	return IsGemmAVX2Supported();
+#else
+	return false;
+#endif
+}
+
 // Y = At[ (G g Gt) * (Bt d B) ] A
 template< typename TKernel >
 void TranformArea(int rowStride, int numSlice, int sliceStride, NNScalar const* RESTRICT area, NNScalar* RESTRICT outArea)
@@ -1344,6 +1650,62 @@ NNScalar* FNNAlgo::Forward(NNConvTranspose2DLayer const& layer, NNScalar const p
 
 	CHECK(layer.stride > 0);
 
+	int const numColRow = layer.numNode * convLength;
+	if (FNNMath::ShouldUseGEMM(numColRow, numSliceInput, sliceInputLength))
+	{
+		NNScalar* pNodeOutput = outputs;
+		for (int idxNode = 0; idxNode < layer.numNode; ++idxNode)
+		{
+			FNNMath::Fill(nodeOutputLength, pNodeOutput, pBias[idxNode]);
+			pNodeOutput += nodeOutputLength;
+		}
+
+		// cols[node , ky , kx][pixel] = weight[slice][node , ky , kx] * inputs[slice][pixel] , then scatter the cols to the outputs (col2im).
+		// The input rows are done in chunks to bound the size of the cols
+		int const inputDimX = layer.inputSize[0];
+		int const inputDimY = layer.inputSize[1];
+		int const numChunkRow = Math::Clamp(MaxColsLength / (numColRow * inputDimX), 1, inputDimY);
+
+		static thread_local TArray< NNScalar > Cols;
+		Cols.resize(numColRow * numChunkRow * inputDimX);
+
+		for (int rowStart = 0; rowStart < inputDimY; rowStart += numChunkRow)
+		{
+			int const numRow = Math::Min(numChunkRow, inputDimY - rowStart);
+			int const numCol = numRow * inputDimX;
+			FNNMath::GEMM(numColRow, numSliceInput, numCol, pWeight, 1, numColRow, inputs + rowStart * inputDimX, sliceInputLength, 1, Cols.data(), numCol);
+
+			NNScalar const* pCols = Cols.data();
+			for (int idxNode = 0; idxNode < layer.numNode; ++idxNode)
+			{
+				pNodeOutput = outputs + idxNode * nodeOutputLength;
+				for (int ky = 0; ky < layer.convSize; ++ky)
+				{
+					for (int kx = 0; kx < layer.convSize; ++kx)
+					{
+						for (int row = 0; row < numRow; ++row)
+						{
+							int oy = (rowStart + row) * layer.stride - layer.padding + ky;
+							if (oy < 0 || oy >= ny)
+								continue;
+
+							NNScalar* pOutRow = pNodeOutput + oy * nx;
+							NNScalar const* pColRow = pCols + row * inputDimX;
+							for (int ix = 0; ix < inputDimX; ++ix)
+							{
+								int ox = ix * layer.stride - layer.padding + kx;
+								if (0 <= ox && ox < nx)
+									pOutRow[ox] += pColRow[ix];
+							}
+						}
+						pCols += numCol;
+					}
+				}
+			}
+		}
+		return outputs;
+	}
+
 	if (layer.stride > 1)
 	{
 		NNScalar* pNodeOutput = outputs;
@@ -1723,6 +2085,48 @@ NNScalar* FNNAlgo::Forward(
 		pNodeOutput += nodeOutputLength;
 	}
 
+	int const numWeightCol = numSliceInput * convLength;
+	if (FNNMath::ShouldUseGEMM(layer.numNode, numWeightCol, nodeOutputLength))
+	{
+		// outputs[node][pixel] += weight[node][slice , ky , kx] * im2col(inputs)[slice , ky , kx][pixel]
+		// The im2col matrix is not built , the element offset is the offset of the kernel element plus the offset of the output pixel
+		static thread_local TArray< int > Offsets;
+		Offsets.resize(layer.numNode + 2 * numWeightCol + nodeOutputLength);
+		int* pWeightRowOffsets = Offsets.data();
+		int* pWeightColOffsets = pWeightRowOffsets + layer.numNode;
+		int* pInputRowOffsets = pWeightColOffsets + numWeightCol;
+		int* pInputColOffsets = pInputRowOffsets + numWeightCol;
+
+		for (int idxNode = 0; idxNode < layer.numNode; ++idxNode)
+		{
+			pWeightRowOffsets[idxNode] = idxNode * convLength;
+		}
+		for (int idxSlice = 0; idxSlice < numSliceInput; ++idxSlice)
+		{
+			for (int ky = 0; ky < layer.convSize; ++ky)
+			{
+				for (int kx = 0; kx < layer.convSize; ++kx)
+				{
+					int index = idxSlice * convLength + ky * layer.convSize + kx;
+					pWeightColOffsets[index] = idxSlice * layer.numNode * convLength + ky * layer.convSize + kx;
+					pInputRowOffsets[index] = idxSlice * sliceInputLength + ky * layer.inputSize[0] + kx;
+				}
+			}
+		}
+		for (int oy = 0; oy < ny; ++oy)
+		{
+			for (int ox = 0; ox < nx; ++ox)
+			{
+				pInputColOffsets[oy * nx + ox] = oy * layer.inputSize[0] + ox;
+			}
+		}
+
+		GemmOffsetMatrix weightMatrix{ pWeight, pWeightRowOffsets, pWeightColOffsets };
+		GemmOffsetMatrix inputMatrix{ inputs, pInputRowOffsets, pInputColOffsets };
+		GemmBlocked(layer.numNode, numWeightCol, nodeOutputLength, weightMatrix, inputMatrix, outputs, nodeOutputLength, true);
+		return outputs;
+	}
+
 	NNScalar const* pSliceInput = inputs;
 	for (int idxSlice = 0; idxSlice < numSliceInput; ++idxSlice)
 	{
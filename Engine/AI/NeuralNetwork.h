@@ -617,8 +617,28 @@ public:
 	static void VectorMulMatrix(int dimRow,  int dimCol,  NNScalar const* RESTRICT m, NNScalar const* RESTRICT v, NNScalar* RESTRICT out);
 	static void VectorMulMatrixAdd(int dimRow, int dimCol, NNScalar const* RESTRICT m, NNScalar const* RESTRICT v, NNScalar const* RESTRICT b, NNScalar* RESTRICT out);
 
+	// out = m * m2 , m is dimRow x dimCol and m2 is dimCol x dimCol2 , the element (i , j) of a matrix is at i * rowStride + j * colStride.
+	// The matrices are packed in cache blocks and multiplied by a register blocked kernel , it use AVX2/FMA if the CPU supports it
+	static void GEMM(int dimRow, int dimCol, int dimCol2,
+		NNScalar const* RESTRICT m, int rowStride, int colStride,
+		NNScalar const* RESTRICT m2, int rowStride2, int colStride2,
+		NNScalar* RESTRICT out, int outRowStride, bool bAccumulate = false);
+	static bool IsGEMMUseAVX2();
+
+	//Packing the blocks only pays off for a large enough matrix
+	static bool ShouldUseGEMM(int dimRow, int dimCol, int dimCol2)
+	{
+		return dimRow >= 8 && dimCol2 >= 8 && int64(dimRow) * dimCol * dimCol2 >= 32 * 32 * 32;
+	}
+
 	static void MatrixMulMatrix(int dimRow, int dimCol, NNScalar const* RESTRICT m, int dimCol2, NNScalar const* RESTRICT m2, NNScalar* RESTRICT out)
 	{
+		if (ShouldUseGEMM(dimRow, dimCol, dimCol2))
+		{
+			GEMM(dimRow, dimCol, dimCol2, m, dimCol, 1, m2, dimCol2, 1, out, dimCol2);
+			return;
+		}
+
 		NNScalar* RESTRICT pOut = out;
 		for (int row = 0; row < dimRow; ++row)
 		{
@@ -634,6 +654,12 @@ public:
 
 	static void MatrixMulMatrix(int dimRow, int dimCol, NNScalar const* RESTRICT m, int dimCol2, NNScalar const* RESTRICT m2, int rowStride2, NNScalar* RESTRICT out)
 	{
+		if (ShouldUseGEMM(dimRow, dimCol, dimCol2))
+		{
+			GEMM(dimRow, dimCol, dimCol2, m, dimCol, 1, m2, rowStride2, 1, out, dimCol2);
+			return;
+		}
+
 		NNScalar* RESTRICT pOut = out;
 		for (int row = 0; row < dimRow; ++row)
 		{
@@ -649,6 +675,12 @@ public:
 
 	static void MatrixMulMatrixT(int dimRow, int dimCol, NNScalar const* RESTRICT m, int dimCol2, NNScalar const* RESTRICT m2, NNScalar* RESTRICT out)
 	{
+		if (ShouldUseGEMM(dimRow, dimCol, dimCol2))
+		{
+			GEMM(dimRow, dimCol, dimCol2, m, dimCol, 1, m2, 1, dimCol, out, dimCol2);
+			return;
+		}
+
 		NNScalar* RESTRICT pOut = out;
 		for (int row = 0; row < dimRow; ++row)
 		{
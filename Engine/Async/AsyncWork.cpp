@@ -1,4 +1,5 @@
 #include "AsyncWork.h"
+#include "WorkStealingQueue.h"
 
 #include "SystemPlatform.h"
 #include "InlineString.h"
@@ -25,12 +26,16 @@ public:
 
 	QueueThreadPool*  mOwningPool;
 	std::atomic< IQueuedWork* > mWork;
+	TWorkStealingQueue< IQueuedWork* > mLocalWorks;
 	ConditionVariable mWaitWorkCV;
 	Mutex             mWaitWorkMutex;
 	volatile int32    mWantDie;
 };
 
+static thread_local PoolRunableThread* GCurrentPoolThread = nullptr;
+
 QueueThreadPool::QueueThreadPool()
+	:mStealIndex(0)
 {
 
 }
@@ -78,25 +83,112 @@ void QueueThreadPool::cleanup()
 
 }
 
+PoolRunableThread* QueueThreadPool::getCurrentPoolThread()
+{
+	if (GCurrentPoolThread && GCurrentPoolThread->mOwningPool == this)
+		return GCurrentPoolThread;
+	return nullptr;
+}
+
 void QueueThreadPool::addWork(IQueuedWork* work)
 {
 	assert(work);
+	PoolRunableThread* currentThread = getCurrentPoolThread();
 	PoolRunableThread* runThread = nullptr;
 	{
 		SpinLock::Locker locker(mQueueLock);
 		if( mQueuedThreads.empty() )
 		{
-			mQueuedWorks.push_back(work);
-			return;
+			if (currentThread == nullptr)
+			{
+				mQueuedWorks.push_back(work);
+				return;
+			}
+		}
+		else
+		{
+			runThread = mQueuedThreads.back();
+			mQueuedThreads.pop_back();
 		}
+	}
 
-		runThread = mQueuedThreads.back();
-		mQueuedThreads.pop_back();
+	if (runThread == nullptr)
+	{
+		// Submitted in worker : keep it local, idle threads will steal it
+		currentThread->mLocalWorks.push(work);
+		return;
 	}
 
 	runThread->doWork(work);
 }
 
+IQueuedWork* QueueThreadPool::stealWork(PoolRunableThread* runThread)
+{
+	int numThread = (int)mAllThreads.size();
+	if (numThread == 0)
+		return nullptr;
+
+	int start = int(mStealIndex.fetch_add(1, std::memory_order_relaxed) % numThread);
+	for (int i = 0; i < numThread; ++i)
+	{
+		PoolRunableThread* thread = mAllThreads[(start + i) % numThread];
+		if (thread == runThread)
+			continue;
+
+		IQueuedWork* work;
+		if (thread->mLocalWorks.steal(work))
+			return work;
+	}
+	return nullptr;
+}
+
+IQueuedWork* QueueThreadPool::fetchWork(PoolRunableThread* runThread)
+{
+	IQueuedWork* work;
+	if (runThread && runThread->mLocalWorks.pop(work))
+		return work;
+
+	{
+		SpinLock::Locker locker(mQueueLock);
+		if (!mQueuedWorks.empty())
+		{
+			work = mQueuedWorks.front();
+			mQueuedWorks.pop_front();
+			return work;
+		}
+	}
+
+	return stealWork(runThread);
+}
+
+void QueueThreadPool::waitWorkGroup(QueuedWorkGroup& group)
+{
+	PROFILE_ENTRY("WaitWorkGroup");
+	PoolRunableThread* currentThread = getCurrentPoolThread();
+	int numIdleLoop = 0;
+	while (!group.isComplete())
+	{
+		IQueuedWork* work = fetchWork(currentThread);
+		if (work)
+		{
+			ExecuteWork(work);
+			numIdleLoop = 0;
+			continue;
+		}
+
+		// Remain works of the group are executing in other threads
+		if (numIdleLoop < 64)
+		{
+			_mm_pause();
+			++numIdleLoop;
+		}
+		else
+		{
+			SystemPlatform::Sleep(0);
+		}
+	}
+}
+
 bool QueueThreadPool::retractWork(IQueuedWork* work)
 {
 	Mutex::Locker locker(mQueueMutex);
@@ -122,19 +214,11 @@ void QueueThreadPool::waitAllWorkComplete(bool bHelpUpdate)
 	{
 		while (true)
 		{
-			IQueuedWork* work = nullptr;
-			{
-				SpinLock::Locker locker(mQueueLock);
-				if (mQueuedWorks.empty())
-					break;
-				work = mQueuedWorks.front();
-				mQueuedWorks.pop_front();
-			}
+			IQueuedWork* work = fetchWork(getCurrentPoolThread());
+			if (work == nullptr)
+				break;
 
-			if (work)
-			{
-				ExecuteWork(work);
-			}
+			ExecuteWork(work);
 		}
 	}
 
@@ -151,21 +235,14 @@ void QueueThreadPool::waitAllWorkComplete(bool bHelpUpdate)
 
 void QueueThreadPool::waitAllWorkCompleteInWorker()
 {
+	PoolRunableThread* currentThread = getCurrentPoolThread();
 	while (true)
 	{
-		IQueuedWork* work = nullptr;
-		{
-			SpinLock::Locker locker(mQueueLock);
-			if (mQueuedWorks.empty())
-				break;
-			work = mQueuedWorks.front();
-			mQueuedWorks.pop_front();
-		}
+		IQueuedWork* work = fetchWork(currentThread);
+		if (work == nullptr)
+			break;
 
-		if (work)
-		{
-			ExecuteWork(work);
-		}
+		ExecuteWork(work);
 	}
 
 	Mutex::Locker locker(mQueueMutex);
@@ -188,6 +265,16 @@ void QueueThreadPool::cencelAllWorks()
 		work->release();
 	}
 	mQueuedWorks.clear();
+
+	for (PoolRunableThread* runThread : mAllThreads)
+	{
+		IQueuedWork* work;
+		while (runThread->mLocalWorks.steal(work))
+		{
+			work->abandon();
+			work->release();
+		}
+	}
 }
 
 void QueueThreadPool::addWorks(IQueuedWork* works[], int count)
@@ -196,9 +283,10 @@ void QueueThreadPool::addWorks(IQueuedWork* works[], int count)
 
 	TArray< PoolRunableThread* , TInlineAllocator<64> > dispatched;
 
+	PoolRunableThread* currentThread = getCurrentPoolThread();
+	int workIdx = 0;
 	{
 		SpinLock::Locker locker(mQueueLock);
-		int workIdx = 0;
 		while( !mQueuedThreads.empty() && workIdx < count )
 		{
 			PoolRunableThread* runThread = mQueuedThreads.back();
@@ -207,12 +295,19 @@ void QueueThreadPool::addWorks(IQueuedWork* works[], int count)
 			dispatched.push_back(runThread);
 		}
 
-		if( workIdx < count )
+		if( workIdx < count && currentThread == nullptr )
 		{
 			mQueuedWorks.addRange(works + workIdx, works + count);
+			workIdx = count;
 		}
 	}
 
+	// Submitted in worker : keep remain works local, other threads will steal them
+	for (; workIdx < count; ++workIdx)
+	{
+		currentThread->mLocalWorks.push(works[workIdx]);
+	}
+
 	// Wake threads outside the lock (CV notify may block on mWaitWorkMutex)
 	for (auto thread : dispatched)
 	{
@@ -224,6 +319,13 @@ void QueueThreadPool::addWorks(IQueuedWork* works[], int count)
 IQueuedWork* QueueThreadPool::doWorkCompleted(PoolRunableThread* runThread)
 {
 	IQueuedWork* outWork = nullptr;
+	if (runThread->mLocalWorks.pop(outWork))
+		return outWork;
+
+	outWork = stealWork(runThread);
+	if (outWork)
+		return outWork;
+
 	bool bShouldNotify = false;
 	{
 		SpinLock::Locker locker(mQueueLock);
@@ -260,6 +362,7 @@ PoolRunableThread::PoolRunableThread()
 
 unsigned PoolRunableThread::run()
 {
+	GCurrentPoolThread = this;
 	while ( !mWantDie )
 	{
 		{
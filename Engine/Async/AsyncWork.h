@@ -19,6 +19,21 @@ public:
 
 class PoolRunableThread;
 
+// Tracks the completion of a batch of works, so callers can wait for their own works only
+class QueuedWorkGroup
+{
+public:
+	QueuedWorkGroup() :mNumPending(0) {}
+
+	void  add(int num = 1) { mNumPending.fetch_add(num, std::memory_order_relaxed); }
+	void  finish() { mNumPending.fetch_sub(1, std::memory_order_acq_rel); }
+	bool  isComplete() const { return mNumPending.load(std::memory_order_acquire) == 0; }
+	int   getPendingNum() const { return mNumPending.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic< int32 > mNumPending;
+};
+
 class QueueThreadPool
 {
 public:
@@ -49,6 +64,20 @@ public:
 		addWork(work);
 	}
 
+	template< class TFunc >
+	void  addFunctionWork(QueuedWorkGroup& group, TFunc&& func)
+	{
+		group.add();
+		addFunctionWork([&group, func = std::forward<TFunc>(func)]() mutable
+		{
+			func();
+			group.finish();
+		});
+	}
+
+	//Wait works of the group complete, the caller thread helps to execute queued works while waiting
+	void  waitWorkGroup(QueuedWorkGroup& group);
+
 	void  waitAllThreadIdle();
 	void  waitAllWorkComplete(bool bHelpUpdate = false);
 	void  waitAllWorkCompleteInWorker();
@@ -63,6 +92,9 @@ private:
 	void  cleanup();
 	friend class PoolRunableThread;
 	IQueuedWork* doWorkCompleted(PoolRunableThread* runThread);
+	PoolRunableThread* getCurrentPoolThread();
+	IQueuedWork* stealWork(PoolRunableThread* runThread);
+	IQueuedWork* fetchWork(PoolRunableThread* runThread);
 
 	Mutex        mQueueMutex;
 	SpinLock     mQueueLock;
@@ -71,6 +103,7 @@ private:
 
 	TArray< PoolRunableThread* > mAllThreads;
 	ConditionVariable            mWaitCompleteCV;
+	std::atomic< uint32 >        mStealIndex;
 };
 
 
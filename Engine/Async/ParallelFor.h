@@ -33,17 +33,19 @@ public:
 		,batchIndex(0)
 		,func(std::forward<UFunc>(inFunc))
 		,name(nullptr)
+		,group(nullptr)
 		,bUseRange(false)
 	{
 	}
 
 	template <typename UFunc>
-	TParallelForWork(int inStart, int inEnd, int inBatchIndex, UFunc&& inFunc, char const* inName)
+	TParallelForWork(int inStart, int inEnd, int inBatchIndex, UFunc&& inFunc, char const* inName, QueuedWorkGroup* inGroup = nullptr)
 		:start(inStart)
 		,end(inEnd)
 		,batchIndex(inBatchIndex)
 		,func(std::forward<UFunc>(inFunc))
 		,name(inName)
+		,group(inGroup)
 		,bUseRange(true)
 	{
 	}
@@ -60,7 +62,14 @@ public:
 		}
 	}
 
-	void release() override { this->~TParallelForWork(); }
+	void release() override 
+	{
+		// Work memory may be reclaimed once the group complete, finish it last
+		QueuedWorkGroup* localGroup = group;
+		this->~TParallelForWork();
+		if (localGroup)
+			localGroup->finish();
+	}
 
 	template< typename UFunc >
 	auto executeSingle(int) -> decltype(std::declval<UFunc&>()(), void())
@@ -103,16 +112,16 @@ public:
 	int batchIndex;
 	TFunc func;
 	char const* name;
+	QueuedWorkGroup* group;
 	bool bUseRange;
 };
 
 template< typename TFunc >
-void ParallelForImpl(QueueThreadPool& threadPool, FrameAllocator& allocator, char const* taskName, int count, TFunc&& func, int batchSize = 64)
+void ParallelForImpl(QueueThreadPool& threadPool, FrameAllocator& allocator, QueuedWorkGroup& group, char const* taskName, int count, TFunc&& func, int batchSize = 64)
 {
 	if (count <= 0) 
 		return;
 	
-	StackMaker marker(allocator);
 	using StoredFunc = std::decay_t<TFunc>;
 
 	int numTasks = (count + batchSize - 1) / batchSize;
@@ -128,26 +137,28 @@ void ParallelForImpl(QueueThreadPool& threadPool, FrameAllocator& allocator, cha
 	{
 		int start = i * batchSize;
 		int end = Math::Min(start + batchSize, count);
-		WorkType* work = new (chunkStart + i * workSize) WorkType(start, end, i, func, taskName);
+		WorkType* work = new (chunkStart + i * workSize) WorkType(start, end, i, func, taskName, &group);
 		works[i] = work;
 	}
 
+	group.add(numTasks);
 	threadPool.addWorks(works, numTasks);
 }
 
-
+// Only wait the works of this call and help to execute them, other works in the pool don't block the caller
 template< typename TFunc >
 void ParallelFor(QueueThreadPool& threadPool, FrameAllocator& allocator, char const* taskName, int count, TFunc&& func, int batchSize = 64)
 {
-	ParallelForImpl(threadPool, allocator, taskName, count, std::forward<TFunc>(func), batchSize);
-	threadPool.waitAllWorkComplete();
+	StackMaker marker(allocator);
+	QueuedWorkGroup group;
+	ParallelForImpl(threadPool, allocator, group, taskName, count, std::forward<TFunc>(func), batchSize);
+	threadPool.waitWorkGroup(group);
 }
 
 template< typename TFunc >
 void ParallelForInWorker(QueueThreadPool& threadPool, FrameAllocator& allocator, char const* taskName, int count, TFunc&& func, int batchSize = 64)
 {
-	ParallelForImpl(threadPool, allocator, taskName, count, std::forward<TFunc>(func), batchSize);
-	threadPool.waitAllWorkCompleteInWorker();
+	ParallelFor(threadPool, allocator, taskName, count, std::forward<TFunc>(func), batchSize);
 }
 
 #endif // ParallelFor_h__
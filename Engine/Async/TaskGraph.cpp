@@ -0,0 +1,134 @@
+#include "TaskGraph.h"
+
+#include "ProfileSystem.h"
+#include "MacroCommon.h"
+#include "LogSystem.h"
+
+TaskGraph::TaskGraph()
+	:mRunPool(nullptr)
+	,mRunGroup(nullptr)
+	,mbCompiled(false)
+{
+
+}
+
+TaskGraph::~TaskGraph()
+{
+
+}
+
+void TaskGraph::addDependency(NodeHandle node, NodeHandle predecessor)
+{
+	CHECK(mNodes.isValidIndex(node) && mNodes.isValidIndex(predecessor));
+	CHECK(node != predecessor);
+	mNodes[predecessor]->successors.push_back(node);
+	mNodes[node]->numPredecessors += 1;
+	mbCompiled = false;
+}
+
+void TaskGraph::clear()
+{
+	mNodes.clear();
+	mRootNodes.clear();
+	mbCompiled = false;
+}
+
+bool TaskGraph::compile()
+{
+	mRootNodes.clear();
+
+	TArray< int > pendingCounts;
+	TArray< NodeHandle > visitQueue;
+	pendingCounts.resize(mNodes.size());
+	for (int i = 0; i < mNodes.size(); ++i)
+	{
+		pendingCounts[i] = mNodes[i]->numPredecessors;
+		if (pendingCounts[i] == 0)
+		{
+			mRootNodes.push_back(mNodes[i].get());
+			visitQueue.push_back(i);
+		}
+	}
+
+	//Kahn's algorithm : all nodes must be visited if the graph is acyclic
+	for (int index = 0; index < visitQueue.size(); ++index)
+	{
+		for (NodeHandle successor : mNodes[visitQueue[index]]->successors)
+		{
+			if (--pendingCounts[successor] == 0)
+				visitQueue.push_back(successor);
+		}
+	}
+
+	if (visitQueue.size() != mNodes.size())
+	{
+		LogWarning(0, "TaskGraph has cycle dependency!");
+		mRootNodes.clear();
+		return false;
+	}
+
+	mbCompiled = true;
+	return true;
+}
+
+void TaskGraph::run(QueueThreadPool& threadPool)
+{
+	QueuedWorkGroup group;
+	dispatch(threadPool, group);
+	threadPool.waitWorkGroup(group);
+}
+
+void TaskGraph::dispatch(QueueThreadPool& threadPool, QueuedWorkGroup& group)
+{
+	if (!mbCompiled && !compile())
+		return;
+
+	if (mNodes.empty())
+		return;
+
+	for (auto& node : mNodes)
+	{
+		node->numPendingPredecessors.store(node->numPredecessors, std::memory_order_relaxed);
+		node->bAbandoned.store(false, std::memory_order_relaxed);
+	}
+
+	mRunPool = &threadPool;
+	mRunGroup = &group;
+	group.add((int)mNodes.size());
+	threadPool.addWorks(mRootNodes.data(), (int)mRootNodes.size());
+}
+
+void TaskGraph::Node::executeWork()
+{
+	PROFILE_ENTRY(name);
+	func();
+}
+
+void TaskGraph::Node::release()
+{
+	QueueThreadPool* pool = graph->mRunPool;
+	QueuedWorkGroup* group = graph->mRunGroup;
+	//The inputs of the successors are never produced if this node is abandoned
+	bool const bNodeAbandoned = bAbandoned.load(std::memory_order_relaxed);
+	for (NodeHandle successorHandle : successors)
+	{
+		Node* successor = graph->mNodes[successorHandle].get();
+		if (bNodeAbandoned)
+		{
+			successor->abandon();
+		}
+		if (successor->numPendingPredecessors.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			if (successor->bAbandoned.load(std::memory_order_relaxed))
+			{
+				successor->release();
+			}
+			else
+			{
+				pool->addWork(successor);
+			}
+		}
+	}
+	// The graph may be rerun or destroyed once the group complete, finish it last
+	group->finish();
+}
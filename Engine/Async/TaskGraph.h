@@ -0,0 +1,84 @@
+#pragma once
+#ifndef TaskGraph_H_B489CC39_EA4E_47B9_97EC_799021D23772
+#define TaskGraph_H_B489CC39_EA4E_47B9_97EC_799021D23772
+
+#include "AsyncWork.h"
+
+#include <functional>
+#include <memory>
+#include <initializer_list>
+
+// DAG of tasks executed on QueueThreadPool.
+// A node is dispatched as soon as all its predecessors complete.
+// When a node is abandoned (QueueThreadPool::cencelAllWorks) all nodes depending on it are abandoned too.
+// The graph is built once and can be run many times without allocation.
+class TaskGraph
+{
+public:
+	using NodeHandle = int;
+
+	TaskGraph();
+	~TaskGraph();
+
+	template< class TFunc >
+	NodeHandle addNode(char const* name, TFunc&& func)
+	{
+		Node* node = new Node;
+		node->graph = this;
+		node->name = name;
+		node->func = std::forward<TFunc>(func);
+		mNodes.push_back(std::unique_ptr<Node>(node));
+		mbCompiled = false;
+		return NodeHandle(mNodes.size() - 1);
+	}
+
+	template< class TFunc >
+	NodeHandle addNode(char const* name, TFunc&& func, std::initializer_list< NodeHandle > predecessors)
+	{
+		NodeHandle handle = addNode(name, std::forward<TFunc>(func));
+		for (NodeHandle predecessor : predecessors)
+		{
+			addDependency(handle, predecessor);
+		}
+		return handle;
+	}
+
+	//node will run after predecessor complete
+	void  addDependency(NodeHandle node, NodeHandle predecessor);
+	void  clear();
+	//build the root list and check the graph is acyclic , run will compile if need
+	bool  compile();
+
+	//dispatch and wait all nodes complete, the caller helps to execute works while waiting
+	void  run(QueueThreadPool& threadPool);
+	//dispatch only, group complete when all nodes complete
+	void  dispatch(QueueThreadPool& threadPool, QueuedWorkGroup& group);
+
+	int   getNodeNum() const { return (int)mNodes.size(); }
+
+private:
+
+	struct Node : public IQueuedWork
+	{
+		void executeWork() override;
+		void abandon() override { bAbandoned.store(true, std::memory_order_relaxed); }
+		void release() override;
+
+		TaskGraph*  graph = nullptr;
+		char const* name = nullptr;
+		std::function< void() > func;
+		TArray< NodeHandle > successors;
+		int numPredecessors = 0;
+		std::atomic< int32 > numPendingPredecessors;
+		//Set when the node or one of its predecessors is abandoned , the node is released without running
+		std::atomic< bool >  bAbandoned;
+	};
+
+	TArray< std::unique_ptr< Node > > mNodes;
+	TArray< IQueuedWork* > mRootNodes;
+	QueueThreadPool*  mRunPool;
+	QueuedWorkGroup*  mRunGroup;
+	bool  mbCompiled;
+};
+
+#endif // TaskGraph_H_B489CC39_EA4E_47B9_97EC_799021D23772
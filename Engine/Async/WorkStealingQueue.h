@@ -0,0 +1,153 @@
+#pragma once
+#ifndef WorkStealingQueue_H_C8868B04_A8AD_444D_A87A_676D511DC4E8
+#define WorkStealingQueue_H_C8868B04_A8AD_444D_A87A_676D511DC4E8
+
+#include "Core/IntegerType.h"
+
+#include <atomic>
+#include <cassert>
+#include <type_traits>
+
+// Chase-Lev work stealing deque.
+// The owner thread push/pop at bottom (LIFO), other threads steal from top (FIFO).
+// Retired buffers are kept alive until the queue destroyed, so a stealer never reads freed memory.
+template< typename T >
+class TWorkStealingQueue
+{
+	static_assert(std::is_trivially_copyable_v<T>, "TWorkStealingQueue only support trivially copyable element");
+public:
+	TWorkStealingQueue(int64 initCapacity = 256)
+	{
+		assert((initCapacity & (initCapacity - 1)) == 0);
+		mBuffer.store(new Buffer(initCapacity, nullptr), std::memory_order_relaxed);
+		mTop.store(0, std::memory_order_relaxed);
+		mBottom.store(0, std::memory_order_relaxed);
+	}
+
+	~TWorkStealingQueue()
+	{
+		Buffer* buffer = mBuffer.load(std::memory_order_relaxed);
+		while (buffer)
+		{
+			Buffer* prev = buffer->retired;
+			delete buffer;
+			buffer = prev;
+		}
+	}
+
+	TWorkStealingQueue(TWorkStealingQueue const&) = delete;
+	TWorkStealingQueue& operator = (TWorkStealingQueue const&) = delete;
+
+	//Owner thread only
+	void push(T value)
+	{
+		int64 bottom = mBottom.load(std::memory_order_relaxed);
+		int64 top = mTop.load(std::memory_order_acquire);
+		Buffer* buffer = mBuffer.load(std::memory_order_relaxed);
+		if (bottom - top > buffer->mask)
+		{
+			buffer = buffer->grow(top, bottom);
+			mBuffer.store(buffer, std::memory_order_release);
+		}
+		buffer->put(bottom, value);
+		std::atomic_thread_fence(std::memory_order_release);
+		mBottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	//Owner thread only
+	bool pop(T& outValue)
+	{
+		int64 bottom = mBottom.load(std::memory_order_relaxed) - 1;
+		Buffer* buffer = mBuffer.load(std::memory_order_relaxed);
+		mBottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64 top = mTop.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		outValue = buffer->get(bottom);
+		if (top == bottom)
+		{
+			//Last element : race with stealers
+			bool bWon = mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+			return bWon;
+		}
+		return true;
+	}
+
+	//Any thread
+	bool steal(T& outValue)
+	{
+		int64 top = mTop.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64 bottom = mBottom.load(std::memory_order_acquire);
+		if (top >= bottom)
+			return false;
+
+		Buffer* buffer = mBuffer.load(std::memory_order_consume);
+		T value = buffer->get(top);
+		if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return false;
+
+		outValue = value;
+		return true;
+	}
+
+	bool  empty() const
+	{
+		int64 bottom = mBottom.load(std::memory_order_relaxed);
+		int64 top = mTop.load(std::memory_order_relaxed);
+		return bottom <= top;
+	}
+
+	int64 size() const
+	{
+		int64 bottom = mBottom.load(std::memory_order_relaxed);
+		int64 top = mTop.load(std::memory_order_relaxed);
+		return bottom > top ? bottom - top : 0;
+	}
+
+private:
+
+	struct Buffer
+	{
+		Buffer(int64 capacity, Buffer* inRetired)
+			:mask(capacity - 1)
+			,retired(inRetired)
+		{
+			elements = new std::atomic<T>[capacity];
+		}
+		~Buffer()
+		{
+			delete[] elements;
+		}
+
+		void put(int64 index, T value) { elements[index & mask].store(value, std::memory_order_relaxed); }
+		T    get(int64 index) const { return elements[index & mask].load(std::memory_order_relaxed); }
+
+		Buffer* grow(int64 top, int64 bottom)
+		{
+			Buffer* result = new Buffer(2 * (mask + 1), this);
+			for (int64 i = top; i < bottom; ++i)
+			{
+				result->put(i, get(i));
+			}
+			return result;
+		}
+
+		int64  mask;
+		std::atomic<T>* elements;
+		Buffer* retired;
+	};
+
+	alignas(64) std::atomic< int64 > mTop;
+	alignas(64) std::atomic< int64 > mBottom;
+	alignas(64) std::atomic< Buffer* > mBuffer;
+};
+
+#endif // WorkStealingQueue_H_C8868B04_A8AD_444D_A87A_676D511DC4E8
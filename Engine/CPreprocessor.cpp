@@ -8,7 +8,7 @@
 #include "Core/FNV1a.h"
 
 
-static InlineString<512> GMsg;
+static thread_local InlineString<512> GMsg;
 #define PARSE_ERROR( MSG , ... ) \
 	{\
 		GMsg.format( "%s (%d) - " MSG , mInput.getSourceName() , mInput.getLine() , ##__VA_ARGS__ );\
@@ -386,6 +386,7 @@ namespace CPP
 		HashString fullPathHS = HashString(fullPath.c_str());
 
 		mUsedFiles.insert(fullPathHS);
+		getFileDependency().includeFiles.addUnique(fullPathHS);
 		if (mPragmaOnceSet.find(fullPathHS) != mPragmaOnceSet.end())
 			return true;
 
@@ -396,12 +397,16 @@ namespace CPP
 		}
 
 		CHECK(mSourceLibrary);
-		CodeSource* includeSource = mSourceLibrary->findOrLoadSource(fullPathHS);
+		CodeBufferSource* includeSource = mSourceLibrary->findOrLoadSource(fullPathHS);
 		if (includeSource == nullptr)
 		{
 			PARSE_ERROR("Can't load include file : %s" , fullPath.c_str());
 		}
 
+		//All the code is skipped when the guard is defined , don't scan the file again
+		if (!includeSource->includeGuard.empty() && findMacro(includeSource->includeGuard))
+			return true;
+
 		if (bCommentIncludeFileName)
 		{
 			mOutput->push("//Include ");
@@ -646,7 +651,10 @@ namespace CPP
 			}
 		}
 
+		InternExprIds(macro);
+
 		HashString macroString{ macroName , true };
+		getFileDependency().definedMacros.insert(macroString);
 		auto iter = mMacroSymbolMap.find(macroString);
 		if (iter != mMacroSymbolMap.end())
 		{
@@ -836,11 +844,13 @@ namespace CPP
 		if (!mInput.tokenIdentifier(idName))
 			return false;
 
+		//A name which was never interned can't be a macro , the output mustn't depend on the other translations
 		HashString nameKey;
-		if (!HashString::Find(idName, true, nameKey))
-			return false;
-
-		mMacroSymbolMap.erase(nameKey);
+		if (HashString::Find(idName, true, nameKey))
+		{
+			getFileDependency().definedMacros.insert(nameKey);
+			mMacroSymbolMap.erase(nameKey);
+		}
 		return true;
 	}
 
@@ -990,7 +1000,9 @@ namespace CPP
 					if (macro->evalFrame < mCurFrame)
 					{
 						std::string expandedExpr;
-						if (!expandMacro(macro->expr, expandedExpr))
+						ExpandMacroResult expandResult;
+						LineStringViewCode codeView(macro->expr);
+						if (!expandMacroInternal(codeView, expandedExpr, expandResult, 0, nullptr, macro))
 						{
 							return false;
 						}
@@ -1018,7 +1030,7 @@ namespace CPP
 		bool bHadExpanded = false;
 		if (id.length())
 		{
-			if (!checkIdentifierToExpand(id, exprCode, exprTextConv, expandResult, 0, nullptr))
+			if (!checkIdentifierToExpand(id, findMacro(id), exprCode, exprTextConv, expandResult, 0, nullptr))
 				return false;
 		}
 
@@ -1060,7 +1072,7 @@ namespace CPP
 		return expandMacroInternal(codeView, outText, outExpandResult, 0, nullptr);
 	}
 
-	bool Preprocessor::checkIdentifierToExpand(StringView const& id, class LineStringViewCode& code, std::string& outText, ExpandMacroResult& outResult, int depth, MacroExpansionContext const* context)
+	bool Preprocessor::checkIdentifierToExpand(StringView const& id, MacroSymbol* macro, class LineStringViewCode& code, std::string& outText, ExpandMacroResult& outResult, int depth, MacroExpansionContext const* context)
 	{
 		if (depth >= MAX_MACRO_EXPANSION_DEPTH)
 		{
@@ -1068,7 +1080,6 @@ namespace CPP
 			return false;
 		}
 
-		MacroSymbol* macro = findMacro(id);
 		if (macro)
 		{
 			if (context && context->isSuppressed(macro))
@@ -1237,7 +1248,7 @@ namespace CPP
 			else
 			{
 				LineStringViewCode codeView(macro->expr);
-				if (!expandMacroInternal(codeView, outText, outResult, depth + 1, &newContext))
+				if (!expandMacroInternal(codeView, outText, outResult, depth + 1, &newContext, macro))
 				{
 					return false;
 				}
@@ -1252,7 +1263,7 @@ namespace CPP
 		return true;
 	}
 
-	bool Preprocessor::expandMacroInternal(class LineStringViewCode& code, std::string& outText, ExpandMacroResult& outResult, int depth, MacroExpansionContext const* context)
+	bool Preprocessor::expandMacroInternal(class LineStringViewCode& code, std::string& outText, ExpandMacroResult& outResult, int depth, MacroExpansionContext const* context, MacroSymbol const* exprMacro)
 	{
 		if (depth >= MAX_MACRO_EXPANSION_DEPTH)
 		{
@@ -1260,12 +1271,14 @@ namespace CPP
 			return false;
 		}
 
+		int idIndex = 0;
 		while (!code.isEOF())
 		{
 			StringView id;
 			if (code.tokenIdentifier(id))
 			{
-				if (!checkIdentifierToExpand(id, code, outText, outResult, depth, context))
+				MacroSymbol* macro = exprMacro ? findExprMacro(*exprMacro, id, idIndex) : findMacro(id);
+				if (!checkIdentifierToExpand(id, macro, code, outText, outResult, depth, context))
 						return false;
 			}
 			else
@@ -1285,28 +1298,10 @@ namespace CPP
 
 	bool Preprocessor::findFile(std::string const& name, std::string& fullPath)
 	{
-		if( FFileSystem::IsExist(name.c_str()) )
-		{
-			fullPath = name;
-			return true;
-		}
-		// Reserve capacity to reduce reallocations
-		size_t maxDirLen = 0;
-		for (auto const& dir : mFileSearchDirs)
-		{
-			if (dir.size() > maxDirLen)
-				maxDirLen = dir.size();
-		}
-		fullPath.reserve(maxDirLen + name.size());
+		if (mSourceLibrary)
+			return mSourceLibrary->findFile(name, mFileSearchDirs, fullPath);
 
-		for (auto const& dir : mFileSearchDirs)
-		{
-			fullPath = dir;
-			fullPath += name;
-			if( FFileSystem::IsExist(fullPath.c_str()) )
-				return true;
-		}
-		return false;
+		return CodeSourceLibrary::SearchFile(name, mFileSearchDirs, fullPath);
 	}
 
 
@@ -1316,14 +1311,82 @@ namespace CPP
 		if (!HashString::Find(name, true, nameKey))
 			return nullptr;
 
-		auto iter = mMacroSymbolMap.find(nameKey);
+		return findMacro(nameKey);
+	}
+
+	Preprocessor::MacroSymbol* Preprocessor::findMacro(HashString const& name)
+	{
+		auto iter = mMacroSymbolMap.find(name);
 		if (iter == mMacroSymbolMap.end())
 			return nullptr;
 
-
+		//Only the defined macros are recorded , the value of a macro which isn't defined can't change the output
+		if (bRecordMacroDependency)
+		{
+			getFileDependency().readMacros.insert(name);
+		}
 		return &iter->second;
 	}
 
+	Preprocessor::MacroSymbol* Preprocessor::findExprMacro(MacroSymbol const& exprMacro, StringView const& id, int& inoutIdIndex)
+	{
+		//The identifiers are found in order , args of a macro skip some of them
+		int offset = int(id.data() - exprMacro.expr.data());
+		auto const& exprIds = exprMacro.exprIds;
+		while (inoutIdIndex < exprIds.size() && exprIds[inoutIdIndex].offset < offset)
+			++inoutIdIndex;
+
+		if (inoutIdIndex < exprIds.size() && exprIds[inoutIdIndex].offset == offset)
+			return findMacro(exprIds[inoutIdIndex].name);
+
+		return findMacro(id);
+	}
+
+	void Preprocessor::InternExprIds(MacroSymbol& macro)
+	{
+		//Same scan as expandMacroInternal , the offsets must match
+		LineStringViewCode code(macro.expr);
+		while (!code.isEOF())
+		{
+			StringView id;
+			if (code.tokenIdentifier(id))
+			{
+				MacroSymbol::ExprId exprId;
+				exprId.offset = int(id.data() - macro.expr.data());
+				exprId.name = HashString(id, true);
+				macro.exprIds.push_back(exprId);
+			}
+			else
+			{
+				do
+				{
+					code.advance();
+				} while (!code.isEOF() && !FCodeParse::IsValidStartCharForIdentifier(code.getChar()));
+			}
+		}
+	}
+
+	FileDependency& Preprocessor::getFileDependency()
+	{
+		if (mDependencyIndex == INDEX_NONE || mInput.source != mDependencySource)
+		{
+			mDependencySource = mInput.source;
+			HashString filePath = mInput.source ? mInput.source->getFilePath() : HashString();
+			auto iter = mFileDependencyMap.find(filePath);
+			if (iter != mFileDependencyMap.end())
+			{
+				mDependencyIndex = iter->second;
+			}
+			else
+			{
+				mDependencyIndex = mFileDependencies.size();
+				mFileDependencies.addDefault()->filePath = filePath;
+				mFileDependencyMap.emplace(filePath, mDependencyIndex);
+			}
+		}
+		return mFileDependencies[mDependencyIndex];
+	}
+
 	void Preprocessor::setOutput(CodeOutput& output)
 	{
 		mOutput = &output;
@@ -1368,6 +1431,14 @@ namespace CPP
 		outFiles.insert(mUsedFiles.begin(), mUsedFiles.end());
 	}
 
+	void Preprocessor::getReadMacros(std::unordered_set< HashString >& outMacros)
+	{
+		for (FileDependency const& dependency : mFileDependencies)
+		{
+			outMacros.insert(dependency.readMacros.begin(), dependency.readMacros.end());
+		}
+	}
+
 	void Preprocessor::emitSourceLine(int lineOffset)
 	{
 		InlineString< 512 > lineMacro;
@@ -1437,6 +1508,137 @@ namespace CPP
 		return true;
 	}
 
+	void CodeBufferSource::analyzeCode()
+	{
+		includeGuard = HashString();
+		macroHashes.clear();
+
+		enum class EGuardState
+		{
+			FindIfndef,
+			FindDefine,
+			InGuard,
+			AfterGuard,
+			Fail,
+		};
+		EGuardState guardState = EGuardState::FindIfndef;
+		StringView guardName(ForceInit);
+		int guardDepth = 0;
+
+		uint64 hash = FNV1a::Table< uint64 >::OffsetBias;
+		CodeLoc loc;
+		loc.mCur = getCode();
+		loc.mLineCount = 0;
+		FCodeParse::SkipBOM(loc.mCur);
+		while (!loc.isEoF())
+		{
+			CodeLoc lineStart = loc;
+			loc.skipSpaceInLine();
+
+			StringView directive(ForceInit);
+			StringView directiveName(ForceInit);
+			bool bDirective = loc.tokenChar('#');
+			if (bDirective)
+			{
+				loc.skipSpaceInLine();
+				loc.tokenIdentifier(directive);
+				loc.skipSpaceInLine();
+				loc.tokenIdentifier(directiveName);
+			}
+
+			uint32 directiveHash = HashValue(directive);
+			StringView macroName(ForceInit);
+			if (directiveHash == HashValue("define"))
+			{
+				macroName = directiveName;
+			}
+
+			bool bBlank = !bDirective && (loc.isEoL() || loc.isEoF() || (loc[0] == '/' && loc[1] == '/'));
+			char const* valueStart = loc.getCur();
+			loc.skipToNextLine();
+			StringView line = loc.getDifference(lineStart);
+
+			if (macroName.size())
+			{
+				//Keep the line count in the text hash , the #line of the output depends on it
+				hash = FNV1a::MakeHash< uint64 >((uint8 const*)lineStart.mCur, int(macroName.end() - lineStart.mCur), hash);
+				int numLine = loc.mLineCount - lineStart.mLineCount;
+				hash = FNV1a::MakeHash< uint64 >((uint8 const*)&numLine, sizeof(numLine), hash);
+				uint64& macroHash = macroHashes[HashString(macroName, true)];
+				macroHash = FNV1a::MakeHash< uint64 >((uint8 const*)valueStart, int(loc.getCur() - valueStart), macroHash ? macroHash : FNV1a::Table< uint64 >::OffsetBias);
+			}
+			else
+			{
+				hash = FNV1a::MakeHash< uint64 >((uint8 const*)line.data(), (int)line.size(), hash);
+			}
+
+			if (bBlank)
+				continue;
+
+			switch (guardState)
+			{
+			case EGuardState::FindIfndef:
+				guardState = EGuardState::Fail;
+				if (directiveHash == HashValue("ifndef") && directiveName.size())
+				{
+					guardName = directiveName;
+					guardState = EGuardState::FindDefine;
+					guardDepth = 1;
+				}
+				break;
+			case EGuardState::FindDefine:
+				guardState = (macroName.size() && macroName == guardName) ? EGuardState::InGuard : EGuardState::Fail;
+				break;
+			case EGuardState::InGuard:
+				switch (directiveHash)
+				{
+				case HashValue("if"):
+				case HashValue("ifdef"):
+				case HashValue("ifndef"):
+					++guardDepth;
+					break;
+				case HashValue("endif"):
+					--guardDepth;
+					if (guardDepth == 0)
+						guardState = EGuardState::AfterGuard;
+					break;
+				case HashValue("else"):
+				case HashValue("elif"):
+					if (guardDepth == 1)
+						guardState = EGuardState::Fail;
+					break;
+				}
+				break;
+			case EGuardState::AfterGuard:
+				guardState = EGuardState::Fail;
+				break;
+			}
+		}
+
+		textHash = hash;
+		if (guardState == EGuardState::AfterGuard)
+		{
+			includeGuard = HashString(guardName, true);
+		}
+	}
+
+	bool CodeBufferSource::CompareMacroValues(CodeBufferSource const& oldSource, CodeBufferSource const& newSource, TArray< HashString >& outChangedMacros)
+	{
+		//Same text hash means the same #define lines in the same places
+		if (oldSource.textHash != newSource.textHash || oldSource.macroHashes.size() != newSource.macroHashes.size())
+			return false;
+
+		for (auto const& pair : newSource.macroHashes)
+		{
+			auto iter = oldSource.macroHashes.find(pair.first);
+			if (iter == oldSource.macroHashes.end())
+				return false;
+			if (iter->second != pair.second)
+				outChangedMacros.push_back(pair.first);
+		}
+		return true;
+	}
+
 	bool CodeBufferSource::appendFile(char const* path)
 	{
 		if (!mBuffer.empty())
@@ -1587,35 +1789,185 @@ namespace CPP
 
 	CodeBufferSource* CodeSourceLibrary::findOrLoadSource(HashString const& path)
 	{
-		auto iter = mSourceMap.find(path);
+		{
+			Mutex::Locker locker(mMutex);
+			auto iter = mSourceMap.find(path);
+			if (iter != mSourceMap.end())
+				return iter->second;
+		}
 
-		CodeBufferSource* result;
-		if (iter == mSourceMap.end())
+		//Load without the lock , other preprocessors keep reading the loaded files
+		TPtrHolder< CodeBufferSource > includeSourcePtr(new CodeBufferSource);
+		//Get the attributes before the load , a modification during the load is found by the next refresh
+		FileAttributes attributes;
+		if (!FFileSystem::GetFileAttributes(path.c_str(), attributes) || !includeSourcePtr->loadFile(path.c_str()))
 		{
-			TPtrHolder< CodeBufferSource > includeSourcePtr(new CodeBufferSource);
-			if (!includeSourcePtr->loadFile(path.c_str()))
+			return nullptr;
+		}
+		includeSourcePtr->filePath = path;
+		includeSourcePtr->lastWriteTime = attributes.lastWrite;
+		includeSourcePtr->fileSize = attributes.size;
+		includeSourcePtr->analyzeCode();
+
+		Mutex::Locker locker(mMutex);
+		auto result = mSourceMap.emplace(path, includeSourcePtr.get());
+		if (result.second)
+		{
+			includeSourcePtr.release();
+		}
+		return result.first->second;
+	}
+
+	bool CodeSourceLibrary::findFile(std::string const& name, TArray< std::string > const& searchDirs, std::string& outFullPath)
+	{
+		std::string key = name;
+		for (auto const& dir : searchDirs)
+		{
+			key += '|';
+			key += dir;
+		}
+
+		{
+			Mutex::Locker locker(mMutex);
+			auto iter = mFilePathMap.find(key);
+			if (iter != mFilePathMap.end())
 			{
-				return nullptr;
+				outFullPath = iter->second;
+				return true;
 			}
-			result = includeSourcePtr.get();
-			result->filePath = path;
-			mSourceMap.emplace(path, includeSourcePtr.release());
 		}
-		else
+
+		if (!SearchFile(name, searchDirs, outFullPath))
+			return false;
+
+		Mutex::Locker locker(mMutex);
+		mFilePathMap.emplace(std::move(key), outFullPath);
+		return true;
+	}
+
+	bool CodeSourceLibrary::SearchFile(std::string const& name, TArray< std::string > const& searchDirs, std::string& outFullPath)
+	{
+		if( FFileSystem::IsExist(name.c_str()) )
 		{
-			result = iter->second;
+			outFullPath = name;
+			return true;
+		}
+		// Reserve capacity to reduce reallocations
+		size_t maxDirLen = 0;
+		for (auto const& dir : searchDirs)
+		{
+			if (dir.size() > maxDirLen)
+				maxDirLen = dir.size();
 		}
+		outFullPath.reserve(maxDirLen + name.size());
 
-		return result;
+		for (auto const& dir : searchDirs)
+		{
+			outFullPath = dir;
+			outFullPath += name;
+			if( FFileSystem::IsExist(outFullPath.c_str()) )
+				return true;
+		}
+		return false;
+	}
+
+	int CodeSourceLibrary::refreshModifiedSources()
+	{
+		Mutex::Locker locker(mMutex);
+
+		int numChanged = 0;
+		for (auto iter = mSourceMap.begin(); iter != mSourceMap.end();)
+		{
+			CodeBufferSource* source = iter->second;
+			FileAttributes attributes;
+			bool bExist = FFileSystem::GetFileAttributes(source->filePath.c_str(), attributes);
+			if (bExist && attributes.lastWrite == source->lastWriteTime && attributes.size == source->fileSize)
+			{
+				++iter;
+				continue;
+			}
+
+			++numChanged;
+			CodeSourceChange* change = mChanges.addDefault();
+			change->filePath = source->filePath;
+			change->serial = ++mChangeSerial;
+			change->bOnlyMacroValue = false;
+
+			TPtrHolder< CodeBufferSource > newSourcePtr(new CodeBufferSource);
+			if (!bExist || !newSourcePtr->loadFile(source->filePath.c_str()))
+			{
+				delete source;
+				iter = mSourceMap.erase(iter);
+				continue;
+			}
+
+			newSourcePtr->filePath = source->filePath;
+			newSourcePtr->lastWriteTime = attributes.lastWrite;
+			newSourcePtr->fileSize = attributes.size;
+			newSourcePtr->analyzeCode();
+			change->bOnlyMacroValue = CodeBufferSource::CompareMacroValues(*source, *newSourcePtr, change->changedMacros);
+
+			delete source;
+			iter->second = newSourcePtr.release();
+			++iter;
+		}
+
+		//Added or removed files can change the search results
+		if (numChanged)
+		{
+			mFilePathMap.clear();
+		}
+		return numChanged;
+	}
+
+	bool CodeSourceLibrary::isTranslationAffected(uint32 serial, std::unordered_set< HashString > const& files, std::unordered_set< HashString > const& readMacros)
+	{
+		Mutex::Locker locker(mMutex);
+
+		if (serial < mCleanupSerial)
+			return true;
+
+		for (HashString const& file : files)
+		{
+			if (mSourceMap.find(file) == mSourceMap.end())
+				return true;
+		}
+
+		for (CodeSourceChange const& change : mChanges)
+		{
+			if (change.serial > serial && change.isAffected(files, readMacros))
+				return true;
+		}
+		return false;
+	}
+
+	bool CodeSourceChange::isAffected(std::unordered_set< HashString > const& files, std::unordered_set< HashString > const& readMacros) const
+	{
+		if (files.find(filePath) == files.end())
+			return false;
+
+		if (!bOnlyMacroValue)
+			return true;
+
+		for (HashString const& macroName : changedMacros)
+		{
+			if (readMacros.find(macroName) != readMacros.end())
+				return true;
+		}
+		return false;
 	}
 
 	void CodeSourceLibrary::cleanup()
 	{
+		Mutex::Locker locker(mMutex);
 		for (auto& pair : mSourceMap)
 		{
 			delete pair.second;
 		}
 		mSourceMap.clear();
+		mFilePathMap.clear();
+		mChanges.clear();
+		mCleanupSerial = ++mChangeSerial;
 	}
 
 	bool ExpressionEvaluator::evaluate(int& ret)
@@ -9,6 +9,8 @@
 #include "Template/ArrayView.h"
 #include "Template/StringView.h"
 #include "DataStructure/Array.h"
+#include "PlatformThread.h"
+#include "Core/DateTime.h"
 
 #include <string>
 #include <ostream>
@@ -422,12 +424,25 @@ namespace CPP
 		TArrayView< uint8 const > getBuffer() { return mBuffer; }
 
 
+		// Find the include guard and hash the text without the macro values , done by the library after loading
+		void analyzeCode();
+		// Return false if more than the values of the macros changed
+		static bool CompareMacroValues(CodeBufferSource const& oldSource, CodeBufferSource const& newSource, TArray< HashString >& outChangedMacros);
+
 		virtual int getLineOffset(){  return lineOffset;  }
 		virtual char const* getCode() {  return (char const*)mBuffer.data();  }
 		virtual HashString  getFilePath() { return filePath; }
 		virtual char const* getSourceName() { return filePath.c_str(); }
 		HashString    filePath;
 		int lineOffset = 0;
+
+		//#ifndef X #define X ... #endif around all the code , the file can be skipped when X is defined
+		HashString    includeGuard;
+		//Hash of the text with the #define lines reduced to the macro names
+		uint64        textHash = 0;
+		std::unordered_map< HashString, uint64 > macroHashes;
+		DateTime      lastWriteTime;
+		int64         fileSize = 0;
 	private:
 
 		TArray< uint8 > mBuffer;
@@ -487,6 +502,20 @@ namespace CPP
 		STD_EXCEPTION_CONSTRUCTOR_WITH_WHAT(SyntaxError)
 	};
 
+	// A modified file found by CodeSourceLibrary::refreshModifiedSources
+	struct CodeSourceChange
+	{
+		HashString filePath;
+		uint32     serial;
+		//Only the values of some macros changed , translations which don't read them have the same output
+		bool       bOnlyMacroValue;
+		TArray< HashString > changedMacros;
+
+		bool isAffected(std::unordered_set< HashString > const& files, std::unordered_set< HashString > const& readMacros) const;
+	};
+
+	// Loaded include files and resolved include paths shared by preprocessors , thread-safe.
+	// The sources are never modified after the load , preprocessors on other threads can read them without lock.
 	class CodeSourceLibrary
 	{
 	public:
@@ -494,10 +523,36 @@ namespace CPP
 		~CodeSourceLibrary();
 
 		CodeBufferSource* findOrLoadSource(HashString const& path);
+		bool findFile(std::string const& name, TArray< std::string > const& searchDirs, std::string& outFullPath);
+
+		// Reload the files modified after they were loaded and record the changes , return the number of changed files.
+		// Must not be called while preprocessors use the library.
+		int  refreshModifiedSources();
+		uint32 getChangeSerial() const { return mChangeSerial; }
+		// Check the changes after the serial of a translation with the files and macros it used ,
+		// a file which isn't in the library can't be checked and is treated as changed
+		bool isTranslationAffected(uint32 serial, std::unordered_set< HashString > const& files, std::unordered_set< HashString > const& readMacros);
 
 		void cleanup();
 
+		static bool SearchFile(std::string const& name, TArray< std::string > const& searchDirs, std::string& outFullPath);
+
+		Mutex mMutex;
 		std::unordered_map< HashString, CodeBufferSource* > mSourceMap;
+		std::unordered_map< std::string, std::string > mFilePathMap;
+		TArray< CodeSourceChange > mChanges;
+		uint32 mChangeSerial = 1;
+		//The changes before a cleanup are lost , the translations before it are unknown like the serial 0
+		uint32 mCleanupSerial = 1;
+	};
+
+	// Dependencies of a file in a translation , the include files are recorded even if they are skipped
+	struct FileDependency
+	{
+		HashString filePath;
+		TArray< HashString > includeFiles;
+		std::unordered_set< HashString > readMacros;
+		std::unordered_set< HashString > definedMacros;
 	};
 
 	class Preprocessor
@@ -516,12 +571,16 @@ namespace CPP
 		void addInclude(char const* fileName, bool bSystemPath = false);
 
 		void getUsedIncludeFiles(std::unordered_set< HashString >& outFiles);
+		void getReadMacros(std::unordered_set< HashString >& outMacros);
+		//The code without file path , like the definitions , is recorded with an empty path
+		TArrayView< FileDependency const > getFileDependencies() const { return mFileDependencies; }
 
 		bool bSupportMacroArg = true;
 		bool bReplaceMacroText = false;
 		bool bAllowRedefineMacro = false;
 		bool bCommentIncludeFileName = true;
 		bool bAddLineMacro = true;
+		bool bRecordMacroDependency = false;
 		enum LineFormat
 		{
 			LF_LineNumber,
@@ -606,8 +665,9 @@ namespace CPP
 			}
 		};
 
-		bool checkIdentifierToExpand(StringView const& id, class LineStringViewCode& code, std::string& outText, ExpandMacroResult& outResult, int depth, MacroExpansionContext const* context);
-		bool expandMacroInternal(class LineStringViewCode& code, std::string& outText, ExpandMacroResult& outResult, int depth, MacroExpansionContext const* context);
+		bool checkIdentifierToExpand(StringView const& id, MacroSymbol* macro, class LineStringViewCode& code, std::string& outText, ExpandMacroResult& outResult, int depth, MacroExpansionContext const* context);
+		//exprMacro is the macro of the code , its interned identifiers are used instead of hashing the text
+		bool expandMacroInternal(class LineStringViewCode& code, std::string& outText, ExpandMacroResult& outResult, int depth, MacroExpansionContext const* context, MacroSymbol const* exprMacro = nullptr);
 
 		static constexpr int MAX_MACRO_EXPANSION_DEPTH = 256;
 
@@ -673,13 +733,25 @@ namespace CPP
 			};
 			TArray< ArgEntry > argEntries;
 			ArgEntry vaArgs;
-			bool bVaEatComma;
+			bool bVaEatComma = false;
+
+			//Identifiers of expr interned when the macro is defined
+			struct ExprId
+			{
+				int offset;
+				HashString name;
+			};
+			TArray< ExprId > exprIds;
 
 			int cachedEvalValue;
 			int evalFrame;
 		};
 
+		static void InternExprIds(MacroSymbol& macro);
+
 		MacroSymbol* findMacro(StringView const& name);
+		MacroSymbol* findMacro(HashString const& name);
+		MacroSymbol* findExprMacro(MacroSymbol const& exprMacro, StringView const& id, int& inoutIdIndex);
 
 		MacroSymbol* findMacroInLineText(StringView& inoutText)
 		{
@@ -730,6 +802,12 @@ namespace CPP
 		TArray< std::string > mFileSearchDirs;
 		std::unordered_set< HashString >  mUsedFiles;
 
+		FileDependency& getFileDependency();
+		TArray< FileDependency > mFileDependencies;
+		std::unordered_map< HashString, int > mFileDependencyMap;
+		CodeSource* mDependencySource = nullptr;
+		int mDependencyIndex = INDEX_NONE;
+
 
 		CodeSourceLibrary* mSourceLibrary = nullptr;
 		bool mbSourceLibraryManaged = false;
@@ -771,5 +849,6 @@ namespace CPP
 }
 
 BITWISE_RELLOCATABLE_FAIL(CPP::Preprocessor::InputEntry);
+BITWISE_RELLOCATABLE_FAIL(CPP::FileDependency);
 
 #endif // CPreprocessor_H_09DCE0C0_9F70_44E8_A8B4_1C2DF2BC8685
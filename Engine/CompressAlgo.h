@@ -118,6 +118,28 @@ public:
 			alphabetNodes[alphabet].alphabet = alphabet;
 		}
 
+		buildTree();
+	}
+
+	//Rebuild from explicit weights , used by adaptive coders that keep their own statistics.
+	//Zero weight alphabets get no code.
+	void buildFromWeights(WeightType const weights[], int numAlphabet)
+	{
+		alphabetNodes.clear();
+		alphabetNodes.resize(numAlphabet);
+		mRoot = nullptr;
+
+		for( int i = 0; i < numAlphabet; ++i )
+		{
+			alphabetNodes[i].weight = weights[i];
+			alphabetNodes[i].alphabet = AlphabetType(i);
+		}
+
+		buildTree();
+	}
+
+	void buildTree()
+	{
 		struct WeightCmp
 		{
 			bool operator()(Node const* a, Node const* b) const
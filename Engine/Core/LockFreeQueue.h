@@ -0,0 +1,299 @@
+#pragma once
+#ifndef LockFreeQueue_H_F49CA884_5B44_45E3_8CFC_15D8C4DF3420
+#define LockFreeQueue_H_F49CA884_5B44_45E3_8CFC_15D8C4DF3420
+
+#include "Core/IntegerType.h"
+#include "BitUtility.h"
+
+#include <atomic>
+#include <cassert>
+#include <new>
+#include <utility>
+
+// Bounded multi-producer multi-consumer ring (Vyukov).
+// Each cell carries a sequence number, so producers and consumers only contend on their own position counter
+// and a full or empty queue is detected without locking.
+template< typename T >
+class TLockFreeBoundedQueue
+{
+public:
+	explicit TLockFreeBoundedQueue(uint32 capacity)
+	{
+		assert(capacity >= 2 && FBitUtility::IsOneBitSet(capacity));
+		mMask = capacity - 1;
+		mCells = new Cell[capacity];
+		for (uint32 i = 0; i < capacity; ++i)
+		{
+			mCells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		mEnqueuePos.store(0, std::memory_order_relaxed);
+		mDequeuePos.store(0, std::memory_order_relaxed);
+	}
+
+	~TLockFreeBoundedQueue()
+	{
+		uint32 enqueuePos = mEnqueuePos.load(std::memory_order_relaxed);
+		for (uint32 pos = mDequeuePos.load(std::memory_order_relaxed); pos != enqueuePos; ++pos)
+		{
+			mCells[pos & mMask].get()->~T();
+		}
+		delete[] mCells;
+	}
+
+	TLockFreeBoundedQueue(TLockFreeBoundedQueue const&) = delete;
+	TLockFreeBoundedQueue& operator = (TLockFreeBoundedQueue const&) = delete;
+
+	//Return false if the queue is full
+	template< class ...Args >
+	bool tryPush(Args&& ...args)
+	{
+		Cell* cell;
+		uint32 pos = mEnqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &mCells[pos & mMask];
+			uint32 sequence = cell->sequence.load(std::memory_order_acquire);
+			int32 diff = int32(sequence - pos);
+			if (diff == 0)
+			{
+				if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = mEnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		new (cell->storage) T(std::forward<Args>(args)...);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Return false if the queue is empty
+	bool tryPop(T& outValue)
+	{
+		Cell* cell;
+		uint32 pos = mDequeuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &mCells[pos & mMask];
+			uint32 sequence = cell->sequence.load(std::memory_order_acquire);
+			int32 diff = int32(sequence - (pos + 1));
+			if (diff == 0)
+			{
+				if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = mDequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		T* value = cell->get();
+		outValue = std::move(*value);
+		value->~T();
+		cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+		return true;
+	}
+
+	uint32 capacity() const { return mMask + 1; }
+
+	//Only a snapshot when other threads are working on the queue
+	uint32 sizeApprox() const
+	{
+		uint32 enqueuePos = mEnqueuePos.load(std::memory_order_relaxed);
+		uint32 dequeuePos = mDequeuePos.load(std::memory_order_relaxed);
+		int32 size = int32(enqueuePos - dequeuePos);
+		return size > 0 ? uint32(size) : 0;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic< uint32 > sequence;
+		alignas(T) uint8 storage[sizeof(T)];
+
+		T* get() { return reinterpret_cast<T*>(storage); }
+	};
+
+	Cell*  mCells;
+	uint32 mMask;
+	alignas(64) std::atomic< uint32 > mEnqueuePos;
+	alignas(64) std::atomic< uint32 > mDequeuePos;
+};
+
+
+// Unbounded multi-producer single-consumer queue (Vyukov intrusive list).
+// A push is one allocation from the node pool and one atomic exchange, the consumer never blocks producers.
+// Nodes are allocated in segments that double in size and are only released with the queue,
+// recycled nodes go through a tagged free list so a stale pop can't succeed after the node is reused (ABA).
+// Also used as a SPSC queue, the single producer case never contends.
+template< typename T, uint32 BaseSegmentSizeLog2 = 8 >
+class TLockFreeMPSCQueue
+{
+public:
+	TLockFreeMPSCQueue()
+	{
+		for (auto& segment : mSegments)
+		{
+			segment.store(nullptr, std::memory_order_relaxed);
+		}
+		mNumNodes.store(0, std::memory_order_relaxed);
+		mFreeHead.store(0, std::memory_order_relaxed);
+
+		Node* stub = allocNode();
+		stub->next.store(nullptr, std::memory_order_relaxed);
+		mHead = stub;
+		mTail.store(stub, std::memory_order_relaxed);
+	}
+
+	~TLockFreeMPSCQueue()
+	{
+		for (Node* node = mHead->next.load(std::memory_order_relaxed); node; node = node->next.load(std::memory_order_relaxed))
+		{
+			node->get()->~T();
+		}
+
+		for (uint32 i = 0; i < MaxSegmentNum; ++i)
+		{
+			delete[] mSegments[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	TLockFreeMPSCQueue(TLockFreeMPSCQueue const&) = delete;
+	TLockFreeMPSCQueue& operator = (TLockFreeMPSCQueue const&) = delete;
+
+	//Any thread
+	template< class ...Args >
+	void push(Args&& ...args)
+	{
+		Node* node = allocNode();
+		new (node->storage) T(std::forward<Args>(args)...);
+		node->next.store(nullptr, std::memory_order_relaxed);
+		Node* prev = mTail.exchange(node, std::memory_order_acq_rel);
+		//The consumer can't pass prev until it is linked, so prev is still alive here
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	//Consumer thread only.
+	//A push that has exchanged the tail but not linked the node yet is not visible until it finish.
+	bool tryPop(T& outValue)
+	{
+		Node* head = mHead;
+		Node* next = head->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+			return false;
+
+		T* value = next->get();
+		outValue = std::move(*value);
+		value->~T();
+		//next becomes the new stub
+		mHead = next;
+		freeNode(head);
+		return true;
+	}
+
+	//Consumer thread only
+	bool empty() const
+	{
+		return mHead->next.load(std::memory_order_acquire) == nullptr;
+	}
+
+	uint32 getAllocatedNodeNum() const { return mNumNodes.load(std::memory_order_relaxed); }
+
+private:
+	static constexpr uint32 BaseSegmentSize = 1 << BaseSegmentSizeLog2;
+	static constexpr uint32 MaxSegmentNum = 32 - BaseSegmentSizeLog2;
+
+	struct Node
+	{
+		std::atomic< Node* >  next;
+		std::atomic< uint32 > nextFree;
+		uint32 index;
+		alignas(T) uint8 storage[sizeof(T)];
+
+		T* get() { return reinterpret_cast<T*>(storage); }
+	};
+
+	//Segment k holds BaseSegmentSize << k nodes
+	static void GetNodeLocation(uint32 index, uint32& outSegment, uint32& outOffset)
+	{
+		uint32 block = (index >> BaseSegmentSizeLog2) + 1;
+		outSegment = 31 - FBitUtility::CountLeadingZeros(block);
+		outOffset = index - ((BaseSegmentSize << outSegment) - BaseSegmentSize);
+	}
+
+	Node* getNode(uint32 index)
+	{
+		uint32 segment, offset;
+		GetNodeLocation(index, segment, offset);
+		return mSegments[segment].load(std::memory_order_acquire) + offset;
+	}
+
+	Node* allocNode()
+	{
+		uint64 head = mFreeHead.load(std::memory_order_acquire);
+		while (uint32(head))
+		{
+			//Nodes are never released , reading a node that was popped by other thread is harmless,
+			//the tag makes the exchange fail in that case
+			Node* node = getNode(uint32(head) - 1);
+			uint64 newHead = ((head >> 32) + 1) << 32 | node->nextFree.load(std::memory_order_relaxed);
+			if (mFreeHead.compare_exchange_weak(head, newHead, std::memory_order_acquire, std::memory_order_acquire))
+				return node;
+		}
+
+		uint32 index = mNumNodes.fetch_add(1, std::memory_order_relaxed);
+		uint32 segment, offset;
+		GetNodeLocation(index, segment, offset);
+		assert(segment < MaxSegmentNum);
+		Node* nodes = mSegments[segment].load(std::memory_order_acquire);
+		if (nodes == nullptr)
+		{
+			Node* newNodes = new Node[BaseSegmentSize << segment];
+			if (mSegments[segment].compare_exchange_strong(nodes, newNodes, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				nodes = newNodes;
+			}
+			else
+			{
+				delete[] newNodes;
+			}
+		}
+		Node* node = nodes + offset;
+		node->index = index;
+		return node;
+	}
+
+	void freeNode(Node* node)
+	{
+		uint64 head = mFreeHead.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			node->nextFree.store(uint32(head), std::memory_order_relaxed);
+			uint64 newHead = ((head >> 32) + 1) << 32 | (node->index + 1);
+			if (mFreeHead.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed))
+				break;
+		}
+	}
+
+	//Consumer side
+	Node* mHead;
+	alignas(64) std::atomic< Node* > mTail;
+	//Low 32 bits : node index + 1 , high 32 bits : ABA tag
+	alignas(64) std::atomic< uint64 > mFreeHead;
+	std::atomic< uint32 > mNumNodes;
+	std::atomic< Node* >  mSegments[MaxSegmentNum];
+};
+
+#endif // LockFreeQueue_H_F49CA884_5B44_45E3_8CFC_15D8C4DF3420
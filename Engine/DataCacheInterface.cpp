@@ -5,6 +5,16 @@
 #include "InlineString.h"
 #include "Serialize/FileStream.h"
 #include "FileSystem.h"
+#include "LZCompress.h"
+#include "PlatformThread.h"
+#include "Async/AsyncWork.h"
+#include "LogSystem.h"
+
+#include <fstream>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
 
 
 DataCacheArg::DataCacheArg()
@@ -33,113 +43,683 @@ void DataCacheArg::addRaw(uint8 const* data, int size)
 	value = FNV1a::MakeHash(data, size, value);
 }
 
-class DataCacheImpl : public DataCacheInterface
+namespace
+{
+	int const NumCacheShard = 16;
+
+	//The key name follows the header , the stored data follows the name
+	struct PackRecordHeader
+	{
+		static uint32 const Magic = 0x32434444; // "DDC2"
+
+		uint32 magic;
+		uint32 flags;
+		uint64 key;
+		uint32 rawSize;
+		uint32 storedSize;
+		uint32 nameLength;
+		uint32 nameHash;
+	};
+
+	enum EPackRecordFlag
+	{
+		PRF_Compressed = 1 << 0,
+	};
+
+	struct PackIndexHeader
+	{
+		static uint32 const Magic = 0x49434444; // "DDCI"
+		static uint32 const Version = 2;
+
+		uint32 magic;
+		uint32 version;
+		uint64 packSize;
+		uint32 numEntry;
+		uint32 useCounter;
+	};
+
+	struct PackIndexEntry
+	{
+		uint64 key;
+		uint64 offset;
+		uint32 rawSize;
+		uint32 storedSize;
+		uint32 flags;
+		uint32 lastUse;
+		uint32 nameLength;
+		uint32 nameHash;
+
+		uint64 getRecordSize() const { return sizeof(PackRecordHeader) + nameLength + storedSize; }
+	};
+
+	//The 64 bit hash selects the entry , the name and its independent 32 bit hash tell colliding keys apart
+	struct CacheKeyName
+	{
+		InlineString<512> name;
+		int    length;
+		uint64 hash;
+		uint32 nameHash;
+	};
+}
+
+// One shard of the cache : a LRU of decompressed data in front of an append only pack file.
+// The index of the pack file is saved on shutdown , a pack file which doesn't match its index is scanned.
+class DataCacheShard
 {
 public:
-	DataCacheImpl(char const* dir)
-		:mCacheDir( dir )
+	DataCacheShard()
 	{
+		mPackSize = 0;
+		mLiveSize = 0;
+		mMemorySize = 0;
+		mUseCounter = 0;
+		mbIndexDirty = false;
+	}
 
+	void initialize(char const* dir, int index, DataCacheSettings const& settings)
+	{
+		mPackPath.format("%s/Shard%02d.pack", dir, index);
+		mIndexPath.format("%s/Shard%02d.index", dir, index);
+		mMemoryBudget = settings.memoryBudget / NumCacheShard;
+		mDiskBudget = settings.diskBudget / NumCacheShard;
 
+		Mutex::Locker locker(mMutex);
+		if (!openPackFile())
+		{
+			LogWarning(0, "DataCache : Can't open pack file %s", mPackPath.c_str());
+			return;
+		}
+		if (!loadIndex())
+		{
+			scanPackFile();
+		}
 	}
 
-	void getFilePath(DataCacheKey const& key, InlineString<512>& outPath)
+	void shutdown()
 	{
-		InlineString<512> fileName;
-		int length = fileName.format("%s_%s_%0llX", key.typeName, key.version, key.keySuffix.value);
-		uint32 nameHash = HashValue(fileName.data(), length);
-		outPath.format("%s/%d/%d/%d/%s.ddc", mCacheDir.c_str(), nameHash % 10, (nameHash / 10) % 10, (nameHash / 100) % 10, fileName.c_str());
+		Mutex::Locker locker(mMutex);
+		if (mPackFile.is_open())
+		{
+			mPackFile.flush();
+			if (mbIndexDirty)
+				saveIndex();
+			mPackFile.close();
+		}
 	}
 
-	bool save(DataCacheKey const& key, TArrayView<uint8> saveData) override
+	bool load(CacheKeyName const& keyName, TArray< uint8 >& outData)
 	{
-		if (isDataIgnored(key))
+		uint64 key = keyName.hash;
+		Mutex::Locker locker(mMutex);
+
+		auto memIter = mMemoryMap.find(key);
+		if (memIter != mMemoryMap.end() && memIter->second->name == keyName.name.c_str())
+		{
+			mMemoryList.splice(mMemoryList.begin(), mMemoryList, memIter->second);
+			outData = memIter->second->data;
+			touchIndex(key);
+			++mStats.numMemoryHit;
 			return true;
+		}
 
-		InlineString<512> filePath;
-		getFilePath(key, filePath);
+		auto iter = mIndex.find(key);
+		if (iter == mIndex.end() || iter->second.nameHash != keyName.nameHash || iter->second.nameLength != keyName.length)
+		{
+			++mStats.numMiss;
+			return false;
+		}
+		if (!readRecord(iter->second, keyName, outData))
+		{
+			removeEntry(key, false);
+			mbIndexDirty = true;
+			++mStats.numMiss;
+			return false;
+		}
+
+		iter->second.lastUse = ++mUseCounter;
+		mbIndexDirty = true;
+		addMemoryEntry(keyName, outData.data(), (uint32)outData.size());
+		++mStats.numDiskHit;
+		return true;
+	}
 
-		OutputFileSerializer fs;
-		if( !fs.open(filePath) )
+	bool save(CacheKeyName const& keyName, uint8 const* rawData, uint32 rawSize, uint8 const* storedData, uint32 storedSize, uint32 flags)
+	{
+		uint64 key = keyName.hash;
+		Mutex::Locker locker(mMutex);
+		if (!mPackFile.is_open())
+			return false;
+
+		PackRecordHeader header;
+		header.magic = PackRecordHeader::Magic;
+		header.flags = flags;
+		header.key = key;
+		header.rawSize = rawSize;
+		header.storedSize = storedSize;
+		header.nameLength = keyName.length;
+		header.nameHash = keyName.nameHash;
+
+		mPackFile.clear();
+		mPackFile.seekp(mPackSize);
+		mPackFile.write((char const*)&header, sizeof(header));
+		mPackFile.write(keyName.name.c_str(), keyName.length);
+		mPackFile.write((char const*)storedData, storedSize);
+		if (!mPackFile.good())
 		{
-			auto dirView = FFileUtility::GetDirectory(filePath);
-			if( !FFileSystem::CreateDirectorySequence(dirView.toMutableCString()) )
-			{
-				return false;
-			}
-			if( !fs.open(filePath) )
-				return false;
+			mPackFile.clear();
+			return false;
 		}
 
-		fs.write(saveData.data(), saveData.size());
+		//The old record of the key , or of a colliding key , becomes garbage
+		removeEntry(key, false);
+
+		PackIndexEntry& entry = mIndex[key];
+		entry.key = key;
+		entry.offset = mPackSize;
+		entry.rawSize = rawSize;
+		entry.storedSize = storedSize;
+		entry.flags = flags;
+		entry.lastUse = ++mUseCounter;
+		entry.nameLength = keyName.length;
+		entry.nameHash = keyName.nameHash;
+		mPackSize += entry.getRecordSize();
+		mLiveSize += entry.getRecordSize();
+		mbIndexDirty = true;
+
+		addMemoryEntry(keyName, rawData, rawSize);
+
+		++mStats.numSave;
+		mStats.rawSize += rawSize;
+		mStats.storedSize += storedSize;
+
+		evictDiskEntries();
+		return true;
+	}
+
+	void getStats(DataCacheStats& inoutStats)
+	{
+		Mutex::Locker locker(mMutex);
+		inoutStats.numMemoryHit += mStats.numMemoryHit;
+		inoutStats.numDiskHit += mStats.numDiskHit;
+		inoutStats.numMiss += mStats.numMiss;
+		inoutStats.numSave += mStats.numSave;
+		inoutStats.numEvict += mStats.numEvict;
+		inoutStats.rawSize += mStats.rawSize;
+		inoutStats.storedSize += mStats.storedSize;
+		inoutStats.memorySize += mMemorySize;
+		inoutStats.diskSize += mPackSize;
+	}
+
+private:
 
-		if( !fs.isValid() )
+	bool openPackFile()
+	{
+		if (!FFileSystem::IsExist(mPackPath))
 		{
+			std::ofstream createFile(mPackPath.c_str(), std::ios::binary);
+			if (!createFile.is_open())
+				return false;
+		}
+		mPackFile.open(mPackPath.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		if (!mPackFile.is_open())
+			return false;
+
+		uint64 fileSize = 0;
+		FFileSystem::GetFileSize(mPackPath, fileSize);
+		mPackSize = fileSize;
+		return true;
+	}
+
+	bool loadIndex()
+	{
+		std::ifstream fs(mIndexPath.c_str(), std::ios::binary);
+		if (!fs.is_open())
+			return false;
+
+		PackIndexHeader header;
+		fs.read((char*)&header, sizeof(header));
+		if (!fs.good() || header.magic != PackIndexHeader::Magic || header.version != PackIndexHeader::Version ||
+			header.packSize != mPackSize)
 			return false;
+
+		TArray< PackIndexEntry > entries;
+		entries.resize(header.numEntry);
+		fs.read((char*)entries.data(), entries.size() * sizeof(PackIndexEntry));
+		if (!fs.good())
+			return false;
+
+		mIndex.clear();
+		mLiveSize = 0;
+		for (PackIndexEntry const& entry : entries)
+		{
+			if (entry.offset + entry.getRecordSize() > mPackSize)
+				continue;
+			mIndex[entry.key] = entry;
+			mLiveSize += entry.getRecordSize();
 		}
-		fs.close();
+		mUseCounter = header.useCounter;
+		mbIndexDirty = false;
 		return true;
 	}
 
-	bool saveDelegate(DataCacheKey const& key, SerializeDelegate inDelegate) override
+	void saveIndex()
 	{
-		if (isDataIgnored(key))
-			return true;
+		std::ofstream fs(mIndexPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (!fs.is_open())
+			return;
+
+		PackIndexHeader header;
+		header.magic = PackIndexHeader::Magic;
+		header.version = PackIndexHeader::Version;
+		header.packSize = mPackSize;
+		header.numEntry = (uint32)mIndex.size();
+		header.useCounter = mUseCounter;
+		fs.write((char const*)&header, sizeof(header));
+		for (auto const& pair : mIndex)
+		{
+			fs.write((char const*)&pair.second, sizeof(PackIndexEntry));
+		}
+		mbIndexDirty = !fs.good();
+	}
 
-		InlineString<512> filePath;
-		getFilePath(key, filePath);
+	//Rebuild the index from the records , the later record of a key wins
+	void scanPackFile()
+	{
+		mIndex.clear();
+		mLiveSize = 0;
+		mUseCounter = 0;
+
+		uint64 offset = 0;
+		uint64 fileSize = mPackSize;
+		mPackFile.clear();
+		mPackFile.seekg(0);
+		while (offset + sizeof(PackRecordHeader) <= fileSize)
+		{
+			PackRecordHeader header;
+			mPackFile.read((char*)&header, sizeof(header));
+			if (!mPackFile.good() || header.magic != PackRecordHeader::Magic ||
+				offset + sizeof(header) + header.nameLength + header.storedSize > fileSize)
+				break;
+
+			removeEntry(header.key, false);
+
+			PackIndexEntry& entry = mIndex[header.key];
+			entry.key = header.key;
+			entry.offset = offset;
+			entry.rawSize = header.rawSize;
+			entry.storedSize = header.storedSize;
+			entry.flags = header.flags;
+			entry.lastUse = ++mUseCounter;
+			entry.nameLength = header.nameLength;
+			entry.nameHash = header.nameHash;
+			mLiveSize += entry.getRecordSize();
+
+			offset += entry.getRecordSize();
+			mPackFile.seekg(offset);
+		}
+
+		//A record cut by a crash is overwritten by the next save
+		mPackSize = offset;
+		mPackFile.clear();
+		mbIndexDirty = true;
+	}
 
-		OutputFileSerializer fs;
-		if( !fs.open(filePath) )
+	bool readRecord(PackIndexEntry const& entry, CacheKeyName const& keyName, TArray< uint8 >& outData)
+	{
+		PackRecordHeader header;
+		mPackFile.clear();
+		mPackFile.seekg(entry.offset);
+		mPackFile.read((char*)&header, sizeof(header));
+		if (!mPackFile.good() || header.magic != PackRecordHeader::Magic || header.key != entry.key ||
+			header.storedSize != entry.storedSize || header.rawSize != entry.rawSize || header.nameLength != keyName.length)
 		{
-			auto dirView = FFileUtility::GetDirectory(filePath);
-			if( !FFileSystem::CreateDirectorySequence(dirView.toMutableCString()) )
+			mPackFile.clear();
+			return false;
+		}
+
+		mReadName.resize(header.nameLength);
+		mPackFile.read(mReadName.data(), header.nameLength);
+		if (!mPackFile.good() || FCString::CompareN(mReadName.data(), keyName.name.c_str(), header.nameLength) != 0)
+		{
+			mPackFile.clear();
+			return false;
+		}
+
+		TArray< uint8 >& readData = (header.flags & PRF_Compressed) ? mReadBuffer : outData;
+		readData.resize(header.storedSize);
+		mPackFile.read((char*)readData.data(), header.storedSize);
+		if (!mPackFile.good())
+		{
+			mPackFile.clear();
+			return false;
+		}
+
+		if (header.flags & PRF_Compressed)
+		{
+			outData.resize(header.rawSize);
+			if (!FLZCompress::Decompress(mReadBuffer.data(), mReadBuffer.size(), outData.data(), outData.size()))
 			{
+				LogWarning(0, "DataCache : Corrupt record in %s", mPackPath.c_str());
 				return false;
 			}
-			if( !fs.open(filePath) )
-				return false;
 		}
+		return true;
+	}
 
-		if( !inDelegate(fs) || !fs.isValid() )
+	void touchIndex(uint64 key)
+	{
+		auto iter = mIndex.find(key);
+		if (iter != mIndex.end())
 		{
-			if (!FFileSystem::DeleteFile(filePath))
+			iter->second.lastUse = ++mUseCounter;
+			mbIndexDirty = true;
+		}
+	}
+
+	void addMemoryEntry(CacheKeyName const& keyName, uint8 const* data, uint32 size)
+	{
+		uint64 key = keyName.hash;
+		removeMemoryEntry(key);
+		//Big entries would flush the whole tier
+		if (size > mMemoryBudget / 4)
+			return;
+
+		mMemoryList.emplace_front();
+		MemoryEntry& entry = mMemoryList.front();
+		entry.key = key;
+		entry.name = keyName.name.c_str();
+		entry.data.assign(data, data + size);
+		mMemoryMap[key] = mMemoryList.begin();
+		mMemorySize += size;
+
+		while (mMemorySize > mMemoryBudget)
+		{
+			MemoryEntry& oldEntry = mMemoryList.back();
+			mMemorySize -= oldEntry.data.size();
+			mMemoryMap.erase(oldEntry.key);
+			mMemoryList.pop_back();
+		}
+	}
+
+	void removeMemoryEntry(uint64 key)
+	{
+		auto iter = mMemoryMap.find(key);
+		if (iter == mMemoryMap.end())
+			return;
+		mMemorySize -= iter->second->data.size();
+		mMemoryList.erase(iter->second);
+		mMemoryMap.erase(iter);
+	}
+
+	void removeEntry(uint64 key, bool bRemoveMemory)
+	{
+		auto iter = mIndex.find(key);
+		if (iter != mIndex.end())
+		{
+			mLiveSize -= iter->second.getRecordSize();
+			mIndex.erase(iter);
+		}
+		if (bRemoveMemory)
+			removeMemoryEntry(key);
+	}
+
+	void evictDiskEntries()
+	{
+		if (mLiveSize > mDiskBudget)
+		{
+			TArray< PackIndexEntry > entries;
+			entries.reserve(mIndex.size());
+			for (auto const& pair : mIndex)
+				entries.push_back(pair.second);
+			std::sort(entries.begin(), entries.end(), [](PackIndexEntry const& lhs, PackIndexEntry const& rhs)
 			{
-				int a = 1;
+				return lhs.lastUse < rhs.lastUse;
+			});
+
+			//Leave room so the next saves don't evict again
+			uint64 targetSize = mDiskBudget - mDiskBudget / 4;
+			for (PackIndexEntry const& entry : entries)
+			{
+				if (mLiveSize <= targetSize)
+					break;
+				removeEntry(entry.key, true);
+				++mStats.numEvict;
 			}
-			return false;
+			mbIndexDirty = true;
+		}
+
+		//Overwritten and evicted records stay in the pack file until it is compacted
+		uint64 garbageSize = mPackSize - mLiveSize;
+		if (garbageSize > mDiskBudget / 2 && garbageSize > mLiveSize)
+		{
+			compactPackFile();
 		}
-		fs.close();
-		return true;
 	}
 
+	//Copy the live records to a new pack file
+	void compactPackFile()
+	{
+		InlineString<512> tempPath;
+		tempPath.format("%s.tmp", mPackPath.c_str());
+
+		TArray< PackIndexEntry* > entries;
+		entries.reserve(mIndex.size());
+		for (auto& pair : mIndex)
+			entries.push_back(&pair.second);
+		std::sort(entries.begin(), entries.end(), [](PackIndexEntry const* lhs, PackIndexEntry const* rhs)
+		{
+			return lhs->offset < rhs->offset;
+		});
+
+		{
+			std::ofstream fs(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+			if (!fs.is_open())
+				return;
 
-	bool loadDelegate(DataCacheKey const& key, SerializeDelegate inDelegate) override
+			uint64 offset = 0;
+			TArray< uint8 > recordData;
+			for (PackIndexEntry* entry : entries)
+			{
+				recordData.resize(entry->getRecordSize());
+				mPackFile.clear();
+				mPackFile.seekg(entry->offset);
+				mPackFile.read((char*)recordData.data(), recordData.size());
+				if (!mPackFile.good())
+				{
+					mPackFile.clear();
+					return;
+				}
+				fs.write((char const*)recordData.data(), recordData.size());
+				entry->offset = offset;
+				offset += recordData.size();
+			}
+			if (!fs.good())
+				return;
+			mPackSize = offset;
+		}
+
+		mPackFile.close();
+		FFileSystem::DeleteFile(mPackPath);
+		FFileSystem::RenameAndMoveFile(tempPath, mPackPath);
+		if (!openPackFile())
+		{
+			LogWarning(0, "DataCache : Can't open pack file %s", mPackPath.c_str());
+		}
+		mbIndexDirty = true;
+	}
+
+	struct MemoryEntry
 	{
-		if (isDataIgnored(key))
-			return false;
+		uint64 key;
+		std::string name;
+		TArray< uint8 > data;
+	};
+
+	Mutex          mMutex;
+	std::fstream   mPackFile;
+	InlineString<512> mPackPath;
+	InlineString<512> mIndexPath;
+
+	std::unordered_map< uint64, PackIndexEntry > mIndex;
+	uint64         mPackSize;
+	uint64         mLiveSize;
+	uint64         mDiskBudget;
+	uint32         mUseCounter;
+	bool           mbIndexDirty;
+
+	std::list< MemoryEntry > mMemoryList;
+	std::unordered_map< uint64, std::list< MemoryEntry >::iterator > mMemoryMap;
+	uint64         mMemorySize;
+	uint64         mMemoryBudget;
+
+	TArray< uint8 > mReadBuffer;
+	TArray< char >  mReadName;
+	DataCacheStats  mStats;
+};
+
+class DataCacheImpl : public DataCacheInterface
+{
+public:
+	DataCacheImpl(char const* dir, DataCacheSettings const& settings)
+		:mCacheDir( dir )
+		,mSettings( settings )
+	{
+		if (!FFileSystem::IsExist(dir))
+		{
+			FFileSystem::CreateDirectorySequence(dir);
+		}
+		for (int i = 0; i < NumCacheShard; ++i)
+		{
+			mShards[i].initialize(dir, i, settings);
+		}
+		if (settings.numIOThread > 0)
+		{
+			mThreadPool.init(settings.numIOThread);
+		}
+	}
+
+	~DataCacheImpl()
+	{
+		waitAsyncWorks();
+		for (int i = 0; i < NumCacheShard; ++i)
+		{
+			mShards[i].shutdown();
+		}
+	}
+
+	void getKeyName(DataCacheKey const& key, CacheKeyName& outKey)
+	{
+		outKey.length = outKey.name.format("%s_%s_%0llX", key.typeName, key.version, key.keySuffix.value);
+		outKey.hash = FNV1a::MakeStringHash<uint64>(outKey.name.c_str());
+		outKey.nameHash = HashValue(outKey.name.data(), outKey.length);
+	}
+
+	DataCacheShard& getShard(uint64 hash) { return mShards[hash % NumCacheShard]; }
+
+	//Files of the cache before the pack files , they are imported on the first load
+	void getLegacyFilePath(CacheKeyName const& key, InlineString<512>& outPath)
+	{
+		uint32 nameHash = key.nameHash;
+		outPath.format("%s/%d/%d/%d/%s.ddc", mCacheDir.c_str(), nameHash % 10, (nameHash / 10) % 10, (nameHash / 100) % 10, key.name.c_str());
+	}
+
+	bool saveInternal(CacheKeyName const& key, uint8 const* data, uint32 size)
+	{
+		uint8 const* storedData = data;
+		uint32 storedSize = size;
+		uint32 flags = 0;
+
+		TArray< uint8 > compressedData;
+		if (mSettings.bCompress && size > 64)
+		{
+			compressedData.resize(FLZCompress::GetMaxCompressedSize(size));
+			size_t compressedSize = FLZCompress::Compress(data, size, compressedData.data(), compressedData.size());
+			//Keep the raw data when it doesn't compress
+			if (compressedSize && compressedSize < size - size / 16)
+			{
+				storedData = compressedData.data();
+				storedSize = (uint32)compressedSize;
+				flags |= PRF_Compressed;
+			}
+		}
+
+		return getShard(key.hash).save(key, data, size, storedData, storedSize, flags);
+	}
+
+	bool loadInternal(CacheKeyName const& key, TArray< uint8 >& outData)
+	{
+		if (getShard(key.hash).load(key, outData))
+			return true;
 
 		InlineString<512> filePath;
-		getFilePath(key, filePath);
-		if( !FFileSystem::IsExist(filePath) )
+		getLegacyFilePath(key, filePath);
+		if (!FFileSystem::IsExist(filePath))
 			return false;
 
 		InputFileSerializer fs;
-		if( !fs.open(filePath) )
-		{
+		if (!fs.open(filePath, false))
 			return false;
-		}
 
-		if( !inDelegate(fs) )
+		outData.resize(fs.getSize());
+		if (!outData.empty())
+			fs.read(outData.data(), outData.size());
+		if (!fs.isValid())
+			return false;
+
+		saveInternal(key, outData.data(), (uint32)outData.size());
+		return true;
+	}
+
+	bool save(DataCacheKey const& key, TArrayView<uint8> saveData) override
+	{
+		if (isDataIgnored(key))
+			return true;
+
+		CacheKeyName keyName;
+		getKeyName(key, keyName);
+		return saveInternal(keyName, saveData.data(), (uint32)saveData.size());
+	}
+
+	bool saveDelegate(DataCacheKey const& key, SerializeDelegate inDelegate) override
+	{
+		if (isDataIgnored(key))
+			return true;
+
+		TArray< uint8 > saveData;
 		{
+			auto serializer = CreateBufferSerializer< ArrayWriteBuffer >(saveData);
+			if (!inDelegate(serializer))
+				return false;
+		}
+
+		CacheKeyName keyName;
+		getKeyName(key, keyName);
+		return saveInternal(keyName, saveData.data(), (uint32)saveData.size());
+	}
+
+	bool loadDelegate(DataCacheKey const& key, SerializeDelegate inDelegate) override
+	{
+		if (isDataIgnored(key))
 			return false;
+
+		CacheKeyName keyName;
+		getKeyName(key, keyName);
+
+		TArray< uint8 > loadData;
+		if (!loadInternal(keyName, loadData))
+			return false;
+
+		TStreamBuffer< ThrowCheckPolicy > buffer((char*)loadData.data(), loadData.size());
+		buffer.setFillSize(loadData.size());
+		try
+		{
+			auto serializer = CreateSerializer(buffer);
+			return inDelegate(serializer);
 		}
-		if( !fs.isValid() )
+		catch (BufferException&)
 		{
 			return false;
 		}
-		fs.close();
-		return true;
 	}
 
 	bool load(DataCacheKey const& key, TArray<uint8>& outBuffer) override
@@ -147,29 +727,72 @@ public:
 		if (isDataIgnored(key))
 			return true;
 
-		InlineString<512> filePath;
-		getFilePath(key, filePath);
-		if( !FFileSystem::IsExist(filePath) )
-			return false;
+		CacheKeyName keyName;
+		getKeyName(key, keyName);
+		return loadInternal(keyName, outBuffer);
+	}
 
-		InputFileSerializer fs;
-		if( !fs.open(filePath, false) )
+	void loadAsync(DataCacheKey const& key, DataCacheLoadCallback callback) override
+	{
+		TArray< uint8 > loadData;
+		if (isDataIgnored(key))
 		{
-			return false;
+			callback(false, loadData);
+			return;
 		}
 
-		size_t fileSize = fs.getSize();
-		if( fileSize )
+		CacheKeyName keyName;
+		getKeyName(key, keyName);
+		if (mSettings.numIOThread <= 0)
 		{
-			outBuffer.resize(fileSize);
-			fs.read(outBuffer.data(), fileSize);
+			bool bSuccess = loadInternal(keyName, loadData);
+			callback(bSuccess, loadData);
+			return;
 		}
 
-		if( !fs.isValid() )
+		mThreadPool.addFunctionWork(mAsyncGroup, [this, keyName, callback = std::move(callback)]()
 		{
-			return false;
+			TArray< uint8 > loadData;
+			bool bSuccess = loadInternal(keyName, loadData);
+			callback(bSuccess, loadData);
+		});
+	}
+
+	void saveAsync(DataCacheKey const& key, TArray< uint8 >&& saveData) override
+	{
+		if (isDataIgnored(key))
+			return;
+
+		CacheKeyName keyName;
+		getKeyName(key, keyName);
+		if (mSettings.numIOThread <= 0)
+		{
+			saveInternal(keyName, saveData.data(), (uint32)saveData.size());
+			return;
+		}
+
+		mThreadPool.addFunctionWork(mAsyncGroup, [this, keyName, data = std::move(saveData)]()
+		{
+			saveInternal(keyName, data.data(), (uint32)data.size());
+		});
+	}
+
+	void waitAsyncWorks() override
+	{
+		if (mSettings.numIOThread > 0)
+		{
+			mThreadPool.waitWorkGroup(mAsyncGroup);
 		}
-		return true;
+	}
+
+	DataCacheStats getStats() override
+	{
+		DataCacheStats stats;
+		for (int i = 0; i < NumCacheShard; ++i)
+		{
+			mShards[i].getStats(stats);
+		}
+		return stats;
 	}
 
 	DataCacheHandle find(DataCacheKey const& key) override
@@ -177,7 +800,6 @@ public:
 		return ERROR_DATA_CACHE_HANDLE;
 	}
 
-
 	void ignoreDataType(char const* typeName) override
 	{
 		mIgnoreTypeNameSet.insert(typeName);
@@ -193,12 +815,16 @@ public:
 		delete this;
 	}
 
-	std::string mCacheDir;
+	std::string       mCacheDir;
+	DataCacheSettings mSettings;
 	std::unordered_set< HashString > mIgnoreTypeNameSet;
 
+	DataCacheShard    mShards[NumCacheShard];
+	QueueThreadPool   mThreadPool;
+	QueuedWorkGroup   mAsyncGroup;
 };
 
-DataCacheInterface* DataCacheInterface::Create(char const* dir)
+DataCacheInterface* DataCacheInterface::Create(char const* dir, DataCacheSettings const& settings)
 {
-	return new DataCacheImpl(dir);
+	return new DataCacheImpl(dir, settings);
 }
@@ -88,10 +88,36 @@ using DataCacheHandle = uint32;
 
 #define ERROR_DATA_CACHE_HANDLE DataCacheHandle(-1)
 
+struct DataCacheSettings
+{
+	//Decompressed data of the recently used entries
+	uint64 memoryBudget = 64ull << 20;
+	//The least recently used entries are evicted when the stored data grows over it
+	uint64 diskBudget = 1ull << 30;
+	int    numIOThread = 2;
+	bool   bCompress = true;
+};
+
+struct DataCacheStats
+{
+	uint64 numMemoryHit = 0;
+	uint64 numDiskHit = 0;
+	uint64 numMiss = 0;
+	uint64 numSave = 0;
+	uint64 numEvict = 0;
+	uint64 memorySize = 0;
+	uint64 diskSize = 0;
+	uint64 rawSize = 0;
+	uint64 storedSize = 0;
+};
+
+//Called on an IO thread
+using DataCacheLoadCallback = std::function< void (bool bSuccess, TArray< uint8 >& data) >;
+
 class DataCacheInterface
 {
 public:
-	static DataCacheInterface* Create( char const* dir );
+	static DataCacheInterface* Create( char const* dir , DataCacheSettings const& settings = DataCacheSettings() );
 
 	virtual ~DataCacheInterface() {}
 	virtual bool save(DataCacheKey const& key, TArrayView< uint8 > saveData) = 0;
@@ -100,6 +126,11 @@ public:
 	virtual bool loadDelegate(DataCacheKey const& key, SerializeDelegate inDelegate) = 0;
 	virtual void ignoreDataType(char const* typeName) = 0;
 
+	virtual void loadAsync(DataCacheKey const& key, DataCacheLoadCallback callback) = 0;
+	virtual void saveAsync(DataCacheKey const& key, TArray< uint8 >&& saveData) = 0;
+	virtual void waitAsyncWorks() = 0;
+	virtual DataCacheStats getStats() = 0;
+
 	virtual DataCacheHandle find(DataCacheKey const& key) = 0;
 	virtual void release() = 0;
 
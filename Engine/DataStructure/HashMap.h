@@ -3,57 +3,666 @@
 #define HashMap_H_6B89800E_5677_46BF_9058_F923AFFE8A74
 
 #include "Core/IntegerType.h"
+#include "Core/TypeHash.h"
+#include "DataStructure/Array.h"
+#include "BitUtility.h"
 
-typedef uint32 HashValueType;
+#include <utility>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <functional>
 
-template< class T >
-HashValueType GetHashValue();
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define HASH_MAP_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define HASH_MAP_USE_SSE2 0
+#endif
 
-template< class KT , class VT >
-class MapValue
+// Open addressing flat hash table ( SwissTable layout ).
+// Every slot has one control byte : empty / deleted or the low 7 bits of the hash ,
+// lookup matches a group of 16 control bytes at once before touching the slots.
+// Elements move when the table rehash , don't keep pointers to them across insert.
+
+struct DefaultHasher
 {
-	KT key;
-	VT value;
+	template< class T >
+	uint64 operator()(T const& value) const
+	{
+		//HashValue truncates to 32 bits , keep the high bits of 64 bit keys
+		if constexpr (std::is_arithmetic_v< T > || std::is_enum_v< T > || std::is_pointer_v< T >)
+			return uint64(std::hash< T >()(value));
+		else
+			return HashValue(value);
+	}
 };
 
-template< class KT , class VT >
-class THashMap
+struct DefaultKeyEqual
+{
+	template< class A, class B >
+	bool operator()(A const& a, B const& b) const { return a == b; }
+};
+
+namespace HashMapDetail
+{
+	using CtrlType = int8;
+	enum : CtrlType
+	{
+		Ctrl_Empty   = -128,
+		Ctrl_Deleted = -2,
+	};
+
+	constexpr int GroupWidth = 16;
+
+	FORCEINLINE bool IsFull(CtrlType ctrl) { return ctrl >= 0; }
+
+	FORCEINLINE uint64 MixHash(uint64 hash)
+	{
+		uint64 result = (hash ^ (hash >> 32)) * 0x9E3779B97F4A7C15ull;
+		return result ^ (result >> 32);
+	}
+	FORCEINLINE uint64   H1(uint64 hash) { return hash >> 7; }
+	FORCEINLINE CtrlType H2(uint64 hash) { return CtrlType(hash & 0x7f); }
+
+	struct BitMask
+	{
+		uint32 mask;
+		explicit operator bool() const { return mask != 0; }
+		int  lowestIndex() const { return FBitUtility::CountTrailingZeros(mask); }
+		void clearLowest() { mask &= mask - 1; }
+	};
+
+	struct Group
+	{
+#if HASH_MAP_USE_SSE2
+		explicit Group(CtrlType const* pos) { ctrl = _mm_loadu_si128((__m128i const*)pos); }
+
+		BitMask match(CtrlType h2) const
+		{
+			return BitMask{ (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)) };
+		}
+		BitMask matchEmpty() const
+		{
+			return BitMask{ (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(Ctrl_Empty), ctrl)) };
+		}
+		BitMask matchEmptyOrDeleted() const
+		{
+			//Empty and Deleted are the only values less than -1
+			return BitMask{ (uint32)_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl)) };
+		}
+		__m128i ctrl;
+#else
+		explicit Group(CtrlType const* pos) :ctrl(pos) {}
+
+		template< class TFunc >
+		BitMask matchIf(TFunc&& func) const
+		{
+			uint32 mask = 0;
+			for (int i = 0; i < GroupWidth; ++i)
+			{
+				if (func(ctrl[i]))
+					mask |= 1u << i;
+			}
+			return BitMask{ mask };
+		}
+		BitMask match(CtrlType h2) const { return matchIf([h2](CtrlType c) { return c == h2; }); }
+		BitMask matchEmpty() const { return matchIf([](CtrlType c) { return c == Ctrl_Empty; }); }
+		BitMask matchEmptyOrDeleted() const { return matchIf([](CtrlType c) { return c < -1; }); }
+		CtrlType const* ctrl;
+#endif
+	};
+
+	template< class T, class = void >
+	struct TIsTransparent { static constexpr bool Value = false; };
+	template< class T >
+	struct TIsTransparent< T, std::void_t< typename T::is_transparent > > { static constexpr bool Value = true; };
+
+	template< class KT >
+	struct TSetPolicy
+	{
+		using KeyType = KT;
+		using ValueType = KT;
+		static KT const& GetKey(ValueType const& value) { return value; }
+	};
+
+	template< class KT, class VT >
+	struct TMapPolicy
+	{
+		using KeyType = KT;
+		using ValueType = std::pair< KT, VT >;
+		static KT const& GetKey(ValueType const& value) { return value.first; }
+	};
+}
+
+template< class Policy, class Hasher, class KeyEqual, class Allocator >
+class THashTableBase
 {
 public:
-	typedef MapValue<KT, VT> ValueType;
+	using KeyType = typename Policy::KeyType;
+	using ValueType = typename Policy::ValueType;
+	using CtrlType = HashMapDetail::CtrlType;
+
+	template< class TValue >
+	class TIterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = TValue;
+		using difference_type = ptrdiff_t;
+		using pointer = TValue*;
+		using reference = TValue&;
+
+		TIterator() :mCtrl(nullptr), mSlot(nullptr), mEnd(nullptr) {}
+		TIterator(CtrlType const* ctrl, TValue* slot, CtrlType const* end)
+			:mCtrl(ctrl), mSlot(slot), mEnd(end)
+		{
+			skipEmpty();
+		}
+		template< class UValue >
+		TIterator(TIterator<UValue> const& other) :mCtrl(other.mCtrl), mSlot(other.mSlot), mEnd(other.mEnd) {}
+
+		TValue& operator*() const { return *mSlot; }
+		TValue* operator->() const { return mSlot; }
+		TIterator& operator++() { ++mCtrl; ++mSlot; skipEmpty(); return *this; }
+		TIterator  operator++(int) { TIterator temp = *this; ++(*this); return temp; }
+		bool operator == (TIterator const& rhs) const { return mCtrl == rhs.mCtrl; }
+		bool operator != (TIterator const& rhs) const { return mCtrl != rhs.mCtrl; }
+
+	private:
+		void skipEmpty()
+		{
+			while (mCtrl != mEnd && !HashMapDetail::IsFull(*mCtrl))
+			{
+				++mCtrl;
+				++mSlot;
+			}
+		}
+		template< class UValue >
+		friend class TIterator;
+		friend class THashTableBase;
+		CtrlType const* mCtrl;
+		TValue*         mSlot;
+		CtrlType const* mEnd;
+	};
 
-	ValueType** mHashTable;
-	int mTableSize;
+	using iterator = TIterator< ValueType >;
+	using const_iterator = TIterator< ValueType const >;
 
-	void insert(KT const& key, VT const& value)
+	THashTableBase()
+		:mSize(0), mCapacity(0), mGrowthLeft(0)
 	{
-		HashValueType hashValue = GetHashValue(key);
+	}
 
-		HashValueType index = ( hashValue % mTableSize );
+	THashTableBase(THashTableBase const& rhs)
+		:THashTableBase()
+	{
+		reserve(rhs.mSize);
+		for (auto const& value : rhs)
+		{
+			insertUnique(hashKey(Policy::GetKey(value)), value);
+		}
+	}
 
-		if( mHashTable[index] == nullptr )
+	THashTableBase(THashTableBase&& rhs)
+		:THashTableBase()
+	{
+		swap(rhs);
+	}
+
+	~THashTableBase()
+	{
+		destroyElements();
+	}
+
+	THashTableBase& operator = (THashTableBase const& rhs)
+	{
+		if (this != &rhs)
 		{
+			THashTableBase temp(rhs);
+			swap(temp);
+		}
+		return *this;
+	}
+
+	THashTableBase& operator = (THashTableBase&& rhs)
+	{
+		THashTableBase temp(std::move(rhs));
+		swap(temp);
+		return *this;
+	}
+
+	void swap(THashTableBase& other)
+	{
+		using std::swap;
+		mCtrls.swap(other.mCtrls);
+		mSlots.swap(other.mSlots);
+		swap(mSize, other.mSize);
+		swap(mCapacity, other.mCapacity);
+		swap(mGrowthLeft, other.mGrowthLeft);
+	}
+
+	iterator       begin()       { return iterator(getCtrls(), getSlots(), getCtrls() + mCapacity); }
+	iterator       end()         { return iterator(getCtrls() + mCapacity, getSlots() + mCapacity, getCtrls() + mCapacity); }
+	const_iterator begin() const { return const_iterator(getCtrls(), getSlots(), getCtrls() + mCapacity); }
+	const_iterator end()   const { return const_iterator(getCtrls() + mCapacity, getSlots() + mCapacity, getCtrls() + mCapacity); }
 
+	size_t size() const { return mSize; }
+	bool   empty() const { return mSize == 0; }
+	size_t capacity() const { return mCapacity; }
+	float  load_factor() const { return mCapacity ? float(mSize) / mCapacity : 0.0f; }
 
+	void clear()
+	{
+		destroyElements();
+		if (mCapacity)
+		{
+			resetCtrls();
 		}
+		mSize = 0;
+	}
 
-		while( mHashTable[index] )
+	//make sure count elements can be inserted without rehash
+	void reserve(size_t count)
+	{
+		if (count > mSize + mGrowthLeft)
 		{
-			if( equal(mHashTable[index]->key, key) )
+			rehash(count);
+		}
+	}
+
+	//rebuild table with at least count capacity , drop all deleted slots
+	void rehash(size_t count)
+	{
+		size_t minCapacity = CapacityForCount(count > mSize ? count : mSize);
+		if (minCapacity == 0)
+		{
+			if (mSize == 0)
 			{
+				destroyElements();
+				mCtrls.cleanup();
+				mSlots.cleanup();
+				mCapacity = 0;
+				mGrowthLeft = 0;
+			}
+			return;
+		}
+		resize(minCapacity);
+	}
+
+	template< class K >
+	iterator find(K const& key)
+	{
+		size_t index = findLookup(key);
+		return index == IndexNotFound ? end() : makeIterator(index);
+	}
+
+	template< class K >
+	const_iterator find(K const& key) const
+	{
+		size_t index = findLookup(key);
+		return index == IndexNotFound ? end() : const_iterator(getCtrls() + index, getSlots() + index, getCtrls() + mCapacity);
+	}
 
-				return false;
+	template< class K >
+	bool contains(K const& key) const
+	{
+		return findLookup(key) != IndexNotFound;
+	}
+
+	template< class K >
+	size_t count(K const& key) const { return contains(key) ? 1 : 0; }
+
+	template< class K >
+	size_t erase(K const& key)
+	{
+		size_t index = findLookup(key);
+		if (index == IndexNotFound)
+			return 0;
+		eraseAt(index);
+		return 1;
+	}
+
+	iterator erase(const_iterator it)
+	{
+		size_t index = it.mCtrl - getCtrls();
+		eraseAt(index);
+		return makeIterator(index + 1);
+	}
+
+	iterator erase(iterator it)
+	{
+		return erase(const_iterator(it));
+	}
+
+protected:
+
+	static constexpr size_t IndexNotFound = size_t(-1);
+
+	template< class K >
+	uint64 hashKey(K const& key) const { return HashMapDetail::MixHash(Hasher()(key)); }
+
+	// Other key types are converted to KeyType first unless the hasher declares is_transparent ,
+	// so they can't get a different hash value from the stored key
+	template< class K >
+	size_t findLookup(K const& key) const
+	{
+		if constexpr (HashMapDetail::TIsTransparent< Hasher >::Value || std::is_same_v< K, KeyType >)
+		{
+			return findIndex(key, hashKey(key));
+		}
+		else
+		{
+			KeyType const& lookupKey = key;
+			return findIndex(lookupKey, hashKey(lookupKey));
+		}
+	}
+
+	CtrlType*  getCtrls() const { return mCtrls.getAllocation(); }
+	ValueType* getSlots() const { return (ValueType*)mSlots.getAllocation(); }
+
+	iterator makeIterator(size_t index)
+	{
+		return iterator(getCtrls() + index, getSlots() + index, getCtrls() + mCapacity);
+	}
+
+	// 7/8 max load factor
+	static size_t GrowthForCapacity(size_t capacity) { return capacity - capacity / 8; }
+	static size_t CapacityForCount(size_t count)
+	{
+		if (count == 0)
+			return 0;
+		size_t capacity = HashMapDetail::GroupWidth;
+		while (GrowthForCapacity(capacity) < count)
+			capacity *= 2;
+		return capacity;
+	}
+
+	void setCtrl(size_t index, CtrlType value)
+	{
+		CtrlType* ctrls = getCtrls();
+		ctrls[index] = value;
+		// Mirror the first group after the end, so group load at the table end doesn't need wrap
+		if (index < HashMapDetail::GroupWidth)
+			ctrls[mCapacity + index] = value;
+	}
+
+	void resetCtrls()
+	{
+		FMemory::Set(getCtrls(), HashMapDetail::Ctrl_Empty, mCapacity + HashMapDetail::GroupWidth);
+		mGrowthLeft = GrowthForCapacity(mCapacity);
+	}
+
+	template< class K >
+	size_t findIndex(K const& key, uint64 hash) const
+	{
+		if (mCapacity == 0)
+			return IndexNotFound;
+
+		using namespace HashMapDetail;
+		size_t const mask = mCapacity - 1;
+		CtrlType const h2 = H2(hash);
+		size_t pos = H1(hash) & mask;
+		size_t step = 0;
+		KeyEqual equal;
+		ValueType const* slots = getSlots();
+		while (true)
+		{
+			Group group(getCtrls() + pos);
+			for (BitMask match = group.match(h2); match; match.clearLowest())
+			{
+				size_t index = (pos + match.lowestIndex()) & mask;
+				if (equal(Policy::GetKey(slots[index]), key))
+					return index;
+			}
+			if (group.matchEmpty())
+				return IndexNotFound;
+
+			step += GroupWidth;
+			if (step > mCapacity)
+				return IndexNotFound;
+			pos = (pos + step) & mask;
+		}
+	}
+
+	size_t findInsertIndex(uint64 hash) const
+	{
+		using namespace HashMapDetail;
+		size_t const mask = mCapacity - 1;
+		size_t pos = H1(hash) & mask;
+		size_t step = 0;
+		while (true)
+		{
+			Group group(getCtrls() + pos);
+			BitMask match = group.matchEmptyOrDeleted();
+			if (match)
+				return (pos + match.lowestIndex()) & mask;
+
+			step += GroupWidth;
+			pos = (pos + step) & mask;
+		}
+	}
+
+	// Insert a key known to be not in the table
+	template< class ...TArgs >
+	size_t insertUnique(uint64 hash, TArgs&& ...args)
+	{
+		size_t index = (mCapacity == 0) ? IndexNotFound : findInsertIndex(hash);
+		if (index == IndexNotFound || (mGrowthLeft == 0 && getCtrls()[index] == HashMapDetail::Ctrl_Empty))
+		{
+			// Grow only when the live elements are the reason of the table full, otherwise drop deleted slots
+			size_t newCapacity = mCapacity == 0 ? HashMapDetail::GroupWidth :
+				(mSize + 1 > GrowthForCapacity(mCapacity) / 2 ? 2 * mCapacity : mCapacity);
+			resize(newCapacity);
+			index = findInsertIndex(hash);
+		}
+
+		if (getCtrls()[index] == HashMapDetail::Ctrl_Empty)
+			--mGrowthLeft;
+		FTypeMemoryOp::Construct(getSlots() + index, std::forward<TArgs>(args)...);
+		setCtrl(index, HashMapDetail::H2(hash));
+		++mSize;
+		return index;
+	}
+
+	void eraseAt(size_t index)
+	{
+		using namespace HashMapDetail;
+		FTypeMemoryOp::Destruct(getSlots() + index);
+		--mSize;
+
+		// The slot can turn back to empty if no probe sequence ever passed a full group around it
+		size_t const mask = mCapacity - 1;
+		size_t indexBefore = (index - GroupWidth) & mask;
+		BitMask emptyAfter = Group(getCtrls() + index).matchEmpty();
+		BitMask emptyBefore = Group(getCtrls() + indexBefore).matchEmpty();
+		bool bWasNeverFull = emptyBefore && emptyAfter &&
+			FBitUtility::CountTrailingZeros(emptyAfter.mask) + CountLeadingZeros16(emptyBefore.mask) < GroupWidth;
+
+		setCtrl(index, bWasNeverFull ? Ctrl_Empty : Ctrl_Deleted);
+		if (bWasNeverFull)
+			++mGrowthLeft;
+	}
+
+	static int CountLeadingZeros16(uint32 mask)
+	{
+		int count = 0;
+		for (uint32 bit = 1u << (HashMapDetail::GroupWidth - 1); bit && !(mask & bit); bit >>= 1)
+			++count;
+		return count;
+	}
+
+	void resize(size_t newCapacity)
+	{
+		using CtrlData = typename Allocator::template TArrayData< CtrlType >;
+		using SlotData = typename Allocator::template TArrayData< TCompatibleByte< ValueType > >;
+
+		CtrlData oldCtrls;
+		SlotData oldSlots;
+		oldCtrls.swap(mCtrls);
+		oldSlots.swap(mSlots);
+		size_t oldCapacity = mCapacity;
+
+		mCapacity = newCapacity;
+		mCtrls.grow(0, mCapacity + HashMapDetail::GroupWidth);
+		mSlots.grow(0, mCapacity);
+		resetCtrls();
+
+		CtrlType const* ctrls = oldCtrls.getAllocation();
+		ValueType* slots = (ValueType*)oldSlots.getAllocation();
+		for (size_t i = 0; i < oldCapacity; ++i)
+		{
+			if (HashMapDetail::IsFull(ctrls[i]))
+			{
+				uint64 hash = hashKey(Policy::GetKey(slots[i]));
+				size_t index = findInsertIndex(hash);
+				FTypeMemoryOp::Construct(getSlots() + index, std::move(slots[i]));
+				FTypeMemoryOp::Destruct(slots + i);
+				setCtrl(index, HashMapDetail::H2(hash));
+				--mGrowthLeft;
 			}
 		}
+	}
+
+	void destroyElements()
+	{
+		if (std::is_trivially_destructible_v< ValueType > || mSize == 0)
+			return;
+
+		CtrlType const* ctrls = getCtrls();
+		ValueType* slots = getSlots();
+		for (size_t i = 0; i < mCapacity; ++i)
+		{
+			if (HashMapDetail::IsFull(ctrls[i]))
+				FTypeMemoryOp::Destruct(slots + i);
+		}
+	}
+
+	typename Allocator::template TArrayData< CtrlType > mCtrls;
+	typename Allocator::template TArrayData< TCompatibleByte< ValueType > > mSlots;
+	size_t mSize;
+	size_t mCapacity;
+	size_t mGrowthLeft;
+};
+
+
+template< class KT, class VT, class Hasher = DefaultHasher, class KeyEqual = DefaultKeyEqual, class Allocator = DefaultAllocator >
+class THashMap : public THashTableBase< HashMapDetail::TMapPolicy< KT, VT >, Hasher, KeyEqual, Allocator >
+{
+	using BaseClass = THashTableBase< HashMapDetail::TMapPolicy< KT, VT >, Hasher, KeyEqual, Allocator >;
+public:
+	using iterator = typename BaseClass::iterator;
+	using const_iterator = typename BaseClass::const_iterator;
+	using ValueType = typename BaseClass::ValueType;
 
+	THashMap() = default;
+	THashMap(std::initializer_list< ValueType > values)
+	{
+		this->reserve(values.size());
+		for (auto const& value : values)
+			insert(value.first, value.second);
+	}
 
+	template< class ...TArgs >
+	std::pair< iterator, bool > tryEmplace(KT const& key, TArgs&& ...args)
+	{
+		return tryEmplaceImpl(key, std::forward<TArgs>(args)...);
 	}
 
-	bool equal(KT const& k1, KT const& k2)
+	template< class ...TArgs >
+	std::pair< iterator, bool > tryEmplace(KT&& key, TArgs&& ...args)
 	{
+		return tryEmplaceImpl(std::move(key), std::forward<TArgs>(args)...);
+	}
 
+	template< class V >
+	std::pair< iterator, bool > insert(KT const& key, V&& value)
+	{
+		return tryEmplace(key, std::forward<V>(value));
+	}
+
+	template< class V >
+	std::pair< iterator, bool > insert(KT&& key, V&& value)
+	{
+		return tryEmplace(std::move(key), std::forward<V>(value));
+	}
+
+	std::pair< iterator, bool > insert(ValueType const& value)
+	{
+		return tryEmplace(value.first, value.second);
 	}
 
+	template< class V >
+	std::pair< iterator, bool > insertOrAssign(KT const& key, V&& value)
+	{
+		auto result = tryEmplace(key, std::forward<V>(value));
+		if (!result.second)
+			result.first->second = std::forward<V>(value);
+		return result;
+	}
+
+	VT& operator[](KT const& key) { return tryEmplace(key).first->second; }
+	VT& operator[](KT&& key) { return tryEmplace(std::move(key)).first->second; }
+
+	template< class K >
+	VT* findValue(K const& key)
+	{
+		size_t index = this->findLookup(key);
+		return index == BaseClass::IndexNotFound ? nullptr : &this->getSlots()[index].second;
+	}
+
+	template< class K >
+	VT const* findValue(K const& key) const
+	{
+		size_t index = this->findLookup(key);
+		return index == BaseClass::IndexNotFound ? nullptr : &this->getSlots()[index].second;
+	}
+
+private:
+	template< class K, class ...TArgs >
+	std::pair< iterator, bool > tryEmplaceImpl(K&& key, TArgs&& ...args)
+	{
+		uint64 hash = this->hashKey(key);
+		size_t index = this->findIndex(key, hash);
+		if (index != BaseClass::IndexNotFound)
+			return { this->makeIterator(index), false };
+
+		index = this->insertUnique(hash, std::piecewise_construct,
+			std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<TArgs>(args)...));
+		return { this->makeIterator(index), true };
+	}
+};
+
+template< class KT, class Hasher = DefaultHasher, class KeyEqual = DefaultKeyEqual, class Allocator = DefaultAllocator >
+class THashSet : public THashTableBase< HashMapDetail::TSetPolicy< KT >, Hasher, KeyEqual, Allocator >
+{
+	using BaseClass = THashTableBase< HashMapDetail::TSetPolicy< KT >, Hasher, KeyEqual, Allocator >;
+public:
+	using iterator = typename BaseClass::iterator;
+
+	THashSet() = default;
+	THashSet(std::initializer_list< KT > values)
+	{
+		this->reserve(values.size());
+		for (auto const& value : values)
+			insert(value);
+	}
+
+	std::pair< iterator, bool > insert(KT const& key) { return insertImpl(key); }
+	std::pair< iterator, bool > insert(KT&& key) { return insertImpl(std::move(key)); }
+
+private:
+	template< class K >
+	std::pair< iterator, bool > insertImpl(K&& key)
+	{
+		uint64 hash = this->hashKey(key);
+		size_t index = this->findIndex(key, hash);
+		if (index != BaseClass::IndexNotFound)
+			return { this->makeIterator(index), false };
+
+		index = this->insertUnique(hash, std::forward<K>(key));
+		return { this->makeIterator(index), true };
+	}
 };
 
-#endif // HashMap_H_6B89800E_5677_46BF_9058_F923AFFE8A74
\ No newline at end of file
+#endif // HashMap_H_6B89800E_5677_46BF_9058_F923AFFE8A74
@@ -797,6 +797,70 @@ bool FFileUtility::LoadToString(char const* path, std::string& outString)
 	return true;
 }
 
+bool MappedFileView::open(char const* path)
+{
+	close();
+#if SYS_PLATFORM_WIN
+	mhFile = FWinApi::CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (mhFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(mhFile, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	mhMapping = ::CreateFileMappingA(mhFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mhMapping == NULL)
+	{
+		close();
+		return false;
+	}
+
+	mData = (uint8 const*)::MapViewOfFile(mhMapping, FILE_MAP_READ, 0, 0, 0);
+	if (mData == nullptr)
+	{
+		close();
+		return false;
+	}
+	mSize = (size_t)fileSize.QuadPart;
+	return true;
+#else
+	if (!FFileUtility::LoadToBuffer(path, mBuffer) || mBuffer.empty())
+		return false;
+
+	mData = mBuffer.data();
+	mSize = mBuffer.size();
+	return true;
+#endif
+}
+
+void MappedFileView::close()
+{
+#if SYS_PLATFORM_WIN
+	if (mData)
+	{
+		::UnmapViewOfFile(mData);
+	}
+	if (mhMapping != NULL)
+	{
+		::CloseHandle(mhMapping);
+		mhMapping = NULL;
+	}
+	if (mhFile != INVALID_HANDLE_VALUE)
+	{
+		::CloseHandle(mhFile);
+		mhFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	mBuffer.clear();
+#endif
+	mData = nullptr;
+	mSize = 0;
+}
+
 template class TFileUtility<char>;
 template class TFileUtility<wchar_t>;
 template class TFileIterator<char>;
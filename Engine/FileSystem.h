@@ -165,6 +165,32 @@ public:
 	static bool OverwriteFile(char const* srcPath, char const* destPath, uint64 num, uint64 offset = 0);
 };
 
+// Read only view of a whole file mapped in memory , the data is valid until close.
+// Platforms without file mapping load the file to a buffer.
+class MappedFileView : public Noncopyable
+{
+public:
+	MappedFileView() = default;
+	~MappedFileView() { close(); }
+
+	bool  open(char const* path);
+	void  close();
+
+	bool         isOpen() const { return mData != nullptr; }
+	uint8 const* getData() const { return mData; }
+	size_t       getSize() const { return mSize; }
+
+private:
+#if SYS_PLATFORM_WIN
+	HANDLE mhFile = INVALID_HANDLE_VALUE;
+	HANDLE mhMapping = NULL;
+#else
+	TArray< uint8 > mBuffer;
+#endif
+	uint8 const* mData = nullptr;
+	size_t       mSize = 0;
+};
+
 
 
 
@@ -1,5 +1,7 @@
 #include "EntityManager.h"
 #include "Math/Base.h"
+#include "Core/Memory.h"
+#include "BitUtility.h"
 
 #include "MacroCommon.h"
 #include "CoreShare.h"
@@ -50,6 +52,281 @@ namespace ECS
 	}
 #endif
 
+	EntityArchetype::EntityArchetype(TArray< ComponentType* > const& sortedTypes)
+		:mTypes(sortedTypes)
+		,mNumEntity(0)
+	{
+		uint32 entitySize = sizeof(EntityHandle);
+		uint32 alignPadding = 0;
+		for (ComponentType* type : mTypes)
+		{
+			entitySize += type->mSize;
+			alignPadding += type->mAlignment;
+		}
+
+		mChunkDataSize = ChunkDataSize;
+		mChunkCapacity = (mChunkDataSize - alignPadding) / entitySize;
+		if (mChunkCapacity < 1)
+		{
+			//big component , one entity per chunk
+			mChunkCapacity = 1;
+			mChunkDataSize = entitySize + alignPadding;
+		}
+
+		uint32 offset = sizeof(EntityHandle) * mChunkCapacity;
+		mColumnOffsets.resize(mTypes.size());
+		for (int column = 0; column < mTypes.size(); ++column)
+		{
+			ComponentType* type = mTypes[column];
+			offset = AlignArbitrary(offset, type->mAlignment);
+			mColumnOffsets[column] = offset;
+			offset += type->mSize * mChunkCapacity;
+		}
+		CHECK(offset <= mChunkDataSize);
+	}
+
+	EntityArchetype::~EntityArchetype()
+	{
+		while (!mChunks.empty())
+		{
+			freeLastChunk();
+		}
+	}
+
+	int EntityArchetype::findColumn(ComponentType* type) const
+	{
+		int low = 0;
+		int high = mTypes.size();
+		while (low < high)
+		{
+			int mid = (low + high) / 2;
+			if (mTypes[mid]->mID < type->mID)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+		if (low < mTypes.size() && mTypes[low] == type)
+			return low;
+		return INDEX_NONE;
+	}
+
+	EntityArchetype::Chunk* EntityArchetype::allocChunk()
+	{
+		// Header and column data in one block , data start at cache line boundary
+		uint8* block = (uint8*)FMemory::Alloc(sizeof(Chunk) + ChunkAlignment + mChunkDataSize);
+		Chunk* chunk = new (block) Chunk;
+		chunk->archetype = this;
+		chunk->data = (uint8*)AlignArbitrary<intptr_t>(intptr_t(block + sizeof(Chunk)), ChunkAlignment);
+		chunk->numEntity = 0;
+		mChunks.push_back(chunk);
+		return chunk;
+	}
+
+	void EntityArchetype::freeLastChunk()
+	{
+		Chunk* chunk = mChunks.back();
+		mChunks.pop_back();
+
+		for (int column = 0; column < mTypes.size(); ++column)
+		{
+			ComponentType* type = mTypes[column];
+			uint8* ptr = chunk->getColumn(column);
+			for (int i = 0; i < chunk->numEntity; ++i)
+			{
+				type->mDestructFunc(ptr);
+				ptr += type->mSize;
+			}
+		}
+		mNumEntity -= chunk->numEntity;
+		FMemory::Free(chunk);
+	}
+
+	bool EntityQuery::checkArchetype(EntityArchetype& archetype, Match& outMatch) const
+	{
+		outMatch.archetype = &archetype;
+		outMatch.columns.resize(mDescList.size());
+		for (int i = 0; i < mDescList.size(); ++i)
+		{
+			QueryComponentDesc const& desc = mDescList[i];
+			int column = archetype.findColumn(desc.type);
+			switch (desc.condition)
+			{
+			case EComponentCondition::Required:
+				if (column == INDEX_NONE)
+					return false;
+				break;
+			case EComponentCondition::Excluded:
+				if (column != INDEX_NONE)
+					return false;
+				break;
+			case EComponentCondition::Optional:
+				break;
+			}
+			outMatch.columns[i] = column;
+		}
+		return true;
+	}
+
+	EntityManager::EntityManager()
+	{
+		TArray< ComponentType* > emptyTypes;
+		mEmptyArchetype = findOrCreateArchetype(emptyTypes);
+	}
+
+	EntityManager::~EntityManager()
+	{
+		// Chunks destruct the remaining components
+		mArchetypes.clear();
+		if (mIndexSlot != INDEX_NONE)
+		{
+			unregisterFromList();
+		}
+	}
+
+	EntityQuery* EntityManager::createQuery(TArray< QueryComponentDesc > const& descList)
+	{
+		EntityQuery* query = new EntityQuery;
+		query->mDescList = descList;
+		mQueries.push_back(std::unique_ptr< EntityQuery >(query));
+		updateQuery(*query);
+		return query;
+	}
+
+	void EntityManager::updateQuery(EntityQuery& query)
+	{
+		for (; query.mNumArchetypeChecked < mArchetypes.size(); ++query.mNumArchetypeChecked)
+		{
+			EntityQuery::Match match;
+			if (query.checkArchetype(*mArchetypes[query.mNumArchetypeChecked], match))
+			{
+				query.mMatches.push_back(std::move(match));
+			}
+		}
+	}
+
+	EntityArchetype* EntityManager::findOrCreateArchetype(TArray< ComponentType* > const& sortedTypes)
+	{
+		for (auto const& archetype : mArchetypes)
+		{
+			if (archetype->mTypes.size() != sortedTypes.size())
+				continue;
+			if (std::equal(sortedTypes.begin(), sortedTypes.end(), archetype->mTypes.begin()))
+				return archetype.get();
+		}
+
+		EntityArchetype* archetype = new EntityArchetype(sortedTypes);
+		mArchetypes.push_back(std::unique_ptr< EntityArchetype >(archetype));
+		return archetype;
+	}
+
+	EntityArchetype* EntityManager::getAddArchetype(EntityArchetype* archetype, ComponentType* type)
+	{
+		EntityArchetype** pEdge = archetype->mAddEdges.findValue(type);
+		if (pEdge)
+			return *pEdge;
+
+		TArray< ComponentType* > types = archetype->mTypes;
+		auto iter = std::lower_bound(types.begin(), types.end(), type, 
+			[](ComponentType* lhs, ComponentType* rhs) { return lhs->mID < rhs->mID; });
+		types.insert(iter, type);
+
+		EntityArchetype* result = findOrCreateArchetype(types);
+		archetype->mAddEdges.insert(type, result);
+		result->mRemoveEdges.insert(type, archetype);
+		return result;
+	}
+
+	EntityArchetype* EntityManager::getRemoveArchetype(EntityArchetype* archetype, ComponentType* type)
+	{
+		EntityArchetype** pEdge = archetype->mRemoveEdges.findValue(type);
+		if (pEdge)
+			return *pEdge;
+
+		TArray< ComponentType* > types = archetype->mTypes;
+		types.remove(type);
+
+		EntityArchetype* result = findOrCreateArchetype(types);
+		archetype->mRemoveEdges.insert(type, result);
+		result->mAddEdges.insert(type, archetype);
+		return result;
+	}
+
+	void EntityManager::allocEntitySlot(EntityArchetype* archetype, EntityData& entityData)
+	{
+		EntityArchetype::Chunk* chunk;
+		if (archetype->mChunks.empty() || archetype->mChunks.back()->numEntity == archetype->mChunkCapacity)
+		{
+			chunk = archetype->allocChunk();
+		}
+		else
+		{
+			chunk = archetype->mChunks.back();
+		}
+
+		int index = chunk->numEntity++;
+		++archetype->mNumEntity;
+		new (chunk->getEntities() + index) EntityHandle(entityData.handle);
+
+		entityData.archetype = archetype;
+		entityData.chunk = chunk;
+		entityData.indexInChunk = index;
+	}
+
+	void EntityManager::freeEntitySlot(EntityArchetype* archetype, EntityArchetype::Chunk* chunk, int index)
+	{
+		EntityArchetype::Chunk* lastChunk = archetype->mChunks.back();
+		int lastIndex = lastChunk->numEntity - 1;
+		if (lastChunk != chunk || lastIndex != index)
+		{
+			for (int column = 0; column < archetype->mTypes.size(); ++column)
+			{
+				ComponentType* type = archetype->mTypes[column];
+				type->mRelocateFunc(chunk->getComponent(column, index), lastChunk->getComponent(column, lastIndex));
+			}
+
+			EntityHandle const& lastHandle = lastChunk->getEntities()[lastIndex];
+			chunk->getEntities()[index] = lastHandle;
+			EntityData& lastData = mEntityLists[lastHandle.indexSlot];
+			lastData.chunk = chunk;
+			lastData.indexInChunk = index;
+		}
+
+		--archetype->mNumEntity;
+		if (--lastChunk->numEntity == 0)
+		{
+			archetype->freeLastChunk();
+		}
+	}
+
+	void EntityManager::moveEntity(EntityData& entityData, EntityArchetype* dest)
+	{
+		EntityArchetype* src = entityData.archetype;
+		EntityArchetype::Chunk* srcChunk = entityData.chunk;
+		int srcIndex = entityData.indexInChunk;
+
+		allocEntitySlot(dest, entityData);
+
+		// Both type lists are sorted , move the shared components and destruct the dropped ones
+		int destColumn = 0;
+		for (int srcColumn = 0; srcColumn < src->mTypes.size(); ++srcColumn)
+		{
+			ComponentType* type = src->mTypes[srcColumn];
+			while (destColumn < dest->mTypes.size() && dest->mTypes[destColumn]->mID < type->mID)
+				++destColumn;
+
+			void* srcPtr = srcChunk->getComponent(srcColumn, srcIndex);
+			if (destColumn < dest->mTypes.size() && dest->mTypes[destColumn] == type)
+			{
+				type->mRelocateFunc(entityData.chunk->getComponent(destColumn, entityData.indexInChunk), srcPtr);
+			}
+			else
+			{
+				type->mDestructFunc(srcPtr);
+			}
+		}
+
+		freeEntitySlot(src, srcChunk, srcIndex);
+	}
 
 	EntityHandle EntityManager::createEntity()
 	{
@@ -78,10 +355,10 @@ namespace ECS
 		}
 
 		auto& data = mEntityLists[indexSlot];
-		data.flags |= EEntityFlag::Used;
+		data.flags = EEntityFlag::Used;
+		data.systemMask = 0;
 		data.handle = EntityHandle(indexSlot, mNextSerialNumber, mIndexSlot);
-
-		mUsedEntityIndices.push_back(indexSlot);
+		allocEntitySlot(mEmptyArchetype, data);
 
 		++mNextSerialNumber;
 		if( mNextSerialNumber == 0 )
@@ -97,27 +374,26 @@ namespace ECS
 	{
 		CHECK(isValid(handle));
 		EntityData& entityData = mEntityLists[handle.indexSlot];
-		for(auto const& componetData : entityData.components )
-		{
-			if (componetData.type == type)
-				return componetData.ptr;
-		}
-		return nullptr;
+		int column = entityData.archetype->findColumn(type);
+		if (column == INDEX_NONE)
+			return nullptr;
+		return entityData.chunk->getComponent(column, entityData.indexInChunk);
 	}
 
 	EntityComponent* EntityManager::addComponentInternal(EntityHandle const& handle, ComponentType* type)
 	{
 		CHECK(isValid(handle));
-		EntityComponent* component = type->getPool()->fetchComponent();
-		if( component )
-		{
-			ComponentData componentData;
-			componentData.ptr = component;
-			componentData.type = type;
-			mEntityLists[handle.indexSlot].components.push_back(componentData);
+		EntityData& entityData = mEntityLists[handle.indexSlot];
+		int column = entityData.archetype->findColumn(type);
+		if (column != INDEX_NONE)
+			return entityData.chunk->getComponent(column, entityData.indexInChunk);
 
-			type->registerComponent(handle, component);
-		}
+		EntityArchetype* archetype = getAddArchetype(entityData.archetype, type);
+		moveEntity(entityData, archetype);
+
+		EntityComponent* component = entityData.chunk->getComponent(archetype->findColumn(type), entityData.indexInChunk);
+		type->mConstructFunc(component);
+		type->registerComponent(handle, component);
 		return component;
 	}
 
@@ -125,21 +401,12 @@ namespace ECS
 	{
 		CHECK(isValid(handle));
 		EntityData& entityData = mEntityLists[handle.indexSlot];
-		auto iter = std::find_if( 
-			entityData.components.begin() , entityData.components.end() , 
-			[type](auto const& componetData)
-			{
-				return componetData.type == type;
-			});
-
-
-		if( iter == entityData.components.end() )
+		int column = entityData.archetype->findColumn(type);
+		if (column == INDEX_NONE)
 			return false;
 
-		EntityComponent* component = iter->ptr;
-		entityData.components.erase(iter);
-		type->unregisterComponent(handle, component);
-		type->getPool()->releaseComponent(component);
+		type->unregisterComponent(handle, entityData.chunk->getComponent(column, entityData.indexInChunk));
+		moveEntity(entityData, getRemoveArchetype(entityData.archetype, type));
 		return true;
 	}
 
@@ -154,11 +421,17 @@ namespace ECS
 		});
 
 		auto& entityData = mEntityLists[handle.indexSlot];
-
-		for (auto const& compentData : entityData.components)
+		EntityArchetype* archetype = entityData.archetype;
+		for (int column = 0; column < archetype->mTypes.size(); ++column)
 		{
-			compentData.type->unregisterComponent(handle, compentData.ptr);
+			ComponentType* type = archetype->mTypes[column];
+			EntityComponent* component = entityData.chunk->getComponent(column, entityData.indexInChunk);
+			type->unregisterComponent(handle, component);
+			type->mDestructFunc(component);
 		}
+		freeEntitySlot(archetype, entityData.chunk, entityData.indexInChunk);
+		entityData.archetype = nullptr;
+		entityData.chunk = nullptr;
 
 		mFreeEntityIndices.push_back(handle.indexSlot);
 		entityData.flags = EEntityFlag::PendingKill;
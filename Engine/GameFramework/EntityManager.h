@@ -6,10 +6,18 @@
 #include "CoreShare.h"
 
 #include "DataStructure/Array.h"
+#include "DataStructure/HashMap.h"
+#include "TypeMemoryOp.h"
+#include "Math/Base.h"
+#include "ProfileSystem.h"
+#include "Async/ParallelFor.h"
 
 #include <unordered_map>
 #include <typeindex>
 #include <algorithm>
+#include <memory>
+#include <utility>
+#include <tuple>
 #include <cassert>
 
 
@@ -23,22 +31,21 @@ namespace ECS
 
 	using EntityComponent = void;
 
-	class IComponentPool
-	{
-	public:
-		virtual void releaseComponent(EntityComponent* component) = 0;
-		virtual EntityComponent* fetchComponent() = 0;
-	};
-
-
 	class ComponentType
 	{
 	public:
-		virtual IComponentPool* getPool() = 0;
+		virtual ~ComponentType() = default;
 		virtual void registerComponent(EntityHandle const& handle, EntityComponent* component) {}
 		virtual void unregisterComponent(EntityHandle const& handle, EntityComponent* component) {}
 
 		uint32 mID;
+		//Memory layout , components are stored in archetype chunks
+		uint32 mSize;
+		uint32 mAlignment;
+		void (*mConstructFunc)(void* ptr);
+		void (*mDestructFunc)(void* ptr);
+		//move construct dest from src and destruct src
+		void (*mRelocateFunc)(void* dest, void* src);
 	};
 
 	class EntityHandle
@@ -98,21 +105,6 @@ namespace ECS
 
 
 
-	template< class T >
-	class TSimpleComponentPool : public IComponentPool
-	{
-		virtual void releaseComponent(EntityComponent* component)
-		{
-			delete component;
-		}
-		virtual EntityComponent* fetchComponent()
-		{
-			return new T();
-		}
-	};
-
-
-
 	enum EComponentCondition
 	{
 		Required,
@@ -151,17 +143,98 @@ namespace ECS
 	};
 
 
-	class EntityManager
+	// Entities with the same component set , components are stored in 16KB chunks as SoA columns:
+	// [ EntityHandle x capacity ][ Component0 x capacity ][ Component1 x capacity ] ...
+	// All chunks are full except the last one , so iterating an archetype is a linear memory sweep
+	class EntityArchetype
 	{
 	public:
+		static constexpr int ChunkDataSize = 16 * 1024;
+		static constexpr int ChunkAlignment = 64;
 
-		~EntityManager()
+		struct Chunk
 		{
-			if (mIndexSlot != INDEX_NONE)
+			EntityArchetype* archetype;
+			uint8* data;
+			int    numEntity;
+
+			EntityHandle* getEntities() { return (EntityHandle*)data; }
+			uint8*        getColumn(int column) { return data + archetype->mColumnOffsets[column]; }
+			template< class T >
+			T*            getColumnT(int column) { return (T*)getColumn(column); }
+			EntityComponent* getComponent(int column, int index)
 			{
-				unregisterFromList();
+				return getColumn(column) + index * archetype->mTypes[column]->mSize;
 			}
-		}
+		};
+
+		EntityArchetype(TArray< ComponentType* > const& sortedTypes);
+		~EntityArchetype();
+
+		int  findColumn(ComponentType* type) const;
+		bool hasComponent(ComponentType* type) const { return findColumn(type) != INDEX_NONE; }
+		int  getEntityNum() const { return mNumEntity; }
+		int  getChunkCapacity() const { return mChunkCapacity; }
+
+		TArray< ComponentType* > const& getTypes() const { return mTypes; }
+		TArray< Chunk* > const&         getChunks() const { return mChunks; }
+
+	private:
+		friend class EntityManager;
+
+		Chunk* allocChunk();
+		void   freeLastChunk();
+
+		//sorted by ComponentType::mID
+		TArray< ComponentType* > mTypes;
+		TArray< uint32 > mColumnOffsets;
+		TArray< Chunk* > mChunks;
+		int mChunkCapacity;
+		int mChunkDataSize;
+		int mNumEntity;
+
+		//cached archetype transitions
+		THashMap< ComponentType*, EntityArchetype* > mAddEdges;
+		THashMap< ComponentType*, EntityArchetype* > mRemoveEdges;
+	};
+
+	struct QueryComponentDesc
+	{
+		ComponentType* type;
+		EComponentCondition condition;
+	};
+
+	// Cached list of archetypes matching the component conditions.
+	// Archetypes are never destroyed , so only new archetypes need to be checked when updating
+	class EntityQuery
+	{
+	public:
+		struct Match
+		{
+			EntityArchetype* archetype;
+			//column of each desc , INDEX_NONE if the optional component is missing
+			TArray< int > columns;
+		};
+
+		TArray< QueryComponentDesc > const& getDescList() const { return mDescList; }
+		TArray< Match > const& getMatches() const { return mMatches; }
+
+	private:
+		friend class EntityManager;
+		bool checkArchetype(EntityArchetype& archetype, Match& outMatch) const;
+
+		TArray< QueryComponentDesc > mDescList;
+		TArray< Match > mMatches;
+		int mNumArchetypeChecked = 0;
+	};
+
+	class EntityManager
+	{
+	public:
+
+		EntityManager();
+		~EntityManager();
+
 		CORE_API void registerToList();
 		CORE_API void unregisterFromList();
 
@@ -178,40 +251,121 @@ namespace ECS
 			return false;
 		}
 
+		// Custom component types should derive from this to keep the memory layout info
 		template< class T >
 		class TDefaultComponentType : public ComponentType
 		{
 		public:
-			virtual IComponentPool* getPool()
+			TDefaultComponentType()
 			{
-				return &poolInstance;
+				mSize = sizeof(T);
+				mAlignment = alignof(T);
+				mConstructFunc = [](void* ptr) { ::new (ptr) T(); };
+				mDestructFunc = [](void* ptr) { FTypeMemoryOp::Destruct((T*)ptr); };
+				mRelocateFunc = [](void* dest, void* src) { FTypeMemoryOp::Move((T*)dest, (T*)src); };
 			}
-			TSimpleComponentPool< T > poolInstance;
 		};
 
 		template< class TComponent , typename TComponentType = TDefaultComponentType< TComponent > >
 		void registerComponentTypeT()
 		{
 			CHECK(mComponentTypeMap.find(std::type_index(typeid(TComponent))) == mComponentTypeMap.end());
-			static TComponentType sComponentTypeInstance;
-			mComponentTypeMap.emplace(std::type_index(typeid(TComponent)), &sComponentTypeInstance);
+			ComponentType* type = new TComponentType;
+			type->mID = mComponentTypes.size();
+			CHECK(type->mAlignment <= EntityArchetype::ChunkAlignment);
+			mComponentTypes.push_back(std::unique_ptr< ComponentType >(type));
+			mComponentTypeMap.insert(std::type_index(typeid(TComponent)), type);
 		}
 
 		template< class TComponent , typename TFunc >
 		void visitComponent(TFunc&& func)
 		{
-			ComponentType* type = getComponentTypeT<TComponent>();
-			for (auto index : mUsedEntityIndices)
+			forEach< TComponent >([&func](EntityHandle const& handle, TComponent& component)
+			{
+				func(handle, &component);
+			});
+		}
+
+		// func(EntityHandle const& handle, TComponents&... components)
+		// Adding or removing components and entities is not allowed in func
+		template< class ...TComponents , typename TFunc >
+		void forEach(TFunc&& func)
+		{
+			EntityQuery& query = getQueryT< TComponents... >();
+			for (auto const& match : query.mMatches)
+			{
+				for (EntityArchetype::Chunk* chunk : match.archetype->mChunks)
+				{
+					ForEachInChunk< TComponents... >(*chunk, match.columns.data(), func, std::index_sequence_for< TComponents... >());
+				}
+			}
+		}
+
+		// Chunks are split over the thread pool , func must be safe to run concurrently for different entities
+		template< class ...TComponents , typename TFunc >
+		void parallelForEach(QueueThreadPool& threadPool, FrameAllocator& allocator, TFunc&& func)
+		{
+			EntityQuery& query = getQueryT< TComponents... >();
+
+			StackMaker marker(allocator);
+			int numChunk = 0;
+			for (auto const& match : query.mMatches)
+			{
+				numChunk += match.archetype->mChunks.size();
+			}
+			if (numChunk == 0)
+				return;
+
+			struct ChunkTask
+			{
+				EntityArchetype::Chunk* chunk;
+				int const* columns;
+			};
+			ChunkTask* tasks = (ChunkTask*)allocator.alloc(sizeof(ChunkTask) * numChunk);
+			int numTask = 0;
+			for (auto const& match : query.mMatches)
+			{
+				for (EntityArchetype::Chunk* chunk : match.archetype->mChunks)
+				{
+					tasks[numTask].chunk = chunk;
+					tasks[numTask].columns = match.columns.data();
+					++numTask;
+				}
+			}
+
+			ParallelFor(threadPool, allocator, "ECS.ForEach", numChunk, [tasks, &func](int index)
+			{
+				ChunkTask const& task = tasks[index];
+				ForEachInChunk< TComponents... >(*task.chunk, task.columns, func, std::index_sequence_for< TComponents... >());
+			}, 1);
+		}
+
+		// Query with Required/Excluded/Optional conditions , owned by the manager
+		EntityQuery* createQuery(TArray< QueryComponentDesc > const& descList);
+		void updateQuery(EntityQuery& query);
+
+		template< class ...TComponents >
+		EntityQuery& getQueryT()
+		{
+			EntityQuery** pQuery = mQueryMap.findValue(std::type_index(typeid(TQueryKey< TComponents... >)));
+			EntityQuery* query;
+			if (pQuery)
+			{
+				query = *pQuery;
+			}
+			else
 			{
-				EntityData& entityData = mEntityLists[index];
-				for (auto const& componentData : entityData.components)
+				TArray< QueryComponentDesc > descList;
+				for (ComponentType* type : { getComponentTypeT< TComponents >()... })
 				{
-					if (componentData.type == type)
-					{
-						func(entityData.handle, (T*)componentData.ptr);
-					}
+					CHECK(type);
+					descList.push_back({ type, EComponentCondition::Required });
 				}
+				query = createQuery(descList);
+				mQueryMap.insert(std::type_index(typeid(TQueryKey< TComponents... >)), query);
 			}
+			updateQuery(*query);
+			return *query;
 		}
 
 		struct FreeSlotCmp
@@ -250,26 +404,16 @@ namespace ECS
 			return *(TComponent*)getComponentInternal(handle, type);
 		}
 
+		// An entity has at most one component of each type
 		template< class TComponent >
 		int getComponentsT(EntityHandle const& handle, TArray< TComponent* >& outComponents)
 		{
-			if( !isValid(handle) )
+			TComponent* component = getComponentT< TComponent >(handle);
+			if (component == nullptr)
 				return 0;
 
-			int result = 0;
-			ComponentType* type = getComponentTypeT<TComponent>();
-			if (type)
-			{
-				for (auto componet : mEntityLists[handle.indexSlot].components)
-				{
-					if (componet->type == type)
-					{
-						outComponents.push_back(componet.ptr);
-						++result;
-					}
-				}
-			}
-			return result;
+			outComponents.push_back(component);
+			return 1;
 		}
 
 		int getAllComponents(EntityHandle const& handle, TArray< EntityComponent* >& outComponents)
@@ -277,16 +421,18 @@ namespace ECS
 			if (!isValid(handle))
 				return 0;
 
-			int result = 0;
-			for (auto componet : mEntityLists[handle.indexSlot].components)
+			EntityData const& entityData = mEntityLists[handle.indexSlot];
+			int numType = entityData.archetype->mTypes.size();
+			for (int column = 0; column < numType; ++column)
 			{
-				outComponents.push_back(componet.ptr);
-				++result;
+				outComponents.push_back(entityData.chunk->getComponent(column, entityData.indexInChunk));
 			}
-			return result;
+			return numType;
 		}
 
 
+		// Return the existing component if the entity has one.
+		// Adding or removing a component moves the entity to another archetype , pointers of its components are invalidated
 		template< class TComponent >
 		TComponent* addComponentT(EntityHandle const& handle)
 		{
@@ -305,7 +451,7 @@ namespace ECS
 		EntityComponent* addComponentInternal(EntityHandle const& handle, ComponentType* type);
 		bool removeComponentInternal(EntityHandle const& handle, ComponentType* type);
 
-
+		int  getArchetypeNum() const { return mArchetypes.size(); }
 
 
 		struct EEntityFlag
@@ -318,34 +464,18 @@ namespace ECS
 			};
 		};
 
-		struct ComponentData
-		{
-			EntityComponent* ptr;
-			ComponentType* type;
-		};
-
 		struct EntityData
 		{
 			uint32 flags;
 			uint64 systemMask;
 			EntityHandle handle;
-			TArray< ComponentData > components;
+			EntityArchetype* archetype;
+			EntityArchetype::Chunk* chunk;
+			int indexInChunk;
 		};
 
-		void  cleanupEntity(EntityData& entityData)
-		{
-			CHECK(entityData.flags & EEntityFlag::PendingKill);
-			for (auto const& compentData : entityData.components)
-			{
-				compentData.type->getPool()->releaseComponent(compentData.ptr);
-			}
-			entityData.components.clear();
-			//entityData.components.shrink_to_fit();
-			entityData.flags = 0;
-		}
 		int mIndexSlot = INDEX_NONE;
 
-		TArray< uint32 > mUsedEntityIndices;
 		TArray< uint32 > mFreeEntityIndices;
 		uint32 mNextSerialNumber = 1;
 
@@ -368,7 +498,8 @@ namespace ECS
 			return iter->second;
 		}
 
-		std::unordered_map< std::type_index, ComponentType* > mComponentTypeMap;
+		THashMap< std::type_index, ComponentType* > mComponentTypeMap;
+		TArray< std::unique_ptr< ComponentType > > mComponentTypes;
 		TArray< EntityData > mEntityLists;
 		TArray< IEntityEventLister* > mEventListers;
 
@@ -397,6 +528,37 @@ namespace ECS
 			bool bManageed;
 		};
 		TArray< ISystemSerivce* > mSystems;
+
+	private:
+
+		template< class ...TComponents >
+		struct TQueryKey {};
+
+		template< class ...TComponents, typename TFunc, size_t ...Is >
+		static void ForEachInChunk(EntityArchetype::Chunk& chunk, int const* columns, TFunc& func, std::index_sequence< Is... >)
+		{
+			EntityHandle* entities = chunk.getEntities();
+			std::tuple< TComponents*... > columnPtrs(chunk.getColumnT< TComponents >(columns[Is])...);
+			for (int i = 0; i < chunk.numEntity; ++i)
+			{
+				func(entities[i], std::get< Is >(columnPtrs)[i]...);
+			}
+		}
+
+		EntityArchetype* findOrCreateArchetype(TArray< ComponentType* > const& sortedTypes);
+		EntityArchetype* getAddArchetype(EntityArchetype* archetype, ComponentType* type);
+		EntityArchetype* getRemoveArchetype(EntityArchetype* archetype, ComponentType* type);
+
+		//reserve a slot at the end of archetype , components are not constructed
+		void  allocEntitySlot(EntityArchetype* archetype, EntityData& entityData);
+		//fill the hole with the last entity of archetype , components of the slot must be destructed or moved
+		void  freeEntitySlot(EntityArchetype* archetype, EntityArchetype::Chunk* chunk, int index);
+		void  moveEntity(EntityData& entityData, EntityArchetype* dest);
+
+		TArray< std::unique_ptr< EntityArchetype > > mArchetypes;
+		EntityArchetype* mEmptyArchetype;
+		TArray< std::unique_ptr< EntityQuery > > mQueries;
+		THashMap< std::type_index, EntityQuery* > mQueryMap;
 	};
 
 
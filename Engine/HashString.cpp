@@ -5,10 +5,12 @@
 #include "Core/TypeHash.h"
 #include "TypeMemoryOp.h"
 #include "Meta/MetaBase.h"
+#include "PlatformThread.h"
 
 #include <functional>
 #include <cassert>
 #include <type_traits>
+#include <atomic>
 
 #include "Core/FNV1a.h"
 
@@ -91,7 +93,8 @@ struct NameSlot
 	InlineString< MaxHashStringLength > str;
 	uint32    hashValue;
 	uint32    index;
-	NameSlot* next;
+	//Slots are published with release stores , the lookup doesn't lock
+	std::atomic< NameSlot* > next;
 
 	int compare(char const* other, bool bCaseSensitive)
 	{
@@ -114,8 +117,55 @@ struct NameSlot
 namespace HashStringInternal
 {
 	static TChunkArray< NameSlot, 2 * 1024 * 4, NameSlotChunkNum > GNameSlots;
-	static NameSlot* GHashHead[NameSlotHashBucketSize];
+	static std::atomic< NameSlot* > GHashHead[NameSlotHashBucketSize];
 	static NameSlot* GHashTail[NameSlotHashBucketSize];
+	static Mutex     GSlotLock;
+
+	template< class TCompareFunc >
+	NameSlot* FindSlot(uint32 hashValue, uint32 idxHash, TCompareFunc&& compareFunc)
+	{
+		NameSlot* slot = GHashHead[idxHash].load(std::memory_order_acquire);
+		for (; slot; slot = slot->next.load(std::memory_order_acquire))
+		{
+			if (hashValue == slot->hashValue && compareFunc(*slot))
+				break;
+		}
+		return slot;
+	}
+
+	template< class TCompareFunc, class TSetupFunc >
+	NameSlot* FindOrAddSlot(uint32 hashValue, TCompareFunc&& compareFunc, TSetupFunc&& setupFunc)
+	{
+		uint32 idxHash = hashValue % NameSlotHashBucketSize;
+		NameSlot* slot = FindSlot(hashValue, idxHash, compareFunc);
+		if (slot)
+			return slot;
+
+		Mutex::Locker locker(GSlotLock);
+		//Other thread may add the same string before the lock
+		slot = FindSlot(hashValue, idxHash, compareFunc);
+		if (slot)
+			return slot;
+
+		int idx = GNameSlots.size();
+		void* ptr = GNameSlots.addUninitialized();
+
+		slot = new (ptr) NameSlot;
+		setupFunc(*slot);
+		slot->hashValue = hashValue;
+		slot->index = idx;
+		slot->next.store(nullptr, std::memory_order_relaxed);
+
+		if (GHashTail[idxHash])
+			GHashTail[idxHash]->next.store(slot, std::memory_order_release);
+
+		GHashTail[idxHash] = slot;
+
+		if (GHashHead[idxHash].load(std::memory_order_relaxed) == nullptr)
+			GHashHead[idxHash].store(slot, std::memory_order_release);
+
+		return slot;
+	}
 };
 
 CORE_API void* DebugHashStringSlot = &HashStringInternal::GNameSlots;
@@ -140,12 +190,10 @@ bool HashString::Find(StringView const& str, bool bCaseSensitive, HashString& ou
 		hashValue = FCString::StriHash(str.data(), str.length());
 	}
 	uint32 idxHash = hashValue % NameSlotHashBucketSize;
-	NameSlot* slot = HashStringInternal::GHashHead[idxHash];
-	for (; slot; slot = slot->next)
+	NameSlot* slot = HashStringInternal::FindSlot(hashValue, idxHash, [&](NameSlot& slot)
 	{
-		if (hashValue == slot->hashValue && slot->compareN(str.data(), str.length(), bCaseSensitive) == 0)
-			break;
-	}
+		return slot.compareN(str.data(), str.length(), bCaseSensitive) == 0;
+	});
 
 	if (slot == nullptr)
 	{
@@ -177,34 +225,9 @@ void HashString::init(char const* str, bool bCaseSensitive)
 	{
 		hashValue = FCString::StriHash(str);
 	}
-	uint32 idxHash = hashValue % NameSlotHashBucketSize;
-	NameSlot* slot = HashStringInternal::GHashHead[idxHash];
-	for( ; slot; slot = slot->next )
-	{
-		if( hashValue == slot->hashValue && slot->compare(str, bCaseSensitive) == 0 )
-			break;
-	}
-
-	if( slot == nullptr )
-	{
-		int idx = HashStringInternal::GNameSlots.size();
-		void* ptr = HashStringInternal::GNameSlots.addUninitialized();
-
-		slot = new (ptr) NameSlot;
-		slot->hashValue = hashValue;
-		slot->str = str;
-		slot->index = idx;
-		slot->next = nullptr;
-
-		//#TODO : thread-safe
-		if(HashStringInternal::GHashTail[idxHash] )
-			HashStringInternal::GHashTail[idxHash]->next = slot;
-
-		HashStringInternal::GHashTail[idxHash] = slot;
-
-		if(HashStringInternal::GHashHead[idxHash] == nullptr )
-			HashStringInternal::GHashHead[idxHash] = slot;
-	}
+	NameSlot* slot = HashStringInternal::FindOrAddSlot(hashValue,
+		[&](NameSlot& slot) { return slot.compare(str, bCaseSensitive) == 0; },
+		[&](NameSlot& slot) { slot.str = str; });
 
 	mIndex = slot->index << 1;
 	if( !bCaseSensitive )
@@ -230,34 +253,9 @@ void HashString::init(char const* str, size_t len, bool bCaseSensitive /*= true*
 	{
 		hashValue = FCString::StriHash(str, len);
 	}
-	uint32 idxHash = hashValue % NameSlotHashBucketSize;
-	NameSlot* slot = HashStringInternal::GHashHead[idxHash];
-	for( ; slot; slot = slot->next )
-	{
-		if( hashValue == slot->hashValue && slot->compareN(str, len, bCaseSensitive) == 0 )
-			break;
-	}
-
-	if( slot == nullptr )
-	{
-		int idx = HashStringInternal::GNameSlots.size();
-		void* ptr = HashStringInternal::GNameSlots.addUninitialized();
-
-		slot = new (ptr) NameSlot;
-		slot->hashValue = hashValue;
-		slot->str = StringView(str, len);
-		slot->index = idx;
-		slot->next = nullptr;
-
-		//#TODO : thread-safe
-		if(HashStringInternal::GHashTail[idxHash] )
-			HashStringInternal::GHashTail[idxHash]->next = slot;
-
-		HashStringInternal::GHashTail[idxHash] = slot;
-
-		if(HashStringInternal::GHashHead[idxHash] == nullptr )
-			HashStringInternal::GHashHead[idxHash] = slot;
-	}
+	NameSlot* slot = HashStringInternal::FindOrAddSlot(hashValue,
+		[&](NameSlot& slot) { return slot.compareN(str, len, bCaseSensitive) == 0; },
+		[&](NameSlot& slot) { slot.str = StringView(str, len); });
 
 	mIndex = slot->index << 1;
 	if( !bCaseSensitive )
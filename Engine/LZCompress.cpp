@@ -0,0 +1,198 @@
+#include "LZCompress.h"
+
+#include "CompilerConfig.h"
+
+#include <cstring>
+
+namespace
+{
+	int const MinMatch = 4;
+	int const HashBits = 12;
+	size_t const MaxOffset = 0xffff;
+	//The match finder reads 4 bytes , the end of the block is always literals
+	size_t const LastLiterals = 5;
+
+	FORCEINLINE uint32 Read32(uint8 const* ptr)
+	{
+		uint32 value;
+		memcpy(&value, ptr, sizeof(value));
+		return value;
+	}
+
+	FORCEINLINE uint32 HashSequence(uint32 value)
+	{
+		return (value * 2654435761u) >> (32 - HashBits);
+	}
+
+	FORCEINLINE size_t GetLengthCodeSize(size_t length)
+	{
+		return (length >= 15) ? (length - 15) / 255 + 1 : 0;
+	}
+
+	uint8* WriteLength(uint8* ptr, size_t length)
+	{
+		length -= 15;
+		while (length >= 255)
+		{
+			*ptr++ = 255;
+			length -= 255;
+		}
+		*ptr++ = uint8(length);
+		return ptr;
+	}
+
+	bool ReadLength(uint8 const*& ptr, uint8 const* ptrEnd, size_t& inoutLength)
+	{
+		uint8 value;
+		do
+		{
+			if (ptr >= ptrEnd)
+				return false;
+			value = *ptr++;
+			inoutLength += value;
+		}
+		while (value == 255);
+		return true;
+	}
+
+	uint8* WriteSequence(uint8* ptr, uint8 const* literals, size_t literalLength, size_t offset, size_t matchLength)
+	{
+		uint8* pToken = ptr++;
+		uint8 token = uint8((literalLength >= 15 ? 15 : literalLength) << 4);
+		if (literalLength >= 15)
+			ptr = WriteLength(ptr, literalLength);
+		memcpy(ptr, literals, literalLength);
+		ptr += literalLength;
+
+		if (offset)
+		{
+			*ptr++ = uint8(offset);
+			*ptr++ = uint8(offset >> 8);
+			token |= uint8(matchLength >= 15 ? 15 : matchLength);
+			if (matchLength >= 15)
+				ptr = WriteLength(ptr, matchLength);
+		}
+		*pToken = token;
+		return ptr;
+	}
+}
+
+size_t FLZCompress::Compress(uint8 const* src, size_t srcSize, uint8* dst, size_t dstCapacity)
+{
+	uint32 hashTable[1 << HashBits];
+	memset(hashTable, 0, sizeof(hashTable));
+
+	uint8 const* ip = src;
+	uint8 const* anchor = src;
+	uint8 const* const ipEnd = src + srcSize;
+	uint8* op = dst;
+	uint8* const opEnd = dst + dstCapacity;
+
+	if (srcSize > MinMatch + LastLiterals)
+	{
+		uint8 const* const matchLimit = ipEnd - LastLiterals;
+		while (ip + MinMatch <= matchLimit)
+		{
+			uint32 sequence = Read32(ip);
+			uint32 hash = HashSequence(sequence);
+			uint8 const* ref = src + hashTable[hash];
+			hashTable[hash] = uint32(ip - src);
+
+			if (ref >= ip || size_t(ip - ref) > MaxOffset || Read32(ref) != sequence)
+			{
+				//Skip faster in data which doesn't compress
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			while (ip > anchor && ref > src && ip[-1] == ref[-1])
+			{
+				--ip;
+				--ref;
+			}
+
+			uint8 const* matchEnd = ip + MinMatch;
+			uint8 const* refEnd = ref + MinMatch;
+			while (matchEnd < matchLimit && *matchEnd == *refEnd)
+			{
+				++matchEnd;
+				++refEnd;
+			}
+
+			size_t literalLength = size_t(ip - anchor);
+			size_t matchLength = size_t(matchEnd - ip) - MinMatch;
+			size_t sequenceSize = 1 + GetLengthCodeSize(literalLength) + literalLength + 2 + GetLengthCodeSize(matchLength);
+			if (sequenceSize > size_t(opEnd - op))
+				return 0;
+
+			op = WriteSequence(op, anchor, literalLength, size_t(ip - ref), matchLength);
+
+			ip = matchEnd;
+			anchor = ip;
+			hashTable[HashSequence(Read32(ip - 2))] = uint32(ip - 2 - src);
+		}
+	}
+
+	size_t literalLength = size_t(ipEnd - anchor);
+	if (1 + GetLengthCodeSize(literalLength) + literalLength > size_t(opEnd - op))
+		return 0;
+
+	op = WriteSequence(op, anchor, literalLength, 0, 0);
+	return size_t(op - dst);
+}
+
+bool FLZCompress::Decompress(uint8 const* src, size_t srcSize, uint8* dst, size_t dstSize)
+{
+	uint8 const* ip = src;
+	uint8 const* const ipEnd = src + srcSize;
+	uint8* op = dst;
+	uint8* const opEnd = dst + dstSize;
+
+	while (ip < ipEnd)
+	{
+		uint8 token = *ip++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !ReadLength(ip, ipEnd, literalLength))
+			return false;
+		if (literalLength > size_t(ipEnd - ip) || literalLength > size_t(opEnd - op))
+			return false;
+
+		memcpy(op, ip, literalLength);
+		ip += literalLength;
+		op += literalLength;
+
+		//The last sequence has no match
+		if (ip == ipEnd)
+			break;
+
+		if (ipEnd - ip < 2)
+			return false;
+		size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+		ip += 2;
+		if (offset == 0 || offset > size_t(op - dst))
+			return false;
+
+		size_t matchLength = token & 0xf;
+		if (matchLength == 15 && !ReadLength(ip, ipEnd, matchLength))
+			return false;
+		matchLength += MinMatch;
+		if (matchLength > size_t(opEnd - op))
+			return false;
+
+		uint8 const* ref = op - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(op, ref, matchLength);
+			op += matchLength;
+		}
+		else
+		{
+			//Overlapped match repeats the last bytes
+			for (size_t i = 0; i < matchLength; ++i)
+				*op++ = *ref++;
+		}
+	}
+
+	return op == opEnd;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#ifndef LZCompress_H_3777013F_ABA2_4AD4_AFB6_D4A1EC5E3EE2
+#define LZCompress_H_3777013F_ABA2_4AD4_AFB6_D4A1EC5E3EE2
+
+#include "Core/IntegerType.h"
+
+#include <cstddef>
+
+// Fast LZ77 block compression in the style of LZ4 , tuned for decompression speed.
+// A block is a list of sequences : token ( literal length , match length ) , literals , 16 bit match offset.
+// The block does not store its size , keep the raw size beside the data.
+class FLZCompress
+{
+public:
+	static size_t GetMaxCompressedSize(size_t size) { return size + size / 255 + 16; }
+
+	// Return the compressed size , 0 if the data doesn't fit the capacity
+	static size_t Compress(uint8 const* src, size_t srcSize, uint8* dst, size_t dstCapacity);
+	// Fail on corrupt data , dstSize must be the raw size of the block
+	static bool   Decompress(uint8 const* src, size_t srcSize, uint8* dst, size_t dstSize);
+};
+
+#endif // LZCompress_H_3777013F_ABA2_4AD4_AFB6_D4A1EC5E3EE2
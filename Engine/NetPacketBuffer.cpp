@@ -0,0 +1,70 @@
+#include "NetPacketBuffer.h"
+
+#include "BitUtility.h"
+
+void NetPacketBuffer::destroyThis()
+{
+	mPool->release(this);
+}
+
+NetPacketBufferPool::NetPacketBufferPool()
+{
+	mNumAllocated.store(0, std::memory_order_relaxed);
+}
+
+NetPacketBufferPool::~NetPacketBufferPool()
+{
+	for (FreeList& freeList : mFreeLists)
+	{
+		NetPacketBuffer* buffer;
+		while (freeList.tryPop(buffer))
+		{
+			delete buffer;
+		}
+	}
+}
+
+NetPacketBufferPool& NetPacketBufferPool::Get()
+{
+	static NetPacketBufferPool StaticPool;
+	return StaticPool;
+}
+
+NetPacketBufferRef NetPacketBufferPool::acquire(size_t minSize)
+{
+	if (minSize > (size_t(1) << MaxSizeLog2))
+	{
+		mNumAllocated.fetch_add(1, std::memory_order_relaxed);
+		return new NetPacketBuffer(*this, minSize);
+	}
+
+	//Round up to the size class that can hold minSize
+	uint32 sizeLog2 = MinSizeLog2;
+	if (minSize > (size_t(1) << MinSizeLog2))
+	{
+		sizeLog2 = 32 - FBitUtility::CountLeadingZeros(uint32(minSize - 1));
+	}
+
+	NetPacketBuffer* buffer;
+	if (mFreeLists[sizeLog2 - MinSizeLog2].tryPop(buffer))
+		return buffer;
+
+	mNumAllocated.fetch_add(1, std::memory_order_relaxed);
+	return new NetPacketBuffer(*this, size_t(1) << sizeLog2);
+}
+
+void NetPacketBufferPool::release(NetPacketBuffer* buffer)
+{
+	//Writes may have grown the buffer , file it under the largest class it can serve
+	size_t maxSize = buffer->mBuffer.getMaxSize();
+	if (maxSize >= (size_t(1) << MinSizeLog2) && maxSize < (size_t(2) << MaxSizeLog2))
+	{
+		uint32 sizeLog2 = 31 - FBitUtility::CountLeadingZeros(uint32(maxSize));
+		buffer->mBuffer.clear();
+		if (mFreeLists[sizeLog2 - MinSizeLog2].tryPush(buffer))
+			return;
+	}
+
+	mNumAllocated.fetch_sub(1, std::memory_order_relaxed);
+	delete buffer;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#ifndef NetPacketBuffer_H_D0F8F923_25C5_470C_A3BA_E0FEE756FBF5
+#define NetPacketBuffer_H_D0F8F923_25C5_470C_A3BA_E0FEE756FBF5
+
+#include "SocketBuffer.h"
+#include "RefCount.h"
+#include "Core/LockFreeQueue.h"
+
+#include <atomic>
+
+class NetPacketBufferPool;
+
+// Serialized packet data shared by many send queues.
+// The reference count is atomic : slices are released by the net thread while the game thread broadcasts,
+// the buffer goes back to its pool when the last reference is gone.
+class NetPacketBuffer
+{
+public:
+	SocketBuffer& getBuffer() { return mBuffer; }
+
+	void  incRef() { mRefCount.fetch_add(1, std::memory_order_relaxed); }
+	bool  decRef() { return mRefCount.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+	int   getRefCount() const { return mRefCount.load(std::memory_order_relaxed); }
+	void  destroyThis();
+
+private:
+	friend class NetPacketBufferPool;
+	NetPacketBuffer(NetPacketBufferPool& pool, size_t size)
+		:mBuffer(size), mPool(&pool)
+	{
+		mRefCount.store(0, std::memory_order_relaxed);
+	}
+
+	SocketBuffer          mBuffer;
+	NetPacketBufferPool*  mPool;
+	std::atomic< int32 >  mRefCount;
+};
+
+typedef TRefCountPtr< NetPacketBuffer > NetPacketBufferRef;
+
+// Read only view of a range of a shared buffer
+struct NetPacketSlice
+{
+	NetPacketSlice() :offset(0), size(0) {}
+	NetPacketSlice(NetPacketBufferRef const& buffer, uint32 offset, uint32 size)
+		:buffer(buffer), offset(offset), size(size) {}
+
+	char const* getData() const { return buffer->getBuffer().getData() + offset; }
+	bool        isValid() const { return buffer.isValid() && size != 0; }
+
+	NetPacketSlice slice(uint32 inOffset, uint32 inSize) const
+	{
+		assert(inOffset + inSize <= size);
+		return NetPacketSlice(buffer, offset + inOffset, inSize);
+	}
+
+	NetPacketBufferRef buffer;
+	uint32 offset;
+	uint32 size;
+};
+
+// Power of two size classes , each with a lock-free free list.
+// Buffers grown past the largest class are released to the heap.
+class NetPacketBufferPool
+{
+public:
+	NetPacketBufferPool();
+	~NetPacketBufferPool();
+
+	NetPacketBufferPool(NetPacketBufferPool const&) = delete;
+	NetPacketBufferPool& operator = (NetPacketBufferPool const&) = delete;
+
+	static NetPacketBufferPool& Get();
+
+	//Return a cleared buffer with at least minSize bytes
+	NetPacketBufferRef acquire(size_t minSize);
+
+	//Buffers created from the heap , a steady state doesn't increase it
+	uint32 getAllocatedNum() const { return mNumAllocated.load(std::memory_order_relaxed); }
+
+	static constexpr uint32 MinSizeLog2 = 8;
+	static constexpr uint32 MaxSizeLog2 = 16;
+	static constexpr uint32 SizeClassNum = MaxSizeLog2 - MinSizeLog2 + 1;
+	static constexpr uint32 MaxFreeNumPerClass = 256;
+
+private:
+	friend class NetPacketBuffer;
+	void release(NetPacketBuffer* buffer);
+
+	struct FreeList : TLockFreeBoundedQueue< NetPacketBuffer* >
+	{
+		FreeList() :TLockFreeBoundedQueue< NetPacketBuffer* >(MaxFreeNumPerClass) {}
+	};
+
+	FreeList mFreeLists[SizeClassNum];
+	std::atomic< uint32 > mNumAllocated;
+};
+
+#endif // NetPacketBuffer_H_D0F8F923_25C5_470C_A3BA_E0FEE756FBF5
@@ -4,10 +4,16 @@
 
 #include <cstdlib>
 #include <cassert>
-#include <corecrt_io.h>
+#include <algorithm>
 #include "Core/Memory.h"
 
+#if SYS_PLATFORM_WIN
+#include <corecrt_io.h>
 WORD  gSockVersion = MAKEWORD(1,1);
+#elif SYS_PLATFORM_LINUX
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#endif
 
 void SocketError(char* str){ }
 
@@ -91,6 +97,55 @@ int NetSocket::sendData( char const* data , size_t num )
 	return ::send( getHandle() , data , (int)num , 0 );
 }
 
+int NetSocket::sendData( NetSendBuffer const* buffers , int numBuffer )
+{
+	if ( numBuffer == 1 )
+		return sendData( buffers[0].data , buffers[0].size );
+
+#if SYS_PLATFORM_LINUX
+	int const MaxBatchNum = 64;
+	iovec vecs[MaxBatchNum];
+	int result = 0;
+	while( numBuffer > 0 )
+	{
+		int num = std::min( numBuffer , MaxBatchNum );
+		size_t batchSize = 0;
+		for( int i = 0; i < num; ++i )
+		{
+			vecs[i].iov_base = const_cast< char* >( buffers[i].data );
+			vecs[i].iov_len = buffers[i].size;
+			batchSize += buffers[i].size;
+		}
+
+		ssize_t numSend = ::writev( getHandle() , vecs , num );
+		if( numSend < 0 )
+			return result ? result : SOCKET_ERROR;
+
+		result += int( numSend );
+		if( size_t( numSend ) != batchSize )
+			break;
+
+		buffers += num;
+		numBuffer -= num;
+	}
+	return result;
+#else
+	//wsock32 has no gather send , stop at the first partial send to keep the stream in order
+	int result = 0;
+	for( int i = 0; i < numBuffer; ++i )
+	{
+		int numSend = sendData( buffers[i].data , buffers[i].size );
+		if( numSend == SOCKET_ERROR )
+			return result ? result : SOCKET_ERROR;
+
+		result += numSend;
+		if( size_t( numSend ) != buffers[i].size )
+			break;
+	}
+	return result;
+#endif
+}
+
 int NetSocket::sendData( char const* data , size_t num , char const* addrName , unsigned port )
 {
 	NetAddress addr;
@@ -109,6 +164,58 @@ int NetSocket::sendData( char const* data , size_t num , sockaddr* addrInfo , in
 	return FSocket::SendTo( getHandle() , data , (int)num , 0 , addrInfo , addrLength );
 }
 
+int NetSocket::sendDatagrams( NetDatagram const* datagrams , int numDatagram )
+{
+	if ( mHandle == INVALID_SOCKET && ! createUDP( ) )
+		return 0;
+
+#if SYS_PLATFORM_LINUX
+	int const MaxBatchNum = 64;
+	mmsghdr msgs[MaxBatchNum];
+	iovec   vecs[MaxBatchNum];
+	int result = 0;
+	while( numDatagram > 0 )
+	{
+		int num = std::min( numDatagram , MaxBatchNum );
+		for( int i = 0; i < num; ++i )
+		{
+			NetDatagram const& datagram = datagrams[i];
+			vecs[i].iov_base = const_cast< char* >( datagram.data );
+			vecs[i].iov_len = datagram.size;
+
+			msghdr& header = msgs[i].msg_hdr;
+			FMemory::Zero( &header , sizeof( header ) );
+			header.msg_name = const_cast< sockaddr_in* >( &datagram.addr->mAddr );
+			header.msg_namelen = sizeof( datagram.addr->mAddr );
+			header.msg_iov = &vecs[i];
+			header.msg_iovlen = 1;
+		}
+
+		int numSend = ::sendmmsg( getHandle() , msgs , num , 0 );
+		if( numSend <= 0 )
+			break;
+
+		result += numSend;
+		if( numSend != num )
+			break;
+
+		datagrams += num;
+		numDatagram -= num;
+	}
+	return result;
+#else
+	int result = 0;
+	for( int i = 0; i < numDatagram; ++i )
+	{
+		NetDatagram const& datagram = datagrams[i];
+		if( FSocket::SendTo( getHandle() , datagram.data , (int)datagram.size , 0 , (sockaddr const*)&datagram.addr->mAddr , sizeof( datagram.addr->mAddr ) ) == SOCKET_ERROR )
+			break;
+		++result;
+	}
+	return result;
+#endif
+}
+
 bool NetSocket::createTCP( bool beNB )
 {
 	close();
@@ -157,8 +264,13 @@ bool NetSocket::bindPort( unsigned port )
 
 bool NetSocket::setNonBlocking( bool beNB )
 {
+#if SYS_PLATFORM_WIN
 	u_long  nonBlocking = beNB ? 1 : 0;
 	int rVal = ioctlsocket( getHandle() , FIONBIO , &nonBlocking );
+#else
+	int nonBlocking = beNB ? 1 : 0;
+	int rVal = ioctl( getHandle() , FIONBIO , &nonBlocking );
+#endif
 	if ( rVal == SOCKET_ERROR )
 	{
 		return false;
@@ -181,7 +293,8 @@ char const* NetSocket::getIPByName( char const* AddrName )
 bool NetSocket::accept( NetSocket& clientSocket , sockaddr* addr , int addrLength )
 {
 	assert( clientSocket.mHandle == INVALID_SOCKET );
-	clientSocket.mHandle = ::accept( mHandle , addr , &addrLength );
+	SocketLength length = addrLength;
+	clientSocket.mHandle = ::accept( mHandle , addr , &length );
 
 	if ( clientSocket.mHandle == INVALID_SOCKET )
 		return false;
@@ -223,7 +336,7 @@ bool NetSocket::detectTCPInternal(SocketDetector& detector, NetSelectSet& select
 		if (selectSet.canRead(*this))
 		{
 			int length = 0;
-			int rVal = ioctlsocket(hSocket, FIONREAD, (unsigned long *)&length);
+			FSocket::GetReadableSize(hSocket, length);
 			// connection is be gracefully closed
 			if (length == 0)
 			{
@@ -310,10 +423,8 @@ bool NetSocket::detectUDPInternal(SocketDetector& detector , NetSelectSet& selec
 	{
 		while (1)
 		{
-			unsigned long length = 0;
-			int rVal = ioctlsocket(hSocket, FIONREAD, (unsigned long *)&length);
-
-			if (rVal == SOCKET_ERROR || length == 0)
+			int length = 0;
+			if (!FSocket::GetReadableSize(hSocket, length) || length == 0)
 				break;
 			detector.onReadable(*this, length);
 		}
@@ -371,9 +482,7 @@ bool NetSocket::IsInitialized()
 
 int NetSocket::getLastError()
 {
-#if SYS_PLATFORM_WIN
-	return WSAGetLastError();
-#endif
+	return FSocket::GetLastError();
 }
 
 void NetSocket::move( NetSocket& socket )
@@ -390,7 +499,7 @@ void NetSocket::move( NetSocket& socket )
 
 bool NetAddress::setFromSocket( NetSocket const& socket )
 {
-	int len = sizeof( mAddr );
+	SocketLength len = sizeof( mAddr );
 	return ::getpeername( socket.getHandle() , (sockaddr*)&mAddr, &len) != 0;
 }
 
@@ -400,7 +509,7 @@ bool NetAddress::setInternet( char const* addrName , unsigned port )
 	if ( !host )
 		return false;
 	mAddr.sin_family = AF_INET;
-	mAddr.sin_addr.s_addr = *( ( unsigned long*) host->h_addr );
+	mAddr.sin_addr.s_addr = *( ( uint32*) host->h_addr );
 	mAddr.sin_port = htons( port );
 
 	FMemory::Zero( mAddr.sin_zero , 8 );
@@ -489,3 +598,373 @@ bool NetSelectSet::haveExcept(NetSocket& socket)
 {
 	return !!FD_ISSET(socket.getHandle(), &mExcept);
 }
+
+
+NetEventLoop::NetEventLoop()
+{
+#if SYS_PLATFORM_LINUX
+	mEpollHandle = -1;
+	mbHavePendingRead = false;
+#endif
+}
+
+NetEventLoop::~NetEventLoop()
+{
+	cleanup();
+}
+
+bool NetEventLoop::initialize()
+{
+#if SYS_PLATFORM_LINUX
+	if (mEpollHandle != -1)
+		return true;
+
+	mEpollHandle = ::epoll_create1(EPOLL_CLOEXEC);
+	if (mEpollHandle == -1)
+	{
+		LogWarning(0, "Can't create epoll instance : error = %d", errno);
+		return false;
+	}
+#endif
+	return true;
+}
+
+void NetEventLoop::cleanup()
+{
+	for (auto& pair : mEntryMap)
+	{
+		pair.second->bRemoved = true;
+		mRemovedEntries.push_back(pair.second);
+	}
+	mEntryMap.clear();
+	purgeRemovedEntries();
+
+#if SYS_PLATFORM_LINUX
+	if (mEpollHandle != -1)
+	{
+		::close(mEpollHandle);
+		mEpollHandle = -1;
+	}
+#else
+	mSelectSet.clear();
+#endif
+}
+
+int NetEventLoop::GetMaxSocketNum()
+{
+#if SYS_PLATFORM_LINUX
+	return INT32_MAX;
+#else
+	return FD_SETSIZE;
+#endif
+}
+
+bool NetEventLoop::addSocket(NetSocket& socket, SocketDetector& detector, bool bPollSendable)
+{
+	assert(socket.getHandle() != INVALID_SOCKET);
+
+	Entry* entry;
+	auto iter = mEntryMap.find(&socket);
+	if (iter != mEntryMap.end())
+	{
+		entry = iter->second;
+		entry->detector = &detector;
+	}
+	else
+	{
+#if !SYS_PLATFORM_LINUX
+		if (mSelectSet.mSockets.size() >= FD_SETSIZE)
+		{
+			LogWarning(0, "Can't add socket : select set is full");
+			return false;
+		}
+		mSelectSet.addSocket(socket);
+#endif
+		entry = new Entry;
+		entry->socket = &socket;
+		entry->detector = &detector;
+		entry->bActive = false;
+		entry->bRemoved = false;
+		mEntryMap.insert(&socket, entry);
+	}
+
+	entry->bPollSendable = bPollSendable;
+	entry->bReadable = false;
+	entry->bWritable = false;
+	entry->bHangup = false;
+	entry->bError = false;
+
+#if SYS_PLATFORM_LINUX
+	epoll_event event;
+	event.data.ptr = entry;
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+	//Listening sockets stay level-triggered , onAcceptable accepts one connection per call
+	if (socket.getState() != SKS_LISTING)
+		event.events |= EPOLLET;
+
+	if (::epoll_ctl(mEpollHandle, EPOLL_CTL_ADD, socket.getHandle(), &event) == -1)
+	{
+		if (errno != EEXIST || ::epoll_ctl(mEpollHandle, EPOLL_CTL_MOD, socket.getHandle(), &event) == -1)
+		{
+			LogWarning(0, "Can't add socket to epoll : error = %d", errno);
+			removeSocket(socket);
+			return false;
+		}
+	}
+#endif
+	return true;
+}
+
+void NetEventLoop::removeSocket(NetSocket& socket)
+{
+	auto iter = mEntryMap.find(&socket);
+	if (iter == mEntryMap.end())
+		return;
+
+	Entry* entry = iter->second;
+	mEntryMap.erase(&socket);
+
+#if SYS_PLATFORM_LINUX
+	//Closed sockets are removed from epoll by the system , the handle may already be reused by other socket
+	if (socket.getHandle() != INVALID_SOCKET)
+	{
+		::epoll_ctl(mEpollHandle, EPOLL_CTL_DEL, socket.getHandle(), nullptr);
+	}
+#else
+	mSelectSet.removeSocket(socket);
+#endif
+	//Events of this dispatch may still refer to the entry
+	entry->bRemoved = true;
+	mRemovedEntries.push_back(entry);
+}
+
+void NetEventLoop::purgeRemovedEntries()
+{
+	if (mRemovedEntries.empty())
+		return;
+
+	for (int index = 0; index < mActiveEntries.size(); ++index)
+	{
+		if (mActiveEntries[index]->bRemoved)
+		{
+			mActiveEntries.removeIndexSwap(index);
+			--index;
+		}
+	}
+	for (Entry* entry : mRemovedEntries)
+	{
+		delete entry;
+	}
+	mRemovedEntries.clear();
+}
+
+int NetEventLoop::dispatch(uint32 timeoutMS)
+{
+#if SYS_PLATFORM_LINUX
+	//Sockets with unread data must not wait for new events , writable sockets only get polled
+	int timeout = mbHavePendingRead ? 0 : int(timeoutMS);
+
+	epoll_event events[256];
+	int numEvents = ::epoll_wait(mEpollHandle, events, ARRAY_SIZE(events), timeout);
+	if (numEvents == -1)
+	{
+		if (errno != EINTR)
+		{
+			LogWarning(0, "epoll_wait failed : error = %d", errno);
+		}
+		numEvents = 0;
+	}
+
+	for (int i = 0; i < numEvents; ++i)
+	{
+		Entry* entry = (Entry*)events[i].data.ptr;
+		uint32 flags = events[i].events;
+		if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+			entry->bReadable = true;
+		if (flags & EPOLLOUT)
+			entry->bWritable = true;
+		if (flags & (EPOLLRDHUP | EPOLLHUP))
+			entry->bHangup = true;
+		if (flags & EPOLLERR)
+			entry->bError = true;
+
+		if (!entry->bActive)
+		{
+			entry->bActive = true;
+			mActiveEntries.push_back(entry);
+		}
+	}
+
+	//New entries are appended during the loop when callbacks add sockets , they are processed in next dispatch
+	int numActive = mActiveEntries.size();
+	for (int index = 0; index < numActive; ++index)
+	{
+		Entry* entry = mActiveEntries[index];
+		if (!entry->bRemoved)
+		{
+			processEntry(*entry);
+		}
+	}
+
+	int numProcessed = numActive;
+	mbHavePendingRead = false;
+	for (int index = 0; index < mActiveEntries.size(); ++index)
+	{
+		Entry* entry = mActiveEntries[index];
+		if (entry->bRemoved || !(entry->bReadable || entry->bWritable))
+		{
+			entry->bActive = false;
+			mActiveEntries.removeIndexSwap(index);
+			--index;
+		}
+		else if (entry->bReadable)
+		{
+			mbHavePendingRead = true;
+		}
+	}
+	purgeRemovedEntries();
+	return numProcessed;
+#else
+	if (mEntryMap.size() == 0 || !mSelectSet.select(uint64(timeoutMS) * 1000))
+		return 0;
+
+	int numProcessed = 0;
+	for (auto& pair : mEntryMap)
+	{
+		mActiveEntries.push_back(pair.second);
+	}
+	for (Entry* entry : mActiveEntries)
+	{
+		if (entry->bRemoved)
+			continue;
+
+		NetSocket& socket = *entry->socket;
+		switch (socket.getState())
+		{
+		case SKS_UDP:
+		case SKS_CONNECTED_UDP:
+			socket.detectUDP(*entry->detector, mSelectSet);
+			++numProcessed;
+			break;
+		case SKS_CLOSE:
+			break;
+		default:
+			socket.detectTCP(*entry->detector, mSelectSet);
+			++numProcessed;
+		}
+	}
+	mActiveEntries.clear();
+	purgeRemovedEntries();
+	return numProcessed;
+#endif
+}
+
+bool NetEventLoop::drainReadable(Entry& entry)
+{
+	NetSocket& socket = *entry.socket;
+	SocketState state = socket.getState();
+
+	//Bound the work of one socket so a flooding peer can't starve the others
+	int const MaxReadNum = 64;
+	int prevLength = 0;
+	for (int i = 0; i < MaxReadNum; ++i)
+	{
+		int length = 0;
+		if (!FSocket::GetReadableSize(socket.getHandle(), length))
+			length = 0;
+
+		if (length == 0)
+		{
+			if (state == SKS_CONNECTED && (entry.bHangup || entry.bError))
+			{
+				entry.bReadable = false;
+				entry.bWritable = false;
+				entry.detector->onClose(socket, !entry.bError);
+				//The detector may remove and release the socket in the callback
+				if (!entry.bRemoved)
+					socket.close();
+				return false;
+			}
+			entry.bReadable = false;
+			return true;
+		}
+
+		//The detector didn't consume data , wait the next readable edge instead of spinning on the same data
+		if (length == prevLength && state == SKS_CONNECTED)
+		{
+			entry.bReadable = false;
+			return true;
+		}
+
+		entry.detector->onReadable(socket, length);
+		if (entry.bRemoved || socket.getState() == SKS_CLOSE)
+			return false;
+
+		prevLength = length;
+	}
+	return true;
+}
+
+void NetEventLoop::processEntry(Entry& entry)
+{
+	NetSocket& socket = *entry.socket;
+	SocketDetector& detector = *entry.detector;
+
+	switch (socket.getState())
+	{
+	case SKS_LISTING:
+		if (entry.bReadable)
+		{
+			entry.bReadable = false;
+			detector.onAcceptable(socket);
+		}
+		entry.bWritable = false;
+		break;
+	case SKS_CONNECTING:
+		if (entry.bWritable || entry.bError || entry.bHangup)
+		{
+			int error = 0;
+			FSocket::GetOption(socket.getHandle(), SO_ERROR, error);
+			entry.bReadable = false;
+			if (error == 0 && !entry.bError)
+			{
+				socket.mState = SKS_CONNECTED;
+				detector.onConnect(socket);
+			}
+			else
+			{
+				entry.bWritable = false;
+				socket.mState = SKS_CLOSE;
+				detector.onConnectFailed(socket);
+			}
+		}
+		break;
+	case SKS_CONNECTED:
+	case SKS_UDP:
+	case SKS_CONNECTED_UDP:
+		if (entry.bReadable)
+		{
+			if (!drainReadable(entry))
+				return;
+		}
+		if (entry.bWritable)
+		{
+			FSocket::ClearLastError();
+			detector.onSendable(socket);
+			if (entry.bRemoved || socket.getState() == SKS_CLOSE)
+				return;
+			//Wait the next writable edge
+			if (!entry.bPollSendable || FSocket::IsWouldBlockError(FSocket::GetLastError()))
+				entry.bWritable = false;
+		}
+		if (entry.bError)
+		{
+			entry.bError = false;
+			detector.onExcept(socket);
+		}
+		break;
+	default:
+		entry.bReadable = false;
+		entry.bWritable = false;
+	}
+}
@@ -5,12 +5,24 @@
 #include "CompilerConfig.h"
 
 #include "DataStructure/Array.h"
+#include "DataStructure/HashMap.h"
 
 #if SYS_PLATFORM_WIN
 #define  NOMINMAX
 #include <WinSock.h>
 #pragma comment(lib, "wsock32.lib")
 #include <Windows.h>
+#elif SYS_PLATFORM_LINUX
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR   (-1)
 #else
 #error "NetSockt not supported"
 #endif
@@ -18,9 +30,30 @@
 
 #define NET_INIT_OK 0
 
+#if SYS_PLATFORM_WIN
+typedef int SocketLength;
 extern WORD  gSockVersion;
+#else
+typedef socklen_t SocketLength;
+#endif
 
 class NetSocket;
+class NetAddress;
+
+//Element of a gather send , data is not copied
+struct NetSendBuffer
+{
+	char const* data;
+	size_t      size;
+};
+
+//One UDP packet of a batch send
+struct NetDatagram
+{
+	char const*       data;
+	size_t            size;
+	NetAddress const* addr;
+};
 
 
 class SocketDetector
@@ -107,7 +140,27 @@ class FSocket
 public:
 	static int GetLastError()
 	{
+#if SYS_PLATFORM_WIN
 		return ::WSAGetLastError();
+#else
+		return errno;
+#endif
+	}
+	static void ClearLastError()
+	{
+#if SYS_PLATFORM_WIN
+		::WSASetLastError(0);
+#else
+		errno = 0;
+#endif
+	}
+	static bool IsWouldBlockError(int error)
+	{
+#if SYS_PLATFORM_WIN
+		return error == WSAEWOULDBLOCK;
+#else
+		return error == EWOULDBLOCK || error == EAGAIN || error == EINPROGRESS;
+#endif
 	}
 	static SOCKET Create( int af, int type, int protocol )
 	{
@@ -117,7 +170,11 @@ public:
 	{
 		if ( handle == INVALID_SOCKET )
 			return;
+#if SYS_PLATFORM_WIN
 		int rVal = ::closesocket( handle );
+#else
+		int rVal = ::close( handle );
+#endif
 		if (rVal == SOCKET_ERROR)
 		{
 
@@ -133,7 +190,7 @@ public:
 	}
 	static bool GetOption(SOCKET handle, int option , int& value )
 	{
-		int len = sizeof(value);
+		SocketLength len = sizeof(value);
 		if ( getsockopt( handle , SOL_SOCKET , option , (char *)&value, &len ) == SOCKET_ERROR )
 			return false;
 		return true;
@@ -152,7 +209,7 @@ public:
 	static bool Connect(SOCKET handle, sockaddr const *to , int tolen )
 	{  
 		int ret = ::connect( handle , to , tolen ); 
-		if ( ret == SOCKET_ERROR && GetLastError()  != WSAEWOULDBLOCK )
+		if ( ret == SOCKET_ERROR && !IsWouldBlockError( GetLastError() ) )
 			return false;
 		return true;
 	}
@@ -162,12 +219,26 @@ public:
 	}
 	static int Recvfrom(SOCKET handle, char* buf , int len, int flags, sockaddr* addr , int lenAddr )
 	{  
-		return ::recvfrom( handle , buf , len , flags , addr , &lenAddr );  
+		SocketLength addrLength = lenAddr;
+		return ::recvfrom( handle , buf , len , flags , addr , &addrLength );  
 	}
 	static int Recv(SOCKET handle, char* buf , int len, int flags )
 	{  
 		return ::recv( handle , buf , len , flags );  
 	}
+	static bool GetReadableSize(SOCKET handle, int& outSize)
+	{
+#if SYS_PLATFORM_WIN
+		u_long size = 0;
+		if ( ::ioctlsocket( handle , FIONREAD , &size ) == SOCKET_ERROR )
+			return false;
+		outSize = int(size);
+#else
+		if ( ::ioctl( handle , FIONREAD , &outSize ) == SOCKET_ERROR )
+			return false;
+#endif
+		return true;
+	}
 	static int Select(SOCKET handle, fd_set* fRead , fd_set* fWrite , fd_set* fExcept , timeval const& timeout )
 	{
 		if ( fRead  ) FD_SET( handle , fRead );
@@ -201,6 +272,58 @@ struct NetSelectSet
 	fd_set mExcept;
 };
 
+// Readiness based socket dispatcher : epoll on Linux , select fallback on other platforms.
+// Only sockets with pending events are visited , so the cost of one dispatch doesn't grow with idle connections.
+// Connected sockets are edge-triggered , a readable socket is drained with onReadable until no data remains.
+// With bPollSendable , onSendable keeps being called every dispatch until a send would block ( the polling
+// the select loop provided ) , otherwise it is only called when the socket becomes writable again.
+class NetEventLoop
+{
+public:
+	NetEventLoop();
+	~NetEventLoop();
+
+	bool initialize();
+	void cleanup();
+
+	//Register the socket , also used to register again after the socket handle is changed
+	bool addSocket(NetSocket& socket, SocketDetector& detector, bool bPollSendable = true);
+	void removeSocket(NetSocket& socket);
+	//Return the number of sockets that got events
+	int  dispatch(uint32 timeoutMS);
+
+	int  getSocketNum() const { return mEntryMap.size(); }
+	static int GetMaxSocketNum();
+
+private:
+	struct Entry
+	{
+		NetSocket*      socket;
+		SocketDetector* detector;
+		bool bPollSendable;
+		bool bReadable;
+		bool bWritable;
+		bool bHangup;
+		bool bError;
+		bool bActive;
+		bool bRemoved;
+	};
+
+	void processEntry(Entry& entry);
+	bool drainReadable(Entry& entry);
+	void purgeRemovedEntries();
+
+	THashMap< NetSocket*, Entry* > mEntryMap;
+	TArray< Entry* > mActiveEntries;
+	TArray< Entry* > mRemovedEntries;
+#if SYS_PLATFORM_LINUX
+	int  mEpollHandle;
+	bool mbHavePendingRead;
+#else
+	NetSelectSet mSelectSet;
+#endif
+};
+
 class NetSocket
 {
 public:
@@ -237,6 +360,8 @@ public:	// TCP
 
 	int  recvData( char* data , size_t maxNum );
 	int  sendData( char const* data , size_t num );
+	//Gather send in one call (writev) , return the sent size or SOCKET_ERROR
+	int  sendData( NetSendBuffer const* buffers , int numBuffer );
 
 public: 	//UDP
 
@@ -256,6 +381,9 @@ public: 	//UDP
 	{
 		return sendData( data , num , (sockaddr*)&addr.mAddr , sizeof( addr.mAddr ) );
 	}
+	//Send packets to many addresses with as few system calls as possible (sendmmsg) ,
+	//return the number of packets sent , stop at the first packet that can't be sent
+	int  sendDatagrams( NetDatagram const* datagrams , int numDatagram );
 	void   close();
 
 	SOCKET getHandle() const { return mHandle; }
@@ -264,6 +392,7 @@ protected:
 	bool detectUDPInternal(SocketDetector& detector,NetSelectSet& selectSet);
 
 	friend class NetAddress;
+	friend class NetEventLoop;
 	
 	static char const* getIPByName( char const* AddrName );
 
@@ -0,0 +1,561 @@
+#include "Broadphase.h"
+
+#include "ProfileSystem.h"
+
+#include <algorithm>
+
+namespace Phy2D
+{
+	Broadphase::Broadphase()
+	{
+		mContactBreakThreshold = 0.1f;
+		mAABBMargin = 0.5f;
+		mNextProxyId = 0;
+		mNumProxy = 0;
+	}
+
+	Broadphase::~Broadphase()
+	{
+		for( auto iter = mProxys.begin(), itEnd = mProxys.end(); iter != itEnd ; )
+		{
+			CollisionProxy* proxy = *iter;
+			++iter;
+			proxy->object->mProxy = nullptr;
+			delete proxy;
+		}
+	}
+
+	CollisionProxy* Broadphase::addObject(CollideObject* obj)
+	{
+		CollisionProxy* proxy = new CollisionProxy;
+		proxy->object = obj;
+		proxy->id = mNextProxyId++;
+		proxy->broadphaseIndex = INDEX_NONE;
+		calcFatAABB( proxy , proxy->aabb );
+		obj->mProxy = proxy;
+		mProxys.push_back( proxy );
+		++mNumProxy;
+		onProxyAdded( proxy );
+		return proxy;
+	}
+
+	void Broadphase::removeObject(CollideObject* obj)
+	{
+		CollisionProxy* proxy = obj->mProxy;
+		if ( proxy )
+		{
+			assert( proxy->pairs.empty() );
+			onProxyRemoved( proxy );
+			proxy->hook.unlink();
+			delete proxy;
+			obj->mProxy = nullptr;
+			--mNumProxy;
+		}
+	}
+
+	void BruteForceBroadphase::process(ContactManager& pairManager , float dt)
+	{
+		for( CollisionProxy* proxy : mProxys )
+		{
+			calcFatAABB( proxy , proxy->aabb );
+		}
+
+		for( ProxyList::iterator iter = mProxys.begin(), itEnd = mProxys.end();
+			 iter != itEnd ; ++iter )
+		{
+			CollisionProxy* proxyA = *iter;
+			ProxyList::iterator iter2 = iter;
+			++iter2;
+			for(  ; iter2 != itEnd ; ++iter2 )
+			{
+				CollisionProxy* proxyB = *iter2;
+				if ( proxyA->aabb.isIntersect( proxyB->aabb ) )
+				{
+					pairManager.addProxyPair( proxyA , proxyB );
+				}
+			}
+		}
+
+		pairManager.removeSeparatedPairs();
+	}
+
+	SweepAndPruneBroadphase::SweepAndPruneBroadphase()
+	{
+		mNumRemoved = 0;
+		mSortAxis = 0;
+		mbNeedFullSort = false;
+	}
+
+	void SweepAndPruneBroadphase::onProxyAdded(CollisionProxy* proxy)
+	{
+		proxy->broadphaseIndex = mEntries.size();
+		Entry entry;
+		entry.min = proxy->aabb.min[mSortAxis];
+		entry.max = proxy->aabb.max[mSortAxis];
+		entry.proxy = proxy;
+		mEntries.push_back( entry );
+		//insertion sort is O(n) per new proxy , too slow when many proxies are added at once
+		mbNeedFullSort = true;
+	}
+
+	void SweepAndPruneBroadphase::onProxyRemoved(CollisionProxy* proxy)
+	{
+		assert( mEntries[proxy->broadphaseIndex].proxy == proxy );
+		mEntries[proxy->broadphaseIndex].proxy = nullptr;
+		++mNumRemoved;
+	}
+
+	void SweepAndPruneBroadphase::process(ContactManager& pairManager , float dt)
+	{
+		if ( mNumRemoved )
+		{
+			mEntries.removeAllPred([](Entry const& entry) { return entry.proxy == nullptr; });
+			mNumRemoved = 0;
+		}
+
+		float sum[2] = { 0 , 0 };
+		float sumSquare[2] = { 0 , 0 };
+		for( Entry& entry : mEntries )
+		{
+			CollisionProxy* proxy = entry.proxy;
+			calcFatAABB( proxy , proxy->aabb );
+			entry.min = proxy->aabb.min[mSortAxis];
+			entry.max = proxy->aabb.max[mSortAxis];
+
+			Vector2 center = proxy->aabb.getCenter();
+			sum[0] += center.x;
+			sum[1] += center.y;
+			sumSquare[0] += center.x * center.x;
+			sumSquare[1] += center.y * center.y;
+		}
+
+		if ( mbNeedFullSort )
+		{
+			std::sort( mEntries.begin() , mEntries.end() , [](Entry const& lhs, Entry const& rhs) { return lhs.min < rhs.min; });
+			mbNeedFullSort = false;
+		}
+		else
+		{
+			//objects move a little per frame , the order is almost sorted
+			for( int i = 1; i < mEntries.size(); ++i )
+			{
+				Entry entry = mEntries[i];
+				int j = i - 1;
+				for( ; j >= 0 && mEntries[j].min > entry.min ; --j )
+				{
+					mEntries[j + 1] = mEntries[j];
+				}
+				mEntries[j + 1] = entry;
+			}
+		}
+
+		int numEntry = mEntries.size();
+		for( int i = 0; i < numEntry; ++i )
+		{
+			Entry const& entry = mEntries[i];
+			entry.proxy->broadphaseIndex = i;
+			for( int j = i + 1; j < numEntry && mEntries[j].min <= entry.max; ++j )
+			{
+				if ( entry.proxy->aabb.isIntersect( mEntries[j].proxy->aabb ) )
+				{
+					pairManager.addProxyPair( entry.proxy , mEntries[j].proxy );
+				}
+			}
+		}
+
+		//sort the axis with larger variance next frame to reduce the overlapping intervals
+		if ( numEntry )
+		{
+			float variance[2];
+			for( int axis = 0; axis < 2; ++axis )
+			{
+				float mean = sum[axis] / numEntry;
+				variance[axis] = sumSquare[axis] / numEntry - mean * mean;
+			}
+			int axis = ( variance[1] > variance[0] ) ? 1 : 0;
+			if ( axis != mSortAxis )
+			{
+				mSortAxis = axis;
+				mbNeedFullSort = true;
+			}
+		}
+
+		pairManager.removeSeparatedPairs();
+	}
+
+	static AABB CombineAABB(AABB const& a, AABB const& b)
+	{
+		AABB result = a;
+		result += b;
+		return result;
+	}
+
+	static float GetPerimeter(AABB const& aabb)
+	{
+		Vector2 size = aabb.getSize();
+		return 2 * ( size.x + size.y );
+	}
+
+	DynamicAABBTree::DynamicAABBTree()
+	{
+		mRoot = NullNode;
+		mFreeList = NullNode;
+	}
+
+	void DynamicAABBTree::clear()
+	{
+		mNodes.clear();
+		mRoot = NullNode;
+		mFreeList = NullNode;
+	}
+
+	int DynamicAABBTree::allocateNode()
+	{
+		int nodeId;
+		if ( mFreeList != NullNode )
+		{
+			nodeId = mFreeList;
+			mFreeList = mNodes[nodeId].next;
+		}
+		else
+		{
+			nodeId = mNodes.size();
+			mNodes.push_back( Node() );
+		}
+
+		Node& node = mNodes[nodeId];
+		node.userData = nullptr;
+		node.parent = NullNode;
+		node.child1 = NullNode;
+		node.child2 = NullNode;
+		node.height = 0;
+		return nodeId;
+	}
+
+	void DynamicAABBTree::freeNode(int nodeId)
+	{
+		Node& node = mNodes[nodeId];
+		node.next = mFreeList;
+		node.height = -1;
+		mFreeList = nodeId;
+	}
+
+	int DynamicAABBTree::createProxy(AABB const& aabb, void* userData)
+	{
+		int proxyId = allocateNode();
+		Node& node = mNodes[proxyId];
+		node.aabb = aabb;
+		node.userData = userData;
+		insertLeaf( proxyId );
+		return proxyId;
+	}
+
+	void DynamicAABBTree::destroyProxy(int proxyId)
+	{
+		assert( mNodes.isValidIndex( proxyId ) && mNodes[proxyId].isLeaf() );
+		removeLeaf( proxyId );
+		freeNode( proxyId );
+	}
+
+	bool DynamicAABBTree::moveProxy(int proxyId, AABB const& aabb, AABB const& fatAABB)
+	{
+		assert( mNodes.isValidIndex( proxyId ) && mNodes[proxyId].isLeaf() );
+		if ( mNodes[proxyId].aabb.contain( aabb ) )
+			return false;
+
+		removeLeaf( proxyId );
+		mNodes[proxyId].aabb = fatAABB;
+		insertLeaf( proxyId );
+		return true;
+	}
+
+	void DynamicAABBTree::insertLeaf(int leaf)
+	{
+		if ( mRoot == NullNode )
+		{
+			mRoot = leaf;
+			mNodes[leaf].parent = NullNode;
+			return;
+		}
+
+		//find the best sibling by surface area heuristic
+		AABB leafAABB = mNodes[leaf].aabb;
+		int index = mRoot;
+		while( !mNodes[index].isLeaf() )
+		{
+			Node const& node = mNodes[index];
+			float area = GetPerimeter( node.aabb );
+			float combinedArea = GetPerimeter( CombineAABB( node.aabb , leafAABB ) );
+
+			//cost of creating a new parent for this node and the new leaf
+			float cost = 2 * combinedArea;
+			//minimum cost of pushing the leaf further down the tree
+			float inheritanceCost = 2 * ( combinedArea - area );
+
+			auto CalcDescendCost = [&](int childId)
+			{
+				Node const& child = mNodes[childId];
+				float newArea = GetPerimeter( CombineAABB( child.aabb , leafAABB ) );
+				if ( child.isLeaf() )
+					return newArea + inheritanceCost;
+				return ( newArea - GetPerimeter( child.aabb ) ) + inheritanceCost;
+			};
+
+			float cost1 = CalcDescendCost( node.child1 );
+			float cost2 = CalcDescendCost( node.child2 );
+			if ( cost < cost1 && cost < cost2 )
+				break;
+
+			index = ( cost1 < cost2 ) ? node.child1 : node.child2;
+		}
+
+		int sibling = index;
+		int oldParent = mNodes[sibling].parent;
+		int newParent = allocateNode();
+		{
+			Node& parentNode = mNodes[newParent];
+			parentNode.parent = oldParent;
+			parentNode.aabb = CombineAABB( leafAABB , mNodes[sibling].aabb );
+			parentNode.height = mNodes[sibling].height + 1;
+			parentNode.child1 = sibling;
+			parentNode.child2 = leaf;
+		}
+
+		if ( oldParent != NullNode )
+		{
+			if ( mNodes[oldParent].child1 == sibling )
+				mNodes[oldParent].child1 = newParent;
+			else
+				mNodes[oldParent].child2 = newParent;
+		}
+		else
+		{
+			mRoot = newParent;
+		}
+		mNodes[sibling].parent = newParent;
+		mNodes[leaf].parent = newParent;
+
+		//walk back up the tree fixing heights and AABBs
+		index = mNodes[leaf].parent;
+		while( index != NullNode )
+		{
+			index = balance( index );
+
+			Node& node = mNodes[index];
+			node.height = 1 + Math::Max( mNodes[node.child1].height , mNodes[node.child2].height );
+			node.aabb = CombineAABB( mNodes[node.child1].aabb , mNodes[node.child2].aabb );
+			index = node.parent;
+		}
+	}
+
+	void DynamicAABBTree::removeLeaf(int leaf)
+	{
+		if ( leaf == mRoot )
+		{
+			mRoot = NullNode;
+			return;
+		}
+
+		int parent = mNodes[leaf].parent;
+		int grandParent = mNodes[parent].parent;
+		int sibling = ( mNodes[parent].child1 == leaf ) ? mNodes[parent].child2 : mNodes[parent].child1;
+
+		if ( grandParent != NullNode )
+		{
+			//destroy parent and connect sibling to grandParent
+			if ( mNodes[grandParent].child1 == parent )
+				mNodes[grandParent].child1 = sibling;
+			else
+				mNodes[grandParent].child2 = sibling;
+			mNodes[sibling].parent = grandParent;
+			freeNode( parent );
+
+			int index = grandParent;
+			while( index != NullNode )
+			{
+				index = balance( index );
+
+				Node& node = mNodes[index];
+				node.height = 1 + Math::Max( mNodes[node.child1].height , mNodes[node.child2].height );
+				node.aabb = CombineAABB( mNodes[node.child1].aabb , mNodes[node.child2].aabb );
+				index = node.parent;
+			}
+		}
+		else
+		{
+			mRoot = sibling;
+			mNodes[sibling].parent = NullNode;
+			freeNode( parent );
+		}
+	}
+
+	// Perform a left or right rotation if node A is imbalanced , return the new root index
+	int DynamicAABBTree::balance(int iA)
+	{
+		Node& A = mNodes[iA];
+		if ( A.isLeaf() || A.height < 2 )
+			return iA;
+
+		int iB = A.child1;
+		int iC = A.child2;
+		Node& B = mNodes[iB];
+		Node& C = mNodes[iC];
+
+		int balanceValue = C.height - B.height;
+
+		//rotate C up
+		if ( balanceValue > 1 )
+		{
+			int iF = C.child1;
+			int iG = C.child2;
+			Node& F = mNodes[iF];
+			Node& G = mNodes[iG];
+
+			C.child1 = iA;
+			C.parent = A.parent;
+			A.parent = iC;
+
+			if ( C.parent != NullNode )
+			{
+				if ( mNodes[C.parent].child1 == iA )
+					mNodes[C.parent].child1 = iC;
+				else
+					mNodes[C.parent].child2 = iC;
+			}
+			else
+			{
+				mRoot = iC;
+			}
+
+			if ( F.height > G.height )
+			{
+				C.child2 = iF;
+				A.child2 = iG;
+				G.parent = iA;
+				A.aabb = CombineAABB( B.aabb , G.aabb );
+				C.aabb = CombineAABB( A.aabb , F.aabb );
+				A.height = 1 + Math::Max( B.height , G.height );
+				C.height = 1 + Math::Max( A.height , F.height );
+			}
+			else
+			{
+				C.child2 = iG;
+				A.child2 = iF;
+				F.parent = iA;
+				A.aabb = CombineAABB( B.aabb , F.aabb );
+				C.aabb = CombineAABB( A.aabb , G.aabb );
+				A.height = 1 + Math::Max( B.height , F.height );
+				C.height = 1 + Math::Max( A.height , G.height );
+			}
+			return iC;
+		}
+
+		//rotate B up
+		if ( balanceValue < -1 )
+		{
+			int iD = B.child1;
+			int iE = B.child2;
+			Node& D = mNodes[iD];
+			Node& E = mNodes[iE];
+
+			B.child1 = iA;
+			B.parent = A.parent;
+			A.parent = iB;
+
+			if ( B.parent != NullNode )
+			{
+				if ( mNodes[B.parent].child1 == iA )
+					mNodes[B.parent].child1 = iB;
+				else
+					mNodes[B.parent].child2 = iB;
+			}
+			else
+			{
+				mRoot = iB;
+			}
+
+			if ( D.height > E.height )
+			{
+				B.child2 = iD;
+				A.child1 = iE;
+				E.parent = iA;
+				A.aabb = CombineAABB( C.aabb , E.aabb );
+				B.aabb = CombineAABB( A.aabb , D.aabb );
+				A.height = 1 + Math::Max( C.height , E.height );
+				B.height = 1 + Math::Max( A.height , D.height );
+			}
+			else
+			{
+				B.child2 = iE;
+				A.child1 = iD;
+				D.parent = iA;
+				A.aabb = CombineAABB( C.aabb , D.aabb );
+				B.aabb = CombineAABB( A.aabb , E.aabb );
+				A.height = 1 + Math::Max( C.height , D.height );
+				B.height = 1 + Math::Max( A.height , E.height );
+			}
+			return iB;
+		}
+
+		return iA;
+	}
+
+	void DynamicTreeBroadphase::onProxyAdded(CollisionProxy* proxy)
+	{
+		proxy->broadphaseIndex = mTree.createProxy( proxy->aabb , proxy );
+		mMoveBuffer.push_back( proxy );
+	}
+
+	void DynamicTreeBroadphase::onProxyRemoved(CollisionProxy* proxy)
+	{
+		mTree.destroyProxy( proxy->broadphaseIndex );
+		mMoveBuffer.removeSwap( proxy );
+	}
+
+	void DynamicTreeBroadphase::process(ContactManager& pairManager , float dt)
+	{
+		for( CollisionProxy* proxy : mProxys )
+		{
+			AABB aabb;
+			calcObjectAABB( proxy , aabb );
+			if ( proxy->aabb.contain( aabb ) )
+				continue;
+
+			AABB fatAABB = aabb;
+			fatAABB.expand( Vector2( mAABBMargin , mAABBMargin ) );
+			mTree.moveProxy( proxy->broadphaseIndex , aabb , fatAABB );
+			proxy->aabb = fatAABB;
+			mMoveBuffer.push_back( proxy );
+		}
+
+		//only the proxies leaving their fat AABB can make new pairs
+		for( CollisionProxy* proxy : mMoveBuffer )
+		{
+			mTree.query( proxy->aabb , [this, proxy, &pairManager](int proxyId)
+			{
+				CollisionProxy* other = static_cast< CollisionProxy* >( mTree.getUserData( proxyId ) );
+				if ( other != proxy )
+				{
+					pairManager.addProxyPair( proxy , other );
+				}
+				return true;
+			});
+		}
+		mMoveBuffer.clear();
+
+		pairManager.removeSeparatedPairs();
+	}
+
+	Broadphase* CreateBroadphase(EBroadphase type)
+	{
+		switch( type )
+		{
+		case EBroadphase::BruteForce:    return new BruteForceBroadphase;
+		case EBroadphase::SweepAndPrune: return new SweepAndPruneBroadphase;
+		case EBroadphase::DynamicTree:   return new DynamicTreeBroadphase;
+		}
+		NEVER_REACH("Unknown broadphase type");
+		return nullptr;
+	}
+
+}//namespace Phy2D
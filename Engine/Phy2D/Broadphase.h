@@ -0,0 +1,183 @@
+#pragma once
+#ifndef Broadphase_h__DAADDD5E_C933_4FEF_838A_38EED35C32CA
+#define Broadphase_h__DAADDD5E_C933_4FEF_838A_38EED35C32CA
+
+#include "Phy2D/Collision.h"
+
+namespace Phy2D
+{
+	class Broadphase
+	{
+	public:
+		Broadphase();
+		virtual ~Broadphase();
+
+		CollisionProxy* addObject( CollideObject* obj );
+		void removeObject( CollideObject* obj );
+
+		// Only add overlapping pairs, pairs are removed by ContactManager::removeSeparatedPairs
+		virtual void process( ContactManager& pairManager , float dt ) = 0;
+
+		int   getProxyNum() const { return mNumProxy; }
+
+		float mContactBreakThreshold;
+		// Extra size of proxy AABB, larger margin means less tree update but more pairs
+		float mAABBMargin;
+
+		typedef TIntrList<
+			CollisionProxy ,
+			MemberHook< CollisionProxy , &CollisionProxy::hook > ,
+			PointerType
+		> ProxyList;
+		ProxyList mProxys;
+
+	protected:
+		virtual void onProxyAdded( CollisionProxy* proxy ){}
+		virtual void onProxyRemoved( CollisionProxy* proxy ){}
+
+		void calcObjectAABB( CollisionProxy* proxy , AABB& outAABB )
+		{
+			CollideObject* object = proxy->object;
+			object->mShape->calcAABB( object->mXForm , outAABB );
+			outAABB.expand( Vector2( mContactBreakThreshold , mContactBreakThreshold ) );
+		}
+		void calcFatAABB( CollisionProxy* proxy , AABB& outAABB )
+		{
+			calcObjectAABB( proxy , outAABB );
+			outAABB.expand( Vector2( mAABBMargin , mAABBMargin ) );
+		}
+
+		uint32 mNextProxyId;
+		int    mNumProxy;
+	};
+
+	// O(n^2) , reference implementation
+	class BruteForceBroadphase : public Broadphase
+	{
+	public:
+		void process( ContactManager& pairManager , float dt ) override;
+	};
+
+	// Sort proxies along one axis and sweep the overlapping intervals.
+	// The sorted order is kept between frames, so insertion sort runs in almost O(n)
+	class SweepAndPruneBroadphase : public Broadphase
+	{
+	public:
+		SweepAndPruneBroadphase();
+		void process( ContactManager& pairManager , float dt ) override;
+
+	protected:
+		void onProxyAdded( CollisionProxy* proxy ) override;
+		void onProxyRemoved( CollisionProxy* proxy ) override;
+
+		struct Entry
+		{
+			float min;
+			float max;
+			CollisionProxy* proxy;
+		};
+		TArray< Entry > mEntries;
+		int  mNumRemoved;
+		int  mSortAxis;
+		bool mbNeedFullSort;
+	};
+
+	// Box2D style dynamic AABB tree , leaf AABBs are fattened so that moving objects rarely need update
+	class DynamicAABBTree
+	{
+	public:
+		static constexpr int NullNode = -1;
+
+		DynamicAABBTree();
+
+		int   createProxy( AABB const& aabb , void* userData );
+		void  destroyProxy( int proxyId );
+		// return true if the leaf is reinserted
+		bool  moveProxy( int proxyId , AABB const& aabb , AABB const& fatAABB );
+		void  clear();
+
+		void*       getUserData( int proxyId ) const { return mNodes[proxyId].userData; }
+		AABB const& getFatAABB( int proxyId ) const { return mNodes[proxyId].aabb; }
+		int         getHeight() const { return ( mRoot == NullNode ) ? 0 : mNodes[mRoot].height; }
+
+		// func( int proxyId ) return false to stop the query
+		template< class TFunc >
+		void query( AABB const& aabb , TFunc&& func ) const
+		{
+			if ( mRoot == NullNode )
+				return;
+
+			TArray< int , TInlineAllocator< 256 > > stack;
+			stack.push_back( mRoot );
+			while( !stack.empty() )
+			{
+				int nodeId = stack.back();
+				stack.pop_back();
+
+				Node const& node = mNodes[nodeId];
+				if ( !node.aabb.isIntersect( aabb ) )
+					continue;
+
+				if ( node.isLeaf() )
+				{
+					if ( !func( nodeId ) )
+						return;
+				}
+				else
+				{
+					stack.push_back( node.child1 );
+					stack.push_back( node.child2 );
+				}
+			}
+		}
+
+	private:
+		struct Node
+		{
+			AABB  aabb;
+			void* userData;
+			union
+			{
+				int parent;
+				int next;
+			};
+			int child1;
+			int child2;
+			// leaf = 0 , free node = -1
+			int height;
+
+			bool isLeaf() const { return child1 == NullNode; }
+		};
+
+		int   allocateNode();
+		void  freeNode( int nodeId );
+		void  insertLeaf( int leaf );
+		void  removeLeaf( int leaf );
+		int   balance( int nodeId );
+
+		TArray< Node > mNodes;
+		int   mRoot;
+		int   mFreeList;
+	};
+
+	class DynamicTreeBroadphase : public Broadphase
+	{
+	public:
+		void process( ContactManager& pairManager , float dt ) override;
+
+		DynamicAABBTree const& getTree() const { return mTree; }
+
+	protected:
+		void onProxyAdded( CollisionProxy* proxy ) override;
+		void onProxyRemoved( CollisionProxy* proxy ) override;
+
+		DynamicAABBTree mTree;
+		// proxies need to query new pairs
+		TArray< CollisionProxy* > mMoveBuffer;
+	};
+
+	Broadphase* CreateBroadphase( EBroadphase type );
+
+}//namespace Phy2D
+
+#endif // Broadphase_h__DAADDD5E_C933_4FEF_838A_38EED35C32CA
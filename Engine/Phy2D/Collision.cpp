@@ -1,6 +1,7 @@
 #include "Collision.h"
 
 #include "Phy2D/RigidBody.h"
+#include "Phy2D/Broadphase.h"
 #include "Collision2D/SATSolver.h"
 #include "ProfileSystem.h"
 
@@ -61,11 +62,100 @@ namespace Phy2D
 		RegisterAlgo(Shape::eBox, Shape::eBox, StaticBoxBoxAlgo);        // Enable specialized box-box collision
 		
 		mDefaultConvexAlgo = &StaticGJKAlgo;
+
+		mBroadphaseType = EBroadphase::DynamicTree;
+		mBroadphase = CreateBroadphase( mBroadphaseType );
+	}
+
+	CollisionManager::~CollisionManager()
+	{
+		delete mBroadphase;
+	}
+
+	void CollisionManager::addObject(CollideObject* obj)
+	{
+		mBroadphase->addObject( obj );
+	}
+
+	void CollisionManager::removeObject(CollideObject* obj)
+	{
+		if ( obj->mProxy )
+		{
+			mPairManager.removeProxy( obj->mProxy );
+		}
+		mBroadphase->removeObject( obj );
+	}
+
+	void CollisionManager::setBroadphase(EBroadphase type)
+	{
+		if ( mBroadphaseType == type )
+			return;
+
+		TArray< CollideObject* > objects;
+		for( CollisionProxy* proxy : mBroadphase->mProxys )
+		{
+			objects.push_back( proxy->object );
+		}
+		for( CollideObject* obj : objects )
+		{
+			removeObject( obj );
+		}
+		mMainifolds.clear();
+
+		delete mBroadphase;
+		mBroadphaseType = type;
+		mBroadphase = CreateBroadphase( type );
+		for( CollideObject* obj : objects )
+		{
+			addObject( obj );
+		}
+	}
+
+	static bool IsSleepingOrStatic(RigidBody* body)
+	{
+		return body->mMotionType == BodyMotion::eStatic || 
+			( body->mMotionType == BodyMotion::eDynamic && !body->isAwake() );
+	}
+
+	// Contact algorithms rebuild the points every frame , carry the accumulated impulses
+	// of the closest old point over so the solver can warm start
+	static void MatchManifoldPoints(ContactManifold& manifold, ManifoldPoint const* oldPoints, int numOldPoints)
+	{
+		float const MatchDistance = 0.1f;
+		for (int i = 0; i < manifold.mNumContacts; ++i)
+		{
+			ManifoldPoint& point = manifold.mPoints[i];
+			float minDistSquare = MatchDistance * MatchDistance;
+			ManifoldPoint const* matchPoint = nullptr;
+			for (int j = 0; j < numOldPoints; ++j)
+			{
+				float distSquare = ( oldPoints[j].posLocal[0] - point.posLocal[0] ).length2();
+				if ( distSquare < minDistSquare )
+				{
+					minDistSquare = distSquare;
+					matchPoint = &oldPoints[j];
+				}
+			}
+
+			if ( matchPoint )
+			{
+				point.normalImpulse = matchPoint->normalImpulse;
+				point.tangentImpulse = matchPoint->tangentImpulse;
+			}
+			else
+			{
+				point.normalImpulse = 0;
+				point.tangentImpulse = 0;
+			}
+		}
 	}
 
 	void CollisionManager::preocss(float dt)
 	{
-		mBroadphase.process( mPairManager , dt );
+		{
+			PROFILE_ENTRY("Phy2D.Broadphase");
+			mBroadphase->process( mPairManager , dt );
+		}
 
 		for (ProxyPair* pair : mPairManager.mProxyList)
 		{
@@ -79,22 +169,33 @@ namespace Phy2D
 				continue;
 			}
 			
+			RigidBody* bodyA = static_cast< RigidBody* >( objA );
+			RigidBody* bodyB = static_cast< RigidBody* >( objB );
 			// Skip if both are static
-			if ( static_cast< RigidBody* >( objA )->mMotionType == BodyMotion::eStatic && 
-				 static_cast< RigidBody* >( objB )->mMotionType == BodyMotion::eStatic )
+			if ( bodyA->mMotionType == BodyMotion::eStatic && 
+				 bodyB->mMotionType == BodyMotion::eStatic )
 			{
 				continue;
 			}
-			
+
+			// Sleeping contacts are kept as is , the island will be skipped by solver
+			if ( IsSleepingOrStatic( bodyA ) && IsSleepingOrStatic( bodyB ) )
+			{
+				if ( pair->manifold.mNumContacts )
+					pair->manifold.mAge = 0;
+				continue;
+			}
+
+			ManifoldPoint oldPoints[MaxManifoldPoints];
+			int numOldPoints = pair->manifold.mNumContacts;
+			std::copy_n( pair->manifold.mPoints , numOldPoints , oldPoints );
+
 			// CRITICAL FIX: Check if collision exists before using manifold
 			if ( testManifold(objA, objB, pair->manifold) )
 			{
 				// Collision detected, manifold is populated with contact data
 				// Mark manifold as active (will be picked up by update())
-				if (pair->manifold.mAge != 0)
-				{
-					// This is a continuing contact, preserve it
-				}
+				MatchManifoldPoints( pair->manifold , oldPoints , numOldPoints );
 			}
 			else
 			{
@@ -118,72 +219,41 @@ namespace Phy2D
 
 	}
 
-	void Broadphase::process( ContactManager& pairManager , float dt )
+	ContactManager::~ContactManager()
 	{
-		for(CollisionProxy* proxy : mProxys)
-		{
-			CollideObject* object = proxy->object;
-			object->mShape->calcAABB( object->mXForm , proxy->aabb );
-			Vector2 dp = Vector2( mContactBreakThreshold + 0.5  , mContactBreakThreshold + 0.5 );
-			proxy->aabb.min -= dp;
-			proxy->aabb.max += dp;
-		}
-
-		for( ProxyList::iterator iter = mProxys.begin(), itEnd = mProxys.end(); 
-			 iter != itEnd ; ++iter )
+		for( auto iter = mProxyList.begin(), itEnd = mProxyList.end(); iter != itEnd ; )
 		{
-			CollisionProxy* proxyA = *iter;
-			ProxyList::iterator iter2 = iter; 
-			++iter2;
-			for(  ; iter2 != itEnd ; ++iter2 )
-			{
-				CollisionProxy* proxyB = *iter2;
-				if ( proxyA->aabb.isIntersect( proxyB->aabb ) )
-				{
-					pairManager.addProxyPair( proxyA , proxyB );
-				}
-				else
-				{
-					pairManager.removeProxyPair( proxyA , proxyB );
-				}
-			}
+			ProxyPair* pair = *iter;
+			++iter;
+			delete pair;
 		}
 	}
 
-
-
 	ProxyPair* ContactManager::findProxyPair(CollisionProxy* proxyA , CollisionProxy* proxyB)
 	{
-		for( ProxyPairList::iterator iter = mProxyList.begin(), itEnd = mProxyList.end() ; 
-			 iter != itEnd ; ++iter )
+		if ( proxyA->id > proxyB->id )
 		{
-			ProxyPair* pair = *iter;
-			if ( pair->proxy[0] == proxyA && pair->proxy[1] == proxyB )
-				return pair;
+			std::swap(proxyA, proxyB);
 		}
-
-		//for( int i = 0; i < proxyA->pairs.size() ; ++i )
-		//{
-		//	ProxyPair* pair = proxyA->pairs[i];
-		//	if ( pair->proxy[0] == proxyB || pair->proxy[1] == proxyB )
-		//		return pair;
-		//}
-		return NULL;
+		ProxyPair** pPair = mPairMap.findValue( MakePairKey( proxyA , proxyB ) );
+		return pPair ? *pPair : nullptr;
 	}
 
 	bool ContactManager::addProxyPair(CollisionProxy* proxyA , CollisionProxy* proxyB)
 	{
-		if (proxyA > proxyB)
+		if ( proxyA->id > proxyB->id )
 		{
 			std::swap(proxyA, proxyB);
 		}
-		ProxyPair* pair = findProxyPair( proxyA , proxyB );
-		if ( pair )
+
+		auto result = mPairMap.tryEmplace( MakePairKey( proxyA , proxyB ) , nullptr );
+		if ( !result.second )
 			return false;
 
-		pair = new ProxyPair;
+		ProxyPair* pair = new ProxyPair;
 		pair->proxy[0] = proxyA;
 		pair->proxy[1] = proxyB;
+		result.first->second = pair;
 
 		mProxyList.push_back( pair );
 		proxyA->pairs.push_back( pair );
@@ -193,19 +263,47 @@ namespace Phy2D
 
 	bool ContactManager::removeProxyPair(CollisionProxy* proxyA , CollisionProxy* proxyB)
 	{
-		if (proxyA > proxyB)
-		{
-			std::swap(proxyA, proxyB);
-		}
 		ProxyPair* pair = findProxyPair( proxyA , proxyB );
 		if ( pair == NULL )
 			return false;
 
+		pair->proxy[0]->remove( pair );
+		pair->proxy[1]->remove( pair );
+		destroyPair( pair );
+		return true;
+	}
+
+	void ContactManager::removeProxy(CollisionProxy* proxy)
+	{
+		for( ProxyPair* pair : proxy->pairs )
+		{
+			CollisionProxy* other = ( pair->proxy[0] == proxy ) ? pair->proxy[1] : pair->proxy[0];
+			other->remove( pair );
+			destroyPair( pair );
+		}
+		proxy->pairs.clear();
+	}
+
+	void ContactManager::removeSeparatedPairs()
+	{
+		for( auto iter = mProxyList.begin(), itEnd = mProxyList.end(); iter != itEnd ; )
+		{
+			ProxyPair* pair = *iter;
+			++iter;
+			if ( !pair->proxy[0]->aabb.isIntersect( pair->proxy[1]->aabb ) )
+			{
+				pair->proxy[0]->remove( pair );
+				pair->proxy[1]->remove( pair );
+				destroyPair( pair );
+			}
+		}
+	}
+
+	void ContactManager::destroyPair(ProxyPair* pair)
+	{
+		mPairMap.erase( MakePairKey( pair->proxy[0] , pair->proxy[1] ) );
 		pair->hook.unlink();
-		proxyA->remove( pair );
-		proxyB->remove( pair );
 		delete pair;
-		return true;
 	}
 
 	void MinkowskiBase::init(CollideObject& objA, Shape& shapeA, CollideObject& objB, Shape& shapeB)
@@ -6,6 +6,7 @@
 
 #include "DataStructure/IntrList.h"
 #include "DataStructure/Array.h"
+#include "DataStructure/HashMap.h"
 
 #include <algorithm>
 
@@ -14,6 +15,7 @@ namespace Phy2D
 
 	struct CollisionProxy;
 	struct ProxyPair;
+	class  Broadphase;
 
 	class PhyObject
 	{
@@ -213,13 +215,16 @@ namespace Phy2D
 	struct CollisionProxy
 	{
 		CollideObject*  object;
+		// AABB used by broadphase , pair is kept until the AABBs are separated
 		AABB aabb;
+		uint32 id;
+		int    broadphaseIndex;
 
 		LinkHook hook;
 		TArray< ProxyPair* > pairs;
 		void remove( ProxyPair* pair )
 		{
-			pairs.erase( std::find( pairs.begin() , pairs.end() , pair ) );
+			pairs.removeSwap( pair );
 		}
 	};
 
@@ -238,70 +243,47 @@ namespace Phy2D
 	class ContactManager
 	{
 	public:
+		~ContactManager();
+
 		ProxyPair* findProxyPair( CollisionProxy* proxyA , CollisionProxy* proxyB );
 		bool addProxyPair( CollisionProxy* proxyA , CollisionProxy* proxyB );
 		bool removeProxyPair( CollisionProxy* proxyA , CollisionProxy* proxyB );
+		void removeProxy( CollisionProxy* proxy );
+		void removeSeparatedPairs();
 
-		
-		ProxyPairList mProxyList;
-	};
+		int  getPairNum() const { return mPairMap.size(); }
 
-	class Broadphase
-	{
-	public:
-		Broadphase()
+		static uint64 MakePairKey( CollisionProxy* proxyA , CollisionProxy* proxyB )
 		{
-			mContactBreakThreshold = 0.1f;
-		}
-		void addObject( CollideObject* obj )
-		{
-			CollisionProxy* proxy = new CollisionProxy;
-			proxy->object = obj;
-			obj->mProxy = proxy;
-			mProxys.push_back( proxy );
-		}
-		void removeObject( CollideObject* obj )
-		{
-			CollisionProxy* proxy = obj->mProxy;
-			if ( proxy )
-			{
-#if 1
-				proxy->hook.unlink();
-#else
-				mProxys.remove(proxy);
-#endif
-				delete proxy;
-			}
+			assert( proxyA->id < proxyB->id );
+			return ( uint64( proxyA->id ) << 32 ) | uint64( proxyB->id );
 		}
 
-		void process( ContactManager& pairManager , float dt );
-		float mContactBreakThreshold;
-	
-#if 1
-		typedef TIntrList< 
-			CollisionProxy , 
-			MemberHook< CollisionProxy , &CollisionProxy::hook > , 
-			PointerType 
-		> ProxyList;		
-#else
-		using ProxyList = TArray< CollisionProxy* >;
-#endif
-		ProxyList mProxys;
+		ProxyPairList mProxyList;
+		THashMap< uint64 , ProxyPair* > mPairMap;
+
+	private:
+		void destroyPair( ProxyPair* pair );
+	};
+
+	enum class EBroadphase
+	{
+		BruteForce ,
+		SweepAndPrune ,
+		DynamicTree ,
 	};
 
 	class CollisionManager
 	{
 	public:
 		CollisionManager();
+		~CollisionManager();
 
-		void addObject( CollideObject* obj )
-		{
-			mBroadphase.addObject( obj );
-		}
-		void removeObject( CollideObject* obj )
-		{
-			mBroadphase.removeObject( obj );
-		}
+		void addObject( CollideObject* obj );
+		void removeObject( CollideObject* obj );
+
+		void setBroadphase( EBroadphase type );
+		EBroadphase getBroadphaseType() const { return mBroadphaseType; }
 
 		bool testManifold(CollideObject* objA, CollideObject* objB, ContactManifold& manifold)
 		{                                                                
@@ -323,7 +305,8 @@ namespace Phy2D
 		CollisionAlgo*   mDefaultConvexAlgo;
 		CollisionAlgo*   mMap[ Shape::NumShape * Shape::NumShape / 2 ];
 		ContactManager   mPairManager;
-		Broadphase       mBroadphase;
+		Broadphase*      mBroadphase;
+		EBroadphase      mBroadphaseType;
 		TArray< ContactManifold* > mMainifolds;
 	};
 
@@ -8,6 +8,7 @@ namespace Phy2D
 			return;
 
 		mMotionType = type;
+		setAwake( true );
 		switch( mMotionType )
 		{
 		case BodyMotion::eStatic:
@@ -41,6 +41,9 @@ namespace Phy2D
 			,mAngularVel(0)
 			,mLinearImpulse(0,0)
 			,mAngularImpulse(0)
+			,mbAwake(true)
+			,mSleepTime(0)
+			,mIslandIndex(INDEX_NONE)
 		{
 
 
@@ -52,6 +55,23 @@ namespace Phy2D
 		void             setMotionType( BodyMotion::Type type );
 		BodyMotion::Type getMotionType() const { return mMotionType; }
 
+		bool isAwake() const { return mbAwake; }
+		void setAwake( bool bAwake )
+		{
+			if ( bAwake )
+			{
+				mbAwake = true;
+				mSleepTime = 0;
+			}
+			else
+			{
+				mbAwake = false;
+				mSleepTime = 0;
+				mLinearVel = Vector2::Zero();
+				mAngularVel = 0;
+			}
+		}
+
 	
 		void intergedTramsform( float dt )
 		{
@@ -86,17 +106,20 @@ namespace Phy2D
 
 		void addImpulse( Vector2 const& pos , Vector2 const& impulse )
 		{
+			mbAwake = true;
 			mLinearImpulse += impulse;
 			mAngularImpulse += ( pos - mPosCenter ).cross( impulse );
 		}
 
 		void addLinearImpulse( Vector2 const& impulse )
 		{
+			mbAwake = true;
 			mLinearImpulse += impulse;
 		}
 
 		void addAngularImpulse( float impulse )
 		{
+			mbAwake = true;
 			mAngularImpulse += impulse;
 		}
 
@@ -133,6 +156,10 @@ namespace Phy2D
 
 
 		BodyMotion::Type mMotionType;
+		bool   mbAwake;
+		float  mSleepTime;
+		// Index in the solver union-find , valid only during World::simulate
+		int    mIslandIndex;
 		Vector2  mLinearVel;
 		float  mAngularVel;
 		float  mDensity;
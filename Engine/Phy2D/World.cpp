@@ -3,23 +3,46 @@
 #include "Phy2D/Shape.h"
 #include "Phy2D/RigidBody.h"
 
+#include "ProfileSystem.h"
+#include "Async/ParallelFor.h"
 #include "LogSystem.h"
 
+#include <algorithm>
+
 
 namespace Phy2D
 {
 	void EmptyDebugJump(){}
 	DebugJumpFunc GDebugJumpFun = EmptyDebugJump;
 
+	static bool IsDynamic(RigidBody* body)
+	{
+		return body->getMotionType() == BodyMotion::eDynamic;
+	}
+
+	// Non-dynamic bodies may be shared by islands solving in parallel , never write them
+	static void ApplyVelocityImpulse(RigidBody* body, Vector2 const& P, float angularImpulse)
+	{
+		if ( !IsDynamic( body ) )
+			return;
+		body->mLinearVel += P * body->mInvMass;
+		body->mAngularVel += angularImpulse * body->mInvI;
+	}
+
+	static void ApplyPositionImpulse(RigidBody* body, Vector2 const& P, float angularImpulse)
+	{
+		if ( !IsDynamic( body ) )
+			return;
+		body->mXForm.translate( P * body->mInvMass );
+		body->mRotationAngle += angularImpulse * body->mInvI;
+		body->synTransform();
+	}
+
 	void World::simulate(float dt)
 	{
 		//LogDevMsg(0,"World::sim");
 		mAllocator.clearFrame();
 
-		// Box2D default iteration counts
-		int vIterNum = 10;   // Increased for stability
-		int pIterNum = 10;   // Increased from 3 to 10 to handle deep stacks
-
 		mColManager.preocss( dt );
 
 		for( RigidBodyList::iterator iter = mRigidBodies.begin() ,itEnd = mRigidBodies.end();
@@ -27,38 +50,231 @@ namespace Phy2D
 		{
 			RigidBody* body = *iter;
 			body->saveState();
-			if ( body->getMotionType() != BodyMotion::eStatic )
-			{
-				if ( body->getMotionType() == BodyMotion::eDynamic )
-					body->addLinearImpulse( body->mMass * mGrivaty * dt );
+			if ( body->getMotionType() == BodyMotion::eKinematic )
 				body->applyImpulse();
+		}
+
+		{
+			PROFILE_ENTRY("Phy2D.BuildIslands");
+			buildIslands();
+		}
 
+		{
+			PROFILE_ENTRY("Phy2D.SolveIslands");
+			int numIsland = (int)mIslands.size();
+			if ( mThreadPool && numIsland > 1 )
+			{
+				// Islands are sorted by size , small islands are batched to reduce the dispatch cost
+				int batchSize = Math::Max( 1 , numIsland / ( 4 * Math::Max( 1 , mThreadPool->getAllThreadNum() ) ) );
+				ParallelFor(*mThreadPool, mAllocator, "Phy2D.SolveIsland", numIsland, [this, dt](int index)
+				{
+					solveIsland( mIslands[index] , dt , false );
+				}, batchSize);
+			}
+			else
+			{
+				for( Island const& island : mIslands )
+				{
+					solveIsland( island , dt , true );
+				}
 			}
 		}
 
-		ContactManifold** sortedContact = new ( mAllocator ) ContactManifold* [ mColManager.mMainifolds.size() ];
-		int numMainfold = mColManager.mMainifolds.size(); 
+		// Kinematic bodies are shared by islands , move them after all islands are solved
+		for( RigidBodyList::iterator iter = mRigidBodies.begin() ,itEnd = mRigidBodies.end();
+			iter != itEnd ; ++iter )
+		{
+			RigidBody* body = *iter;
+			if ( body->getMotionType() == BodyMotion::eKinematic )
+				body->intergedTramsform( dt );
+		}
+	}
 
-		int idxStatic = mColManager.mMainifolds.size() - 1;
-		int idxNormal = 0;
+	void World::buildIslands()
+	{
+		mIslands.clear();
+		mIslandBodies.clear();
+		mIslandManifolds.clear();
 
-		for( int i = 0 ; i < mColManager.mMainifolds.size() ; ++i )
+		int numDynamic = 0;
+		for( RigidBody* body : mRigidBodies )
 		{
-			ContactManifold& cm = *mColManager.mMainifolds[i];
+			body->mIslandIndex = IsDynamic( body ) ? numDynamic++ : INDEX_NONE;
+		}
+		if ( numDynamic == 0 )
+			return;
+
+		// Union-find dynamic bodies connected by contacts
+		int* parents = new ( mAllocator ) int[ numDynamic ];
+		RigidBody** dynamicBodies = new ( mAllocator ) RigidBody*[ numDynamic ];
+		for( RigidBody* body : mRigidBodies )
+		{
+			if ( body->mIslandIndex != INDEX_NONE )
+			{
+				parents[body->mIslandIndex] = body->mIslandIndex;
+				dynamicBodies[body->mIslandIndex] = body;
+			}
+		}
 
-			RigidBody* bodyA = static_cast< RigidBody* >( cm.mContact.object[0] );
-			RigidBody* bodyB = static_cast< RigidBody* >( cm.mContact.object[1] );
+		auto FindRoot = [parents](int index)
+		{
+			while( parents[index] != index )
+			{
+				parents[index] = parents[parents[index]];
+				index = parents[index];
+			}
+			return index;
+		};
 
-			if ( bodyA->getMotionType() == BodyMotion::eStatic || 
-				 bodyB->getMotionType() == BodyMotion::eStatic )
+		for( ContactManifold* cm : mColManager.mMainifolds )
+		{
+			RigidBody* bodyA = static_cast< RigidBody* >( cm->mContact.object[0] );
+			RigidBody* bodyB = static_cast< RigidBody* >( cm->mContact.object[1] );
+			if ( IsDynamic( bodyA ) && IsDynamic( bodyB ) )
 			{
-				sortedContact[idxStatic--] = &cm;
+				int rootA = FindRoot( bodyA->mIslandIndex );
+				int rootB = FindRoot( bodyB->mIslandIndex );
+				if ( rootA != rootB )
+					parents[rootA] = rootB;
+			}
+		}
+
+		int* islandIds = new ( mAllocator ) int[ numDynamic ];
+		std::fill_n( islandIds , numDynamic , INDEX_NONE );
+		for( int i = 0; i < numDynamic; ++i )
+		{
+			int root = FindRoot( i );
+			if ( islandIds[root] == INDEX_NONE )
+			{
+				islandIds[root] = (int)mIslands.size();
+				Island island;
+				island.bodyStart = 0;
+				island.bodyNum = 0;
+				island.manifoldStart = 0;
+				island.manifoldNum = 0;
+				island.bAwake = !mbEnableSleep;
+				mIslands.push_back( island );
+			}
+			islandIds[i] = islandIds[root];
+
+			Island& island = mIslands[islandIds[i]];
+			island.bodyNum += 1;
+			if ( dynamicBodies[i]->isAwake() )
+				island.bAwake = true;
+		}
+
+		auto GetManifoldIsland = [&](ContactManifold* cm) -> int
+		{
+			RigidBody* bodyA = static_cast< RigidBody* >( cm->mContact.object[0] );
+			RigidBody* bodyB = static_cast< RigidBody* >( cm->mContact.object[1] );
+			if ( IsDynamic( bodyA ) )
+				return islandIds[bodyA->mIslandIndex];
+			if ( IsDynamic( bodyB ) )
+				return islandIds[bodyB->mIslandIndex];
+			return INDEX_NONE;
+		};
+
+		for( ContactManifold* cm : mColManager.mMainifolds )
+		{
+			int islandId = GetManifoldIsland( cm );
+			if ( islandId == INDEX_NONE )
+				continue;
+
+			Island& island = mIslands[islandId];
+			island.manifoldNum += 1;
+
+			// A moving kinematic body wakes the island it touches
+			for( int i = 0; i < 2; ++i )
+			{
+				RigidBody* body = static_cast< RigidBody* >( cm->mContact.object[i] );
+				if ( body->getMotionType() == BodyMotion::eKinematic &&
+					 ( body->mLinearVel.length2() > 0 || body->mAngularVel != 0 ) )
+				{
+					island.bAwake = true;
+				}
+			}
+		}
+
+		int bodyOffset = 0;
+		int manifoldOffset = 0;
+		for( Island& island : mIslands )
+		{
+			island.bodyStart = bodyOffset;
+			island.manifoldStart = manifoldOffset;
+			bodyOffset += island.bodyNum;
+			manifoldOffset += island.manifoldNum;
+		}
+		mIslandBodies.resize( bodyOffset );
+		mIslandManifolds.resize( manifoldOffset );
+
+		int numIsland = (int)mIslands.size();
+		int* bodyCursors = new ( mAllocator ) int[ numIsland ];
+		int* normalCursors = new ( mAllocator ) int[ numIsland ];
+		int* staticCursors = new ( mAllocator ) int[ numIsland ];
+		for( int i = 0; i < numIsland; ++i )
+		{
+			bodyCursors[i] = mIslands[i].bodyStart;
+			normalCursors[i] = mIslands[i].manifoldStart;
+			staticCursors[i] = mIslands[i].manifoldStart + mIslands[i].manifoldNum - 1;
+		}
+
+		for( int i = 0; i < numDynamic; ++i )
+		{
+			RigidBody* body = dynamicBodies[i];
+			if ( mIslands[islandIds[i]].bAwake && !body->isAwake() )
+			{
+				body->setAwake( true );
+			}
+			mIslandBodies[bodyCursors[islandIds[i]]++] = body;
+		}
+
+		// Contacts with static bodies are placed at the end of the island
+		for( ContactManifold* cm : mColManager.mMainifolds )
+		{
+			int islandId = GetManifoldIsland( cm );
+			if ( islandId == INDEX_NONE )
+				continue;
+
+			RigidBody* bodyA = static_cast< RigidBody* >( cm->mContact.object[0] );
+			RigidBody* bodyB = static_cast< RigidBody* >( cm->mContact.object[1] );
+			if ( IsDynamic( bodyA ) && IsDynamic( bodyB ) )
+			{
+				mIslandManifolds[normalCursors[islandId]++] = cm;
 			}
 			else
 			{
-				sortedContact[idxNormal++] = &cm;
+				mIslandManifolds[staticCursors[islandId]--] = cm;
 			}
+		}
+
+		// Dispatch large islands first for better load balance
+		std::sort( mIslands.begin() , mIslands.end() , [](Island const& lhs, Island const& rhs)
+		{
+			return lhs.manifoldNum > rhs.manifoldNum;
+		});
+	}
+
+	void World::solveIsland(Island const& island, float dt, bool bAllowDebugJump)
+	{
+		if ( !island.bAwake )
+			return;
+
+		RigidBody** bodies = mIslandBodies.data() + island.bodyStart;
+		ContactManifold** sortedContact = mIslandManifolds.data() + island.manifoldStart;
+		int numBody = island.bodyNum;
+		int numMainfold = island.manifoldNum;
 
+		auto DebugJump = [bAllowDebugJump, numMainfold]()
+		{
+			if ( bAllowDebugJump && numMainfold != 0 )
+				GDebugJumpFun();
+		};
+
+		for( int i = 0 ; i < numBody ; ++i )
+		{
+			RigidBody* body = bodies[i];
+			body->addLinearImpulse( body->mMass * mGrivaty * dt );
+			body->applyImpulse();
 		}
 
 		// Phase 1: Compute velocity bias for all contact points (using pre-warmstart velocities)
@@ -93,13 +309,12 @@ namespace Phy2D
 		}
 
 		// Phase 2: Apply warm start for all contact points
-		bool enableWarmStart = false;  // Disable warm start for debugging
 		for( int i = 0 ; i < numMainfold ; ++i )
 		{
 			ContactManifold& cm = *sortedContact[i];
 			Contact& c = cm.mContact;
 
-			if ( !enableWarmStart )
+			if ( !mbEnableWarmStart )
 			{
 				// Reset all impulses when warm start is disabled
 				for (int j = 0; j < cm.mNumContacts; ++j)
@@ -113,7 +328,9 @@ namespace Phy2D
 			RigidBody* bodyA = static_cast< RigidBody* >( c.object[0] );
 			RigidBody* bodyB = static_cast< RigidBody* >( c.object[1] );
 
-			// Warm start each contact point
+			Vector2 tangent = Math::Perp( c.normal );
+
+			// Warm start each contact point with the impulses accumulated last step
 			for (int j = 0; j < cm.mNumContacts; ++j)
 			{
 				ManifoldPoint& mp = cm.mPoints[j];
@@ -124,20 +341,17 @@ namespace Phy2D
 				Vector2 rA = cp - bodyA->mPosCenter;
 				Vector2 rB = cp - bodyB->mPosCenter;
 				
-				Vector2 dp = mp.normalImpulse * c.normal;
+				Vector2 P = mp.normalImpulse * c.normal + mp.tangentImpulse * tangent;
 
-				bodyA->mLinearVel -= dp * bodyA->mInvMass;
-				bodyA->mAngularVel -= rA.cross( dp ) * bodyA->mInvI;
-				bodyB->mLinearVel += dp * bodyB->mInvMass;
-				bodyB->mAngularVel += rB.cross( dp ) * bodyB->mInvI;
+				ApplyVelocityImpulse( bodyA , -P , -rA.cross( P ) );
+				ApplyVelocityImpulse( bodyB , P , rB.cross( P ) );
 			}
 		}
 
-		if ( numMainfold != 0 )
-			GDebugJumpFun();
+		DebugJump();
 
 		// Velocity solver iterations
-		for( int nIter = 0 ; nIter < vIterNum ; ++nIter )
+		for( int nIter = 0 ; nIter < mVelocityIterations ; ++nIter )
 		{
 			for( int i = 0 ; i < numMainfold ; ++i )
 			{
@@ -206,10 +420,8 @@ namespace Phy2D
 						
 						// Apply tangent impulse
 						Vector2 Pt = lambda * tangent;
-						bodyA->mLinearVel -= Pt * bodyA->mInvMass;
-						bodyA->mAngularVel -= lambda * trA * bodyA->mInvI;
-						bodyB->mLinearVel += Pt * bodyB->mInvMass;
-						bodyB->mAngularVel += lambda * trB * bodyB->mInvI;
+						ApplyVelocityImpulse( bodyA , -Pt , -lambda * trA );
+						ApplyVelocityImpulse( bodyB , Pt , lambda * trB );
 					}
 
 					// ============ Solve normal constraints ============
@@ -228,42 +440,32 @@ namespace Phy2D
 					impulse = newImpulse - mp.normalImpulse;
 
 					Vector2 P = impulse * normal;
-					bodyA->mLinearVel -= P * bodyA->mInvMass;
-					bodyA->mAngularVel -= impulse * nrA * bodyA->mInvI;
-					bodyB->mLinearVel += P * bodyB->mInvMass;
-					bodyB->mAngularVel += impulse * nrB * bodyB->mInvI;
+					ApplyVelocityImpulse( bodyA , -P , -impulse * nrA );
+					ApplyVelocityImpulse( bodyB , P , impulse * nrB );
 
 					mp.normalImpulse = newImpulse;
 				}
 
-				if ( numMainfold != 0 )
-					GDebugJumpFun();
+				DebugJump();
 			}
 		}
 
-
-		for( RigidBodyList::iterator iter = mRigidBodies.begin() ,itEnd = mRigidBodies.end();
-			iter != itEnd ; ++iter )
+		for( int i = 0 ; i < numBody ; ++i )
 		{
-			RigidBody* body = *iter;
+			RigidBody* body = bodies[i];
 			body->intergedTramsform( dt );
-				if ( body->getMotionType() == BodyMotion::eDynamic )
-			{
-				// Apply linear damping
-				float linearDampFactor = Math::Max( 0.0f, 1.0f - body->mLinearDamping * dt );
-				body->mLinearVel *= linearDampFactor;
-				
-				// Apply angular damping
-				float angularDampFactor = Math::Max( 0.0f, 1.0f - body->mAngularDamping * dt );
-				body->mAngularVel *= angularDampFactor;
-			}
 
-	
-			//body->mAngularVel = 0;
+			// Apply linear damping
+			float linearDampFactor = Math::Max( 0.0f, 1.0f - body->mLinearDamping * dt );
+			body->mLinearVel *= linearDampFactor;
+			
+			// Apply angular damping
+			float angularDampFactor = Math::Max( 0.0f, 1.0f - body->mAngularDamping * dt );
+			body->mAngularVel *= angularDampFactor;
 		}
 
 		// Position solver iterations
-		for( int nIter = 0 ; nIter < pIterNum ; ++nIter )
+		for( int nIter = 0 ; nIter < mPositionIterations ; ++nIter )
 		{
 			float const LinearSlop = 0.005f;
 			float const Baumgarte = 0.2f;
@@ -347,13 +549,8 @@ namespace Phy2D
 
 					Vector2 P = impulse * normal;
 
-					bodyA->mXForm.translate( -P * bodyA->mInvMass );
-					bodyA->mRotationAngle += -impulse * nrA * bodyA->mInvI;
-					bodyA->synTransform();
-
-					bodyB->mXForm.translate( P * bodyB->mInvMass );
-					bodyB->mRotationAngle += impulse * nrB * bodyB->mInvI;
-					bodyB->synTransform();
+					ApplyPositionImpulse( bodyA , -P , -impulse * nrA );
+					ApplyPositionImpulse( bodyB , P , impulse * nrB );
 				}
 			}
 
@@ -362,9 +559,38 @@ namespace Phy2D
 				break;
 		}
 
-		if ( numMainfold != 0 )
-			GDebugJumpFun();
+		DebugJump();
+
+		if ( mbEnableSleep )
+		{
+			float const LinearSleepTolerance = 0.01f;
+			float const AngularSleepTolerance = Math::DegToRad( 2.0f );
+			float const TimeToSleep = 0.5f;
 
+			float minSleepTime = std::numeric_limits< float >::max();
+			for( int i = 0 ; i < numBody ; ++i )
+			{
+				RigidBody* body = bodies[i];
+				if ( body->mLinearVel.length2() > LinearSleepTolerance * LinearSleepTolerance ||
+					 body->mAngularVel * body->mAngularVel > AngularSleepTolerance * AngularSleepTolerance )
+				{
+					body->mSleepTime = 0;
+				}
+				else
+				{
+					body->mSleepTime += dt;
+				}
+				minSleepTime = Math::Min( minSleepTime , body->mSleepTime );
+			}
+
+			if ( minSleepTime >= TimeToSleep )
+			{
+				for( int i = 0 ; i < numBody ; ++i )
+				{
+					bodies[i]->setAwake( false );
+				}
+			}
+		}
 	}
 
 	void World::destroyRigidBody(RigidBody* body)
@@ -6,8 +6,11 @@
 #include "Phy2D/Collision.h"
 
 #include "DataStructure/IntrList.h"
+#include "DataStructure/Array.h"
 #include "Memory/FrameAllocator.h"
 
+class QueueThreadPool;
+
 
 namespace Phy2D
 {
@@ -21,6 +24,11 @@ namespace Phy2D
 			:mAllocator( 1024 )
 		{
 			mGrivaty = Vector2(0,-9.8);
+			mVelocityIterations = 8;
+			mPositionIterations = 3;
+			mbEnableWarmStart = true;
+			mbEnableSleep = true;
+			mThreadPool = nullptr;
 		}
 		
 		CollideObject* createCollideObject( Shape* shape );
@@ -33,6 +41,10 @@ namespace Phy2D
 
 		void           clearnup( bool beDelete );
 
+		// Independent islands are solved in parallel , null to solve on the calling thread
+		void           setThreadPool( QueueThreadPool* threadPool ){ mThreadPool = threadPool; }
+		int            getIslandNum() const { return mIslands.size(); }
+
 		CollisionManager mColManager;
 
 		typedef TIntrList< 
@@ -51,6 +63,30 @@ namespace Phy2D
 		Vector2          mGrivaty;
 		FrameAllocator mAllocator;
 
+		int   mVelocityIterations;
+		int   mPositionIterations;
+		bool  mbEnableWarmStart;
+		bool  mbEnableSleep;
+
+	private:
+		// Bodies and manifolds connected by contacts , static bodies don't link islands
+		struct Island
+		{
+			int  bodyStart;
+			int  bodyNum;
+			int  manifoldStart;
+			int  manifoldNum;
+			bool bAwake;
+		};
+
+		void  buildIslands();
+		void  solveIsland( Island const& island , float dt , bool bAllowDebugJump );
+
+		TArray< Island >           mIslands;
+		TArray< RigidBody* >       mIslandBodies;
+		TArray< ContactManifold* > mIslandManifolds;
+		QueueThreadPool*           mThreadPool;
+
 	};
 
 
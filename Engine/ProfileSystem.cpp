@@ -6,6 +6,13 @@
 #include "PlatformThread.h"
 
 #include <atomic>
+#include <chrono>
+#include <fstream>
+#include <unordered_map>
+
+#if CPP_COMPILER_MSVC
+#include <intrin.h>
+#endif
 
 struct ProfileFrameData
 {
@@ -170,6 +177,12 @@ public:
 	}
 	void   setThreadName(uint32 threadId, char const* name) override;
 	void   getAllThreadIds(TArray<uint32>& outIds) override;
+	bool   startCapture() override;
+	void   stopCapture() override;
+	bool   isCapturing() override;
+	bool   exportCapture(char const* path) override;
+	void   getCaptureStats(TArray< ProfileCaptureStat >& outStats) override;
+
 	bool   canSampling()
 	{
 		return bEnabled &&  !bFinalized;
@@ -221,6 +234,402 @@ struct TimeScopeResult
 };
 
 
+namespace ProfileCapture
+{
+	enum EEventType : uint32
+	{
+		Event_Begin,
+		Event_End,
+		// nameId is the number of the scopes dropped before the event
+		Event_Dropped,
+	};
+
+	struct Event
+	{
+		uint64 tick;
+		uint32 nameId;
+		uint32 type;
+	};
+
+	static constexpr uint32 RingSize = 1 << 16;
+	static constexpr uint32 NameCacheSize = 256;
+
+	// The time stamp counter is read at the capture start and stop to calibrate the tick frequency
+	FORCEINLINE uint64 ReadTick()
+	{
+#if CPP_COMPILER_MSVC
+		return __rdtsc();
+#else
+		return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	struct ClockSync
+	{
+		uint64 tick;
+		std::chrono::steady_clock::time_point time;
+
+		void record()
+		{
+			time = std::chrono::steady_clock::now();
+			tick = ReadTick();
+		}
+	};
+
+	uint32 InternName(char const* name);
+
+	// Single producer (the owner thread) , single consumer (the collector thread) ring
+	struct EventRing
+	{
+		Event events[RingSize];
+		std::atomic< uint32 > head{ 0 };
+		std::atomic< uint32 > tail{ 0 };
+	};
+
+	struct CompletedScope
+	{
+		uint64 tick;
+		uint64 duration;
+		uint32 nameId;
+	};
+
+	struct DroppedMarker
+	{
+		uint64 tick;
+		uint32 num;
+	};
+
+	struct ScopeStat
+	{
+		uint32 count;
+		uint64 totalTicks;
+		uint64 maxTicks;
+	};
+
+	// Aggregated by the collector , indexed by the name id
+	TArray< ScopeStat > GScopeStats;
+
+	class ThreadBuffer
+	{
+	public:
+		ThreadBuffer(uint32 inThreadId, EventRing* inRing)
+			:threadId(inThreadId)
+			,mRing(inRing)
+		{
+			FMemory::Zero(mNameCache, sizeof(mNameCache));
+		}
+
+		// Return false if the begin event is dropped , the room of the end events of the recorded open scopes
+		// is always kept so an end event is never dropped and the export can't mispair the scopes
+		bool push(char const* name, uint32 type)
+		{
+			EventRing& ring = *mRing;
+			uint32 h = ring.head.load(std::memory_order_relaxed);
+			uint32 used = h - ring.tail.load(std::memory_order_acquire);
+			if (type == Event_Begin)
+			{
+				uint32 needSize = mNumOpenScope + 2 + (mNumPendingDropped ? 1 : 0);
+				if (used + needSize > RingSize)
+				{
+					++mNumPendingDropped;
+					mNumDropped.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+				if (mNumPendingDropped)
+				{
+					write(h++, Event_Dropped, mNumPendingDropped);
+					mNumPendingDropped = 0;
+				}
+				write(h++, Event_Begin, getNameId(name));
+				++mNumOpenScope;
+			}
+			else
+			{
+				if (mNumPendingDropped && used + mNumOpenScope + 1 <= RingSize)
+				{
+					write(h++, Event_Dropped, mNumPendingDropped);
+					mNumPendingDropped = 0;
+				}
+				write(h++, Event_End, 0);
+				--mNumOpenScope;
+			}
+			ring.head.store(h, std::memory_order_release);
+			return true;
+		}
+
+		// Collector only : pair the begin/end events into completed scopes and aggregate the scope stats
+		void collect()
+		{
+			if (mRing == nullptr)
+				return;
+
+			EventRing& ring = *mRing;
+			uint32 h = ring.head.load(std::memory_order_acquire);
+			uint32 t = ring.tail.load(std::memory_order_relaxed);
+			for (; t != h; ++t)
+			{
+				Event const& event = ring.events[t & (RingSize - 1)];
+				switch (event.type)
+				{
+				case Event_Begin:
+					mOpenScopes.push_back({ event.tick, 0, event.nameId });
+					break;
+				case Event_End:
+					// The begin event is discarded at the capture start
+					if (mOpenScopes.empty())
+						break;
+					{
+						CompletedScope scope = mOpenScopes.back();
+						mOpenScopes.pop_back();
+						scope.duration = event.tick - scope.tick;
+						scopes.push_back(scope);
+
+						if (scope.nameId >= GScopeStats.size())
+						{
+							GScopeStats.resize(scope.nameId + 1, ScopeStat{ 0, 0, 0 });
+						}
+						ScopeStat& stat = GScopeStats[scope.nameId];
+						++stat.count;
+						stat.totalTicks += scope.duration;
+						if (scope.duration > stat.maxTicks)
+							stat.maxTicks = scope.duration;
+					}
+					break;
+				case Event_Dropped:
+					droppedMarkers.push_back({ event.tick, event.nameId });
+					break;
+				}
+			}
+			ring.tail.store(t, std::memory_order_release);
+		}
+
+		void discard()
+		{
+			if (mRing)
+			{
+				mRing->tail.store(mRing->head.load(std::memory_order_acquire), std::memory_order_release);
+			}
+			mNumDropped.store(0, std::memory_order_relaxed);
+			mOpenScopes.clear();
+			scopes.clear();
+			droppedMarkers.clear();
+		}
+
+		EventRing* releaseRing()
+		{
+			EventRing* ring = mRing;
+			mRing = nullptr;
+			return ring;
+		}
+
+		uint32 getDroppedNum() const { return mNumDropped.load(std::memory_order_relaxed); }
+
+		uint32 const threadId;
+		// Unmatched capture scopes , only used by the owner thread
+		int    depth = 0;
+		// The depths of the scopes whose begin event is dropped , their end event is skipped
+		TArray< int > droppedDepths;
+		std::atomic< bool > bThreadExited{ false };
+
+		// Aggregated by the collector
+		TArray< CompletedScope > scopes;
+		TArray< DroppedMarker >  droppedMarkers;
+
+	private:
+		FORCEINLINE void write(uint32 index, uint32 type, uint32 nameId)
+		{
+			Event& event = mRing->events[index & (RingSize - 1)];
+			event.tick = ReadTick();
+			event.nameId = nameId;
+			event.type = type;
+		}
+
+		uint32 getNameId(char const* name)
+		{
+			NameCacheEntry& entry = mNameCache[(uintptr_t(name) >> 3) & (NameCacheSize - 1)];
+			if (entry.name != name)
+			{
+				entry.name = name;
+				entry.id = InternName(name);
+			}
+			return entry.id;
+		}
+
+		struct NameCacheEntry
+		{
+			char const* name;
+			uint32 id;
+		};
+		NameCacheEntry mNameCache[NameCacheSize];
+
+		EventRing* mRing;
+		uint32     mNumOpenScope = 0;
+		uint32     mNumPendingDropped = 0;
+		TArray< CompletedScope > mOpenScopes;
+		std::atomic< uint32 > mNumDropped{ 0 };
+	};
+
+	std::atomic< bool > GActive{ false };
+	// The rings of the exited threads are recycled , the buffers are kept for the export until the next capture start
+	Mutex GBufferLock;
+	TArray< ThreadBuffer* > GBuffers;
+	TArray< EventRing* > GFreeRings;
+	thread_local ThreadBuffer* GBufferLocal = nullptr;
+
+	struct ThreadBufferOwner
+	{
+		~ThreadBufferOwner()
+		{
+			if (buffer)
+			{
+				buffer->bThreadExited.store(true, std::memory_order_release);
+				GBufferLocal = nullptr;
+			}
+		}
+		ThreadBuffer* buffer = nullptr;
+	};
+	thread_local ThreadBufferOwner GBufferOwner;
+
+	Mutex GNameLock;
+	std::unordered_map< char const*, uint32 > GNameMap;
+	TArray< std::string > GNames;
+
+	ClockSync GStartSync;
+	ClockSync GStopSync;
+
+	uint32 InternName(char const* name)
+	{
+		Mutex::Locker locker(GNameLock);
+		auto iter = GNameMap.find(name);
+		if (iter != GNameMap.end())
+			return iter->second;
+
+		uint32 id = GNames.size();
+		GNames.push_back(name);
+		GNameMap.emplace(name, id);
+		return id;
+	}
+
+	ThreadBuffer* GetThreadBuffer()
+	{
+		if (GBufferLocal == nullptr)
+		{
+			Mutex::Locker locker(GBufferLock);
+			EventRing* ring;
+			if (GFreeRings.empty())
+			{
+				ring = new EventRing;
+			}
+			else
+			{
+				ring = GFreeRings.back();
+				GFreeRings.pop_back();
+			}
+			GBufferLocal = new ThreadBuffer(PlatformThread::GetCurrentThreadId(), ring);
+			GBuffers.push_back(GBufferLocal);
+			// The buffer is marked exited at the thread exit
+			GBufferOwner.buffer = GBufferLocal;
+		}
+		return GBufferLocal;
+	}
+
+	FORCEINLINE bool TryBegin(char const* name)
+	{
+		if (!GActive.load(std::memory_order_relaxed))
+			return false;
+
+		ThreadBuffer* buffer = GetThreadBuffer();
+		++buffer->depth;
+		if (!buffer->push(name, Event_Begin))
+		{
+			buffer->droppedDepths.push_back(buffer->depth);
+		}
+		return true;
+	}
+
+	FORCEINLINE bool TryEnd()
+	{
+		// Scopes started before the capture still end in the sample tree
+		ThreadBuffer* buffer = GBufferLocal;
+		if (buffer == nullptr || buffer->depth == 0)
+			return false;
+
+		if (!buffer->droppedDepths.empty() && buffer->droppedDepths.back() == buffer->depth)
+		{
+			buffer->droppedDepths.pop_back();
+		}
+		else
+		{
+			buffer->push(nullptr, Event_End);
+		}
+		--buffer->depth;
+		return true;
+	}
+
+	// GBufferLock must be held
+	void RecycleRing(ThreadBuffer& buffer)
+	{
+		EventRing* ring = buffer.releaseRing();
+		if (ring)
+		{
+			ring->head.store(0, std::memory_order_relaxed);
+			ring->tail.store(0, std::memory_order_relaxed);
+			GFreeRings.push_back(ring);
+		}
+	}
+
+	// Collector only , or after the collector is joined
+	void CollectAll()
+	{
+		Mutex::Locker locker(GBufferLock);
+		for (ThreadBuffer* buffer : GBuffers)
+		{
+			// Read the exit flag first , the events pushed before the exit are visible to the last collect
+			bool bExited = buffer->bThreadExited.load(std::memory_order_acquire);
+			buffer->collect();
+			if (bExited)
+			{
+				RecycleRing(*buffer);
+			}
+		}
+	}
+
+	// Remove the buffers of the exited threads , their scopes are exported already
+	void RemoveExitedBuffers()
+	{
+		Mutex::Locker locker(GBufferLock);
+		for (int i = 0; i < GBuffers.size(); ++i)
+		{
+			ThreadBuffer* buffer = GBuffers[i];
+			if (!buffer->bThreadExited.load(std::memory_order_acquire))
+				continue;
+
+			RecycleRing(*buffer);
+			delete buffer;
+			GBuffers.removeIndexSwap(i);
+			--i;
+		}
+	}
+
+	class Collector : public RunnableThreadT< Collector >
+	{
+	public:
+		unsigned run()
+		{
+			while (bRunning.load(std::memory_order_acquire))
+			{
+				CollectAll();
+				SystemPlatform::Sleep(1);
+			}
+			CollectAll();
+			return 0;
+		}
+
+		std::atomic< bool > bRunning{ false };
+	};
+
+	Collector* GCollector = nullptr;
+}
 
 #if CORE_SHARE_CODE
 
@@ -263,6 +672,9 @@ ProfileSystem& ProfileSystem::Get()
 
 void ProfileSystem::StartSample(const char * name, char const* category, unsigned flag)
 {
+	if (ProfileCapture::TryBegin(name))
+		return;
+
 	if (!GSystem.canSampling())
 		return;
 
@@ -271,6 +683,9 @@ void ProfileSystem::StartSample(const char * name, char const* category, unsigne
 
 void ProfileSystem::EndSample()
 {
+	if (ProfileCapture::TryEnd())
+		return;
+
 	if (!GSystem.canSampling())
 		return;
 
@@ -394,6 +809,163 @@ void ProfileSystemImpl::getAllThreadIds(TArray<uint32>& outIds)
 	}
 }
 
+bool ProfileSystemImpl::startCapture()
+{
+	using namespace ProfileCapture;
+	if (GCollector)
+		return false;
+
+	RemoveExitedBuffers();
+	{
+		Mutex::Locker locker(GBufferLock);
+		for (ThreadBuffer* buffer : GBuffers)
+		{
+			buffer->discard();
+		}
+	}
+	GScopeStats.clear();
+
+	GStartSync.record();
+	GCollector = new Collector;
+	GCollector->bRunning.store(true, std::memory_order_release);
+	if (!GCollector->start())
+	{
+		delete GCollector;
+		GCollector = nullptr;
+		return false;
+	}
+	GActive.store(true, std::memory_order_release);
+	return true;
+}
+
+void ProfileSystemImpl::stopCapture()
+{
+	using namespace ProfileCapture;
+	if (GCollector == nullptr)
+		return;
+
+	GActive.store(false, std::memory_order_release);
+	GStopSync.record();
+	GCollector->bRunning.store(false, std::memory_order_release);
+	GCollector->join();
+	delete GCollector;
+	GCollector = nullptr;
+}
+
+bool ProfileSystemImpl::isCapturing()
+{
+	return ProfileCapture::GCollector != nullptr;
+}
+
+namespace ProfileCapture
+{
+	void WriteJsonString(std::ostream& os, char const* str)
+	{
+		os << '"';
+		for (; *str; ++str)
+		{
+			char c = *str;
+			if (c == '"' || c == '\\')
+				os << '\\' << c;
+			else if (uint8(c) < 0x20)
+				os << ' ';
+			else
+				os << c;
+		}
+		os << '"';
+	}
+}
+
+bool ProfileSystemImpl::exportCapture(char const* path)
+{
+	using namespace ProfileCapture;
+	if (isCapturing())
+	{
+		LogWarning(0, "Can't export profile capture while capturing");
+		return false;
+	}
+
+	std::ofstream fs(path);
+	if (!fs.is_open())
+		return false;
+
+	double const duration = std::chrono::duration< double >(GStopSync.time - GStartSync.time).count();
+	double const tickToMicroseconds = (GStopSync.tick > GStartSync.tick && duration > 0) ? 
+		1e6 * duration / double(GStopSync.tick - GStartSync.tick) : 0.0;
+
+	Mutex::Locker bufferLocker(GBufferLock);
+	Mutex::Locker nameLocker(GNameLock);
+
+	fs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	fs.setf(std::ios::fixed);
+	fs.precision(3);
+
+	bool bFirst = true;
+	uint32 numDropped = 0;
+	for (ThreadBuffer* buffer : GBuffers)
+	{
+		if (buffer->scopes.empty() && buffer->droppedMarkers.empty())
+			continue;
+
+		numDropped += buffer->getDroppedNum();
+		if (!bFirst)
+			fs << ",\n";
+		bFirst = false;
+		fs << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+		WriteJsonString(fs, PlatformThread::GetThreadName(buffer->threadId).c_str());
+		fs << "}}";
+
+		// Scopes are paired by the collector , scopes still open at the capture stop are skipped
+		for (CompletedScope const& scope : buffer->scopes)
+		{
+			fs << ",\n{\"ph\":\"X\",\"name\":";
+			WriteJsonString(fs, GNames[scope.nameId].c_str());
+			fs << ",\"pid\":1,\"tid\":" << buffer->threadId
+				<< ",\"ts\":" << double(int64(scope.tick - GStartSync.tick)) * tickToMicroseconds
+				<< ",\"dur\":" << double(scope.duration) * tickToMicroseconds << "}";
+		}
+		for (DroppedMarker const& marker : buffer->droppedMarkers)
+		{
+			fs << ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"Dropped Scopes\",\"pid\":1,\"tid\":" << buffer->threadId
+				<< ",\"ts\":" << double(int64(marker.tick - GStartSync.tick)) * tickToMicroseconds
+				<< ",\"args\":{\"num\":" << marker.num << "}}";
+		}
+	}
+	fs << "\n]}\n";
+
+	if (numDropped)
+	{
+		LogWarning(0, "Profile capture dropped %u scopes , thread ring buffers are full", numDropped);
+	}
+	return true;
+}
+
+void ProfileSystemImpl::getCaptureStats(TArray< ProfileCaptureStat >& outStats)
+{
+	using namespace ProfileCapture;
+	if (isCapturing())
+		return;
+
+	double const duration = std::chrono::duration< double >(GStopSync.time - GStartSync.time).count();
+	double const tickToMicroseconds = (GStopSync.tick > GStartSync.tick && duration > 0) ?
+		1e6 * duration / double(GStopSync.tick - GStartSync.tick) : 0.0;
+
+	Mutex::Locker nameLocker(GNameLock);
+	for (int nameId = 0; nameId < GScopeStats.size(); ++nameId)
+	{
+		ScopeStat const& stat = GScopeStats[nameId];
+		if (stat.count == 0)
+			continue;
+
+		ProfileCaptureStat captureStat;
+		captureStat.name = GNames[nameId];
+		captureStat.count = stat.count;
+		captureStat.totalTime = double(stat.totalTicks) * tickToMicroseconds;
+		captureStat.maxTime = double(stat.maxTicks) * tickToMicroseconds;
+		outStats.push_back(std::move(captureStat));
+	}
+}
+
 thread_local ThreadProfileData* GThreadDataLocal = nullptr;
 
 ThreadProfileData* ProfileSystemImpl::GetCurrentThreadData()
@@ -13,6 +13,7 @@
 #include "DataStructure/Array.h"
 
 #include <unordered_map>
+#include <string>
 
 #ifndef USE_PROFILE
 #define USE_PROFILE 1
@@ -165,6 +166,15 @@ protected:
 	friend class ThreadProfileData;
 };
 
+struct ProfileCaptureStat
+{
+	std::string name;
+	uint32      count;
+	// microseconds
+	double      totalTime;
+	double      maxTime;
+};
+
 class ProfileSystem
 {
 public:
@@ -188,6 +198,16 @@ public:
 	virtual ProfileSampleNode* getRootSample(uint32 threadId = 0) = 0;
 	virtual void   setThreadName(uint32 threadId, char const* name) = 0;
 	virtual void   getAllThreadIds(TArray<uint32>& outIds) = 0;
+
+	// Capture mode : samples are recorded as begin/end events into per-thread lock-free rings
+	// instead of the sample tree , a collector thread drains the rings until the capture stop
+	virtual bool   startCapture() = 0;
+	virtual void   stopCapture() = 0;
+	virtual bool   isCapturing() = 0;
+	// Chrome trace_event JSON , open with chrome://tracing or ui.perfetto.dev
+	virtual bool   exportCapture(char const* path) = 0;
+	// Per scope name stats aggregated by the collector thread
+	virtual void   getCaptureStats(TArray< ProfileCaptureStat >& outStats) = 0;
 };
 
 class ProfileReadScope
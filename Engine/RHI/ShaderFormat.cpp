@@ -4,13 +4,15 @@
 #include "FileSystem.h"
 #include "ProfileSystem.h"
 #include "InlineString.h"
+#include "Async/AsyncWork.h"
+#include "Core/FNV1a.h"
 
 
 #include <sstream>
 
 namespace Render
 {
-	bool ShaderFormat::preprocessCode(char const* path, ShaderCompileDesc* compileDesc, StringView const& definition, CPP::CodeSourceLibrary* sourceLibrary, TArray<uint8>& inoutCodes, std::unordered_set<HashString>* outIncludeFiles, bool bOuputPreprocessedCode)
+	bool ShaderFormat::PreprocessCode(char const* path, StringView const& definition, ShaderPreprocessSettings const& settings, CPP::CodeSourceLibrary* sourceLibrary, TArray<uint8>& outCodes, std::unordered_set<HashString>* outIncludeFiles, std::unordered_set<HashString>* outReadMacros)
 	{
 		TimeScope scope("PreprocessCode");
 
@@ -22,13 +24,26 @@ namespace Render
 #if USE_MULTI_INPUT
 		if (path)
 		{
-			if (!source.loadFile(path))
+			CPP::CodeBufferSource* fileSource = &source;
+			if (sourceLibrary)
+			{
+				fileSource = sourceLibrary->findOrLoadSource(path);
+			}
+			else if (source.loadFile(path))
+			{
+				source.filePath = path;
+			}
+			else
+			{
+				fileSource = nullptr;
+			}
+
+			if (fileSource == nullptr)
 			{
 				LogWarning(0, "Can't load shader file %s", path);
 				return false;
 			}
-			source.filePath = path;
-			preprocessor.pushInput(source);
+			preprocessor.pushInput(*fileSource);
 		}
 
 		CPP::CodeStringSource definitionSource;
@@ -94,13 +109,12 @@ namespace Render
 		preprocessor.pushInput(source);
 #endif
 
-		auto settings = getPreprocessSettings();
-
 		if (sourceLibrary)
 		{
 			preprocessor.setSourceLibrary(*sourceLibrary);
 		}
 		preprocessor.bReplaceMacroText = true;
+		preprocessor.bRecordMacroDependency = outReadMacros != nullptr;
 		preprocessor.bAllowRedefineMacro = true;
 		preprocessor.bAddLineMacro = settings.bAddLineMacro;
 		preprocessor.lineFormat = (settings.bSupportLineFilePath) ? CPP::Preprocessor::LF_LineNumberAndFilePath : CPP::Preprocessor::LF_None;
@@ -133,14 +147,88 @@ namespace Render
 		{
 			preprocessor.getUsedIncludeFiles(*outIncludeFiles);
 		}
+		if (outReadMacros)
+		{
+			preprocessor.getReadMacros(*outReadMacros);
+		}
 
 #if 0
-		inoutCodes.assign(std::istreambuf_iterator< char >(oss), std::istreambuf_iterator< char >());
+		outCodes.assign(std::istreambuf_iterator< char >(oss), std::istreambuf_iterator< char >());
 #else
 		std::string code = oss.str();
-		inoutCodes.assign(code.begin(), code.end());
+		outCodes.assign(code.begin(), code.end());
 #endif
-		inoutCodes.push_back('\0');
+		outCodes.push_back('\0');
+		return true;
+	}
+
+	void ShaderFormat::PreprocessCodes(TArrayView< ShaderPreprocessJob > jobs, ShaderPreprocessSettings const& settings, CPP::CodeSourceLibrary& sourceLibrary, QueueThreadPool* threadPool)
+	{
+		TimeScope scope("PreprocessCodes");
+
+		auto ExecuteJob = [&settings, &sourceLibrary](ShaderPreprocessJob& job)
+		{
+			ShaderCompileDesc const& desc = *job.desc;
+			job.bSuccess = PreprocessCode(desc.filePath.empty() ? nullptr : desc.filePath.c_str(), desc.headCode, settings, &sourceLibrary, job.code, &job.includeFiles, &job.readMacros);
+			if (job.bSuccess)
+			{
+				job.codeHash = FNV1a::MakeHash<uint64>(job.code.data(), (int)job.code.size());
+			}
+		};
+
+		if (threadPool)
+		{
+			QueuedWorkGroup workGroup;
+			for (ShaderPreprocessJob& job : jobs)
+			{
+				threadPool->addFunctionWork(workGroup, [&job, &ExecuteJob]()
+				{
+					ExecuteJob(job);
+				});
+			}
+			threadPool->waitWorkGroup(workGroup);
+		}
+		else
+		{
+			for (ShaderPreprocessJob& job : jobs)
+			{
+				ExecuteJob(job);
+			}
+		}
+
+		//Permutations which don't change a stage produce identical code , only the first one need to compile
+		std::unordered_multimap< uint64, int > codeHashMap;
+		for (int index = 0; index < (int)jobs.size(); ++index)
+		{
+			ShaderPreprocessJob& job = jobs[index];
+			job.duplicateIndex = INDEX_NONE;
+			if (!job.bSuccess)
+				continue;
+
+			auto range = codeHashMap.equal_range(job.codeHash);
+			for (auto iter = range.first; iter != range.second; ++iter)
+			{
+				ShaderPreprocessJob const& other = jobs[iter->second];
+				if (other.desc->type == job.desc->type &&
+					other.desc->entryName == job.desc->entryName &&
+					other.code == job.code)
+				{
+					job.duplicateIndex = iter->second;
+					break;
+				}
+			}
+
+			if (job.duplicateIndex == INDEX_NONE)
+			{
+				codeHashMap.emplace(job.codeHash, index);
+			}
+		}
+	}
+
+	bool ShaderFormat::preprocessCode(char const* path, ShaderCompileDesc* compileDesc, StringView const& definition, CPP::CodeSourceLibrary* sourceLibrary, TArray<uint8>& inoutCodes, std::unordered_set<HashString>* outIncludeFiles, std::unordered_set<HashString>* outReadMacros, bool bOuputPreprocessedCode)
+	{
+		if (!PreprocessCode(path, definition, getPreprocessSettings(), sourceLibrary, inoutCodes, outIncludeFiles, outReadMacros))
+			return false;
 
 		if (bOuputPreprocessedCode)
 		{
@@ -179,7 +267,7 @@ namespace Render
 					return false;
 				}
 			}
-			return preprocessCode(context.haveFile() ? context.getPath() : nullptr, context.desc, context.getDefinition(), context.sourceLibrary, outCodes, context.includeFiles, context.bOuputPreprocessedCode);
+			return preprocessCode(context.haveFile() ? context.getPath() : nullptr, context.desc, context.getDefinition(), context.sourceLibrary, outCodes, context.includeFiles, context.readMacros, context.bOuputPreprocessedCode);
 		}
 		else
 		{
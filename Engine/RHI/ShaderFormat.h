@@ -18,6 +18,8 @@ namespace CPP
 	class CodeSourceLibrary;
 }
 
+class QueueThreadPool;
+
 namespace Render
 {
 	class ShaderManagedData;
@@ -79,6 +81,19 @@ namespace Render
 		ShaderResourceInfo   shaderResource;
 	};
 
+	struct ShaderPreprocessJob
+	{
+		ShaderCompileDesc const* desc = nullptr;
+
+		TArray< uint8 > code;
+		std::unordered_set< HashString > includeFiles;
+		std::unordered_set< HashString > readMacros;
+		uint64 codeHash = 0;
+		//First job with the same code , type and entry , INDEX_NONE if no earlier job is identical
+		int  duplicateIndex = INDEX_NONE;
+		bool bSuccess = false;
+	};
+
 	struct ShaderCompileContext
 	{
 		bool bOuputPreprocessedCode = true;
@@ -88,6 +103,8 @@ namespace Render
 		int  shaderIndex;
 		ShaderCompileDesc* desc;
 		std::unordered_set<HashString>* includeFiles;
+		//Macros the preprocessed code depends on , a modified file changing other macros doesn't need a recompile
+		std::unordered_set<HashString>* readMacros;
 
 		bool haveFile() const { return desc->filePath.empty() == false; }
 		EShader::Type getType() const { return desc->type; }
@@ -99,6 +116,8 @@ namespace Render
 		TArray< StringView > codes;
 		
 		CPP::CodeSourceLibrary* sourceLibrary;
+		//Preprocessed code of a batch , used instead of preprocessing the file again
+		ShaderPreprocessJob const* preprocessJob;
 
 		ShaderProgramSetupData* programSetupData;
 		ShaderSetupData* shaderSetupData;
@@ -108,6 +127,8 @@ namespace Render
 			programSetupData = nullptr;
 			shaderSetupData = nullptr;
 			sourceLibrary = nullptr;
+			preprocessJob = nullptr;
+			readMacros = nullptr;
 		}
 	};
 
@@ -155,7 +176,11 @@ namespace Render
 		virtual bool getBinaryCode(ShaderSetupData& setupData, TArray<uint8>& outBinaryCode){ return false; }
 
 
-		bool preprocessCode(char const* path, ShaderCompileDesc* compileDesc, StringView const& definition, CPP::CodeSourceLibrary* sourceLibrary, TArray<uint8>& inoutCodes, std::unordered_set<HashString>* outIncludeFiles, bool bOuputPreprocessedCode);
+		bool preprocessCode(char const* path, ShaderCompileDesc* compileDesc, StringView const& definition, CPP::CodeSourceLibrary* sourceLibrary, TArray<uint8>& inoutCodes, std::unordered_set<HashString>* outIncludeFiles, std::unordered_set<HashString>* outReadMacros, bool bOuputPreprocessedCode);
+		//The file is loaded with the library if it's not null , the modifications of it can be found by the library
+		static bool PreprocessCode(char const* path, StringView const& definition, ShaderPreprocessSettings const& settings, CPP::CodeSourceLibrary* sourceLibrary, TArray<uint8>& outCodes, std::unordered_set<HashString>* outIncludeFiles, std::unordered_set<HashString>* outReadMacros = nullptr);
+		//The jobs run on the thread pool ( or the calling thread if it's null ) and share the loaded include files of the library
+		static void PreprocessCodes(TArrayView< ShaderPreprocessJob > jobs, ShaderPreprocessSettings const& settings, CPP::CodeSourceLibrary& sourceLibrary, QueueThreadPool* threadPool);
 		bool loadCode(ShaderCompileContext const& context, TArray<uint8>& outCodes);
 
 		virtual ShaderPreprocessSettings getPreprocessSettings()
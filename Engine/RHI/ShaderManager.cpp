@@ -12,6 +12,8 @@
 #include "ConsoleSystem.h"
 #include "CPreprocessor.h"
 #include "ProfileSystem.h"
+#include "SystemPlatform.h"
+#include "Async/AsyncWork.h"
 
 //#TODO remove
 #include "Renderer/BasePassRendering.h"
@@ -246,6 +248,31 @@ namespace Render
 		
 		}
 
+		//The binary code is taken here , compression and file writes run on the cache IO threads
+		template< class TSetupData, class TManagedData >
+		bool saveBinaryData(DataCacheKey const& key, ShaderFormat& format, TSetupData& setupData, TManagedData const& managedData, ShaderCacheBinaryData& binaryData)
+		{
+			if (!format.getBinaryCode(setupData, binaryData.codeBuffer))
+				return false;
+
+			return saveBinaryData(key, managedData, binaryData);
+		}
+
+		template< class TManagedData >
+		bool saveBinaryData(DataCacheKey const& key, TManagedData const& managedData, ShaderCacheBinaryData& binaryData)
+		{
+			if (!binaryData.addFileDependences(managedData))
+				return false;
+
+			TArray< uint8 > saveData;
+			{
+				auto serializer = CreateBufferSerializer< ArrayWriteBuffer >(saveData);
+				serializer << binaryData;
+			}
+			mDataCache->saveAsync(key, std::move(saveData));
+			return true;
+		}
+
 		bool saveCacheData( ShaderFormat& format, ShaderProgramSetupData& setupData, ShaderProgramManagedData const& managedData)
 		{
 			if( !format.doesSuppurtBinaryCode() )
@@ -254,17 +281,7 @@ namespace Render
 			ShaderCacheBinaryData binaryData;
 			DataCacheKey key;
 			GetShaderCacheKey(format, managedData, key);
-			bool result = mDataCache->saveDelegate(key, [&setupData,&binaryData,&format,&managedData](IStreamSerializer& serializer)
-			{			
-				if (!format.getBinaryCode(setupData, binaryData.codeBuffer))
-					return false;
-
-				if (!binaryData.addFileDependences(managedData))
-					return false;
-
-				serializer << binaryData;
-				return true;
-			});
+			bool result = saveBinaryData(key, format, setupData, managedData, binaryData);
 #if 0
 			ShaderCacheBinaryData temp;
 			if ( result )
@@ -287,17 +304,7 @@ namespace Render
 			ShaderCacheBinaryData binaryData;
 			DataCacheKey key;
 			GetShaderCacheKey(format, managedData, key);
-			bool result = mDataCache->saveDelegate(key, [&setupData, &binaryData, &format,&managedData](IStreamSerializer& serializer)
-			{
-				if (!format.getBinaryCode(setupData, binaryData.codeBuffer))
-					return false;
-
-				if (!binaryData.addFileDependences(managedData))
-					return false;
-
-				serializer << binaryData;
-				return true;
-			});
+			bool result = saveBinaryData(key, format, setupData, managedData, binaryData);
 #if 0
 			ShaderCacheBinaryData temp;
 			if (result)
@@ -312,6 +319,17 @@ namespace Render
 			return result;
 		}
 
+		//The shader shares the binary code of a shader with identical preprocessed codes
+		template< class TManagedData >
+		bool saveCacheData(ShaderFormat& format, TArray< uint8 > const& binaryCode, TManagedData const& managedData)
+		{
+			ShaderCacheBinaryData binaryData;
+			binaryData.codeBuffer = binaryCode;
+			DataCacheKey key;
+			GetShaderCacheKey(format, managedData, key);
+			return saveBinaryData(key, managedData, binaryData);
+		}
+
 		bool canUseCacheData(ShaderFormat& format)
 		{
 			if (GRHIPrefEnabled)
@@ -388,6 +406,65 @@ namespace Render
 		DataCacheInterface* mDataCache;
 	};
 
+	class ShaderPreprocessBatch
+	{
+	public:
+		void addJob(ShaderCompileDesc const& desc)
+		{
+			mJobIndexMap.emplace(&desc, (int)jobs.size());
+			ShaderPreprocessJob job;
+			job.desc = &desc;
+			jobs.push_back(std::move(job));
+		}
+
+		ShaderPreprocessJob const* findJob(ShaderCompileDesc const& desc) const
+		{
+			auto iter = mJobIndexMap.find(&desc);
+			if (iter == mJobIndexMap.end())
+				return nullptr;
+
+			ShaderPreprocessJob const& job = jobs[iter->second];
+			return job.bSuccess ? &job : nullptr;
+		}
+
+		//The key of the first jobs with identical codes , the shaders with the same key compile to the same binary code
+		bool getCodeKey(TArrayView< ShaderCompileDesc const > descList, std::string& outKey) const
+		{
+			outKey.clear();
+			for (ShaderCompileDesc const& desc : descList)
+			{
+				auto iter = mJobIndexMap.find(&desc);
+				if (iter == mJobIndexMap.end() || !jobs[iter->second].bSuccess)
+					return false;
+
+				int index = jobs[iter->second].duplicateIndex;
+				if (index == INDEX_NONE)
+					index = iter->second;
+				outKey.append((char const*)&index, sizeof(index));
+			}
+			return true;
+		}
+
+		void addDependencies(TArrayView< ShaderCompileDesc const > descList, std::unordered_set< HashString >& inoutFiles, std::unordered_set< HashString >& inoutReadMacros) const
+		{
+			for (ShaderCompileDesc const& desc : descList)
+			{
+				ShaderPreprocessJob const* job = findJob(desc);
+				if (job)
+				{
+					inoutFiles.insert(job->includeFiles.begin(), job->includeFiles.end());
+					inoutReadMacros.insert(job->readMacros.begin(), job->readMacros.end());
+				}
+			}
+		}
+
+		TArray< ShaderPreprocessJob > jobs;
+		std::unordered_map< std::string, TArray< uint8 > > binaryCodeMap;
+		int numSharedBinary = 0;
+	private:
+		std::unordered_map< ShaderCompileDesc const*, int > mJobIndexMap;
+	};
+
 	char const* const ShaderPosfixNames[] =
 	{
 		"VS", "PS", "GS", "CS", "HS", "DS", "TS", "MS",
@@ -445,6 +522,11 @@ namespace Render
 	ShaderManager::~ShaderManager()
 	{
 		cleanupLoadedSource();
+		if (mPreprocessThreadPool)
+		{
+			delete mPreprocessThreadPool;
+			mPreprocessThreadPool = nullptr;
+		}
 	}
 
 	void ShaderManager::clearnupRHIResouse()
@@ -524,17 +606,25 @@ namespace Render
 						continue;
 				}
 
+				TArray< ShaderConstructRequest > requests;
+				requests.resize(pShaderClass->permutationCount);
 				for (uint32 permutationId = 0; permutationId < pShaderClass->permutationCount; ++permutationId)
 				{
-					ShaderCompileOption option;
-					pVertexFactoryType->getCompileOption(option);
-					info.setup(option);
-					option.addMeta("SourceFile", info.name);
-					MaterialShaderProgram* shaderProgram = (MaterialShaderProgram*)constructShaderInternal(*pShaderClass, permutationId, option, ShaderClassType::Material);
+					ShaderConstructRequest& request = requests[permutationId];
+					request.shaderClass = pShaderClass;
+					request.permutationId = permutationId;
+					request.classType = ShaderClassType::Material;
+					pVertexFactoryType->getCompileOption(request.option);
+					info.setup(request.option);
+					request.option.addMeta("SourceFile", info.name);
+				}
 
-					if (shaderProgram)
+				constructShaderBatch(MakeView(requests));
+				for (ShaderConstructRequest const& request : requests)
+				{
+					if (request.result)
 					{
-						outShaders.push_back({ pShaderClass, pVertexFactoryType, shaderProgram, permutationId });
+						outShaders.push_back({ pShaderClass, pVertexFactoryType, (MaterialShaderProgram*)request.result, request.permutationId });
 						++result;
 					}
 				}
@@ -558,22 +648,25 @@ namespace Render
 
 	int ShaderManager::loadAllGlobalShaders()
 	{
-		int numFailLoad = 0;
+		TArray< ShaderConstructRequest > requests;
 		for (auto& pair : mGlobalShaderMap)
 		{
-			ShaderObject* shaderObject = pair.second;
-			if (shaderObject == nullptr)
-			{
-				GlobalShaderEntry const& entry = pair.first;
-				ShaderCompileOption option;
-				shaderObject = constructGlobalShader(*entry.shaderClass, entry.permutationId, option);
-				mGlobalShaderMap[entry] = shaderObject;
-			}
+			if (pair.second)
+				continue;
 
-			if( shaderObject == nullptr )
-			{
-				++numFailLoad;
-			}
+			ShaderConstructRequest* request = requests.addDefault();
+			request->shaderClass = pair.first.shaderClass;
+			request->permutationId = pair.first.permutationId;
+			request->classType = ShaderClassType::Global;
+		}
+
+		int numFailLoad = constructShaderBatch(MakeView(requests));
+		for (ShaderConstructRequest const& request : requests)
+		{
+			GlobalShaderEntry entry;
+			entry.shaderClass = request.shaderClass;
+			entry.permutationId = request.permutationId;
+			mGlobalShaderMap[entry] = request.result;
 		}
 		return numFailLoad;
 	}
@@ -588,68 +681,198 @@ namespace Render
 		ShaderObject* result = (*shaderObjectClass.CreateShaderObject)();
 		if( result )
 		{
+			ShaderManagedDataBase* managedData = setupShaderObject(*result, shaderObjectClass, permutationId, option, classType);
+
+			bool bBuilded = false;
 			switch (result->getObjectType())
 			{
 			case EShaderObjectType::Program:
-				{
-					GlobalShaderProgram* shaderProgram = static_cast<GlobalShaderProgram*>(result);
-					GlobalShaderProgramClass const& shaderProgramClass = static_cast<GlobalShaderProgramClass const&>(shaderObjectClass);
-					shaderProgramClass.SetupShaderCompileOption(option, permutationId);
+				bBuilded = buildShader(static_cast<ShaderProgramManagedData&>(*managedData));
+				break;
+			case EShaderObjectType::Shader:
+				bBuilded = buildShader(static_cast<ShaderManagedData&>(*managedData));
+				break;
+			}
+
+			if ( bBuilded )
+			{
+				postShaderLoaded(*result, *managedData, classType);
+			}
+			else
+			{
+				LogWarning(0, "Can't Load Shader %s", shaderObjectClass.GetShaderFileName());
+				delete managedData;
+				delete result;
+				result = nullptr;
+			}
+		}
+
+		return result;
+	}
+
+	ShaderManagedDataBase* ShaderManager::setupShaderObject(ShaderObject& shaderObject, GlobalShaderObjectClass const& shaderObjectClass, uint32 permutationId, ShaderCompileOption& option, ShaderClassType classType)
+	{
+		ShaderManagedDataBase* result = nullptr;
+		switch (shaderObject.getObjectType())
+		{
+		case EShaderObjectType::Program:
+			{
+				GlobalShaderProgramClass const& shaderProgramClass = static_cast<GlobalShaderProgramClass const&>(shaderObjectClass);
+				shaderProgramClass.SetupShaderCompileOption(option, permutationId);
+
+				ShaderProgramManagedData* managedData = new ShaderProgramManagedData;
+				managedData->classType = classType;
+				managedData->shaderProgram = static_cast<GlobalShaderProgram*>(&shaderObject);
+				setupManagedData(*managedData, shaderProgramClass.GetShaderEntries(permutationId), option, shaderProgramClass.GetShaderFileName(), true);
+				result = managedData;
+			}
+			break;
+		case EShaderObjectType::Shader:
+			{
+				GlobalShaderClass const& shaderClass = static_cast<GlobalShaderClass const&>(shaderObjectClass);
+				shaderClass.SetupShaderCompileOption(option, permutationId);
+
+				ShaderManagedData* managedData = new ShaderManagedData;
+				managedData->classType = classType;
+				managedData->shader = static_cast<GlobalShader*>(&shaderObject);
+				setupManagedData(*managedData, shaderClass.entry, option, shaderClass.GetShaderFileName());
+				result = managedData;
+			}
+			break;
+		default:
+			NEVER_REACH("Unknow Shader Object Type");
+			break;
+		}
+
+		result->shaderClass = &shaderObjectClass;
+		result->permutationId = permutationId;
+		return result;
+	}
+
+	int ShaderManager::constructShaderBatch(TArrayView< ShaderConstructRequest > requests)
+	{
+		TIME_SCOPE("Construct Shader Batch");
+
+		bool const bCanBuild = RHIIsInitialized();
+
+		struct BuildEntry
+		{
+			ShaderObject* shaderObject;
+			ShaderManagedDataBase* managedData;
+			bool bLoaded;
+		};
+		TArray< BuildEntry > buildEntries;
+		buildEntries.resize(requests.size());
+
+		ShaderPreprocessBatch batch;
+		for (int index = 0; index < (int)requests.size(); ++index)
+		{
+			ShaderConstructRequest& request = requests[index];
+			BuildEntry& buildEntry = buildEntries[index];
+			request.result = nullptr;
+			buildEntry.managedData = nullptr;
+			buildEntry.bLoaded = false;
+			buildEntry.shaderObject = (*request.shaderClass->CreateShaderObject)();
+			if (buildEntry.shaderObject == nullptr)
+				continue;
 
-					ShaderProgramManagedData* managedData = loadInternal(
-						*shaderProgram, shaderProgramClass.GetShaderFileName(),
-						shaderProgramClass.GetShaderEntries(permutationId), option,
-						true, classType);
+			buildEntry.managedData = setupShaderObject(*buildEntry.shaderObject, *request.shaderClass, request.permutationId, request.option, request.classType);
+			if (!bCanBuild)
+				continue;
 
-					if ( managedData )
+			//Same as buildShader , the cache data is used first and only the missing shaders are preprocessed
+			switch (buildEntry.shaderObject->getObjectType())
+			{
+			case EShaderObjectType::Program:
+				{
+					ShaderProgramManagedData& managedData = static_cast<ShaderProgramManagedData&>(*buildEntry.managedData);
+					if (getCache()->loadCacheData(*mShaderFormat, managedData))
 					{
-						managedData->shaderClass = &shaderObjectClass;
-						managedData->permutationId = permutationId;
+						mShaderFormat->postShaderLoaded(*managedData.shaderProgram->mRHIResource);
+						buildEntry.bLoaded = true;
 					}
 					else
 					{
-						LogWarning(0, "Can't Load Shader %s", shaderProgramClass.GetShaderFileName());
-						delete result;
-						result = nullptr;
+						for (ShaderCompileDesc const& desc : managedData.descList)
+						{
+							batch.addJob(desc);
+						}
 					}
 				}
 				break;
 			case EShaderObjectType::Shader:
 				{
-					GlobalShader* shader = static_cast<GlobalShader*>(result);
-					GlobalShaderClass const& shaderClass = static_cast<GlobalShaderClass const&>(shaderObjectClass);
+					ShaderManagedData& managedData = static_cast<ShaderManagedData&>(*buildEntry.managedData);
+					batch.addJob(managedData.desc);
+				}
+				break;
+			}
+		}
 
-					shaderClass.SetupShaderCompileOption(option, permutationId);
+		if (!batch.jobs.empty())
+		{
+			if (mSourceLibrary == nullptr)
+			{
+				mSourceLibrary = new CPP::CodeSourceLibrary;
+			}
+			if (mPreprocessThreadPool == nullptr)
+			{
+				mPreprocessThreadPool = new QueueThreadPool;
+				mPreprocessThreadPool->init(Math::Max(1, SystemPlatform::GetProcessorNumber() - 1));
+			}
+			ShaderFormat::PreprocessCodes(MakeView(batch.jobs), mShaderFormat->getPreprocessSettings(), *mSourceLibrary, mPreprocessThreadPool);
+		}
 
-					ShaderManagedData* managedData = loadInternal(
-						*shader, shaderClass.GetShaderFileName(), shaderClass.entry, option, classType);
+		mPreprocessBatch = &batch;
+		int numFail = 0;
+		for (int index = 0; index < (int)requests.size(); ++index)
+		{
+			ShaderConstructRequest& request = requests[index];
+			BuildEntry& buildEntry = buildEntries[index];
+			if (buildEntry.shaderObject == nullptr)
+			{
+				++numFail;
+				continue;
+			}
 
-					if ( managedData )
-					{
-						managedData->shaderClass = &shaderObjectClass;
-						managedData->permutationId = permutationId;
-					}
-					else
+			bool bBuilded = buildEntry.bLoaded;
+			if (!bBuilded && bCanBuild)
+			{
+				switch (buildEntry.shaderObject->getObjectType())
+				{
+				case EShaderObjectType::Program:
 					{
-						LogWarning(0, "Can't Load Shader %s", shaderClass.GetShaderFileName());
-						delete result;
-						result = nullptr;
+						ShaderProgramManagedData& managedData = static_cast<ShaderProgramManagedData&>(*buildEntry.managedData);
+						bBuilded = compileShader(managedData);
+						if (bBuilded)
+						{
+							mShaderFormat->postShaderLoaded(*managedData.shaderProgram->mRHIResource);
+						}
 					}
+					break;
+				case EShaderObjectType::Shader:
+					bBuilded = compileShader(static_cast<ShaderManagedData&>(*buildEntry.managedData));
+					break;
 				}
-				break;
-
-			default:
-				NEVER_REACH("Unknow Shader Object Type");
-				break;
 			}
-		}
-		else
-		{
 
-			
+			if (bBuilded)
+			{
+				postShaderLoaded(*buildEntry.shaderObject, *buildEntry.managedData, request.classType);
+				request.result = buildEntry.shaderObject;
+			}
+			else
+			{
+				LogWarning(0, "Can't Load Shader %s", request.shaderClass->GetShaderFileName());
+				delete buildEntry.managedData;
+				delete buildEntry.shaderObject;
+				++numFail;
+			}
 		}
+		mPreprocessBatch = nullptr;
 
-		return result;
+		LogDevMsg(0, "Shader Batch : %d shaders , %d preprocess jobs , %d share compiled code", (int)requests.size(), (int)batch.jobs.size(), batch.numSharedBinary);
+		return numFail;
 	}
 
 	void ShaderManager::cleanupGlobalShader()
@@ -878,9 +1101,22 @@ namespace Render
 
 	bool LoadCode(ShaderCompileContext& context, ShaderFormat& format, TArray<uint8>& outCodeBuffer)
 	{
-		if (context.bUsePreprocess)
+		if (context.bUsePreprocess && context.preprocessJob)
+		{
+			ShaderPreprocessJob const& job = *context.preprocessJob;
+			if (context.includeFiles)
+			{
+				context.includeFiles->insert(job.includeFiles.begin(), job.includeFiles.end());
+			}
+			if (context.readMacros)
+			{
+				context.readMacros->insert(job.readMacros.begin(), job.readMacros.end());
+			}
+			context.codes.push_back(StringView((char const*)job.code.data(), job.code.size()));
+		}
+		else if (context.bUsePreprocess)
 		{
-			if (!format.preprocessCode(context.haveFile() ? context.getPath() : nullptr, context.desc, context.getDefinition(), context.sourceLibrary, outCodeBuffer, context.includeFiles, context.bOuputPreprocessedCode))
+			if (!format.preprocessCode(context.haveFile() ? context.getPath() : nullptr, context.desc, context.getDefinition(), context.sourceLibrary, outCodeBuffer, context.includeFiles, context.readMacros, context.bOuputPreprocessedCode))
 				return false;
 
 			context.codes.push_back(StringView((char const*)outCodeBuffer.data(), outCodeBuffer.size()));
@@ -950,6 +1186,8 @@ namespace Render
 					{
 						context.sourceLibrary->cleanup();
 					}
+					//The files may be fixed , preprocess them again
+					context.preprocessJob = nullptr;
 					context.codes.resize(numCodes);
 				}
 				break;
@@ -967,9 +1205,9 @@ namespace Render
 		if ( !RHIIsInitialized() )
 			return false;
 
-		if (bForceReload)
+		if (bForceReload && mSourceLibrary)
 		{
-			cleanupLoadedSource();
+			mSourceLibrary->refreshModifiedSources();
 		}
 
 		TIME_SCOPE("Build Shader Program");
@@ -990,84 +1228,133 @@ namespace Render
 		}
 		else
 		{
-			if (!managedData.sourceFile.empty())
-			{
-				LogDevMsg(0, "Recompile shader : %s , source file : %s ", managedData.descList[0].filePath.c_str(), managedData.sourceFile.c_str());
-			}
-			else
-			{
-				LogDevMsg(0, "Recompile shader : %s ", managedData.descList[0].filePath.c_str());
-			}
+			if (!compileShader(managedData))
+				return false;
+		}
 
-			ShaderProgramSetupData setupData;
+		mShaderFormat->postShaderLoaded(*shaderProgram.mRHIResource);
+		return true;
+	}
 
-			shaderProgram.mRHIResource.release();
-			setupData.resource = RHICreateShaderProgram();
-			if (!setupData.resource.isValid())
-				return false;
-	
-			setupData.descList = MakeConstView(managedData.descList);
-			mShaderFormat->precompileCode(setupData);
+	bool ShaderManager::compileShader(ShaderProgramManagedData& managedData)
+	{
+		ShaderProgram& shaderProgram = *managedData.shaderProgram;
 
-			ShaderResourceInfo shaders[EShader::MaxStorageSize];
-			int shaderIndex = 0;
-			bool bFailed = false;
+		if (!managedData.sourceFile.empty())
+		{
+			LogDevMsg(0, "Recompile shader : %s , source file : %s ", managedData.descList[0].filePath.c_str(), managedData.sourceFile.c_str());
+		}
+		else
+		{
+			LogDevMsg(0, "Recompile shader : %s ", managedData.descList[0].filePath.c_str());
+		}
 
-			for (ShaderCompileDesc& desc : managedData.descList)
-			{
-				LogDevMsg(0, "Shader Entry: %s ", desc.entryName.c_str());
+		managedData.readMacros.clear();
+		managedData.sourceSerial = mSourceLibrary ? mSourceLibrary->getChangeSerial() : 0;
 
-				ShaderCompileContext  context;
-				context.programSetupData = &setupData;
-				context.shaderIndex = shaderIndex;
-				context.desc = &desc;
-				context.bAllowRecompile = context.haveFile();
-				context.includeFiles = &managedData.includeFiles;
-				if (context.bAllowRecompile)
+		//Permutations of a batch with identical preprocessed codes share the binary code
+		std::string codeKey;
+		bool bShareBinaryCode = mPreprocessBatch && mShaderFormat->doesSuppurtBinaryCode() && mPreprocessBatch->getCodeKey(managedData.descList, codeKey);
+		if (bShareBinaryCode)
+		{
+			auto iter = mPreprocessBatch->binaryCodeMap.find(codeKey);
+			if (iter != mPreprocessBatch->binaryCodeMap.end())
+			{
+				ShaderCacheBinaryData binaryData;
+				binaryData.codeBuffer = iter->second;
+				if (binaryData.setupProgram(*mShaderFormat, shaderProgram, managedData.descList))
 				{
-					if (mSourceLibrary == nullptr)
+					mPreprocessBatch->addDependencies(managedData.descList, managedData.includeFiles, managedData.readMacros);
+					++mPreprocessBatch->numSharedBinary;
+					if (CVarShaderUseCache && !getCache()->saveCacheData(*mShaderFormat, iter->second, managedData))
 					{
-						mSourceLibrary = new CPP::CodeSourceLibrary;
+						LogWarning(0, "Can't Save ShaderProgram Cache");
 					}
-					context.sourceLibrary = mSourceLibrary;
+					return true;
 				}
+			}
+		}
 
-				if (!CompileCode(context, *mShaderFormat))
-				{
-					bFailed = true;
-				}
+		ShaderProgramSetupData setupData;
 
-				if (managedData.bShowComplieInfo)
-				{
+		shaderProgram.mRHIResource.release();
+		setupData.resource = RHICreateShaderProgram();
+		if (!setupData.resource.isValid())
+			return false;
 
-				}
+		setupData.descList = MakeConstView(managedData.descList);
+		mShaderFormat->precompileCode(setupData);
 
-				++shaderIndex;
+		ShaderResourceInfo shaders[EShader::MaxStorageSize];
+		int shaderIndex = 0;
+		bool bFailed = false;
+
+		for (ShaderCompileDesc& desc : managedData.descList)
+		{
+			LogDevMsg(0, "Shader Entry: %s ", desc.entryName.c_str());
+
+			ShaderCompileContext  context;
+			context.programSetupData = &setupData;
+			context.shaderIndex = shaderIndex;
+			context.desc = &desc;
+			context.bAllowRecompile = context.haveFile();
+			context.includeFiles = &managedData.includeFiles;
+			context.readMacros = &managedData.readMacros;
+			if (context.bAllowRecompile)
+			{
+				if (mSourceLibrary == nullptr)
+				{
+					mSourceLibrary = new CPP::CodeSourceLibrary;
+				}
+				context.sourceLibrary = mSourceLibrary;
+			}
+			if (mPreprocessBatch)
+			{
+				context.preprocessJob = mPreprocessBatch->findJob(desc);
 			}
 
-			if (bFailed)
+			if (!CompileCode(context, *mShaderFormat))
 			{
-				return false;
+				bFailed = true;
 			}
-	
-			shaderProgram.mRHIResource = setupData.resource;
-			shaderProgram.preInitialize();
 
-			ShaderParameterMap* parameterMap = mShaderFormat->initializeProgram(*shaderProgram.mRHIResource, setupData);
-			if (parameterMap == nullptr)
+			if (managedData.bShowComplieInfo)
 			{
-				shaderProgram.mRHIResource.release();
-				return false;
+
 			}
-			shaderProgram.bindParameters(*parameterMap);
 
-			if (CVarShaderUseCache && !getCache()->saveCacheData(*mShaderFormat, setupData, managedData))
+			++shaderIndex;
+		}
+
+		if (bFailed)
+		{
+			return false;
+		}
+
+		shaderProgram.mRHIResource = setupData.resource;
+		shaderProgram.preInitialize();
+
+		ShaderParameterMap* parameterMap = mShaderFormat->initializeProgram(*shaderProgram.mRHIResource, setupData);
+		if (parameterMap == nullptr)
+		{
+			shaderProgram.mRHIResource.release();
+			return false;
+		}
+		shaderProgram.bindParameters(*parameterMap);
+
+		if (bShareBinaryCode)
+		{
+			TArray< uint8 > binaryCode;
+			if (mShaderFormat->getBinaryCode(setupData, binaryCode))
 			{
-				LogWarning(0, "Can't Save ShaderProgram Cache");
+				mPreprocessBatch->binaryCodeMap.emplace(codeKey, std::move(binaryCode));
 			}
 		}
 
-		mShaderFormat->postShaderLoaded(*shaderProgram.mRHIResource);
+		if (CVarShaderUseCache && !getCache()->saveCacheData(*mShaderFormat, setupData, managedData))
+		{
+			LogWarning(0, "Can't Save ShaderProgram Cache");
+		}
 		return true;
 	}
 
@@ -1090,14 +1377,13 @@ namespace Render
 		if (!RHIIsInitialized())
 			return false;
 
-		if (bForceReload)
+		if (bForceReload && mSourceLibrary)
 		{
-			cleanupLoadedSource();
+			mSourceLibrary->refreshModifiedSources();
 		}
 
 		TIME_SCOPE("Build Shader");
 
-		Shader& shader = *managedData.shader;
 		bForceReload = true;
 		if (!bForceReload && getCache()->loadCacheData(*mShaderFormat, managedData))
 		{
@@ -1105,71 +1391,142 @@ namespace Render
 		}
 		else
 		{
-			LogDevMsg(0, "Recompile shader : %s, Entry = %s", GetCompileInfo(managedData).c_str(), managedData.desc.entryName.c_str());
-
-			ShaderSetupData setupData;
-			shader.mRHIResource.release();
-			setupData.resource = RHICreateShader(managedData.desc.type);
-			if (!setupData.resource.isValid())
+			if (!compileShader(managedData))
 				return false;
+		}
 
-			setupData.desc = &managedData.desc;
+		return true;
+	}
 
-			mShaderFormat->precompileCode(setupData);
+	bool ShaderManager::checkSourceModified(ShaderManagedDataBase& managedData, TArrayView< ShaderCompileDesc const > descList)
+	{
+		if (mSourceLibrary == nullptr)
+			return true;
 
-			bool bFailed = false;
+		mSourceLibrary->refreshModifiedSources();
 
+		std::unordered_set< HashString > files = managedData.includeFiles;
+		for (ShaderCompileDesc const& desc : descList)
+		{
+			if (!desc.filePath.empty())
 			{
-				ShaderCompileContext  context;
-				context.shaderSetupData = &setupData;
-				context.shaderIndex = 0;
-				context.desc = &managedData.desc;
-				context.includeFiles = &managedData.includeFiles;
-				context.bAllowRecompile = context.haveFile();
-				if (context.bAllowRecompile)
-				{
-					if (mSourceLibrary == nullptr)
-					{
-						mSourceLibrary = new CPP::CodeSourceLibrary;
-					}
-					context.sourceLibrary = mSourceLibrary;
-				}
+				files.insert(desc.filePath);
+			}
+		}
+
+		if (mSourceLibrary->isTranslationAffected(managedData.sourceSerial, files, managedData.readMacros))
+			return true;
+
+		//Only the values of the macros the shader doesn't read are changed
+		managedData.sourceSerial = mSourceLibrary->getChangeSerial();
+		LogDevMsg(0, "Skip recompile shader : %s , the modified codes are not used", descList[0].filePath.c_str());
+		return false;
+	}
+
+	bool ShaderManager::compileShader(ShaderManagedData& managedData)
+	{
+		Shader& shader = *managedData.shader;
 
-				if (!CompileCode(context, *mShaderFormat))
+		LogDevMsg(0, "Recompile shader : %s, Entry = %s", GetCompileInfo(managedData).c_str(), managedData.desc.entryName.c_str());
+
+		managedData.readMacros.clear();
+		managedData.sourceSerial = mSourceLibrary ? mSourceLibrary->getChangeSerial() : 0;
+
+		TArrayView< ShaderCompileDesc const > descList(&managedData.desc, 1);
+		std::string codeKey;
+		bool bShareBinaryCode = mPreprocessBatch && mShaderFormat->doesSuppurtBinaryCode() && mPreprocessBatch->getCodeKey(descList, codeKey);
+		if (bShareBinaryCode)
+		{
+			auto iter = mPreprocessBatch->binaryCodeMap.find(codeKey);
+			if (iter != mPreprocessBatch->binaryCodeMap.end())
+			{
+				ShaderCacheBinaryData binaryData;
+				binaryData.codeBuffer = iter->second;
+				if (binaryData.setupShader(*mShaderFormat, shader, managedData.desc))
 				{
-					bFailed = true;
+					mPreprocessBatch->addDependencies(descList, managedData.includeFiles, managedData.readMacros);
+					++mPreprocessBatch->numSharedBinary;
+					mShaderFormat->postShaderLoaded(*shader.mRHIResource);
+					return true;
 				}
+			}
+		}
 
-				if (managedData.bShowComplieInfo)
-				{
+		ShaderSetupData setupData;
+		shader.mRHIResource.release();
+		setupData.resource = RHICreateShader(managedData.desc.type);
+		if (!setupData.resource.isValid())
+			return false;
+
+		setupData.desc = &managedData.desc;
+
+		mShaderFormat->precompileCode(setupData);
+
+		bool bFailed = false;
 
+		{
+			ShaderCompileContext  context;
+			context.shaderSetupData = &setupData;
+			context.shaderIndex = 0;
+			context.desc = &managedData.desc;
+			context.includeFiles = &managedData.includeFiles;
+			context.readMacros = &managedData.readMacros;
+			context.bAllowRecompile = context.haveFile();
+			if (context.bAllowRecompile)
+			{
+				if (mSourceLibrary == nullptr)
+				{
+					mSourceLibrary = new CPP::CodeSourceLibrary;
 				}
+				context.sourceLibrary = mSourceLibrary;
 			}
-
-			if (bFailed)
+			if (mPreprocessBatch)
 			{
-				return false;
+				context.preprocessJob = mPreprocessBatch->findJob(managedData.desc);
 			}
 
-			shader.mRHIResource = setupData.resource;
-			shader.preInitialize();
+			if (!CompileCode(context, *mShaderFormat))
+			{
+				bFailed = true;
+			}
 
-			ShaderParameterMap* parameterMap = mShaderFormat->initializeShader(*shader.mRHIResource, setupData);
-			if (parameterMap == nullptr)
+			if (managedData.bShowComplieInfo)
 			{
-				shader.mRHIResource.release();
-				return false;
+
 			}
-			shader.bindParameters(*parameterMap);
+		}
 
-			if (CVarShaderUseCache && !getCache()->saveCacheData(*mShaderFormat, setupData, managedData))
+		if (bFailed)
+		{
+			return false;
+		}
+
+		shader.mRHIResource = setupData.resource;
+		shader.preInitialize();
+
+		ShaderParameterMap* parameterMap = mShaderFormat->initializeShader(*shader.mRHIResource, setupData);
+		if (parameterMap == nullptr)
+		{
+			shader.mRHIResource.release();
+			return false;
+		}
+		shader.bindParameters(*parameterMap);
+
+		if (bShareBinaryCode)
+		{
+			TArray< uint8 > binaryCode;
+			if (mShaderFormat->getBinaryCode(setupData, binaryCode))
 			{
-				LogWarning(0, "Can't Save Shader Cache");
+				mPreprocessBatch->binaryCodeMap.emplace(codeKey, std::move(binaryCode));
 			}
+		}
 
-			mShaderFormat->postShaderLoaded(*shader.mRHIResource);
+		if (CVarShaderUseCache && !getCache()->saveCacheData(*mShaderFormat, setupData, managedData))
+		{
+			LogWarning(0, "Can't Save Shader Cache");
 		}
 
+		mShaderFormat->postShaderLoaded(*shader.mRHIResource);
 		return true;
 	}
 
@@ -1349,8 +1706,10 @@ namespace Render
 	{
 		if (action == EFileAction::Modify || action == EFileAction::Rename)
 		{
-			ShaderManager::Get().buildShader(*this, true);
-			ShaderManager::Get().cleanupLoadedSource();
+			if (ShaderManager::Get().checkSourceModified(*this, descList))
+			{
+				ShaderManager::Get().buildShader(*this, true);
+			}
 		}
 	}
 
@@ -1379,8 +1738,10 @@ namespace Render
 	{
 		if (action == EFileAction::Modify || action == EFileAction::Rename)
 		{
-			ShaderManager::Get().buildShader(*this, true);
-			ShaderManager::Get().cleanupLoadedSource();
+			if (ShaderManager::Get().checkSourceModified(*this, TArrayView< ShaderCompileDesc const >(&desc, 1)))
+			{
+				ShaderManager::Get().buildShader(*this, true);
+			}
 		}
 	}
 
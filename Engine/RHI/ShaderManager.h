@@ -22,6 +22,7 @@ namespace CPP
 }
 
 class DataCacheInterface;
+class QueueThreadPool;
 
 namespace Render
 {
@@ -47,6 +48,9 @@ namespace Render
 		bool           bShowComplieInfo = false;
 		std::string    sourceFile;
 		std::unordered_set< HashString > includeFiles;
+		//Macros the preprocessed codes read and the change serial of the source library when they were compiled
+		std::unordered_set< HashString > readMacros;
+		uint32         sourceSerial = 0;
 	};
 
 	class ShaderProgramManagedData : public ShaderManagedDataBase
@@ -145,6 +149,20 @@ namespace Render
 		ShaderObject* constructGlobalShader(GlobalShaderObjectClass const& shaderObjectClass, uint32 permutationId, ShaderCompileOption& option);
 		ShaderObject* constructShaderInternal(GlobalShaderObjectClass const& shaderObjectClass, uint32 permutationId, ShaderCompileOption& option, ShaderClassType classType);
 
+		struct ShaderConstructRequest
+		{
+			GlobalShaderObjectClass const* shaderClass;
+			uint32 permutationId;
+			ShaderCompileOption option;
+			ShaderClassType classType;
+
+			ShaderObject* result = nullptr;
+		};
+		// Construct the shaders in a batch : the permutations which don't use the cache data are preprocessed on a thread pool,
+		// then compiled on the calling thread and the identical preprocessed codes only compile once.
+		// Return the number of the fail requests
+		int  constructShaderBatch(TArrayView< ShaderConstructRequest > requests);
+
 		void cleanupGlobalShader();
 
 		bool loadFileSimple(ShaderProgram& shaderProgram, char const* fileName, char const* def = nullptr);
@@ -221,6 +239,11 @@ namespace Render
 		};
 		bool buildShader(ShaderProgramManagedData& managedData, bool bForceReload = false );
 		bool buildShader(ShaderManagedData& managedData, bool bForceReload = false);
+		bool compileShader(ShaderProgramManagedData& managedData);
+		bool compileShader(ShaderManagedData& managedData);
+		bool checkSourceModified(ShaderManagedDataBase& managedData, TArrayView< ShaderCompileDesc const > descList);
+
+		ShaderManagedDataBase* setupShaderObject(ShaderObject& shaderObject, GlobalShaderObjectClass const& shaderObjectClass, uint32 permutationId, ShaderCompileOption& option, ShaderClassType classType);
 
 		void removeFromShaderCompileMap(ShaderObject& shader);
 
@@ -248,6 +271,8 @@ namespace Render
 		ShaderCache* getCache();
 
 		CPP::CodeSourceLibrary* mSourceLibrary = nullptr;
+		QueueThreadPool*        mPreprocessThreadPool = nullptr;
+		class ShaderPreprocessBatch* mPreprocessBatch = nullptr;
 		struct GlobalShaderEntry
 		{
 			uint32 permutationId;
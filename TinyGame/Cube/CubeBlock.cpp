@@ -16,6 +16,7 @@ namespace Cube
 		(*new Block(BLOCK_BASE)).setSolid(true);
 		(*new Block(BLOCK_ROCK)).setSolid(true);
 		(*new LiquidBlock( BLOCK_WATER ) ).setSolid( false );
+		(*new Block(BLOCK_TORCH)).setSolid(true).setLightValue(14);
 	}
 
 	Block* Block::Get( BlockId id )
@@ -26,6 +27,7 @@ namespace Cube
 	Block::Block( BlockId id ) :mId( id )
 		,mbSolid( true )
 		,mbFullCube( true )
+		,mLightValue( 0 )
 	{
 		if ( sBlockMap[ id ] )
 		{
@@ -32,6 +32,10 @@ namespace Cube
 		bool    isFullCube() { return mbFullCube; }
 		Block&  setFullCube(bool bFull = true) { mbFullCube = bFull; return *this; }
 
+		//The block light level of the emitted light
+		uint8   getLightValue() { return mLightValue; }
+		Block&  setLightValue(uint8 value) { mLightValue = value; return *this; }
+
 		virtual unsigned    calcRenderFaceMask( IBlockAccess& blockAccess , Vec3i const& blockPos);
 		virtual bool        canPlaceItem( FaceSide face , ItemId itemId ){ return false; }
 		virtual void        onNeighborBlockModify( IBlockAccess& blockAccess , Vec3i const& blockPos, FaceSide face ){}
@@ -40,6 +44,7 @@ namespace Cube
 		BlockId mId;
 		bool    mbSolid;
 		bool    mbFullCube;
+		uint8   mLightValue;
 	};
 
 	class LiquidBlock : public Block
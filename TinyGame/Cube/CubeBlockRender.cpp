@@ -35,6 +35,31 @@ namespace Cube
 			vertex.uv[1] = uv.y;
 		}
 
+		// The brightness drops 20% per light level , the block light is warmer than the sky light
+		struct LightColorTable
+		{
+			LightColorTable()
+			{
+				for (int light = 0; light < 256; ++light)
+				{
+					int skyLevel = light >> 4;
+					int blockLevel = light & 0xf;
+					float sky = Math::Pow(0.8f, float(MaxLightLevel - skyLevel));
+					float block = blockLevel ? Math::Pow(0.8f, float(MaxLightLevel - blockLevel)) : 0.0f;
+					auto ToByte = [](float value) { return uint8(Math::RoundToInt(255.0f * Math::Clamp(value, 0.0f, 1.0f))); };
+					colors[light] = Color4ub(ToByte(Math::Max(sky, block)), ToByte(Math::Max(sky, 0.9f * block)), ToByte(Math::Max(sky, 0.75f * block)), 255);
+				}
+			}
+			Color4ub colors[256];
+		};
+
+		FORCEINLINE Color4ub GetLightColor(uint8 packedLight, Color4ub const& tint)
+		{
+			static LightColorTable const Table;
+			Color4ub const& color = Table.colors[packedLight];
+			return Color4ub(color.r * tint.r / 255, color.g * tint.g / 255, color.b * tint.b / 255, tint.a);
+		}
+
 		bool HasAnyRenderableFace(PaddedBlockAccess const& access)
 		{
 			for (int x = 1; x <= ChunkSize; ++x)
@@ -103,11 +128,36 @@ namespace Cube
 				blocks[x][y][Chunk::LayerSize + 1] = 0;
 			}
 		}
+		// A missing layer or chunk has the full sky light.
+		FMemory::Set(lights, PackLight(MaxLightLevel, 0), sizeof(lights));
+
+		auto FillColumn = [&](Chunk::LayerData const& layer, int x, int y, int lx, int ly)
+		{
+			layer.blocks.getColumn(x, y, &blocks[lx][ly][1]);
+
+			Chunk::LightStorage const& skyLight = layer.lights[(int)ELightType::Sky];
+			Chunk::LightStorage const& blockLight = layer.lights[(int)ELightType::Block];
+			uint8* outLights = &lights[lx][ly][1];
+			if (skyLight.isUniform() && blockLight.isUniform())
+			{
+				FMemory::Set(outLights, PackLight(skyLight.getUniformLevel(), blockLight.getUniformLevel()), Chunk::LayerSize);
+				return;
+			}
+
+			uint8 skyLevels[Chunk::LayerSize];
+			uint8 blockLevels[Chunk::LayerSize];
+			skyLight.getColumn(x, y, skyLevels);
+			blockLight.getColumn(x, y, blockLevels);
+			for (int z = 0; z < Chunk::LayerSize; ++z)
+				outLights[z] = PackLight(skyLevels[z], blockLevels[z]);
+		};
 
 		auto FillLayer = [&](int ox, int oy, Chunk* chunk)
 		{
 			if (!chunk) return;
-			auto layer = chunk->mLayer[layerIdx];
+
+			RWLock::ReadLocker locker(chunk->mBlockLock);
+			Chunk::LayerData* layer = chunk->mLayer[layerIdx];
 			if (!layer) return;
 
 			if (ox == 0 && oy == 0)
@@ -115,7 +165,7 @@ namespace Cube
 				for (int x = 0; x < ChunkSize; ++x)
 				{
 					for (int y = 0; y < ChunkSize; ++y)
-						FMemory::Copy(&blocks[x + 1][y + 1][1], &layer->blockMap[x][y][0], Chunk::LayerSize * sizeof(BlockId));
+						FillColumn(*layer, x, y, x + 1, y + 1);
 				}
 			}
 			else
@@ -127,13 +177,13 @@ namespace Cube
 				{
 					int sx = (ox == 1) ? 0 : ChunkSize - 1;
 					for (int y = 0; y < ChunkSize; ++y)
-						FMemory::Copy(&blocks[lx][y + 1][1], &layer->blockMap[sx][y][0], Chunk::LayerSize * sizeof(BlockId));
+						FillColumn(*layer, sx, y, lx, y + 1);
 				}
 				else if (oy != 0)
 				{
 					int sy = (oy == 1) ? 0 : ChunkSize - 1;
 					for (int x = 0; x < ChunkSize; ++x)
-						FMemory::Copy(&blocks[x + 1][ly][1], &layer->blockMap[x][sy][0], Chunk::LayerSize * sizeof(BlockId));
+						FillColumn(*layer, x, sy, x + 1, ly);
 				}
 			}
 		};
@@ -145,19 +195,28 @@ namespace Cube
 		FillLayer(0, -1, chunkAccess.mNeighborChunks[FACE_NY]);
 
 		// Z neighbors
-		if (layerIdx > 0 && center->mLayer[layerIdx - 1])
+		RWLock::ReadLocker locker(center->mBlockLock);
+		auto FillZNeighbor = [&](Chunk::LayerData const& layer, int z, int lz)
 		{
-			auto layer = center->mLayer[layerIdx - 1];
+			Chunk::LightStorage const& skyLight = layer.lights[(int)ELightType::Sky];
+			Chunk::LightStorage const& blockLight = layer.lights[(int)ELightType::Block];
 			for (int x = 0; x < ChunkSize; ++x)
+			{
 				for (int y = 0; y < ChunkSize; ++y)
-					blocks[x + 1][y + 1][0] = layer->blockMap[x][y][Chunk::LayerSize - 1];
+				{
+					int index = Chunk::BlockStorage::GetIndex(x, y, z);
+					blocks[x + 1][y + 1][lz] = layer.blocks.get(index);
+					lights[x + 1][y + 1][lz] = PackLight(skyLight.get(index), blockLight.get(index));
+				}
+			}
+		};
+		if (layerIdx > 0 && center->mLayer[layerIdx - 1])
+		{
+			FillZNeighbor(*center->mLayer[layerIdx - 1].load(std::memory_order_acquire), Chunk::LayerSize - 1, 0);
 		}
 		if (layerIdx < Chunk::NumLayer - 1 && center->mLayer[layerIdx + 1])
 		{
-			auto layer = center->mLayer[layerIdx + 1];
-			for (int x = 0; x < ChunkSize; ++x)
-				for (int y = 0; y < ChunkSize; ++y)
-					blocks[x + 1][y + 1][Chunk::LayerSize + 1] = layer->blockMap[x][y][0];
+			FillZNeighbor(*center->mLayer[layerIdx + 1].load(std::memory_order_acquire), 0, Chunk::LayerSize + 1);
 		}
 	}
 
@@ -206,7 +265,7 @@ namespace Cube
 
 	void BlockRenderer::drawLayer(Chunk& chunk, int layerIdx)
 	{
-		auto layer = chunk.mLayer[layerIdx];
+		Chunk::LayerData* layer = chunk.mLayer[layerIdx];
 		if (!layer) 
 			return;
 
@@ -219,7 +278,8 @@ namespace Cube
 		mMesh->mIndices.reserve(mMesh->mIndices.size() + 1536);
 
 		int dims[3] = { ChunkSize, ChunkSize, Chunk::LayerSize };
-		uint16 mask[ChunkSize * Chunk::LayerSize];
+		//Material id in the low 16 bits , the packed light of the face in the next 8 bits
+		uint32 mask[ChunkSize * Chunk::LayerSize];
 		static Vec3f const FaceUVVectorMap[FaceSide::COUNT][2] =
 		{
 			{ Vec3f(0,1,0), Vec3f(0,0,-1) }, { Vec3f(0,1,0), Vec3f(0,0,-1) },
@@ -243,7 +303,7 @@ namespace Cube
 					FaceSide curFace = getFaceSide(axis, side != 0);
 					Vec3i nOffset = GetFaceOffset(curFace);
 
-					FMemory::Set(mask, 0, du * dv * sizeof(uint16));
+					FMemory::Set(mask, 0, du * dv * sizeof(uint32));
 					bool bHasFace = false;
 
 					for (int j = 0; j < dv; ++j)
@@ -271,7 +331,8 @@ namespace Cube
 							bool bExposed = (id == BLOCK_WATER) ? (neighborId != id) : (neighborId == 0);
 							if (bExposed)
 							{
-								mask[i + j * du] = info.matId;
+								uint8 light = paddedAccess->lights[lx + nOffset.x][ly + nOffset.y][lz + nOffset.z];
+								mask[i + j * du] = info.matId | (uint32(light) << 16);
 								bHasFace = true;
 							}
 						}
@@ -284,17 +345,17 @@ namespace Cube
 					{
 						for (int i = 0; i < du; ++i)
 						{
-							uint16 matIdx = mask[i + j * du];
-							if (matIdx == 0) continue;
+							uint32 faceKey = mask[i + j * du];
+							if (faceKey == 0) continue;
 
 							int w, h;
-							for (w = 1; i + w < du && mask[i + w + j * du] == matIdx; ++w);
+							for (w = 1; i + w < du && mask[i + w + j * du] == faceKey; ++w);
 							for (h = 1; j + h < dv; ++h)
 							{
 								bool bSame = true;
 								for (int k_u = 0; k_u < w; ++k_u)
 								{
-									if (mask[i + k_u + (j + h) * du] != matIdx)
+									if (mask[i + k_u + (j + h) * du] != faceKey)
 									{
 										bSame = false;
 										break;
@@ -312,6 +373,8 @@ namespace Cube
 							unsigned vStart = (unsigned)mMesh->mVertices.size();
 							auto faceVerts = GetFaceVertices(curFace);
 							Vec3f normal = GetFaceNoraml(curFace);
+							uint32 matIdx = faceKey & 0xffff;
+							Color4ub faceColor = GetLightColor(uint8(faceKey >> 16), mDebugColor);
 
 							mMesh->mVertices.resize(vStart + 4);
 							Mesh::Vertex* outVertices = mMesh->mVertices.data() + vStart;
@@ -325,7 +388,7 @@ namespace Cube
 								Mesh::Vertex& vertex = outVertices[iv];
 								vertex.pos = Vec3f(mBasePos) + localPos;
 								SetPackedNormal(vertex, normal);
-								vertex.color = mDebugColor;
+								vertex.color = faceColor;
 								SetPackedUV(vertex, Vec2f(FaceUVVectorMap[curFace][0].dot(localPos), FaceUVVectorMap[curFace][1].dot(localPos)));
 								vertex.meta = matIdx;
 								bound += vertex.pos;
@@ -43,8 +43,12 @@ namespace Cube
 	struct PaddedBlockAccess : public IBlockAccess
 	{
 		BlockId blocks[ChunkSize + 2][ChunkSize + 2][Chunk::LayerSize + 2];
+		//Sky light level in the high 4 bits , block light level in the low 4 bits
+		uint8   lights[ChunkSize + 2][ChunkSize + 2][Chunk::LayerSize + 2];
 		Vec3i basePos;
 
+		static uint8 PackLight(uint8 skyLevel, uint8 blockLevel) { return uint8(skyLevel << 4) | blockLevel; }
+
 		void fill(class NeighborChunkAccess const& chunkAccess, Chunk* center, int layerIdx);
 
 		virtual BlockId  getBlockId(int x, int y, int z) override
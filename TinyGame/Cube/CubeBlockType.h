@@ -9,6 +9,7 @@ namespace Cube
 		BLOCK_DIRT = 1,
 		BLOCK_ROCK = 2,
 		BLOCK_WATER ,
+		BLOCK_TORCH ,
 	};
 
 
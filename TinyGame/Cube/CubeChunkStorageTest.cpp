@@ -0,0 +1,324 @@
+#include "CubePCH.h"
+#include "StageRegister.h"
+
+#include "CubeWorld.h"
+#include "CubeRegionFile.h"
+#include "CubeBlockType.h"
+
+#include "FileSystem.h"
+#include "InlineString.h"
+#include "LogSystem.h"
+
+#include <random>
+#include <cstring>
+#include <chrono>
+
+// Compare the palette storage of generated chunks with the dense layer arrays , save the chunks to region files
+// and load them back. A world walking in a line must keep the loaded chunk count bounded by the view distance
+// and an edited block must survive the unload.
+namespace Cube
+{
+	namespace
+	{
+		using Clock = std::chrono::high_resolution_clock;
+
+		char const* const SaveDir = "CubeChunkStorageTest";
+		//The old layer kept a block id , a 4 bit meta and a light value of every block
+		size_t const DenseLayerSize = Chunk::BlockStorage::NumBlock * (sizeof(BlockId) + 1) + Chunk::BlockStorage::NumBlock / 2;
+
+		double GetElapsedMS(Clock::time_point startTime)
+		{
+			return std::chrono::duration< double, std::milli >(Clock::now() - startTime).count();
+		}
+
+		void CleanupSaveDir()
+		{
+			FileIterator fileIter;
+			if (!FFileSystem::FindFiles(SaveDir, ".region", fileIter))
+				return;
+
+			TArray< std::string > paths;
+			for (; fileIter.haveMore(); fileIter.goNext())
+			{
+				paths.push_back(InlineString< 256 >::Make("%s/%s", SaveDir, fileIter.getFileName()).c_str());
+			}
+			for (auto const& path : paths)
+			{
+				FFileSystem::DeleteFile(path.c_str());
+			}
+		}
+
+		bool IsSameBlocks(Chunk& lhs, Chunk& rhs)
+		{
+			for (int z = 0; z < ChunkBlockMaxHeight; ++z)
+			{
+				for (int x = 0; x < ChunkSize; ++x)
+				{
+					for (int y = 0; y < ChunkSize; ++y)
+					{
+						if (lhs.getBlockId(x, y, z) != rhs.getBlockId(x, y, z) || lhs.getBlockMeta(x, y, z) != rhs.getBlockMeta(x, y, z))
+							return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		// Random edits with a growing palette must read back like a dense array
+		bool TestBlockStorage()
+		{
+			std::mt19937 rand(1234);
+			Chunk::BlockStorage storage(BLOCK_ROCK);
+			TArray< BlockId > expectIds;
+			expectIds.resize(Chunk::BlockStorage::NumBlock, BLOCK_ROCK);
+
+			bool bPass = true;
+			int const NumIdSteps[] = { 2, 3, 9, 200 };
+			for (int numId : NumIdSteps)
+			{
+				for (int i = 0; i < 4000; ++i)
+				{
+					int index = rand() % Chunk::BlockStorage::NumBlock;
+					BlockId id = BlockId(rand() % numId);
+					storage.set(index, id);
+					expectIds[index] = id;
+				}
+
+				for (int pass = 0; pass < 2; ++pass)
+				{
+					for (int i = 0; i < Chunk::BlockStorage::NumBlock; ++i)
+						bPass &= storage.get(i) == expectIds[i];
+
+					BlockId column[Chunk::LayerSize];
+					storage.getColumn(7, 11, column);
+					bPass &= memcmp(column, &expectIds[Chunk::BlockStorage::GetIndex(7, 11, 0)], sizeof(column)) == 0;
+					storage.compact();
+				}
+			}
+
+			storage.fill(BLOCK_DIRT);
+			storage.set(5, BLOCK_DIRT);
+			bPass &= storage.isUniform() && storage.get(5) == BLOCK_DIRT;
+			LogMsg("Block Storage : %s", bPass ? "Pass" : "Fail");
+			return bPass;
+		}
+
+		void GenerateChunks(int size, TArray< Chunk* >& outChunks)
+		{
+			LandGenerater generater;
+			generater.height = 256;
+			Random rand;
+			rand.setSeed(0);
+			for (int y = 0; y < size; ++y)
+			{
+				for (int x = 0; x < size; ++x)
+				{
+					Chunk* chunk = new Chunk(ChunkPos(x, y));
+					generater.generate(*chunk, rand);
+					chunk->setBlockMeta(1, 2, 300, 5);
+					outChunks.push_back(chunk);
+				}
+			}
+		}
+
+		bool TestRegionFile(TArray< Chunk* > const& chunks)
+		{
+			CleanupSaveDir();
+
+			bool bPass = true;
+			size_t rawSize = 0;
+			auto startTime = Clock::now();
+			{
+				RegionFileStore store(SaveDir);
+				//Saved many times to compact the region file
+				for (int n = 0; n < 16; ++n)
+				{
+					for (Chunk* chunk : chunks)
+					{
+						TArray< uint8 > data;
+						chunk->serialize(data);
+						rawSize += data.size();
+						store.saveAsync(chunk->getPos(), std::move(data));
+					}
+				}
+
+				//The pending data is loaded before it's written
+				TArray< uint8 > data;
+				Chunk loadedChunk(chunks[0]->getPos());
+				bPass &= store.load(chunks[0]->getPos(), data) && loadedChunk.unserialize(data.data(), data.size()) && IsSameBlocks(*chunks[0], loadedChunk);
+				store.waitSaveComplete();
+				bPass &= store.getPendingSaveCount() == 0;
+			}
+			double saveTime = GetElapsedMS(startTime);
+
+			double loadTime;
+			{
+				RegionFileStore store(SaveDir);
+				TArray< TArray< uint8 > > datas;
+				datas.resize(chunks.size());
+				startTime = Clock::now();
+				for (int i = 0; i < (int)chunks.size(); ++i)
+				{
+					bPass &= store.load(chunks[i]->getPos(), datas[i]);
+				}
+				loadTime = GetElapsedMS(startTime);
+
+				for (int i = 0; i < (int)chunks.size(); ++i)
+				{
+					Chunk loadedChunk(chunks[i]->getPos());
+					if (!loadedChunk.unserialize(datas[i].data(), datas[i].size()) || !IsSameBlocks(*chunks[i], loadedChunk))
+					{
+						LogMsg("Chunk (%d,%d) load fail", chunks[i]->getPos().x, chunks[i]->getPos().y);
+						bPass = false;
+					}
+				}
+
+				TArray< uint8 > data;
+				bPass &= !store.load(ChunkPos(-100, 7), data);
+			}
+
+			uint64 fileSize = 0;
+			FFileSystem::GetFileSize(InlineString< 256 >::Make("%s/r.0.0.region", SaveDir), fileSize);
+			LogMsg("Region File : %s , save %d chunks x16 %.2f ms , load %.2f ms , file %.1f KB ( raw chunk data %.1f KB )", bPass ? "Pass" : "Fail",
+				(int)chunks.size(), saveTime, loadTime, fileSize / 1024.0, rawSize / 16 / 1024.0);
+			return bPass;
+		}
+
+		bool TestStorageMemory()
+		{
+			TArray< Chunk* > chunks;
+			auto startTime = Clock::now();
+			GenerateChunks(8, chunks);
+			double generateTime = GetElapsedMS(startTime);
+
+			size_t denseSize = 0;
+			size_t generatedSize = 0;
+			size_t compactSize = 0;
+			int numLayer = 0;
+			int numUniformLayer = 0;
+			bool bPass = true;
+			for (Chunk* chunk : chunks)
+			{
+				Chunk copyChunk(chunk->getPos());
+				TArray< uint8 > data;
+				chunk->serialize(data);
+				bPass &= copyChunk.unserialize(data.data(), data.size());
+
+				for (Chunk::LayerData* layer : chunk->mLayer)
+				{
+					if (layer)
+						denseSize += DenseLayerSize;
+				}
+				denseSize += sizeof(Chunk);
+
+				generatedSize += chunk->getAllocatedSize();
+				chunk->compact();
+				compactSize += chunk->getAllocatedSize();
+				bPass &= IsSameBlocks(*chunk, copyChunk);
+
+				for (Chunk::LayerData* layer : chunk->mLayer)
+				{
+					if (layer == nullptr)
+						continue;
+					++numLayer;
+					if (layer->blocks.isUniform())
+						++numUniformLayer;
+				}
+			}
+
+			LogMsg("Chunk Storage : %s , generate %d chunks %.2f ms , %d layers ( %d uniform )", bPass ? "Pass" : "Fail",
+				(int)chunks.size(), generateTime, numLayer, numUniformLayer);
+			LogMsg("Memory per chunk : dense %.1f KB , palette %.1f KB , compact %.1f KB",
+				denseSize / 1024.0 / chunks.size(), generatedSize / 1024.0 / chunks.size(), compactSize / 1024.0 / chunks.size());
+
+			bPass &= TestRegionFile(chunks);
+			for (Chunk* chunk : chunks)
+			{
+				delete chunk;
+			}
+			return bPass;
+		}
+
+		void RequestChunks(World& world, int centerX, int dist)
+		{
+			for (int dy = -dist; dy <= dist; ++dy)
+			{
+				for (int dx = -dist; dx <= dist; ++dx)
+				{
+					world.getChunk(ChunkPos(centerX + dx, dy), true);
+				}
+			}
+			world.mChunkProvider->mGeneratePool->waitAllWorkComplete();
+			world.update(0);
+		}
+
+		bool TestProvider()
+		{
+			CleanupSaveDir();
+
+			int const ViewDist = 4;
+			int const WalkDist = 40;
+			bool bPass = true;
+			int maxLoaded = 0;
+			int maxLoadedLimit;
+			double walkTime;
+			size_t loadedSize = 0;
+			{
+				World world;
+				ChunkProvider& provider = *world.mChunkProvider;
+				provider.setSaveDir(SaveDir);
+				provider.setViewDistance(ViewDist);
+				//A step loads a new column of chunks
+				maxLoadedLimit = provider.mMaxLoadedChunks + 2 * ViewDist + 1;
+
+				RequestChunks(world, 0, ViewDist);
+				world.setBlock(3, 5, 1000, BLOCK_DIRT);
+				bPass &= world.getBlockId(3, 5, 1000) == BLOCK_DIRT;
+
+				auto startTime = Clock::now();
+				for (int step = 0; step <= 2 * WalkDist; ++step)
+				{
+					int centerX = step <= WalkDist ? step : 2 * WalkDist - step;
+					RequestChunks(world, centerX, ViewDist);
+					maxLoaded = Math::Max(maxLoaded, provider.getLoadedChunkCount());
+					if (step == WalkDist)
+					{
+						bPass &= provider.mMap.find(ChunkPos(0, 0).hash_value()) == provider.mMap.end();
+					}
+				}
+				walkTime = GetElapsedMS(startTime);
+
+				bPass &= world.getBlockId(3, 5, 1000) == BLOCK_DIRT;
+				for (auto& pair : provider.mMap)
+				{
+					loadedSize += pair.second->getAllocatedSize();
+				}
+				loadedSize /= provider.mMap.size();
+			}
+
+			{
+				//The edit is saved when the world is destroyed
+				World world;
+				world.mChunkProvider->setSaveDir(SaveDir);
+				RequestChunks(world, 0, 1);
+				bPass &= world.getBlockId(3, 5, 1000) == BLOCK_DIRT;
+			}
+
+			bPass &= maxLoaded <= maxLoadedLimit;
+			LogMsg("Chunk Provider : %s , walk %d chunks %.2f ms , max loaded %d ( limit %d ) , %.1f KB per chunk", bPass ? "Pass" : "Fail",
+				2 * WalkDist, walkTime, maxLoaded, maxLoadedLimit, loadedSize / 1024.0);
+			CleanupSaveDir();
+			return bPass;
+		}
+	}
+
+	void RunChunkStorageTest()
+	{
+		bool bPass = TestBlockStorage();
+		bPass &= TestStorageMemory();
+		bPass &= TestProvider();
+		LogMsg("Chunk Storage Test : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Cube Chunk Storage Test", Cube::RunChunkStorageTest);
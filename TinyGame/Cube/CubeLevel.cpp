@@ -28,6 +28,7 @@ namespace Cube
 			delete mWorld;
 
 		mWorld = new World;
+		mWorld->mChunkProvider->setSaveDir("CubeWorld");
 	}
 
 	void Level::tick(float deltaTime)
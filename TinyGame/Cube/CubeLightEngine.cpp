@@ -0,0 +1,763 @@
+#include "CubePCH.h"
+#include "CubeLightEngine.h"
+
+#include "CubeBlock.h"
+#include "CubeBlockType.h"
+
+#include "ProfileSystem.h"
+#include "SystemPlatform.h"
+
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Cube
+{
+	namespace
+	{
+		struct LightBlockTable
+		{
+			uint8 emitLevels[256];
+			bool  bOpaque[256];
+
+			void setup()
+			{
+				for (int id = 0; id < 256; ++id)
+				{
+					Block* block = id == BLOCK_NULL ? nullptr : Block::Get(BlockId(id));
+					emitLevels[id] = block ? uint8(Math::Min<int>(block->getLightValue(), MaxLightLevel)) : 0;
+					//Liquid blocks don't stop the light
+					bOpaque[id] = id != BLOCK_NULL && (block == nullptr || (block->isSolid() && block->isFullCube()));
+				}
+			}
+		};
+
+		// Light access of the chunks a BFS can reach , the positions out of the chunks are skipped.
+		// The write lock of a chunk is taken at the first access and kept until unlockChunks.
+		class LightContext
+		{
+		public:
+			LightContext(LightBlockTable const& table, bool bBatch)
+				:mTable(table)
+				,mbBatch(bBatch)
+			{
+			}
+
+			~LightContext()
+			{
+				unlockChunks();
+			}
+
+			void addChunk(Chunk* chunk)
+			{
+				ChunkSlot& slot = mSlots.emplace(chunk->getPos().hash_value(), ChunkSlot()).first->second;
+				slot.chunk = chunk;
+				//Link the loaded neighbors , the BFS crosses the chunk borders without the map lookup
+				for (int dir = 0; dir < 4; ++dir)
+				{
+					Vec3i offset = GetFaceOffset(FaceSide(dir));
+					auto iter = mSlots.find(ChunkPos(chunk->getPos().x + offset.x, chunk->getPos().y + offset.y).hash_value());
+					if (iter == mSlots.end())
+						continue;
+					slot.neighbors[dir] = &iter->second;
+					iter->second.neighbors[dir ^ 1] = &slot;
+				}
+			}
+
+			void unlockChunks()
+			{
+				for (ChunkSlot* slot : mLockedSlots)
+				{
+					slot->chunk->mBlockLock.writeUnlock();
+					slot->bLocked = false;
+				}
+				mLockedSlots.clear();
+			}
+
+			void pushNode(int x, int y, int z)
+			{
+				ChunkSlot* slot = findSlot(x, y);
+				if (slot)
+					pushNode(slot, x, y, z);
+			}
+
+			void spreadLight(ELightType type);
+			void removeLight(ELightType type);
+
+			void updateBlock(Vec3i const& pos);
+			//Spread the light through the faces of the chunk and the loaded neighbor chunks
+			void stitchChunk(Chunk* chunk);
+
+			void getModifiedLayers(TArray< std::pair< ChunkPos, uint32 > >& outLayers);
+
+			int  mNumVisitedNode = 0;
+
+		private:
+			struct ChunkSlot
+			{
+				Chunk*     chunk = nullptr;
+				ChunkSlot* neighbors[4] = {};
+				bool       bLocked = false;
+				uint32     modifiedLayerMask = 0;
+				//The faces of the neighbor chunk blocks at the border use the light
+				uint32     neighborLayerMasks[4] = {};
+			};
+
+			struct LightNode
+			{
+				ChunkSlot* slot;
+				int   x, y, z;
+				uint8 level;
+			};
+
+			ChunkSlot* findSlot(int x, int y)
+			{
+				auto iter = mSlots.find(ChunkPos(x >> ChunkBitCount, y >> ChunkBitCount).hash_value());
+				if (iter == mSlots.end())
+					return nullptr;
+				lockSlot(&iter->second);
+				return &iter->second;
+			}
+
+			void lockSlot(ChunkSlot* slot)
+			{
+				if (mbBatch && !slot->bLocked)
+				{
+					slot->chunk->mBlockLock.writeLock();
+					slot->bLocked = true;
+					mLockedSlots.push_back(slot);
+				}
+			}
+
+			//The slot of the block at a face of the block (x,y) in the slot
+			FORCEINLINE ChunkSlot* getFaceSlot(ChunkSlot* slot, int face, int x, int y, int nx, int ny)
+			{
+				if (face >= FACE_Z || (((nx ^ x) | (ny ^ y)) & ~ChunkMask) == 0)
+					return slot;
+
+				ChunkSlot* result = slot->neighbors[face];
+				if (result)
+					lockSlot(result);
+				return result;
+			}
+
+			void pushNode(ChunkSlot* slot, int x, int y, int z, uint8 level = 0)
+			{
+				mAddQueue.push_back({ slot, x , y , z , level });
+			}
+
+			void setLight(ChunkSlot* slot, ELightType type, int x, int y, int z, uint8 level)
+			{
+				Chunk::LayerData* layer = slot->chunk->getLayer(z);
+				if (layer)
+					layer->getLight(type).set(Chunk::BlockStorage::GetIndex(x & ChunkMask, y & ChunkMask, z & Chunk::LayerMask), level);
+				else
+					slot->chunk->setLight(type, x, y, z, level);
+				if (mbBatch)
+				{
+					markModified(slot, x, y, z);
+				}
+			}
+
+			void markModified(ChunkSlot* slot, int x, int y, int z)
+			{
+				int layerIndex = z >> Chunk::LayerBitCount;
+				int localZ = z & Chunk::LayerMask;
+				uint32 layerBit = uint32(1) << layerIndex;
+				uint32 layerMask = layerBit;
+				if (localZ == 0 && layerIndex > 0)
+					layerMask |= layerBit >> 1;
+				if (localZ == Chunk::LayerMask && layerIndex + 1 < Chunk::NumLayer)
+					layerMask |= layerBit << 1;
+				slot->modifiedLayerMask |= layerMask;
+
+				int localX = x & ChunkMask;
+				int localY = y & ChunkMask;
+				if (localX == ChunkMask)
+					slot->neighborLayerMasks[FACE_X] |= layerBit;
+				else if (localX == 0)
+					slot->neighborLayerMasks[FACE_NX] |= layerBit;
+				if (localY == ChunkMask)
+					slot->neighborLayerMasks[FACE_Y] |= layerBit;
+				else if (localY == 0)
+					slot->neighborLayerMasks[FACE_NY] |= layerBit;
+			}
+
+			//Inline access of the layer storages , the z is in the height
+			FORCEINLINE uint8 getLight(ChunkSlot* slot, ELightType type, int x, int y, int z)
+			{
+				Chunk::LayerData* layer = slot->chunk->getLayer(z);
+				if (layer == nullptr)
+					return type == ELightType::Sky ? MaxLightLevel : 0;
+				return layer->getLight(type).get(Chunk::BlockStorage::GetIndex(x & ChunkMask, y & ChunkMask, z & Chunk::LayerMask));
+			}
+			FORCEINLINE bool  isOpaque(ChunkSlot* slot, int x, int y, int z)
+			{
+				Chunk::LayerData* layer = slot->chunk->getLayer(z);
+				if (layer == nullptr)
+					return false;
+				return mTable.bOpaque[layer->blocks.get(Chunk::BlockStorage::GetIndex(x & ChunkMask, y & ChunkMask, z & Chunk::LayerMask))];
+			}
+
+			LightBlockTable const& mTable;
+			bool mbBatch;
+			std::unordered_map< uint64, ChunkSlot > mSlots;
+			TArray< ChunkSlot* > mLockedSlots;
+
+			TArray< LightNode > mAddQueue;
+			TArray< LightNode > mRemoveQueue;
+		};
+
+		FORCEINLINE bool IsSkyColumnFace(ELightType type, int face, uint8 level)
+		{
+			//The full sky light goes down without decay
+			return type == ELightType::Sky && face == FACE_NZ && level == MaxLightLevel;
+		}
+
+		void LightContext::spreadLight(ELightType type)
+		{
+			for (int index = 0; index < (int)mAddQueue.size(); ++index)
+			{
+				LightNode node = mAddQueue[index];
+				uint8 level = getLight(node.slot, type, node.x, node.y, node.z);
+				if (level <= 1)
+					continue;
+
+				for (int face = 0; face < FaceSide::COUNT; ++face)
+				{
+					Vec3i offset = GetFaceOffset(FaceSide(face));
+					int nx = node.x + offset.x;
+					int ny = node.y + offset.y;
+					int nz = node.z + offset.z;
+					if (nz < 0 || nz >= ChunkBlockMaxHeight)
+						continue;
+
+					ChunkSlot* neighborSlot = getFaceSlot(node.slot, face, node.x, node.y, nx, ny);
+					if (neighborSlot == nullptr)
+						continue;
+
+					//The light is cheaper to read than the block id
+					uint8 neighborLevel = IsSkyColumnFace(type, face, level) ? level : level - 1;
+					if (getLight(neighborSlot, type, nx, ny, nz) >= neighborLevel || isOpaque(neighborSlot, nx, ny, nz))
+						continue;
+
+					setLight(neighborSlot, type, nx, ny, nz, neighborLevel);
+					mAddQueue.push_back({ neighborSlot, nx , ny , nz , neighborLevel });
+				}
+			}
+
+			mNumVisitedNode += (int)mAddQueue.size();
+			mAddQueue.clear();
+		}
+
+		void LightContext::removeLight(ELightType type)
+		{
+			for (int index = 0; index < (int)mRemoveQueue.size(); ++index)
+			{
+				LightNode node = mRemoveQueue[index];
+				for (int face = 0; face < FaceSide::COUNT; ++face)
+				{
+					Vec3i offset = GetFaceOffset(FaceSide(face));
+					int nx = node.x + offset.x;
+					int ny = node.y + offset.y;
+					int nz = node.z + offset.z;
+					if (nz < 0 || nz >= ChunkBlockMaxHeight)
+						continue;
+
+					ChunkSlot* neighborSlot = getFaceSlot(node.slot, face, node.x, node.y, nx, ny);
+					if (neighborSlot == nullptr)
+						continue;
+
+					uint8 neighborLevel = getLight(neighborSlot, type, nx, ny, nz);
+					if (neighborLevel == 0)
+						continue;
+
+					if (neighborLevel < node.level || IsSkyColumnFace(type, face, node.level))
+					{
+						//The light came from the removed node
+						setLight(neighborSlot, type, nx, ny, nz, 0);
+						mRemoveQueue.push_back({ neighborSlot, nx , ny , nz , neighborLevel });
+						if (type == ELightType::Block)
+						{
+							uint8 emitLevel = mTable.emitLevels[neighborSlot->chunk->getBlockId(nx, ny, nz)];
+							if (emitLevel)
+							{
+								setLight(neighborSlot, type, nx, ny, nz, emitLevel);
+								pushNode(neighborSlot, nx, ny, nz);
+							}
+						}
+					}
+					else
+					{
+						//A light of another source , it spreads again into the removed nodes
+						pushNode(neighborSlot, nx, ny, nz);
+					}
+				}
+			}
+
+			mNumVisitedNode += (int)mRemoveQueue.size();
+			mRemoveQueue.clear();
+		}
+
+		void LightContext::updateBlock(Vec3i const& pos)
+		{
+			if (pos.z < 0 || pos.z >= ChunkBlockMaxHeight)
+				return;
+
+			ChunkSlot* slot = findSlot(pos.x, pos.y);
+			if (slot == nullptr)
+				return;
+
+			BlockId id = slot->chunk->getBlockId(pos.x, pos.y, pos.z);
+			bool const bOpaque = mTable.bOpaque[id];
+			for (int i = 0; i < (int)ELightType::Count; ++i)
+			{
+				ELightType type = ELightType(i);
+				uint8 sourceLevel;
+				bool  bRemove;
+				uint8 level = getLight(slot, type, pos.x, pos.y, pos.z);
+				if (type == ELightType::Sky)
+				{
+					sourceLevel = (!bOpaque && pos.z == ChunkBlockMaxHeight - 1) ? MaxLightLevel : 0;
+					//A transparent block keeps the sky light of the neighbors
+					bRemove = bOpaque;
+				}
+				else
+				{
+					sourceLevel = mTable.emitLevels[id];
+					//The level may be from the emitter replaced by the block
+					bRemove = bOpaque || level > sourceLevel;
+				}
+
+				if (bRemove && level)
+				{
+					setLight(slot, type, pos.x, pos.y, pos.z, 0);
+					mRemoveQueue.push_back({ slot, pos.x , pos.y , pos.z , level });
+					removeLight(type);
+					level = 0;
+				}
+
+				if (sourceLevel > level)
+				{
+					setLight(slot, type, pos.x, pos.y, pos.z, sourceLevel);
+					pushNode(slot, pos.x, pos.y, pos.z);
+				}
+				if (!bOpaque)
+				{
+					for (int face = 0; face < FaceSide::COUNT; ++face)
+					{
+						Vec3i neighborPos = pos + GetFaceOffset(FaceSide(face));
+						if (neighborPos.z < 0 || neighborPos.z >= ChunkBlockMaxHeight)
+							continue;
+						ChunkSlot* neighborSlot = getFaceSlot(slot, face, pos.x, pos.y, neighborPos.x, neighborPos.y);
+						if (neighborSlot)
+							pushNode(neighborSlot, neighborPos.x, neighborPos.y, neighborPos.z);
+					}
+				}
+				spreadLight(type);
+			}
+		}
+
+		void LightContext::stitchChunk(Chunk* chunk)
+		{
+			Vec2i const chunkOffset = ChunkSize * chunk->getPos();
+			ChunkSlot* slot = findSlot(chunkOffset.x, chunkOffset.y);
+			if (slot == nullptr)
+				return;
+
+			for (int dir = 0; dir < 4; ++dir)
+			{
+				Vec3i offset = GetFaceOffset(FaceSide(dir));
+				ChunkSlot* neighborSlot = slot->neighbors[dir];
+				if (neighborSlot == nullptr)
+					continue;
+				lockSlot(neighborSlot);
+				Chunk* neighbor = neighborSlot->chunk;
+
+				//The border block of the chunk and the block of the neighbor chunk face to face
+				int const edge = (offset.x + offset.y > 0) ? ChunkMask : 0;
+				for (int i = 0; i < (int)ELightType::Count; ++i)
+				{
+					ELightType type = ELightType(i);
+					for (int indexLayer = 0; indexLayer < Chunk::NumLayer; ++indexLayer)
+					{
+						//The layers without data have the same light
+						if (chunk->mLayer[indexLayer] == nullptr && neighbor->mLayer[indexLayer] == nullptr)
+							continue;
+
+						for (int t = 0; t < ChunkSize; ++t)
+						{
+							int x = chunkOffset.x + (offset.x ? edge : t);
+							int y = chunkOffset.y + (offset.y ? edge : t);
+							int nx = x + offset.x;
+							int ny = y + offset.y;
+							for (int z = indexLayer * Chunk::LayerSize; z < (indexLayer + 1) * Chunk::LayerSize; ++z)
+							{
+								uint8 level = chunk->getLight(type, x, y, z);
+								uint8 neighborLevel = neighbor->getLight(type, nx, ny, z);
+								if (neighborLevel > level + 1 && !mTable.bOpaque[chunk->getBlockId(x, y, z)])
+								{
+									pushNode(neighborSlot, nx, ny, z);
+								}
+								else if (level > neighborLevel + 1 && !mTable.bOpaque[neighbor->getBlockId(nx, ny, z)])
+								{
+									pushNode(slot, x, y, z);
+								}
+							}
+						}
+					}
+					spreadLight(type);
+				}
+			}
+		}
+
+		void LightContext::getModifiedLayers(TArray< std::pair< ChunkPos, uint32 > >& outLayers)
+		{
+			std::unordered_map< uint64, std::pair< ChunkPos, uint32 > > layerMap;
+			for (auto& pair : mSlots)
+			{
+				ChunkSlot const& slot = pair.second;
+				ChunkPos const& pos = slot.chunk->getPos();
+				if (slot.modifiedLayerMask)
+				{
+					auto& entry = layerMap.emplace(pos.hash_value(), std::make_pair(pos, 0u)).first->second;
+					entry.second |= slot.modifiedLayerMask;
+				}
+				for (int dir = 0; dir < 4; ++dir)
+				{
+					if (slot.neighborLayerMasks[dir] == 0)
+						continue;
+
+					Vec3i offset = GetFaceOffset(FaceSide(dir));
+					ChunkPos neighborPos = ChunkPos(pos.x + offset.x, pos.y + offset.y);
+					auto& entry = layerMap.emplace(neighborPos.hash_value(), std::make_pair(neighborPos, 0u)).first->second;
+					entry.second |= slot.neighborLayerMasks[dir];
+				}
+			}
+
+			for (auto const& pair : layerMap)
+			{
+				outLayers.push_back(pair.second);
+			}
+		}
+	}
+
+	struct LightEngine::Batch
+	{
+		LightBlockTable  table;
+		TArray< Vec3i >  blocks;
+		TArray< Chunk* > addedChunks;
+		//The chunks the light can reach , they can't be unloaded until the batch is finished
+		TArray< Chunk* > usedChunks;
+		TArray< std::pair< ChunkPos, uint32 > > modifiedLayers;
+		BatchStats stats;
+	};
+
+	class LightEngine::BatchWork : public IQueuedWork
+	{
+	public:
+		virtual void executeWork()
+		{
+			PROFILE_ENTRY("Light Update");
+
+			using Clock = std::chrono::high_resolution_clock;
+			auto startTime = Clock::now();
+			{
+				LightContext context(batch->table, true);
+				for (Chunk* chunk : batch->usedChunks)
+				{
+					context.addChunk(chunk);
+				}
+				//Release the locks after an update , the mesh workers and the game thread don't wait the whole batch
+				for (Chunk* chunk : batch->addedChunks)
+				{
+					context.stitchChunk(chunk);
+					context.unlockChunks();
+				}
+				for (Vec3i const& pos : batch->blocks)
+				{
+					context.updateBlock(pos);
+					context.unlockChunks();
+				}
+
+				context.getModifiedLayers(batch->modifiedLayers);
+				batch->stats.numVisitedNode = context.mNumVisitedNode;
+			}
+			batch->stats.executeTimeMS = std::chrono::duration< double, std::milli >(Clock::now() - startTime).count();
+			engine->mbBatchRunning = false;
+		}
+
+		virtual void abandon()
+		{
+			engine->mbBatchRunning = false;
+		}
+
+		//Owned by the engine
+		virtual void release() {}
+
+		LightEngine* engine;
+		Batch*       batch;
+	};
+
+	LightEngine::LightEngine(World& world)
+		:mWorld(world)
+		,mbBatchRunning(false)
+	{
+		mBatch = new Batch;
+		mWork = new BatchWork;
+		mWork->engine = this;
+		mWork->batch = mBatch;
+	}
+
+	LightEngine::~LightEngine()
+	{
+		//The world deletes the generate pool before , the batch isn't running
+		CHECK(!mbBatchRunning);
+		delete mWork;
+		delete mBatch;
+	}
+
+	void LightEngine::InitChunkLight(Chunk& chunk)
+	{
+		PROFILE_ENTRY("Init Chunk Light");
+
+		LightBlockTable table;
+		table.setup();
+		LightContext context(table, false);
+		context.addChunk(&chunk);
+
+		//The blocks below the top opaque block of the column are dark until the sky light spreads
+		int heights[ChunkSize][ChunkSize];
+		int minHeight = ChunkBlockMaxHeight;
+		int maxHeight = 0;
+		for (int x = 0; x < ChunkSize; ++x)
+		{
+			for (int y = 0; y < ChunkSize; ++y)
+			{
+				int height = 0;
+				for (int indexLayer = Chunk::NumLayer - 1; indexLayer >= 0 && height == 0; --indexLayer)
+				{
+					Chunk::LayerData* layer = chunk.mLayer[indexLayer];
+					if (layer == nullptr)
+						continue;
+
+					if (layer->blocks.isUniform())
+					{
+						if (table.bOpaque[layer->blocks.getUniformId()])
+							height = (indexLayer + 1) * Chunk::LayerSize;
+						continue;
+					}
+
+					BlockId ids[Chunk::LayerSize];
+					layer->blocks.getColumn(x, y, ids);
+					for (int z = Chunk::LayerSize - 1; z >= 0; --z)
+					{
+						if (table.bOpaque[ids[z]])
+						{
+							height = indexLayer * Chunk::LayerSize + z + 1;
+							break;
+						}
+					}
+				}
+
+				heights[x][y] = height;
+				minHeight = Math::Min(minHeight, height);
+				maxHeight = Math::Max(maxHeight, height);
+			}
+		}
+
+		for (int indexLayer = 0; indexLayer < Chunk::NumLayer; ++indexLayer)
+		{
+			int const layerZ = indexLayer * Chunk::LayerSize;
+			Chunk::LayerData* layer = (layerZ < maxHeight) ? chunk.getOrCreateLayer(indexLayer) : chunk.mLayer[indexLayer].load(std::memory_order_acquire);
+			if (layer == nullptr)
+				continue;
+
+			layer->getLight(ELightType::Block).fill(0);
+			Chunk::LightStorage& skyLight = layer->getLight(ELightType::Sky);
+			if (layerZ + (int)Chunk::LayerSize <= minHeight)
+			{
+				skyLight.fill(0);
+				continue;
+			}
+
+			skyLight.fill(MaxLightLevel);
+			for (int x = 0; x < ChunkSize; ++x)
+			{
+				for (int y = 0; y < ChunkSize; ++y)
+				{
+					int numDark = Math::Clamp(heights[x][y] - layerZ, 0, (int)Chunk::LayerSize);
+					for (int z = 0; z < numDark; ++z)
+					{
+						skyLight.set(Chunk::BlockStorage::GetIndex(x, y, z), 0);
+					}
+				}
+			}
+		}
+
+		//The sky light spreads from the lit blocks beside the dark blocks of the neighbor columns
+		Vec2i const chunkOffset = ChunkSize * chunk.getPos();
+		for (int x = 0; x < ChunkSize; ++x)
+		{
+			for (int y = 0; y < ChunkSize; ++y)
+			{
+				int neighborHeight = heights[x][y];
+				for (int dir = 0; dir < 4; ++dir)
+				{
+					Vec3i offset = GetFaceOffset(FaceSide(dir));
+					int nx = x + offset.x;
+					int ny = y + offset.y;
+					if (0 <= nx && nx < ChunkSize && 0 <= ny && ny < ChunkSize)
+						neighborHeight = Math::Max(neighborHeight, heights[nx][ny]);
+				}
+				for (int z = heights[x][y]; z < neighborHeight; ++z)
+				{
+					context.pushNode(chunkOffset.x + x, chunkOffset.y + y, z);
+				}
+			}
+		}
+		context.spreadLight(ELightType::Sky);
+
+		for (int indexLayer = 0; indexLayer < Chunk::NumLayer; ++indexLayer)
+		{
+			Chunk::LayerData* layer = chunk.mLayer[indexLayer];
+			if (layer == nullptr)
+				continue;
+
+			auto const& palette = layer->blocks.getPalette();
+			if (std::none_of(palette.begin(), palette.end(), [&table](BlockId id) { return table.emitLevels[id] != 0; }))
+				continue;
+
+			for (int index = 0; index < Chunk::BlockStorage::NumBlock; ++index)
+			{
+				uint8 emitLevel = table.emitLevels[layer->blocks.get(index)];
+				if (emitLevel == 0)
+					continue;
+
+				//Inverse of BlockStorage::GetIndex
+				int x = chunkOffset.x + (index >> (ChunkBitCount + Chunk::LayerBitCount));
+				int y = chunkOffset.y + ((index >> Chunk::LayerBitCount) & ChunkMask);
+				int z = indexLayer * Chunk::LayerSize + (index & Chunk::LayerMask);
+				chunk.setLight(ELightType::Block, x, y, z, emitLevel);
+				context.pushNode(x, y, z);
+			}
+		}
+		context.spreadLight(ELightType::Block);
+	}
+
+	void LightEngine::notifyBlockModified(int bx, int by, int bz)
+	{
+		mPendingBlocks.push_back(Vec3i(bx, by, bz));
+	}
+
+	void LightEngine::notifyChunkAdded(Chunk* chunk)
+	{
+		mPendingChunks.push_back(chunk);
+	}
+
+	void LightEngine::notifyChunkRemoved(Chunk* chunk)
+	{
+		mPendingChunks.remove(chunk);
+	}
+
+	void LightEngine::update()
+	{
+		if (mbBatchRunning)
+			return;
+
+		finishBatch();
+		if (mPendingBlocks.empty() && mPendingChunks.empty())
+			return;
+
+		startBatch();
+	}
+
+	void LightEngine::flush()
+	{
+		for (;;)
+		{
+			while (mbBatchRunning)
+			{
+				SystemPlatform::Sleep(0);
+			}
+			update();
+			//The started batch may be completed already , the result is finished by the next update
+			if (!mbHaveBatchResult)
+				break;
+		}
+	}
+
+	void LightEngine::startBatch()
+	{
+		Batch& batch = *mBatch;
+		batch.table.setup();
+		batch.blocks = std::move(mPendingBlocks);
+		mPendingBlocks.clear();
+		batch.addedChunks = std::move(mPendingChunks);
+		mPendingChunks.clear();
+		batch.usedChunks.clear();
+		batch.modifiedLayers.clear();
+		batch.stats = BatchStats();
+		batch.stats.numBlockUpdate = (int)batch.blocks.size();
+		batch.stats.numChunkUpdate = (int)batch.addedChunks.size();
+
+		//The light of a block reaches the neighbor chunks at most
+		std::unordered_set< uint64 > usedChunkSet;
+		auto AddUsedChunks = [&](ChunkPos const& center)
+		{
+			for (int dy = -1; dy <= 1; ++dy)
+			{
+				for (int dx = -1; dx <= 1; ++dx)
+				{
+					ChunkPos pos = ChunkPos(center.x + dx, center.y + dy);
+					if (!usedChunkSet.insert(pos.hash_value()).second)
+						continue;
+
+					Chunk* chunk = mWorld.mChunkProvider->getChunk(pos);
+					if (chunk == nullptr)
+						continue;
+
+					++chunk->asyncUseCount;
+					batch.usedChunks.push_back(chunk);
+				}
+			}
+		};
+
+		for (Chunk* chunk : batch.addedChunks)
+		{
+			AddUsedChunks(chunk->getPos());
+		}
+		for (Vec3i const& pos : batch.blocks)
+		{
+			ChunkPos chunkPos;
+			chunkPos.setBlockPos(pos.x, pos.y);
+			AddUsedChunks(chunkPos);
+		}
+
+		mbHaveBatchResult = true;
+		mbBatchRunning = true;
+		mWorld.mChunkProvider->mGeneratePool->addWork(mWork);
+	}
+
+	void LightEngine::finishBatch()
+	{
+		if (!mbHaveBatchResult)
+			return;
+
+		mbHaveBatchResult = false;
+		for (Chunk* chunk : mBatch->usedChunks)
+		{
+			--chunk->asyncUseCount;
+		}
+		mBatch->usedChunks.clear();
+
+		mBatch->stats.numModifiedLayer = 0;
+		for (auto const& pair : mBatch->modifiedLayers)
+		{
+			mBatch->stats.numModifiedLayer += FBitUtility::CountSet(pair.second);
+			mWorld.notifyLightModified(pair.first, pair.second);
+		}
+		mLastBatchStats = mBatch->stats;
+	}
+
+}//namespace Cube
@@ -0,0 +1,64 @@
+#ifndef CubeLightEngine_h__
+#define CubeLightEngine_h__
+
+#include "CubeWorld.h"
+
+#include <atomic>
+
+namespace Cube
+{
+	// Sky and block light spread with BFS queues. A modified block removes the light it spread and the light of
+	// the neighbors spreads again , only the blocks the light can reach are visited.
+	// The updates of a tick are processed as a batch on the chunk generate pool , the layers of the modified light
+	// are notified to the world listeners.
+	class LightEngine
+	{
+	public:
+		LightEngine(World& world);
+		~LightEngine();
+
+		//Compute the light of a chunk not added to the world , the light of the neighbor chunks spreads when it's added
+		static void InitChunkLight(Chunk& chunk);
+
+		void notifyBlockModified(int bx, int by, int bz);
+		void notifyChunkAdded(Chunk* chunk);
+		void notifyChunkRemoved(Chunk* chunk);
+
+		//Called by the game thread each tick , finish the completed batch and start a batch of the pending updates
+		void update();
+		//Process all the pending updates before return
+		void flush();
+		bool isBatchRunning() const { return mbBatchRunning; }
+
+		struct BatchStats
+		{
+			int    numBlockUpdate = 0;
+			int    numChunkUpdate = 0;
+			int    numVisitedNode = 0;
+			int    numModifiedLayer = 0;
+			double executeTimeMS = 0;
+		};
+		BatchStats const& getLastBatchStats() const { return mLastBatchStats; }
+
+	private:
+		class BatchWork;
+		struct Batch;
+
+		void startBatch();
+		void finishBatch();
+
+		World& mWorld;
+		//Game thread only
+		TArray< Vec3i >  mPendingBlocks;
+		TArray< Chunk* > mPendingChunks;
+
+		Batch*     mBatch;
+		BatchWork* mWork;
+		bool       mbHaveBatchResult = false;
+		std::atomic< bool > mbBatchRunning;
+		BatchStats mLastBatchStats;
+	};
+
+}//namespace Cube
+
+#endif // CubeLightEngine_h__
@@ -0,0 +1,224 @@
+#include "CubePCH.h"
+#include "StageRegister.h"
+
+#include "CubeWorld.h"
+#include "CubeLightEngine.h"
+#include "CubeBlock.h"
+#include "CubeBlockType.h"
+#include "IWorldEventListener.h"
+
+#include "LogSystem.h"
+
+#include <chrono>
+
+// Build a sealed room across the chunk corner and place a torch in it , the block light must be the torch level
+// minus the distance and go back to zero after the torch is removed. A shaft to the sky lights the room by the
+// distance to the shaft. Compare the time of a torch update with the light rebuild of a chunk.
+namespace Cube
+{
+	namespace
+	{
+		using Clock = std::chrono::high_resolution_clock;
+
+		//The interior of the room , the walls are one block thick
+		Vec3i const RoomMin = Vec3i(6, 6, 100);
+		Vec3i const RoomMax = Vec3i(26, 26, 118);
+		Vec3i const TorchPos = Vec3i(16, 16, 109);
+		Vec3i const ShaftPos = Vec3i(20, 11, RoomMax.z + 1);
+
+		double GetElapsedMS(Clock::time_point startTime)
+		{
+			return std::chrono::duration< double, std::milli >(Clock::now() - startTime).count();
+		}
+
+		class LightListener : public IWorldEventListener
+		{
+		public:
+			virtual void onModifyBlock(int bx, int by, int bz) {}
+			virtual void onModifyLight(ChunkPos const& pos, uint32 layerMask)
+			{
+				++numChunk;
+				numLayer += FBitUtility::CountSet(layerMask);
+			}
+
+			int numChunk = 0;
+			int numLayer = 0;
+		};
+
+		void LoadChunks(World& world, int dist)
+		{
+			for (int dy = -dist; dy <= dist; ++dy)
+			{
+				for (int dx = -dist; dx <= dist; ++dx)
+				{
+					world.getChunk(ChunkPos(dx, dy), true);
+				}
+			}
+			world.mChunkProvider->mGeneratePool->waitAllWorkComplete();
+			world.update(0);
+			world.mLightEngine->flush();
+		}
+
+		void BuildRoom(World& world)
+		{
+			for (int x = RoomMin.x - 1; x <= RoomMax.x + 1; ++x)
+			{
+				for (int y = RoomMin.y - 1; y <= RoomMax.y + 1; ++y)
+				{
+					for (int z = RoomMin.z - 1; z <= RoomMax.z + 1; ++z)
+					{
+						bool bWall = x < RoomMin.x || x > RoomMax.x || y < RoomMin.y || y > RoomMax.y || z < RoomMin.z || z > RoomMax.z;
+						world.setBlockNotify(x, y, z, bWall ? BLOCK_ROCK : BLOCK_NULL);
+					}
+				}
+			}
+		}
+
+		template< class TFunc >
+		int CountRoomLightError(World& world, ELightType type, TFunc&& GetExpectedLevel)
+		{
+			int result = 0;
+			for (int x = RoomMin.x; x <= RoomMax.x; ++x)
+			{
+				for (int y = RoomMin.y; y <= RoomMax.y; ++y)
+				{
+					for (int z = RoomMin.z; z <= RoomMax.z; ++z)
+					{
+						if (world.getLight(type, x, y, z) != GetExpectedLevel(Vec3i(x, y, z)))
+							++result;
+					}
+				}
+			}
+			return result;
+		}
+
+		int GetTorchLevel(Vec3i const& pos, bool bHaveTorch)
+		{
+			if (!bHaveTorch)
+				return 0;
+			Vec3i offset = pos - TorchPos;
+			int dist = Math::Abs(offset.x) + Math::Abs(offset.y) + Math::Abs(offset.z);
+			return Math::Max(0, Block::Get(BLOCK_TORCH)->getLightValue() - dist);
+		}
+
+		int GetSkyLevel(Vec3i const& pos, bool bShaftOpen)
+		{
+			//The torch stops the sky light
+			if (!bShaftOpen || pos == TorchPos)
+				return 0;
+			int dist = Math::Abs(pos.x - ShaftPos.x) + Math::Abs(pos.y - ShaftPos.y);
+			return Math::Max(0, MaxLightLevel - dist);
+		}
+
+		bool CheckRoomLight(World& world, char const* step, bool bHaveTorch, bool bShaftOpen)
+		{
+			int numBlockError = CountRoomLightError(world, ELightType::Block, [bHaveTorch](Vec3i const& pos) { return GetTorchLevel(pos, bHaveTorch); });
+			int numSkyError = CountRoomLightError(world, ELightType::Sky, [bShaftOpen](Vec3i const& pos) { return GetSkyLevel(pos, bShaftOpen); });
+			if (numBlockError || numSkyError)
+			{
+				LogMsg("%s : %d block light errors , %d sky light errors", step, numBlockError, numSkyError);
+				return false;
+			}
+			return true;
+		}
+
+		void SetShaftOpen(World& world, bool bOpen)
+		{
+			if (!bOpen)
+			{
+				world.setBlockNotify(ShaftPos.x, ShaftPos.y, ShaftPos.z, BLOCK_ROCK);
+				return;
+			}
+
+			for (int z = ShaftPos.z; z < 2 * Chunk::LayerSize * 8; ++z)
+			{
+				if (world.getBlockId(ShaftPos.x, ShaftPos.y, z) != BLOCK_NULL)
+					world.setBlockNotify(ShaftPos.x, ShaftPos.y, z, BLOCK_NULL);
+			}
+		}
+	}
+
+	void RunLightTest()
+	{
+		Block::InitList();
+
+		World world;
+		LightListener listener;
+		world.addListener(listener);
+		LightEngine& lightEngine = *world.mLightEngine;
+
+		auto startTime = Clock::now();
+		LoadChunks(world, 2);
+		double loadTime = GetElapsedMS(startTime);
+		int numLoadChunk = world.mChunkProvider->getLoadedChunkCount();
+
+		bool bPass = true;
+		BuildRoom(world);
+		lightEngine.flush();
+		bPass &= CheckRoomLight(world, "Build Room", false, false);
+
+		int const NumRepeat = 20;
+		double placeTime = 0;
+		double removeTime = 0;
+		double placeFlushTime = 0;
+		int numVisitedNode = 0;
+		int numModifiedChunk = 0;
+		int numModifiedLayer = 0;
+		for (int i = 0; i < NumRepeat; ++i)
+		{
+			listener.numChunk = 0;
+			listener.numLayer = 0;
+			world.setBlockNotify(TorchPos.x, TorchPos.y, TorchPos.z, BLOCK_TORCH);
+			startTime = Clock::now();
+			lightEngine.flush();
+			placeFlushTime += GetElapsedMS(startTime);
+			placeTime += lightEngine.getLastBatchStats().executeTimeMS;
+			numVisitedNode = lightEngine.getLastBatchStats().numVisitedNode;
+			numModifiedChunk = listener.numChunk;
+			numModifiedLayer = listener.numLayer;
+			if (i == 0)
+				bPass &= CheckRoomLight(world, "Place Torch", true, false);
+
+			world.setBlockNotify(TorchPos.x, TorchPos.y, TorchPos.z, BLOCK_NULL);
+			lightEngine.flush();
+			removeTime += lightEngine.getLastBatchStats().executeTimeMS;
+			if (i == 0)
+				bPass &= CheckRoomLight(world, "Remove Torch", false, false);
+		}
+		//The light of the torch only reaches the layer of the four chunks at the corner
+		bPass &= numModifiedChunk == 4 && numModifiedLayer == 4;
+
+		world.setBlockNotify(TorchPos.x, TorchPos.y, TorchPos.z, BLOCK_TORCH);
+		SetShaftOpen(world, true);
+		lightEngine.flush();
+		double openTime = lightEngine.getLastBatchStats().executeTimeMS;
+		bPass &= CheckRoomLight(world, "Open Shaft", true, true);
+
+		SetShaftOpen(world, false);
+		lightEngine.flush();
+		double closeTime = lightEngine.getLastBatchStats().executeTimeMS;
+		bPass &= CheckRoomLight(world, "Close Shaft", true, false);
+
+		//The light of a loaded chunk computed again
+		double rebuildTime;
+		{
+			Chunk* chunk = world.getChunk(ChunkPos(1, 1));
+			TArray< uint8 > data;
+			chunk->serialize(data);
+			Chunk copyChunk(chunk->getPos());
+			copyChunk.unserialize(data.data(), data.size());
+			startTime = Clock::now();
+			LightEngine::InitChunkLight(copyChunk);
+			rebuildTime = GetElapsedMS(startTime);
+		}
+		world.removeListener(listener);
+
+		LogMsg("Load %d chunks with light %.2f ms , chunk light rebuild %.3f ms", numLoadChunk, loadTime, rebuildTime);
+		LogMsg("Torch : place %.1f us ( %.1f us with the batch dispatch ) , remove %.1f us , %d nodes , %d chunks %d layers modified",
+			1000 * placeTime / NumRepeat, 1000 * placeFlushTime / NumRepeat, 1000 * removeTime / NumRepeat, numVisitedNode, numModifiedChunk, numModifiedLayer);
+		LogMsg("Sky Shaft : open %.1f us , close %.1f us", 1000 * openTime, 1000 * closeTime);
+		LogMsg("Light Test : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Cube Light Test", Cube::RunLightTest);
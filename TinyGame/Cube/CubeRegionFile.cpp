@@ -0,0 +1,510 @@
+#include "CubePCH.h"
+#include "CubeRegionFile.h"
+
+#include "LZCompress.h"
+#include "FileSystem.h"
+#include "InlineString.h"
+#include "LogSystem.h"
+#include "ProfileSystem.h"
+
+#include <algorithm>
+
+namespace Cube
+{
+	namespace
+	{
+		struct RegionFileHeader
+		{
+			static uint32 const Magic = 0x4e475243; // 'CRGN'
+			static uint32 const LastVersion = 1;
+
+			uint32 magic;
+			uint32 version;
+		};
+
+		struct RegionRecordHeader
+		{
+			static uint32 const Magic = 0x4b4e4843; // 'CHNK'
+
+			uint32 magic;
+			int32  x;
+			int32  y;
+			uint32 storedSize;
+			uint32 rawSize;
+			uint32 flags;
+		};
+
+		//Don't compact small files , the garbage of a few saves doesn't matter
+		uint64 const MinCompactGarbageSize = 1024 * 1024;
+	}
+
+	RegionFile::RegionFile()
+	{
+		FMemory::Zero(mEntries, sizeof(mEntries));
+		mFileSize = 0;
+		mLiveSize = 0;
+	}
+
+	RegionFile::~RegionFile()
+	{
+		close();
+	}
+
+	uint64 RegionFile::GetDataOffset()
+	{
+		return sizeof(RegionFileHeader) + sizeof(Entry) * NumChunk;
+	}
+
+	uint64 RegionFile::getGarbageSize() const
+	{
+		return mFileSize - mLiveSize - GetDataOffset();
+	}
+
+	bool RegionFile::open(char const* path)
+	{
+		mPath = path;
+		//The compact was interrupted between the renames , the backup is the live file
+		InlineString<512> backupPath;
+		backupPath.format("%s.bak", path);
+		if (!FFileSystem::IsExist(path) && FFileSystem::IsExist(backupPath.c_str()))
+		{
+			FFileSystem::RenameAndMoveFile(backupPath.c_str(), path);
+		}
+
+		if (!FFileSystem::IsExist(path) && !createFile())
+			return false;
+
+		mFile.open(path, std::ios::in | std::ios::out | std::ios::binary);
+		if (!mFile.is_open())
+			return false;
+
+		if (!loadTable())
+		{
+			LogWarning(0, "Cube : Region file %s is broken", path);
+			mFile.close();
+			return false;
+		}
+		return true;
+	}
+
+	void RegionFile::close()
+	{
+		if (mFile.is_open())
+		{
+			mFile.flush();
+			mFile.close();
+		}
+	}
+
+	bool RegionFile::createFile()
+	{
+		std::ofstream fs(mPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (!fs.is_open())
+			return false;
+
+		RegionFileHeader header;
+		header.magic = RegionFileHeader::Magic;
+		header.version = RegionFileHeader::LastVersion;
+		fs.write((char const*)&header, sizeof(header));
+		Entry entries[NumChunk];
+		FMemory::Zero(entries, sizeof(entries));
+		fs.write((char const*)entries, sizeof(entries));
+		return fs.good();
+	}
+
+	bool RegionFile::loadTable()
+	{
+		RegionFileHeader header;
+		mFile.seekg(0);
+		mFile.read((char*)&header, sizeof(header));
+		mFile.read((char*)mEntries, sizeof(mEntries));
+		if (!mFile.good() || header.magic != RegionFileHeader::Magic || header.version != RegionFileHeader::LastVersion)
+		{
+			mFile.clear();
+			return false;
+		}
+
+		mFileSize = 0;
+		FFileSystem::GetFileSize(mPath.c_str(), mFileSize);
+		mLiveSize = 0;
+		//A record may be lost if the table entry was written but the data wasn't
+		for (Entry& entry : mEntries)
+		{
+			if (entry.storedSize == 0)
+				continue;
+
+			uint64 recordSize = sizeof(RegionRecordHeader) + uint64(entry.storedSize);
+			if (entry.offset < GetDataOffset() || entry.offset + recordSize > mFileSize)
+			{
+				FMemory::Zero(&entry, sizeof(entry));
+				continue;
+			}
+			mLiveSize += recordSize;
+		}
+		return true;
+	}
+
+	bool RegionFile::writeEntry(int index)
+	{
+		mFile.clear();
+		mFile.seekp(sizeof(RegionFileHeader) + index * sizeof(Entry));
+		mFile.write((char const*)&mEntries[index], sizeof(Entry));
+		mFile.flush();
+		return mFile.good();
+	}
+
+	bool RegionFile::readRecord(ChunkPos const& pos, TArray< uint8 >& outStoredData, uint32& outRawSize, uint32& outFlags)
+	{
+		Entry const& entry = mEntries[GetChunkIndex(pos)];
+		if (entry.storedSize == 0 || !mFile.is_open())
+			return false;
+
+		RegionRecordHeader header;
+		mFile.clear();
+		mFile.seekg(entry.offset);
+		mFile.read((char*)&header, sizeof(header));
+		if (!mFile.good() || header.magic != RegionRecordHeader::Magic || header.x != pos.x || header.y != pos.y ||
+			header.storedSize != entry.storedSize || header.rawSize != entry.rawSize)
+		{
+			mFile.clear();
+			return false;
+		}
+
+		outStoredData.resize(header.storedSize);
+		mFile.read((char*)outStoredData.data(), header.storedSize);
+		if (!mFile.good())
+		{
+			mFile.clear();
+			return false;
+		}
+
+		outRawSize = header.rawSize;
+		outFlags = header.flags;
+		return true;
+	}
+
+	bool RegionFile::writeRecord(ChunkPos const& pos, uint8 const* storedData, uint32 storedSize, uint32 rawSize, uint32 flags)
+	{
+		if (!mFile.is_open() || storedSize == 0)
+			return false;
+
+		uint64 recordSize = sizeof(RegionRecordHeader) + uint64(storedSize);
+		if (mFileSize + recordSize > MaxUint32)
+		{
+			compact();
+			if (mFileSize + recordSize > MaxUint32)
+				return false;
+		}
+
+		RegionRecordHeader header;
+		header.magic = RegionRecordHeader::Magic;
+		header.x = pos.x;
+		header.y = pos.y;
+		header.storedSize = storedSize;
+		header.rawSize = rawSize;
+		header.flags = flags;
+
+		//Write the record before the entry , a crash only loses the new record
+		mFile.clear();
+		mFile.seekp(mFileSize);
+		mFile.write((char const*)&header, sizeof(header));
+		mFile.write((char const*)storedData, storedSize);
+		mFile.flush();
+		if (!mFile.good())
+		{
+			mFile.clear();
+			return false;
+		}
+
+		int index = GetChunkIndex(pos);
+		Entry& entry = mEntries[index];
+		if (entry.storedSize)
+		{
+			mLiveSize -= sizeof(RegionRecordHeader) + uint64(entry.storedSize);
+		}
+		entry.offset = uint32(mFileSize);
+		entry.storedSize = storedSize;
+		entry.rawSize = rawSize;
+		entry.flags = flags;
+		mFileSize += recordSize;
+		mLiveSize += recordSize;
+		if (!writeEntry(index))
+			return false;
+
+		uint64 garbageSize = getGarbageSize();
+		if (garbageSize > MinCompactGarbageSize && garbageSize > mLiveSize)
+		{
+			compact();
+		}
+		return true;
+	}
+
+	void RegionFile::compact()
+	{
+		PROFILE_ENTRY("Compact Region File");
+
+		InlineString<512> tempPath;
+		tempPath.format("%s.tmp", mPath.c_str());
+
+		int indices[NumChunk];
+		int numIndex = 0;
+		for (int i = 0; i < NumChunk; ++i)
+		{
+			if (mEntries[i].storedSize)
+				indices[numIndex++] = i;
+		}
+		std::sort(indices, indices + numIndex, [this](int lhs, int rhs)
+		{
+			return mEntries[lhs].offset < mEntries[rhs].offset;
+		});
+
+		Entry entries[NumChunk];
+		FMemory::Copy(entries, mEntries, sizeof(entries));
+		auto WriteTempFile = [&]() -> bool
+		{
+			std::ofstream fs(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+			if (!fs.is_open())
+				return false;
+
+			RegionFileHeader header;
+			header.magic = RegionFileHeader::Magic;
+			header.version = RegionFileHeader::LastVersion;
+			fs.write((char const*)&header, sizeof(header));
+			//The table is rewritten with the new offsets after the records are copied
+			fs.write((char const*)entries, sizeof(entries));
+
+			uint64 offset = GetDataOffset();
+			TArray< uint8 > recordData;
+			for (int i = 0; i < numIndex; ++i)
+			{
+				Entry& entry = entries[indices[i]];
+				recordData.resize(sizeof(RegionRecordHeader) + entry.storedSize);
+				mFile.clear();
+				mFile.seekg(entry.offset);
+				mFile.read((char*)recordData.data(), recordData.size());
+				if (!mFile.good())
+				{
+					mFile.clear();
+					return false;
+				}
+				fs.write((char const*)recordData.data(), recordData.size());
+				entry.offset = uint32(offset);
+				offset += recordData.size();
+			}
+			fs.seekp(sizeof(header));
+			fs.write((char const*)entries, sizeof(entries));
+			fs.flush();
+			return fs.good();
+		};
+
+		if (!WriteTempFile())
+		{
+			FFileSystem::DeleteFile(tempPath.c_str());
+			return;
+		}
+
+		//The live file is kept as a backup until the compacted file replaces it , open restores the backup after a crash
+		InlineString<512> backupPath;
+		backupPath.format("%s.bak", mPath.c_str());
+		mFile.close();
+		FFileSystem::DeleteFile(backupPath.c_str());
+		bool bReplaced = false;
+		if (FFileSystem::RenameAndMoveFile(mPath.c_str(), backupPath.c_str()))
+		{
+			bReplaced = FFileSystem::RenameAndMoveFile(tempPath.c_str(), mPath.c_str());
+			if (bReplaced)
+			{
+				FFileSystem::DeleteFile(backupPath.c_str());
+			}
+			else
+			{
+				FFileSystem::RenameAndMoveFile(backupPath.c_str(), mPath.c_str());
+			}
+		}
+		if (!bReplaced)
+		{
+			LogWarning(0, "Cube : Can't replace region file %s with the compacted file", mPath.c_str());
+			FFileSystem::DeleteFile(tempPath.c_str());
+		}
+
+		mFile.open(mPath.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		if (!mFile.is_open() || !loadTable())
+		{
+			LogWarning(0, "Cube : Can't open region file %s", mPath.c_str());
+			mFile.close();
+		}
+	}
+
+
+	RegionFileStore::RegionFileStore(char const* dir)
+		:mDir(dir)
+	{
+		FFileSystem::CreateDirectorySequence(dir);
+		mIOPool = new QueueThreadPool;
+		mIOPool->init(1);
+	}
+
+	RegionFileStore::~RegionFileStore()
+	{
+		waitSaveComplete();
+		delete mIOPool;
+		for (auto& pair : mRegionMap)
+		{
+			delete pair.second.file;
+		}
+	}
+
+	RegionFile* RegionFileStore::getRegion(ChunkPos const& pos)
+	{
+		ChunkPos regionPos = RegionFile::GetRegionPos(pos);
+		uint64 key = regionPos.hash_value();
+		auto iter = mRegionMap.find(key);
+		if (iter != mRegionMap.end())
+		{
+			iter->second.lastUse = ++mUseCounter;
+			return iter->second.file;
+		}
+
+		if (mRegionMap.size() >= MaxOpenRegionCount)
+		{
+			auto lruIter = std::min_element(mRegionMap.begin(), mRegionMap.end(), [](auto const& lhs, auto const& rhs)
+			{
+				return lhs.second.lastUse < rhs.second.lastUse;
+			});
+			delete lruIter->second.file;
+			mRegionMap.erase(lruIter);
+		}
+
+		InlineString<512> path;
+		path.format("%s/r.%d.%d.region", mDir.c_str(), regionPos.x, regionPos.y);
+		RegionFile* file = new RegionFile;
+		if (!file->open(path))
+		{
+			delete file;
+			return nullptr;
+		}
+
+		RegionSlot& slot = mRegionMap[key];
+		slot.file = file;
+		slot.lastUse = ++mUseCounter;
+		return file;
+	}
+
+	bool RegionFileStore::load(ChunkPos const& pos, TArray< uint8 >& outData)
+	{
+		TArray< uint8 > storedData;
+		uint32 rawSize;
+		uint32 flags;
+		{
+			Mutex::Locker locker(mMutex);
+			auto iter = mPendingSaves.find(pos.hash_value());
+			if (iter != mPendingSaves.end())
+			{
+				outData = iter->second.data;
+				return true;
+			}
+
+			RegionFile* region = getRegion(pos);
+			if (region == nullptr || !region->haveChunk(pos))
+				return false;
+			if (!region->readRecord(pos, storedData, rawSize, flags))
+				return false;
+		}
+
+		if (flags & RegionFile::RF_Compressed)
+		{
+			outData.resize(rawSize);
+			return FLZCompress::Decompress(storedData.data(), storedData.size(), outData.data(), rawSize);
+		}
+
+		outData = std::move(storedData);
+		return outData.size() == rawSize;
+	}
+
+	void RegionFileStore::saveAsync(ChunkPos const& pos, TArray< uint8 >&& data)
+	{
+		uint32 serial;
+		{
+			Mutex::Locker locker(mMutex);
+			PendingSave& save = mPendingSaves[pos.hash_value()];
+			save.data = std::move(data);
+			save.serial = serial = ++mSaveSerial;
+			save.numRetry = 0;
+		}
+
+		mIOPool->addFunctionWork([this, pos, serial]()
+		{
+			executeSave(pos, serial);
+		});
+	}
+
+	void RegionFileStore::executeSave(ChunkPos const& pos, uint32 serial)
+	{
+		PROFILE_ENTRY("Save Chunk");
+
+		uint64 key = pos.hash_value();
+		TArray< uint8 > rawData;
+		{
+			Mutex::Locker locker(mMutex);
+			auto iter = mPendingSaves.find(key);
+			//A newer save of the chunk writes the data
+			if (iter == mPendingSaves.end() || iter->second.serial != serial)
+				return;
+			rawData = iter->second.data;
+		}
+
+		uint32 rawSize = (uint32)rawData.size();
+		TArray< uint8 > storedData;
+		storedData.resize(FLZCompress::GetMaxCompressedSize(rawData.size()));
+		size_t storedSize = FLZCompress::Compress(rawData.data(), rawData.size(), storedData.data(), storedData.size());
+		uint32 flags = RegionFile::RF_Compressed;
+		if (storedSize == 0 || storedSize >= rawSize)
+		{
+			storedData = std::move(rawData);
+			storedSize = storedData.size();
+			flags = 0;
+		}
+
+		Mutex::Locker locker(mMutex);
+		RegionFile* region = getRegion(pos);
+		bool bSaved = region != nullptr && region->writeRecord(pos, storedData.data(), (uint32)storedSize, rawSize, flags);
+
+		auto iter = mPendingSaves.find(key);
+		if (iter == mPendingSaves.end() || iter->second.serial != serial)
+			return;
+
+		if (bSaved)
+		{
+			mPendingSaves.erase(iter);
+			return;
+		}
+
+		//The pending data is kept , the chunk loads it and the next save of the chunk writes it
+		PendingSave& save = iter->second;
+		if (save.numRetry < MaxSaveRetryCount)
+		{
+			++save.numRetry;
+			LogWarning(0, "Cube : Can't save chunk (%d,%d) , retry %d", pos.x, pos.y, save.numRetry);
+			mIOPool->addFunctionWork([this, pos, serial]()
+			{
+				executeSave(pos, serial);
+			});
+		}
+		else
+		{
+			LogWarning(0, "Cube : Can't save chunk (%d,%d)", pos.x, pos.y);
+		}
+	}
+
+	void RegionFileStore::waitSaveComplete()
+	{
+		mIOPool->waitAllWorkComplete();
+	}
+
+	int RegionFileStore::getPendingSaveCount()
+	{
+		Mutex::Locker locker(mMutex);
+		return (int)mPendingSaves.size();
+	}
+
+}//namespace Cube
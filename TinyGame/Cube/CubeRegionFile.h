@@ -0,0 +1,116 @@
+#ifndef CubeRegionFile_h__
+#define CubeRegionFile_h__
+
+#include "CubeWorld.h"
+
+#include "PlatformThread.h"
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+namespace Cube
+{
+	// A region file keeps the chunks of a RegionSize x RegionSize area : a header , the entry table of the chunks
+	// and the chunk records appended after the table. A saved chunk is appended and only its entry is rewritten in place ,
+	// the old record becomes garbage until the file is compacted.
+	class RegionFile
+	{
+	public:
+		static int const RegionBitCount = 5;
+		static int const RegionSize = 1 << RegionBitCount;
+		static int const RegionMask = RegionSize - 1;
+		static int const NumChunk = RegionSize * RegionSize;
+
+		static ChunkPos GetRegionPos(ChunkPos const& pos) { return ChunkPos(pos.x >> RegionBitCount, pos.y >> RegionBitCount); }
+		static int      GetChunkIndex(ChunkPos const& pos) { return (pos.x & RegionMask) + RegionSize * (pos.y & RegionMask); }
+
+		enum
+		{
+			RF_Compressed = 1 << 0,
+		};
+
+		RegionFile();
+		~RegionFile();
+
+		bool open(char const* path);
+		void close();
+
+		bool haveChunk(ChunkPos const& pos) const { return mEntries[GetChunkIndex(pos)].storedSize != 0; }
+		// Read the stored data of the chunk record , it's compressed if outFlags has RF_Compressed
+		bool readRecord(ChunkPos const& pos, TArray< uint8 >& outStoredData, uint32& outRawSize, uint32& outFlags);
+		bool writeRecord(ChunkPos const& pos, uint8 const* storedData, uint32 storedSize, uint32 rawSize, uint32 flags);
+
+		uint64 getFileSize() const { return mFileSize; }
+		uint64 getGarbageSize() const;
+
+	private:
+		struct Entry
+		{
+			uint32 offset;
+			uint32 storedSize;
+			uint32 rawSize;
+			uint32 flags;
+		};
+
+		static uint64 GetDataOffset();
+		bool   createFile();
+		bool   loadTable();
+		bool   writeEntry(int index);
+		//Copy the live records to a new region file
+		void   compact();
+
+		std::string  mPath;
+		std::fstream mFile;
+		Entry        mEntries[NumChunk];
+		uint64       mFileSize;
+		uint64       mLiveSize;
+	};
+
+	// Region files of a save dir. Saves are compressed and written on an IO thread ,
+	// a load of a chunk with a pending save returns the pending data.
+	class RegionFileStore
+	{
+	public:
+		RegionFileStore(char const* dir);
+		~RegionFileStore();
+
+		// Thread-safe , the generate workers load the saved chunks
+		bool load(ChunkPos const& pos, TArray< uint8 >& outData);
+		void saveAsync(ChunkPos const& pos, TArray< uint8 >&& data);
+		void waitSaveComplete();
+
+		int  getPendingSaveCount();
+
+	private:
+		void        executeSave(ChunkPos const& pos, uint32 serial);
+		RegionFile* getRegion(ChunkPos const& pos);
+
+		static int const MaxOpenRegionCount = 16;
+		static int const MaxSaveRetryCount = 3;
+
+		struct RegionSlot
+		{
+			RegionFile* file;
+			uint32      lastUse;
+		};
+
+		struct PendingSave
+		{
+			TArray< uint8 > data;
+			uint32 serial;
+			int    numRetry;
+		};
+
+		std::string mDir;
+		Mutex       mMutex;
+		std::unordered_map< uint64, RegionSlot >  mRegionMap;
+		std::unordered_map< uint64, PendingSave > mPendingSaves;
+		uint32      mUseCounter = 0;
+		uint32      mSaveSerial = 0;
+		QueueThreadPool* mIOPool;
+	};
+
+}//namespace Cube
+
+#endif // CubeRegionFile_h__
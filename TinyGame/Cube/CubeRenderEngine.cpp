@@ -574,6 +574,22 @@ namespace Cube
 
 	}
 
+	bool RenderEngine::canUnloadChunk(Chunk* chunk)
+	{
+		//Mesh workers read the neighbor chunks of the render data
+		if (mChunkMap.find(chunk->getPos().hash_value()) != mChunkMap.end())
+			return false;
+
+		for (int i = 0; i < 4; ++i)
+		{
+			Vec3i offset = GetFaceOffset(FaceSide(i));
+			ChunkPos chunkPos = ChunkPos{ chunk->getPos() + Vec2i(offset.x, offset.y) };
+			if (mChunkMap.find(chunkPos.hash_value()) != mChunkMap.end())
+				return false;
+		}
+		return true;
+	}
+
 	void RenderEngine::updateRenderData(ChunkRenderData* data, bool bForceHighPriority)
 	{
 		if (data->state == ChunkRenderData::eMeshGenerating)
@@ -651,7 +667,7 @@ namespace Cube
 				if (!bFullRebuild && (dirtyLayerMask & (uint32(1) << indexLayer)) == 0)
 					continue;
 
-				auto layer = chunk->mLayer[indexLayer];
+				Chunk::LayerData* layer = chunk->mLayer[indexLayer];
 				auto& layerData = updateData->layers[updateData->numLayer];
 				updateData->numLayer += 1;
 				layerData.index = indexLayer;
@@ -1045,6 +1061,7 @@ namespace Cube
 		if (mChunkScanOffsetViewDist != viewDist)
 		{
 			mChunkScanOffsetViewDist = viewDist;
+			world.mChunkProvider->setViewDistance(viewDist + mChunkReleaseMargin);
 			mChunkScanOffsets.clear();
 			int viewDistSq = viewDist * viewDist;
 			for (int dy = -viewDist; dy <= viewDist; ++dy)
@@ -1909,6 +1926,16 @@ namespace Cube
 		}
 	}
 
+	void RenderEngine::onModifyLight(ChunkPos const& pos, uint32 layerMask)
+	{
+		//The chunks without render data build all the layers when they are visible
+		ChunkDataMap::iterator iter = mChunkMap.find(pos.hash_value());
+		if (iter == mChunkMap.end() || iter->second == nullptr)
+			return;
+
+		markChunkDirty(pos, layerMask, iter->second->state == ChunkRenderData::eMesh);
+	}
+
 	bool MeshRenderPoolData::initialize()
 	{
 		uint32 MaxVerticesCount = 131072 * 64 * 4;
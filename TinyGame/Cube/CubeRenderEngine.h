@@ -142,6 +142,7 @@ namespace Cube
 
 
 		void onModifyBlock( int bx , int by , int bz );
+		void onModifyLight( ChunkPos const& pos , uint32 layerMask );
 
 		void setupWorld( World& world );
 
@@ -162,6 +163,7 @@ namespace Cube
 
 		virtual void onChunkAdded(Chunk* chunk);
 		virtual void onPrevRemovChunk(Chunk* chunk){}
+		virtual bool canUnloadChunk(Chunk* chunk);
 
 		void resetChunkRenderData(ChunkRenderData* data);
 		void markChunkDirty(ChunkPos const& chunkPos);
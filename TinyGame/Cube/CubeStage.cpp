@@ -1,5 +1,6 @@
 #include "CubePCH.h"
 #include "CubeStage.h"
+#include "CubeBlockType.h"
 
 #include "GameGlobal.h"
 #include "GameGUISystem.h"
@@ -86,6 +87,17 @@ namespace Cube
 				mLevel->getWorld().setBlockNotify(info.x, info.y, info.z, BLOCK_NULL);
 			}
 		}
+		else if (msg.onRightDown())
+		{
+			BlockPosInfo info;
+			BlockId id = mLevel->getWorld().rayBlockTest(mCamera.getPos(), mCamera.getViewDir(), 100, &info);
+			if (id)
+			{
+				//Place the torch on the hit face of the block
+				Vec3i pos = Vec3i(info.x, info.y, info.z) + GetFaceOffset(info.face);
+				mLevel->getWorld().setBlockNotify(pos.x, pos.y, pos.z, BLOCK_TORCH);
+			}
+		}
 
 		return BaseClass::onMouse(msg);
 	}
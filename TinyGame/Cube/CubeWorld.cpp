@@ -7,6 +7,8 @@
 
 #include "CubeBlockRender.h"
 #include "IWorldEventListener.h"
+#include "CubeRegionFile.h"
+#include "CubeLightEngine.h"
 
 #include <algorithm>
 #include "ProfileSystem.h"
@@ -14,12 +16,295 @@
 
 namespace Cube
 {
+	namespace
+	{
+		uint32 const ChunkDataMagic = 0x4b484343; // 'CCHK'
+		uint32 const ChunkDataVersion = 1;
+		int const NumLayerMetaByte = Chunk::BlockStorage::NumBlock / 2;
+
+		void WriteBytes(TArray< uint8 >& outData, void const* data, size_t size)
+		{
+			if (size == 0)
+				return;
+			size_t offset = outData.size();
+			outData.resize(offset + size);
+			FMemory::Copy(outData.data() + offset, data, size);
+		}
+
+		template< class T >
+		void WriteValue(TArray< uint8 >& outData, T const& value)
+		{
+			WriteBytes(outData, &value, sizeof(T));
+		}
+
+		bool ReadBytes(uint8 const*& data, uint8 const* dataEnd, void* outData, size_t size)
+		{
+			if (size_t(dataEnd - data) < size)
+				return false;
+			if (size == 0)
+				return true;
+			FMemory::Copy(outData, data, size);
+			data += size;
+			return true;
+		}
+
+		template< class T >
+		bool ReadValue(uint8 const*& data, uint8 const* dataEnd, T& outValue)
+		{
+			return ReadBytes(data, dataEnd, &outValue, sizeof(T));
+		}
+
+		int GetPaletteIndexBits(int numPalette)
+		{
+			if (numPalette <= 1)
+				return 0;
+			if (numPalette <= 2)
+				return 1;
+			if (numPalette <= 4)
+				return 2;
+			if (numPalette <= 16)
+				return 4;
+			return 8;
+		}
+	}
+
+	static_assert(Chunk::LayerSize == 64, "A z column of the block storage must fill whole words");
+
+	void Chunk::BlockStorage::set(int index, BlockId id)
+	{
+		int numPalette = (int)mPalette.size();
+		int paletteIndex = 0;
+		for (; paletteIndex < numPalette; ++paletteIndex)
+		{
+			if (mPalette[paletteIndex] == id)
+				break;
+		}
+
+		if (paletteIndex == numPalette)
+		{
+			if (numPalette >= (1 << mIndexBits))
+			{
+				repack(mIndexBits == 0 ? 1 : 2 * mIndexBits);
+			}
+			mPalette.push_back(id);
+		}
+		else if (mIndexBits == 0)
+		{
+			return;
+		}
+
+		setIndex(index, paletteIndex);
+	}
+
+	void Chunk::BlockStorage::fill(BlockId id)
+	{
+		mPalette.clear();
+		mPalette.push_back(id);
+		mPalette.shrink_to_fit();
+		mWords.clear();
+		mWords.shrink_to_fit();
+		mIndexBits = 0;
+	}
+
+	void Chunk::BlockStorage::repack(int indexBits)
+	{
+		TArray< uint64 > words;
+		words.resize(NumBlock * indexBits / 64, 0);
+		if (mIndexBits)
+		{
+			uint32 const mask = (1u << mIndexBits) - 1;
+			for (int i = 0; i < NumBlock; ++i)
+			{
+				uint32 bitPos = uint32(i) * mIndexBits;
+				uint64 paletteIndex = (mWords[bitPos >> 6] >> (bitPos & 63)) & mask;
+				uint32 newBitPos = uint32(i) * indexBits;
+				words[newBitPos >> 6] |= paletteIndex << (newBitPos & 63);
+			}
+		}
+		mWords = std::move(words);
+		mIndexBits = uint8(indexBits);
+	}
+
+	void Chunk::BlockStorage::compact()
+	{
+		if (mIndexBits == 0)
+			return;
+
+		uint32 const mask = (1u << mIndexBits) - 1;
+		bool bUsed[256] = {};
+		for (int i = 0; i < NumBlock; ++i)
+		{
+			uint32 bitPos = uint32(i) * mIndexBits;
+			bUsed[uint32(mWords[bitPos >> 6] >> (bitPos & 63)) & mask] = true;
+		}
+
+		uint8 remap[256];
+		TArray< BlockId > palette;
+		for (int i = 0; i < (int)mPalette.size(); ++i)
+		{
+			if (!bUsed[i])
+				continue;
+			remap[i] = uint8(palette.size());
+			palette.push_back(mPalette[i]);
+		}
+
+		int indexBits = GetPaletteIndexBits((int)palette.size());
+		if (indexBits == 0)
+		{
+			fill(palette[0]);
+			return;
+		}
+		if (palette.size() == mPalette.size() && indexBits == mIndexBits)
+			return;
+
+		TArray< uint64 > words;
+		words.resize(NumBlock * indexBits / 64, 0);
+		for (int i = 0; i < NumBlock; ++i)
+		{
+			uint32 bitPos = uint32(i) * mIndexBits;
+			uint64 paletteIndex = remap[uint32(mWords[bitPos >> 6] >> (bitPos & 63)) & mask];
+			uint32 newBitPos = uint32(i) * indexBits;
+			words[newBitPos >> 6] |= paletteIndex << (newBitPos & 63);
+		}
+		mPalette = std::move(palette);
+		mWords = std::move(words);
+		mIndexBits = uint8(indexBits);
+	}
+
+	void Chunk::BlockStorage::getColumn(int x, int y, BlockId outIds[]) const
+	{
+		if (mIndexBits == 0)
+		{
+			FMemory::Set(outIds, mPalette[0], LayerSize * sizeof(BlockId));
+			return;
+		}
+
+		uint32 const mask = (1u << mIndexBits) - 1;
+		int const numIndexPerWord = 64 / mIndexBits;
+		//A column takes mIndexBits words
+		uint64 const* words = mWords.data() + GetIndex(x, y, 0) * mIndexBits / 64;
+		for (int i = 0; i < mIndexBits; ++i)
+		{
+			uint64 word = words[i];
+			for (int n = 0; n < numIndexPerWord; ++n)
+			{
+				*(outIds++) = mPalette[uint32(word) & mask];
+				word >>= mIndexBits;
+			}
+		}
+	}
+
+	void Chunk::BlockStorage::serialize(TArray< uint8 >& outData) const
+	{
+		WriteValue(outData, mIndexBits);
+		WriteValue(outData, uint16(mPalette.size()));
+		WriteBytes(outData, mPalette.data(), mPalette.size() * sizeof(BlockId));
+		WriteBytes(outData, mWords.data(), mWords.size() * sizeof(uint64));
+	}
+
+	bool Chunk::BlockStorage::unserialize(uint8 const*& data, uint8 const* dataEnd)
+	{
+		uint8 indexBits;
+		uint16 numPalette;
+		if (!ReadValue(data, dataEnd, indexBits) || !ReadValue(data, dataEnd, numPalette))
+			return false;
+		if ((indexBits != 0 && indexBits != 1 && indexBits != 2 && indexBits != 4 && indexBits != 8) ||
+			numPalette == 0 || numPalette > (1 << indexBits))
+			return false;
+
+		TArray< BlockId > palette;
+		palette.resize(numPalette);
+		TArray< uint64 > words;
+		words.resize(NumBlock * indexBits / 64);
+		if (!ReadBytes(data, dataEnd, palette.data(), numPalette * sizeof(BlockId)) ||
+			!ReadBytes(data, dataEnd, words.data(), words.size() * sizeof(uint64)))
+			return false;
+
+		//Broken indices would read out of the palette
+		if (numPalette < (1 << indexBits))
+		{
+			uint32 const mask = (1u << indexBits) - 1;
+			for (int i = 0; i < NumBlock; ++i)
+			{
+				uint32 bitPos = uint32(i) * indexBits;
+				if ((uint32(words[bitPos >> 6] >> (bitPos & 63)) & mask) >= numPalette)
+					return false;
+			}
+		}
+
+		mPalette = std::move(palette);
+		mWords = std::move(words);
+		mIndexBits = indexBits;
+		return true;
+	}
+
+	void Chunk::LightStorage::set(int index, uint8 level)
+	{
+		if (mLevels.empty())
+		{
+			if (level == mUniformLevel)
+				return;
+			mLevels.resize(BlockStorage::NumBlock / 2, uint8(mUniformLevel | (mUniformLevel << 4)));
+		}
+
+		uint8& value = mLevels[index >> 1];
+		if (index & 1)
+			value = (value & 0x0f) | (level << 4);
+		else
+			value = (value & 0xf0) | level;
+	}
+
+	void Chunk::LightStorage::fill(uint8 level)
+	{
+		mUniformLevel = level;
+		mLevels.clear();
+		mLevels.shrink_to_fit();
+	}
+
+	void Chunk::LightStorage::compact()
+	{
+		if (mLevels.empty())
+			return;
+
+		uint8 value = mLevels[0];
+		if ((value & 0xf) != (value >> 4))
+			return;
+		if (std::all_of(mLevels.begin(), mLevels.end(), [value](uint8 levels) { return levels == value; }))
+		{
+			fill(value & 0xf);
+		}
+	}
+
+	void Chunk::LightStorage::getColumn(int x, int y, uint8 outLevels[]) const
+	{
+		if (mLevels.empty())
+		{
+			FMemory::Set(outLevels, mUniformLevel, LayerSize);
+			return;
+		}
+
+		uint8 const* levels = mLevels.data() + BlockStorage::GetIndex(x, y, 0) / 2;
+		for (int i = 0; i < LayerSize / 2; ++i)
+		{
+			*(outLevels++) = levels[i] & 0xf;
+			*(outLevels++) = levels[i] >> 4;
+		}
+	}
+
 	Chunk::Chunk( ChunkPos const& pos )
 		:mPos( pos )
 	{
 		std::fill_n( mLayer , NumLayer , nullptr );
 	}
 
+	Chunk::~Chunk()
+	{
+		for (LayerData* layer : mLayer)
+		{
+			delete layer;
+		}
+	}
+
 	BlockId Chunk::getBlockId( int x , int y , int z )
 	{
 		if (z < 0)
@@ -30,11 +315,8 @@ namespace Cube
 		LayerData* layer = getLayer( z );
 		if ( !layer )
 			return BLOCK_NULL;
-		int mx = x & ChunkMask;
-		int my = y & ChunkMask;
-		int mz = z & LayerMask;
 
-		return layer->blockMap[ x & ChunkMask ][ y & ChunkMask ][ z & LayerMask ];
+		return layer->blocks.get( BlockStorage::GetIndex( x & ChunkMask , y & ChunkMask , z & LayerMask ) );
 	}
 
 	void Chunk::setBlockId( int x , int y , int z , BlockId id )
@@ -47,11 +329,10 @@ namespace Cube
 		{
 			if ( id == BLOCK_NULL )
 				return;
-			layer = new LayerData;
-			mLayer[ z >> LayerBitCount ] = layer;
+			layer = getOrCreateLayer( z >> LayerBitCount );
 		}
 
-		layer->blockMap[ x & ChunkMask ][ y & ChunkMask ][ z & LayerMask ] = id;
+		layer->blocks.set( BlockStorage::GetIndex( x & ChunkMask , y & ChunkMask , z & LayerMask ) , id );
 	}
 
 	MetaType Chunk::getBlockMeta( int x , int y , int z )
@@ -59,10 +340,10 @@ namespace Cube
 		if ( z < 0 ||z >= ChunkBlockMaxHeight )
 			return 0;
 		LayerData* layer = getLayer( z );
-		if ( !layer )
+		if ( !layer || layer->meta.empty() )
 			return 0;
 
-		uint32 meta = layer->meta[ x & ChunkMask ][ y & ChunkMask ][ ( z & LayerMask ) / 2 ];
+		uint32 meta = layer->meta[ BlockStorage::GetIndex( x & ChunkMask , y & ChunkMask , z & LayerMask ) / 2 ];
 		return ( z & 0x1 ) ? ( meta & 0xf ) : ( meta >> 4 );
 	}
 
@@ -76,11 +357,18 @@ namespace Cube
 		LayerData* layer = getLayer( z );
 		if ( !layer )
 		{
-			layer = new LayerData;
-			mLayer[ z >> LayerBitCount ] = layer;
+			if ( meta == 0 )
+				return;
+			layer = getOrCreateLayer( z >> LayerBitCount );
+		}
+		if ( layer->meta.empty() )
+		{
+			if ( meta == 0 )
+				return;
+			layer->meta.resize( NumLayerMetaByte , 0 );
 		}
 
-		uint8& holdMeta = layer->meta[ x & ChunkMask ][ y & ChunkMask ][ z & LayerMask ];
+		uint8& holdMeta = layer->meta[ BlockStorage::GetIndex( x & ChunkMask , y & ChunkMask , z & LayerMask ) / 2 ];
 
 		if ( z & 1 )
 			holdMeta = ( holdMeta & 0xf0 ) | meta;
@@ -88,6 +376,151 @@ namespace Cube
 			holdMeta = ( meta << 4 ) | ( holdMeta & 0xf);
 	}
 
+	uint8 Chunk::getLight(ELightType type, int x, int y, int z)
+	{
+		if (z < 0)
+			return 0;
+		if (z >= ChunkBlockMaxHeight)
+			return type == ELightType::Sky ? MaxLightLevel : 0;
+
+		LayerData* layer = getLayer(z);
+		if (!layer)
+			return type == ELightType::Sky ? MaxLightLevel : 0;
+
+		return layer->getLight(type).get(BlockStorage::GetIndex(x & ChunkMask, y & ChunkMask, z & LayerMask));
+	}
+
+	void Chunk::setLight(ELightType type, int x, int y, int z, uint8 level)
+	{
+		assert(level <= MaxLightLevel);
+
+		if (z < 0 || z >= ChunkBlockMaxHeight)
+			return;
+
+		LayerData* layer = getLayer(z);
+		if (!layer)
+		{
+			if (level == (type == ELightType::Sky ? MaxLightLevel : 0))
+				return;
+			layer = getOrCreateLayer(z >> LayerBitCount);
+		}
+
+		layer->getLight(type).set(BlockStorage::GetIndex(x & ChunkMask, y & ChunkMask, z & LayerMask), level);
+	}
+
+	void Chunk::compact()
+	{
+		for (int i = 0; i < NumLayer; ++i)
+		{
+			LayerData* layer = mLayer[i];
+			if (layer == nullptr)
+				continue;
+
+			layer->blocks.compact();
+			if (!layer->meta.empty() && std::all_of(layer->meta.begin(), layer->meta.end(), [](uint8 value) { return value == 0; }))
+			{
+				layer->meta.clear();
+				layer->meta.shrink_to_fit();
+			}
+			for (LightStorage& light : layer->lights)
+			{
+				light.compact();
+			}
+
+			//A layer without data has the full sky light
+			LightStorage const& skyLight = layer->getLight(ELightType::Sky);
+			LightStorage const& blockLight = layer->getLight(ELightType::Block);
+			if (layer->blocks.isUniform() && layer->blocks.getUniformId() == BLOCK_NULL && layer->meta.empty() &&
+				skyLight.isUniform() && skyLight.getUniformLevel() == MaxLightLevel && blockLight.isUniform() && blockLight.getUniformLevel() == 0)
+			{
+				delete layer;
+				mLayer[i] = nullptr;
+			}
+		}
+	}
+
+	size_t Chunk::getAllocatedSize() const
+	{
+		size_t result = sizeof(Chunk);
+		for (LayerData const* layer : mLayer)
+		{
+			if (layer == nullptr)
+				continue;
+			result += sizeof(LayerData) + layer->blocks.getAllocatedSize() + layer->meta.capacity();
+			for (LightStorage const& light : layer->lights)
+			{
+				result += light.getAllocatedSize();
+			}
+		}
+		return result;
+	}
+
+	void Chunk::serialize(TArray< uint8 >& outData) const
+	{
+		uint32 layerMask = 0;
+		for (int i = 0; i < NumLayer; ++i)
+		{
+			if (mLayer[i])
+				layerMask |= uint32(1) << i;
+		}
+
+		WriteValue(outData, ChunkDataMagic);
+		WriteValue(outData, ChunkDataVersion);
+		WriteValue(outData, layerMask);
+		for (LayerData const* layer : mLayer)
+		{
+			if (layer == nullptr)
+				continue;
+
+			layer->blocks.serialize(outData);
+			WriteValue(outData, uint8(layer->meta.empty() ? 0 : 1));
+			WriteBytes(outData, layer->meta.data(), layer->meta.size());
+		}
+	}
+
+	bool Chunk::unserialize(uint8 const* data, size_t size)
+	{
+		uint8 const* dataEnd = data + size;
+		uint32 magic;
+		uint32 version;
+		uint32 layerMask;
+		if (!ReadValue(data, dataEnd, magic) || !ReadValue(data, dataEnd, version) || !ReadValue(data, dataEnd, layerMask) ||
+			magic != ChunkDataMagic || version != ChunkDataVersion)
+			return false;
+
+		LayerData* layers[NumLayer] = {};
+		bool bOk = true;
+		for (int i = 0; i < NumLayer && bOk; ++i)
+		{
+			if ((layerMask & (uint32(1) << i)) == 0)
+				continue;
+
+			LayerData* layer = new LayerData;
+			layers[i] = layer;
+			uint8 bHaveMeta;
+			bOk = layer->blocks.unserialize(data, dataEnd) && ReadValue(data, dataEnd, bHaveMeta);
+			if (bOk && bHaveMeta)
+			{
+				layer->meta.resize(NumLayerMetaByte);
+				bOk = ReadBytes(data, dataEnd, layer->meta.data(), NumLayerMetaByte);
+			}
+		}
+
+		if (!bOk || data != dataEnd)
+		{
+			for (LayerData* layer : layers)
+				delete layer;
+			return false;
+		}
+
+		for (int i = 0; i < NumLayer; ++i)
+		{
+			delete mLayer[i];
+			mLayer[i] = layers[i];
+		}
+		return true;
+	}
+
 	struct NoiseFunc
 	{
 		void setSeed(uint64 seed)
@@ -133,16 +566,28 @@ namespace Cube
 			PROFILE_ENTRY("ChunkGenerate");
 			
 			chunk->state = EChunkLoadState::Generating;
+
+			TArray< uint8 > data;
+			if (provider->mRegionStore && provider->mRegionStore->load(chunk->getPos(), data) && chunk->unserialize(data.data(), data.size()))
+			{
+				LightEngine::InitChunkLight(*chunk);
+				chunk->compact();
+				chunk->state = EChunkLoadState::Ok;
+				provider->mGeneratedChunks.push(chunk);
+				return;
+			}
+
 			LandGenerater gen;
 			gen.height = 256;
 			Random rand;
 			rand.setSeed(0);
 			gen.generate(*chunk, rand);
-
-
-
+			LightEngine::InitChunkLight(*chunk);
+			chunk->compact();
+			chunk->bNeedSave = true;
 
 			chunk->state = EChunkLoadState::Ok;
+			provider->mGeneratedChunks.push(chunk);
 		}
 		virtual void abandon()
 		{
@@ -158,6 +603,135 @@ namespace Cube
 		Chunk* chunk;
 	};
 
+	ChunkProvider::ChunkProvider()
+	{
+		mGeneratePool = new QueueThreadPool();
+		mGeneratePool->init(4);
+		setViewDistance(32);
+	}
+
+	ChunkProvider::~ChunkProvider()
+	{
+		//Cancel the queued works and wait the running ones
+		delete mGeneratePool;
+
+		Chunk* chunk;
+		while (mGeneratedChunks.tryPop(chunk))
+		{
+			mPendingAddChunks.remove(chunk);
+			mMap.insert(std::make_pair(chunk->getPos().hash_value(), chunk));
+		}
+		for (Chunk* pendingChunk : mPendingAddChunks)
+		{
+			delete pendingChunk;
+		}
+		mPendingAddChunks.clear();
+
+		saveAllChunks();
+		for (auto& pair : mMap)
+		{
+			delete pair.second;
+		}
+		mMap.clear();
+		delete mRegionStore;
+	}
+
+	void ChunkProvider::setSaveDir(char const* dir)
+	{
+		//Generate workers load the chunks from the store
+		mGeneratePool->waitAllWorkComplete();
+		if (mRegionStore)
+		{
+			saveAllChunks();
+			delete mRegionStore;
+		}
+		mRegionStore = dir ? new RegionFileStore(dir) : nullptr;
+	}
+
+	void ChunkProvider::setViewDistance(int dist)
+	{
+		//The neighbors of the visible chunks are used by the mesh building
+		int size = 2 * (dist + 2) + 1;
+		mMaxLoadedChunks = size * size;
+		mUnloadCheckCount = 0;
+	}
+
+	void ChunkProvider::saveChunk(Chunk* chunk)
+	{
+		if (mRegionStore == nullptr || !chunk->bNeedSave)
+			return;
+
+		//Only the game thread edits the loaded chunks
+		TArray< uint8 > data;
+		chunk->serialize(data);
+		mRegionStore->saveAsync(chunk->getPos(), std::move(data));
+		chunk->bNeedSave = false;
+	}
+
+	void ChunkProvider::saveAllChunks()
+	{
+		if (mRegionStore == nullptr)
+			return;
+
+		for (auto& pair : mMap)
+		{
+			saveChunk(pair.second);
+		}
+		mRegionStore->waitSaveComplete();
+	}
+
+	void ChunkProvider::unloadChunk(Chunk* chunk)
+	{
+		if (mListener)
+		{
+			mListener->onPrevRemovChunk(chunk);
+		}
+		if (mLightEngine)
+		{
+			mLightEngine->notifyChunkRemoved(chunk);
+		}
+		saveChunk(chunk);
+		mMap.erase(chunk->getPos().hash_value());
+		delete chunk;
+	}
+
+	void ChunkProvider::unloadUnusedChunks()
+	{
+		int numLoaded = (int)mMap.size();
+		if (numLoaded <= mMaxLoadedChunks || numLoaded < mUnloadCheckCount)
+			return;
+
+		PROFILE_ENTRY("Unload Chunks");
+
+		TArray< Chunk* > candidates;
+		for (auto& pair : mMap)
+		{
+			Chunk* chunk = pair.second;
+			//The callers of this frame may still hold the chunk
+			if (chunk->lastUseFrame == mUpdateFrame || chunk->asyncUseCount)
+				continue;
+			//Edits are lost without a save dir
+			if (chunk->bEdited && mRegionStore == nullptr)
+				continue;
+			if (mListener && !mListener->canUnloadChunk(chunk))
+				continue;
+			candidates.push_back(chunk);
+		}
+
+		//Unload a batch below the limit , the least recently used first
+		int numUnload = Math::Min<int>((int)candidates.size(), numLoaded - mMaxLoadedChunks + mMaxLoadedChunks / 8);
+		std::nth_element(candidates.begin(), candidates.begin() + numUnload, candidates.end(), [](Chunk* lhs, Chunk* rhs)
+		{
+			return lhs->lastUseFrame < rhs->lastUseFrame;
+		});
+		for (int i = 0; i < numUnload; ++i)
+		{
+			unloadChunk(candidates[i]);
+		}
+
+		mUnloadCheckCount = (int)mMap.size() + Math::Max(mMaxLoadedChunks / 16, 1);
+	}
+
 
 	Chunk* ChunkProvider::getChunk(ChunkPos const& pos, bool bGneRequest)
 	{
@@ -169,7 +743,6 @@ namespace Cube
 			if (bGneRequest)
 			{
 				{
-					//Mutex::Locker locker(mMutexPendingAdd);
 					for (auto chunk : mPendingAddChunks)
 					{
 						if (chunk->getPos() == pos)
@@ -181,11 +754,8 @@ namespace Cube
 				ChunkGenerateWork* work = new ChunkGenerateWork;
 				work->chunk = chunk;
 				work->provider = this;
-				mGeneratePool->addWork(work);
-
-				//Mutex::Locker locker(mMutexPendingAdd);
 				mPendingAddChunks.push_back(chunk);
-
+				mGeneratePool->addWork(work);
 			}
 
 			return nullptr;
@@ -194,38 +764,58 @@ namespace Cube
 		if (iter->second->state != EChunkLoadState::Ok)
 			return nullptr;
 
+		iter->second->lastUseFrame = mUpdateFrame;
 		return iter->second;
 	}
 
 
 	void ChunkProvider::update(float deltaTime)
 	{
-		if (!mPendingAddChunks.empty())
+		++mUpdateFrame;
+
+		if (!mGeneratedChunks.empty())
 		{
 			PROFILE_ENTRY("Add Pending Chunks");
 
-			for (int index = 0; index < mPendingAddChunks.size(); ++index)
+			Chunk* chunk;
+			while (mGeneratedChunks.tryPop(chunk))
 			{
-				Chunk* chunk = mPendingAddChunks[index];
-
-				if (chunk->state == EChunkLoadState::Ok)
+				mPendingAddChunks.remove(chunk);
+				uint64 value = chunk->getPos().hash_value();
+				chunk->lastUseFrame = mUpdateFrame;
+				mMap.insert(std::make_pair(value, chunk));
+				if (mLightEngine)
 				{
-					uint64 value = chunk->getPos().hash_value();
-					mMap.insert(std::make_pair(value, chunk));
-					if (mListener)
-					{
-						mListener->onChunkAdded(chunk);
-					}
-					mPendingAddChunks.removeIndexSwap(index);
-					--index;
+					mLightEngine->notifyChunkAdded(chunk);
+				}
+				if (mListener)
+				{
+					mListener->onChunkAdded(chunk);
 				}
 			}
 		}
+
+		unloadUnusedChunks();
 	}
 
 	World::World()
 	{
 		mChunkProvider = new ChunkProvider;
+		mLightEngine = new LightEngine(*this);
+		mChunkProvider->mLightEngine = mLightEngine;
+	}
+
+	World::~World()
+	{
+		//The provider waits the light works running on the generate pool
+		delete mChunkProvider;
+		delete mLightEngine;
+	}
+
+	void World::update(float deltaTime)
+	{
+		mLightEngine->update();
+		mChunkProvider->update(deltaTime);
 	}
 
 	Cube::BlockId World::getBlockId( int bx , int by , int bz )
@@ -244,6 +834,14 @@ namespace Cube
 		return chunk->getBlockMeta( bx , by , bz );
 	}
 
+	uint8 World::getLight(ELightType type, int bx, int by, int bz)
+	{
+		Chunk* chunk = getChunk(bx, by);
+		if (!chunk)
+			return type == ELightType::Sky ? MaxLightLevel : 0;
+		return chunk->getLight(type, bx, by, bz);
+	}
+
 	void World::getNeighborBlockIds(Vec3i const& blockPos, BlockId outIds[])
 	{
 		for (int i = 0; i < FaceSide::COUNT; ++i)
@@ -267,7 +865,12 @@ namespace Cube
 		Chunk* chunk = getChunk( bx , by );
 		if ( !chunk )
 			return;
-		chunk->setBlockId( bx , by , bz , id );
+		{
+			RWLock::WriteLocker locker( chunk->mBlockLock );
+			chunk->setBlockId( bx , by , bz , id );
+		}
+		chunk->bNeedSave = true;
+		chunk->bEdited = true;
 	}
 
 
@@ -453,9 +1056,18 @@ namespace Cube
 	void World::setBlockNotify( int bx , int by , int bz , BlockId id )
 	{
 		setBlock( bx , by , bz , id );
+		mLightEngine->notifyBlockModified( bx , by , bz );
 		notifyBlockModified( bx , by , bz );
 	}
 
+	void World::notifyLightModified(ChunkPos const& pos, uint32 layerMask)
+	{
+		for (IWorldEventListener* listener : mListeners)
+		{
+			listener->onModifyLight(pos, layerMask);
+		}
+	}
+
 	void World::notifyBlockModified(int bx, int by, int bz)
 	{
 		for( ListenerList::iterator iter = mListeners.begin();
@@ -8,8 +8,12 @@
 #include "Math/TVector2.h"
 
 #include "Async/AsyncWork.h"
+#include "PlatformThread.h"
+#include "Core/LockFreeQueue.h"
+#include "DataStructure/HashMap.h"
 
 #include <unordered_map>
+#include <atomic>
 
 namespace Cube
 {
@@ -33,6 +37,15 @@ namespace Cube
 
 	int const ChunkBlockMaxHeight = 2048;
 
+	int const MaxLightLevel = 15;
+
+	enum class ELightType : uint8
+	{
+		Sky,
+		Block,
+		Count,
+	};
+
 	struct ChunkPos : public TVector2<int>
 	{
 		using TVector2::TVector2;
@@ -61,9 +74,19 @@ namespace Cube
 	{
 	public:
 		EChunkLoadState state;
+		//The chunk data is different from the saved data
+		bool   bNeedSave = false;
+		//The blocks are edited after generated , it can't be generated again
+		bool   bEdited = false;
+		uint32 lastUseFrame = 0;
+		//Async works started by the game thread use the chunk , it can't be unloaded
+		int    asyncUseCount = 0;
 
+		//Mesh workers read the blocks , edits after the chunk is added to the provider take the write lock
+		RWLock mBlockLock;
 
 		Chunk( ChunkPos const& pos );
+		~Chunk();
 
 		BlockId  getBlockId( int x , int y , int z );
 		void     setBlockId( int x , int y , int z , BlockId id );
@@ -71,37 +94,141 @@ namespace Cube
 		MetaType getBlockMeta( int x , int y , int z );
 		void     setBlockMeta( int x , int y , int z , MetaType meta );
 
+		//A position without a layer has the full sky light
+		uint8    getLight( ELightType type , int x , int y , int z );
+		void     setLight( ELightType type , int x , int y , int z , uint8 level );
+
 		ChunkPos const& getPos(){ return mPos; }
 
+		//Shrink the block storages , the empty layers are released
+		void     compact();
+		size_t   getAllocatedSize() const;
+
+		void     serialize( TArray< uint8 >& outData ) const;
+		bool     unserialize( uint8 const* data , size_t size );
+
 		static unsigned const LayerBitCount  = 6;
 		static unsigned const LayerSize = 1 << LayerBitCount;
 		static unsigned const LayerMask = ( 1 << LayerBitCount ) - 1;
 
 		static unsigned const NumLayer = ChunkBlockMaxHeight >> LayerBitCount;
 
+		// Block ids of a layer as indices of a palette , bit-packed in 64 bit words.
+		// A layer of one block type ( air , stone ) only keeps the palette.
+		class BlockStorage
+		{
+		public:
+			static int const NumBlock = ChunkSize * ChunkSize * LayerSize;
 
-		struct LayerData
+			BlockStorage( BlockId id = BLOCK_NULL )
+			{
+				mPalette.push_back(id);
+			}
+
+			static int GetIndex(int x, int y, int z) { return ( ( x * ChunkSize ) + y ) * LayerSize + z; }
+
+			BlockId get( int index ) const
+			{
+				if ( mIndexBits == 0 )
+					return mPalette[0];
+				uint32 bitPos = uint32( index ) * mIndexBits;
+				uint32 paletteIndex = uint32( mWords[ bitPos >> 6 ] >> ( bitPos & 63 ) ) & ( ( 1u << mIndexBits ) - 1 );
+				return mPalette[ paletteIndex ];
+			}
+			void set( int index , BlockId id );
+			void fill( BlockId id );
+
+			bool    isUniform() const { return mIndexBits == 0; }
+			BlockId getUniformId() const { return mPalette[0]; }
+			//The palette may keep the ids not used any more until compacted
+			TArray<BlockId> const& getPalette() const { return mPalette; }
+
+			//Rebuild the palette with the used ids and the minimum index bits
+			void    compact();
+			//Decode the LayerSize ids of the z column
+			void    getColumn( int x , int y , BlockId outIds[] ) const;
+			size_t  getAllocatedSize() const { return mPalette.capacity() * sizeof(BlockId) + mWords.capacity() * sizeof(uint64); }
+
+			void    serialize( TArray< uint8 >& outData ) const;
+			bool    unserialize( uint8 const*& data , uint8 const* dataEnd );
+
+		private:
+			void    repack( int indexBits );
+			void    setIndex( int index , uint32 paletteIndex )
+			{
+				uint32 bitPos = uint32( index ) * mIndexBits;
+				uint64 mask = ( ( uint64(1) << mIndexBits ) - 1 ) << ( bitPos & 63 );
+				uint64& word = mWords[ bitPos >> 6 ];
+				word = ( word & ~mask ) | ( uint64( paletteIndex ) << ( bitPos & 63 ) );
+			}
+
+			//0 , 1 , 2 , 4 or 8 , an index never crosses the words
+			uint8           mIndexBits = 0;
+			TArray<BlockId> mPalette;
+			TArray<uint64>  mWords;
+		};
+
+		// 4 bit light levels of a layer packed two per byte , a layer of one level doesn't allocate the levels
+		class LightStorage
 		{
-			LayerData()
+		public:
+			LightStorage( uint8 level = 0 ) :mUniformLevel( level ){}
+
+			uint8 get( int index ) const
 			{
-				FMemory::Zero(this, sizeof(*this));
+				if ( mLevels.empty() )
+					return mUniformLevel;
+				return ( mLevels[ index >> 1 ] >> ( 4 * ( index & 1 ) ) ) & 0xf;
 			}
-			BlockId  blockMap[ ChunkSize ][ ChunkSize ][ LayerSize ];
-			uint8    meta[ ChunkSize ][ ChunkSize ][ LayerSize / 2 ];
-			uint8    lightMap[ ChunkSize ][ ChunkSize ][ LayerSize ];
+			void  set( int index , uint8 level );
+			void  fill( uint8 level );
+
+			bool  isUniform() const { return mLevels.empty(); }
+			uint8 getUniformLevel() const { return mUniformLevel; }
+
+			//Release the levels if all the levels are the same
+			void  compact();
+			//Decode the LayerSize levels of the z column
+			void  getColumn( int x , int y , uint8 outLevels[] ) const;
+			size_t getAllocatedSize() const { return mLevels.capacity(); }
+
+		private:
+			uint8         mUniformLevel;
+			TArray<uint8> mLevels;
+		};
+
+		struct LayerData
+		{
+			BlockStorage  blocks;
+			//Packed 4 bit metas , allocated at the first non-zero meta
+			TArray<uint8> meta;
+			//Not saved , the light is computed when the chunk is loaded
+			LightStorage  lights[ (int)ELightType::Count ] = { LightStorage( MaxLightLevel ) , LightStorage( 0 ) };
+
+			LightStorage& getLight( ELightType type ) { return lights[ (int)type ]; }
 		};
 
 		LayerData* getLayer( int z )
 		{
-			return mLayer[ z >> LayerBitCount ];
+			return mLayer[ z >> LayerBitCount ].load( std::memory_order_acquire );
+		}
+		LayerData* getOrCreateLayer( int layerIndex )
+		{
+			LayerData* layer = mLayer[ layerIndex ].load( std::memory_order_acquire );
+			if ( layer == nullptr )
+			{
+				layer = new LayerData;
+				mLayer[ layerIndex ].store( layer , std::memory_order_release );
+			}
+			return layer;
 		}
 
-		LayerData* mLayer[ NumLayer ];
+		//The light workers create layers under the write lock while the game thread reads them without the lock ,
+		//a new layer is published with an atomic store
+		std::atomic< LayerData* > mLayer[ NumLayer ];
 		ChunkPos   mPos;
 	};
 
-
-
 	class TerrainGenerator
 	{
 	public:
@@ -126,36 +253,53 @@ namespace Cube
 	public:
 		virtual void onChunkAdded(Chunk* chunk) = 0;
 		virtual void onPrevRemovChunk(Chunk* chunk) = 0;
+		//The chunks used by the listener must be kept loaded
+		virtual bool canUnloadChunk(Chunk* chunk) { return true; }
 	};
 
+	class RegionFileStore;
+	class LightEngine;
 
 	class ChunkProvider
 	{
 	public:
-		ChunkProvider()
-		{
-			mGeneratePool = new QueueThreadPool();
-			mGeneratePool->init(4);
-		}
+		ChunkProvider();
+		~ChunkProvider();
 
-		~ChunkProvider()
-		{
-			delete mGeneratePool;
-		}
 		Chunk* getChunk( int x , int y );
 
 		Chunk* getChunk( ChunkPos const& pos, bool bGneRequest = false);
 
 		void update(float deltaTime);
 
-		typedef std::unordered_map< uint64 , Chunk* > ChunkMap;
+		//Unloaded chunks are saved to the region files of the dir and loaded before generating
+		void setSaveDir(char const* dir);
+		//Keep about the chunks of the view square loaded , the least recently used chunks are unloaded
+		void setViewDistance(int dist);
+		void saveAllChunks();
+		int  getLoadedChunkCount() const { return (int)mMap.size(); }
+
+		void unloadUnusedChunks();
+		void unloadChunk(Chunk* chunk);
+		void saveChunk(Chunk* chunk);
+
+		typedef THashMap< uint64 , Chunk* > ChunkMap;
 		ChunkMap mMap;
 
-		Mutex mMutexPendingAdd;
+		//Chunks requested but not generated yet , only used by the game thread
 		TArray<Chunk*> mPendingAddChunks;
+		//Generate workers hand finished chunks to the game thread
+		TLockFreeMPSCQueue<Chunk*> mGeneratedChunks;
 
 		IChunkEventListener* mListener = nullptr;
 		QueueThreadPool* mGeneratePool;
+		RegionFileStore* mRegionStore = nullptr;
+		LightEngine*     mLightEngine = nullptr;
+
+		uint32 mUpdateFrame = 1;
+		int    mMaxLoadedChunks;
+		//The chunk count of the next unload scan , the scan doesn't run every frame when the listener keeps the chunks
+		int    mUnloadCheckCount = 0;
 	};
 
 
@@ -171,10 +315,12 @@ namespace Cube
 	public:
 
 		World();
+		~World();
 
 		BlockId  getBlockId( int bx , int by , int bz ) final;
 		MetaType getBlockMeta( int bx , int by , int bz ) final;
 		void     getNeighborBlockIds(Vec3i const& blockPos, BlockId outIds[]);
+		uint8    getLight( ELightType type , int bx , int by , int bz );
 
 		void     setBlock( int bx , int by , int bz , BlockId id );
 		void     setBlockNotify( int bx , int by , int bz , BlockId id );
@@ -194,15 +340,15 @@ namespace Cube
 		void    removeListener( IWorldEventListener& listener );
 		void    notifyBlockModified( int bx , int by , int bz );
 
-		void update(float deltaTime)
-		{
-			mChunkProvider->update(deltaTime);
-		}
+		void    notifyLightModified( ChunkPos const& pos , uint32 layerMask );
+
+		void update(float deltaTime);
 
 
 		typedef std::list< IWorldEventListener* > ListenerList;
 		ListenerList   mListeners;
 		ChunkProvider* mChunkProvider;
+		LightEngine*   mLightEngine;
 		Random         mRandom;
 	};
 
@@ -5,11 +5,14 @@
 
 namespace Cube
 {
+struct ChunkPos;
 
 class IWorldEventListener
 {
 public:
 	virtual void onModifyBlock( int bx , int by , int bz ) = 0;
+	//The light of the layers in the layer mask of the chunk is changed
+	virtual void onModifyLight( ChunkPos const& pos , uint32 layerMask ){}
 };
 
 }//namespace Cube
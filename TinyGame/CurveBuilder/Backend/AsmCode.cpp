@@ -2,6 +2,14 @@
 
 #include <iostream>
 
+#if TARGET_PLATFORM_64BITS
+#if SYS_PLATFORM_WIN
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
 
 #if SYS_PLATFORM_WIN
 #include "WindowsHeader.h"
@@ -168,3 +176,34 @@ void AsmCodeBuffer::clear()
 	FMemory::Set(mCode, 0, mMaxCodeSize);
 	mCodeEnd = mCode;
 }
+
+#if TARGET_PLATFORM_64BITS
+bool AVXSIMDCodeGeneratorX64::IsSupported()
+{
+	static bool const bSupported = []() -> bool
+	{
+		// CPUID.1:ECX OSXSAVE(27) and AVX(28) , XCR0 must enable the XMM(1) and YMM(2) states
+		uint32 ecx;
+		uint64 xcr0;
+#if SYS_PLATFORM_WIN
+		int info[4];
+		__cpuid(info, 1);
+		ecx = uint32(info[2]);
+		if ((ecx & (1 << 27)) == 0)
+			return false;
+		xcr0 = _xgetbv(0);
+#else
+		uint32 eax, ebx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			return false;
+		if ((ecx & (1 << 27)) == 0)
+			return false;
+		uint32 xcr0Low, xcr0High;
+		__asm__ volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+		xcr0 = (uint64(xcr0High) << 32) | xcr0Low;
+#endif
+		return (ecx & (1 << 28)) != 0 && (xcr0 & 0x6) == 0x6;
+	}();
+	return bSupported;
+}
+#endif
@@ -70,6 +70,7 @@ protected:
 	friend class ExpressionCompiler;
 	friend class SSECodeGeneratorX64;
 	friend class SSESIMDCodeGeneratorX64;
+	friend class AVXSIMDCodeGeneratorX64;
 };
 
 
@@ -1273,7 +1274,6 @@ public:
 		{
 			uint32 index : 24;
 			uint32 bAlloc : 1;
-			int32  refIndex : 7; // -1 if new alloc, else index in current simulated stack to reuse
 		};
 		TArray<AllocEvent> mAllocEvents;
 
@@ -1301,30 +1301,13 @@ public:
 			mCurPushIndex = 0;
 		}
 
-		int findValueInSimStack(ExprParse::Unit const& code)
-		{
-			for (int i = 0; i < (int)mSimStackValue.size(); ++i)
-			{
-				if (code.type == mSimStackValue[i].type)
-				{
-					switch (code.type)
-					{
-					case VALUE_CONST: if (code.constValue == mSimStackValue[i].constValue) return i; break;
-					case VALUE_VARIABLE: if (code.variable.ptr == mSimStackValue[i].variable.ptr) return i; break;
-					case VALUE_INPUT: if (code.input.index == mSimStackValue[i].input.index) return i; break;
-					case VALUE_EXPR_TEMP: if (code.exprTemp.tempIndex == mSimStackValue[i].exprTemp.tempIndex) return i; break;
-					}
-				}
-			}
-			return -1;
-		}
-
+		// A pushed value always gets its own register , the left operand of an operator is overwritten by the result
+		// and a register shared by two stack values would change both.
 		void pushSimValue(ExprParse::Unit const& code)
 		{
-			int refIdx = findValueInSimStack(code);
 			mPushStack.push_back(mCurPushIndex);
 			mSimStackValue.push_back(code);
-			mAllocEvents.push_back({ (uint32)mCurPushIndex, 1, (int8)refIdx });
+			mAllocEvents.push_back({ (uint32)mCurPushIndex, 1 });
 			if (mPushCrossesCall.size() <= mCurPushIndex) mPushCrossesCall.resize(mCurPushIndex + 1);
 			mPushCrossesCall[mCurPushIndex] = false;
 			mCurPushIndex++;
@@ -1336,7 +1319,7 @@ public:
 			{
 				if (!mPushStack.empty())
 				{
-					mAllocEvents.push_back({ (uint32)mPushStack.back(), 0, -1 });
+					mAllocEvents.push_back({ (uint32)mPushStack.back(), 0 });
 					mPushStack.pop_back();
 					mSimStackValue.pop_back();
 				}
@@ -1392,7 +1375,7 @@ public:
 				// Function Result Push (matches codeFunction increment)
 				mPushStack.push_back(mCurPushIndex);
 				mSimStackValue.push_back(Unit(code.type)); 
-				mAllocEvents.push_back({ (uint32)mCurPushIndex, 1, -1 });
+				mAllocEvents.push_back({ (uint32)mCurPushIndex, 1 });
 				if (mPushCrossesCall.size() <= mCurPushIndex) mPushCrossesCall.resize(mCurPushIndex + 1);
 				mPushCrossesCall[mCurPushIndex] = false;
 				mCurPushIndex++;
@@ -1482,17 +1465,8 @@ public:
 			{
 				if (ev.bAlloc)
 				{
-					int regIdx = -1;
-					if (ev.refIndex != -1)
-					{
-						uint32 refEventIdx = activePushes[ev.refIndex];
-						regIdx = outPlan[refEventIdx];
-					}
-					else
-					{
-						bool bCrossesCall = (ev.index < mPushCrossesCall.size()) ? mPushCrossesCall[ev.index] : true;
-						regIdx = alloc(!bCrossesCall);
-					}
+					bool bCrossesCall = (ev.index < mPushCrossesCall.size()) ? mPushCrossesCall[ev.index] : true;
+					int regIdx = alloc(!bCrossesCall);
 
 					// If exhausted, assign to an anonymous stack slot
 					if (regIdx == -1)
@@ -1579,9 +1553,8 @@ public:
 		else
 		{
 			// Load to physical register
+			// A value cached in another register is copied
 			RegXMM dstReg = xmm(xmmIdx);
-			int currentReg = findXMMWithValue(mPrevValue);
-			CHECK(currentReg == INDEX_NONE || currentReg == xmmIdx);
 			mNumInstruction += emitLoadValue(mPrevValue, dstReg);
 		}
 
@@ -1624,6 +1597,10 @@ public:
 			mRegAllocator.pushSimValue(mRegAllocator.mSimPrevUnit);
 		}
 
+		// Generate the allocation plan based on collected stack info , the spilled values add temp slots
+		mRegAllocator.generateAllocPlan(mAllocPlan);
+		mCurPushIndex = 0;
+
 		// Calculate precise stack size
 		int tempSize = mRegAllocator.mNumTemps * 8;
 		if (tempSize % 16 != 0) tempSize += 8; // Maintain 16-byte alignment
@@ -1640,10 +1617,6 @@ public:
 				mReservedInputCount = i + 1;
 		}
 
-		// Generate the allocation plan based on collected stack info
-		mRegAllocator.generateAllocPlan(mAllocPlan);
-		mCurPushIndex = 0;
-
 		// Save non-volatile XMM registers (xmm6 - xmm15)
 		// We save all of them here based on the simulation plan
 		for (int i = 0; i < MaxXMMStackSize; ++i)
@@ -2034,6 +2007,10 @@ public:
 			}
 		}
 
+		// The left operand register holds the result now
+		if (opType != BOP_ASSIGN && !mXMMStack.empty())
+			mXMMStack.back().type = TOKEN_BINARY_OP;
+
 		mPrevValue.type = TOKEN_BINARY_OP;
 		mPrevValue.idxXMM = INDEX_NONE;
 	}
@@ -2068,6 +2045,9 @@ public:
 			}
 		}
 
+		if (!mXMMStack.empty())
+			mXMMStack.back().type = TOKEN_UNARY_OP;
+
 		mPrevValue.type = TOKEN_FUNC;
 		mPrevValue.idxXMM = INDEX_NONE;
 	}
@@ -2169,7 +2149,8 @@ class SSESIMDCodeGeneratorX64 : public TCodeGenerator<SSESIMDCodeGeneratorX64>
 	, public SSECodeGeneratorX64Base
 {
 	using BaseClass = SSECodeGeneratorX64Base;
-	static int constexpr InputScratchReg = 4;
+	// xmm0 is never allocated , xmm1 - xmm4 can hold live values
+	static int constexpr InputScratchReg = 0;
 	static int constexpr SpillScratchReg = RegAllocator::ScratchReg;
 public:
 	using TokenType = SSECodeGeneratorX64Base::TokenType;
@@ -2192,11 +2173,18 @@ public:
 		return -176 - 16 - mRegAllocator.mNumTemps * 16 - index * 16;
 	}
 
+	// Call slots : xmm1 - xmm4 saved across a call , the arguments and the result of a scalar function
+	static int constexpr MaxFuncArgs = 4;
+	static int constexpr NumCallSlot = 4 + MaxFuncArgs + 1;
+
 	int getSIMDCallSaveOffset(int slot) const
 	{
 		return -176 - 16 - mRegAllocator.mNumTemps * 16 - std::max(4, mReservedInputCount) * 16 - (slot + 1) * 16;
 	}
 
+	int getSIMDFuncArgOffset(int index) const { return getSIMDCallSaveOffset(4 + index); }
+	int getSIMDFuncResultOffset() const { return getSIMDCallSaveOffset(4 + MaxFuncArgs); }
+
 	void emitLoadSIMDInput(int index, RegXMM const& dst)
 	{
 		Asm::movups(dst, xmmword_ptr(rbp, getSIMDInputOffset(index)));
@@ -2315,6 +2303,10 @@ public:
 			mRegAllocator.pushSimValue(mRegAllocator.mSimPrevUnit);
 		}
 
+		// Generate the allocation plan based on collected stack info , the spilled values add temp slots
+		mRegAllocator.generateAllocPlan(mAllocPlan);
+		mCurPushIndex = 0;
+
 		// SIMD path stores temporaries and vector inputs in 16-byte slots.
 		int tempSize = mRegAllocator.mNumTemps * 16;
 
@@ -2327,16 +2319,13 @@ public:
 		}
 
 		int inputSaveSize = std::max(4, mReservedInputCount) * 16;
-		int callSaveSize = 4 * 16;
-		int finalStackSize = 32 + 16 * MaxXMMStackSize + tempSize + inputSaveSize + callSaveSize;
+		int callSaveSize = NumCallSlot * 16;
+		// The slots end above the 32 bytes shadow space of the called functions
+		int finalStackSize = 32 + 176 + 16 + tempSize + inputSaveSize + callSaveSize;
 
 		Asm::sub(rsp, imm32(finalStackSize));
 		mNumInstruction += 3;
 
-		// Generate the allocation plan based on collected stack info
-		mRegAllocator.generateAllocPlan(mAllocPlan);
-		mCurPushIndex = 0;
-
 		// Save non-volatile XMM registers (xmm6 - xmm15)
 		// We save all of them here based on the simulation plan
 		for (int i = 0; i < MaxXMMStackSize; ++i)
@@ -2427,6 +2416,9 @@ public:
 	static __m128 __vectorcall SIMD_Tan(__m128 v) { return ApplyScalarMath(v, [](double x) { return std::tan(x); }); }
 	static __m128 __vectorcall SIMD_Exp(__m128 v) { return ApplyScalarMath(v, [](double x) { return std::exp(x); }); }
 	static __m128 __vectorcall SIMD_Log(__m128 v) { return ApplyScalarMath(v, [](double x) { return std::log(x); }); }
+	static __m128 __vectorcall SIMD_Cot(__m128 v) { return ApplyScalarMath(v, [](double x) { return 1.0 / std::tan(x); }); }
+	static __m128 __vectorcall SIMD_Sec(__m128 v) { return ApplyScalarMath(v, [](double x) { return 1.0 / std::cos(x); }); }
+	static __m128 __vectorcall SIMD_Csc(__m128 v) { return ApplyScalarMath(v, [](double x) { return 1.0 / std::sin(x); }); }
 
 	static void* GetSIMDFuncAddress(int id)
 	{
@@ -2437,6 +2429,9 @@ public:
 		case EFuncSymbol::Sin: return (void*)&SIMD_Sin;
 		case EFuncSymbol::Cos: return (void*)&SIMD_Cos;
 		case EFuncSymbol::Tan: return (void*)&SIMD_Tan;
+		case EFuncSymbol::Cot: return (void*)&SIMD_Cot;
+		case EFuncSymbol::Sec: return (void*)&SIMD_Sec;
+		case EFuncSymbol::Csc: return (void*)&SIMD_Csc;
 		}
 		return nullptr;
 	}
@@ -2445,128 +2440,52 @@ public:
 	{
 		checkAndLoadPrevValue();
 		int numParam = info.getArgNum();
-		int numLive = (int)mXMMStack.size() - numParam;
-		uint32 spilledMask = spillLiveVolatileAcrossCall(numLive);
-
-		// Use the plan's assigned result register as the accumulator
-		// Note: The plan assumes arguments are popped (freed) before result is pushed (allocated).
-		// So resultReg MIGHT reuse an argument register.
-		int accRegIdx = -1;
-		if (mCurPushIndex < mAllocPlan.size())
-			accRegIdx = mAllocPlan[mCurPushIndex];
-		mCurPushIndex++;
-
-		if (accRegIdx == -1) throw ExprParseException(EExprErrorCode::eGenerateCodeFailed, "Register allocation failed");
-		accRegIdx = resolveSIMDResultRegCollision(accRegIdx, numLive);
+		if (numParam > MaxFuncArgs)
+			throw ExprParseException(EExprErrorCode::eGenerateCodeFailed, "SIMD function calls with > 4 parameters not supported in JIT");
 
-
-		// Check for conflict: Does accRegIdx alias any live input argument?
-		bool hasConflict = false;
+		// The arguments are stored to the call slots and the scalar function is called for each lane ,
+		// the volatile registers are clobbered by every call.
+		int numLive = (int)mXMMStack.size() - numParam;
 		for (int i = 0; i < numParam; ++i)
 		{
-			if (mXMMStack[numLive + i].idxXMM == accRegIdx)
-			{
-				hasConflict = true;
-				break;
-			}
+			emitLoadSIMDPhysicalValue(mXMMStack[numLive + i].idxXMM, xmm0);
+			Asm::movups(xmmword_ptr(rbp, getSIMDFuncArgOffset(i)), xmm0);
+			mNumInstruction += 2;
 		}
-
-		// If conflict, we must save the input value elsewhere because accReg will be overwritten
-		if (hasConflict)
+		for (int i = 0; i < numParam; ++i)
 		{
-			Asm::sub(rsp, imm32(16));
-			if (accRegIdx >= RegAllocator::RegSlotBase)
-			{
-				int offset = GetTempStackOffsetSIMD(accRegIdx - RegAllocator::RegSlotBase);
-				Asm::movups(xmm0, xmmword_ptr(rbp, offset));
-				Asm::movups(xmmword_ptr(rsp, 0), xmm0);
-			}
-			else
-			{
-				Asm::movups(xmmword_ptr(rsp, 0), xmm(accRegIdx));
-			}
-			mNumInstruction += 2;
+			mXMMStack.pop_back();
 		}
-
-		// Use ScratchReg as accumulator if result is spilled
-		int physicalAccIdx = (accRegIdx >= RegAllocator::RegSlotBase) ? RegAllocator::ScratchReg : accRegIdx;
-		RegXMM accReg = xmm(physicalAccIdx);
-		Asm::xorps(accReg, accReg);
+		uint32 spilledMask = spillLiveVolatileAcrossCall(numLive);
 
 		for (int lane = 0; lane < 4; ++lane)
 		{
-			for (int i = 0; i < numParam && i < 4; ++i)
+			for (int i = 0; i < numParam; ++i)
 			{
-				RegXMM srcReg = xmm(0); // Initialize
-				int srcPhyIdx = mXMMStack[numLive + i].idxXMM;
-
-				if (hasConflict && srcPhyIdx == accRegIdx)
-				{
-					// Load from spill
-					Asm::movups(xmm0, xmmword_ptr(rsp, 0)); 
-					srcReg = xmm0;
-					mNumInstruction++;
-				}
-				else if (srcPhyIdx >= RegAllocator::RegSlotBase)
-				{
-					// Load from spilled virtual register slot
-					int offset = GetTempStackOffsetSIMD(srcPhyIdx - RegAllocator::RegSlotBase);
-					Asm::movups(xmm(InputScratchReg), xmmword_ptr(rbp, offset)); 
-					srcReg = xmm(InputScratchReg);
-					mNumInstruction++;
-				}
-				else
-				{
-					srcReg = xmm(srcPhyIdx);
-				}
-				
-
-				if (lane == 0) {
-					Asm::movss(xmm(i), srcReg);
-				}
-				else {
-					Asm::movaps(xmm(i), srcReg);
-					Asm::shufps(xmm(i), xmm(i), uint8(lane));
-				}
-				mNumInstruction += 2;
+				Asm::movss(xmm(i), dword_ptr(rbp, getSIMDFuncArgOffset(i) + 4 * lane));
 			}
-
-			// Call Scalar Function
-			// Since we iterate lanes, we call the scalar function implementation
 			Asm::movabs(rax, (uint64)info.funcPtr);
 			Asm::call(rax);
-			mNumInstruction += 2;
-
-			// Insert result (xmm0) into accumulator
-			// 0x00 -> lane 0, 0x10 -> lane 1, 0x20 -> lane 2, 0x30 -> lane 3
-			uint8 mask = (lane << 4); 
-			Asm::insertps(accReg, xmm0, mask);
-			mNumInstruction++;
-		}
-
-		if (hasConflict)
-		{
-			Asm::add(rsp, imm32(16));
-			mNumInstruction++;
+			Asm::movss(dword_ptr(rbp, getSIMDFuncResultOffset() + 4 * lane), xmm0);
+			mNumInstruction += numParam + 3;
 		}
 
 		restoreLiveVolatileAcrossCall(spilledMask);
 
-		// If result was spilled, move from scratch register to stack slot
-		if (accRegIdx >= RegAllocator::RegSlotBase)
-		{
-			int offset = GetTempStackOffsetSIMD(accRegIdx - RegAllocator::RegSlotBase);
-			Asm::movups(xmmword_ptr(rbp, offset), accReg);
-			mNumInstruction++;
-		}
-		for (int i = 0; i < numParam; ++i)
-		{
-			mXMMStack.pop_back();
-		}
+		int resultIdx = -1;
+		if (mCurPushIndex < mAllocPlan.size())
+			resultIdx = mAllocPlan[mCurPushIndex];
+		mCurPushIndex++;
+		if (resultIdx == -1) throw ExprParseException(EExprErrorCode::eGenerateCodeFailed, "Register allocation failed");
+		resultIdx = resolveSIMDResultRegCollision(resultIdx, (int)mXMMStack.size());
+
+		Asm::movups(xmm0, xmmword_ptr(rbp, getSIMDFuncResultOffset()));
+		emitStoreSIMDPhysicalValue(resultIdx, xmm0);
+		mNumInstruction += 2;
 
 		mXMMStack.emplace_back();
 		mXMMStack.back().type = TOKEN_FUNC;
-		mXMMStack.back().idxXMM = accRegIdx;
+		mXMMStack.back().idxXMM = resultIdx;
 
 		mPrevValue.type = TOKEN_FUNC;
 		mPrevValue.idxXMM = INDEX_NONE;
@@ -2577,20 +2496,29 @@ public:
 		checkAndLoadPrevValue();
 		if (info.id == EFuncSymbol::Sqrt)
 		{
-			int xmmIdx = mXMMStack.back().idxXMM;
-			if (xmmIdx >= RegAllocator::RegSlotBase)
-			{
-				int offset = GetTempStackOffsetSIMD(xmmIdx - RegAllocator::RegSlotBase);
-				Asm::movups(xmm(SpillScratchReg), xmmword_ptr(rbp, offset));
-				Asm::sqrtps(xmm(SpillScratchReg), xmm(SpillScratchReg));
-				Asm::movups(xmmword_ptr(rbp, offset), xmm(SpillScratchReg));
-				mNumInstruction += 3;
-			}
+			// The result takes the push of the plan like a called function
+			int argIdx = mXMMStack.back().idxXMM;
+			mXMMStack.pop_back();
+
+			int resultIdx = -1;
+			if (mCurPushIndex < mAllocPlan.size())
+				resultIdx = mAllocPlan[mCurPushIndex];
+			mCurPushIndex++;
+			if (resultIdx == -1) throw ExprParseException(EExprErrorCode::eGenerateCodeFailed, "Register allocation failed");
+
+			RegXMM resultReg = (resultIdx >= RegAllocator::RegSlotBase) ? xmm(SpillScratchReg) : xmm(resultIdx);
+			if (argIdx >= RegAllocator::RegSlotBase)
+				Asm::sqrtps(resultReg, xmmword_ptr(rbp, GetTempStackOffsetSIMD(argIdx - RegAllocator::RegSlotBase)));
 			else
-			{
-				Asm::sqrtps(xmm(xmmIdx), xmm(xmmIdx));
-				mNumInstruction++;
-			}
+				Asm::sqrtps(resultReg, xmm(argIdx));
+			emitStoreSIMDPhysicalValue(resultIdx, resultReg);
+			mNumInstruction += 2;
+
+			mXMMStack.emplace_back();
+			mXMMStack.back().type = TOKEN_FUNC;
+			mXMMStack.back().idxXMM = resultIdx;
+			mPrevValue.type = TOKEN_FUNC;
+			mPrevValue.idxXMM = INDEX_NONE;
 			return;
 		}
 
@@ -2704,12 +2632,13 @@ public:
 				switch (opType) {
 				case BOP_ADD: Asm::addps(dst, src); break;
 				case BOP_MUL: Asm::mulps(dst, src); break;
+				// xmm0 is never allocated , src can be the input scratch register or a memory slot
 				case BOP_SUB:
-					if (isReverse) { Asm::movaps(xmm1, dst); Asm::movaps(dst, src); Asm::subps(dst, xmm1); }
+					if (isReverse) { Asm::movups(xmm0, src); Asm::subps(xmm0, dst); Asm::movaps(dst, xmm0); }
 					else Asm::subps(dst, src);
 					break;
 				case BOP_DIV:
-					if (isReverse) { Asm::movaps(xmm1, dst); Asm::movaps(dst, src); Asm::divps(dst, xmm1); }
+					if (isReverse) { Asm::movups(xmm0, src); Asm::divps(xmm0, dst); Asm::movaps(dst, xmm0); }
 					else Asm::divps(dst, src);
 					break;
 				}
@@ -2767,6 +2696,10 @@ public:
 			}
 		}
 
+		// The left operand register holds the result now
+		if (opType != BOP_ASSIGN && !mXMMStack.empty())
+			mXMMStack.back().type = TOKEN_BINARY_OP;
+
 		mPrevValue.type = TOKEN_BINARY_OP;
 		mPrevValue.idxXMM = INDEX_NONE;
 	}
@@ -2793,11 +2726,11 @@ public:
 			}
 
 			// 1. Load mask [v, ?, ?, ?]
-			Asm::movss(xmm1, dword_ptr(&mConstLabel, constValue.offset));
+			Asm::movss(xmm0, dword_ptr(&mConstLabel, constValue.offset));
 			// 2. Broadcast to [v, v, v, v]
-			Asm::shufps(xmm1, xmm1, 0);
+			Asm::shufps(xmm0, xmm0, 0);
 			// 3. XOR to negate
-			Asm::xorps(reg, xmm1);
+			Asm::xorps(reg, xmm0);
 			mNumInstruction += 4;
 
 			if (xmmIdx >= RegAllocator::RegSlotBase)
@@ -2806,6 +2739,7 @@ public:
 				Asm::movups(xmmword_ptr(rbp, offset), reg);
 				++mNumInstruction;
 			}
+			mXMMStack.back().type = TOKEN_UNARY_OP;
 		}
 
 		mPrevValue.type = TOKEN_FUNC;
@@ -2895,5 +2829,569 @@ public:
 	}
 };
 
+//=============================================================================
+// AVXSIMDCodeGeneratorX64 - SIMD version with AVX (Processing 8 floats)
+//=============================================================================
+// __vectorcall passes the __m256 inputs in ymm0 - ymm3 and returns the result in ymm0.
+// Only the low 128 bits of xmm6 - xmm15 are non-volatile , all the live values are spilled across a call.
+class AVXSIMDCodeGeneratorX64 : public TCodeGenerator<AVXSIMDCodeGeneratorX64>
+	, public SSECodeGeneratorX64Base
+{
+	using BaseClass = SSECodeGeneratorX64Base;
+	// ymm0 is never allocated
+	static int constexpr InputScratchReg = 0;
+	static int constexpr SpillScratchReg = RegAllocator::ScratchReg;
+public:
+	using TokenType = SSECodeGeneratorX64Base::TokenType;
+
+	static int constexpr SIMDWidth = 8;
+	//Check the CPU and the OS support of the YMM registers
+	static bool IsSupported();
+
+	void codeInit(int numInput, ValueLayout inputLayouts[])
+	{
+		mbIsSIMD = true;
+		mData->clear();
+		mNumXMMUsed = 0;
+		mNumInstruction = 0;
+		mPrevValue.type = TOKEN_NONE;
+		mPrevValue.var = nullptr;
+		Asm::clearLink();
+
+		BaseClass::codeInit(numInput, inputLayouts);
+	}
+
+	// Frame : xmm6 - xmm15 saves , temps , inputs , call slots , all in 32 bytes slots after the saves
+	static int GetTempStackOffsetAVX(int index)
+	{
+		return -176 - 32 - index * 32;
+	}
+
+	int getAVXInputOffset(int index) const
+	{
+		return -176 - mRegAllocator.mNumTemps * 32 - (index + 1) * 32;
+	}
+
+	// Call slots : the live registers by index , the arguments and the result of a scalar function
+	static int constexpr MaxFuncArgs = 4;
+	static int constexpr NumCallSlot = 16 + MaxFuncArgs + 1;
+
+	int getAVXCallSlotOffset(int slot) const
+	{
+		return -176 - mRegAllocator.mNumTemps * 32 - std::max(4, mReservedInputCount) * 32 - (slot + 1) * 32;
+	}
+	int getAVXFuncArgOffset(int index) const { return getAVXCallSlotOffset(16 + index); }
+	int getAVXFuncResultOffset() const { return getAVXCallSlotOffset(16 + MaxFuncArgs); }
+
+	static bool IsSlot(int phyIdx) { return phyIdx >= RegAllocator::RegSlotBase; }
+	static int  GetSlotOffset(int phyIdx) { return GetTempStackOffsetAVX(phyIdx - RegAllocator::RegSlotBase); }
+
+	void emitLoadAVXPhysicalValue(int phyIdx, RegYMM const& dst)
+	{
+		if (IsSlot(phyIdx))
+		{
+			Asm::vmovups(dst, ymmword_ptr(rbp, GetSlotOffset(phyIdx)));
+			++mNumInstruction;
+		}
+		else if (dst.index() != phyIdx)
+		{
+			Asm::vmovups(dst, ymm(phyIdx));
+			++mNumInstruction;
+		}
+	}
+
+	void emitStoreAVXPhysicalValue(int phyIdx, RegYMM const& src)
+	{
+		if (IsSlot(phyIdx))
+		{
+			Asm::vmovups(ymmword_ptr(rbp, GetSlotOffset(phyIdx)), src);
+			++mNumInstruction;
+		}
+		else if (src.index() != phyIdx)
+		{
+			Asm::vmovups(ymm(phyIdx), src);
+			++mNumInstruction;
+		}
+	}
+
+	uint32 spillLiveAcrossCall(int numLive)
+	{
+		uint32 spilledMask = 0;
+		for (int i = 0; i < numLive; ++i)
+		{
+			int phyIdx = mXMMStack[i].idxXMM;
+			if (IsSlot(phyIdx))
+				continue;
+
+			uint32 bit = (1u << phyIdx);
+			if ((spilledMask & bit) == 0)
+			{
+				Asm::vmovups(ymmword_ptr(rbp, getAVXCallSlotOffset(phyIdx)), ymm(phyIdx));
+				++mNumInstruction;
+				spilledMask |= bit;
+			}
+		}
+		return spilledMask;
+	}
+
+	void restoreLiveAcrossCall(uint32 spilledMask)
+	{
+		for (int phyIdx = 1; phyIdx < 16; ++phyIdx)
+		{
+			if (spilledMask & (1u << phyIdx))
+			{
+				Asm::vmovups(ymm(phyIdx), ymmword_ptr(rbp, getAVXCallSlotOffset(phyIdx)));
+				++mNumInstruction;
+			}
+		}
+	}
+
+	int fetchResultIndex()
+	{
+		int resultIdx = -1;
+		if (mCurPushIndex < mAllocPlan.size())
+			resultIdx = mAllocPlan[mCurPushIndex];
+		mCurPushIndex++;
+		if (resultIdx == -1) throw ExprParseException(EExprErrorCode::eGenerateCodeFailed, "Register allocation failed");
+		return resultIdx;
+	}
+
+	void pushFuncResult(int resultIdx)
+	{
+		mXMMStack.emplace_back();
+		mXMMStack.back().type = TOKEN_FUNC;
+		mXMMStack.back().idxXMM = resultIdx;
+		mPrevValue.type = TOKEN_FUNC;
+		mPrevValue.idxXMM = INDEX_NONE;
+	}
+
+	void postLoadCode()
+	{
+		// Function prologue for x64
+		Asm::push(rbp);
+		Asm::mov(rbp, rsp);
+
+		if (IsValue(mRegAllocator.mSimulatedPrevType))
+		{
+			mRegAllocator.pushSimValue(mRegAllocator.mSimPrevUnit);
+		}
+
+		// The spilled values of the plan add temp slots
+		mRegAllocator.generateAllocPlan(mAllocPlan);
+		mCurPushIndex = 0;
+
+		mReservedInputCount = 0;
+		for (int i = 0; i < (int)mRegAllocator.mInputUsed.size(); ++i)
+		{
+			if (!mRegAllocator.mInputUsed[i])
+				continue;
+			if (i >= 4)
+				throw ExprParseException(EExprErrorCode::eGenerateCodeFailed, "AVX code supports 4 inputs only");
+			mReservedInputCount = i + 1;
+		}
+
+		int tempSize = mRegAllocator.mNumTemps * 32;
+		int inputSaveSize = std::max(4, mReservedInputCount) * 32;
+		int callSaveSize = NumCallSlot * 32;
+		// The slots end above the 32 bytes shadow space of the called functions
+		int finalStackSize = 32 + 176 + tempSize + inputSaveSize + callSaveSize;
+
+		Asm::sub(rsp, imm32(finalStackSize));
+		mNumInstruction += 3;
+
+		for (int i = 0; i < MaxXMMStackSize; ++i)
+		{
+			int reg = 6 + i;
+			if (mRegAllocator.usedMask & (1 << reg))
+			{
+				Asm::vmovups(xmmword_ptr(rbp, -16 - (i * 16)), xmm(reg));
+				++mNumInstruction;
+			}
+		}
+
+		for (int i = 0; i < mReservedInputCount; ++i)
+		{
+			if (mRegAllocator.mInputUsed[i])
+			{
+				Asm::vmovups(ymmword_ptr(rbp, getAVXInputOffset(i)), ymm(i));
+				++mNumInstruction;
+			}
+		}
+	}
+
+	void codeConstValue(ConstValueInfo const& val)
+	{
+		checkAndLoadPrevValue();
+		mPrevValue.type = VALUE_CONST;
+		mPrevValue.idxCV = addConstValue(val);
+		mPrevValue.idxXMM = findXMMWithValue(mPrevValue);
+	}
+
+	void codeVar(VariableInfo const& varInfo)
+	{
+		checkAndLoadPrevValue();
+		mPrevValue.type = VALUE_VARIABLE;
+		mPrevValue.var = &varInfo;
+		mPrevValue.idxXMM = findXMMWithValue(mPrevValue);
+	}
+
+	void codeInput(InputInfo const& input)
+	{
+		checkAndLoadPrevValue();
+		mPrevValue.type = VALUE_INPUT;
+		mPrevValue.input = input;
+		mPrevValue.idxXMM = findXMMWithValue(mPrevValue);
+	}
+
+	void codeExprTemp(ExprTempInfo const& tempInfo)
+	{
+		checkAndLoadPrevValue();
+		mPrevValue.type = VALUE_EXPR_TEMP;
+		mPrevValue.idxTemp = tempInfo.tempIndex;
+		mPrevValue.idxXMM = findXMMWithValue(mPrevValue);
+	}
+
+	void codeStoreTemp(int16 tempIndex)
+	{
+		if (mXMMStack.empty())
+			return;
+
+		emitLoadAVXPhysicalValue(mXMMStack.back().idxXMM, ymm(SpillScratchReg));
+		Asm::vmovups(ymmword_ptr(rbp, GetTempStackOffsetAVX(tempIndex)), ymm(SpillScratchReg));
+		++mNumInstruction;
+	}
+
+	static __m256 __vectorcall AVX_Sin(__m256 v)
+	{
+		__m256 s, c;
+		sincos256_ps(v, &s, &c);
+		return s;
+	}
+	static __m256 __vectorcall AVX_Cos(__m256 v) { return cos256_ps(v); }
+	static __m256 __vectorcall AVX_Tan(__m256 v)
+	{
+		__m256 s, c;
+		sincos256_ps(v, &s, &c);
+		return _mm256_div_ps(s, c);
+	}
+	static __m256 __vectorcall AVX_Cot(__m256 v)
+	{
+		__m256 s, c;
+		sincos256_ps(v, &s, &c);
+		return _mm256_div_ps(c, s);
+	}
+	static __m256 __vectorcall AVX_Sec(__m256 v) { return _mm256_div_ps(_mm256_set1_ps(1.0f), cos256_ps(v)); }
+	static __m256 __vectorcall AVX_Csc(__m256 v) { return _mm256_div_ps(_mm256_set1_ps(1.0f), AVX_Sin(v)); }
+	static __m256 __vectorcall AVX_Exp(__m256 v) { return exp256_ps(v); }
+	static __m256 __vectorcall AVX_Log(__m256 v) { return log256_ps(v); }
+
+	static void* GetAVXFuncAddress(int id)
+	{
+		switch (id)
+		{
+		case EFuncSymbol::Exp: return (void*)&AVX_Exp;
+		case EFuncSymbol::Ln:  return (void*)&AVX_Log;
+		case EFuncSymbol::Sin: return (void*)&AVX_Sin;
+		case EFuncSymbol::Cos: return (void*)&AVX_Cos;
+		case EFuncSymbol::Tan: return (void*)&AVX_Tan;
+		case EFuncSymbol::Cot: return (void*)&AVX_Cot;
+		case EFuncSymbol::Sec: return (void*)&AVX_Sec;
+		case EFuncSymbol::Csc: return (void*)&AVX_Csc;
+		}
+		return nullptr;
+	}
+
+	void codeFunction(FuncInfo const& info)
+	{
+		checkAndLoadPrevValue();
+		int numParam = info.getArgNum();
+		if (numParam > MaxFuncArgs)
+			throw ExprParseException(EExprErrorCode::eGenerateCodeFailed, "SIMD function calls with > 4 parameters not supported in JIT");
+
+		// The scalar function is called for each lane with the arguments in the call slots
+		int numLive = (int)mXMMStack.size() - numParam;
+		for (int i = 0; i < numParam; ++i)
+		{
+			emitLoadAVXPhysicalValue(mXMMStack[numLive + i].idxXMM, ymm(InputScratchReg));
+			Asm::vmovups(ymmword_ptr(rbp, getAVXFuncArgOffset(i)), ymm(InputScratchReg));
+			++mNumInstruction;
+		}
+		for (int i = 0; i < numParam; ++i)
+		{
+			mXMMStack.pop_back();
+		}
+		uint32 spilledMask = spillLiveAcrossCall(numLive);
+
+		// The scalar code runs without the AVX-SSE transition penalty
+		Asm::vzeroupper();
+		for (int lane = 0; lane < SIMDWidth; ++lane)
+		{
+			for (int i = 0; i < numParam; ++i)
+			{
+				Asm::movss(xmm(i), dword_ptr(rbp, getAVXFuncArgOffset(i) + 4 * lane));
+			}
+			Asm::movabs(rax, (uint64)info.funcPtr);
+			Asm::call(rax);
+			Asm::movss(dword_ptr(rbp, getAVXFuncResultOffset() + 4 * lane), xmm0);
+			mNumInstruction += numParam + 3;
+		}
+
+		restoreLiveAcrossCall(spilledMask);
+
+		int resultIdx = fetchResultIndex();
+		Asm::vmovups(ymm0, ymmword_ptr(rbp, getAVXFuncResultOffset()));
+		++mNumInstruction;
+		emitStoreAVXPhysicalValue(resultIdx, ymm0);
+		pushFuncResult(resultIdx);
+	}
+
+	void codeFunction(FuncSymbolInfo const& info)
+	{
+		checkAndLoadPrevValue();
+		if (info.id == EFuncSymbol::Sqrt)
+		{
+			int argIdx = mXMMStack.back().idxXMM;
+			mXMMStack.pop_back();
+
+			int resultIdx = fetchResultIndex();
+			RegYMM resultReg = IsSlot(resultIdx) ? ymm(SpillScratchReg) : ymm(resultIdx);
+			if (IsSlot(argIdx))
+				Asm::vsqrtps(resultReg, ymmword_ptr(rbp, GetSlotOffset(argIdx)));
+			else
+				Asm::vsqrtps(resultReg, ymm(argIdx));
+			++mNumInstruction;
+			emitStoreAVXPhysicalValue(resultIdx, resultReg);
+			pushFuncResult(resultIdx);
+			return;
+		}
+
+		void* funcAddr = GetAVXFuncAddress(info.id);
+		if (!funcAddr)
+			throw ExprParseException(EExprErrorCode::eGenerateCodeFailed, "SIMD function not supported");
+
+		int numParam = info.numArgs;
+		if (numParam > MaxFuncArgs)
+			throw ExprParseException(EExprErrorCode::eGenerateCodeFailed, "SIMD function calls with > 4 parameters not supported in JIT");
+
+		int numLive = (int)mXMMStack.size() - numParam;
+		uint32 spilledMask = spillLiveAcrossCall(numLive);
+		for (int i = 0; i < numParam; ++i)
+		{
+			emitLoadAVXPhysicalValue(mXMMStack[numLive + i].idxXMM, ymm(i));
+		}
+		for (int i = 0; i < numParam; ++i)
+		{
+			mXMMStack.pop_back();
+		}
+
+		Asm::movabs(rax, (uint64)funcAddr);
+		Asm::call(rax);
+		mNumInstruction += 2;
+
+		restoreLiveAcrossCall(spilledMask);
+
+		int resultIdx = fetchResultIndex();
+		emitStoreAVXPhysicalValue(resultIdx, ymm0);
+		pushFuncResult(resultIdx);
+	}
+
+	void codeBinaryOp(TokenType opType, bool isReverse)
+	{
+		if (opType == BOP_ASSIGN)
+			throw ExprParseException(EExprErrorCode::eGenerateCodeFailed, "Assign is not supported in AVX code");
+
+		// Same operand rules as the SSE SIMD code , the three operands form writes the result to the left operand
+		int dstIdx;
+		if (IsValue(mPrevValue.type) && mPrevValue.idxXMM == INDEX_NONE)
+			dstIdx = mXMMStack.back().idxXMM;
+		else if (mPrevValue.idxXMM != INDEX_NONE)
+			dstIdx = mXMMStack.back().idxXMM;
+		else
+			dstIdx = mXMMStack[mXMMStack.size() - 2].idxXMM;
+
+		RegYMM dstReg = IsSlot(dstIdx) ? ymm(SpillScratchReg) : ymm(dstIdx);
+		if (IsSlot(dstIdx))
+		{
+			Asm::vmovups(dstReg, ymmword_ptr(rbp, GetSlotOffset(dstIdx)));
+			++mNumInstruction;
+		}
+
+		int srcIdx = INDEX_NONE;
+		if (mPrevValue.idxXMM != INDEX_NONE)
+		{
+			srcIdx = mPrevValue.idxXMM;
+		}
+		else if (IsValue(mPrevValue.type))
+		{
+			mNumInstruction += emitLoadAVXValue(mPrevValue, ymm(InputScratchReg));
+			srcIdx = InputScratchReg;
+		}
+		else
+		{
+			srcIdx = mXMMStack.back().idxXMM;
+			mXMMStack.pop_back();
+		}
+
+		bool bReverse = isReverse && (opType == BOP_SUB || opType == BOP_DIV);
+		if (IsSlot(srcIdx) && bReverse)
+		{
+			Asm::vmovups(ymm(InputScratchReg), ymmword_ptr(rbp, GetSlotOffset(srcIdx)));
+			++mNumInstruction;
+			srcIdx = InputScratchReg;
+		}
+
+		auto EmitOp = [&](auto const& src)
+		{
+			switch (opType)
+			{
+			case BOP_ADD: Asm::vaddps(dstReg, dstReg, src); break;
+			case BOP_MUL: Asm::vmulps(dstReg, dstReg, src); break;
+			case BOP_SUB: Asm::vsubps(dstReg, dstReg, src); break;
+			case BOP_DIV: Asm::vdivps(dstReg, dstReg, src); break;
+			}
+			++mNumInstruction;
+		};
+
+		if (bReverse)
+		{
+			if (opType == BOP_SUB)
+				Asm::vsubps(dstReg, ymm(srcIdx), dstReg);
+			else
+				Asm::vdivps(dstReg, ymm(srcIdx), dstReg);
+			++mNumInstruction;
+		}
+		else if (IsSlot(srcIdx))
+		{
+			EmitOp(ymmword_ptr(rbp, GetSlotOffset(srcIdx)));
+		}
+		else
+		{
+			EmitOp(ymm(srcIdx));
+		}
+
+		if (IsSlot(dstIdx))
+		{
+			Asm::vmovups(ymmword_ptr(rbp, GetSlotOffset(dstIdx)), dstReg);
+			++mNumInstruction;
+		}
+
+		// The left operand register holds the result now
+		mXMMStack.back().type = TOKEN_BINARY_OP;
+		mPrevValue.type = TOKEN_BINARY_OP;
+		mPrevValue.idxXMM = INDEX_NONE;
+	}
+
+	void codeUnaryOp(TokenType type)
+	{
+		checkAndLoadPrevValue();
+		if (type == UOP_MINS)
+		{
+			int idx = mXMMStack.back().idxXMM;
+			RegYMM reg = IsSlot(idx) ? ymm(SpillScratchReg) : ymm(idx);
+			emitLoadAVXPhysicalValue(idx, reg);
+
+			// Flip the sign bits with -0.0f
+			StackValue& constValue = mConstStack[addConstValue(ConstValueInfo(-0.0f))];
+			Asm::vbroadcastss(ymm(InputScratchReg), dword_ptr(&mConstLabel, constValue.offset));
+			Asm::vxorps(reg, reg, ymm(InputScratchReg));
+			mNumInstruction += 2;
+
+			emitStoreAVXPhysicalValue(idx, reg);
+			mXMMStack.back().type = TOKEN_UNARY_OP;
+		}
+
+		mPrevValue.type = TOKEN_FUNC;
+		mPrevValue.idxXMM = INDEX_NONE;
+	}
+
+	void codeEnd()
+	{
+		checkAndLoadPrevValue();
+
+		if (!mXMMStack.empty())
+		{
+			emitLoadAVXPhysicalValue(mXMMStack.back().idxXMM, ymm0);
+		}
+
+		for (int i = 0; i < MaxXMMStackSize; ++i)
+		{
+			int reg = 6 + i;
+			if (mRegAllocator.usedMask & (1 << reg))
+			{
+				Asm::vmovups(xmm(reg), xmmword_ptr(rbp, -16 - (i * 16)));
+				++mNumInstruction;
+			}
+		}
+
+		Asm::mov(rsp, rbp); Asm::pop(rbp); Asm::ret();
+		mNumInstruction += 3;
+
+		Asm::bind(&mConstLabel);
+		if (!mConstStorage.empty()) mData->pushCode(&mConstStorage[0], (int)mConstStorage.size());
+		Asm::reloc(mData->mCode);
+#if _DEBUG
+		mData->mNumInstruction = mNumInstruction;
+#endif
+	}
+
+	void checkAndLoadPrevValue()
+	{
+		if (!ExprParse::IsValue(mPrevValue.type))
+			return;
+
+		int idx = fetchResultIndex();
+		if (IsSlot(idx))
+		{
+			int currentReg = findXMMWithValue(mPrevValue);
+			if (currentReg == INDEX_NONE || IsSlot(currentReg))
+			{
+				mNumInstruction += emitLoadAVXValue(mPrevValue, ymm(SpillScratchReg));
+				currentReg = SpillScratchReg;
+			}
+			Asm::vmovups(ymmword_ptr(rbp, GetSlotOffset(idx)), ymm(currentReg));
+			++mNumInstruction;
+		}
+		else
+		{
+			// A value cached in another register is copied
+			mNumInstruction += emitLoadAVXValue(mPrevValue, ymm(idx));
+		}
+
+		mXMMStack.push_back(mPrevValue);
+		mXMMStack.back().idxXMM = idx;
+	}
+
+	// The scalar values are broadcast to all the lanes
+	int emitLoadAVXValue(ValueInfo const& info, RegYMM const& dst)
+	{
+		if (info.idxXMM != INDEX_NONE)
+		{
+			int numInstruction = mNumInstruction;
+			emitLoadAVXPhysicalValue(info.idxXMM, dst);
+			int result = mNumInstruction - numInstruction;
+			mNumInstruction = numInstruction;
+			return result;
+		}
+
+		switch (info.type)
+		{
+		case VALUE_VARIABLE:
+			Asm::movabs(rax, (uint64)info.var->ptr);
+			Asm::vbroadcastss(dst, dword_ptr(rax, 0));
+			return 2;
+		case VALUE_INPUT:
+			Asm::vmovups(dst, ymmword_ptr(rbp, getAVXInputOffset(info.input.index)));
+			return 1;
+		case VALUE_CONST:
+			Asm::vbroadcastss(dst, dword_ptr(&mConstLabel, mConstStack[info.idxCV].offset));
+			return 1;
+		case VALUE_EXPR_TEMP:
+			Asm::vmovups(dst, ymmword_ptr(rbp, GetTempStackOffsetAVX(info.idxTemp)));
+			return 1;
+		}
+		return 0;
+	}
+};
+
 #endif // TARGET_PLATFORM_64BITS
 #endif
@@ -177,6 +177,19 @@ namespace Asmeta
 		uint8 mIndex;
 	};
 
+	// YMM register class for AVX operations , the low 128 bits are the XMM register of the same index
+	class RegYMM
+	{
+	public:
+		RegYMM(uint8 idx) : mIndex(idx) {}
+		uint8 index() const { return mIndex; }
+		bool isExtended() const { return mIndex >= 8; }
+		uint8 lowBits() const { return mIndex & 0x7; }
+		RegXMM xmm() const { return RegXMM(mIndex); }
+	private:
+		uint8 mIndex;
+	};
+
 	enum CondTestField
 	{
 		CTF_O  = 0x0 , CTF_NO  = 0x1 , CTF_B  = 0x2 , CTF_NB  = 0x3, 
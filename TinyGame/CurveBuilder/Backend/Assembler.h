@@ -141,6 +141,29 @@ namespace Asmeta
 
 	ASMETA_INLINE RegXMM xmm(uint8 idx) { assert(idx < 16); return RegXMM(idx); }
 
+	// YMM registers (AVX)
+	RegYMM const ymm0 = RegYMM(0);
+	RegYMM const ymm1 = RegYMM(1);
+	RegYMM const ymm2 = RegYMM(2);
+	RegYMM const ymm3 = RegYMM(3);
+	RegYMM const ymm4 = RegYMM(4);
+	RegYMM const ymm5 = RegYMM(5);
+	RegYMM const ymm6 = RegYMM(6);
+	RegYMM const ymm7 = RegYMM(7);
+
+#if TARGET_PLATFORM_64BITS
+	RegYMM const ymm8 = RegYMM(8);
+	RegYMM const ymm9 = RegYMM(9);
+	RegYMM const ymm10 = RegYMM(10);
+	RegYMM const ymm11 = RegYMM(11);
+	RegYMM const ymm12 = RegYMM(12);
+	RegYMM const ymm13 = RegYMM(13);
+	RegYMM const ymm14 = RegYMM(14);
+	RegYMM const ymm15 = RegYMM(15);
+#endif
+
+	ASMETA_INLINE RegYMM ymm(uint8 idx) { assert(idx < 16); return RegYMM(idx); }
+
 
 #define DEF_REF_MEM( Type , Param , InputRef )\
 	ASMETA_INLINE RefMem< Type , 0 >  ptr      ( Param ){ return RefMem< Type , 0 >( InputRef );  }\
@@ -237,6 +260,8 @@ namespace Asmeta
 	ASMETA_INLINE RefMem< RegPtr64 , 10 > tword_ptr( Reg64 const& base , Reg64 const& index , uint8 shift ){ return RefMem< RegPtr64 , 10 >( RegPtr64( base , index , shift ) );  }
 	ASMETA_INLINE RefMem< RegPtr64 , 16 > xmmword_ptr(Reg64 const& base, int32 disp) { return RefMem< RegPtr64 , 16 >(RegPtr64(base, disp)); }
 	ASMETA_INLINE RefMem< RegPtr64 , 16 > xmmword_ptr(Reg64 const& base, Reg64 const& index, uint8 shift, int32 disp) { return RefMem< RegPtr64 , 16 >(RegPtr64(base, index, shift, disp)); }
+	ASMETA_INLINE RefMem< RegPtr64 , 32 > ymmword_ptr(Reg64 const& base, int32 disp) { return RefMem< RegPtr64 , 32 >(RegPtr64(base, disp)); }
+	ASMETA_INLINE RefMem< RegPtr64 , 32 > ymmword_ptr(Reg64 const& base, Reg64 const& index, uint8 shift, int32 disp) { return RefMem< RegPtr64 , 32 >(RegPtr64(base, index, shift, disp)); }
 #endif
 
 #if TARGET_PLATFORM_64BITS
@@ -258,6 +283,8 @@ namespace Asmeta
 
 	ASMETA_INLINE RefMem< LabelPtr , 16 > xmmword_ptr(Label* label, int32 offset) { return RefMem< LabelPtr , 16 >(LabelPtr(label, offset)); }
 	ASMETA_INLINE RefMem< RegPtr , 16 > xmmword_ptr(Reg32 const& base, int32 disp) { return RefMem< RegPtr , 16 >(RegPtr(base, disp)); }
+	ASMETA_INLINE RefMem< LabelPtr , 32 > ymmword_ptr(Label* label, int32 offset) { return RefMem< LabelPtr , 32 >(LabelPtr(label, offset)); }
+	ASMETA_INLINE RefMem< RegPtr , 32 > ymmword_ptr(Reg32 const& base, int32 disp) { return RefMem< RegPtr , 32 >(RegPtr(base, disp)); }
 
 	ASMETA_INLINE Immediate< 4 > imm32( int32 val ){ return Immediate< 4 >( val , true ); }
 	ASMETA_INLINE Immediate< 2 > imm16( int16 val ){ return Immediate< 2 >( val , true ); }
@@ -1742,6 +1769,156 @@ namespace Asmeta
 			encodeSSE(SSE_PREFIX_66, 0x0F, 0xEF, dst, src);
 		}
 
+		//=============================================================================
+		// AVX Instructions (VEX encoded)
+		//=============================================================================
+		// VEX.pp field and the opcode map of VEX.mmmmm
+		static constexpr uint8 VEX_PP_NONE = 0;
+		static constexpr uint8 VEX_PP_66 = 1;
+		static constexpr uint8 VEX_PP_F3 = 2;
+		static constexpr uint8 VEX_PP_F2 = 3;
+		static constexpr uint8 VEX_MAP_0F = 1;
+		static constexpr uint8 VEX_MAP_0F38 = 2;
+		static constexpr uint8 VEX_MAP_0F3A = 3;
+
+		//-----------------------------------------------------------------------------
+		// VMOVUPS - Move Unaligned Packed Single (256 bits)
+		//-----------------------------------------------------------------------------
+		ASMETA_INLINE void vmovups(RegYMM const& dst, RegYMM const& src)
+		{
+			encodeVEX(VEX_PP_NONE, VEX_MAP_0F, 1, 0x10, dst.index(), 0, src.index());
+		}
+		template< class Ref >
+		ASMETA_INLINE void vmovups(RegYMM const& dst, RefMem< Ref, 32 > const& src)
+		{
+			encodeVEXMem(VEX_PP_NONE, VEX_MAP_0F, 1, 0x10, dst.index(), 0, src);
+		}
+		template< class Ref >
+		ASMETA_INLINE void vmovups(RefMem< Ref, 32 > const& dst, RegYMM const& src)
+		{
+			encodeVEXMem(VEX_PP_NONE, VEX_MAP_0F, 1, 0x11, src.index(), 0, dst);
+		}
+		// vmovups xmm, m128 - The VEX form zeroes the upper bits of the YMM register
+		template< class Ref >
+		ASMETA_INLINE void vmovups(RegXMM const& dst, RefMem< Ref, 16 > const& src)
+		{
+			encodeVEXMem(VEX_PP_NONE, VEX_MAP_0F, 0, 0x10, dst.index(), 0, src);
+		}
+		template< class Ref >
+		ASMETA_INLINE void vmovups(RefMem< Ref, 16 > const& dst, RegXMM const& src)
+		{
+			encodeVEXMem(VEX_PP_NONE, VEX_MAP_0F, 0, 0x11, src.index(), 0, dst);
+		}
+
+		//-----------------------------------------------------------------------------
+		// VMOVSS - Move Scalar Single , the upper bits of the destination register are zeroed
+		//-----------------------------------------------------------------------------
+		template< class Ref >
+		ASMETA_INLINE void vmovss(RegXMM const& dst, RefMem< Ref, 4 > const& src)
+		{
+			encodeVEXMem(VEX_PP_F3, VEX_MAP_0F, 0, 0x10, dst.index(), 0, src);
+		}
+		template< class Ref >
+		ASMETA_INLINE void vmovss(RefMem< Ref, 4 > const& dst, RegXMM const& src)
+		{
+			encodeVEXMem(VEX_PP_F3, VEX_MAP_0F, 0, 0x11, src.index(), 0, dst);
+		}
+
+		//-----------------------------------------------------------------------------
+		// VBROADCASTSS - Broadcast a m32 float to all 8 lanes
+		//-----------------------------------------------------------------------------
+		template< class Ref >
+		ASMETA_INLINE void vbroadcastss(RegYMM const& dst, RefMem< Ref, 4 > const& src)
+		{
+			encodeVEXMem(VEX_PP_66, VEX_MAP_0F38, 1, 0x18, dst.index(), 0, src);
+		}
+
+		//-----------------------------------------------------------------------------
+		// AVX Arithmetic - Packed Single (dst = src1 op src2)
+		//-----------------------------------------------------------------------------
+#define DEF_AVX_ARITH_PS(NAME, OPCODE) \
+		ASMETA_INLINE void NAME(RegYMM const& dst, RegYMM const& src1, RegYMM const& src2) { encodeVEX(VEX_PP_NONE, VEX_MAP_0F, 1, OPCODE, dst.index(), src1.index(), src2.index()); } \
+		template< class Ref > ASMETA_INLINE void NAME(RegYMM const& dst, RegYMM const& src1, RefMem< Ref, 32 > const& src2) { encodeVEXMem(VEX_PP_NONE, VEX_MAP_0F, 1, OPCODE, dst.index(), src1.index(), src2); }
+
+		DEF_AVX_ARITH_PS(vaddps, 0x58)
+		DEF_AVX_ARITH_PS(vsubps, 0x5C)
+		DEF_AVX_ARITH_PS(vmulps, 0x59)
+		DEF_AVX_ARITH_PS(vdivps, 0x5E)
+		DEF_AVX_ARITH_PS(vminps, 0x5D)
+		DEF_AVX_ARITH_PS(vmaxps, 0x5F)
+		DEF_AVX_ARITH_PS(vxorps, 0x57)
+		DEF_AVX_ARITH_PS(vandps, 0x54)
+		DEF_AVX_ARITH_PS(vorps, 0x56)
+
+#undef DEF_AVX_ARITH_PS
+
+		// vsqrtps ymm, ymm/m256 - VEX.vvvv is unused
+		ASMETA_INLINE void vsqrtps(RegYMM const& dst, RegYMM const& src)
+		{
+			encodeVEX(VEX_PP_NONE, VEX_MAP_0F, 1, 0x51, dst.index(), 0, src.index());
+		}
+		template< class Ref >
+		ASMETA_INLINE void vsqrtps(RegYMM const& dst, RefMem< Ref, 32 > const& src)
+		{
+			encodeVEXMem(VEX_PP_NONE, VEX_MAP_0F, 1, 0x51, dst.index(), 0, src);
+		}
+
+		// vzeroupper - Avoid the AVX-SSE transition penalty before calling SSE code
+		ASMETA_INLINE void vzeroupper()
+		{
+			encodeVEXPrefix(VEX_PP_NONE, VEX_MAP_0F, 0, 0, 0, 0, 0, 0);
+			_this()->emitByte(0x77);
+		}
+
+	protected:
+		//-----------------------------------------------------------------------------
+		// VEX Encoding Helpers
+		//-----------------------------------------------------------------------------
+
+		// The R X B bits extend ModRM.reg , SIB.index and ModRM.rm , vvvv is the extra source register.
+		// All the bits are stored inverted , the 2 bytes form is used when X B W are zero and the map is 0F.
+		ASMETA_INLINE void encodeVEXPrefix(uint8 pp, uint8 map, uint8 w, uint8 l, uint8 r, uint8 x, uint8 b, uint8 vvvv)
+		{
+			uint8 tail = uint8(((~vvvv & 0xf) << 3) | (l << 2) | pp);
+			if (map == VEX_MAP_0F && w == 0 && x == 0 && b == 0)
+			{
+				_this()->emitByte(0xC5);
+				_this()->emitByte(uint8(((r ^ 1) << 7) | tail));
+			}
+			else
+			{
+				_this()->emitByte(0xC4);
+				_this()->emitByte(uint8(((r ^ 1) << 7) | ((x ^ 1) << 6) | ((b ^ 1) << 5) | map));
+				_this()->emitByte(uint8((w << 7) | tail));
+			}
+		}
+
+		// Encode VEX instruction: reg, vvvv, reg
+		ASMETA_INLINE void encodeVEX(uint8 pp, uint8 map, uint8 l, uint8 opcode, uint8 reg, uint8 vvvv, uint8 rm)
+		{
+			encodeVEXPrefix(pp, map, 0, l, reg >> 3, 0, rm >> 3, vvvv);
+			_this()->emitByte(opcode);
+			_this()->emitByte(MOD_RM_BYTE(MOD_R, reg & 0x7, rm & 0x7));
+		}
+
+		// Encode VEX instruction: reg, vvvv, m
+		template< class Ref, int Size >
+		ASMETA_INLINE void encodeVEXMem(uint8 pp, uint8 map, uint8 l, uint8 opcode, uint8 reg, uint8 vvvv, RefMem< Ref, Size > const& mem)
+		{
+			uint8 x = 0;
+			uint8 b = 0;
+#if TARGET_PLATFORM_64BITS
+			if constexpr (std::is_same_v<Ref, RegPtr64>)
+			{
+				x = mem.reference().mREX_X;
+				b = mem.reference().mREX_B;
+			}
+#endif
+			encodeVEXPrefix(pp, map, 0, l, reg >> 3, x, b, vvvv);
+			_this()->emitByte(opcode);
+			encodeModRM(mem.reference(), reg & 0x7);
+		}
+
 	protected:
 		//-----------------------------------------------------------------------------
 		// SSE Encoding Helpers
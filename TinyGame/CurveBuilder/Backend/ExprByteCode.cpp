@@ -3,6 +3,9 @@
 #include "Misc/DuffDevice.h"
 #include "Meta/IndexList.h"
 
+#include <algorithm>
+#include <cmath>
+
 
 constexpr int GetOpCmdSizeConstexpr(EExprByteCode::Type op)
 {
@@ -1312,8 +1315,8 @@ FORCEINLINE int TByteCodeExecutor<TValue>::execCode(uint8 const* __restrict pCod
 			void* funcPtr = mExecData->pointers[pCode[1]];
 
 			*pValueStack = topValue;
-			topValue = Invoke(static_cast<FuncType2>(funcPtr), pValueStack);
 			pValueStack -= 1;
+			topValue = Invoke(static_cast<FuncType2>(funcPtr), pValueStack);
 		}
 		return 2;
 #endif
@@ -1322,8 +1325,8 @@ FORCEINLINE int TByteCodeExecutor<TValue>::execCode(uint8 const* __restrict pCod
 		{
 			void* funcPtr = mExecData->pointers[pCode[1]];
 			*pValueStack = topValue;
-			topValue = Invoke(static_cast<FuncType3>(funcPtr), pValueStack);
 			pValueStack -= 2;
+			topValue = Invoke(static_cast<FuncType3>(funcPtr), pValueStack);
 		}
 		return 2;
 #endif
@@ -1332,8 +1335,8 @@ FORCEINLINE int TByteCodeExecutor<TValue>::execCode(uint8 const* __restrict pCod
 		{
 			void* funcPtr = mExecData->pointers[pCode[1]];
 			*pValueStack = topValue;
-			topValue = Invoke(static_cast<FuncType4>(funcPtr), pValueStack);
 			pValueStack -= 3;
+			topValue = Invoke(static_cast<FuncType4>(funcPtr), pValueStack);
 		}
 		return 2;
 #endif
@@ -1342,8 +1345,8 @@ FORCEINLINE int TByteCodeExecutor<TValue>::execCode(uint8 const* __restrict pCod
 		{
 			void* funcPtr = mExecData->pointers[pCode[1]];
 			*pValueStack = topValue;
-			topValue = Invoke(static_cast<FuncType5>(funcPtr), pValueStack);
 			pValueStack -= 4;
+			topValue = Invoke(static_cast<FuncType5>(funcPtr), pValueStack);
 		}
 		return 2;
 #endif
@@ -1355,3 +1358,434 @@ template RealType TByteCodeExecutor<RealType>::doExecute(ExprByteCodeExecData co
 template FloatVector TByteCodeExecutor<FloatVector>::doExecute(ExprByteCodeExecData const& code);
 template double TByteCodeExecutor<double>::doExecute(ExprByteCodeExecData const& code);
 
+
+#if EBC_USE_BATCH_EXECUTE
+
+#define BATCH_OP_LIST(op)\
+	op(Input) op(Store)\
+	op(Add) op(IAdd) op(Sub) op(ISub) op(SubR) op(ISubR) op(Mul) op(IMul) op(Div) op(IDiv) op(DivR) op(IDivR) op(Mins)\
+	op(SMul) op(SMulAdd) op(SMulSub) op(SMulMul) op(SMulDiv)\
+	op(ISMul) op(ISMulAdd) op(ISMulSub) op(ISMulMul) op(ISMulDiv)\
+	op(IIAdd) op(IISub) op(IIMul) op(IIDiv)\
+	op(MulAdd) op(IMulAdd) op(AddMul) op(IAddMul) op(MulSub) op(IMulSub)\
+	op(FuncCall0) op(FuncCall1) op(FuncCall2) op(FuncCall3) op(FuncCall4) op(FuncCall5)
+
+static int GetBatchStackOffset(EExprByteCode::Type op)
+{
+	switch (op)
+	{
+	case EExprByteCode::Input:
+	case EExprByteCode::ISMul:
+	case EExprByteCode::IIAdd:
+	case EExprByteCode::IISub:
+	case EExprByteCode::IIMul:
+	case EExprByteCode::IIDiv:
+	case EExprByteCode::FuncCall0:
+		return 1;
+	case EExprByteCode::Add:
+	case EExprByteCode::Sub:
+	case EExprByteCode::SubR:
+	case EExprByteCode::Mul:
+	case EExprByteCode::Div:
+	case EExprByteCode::DivR:
+	case EExprByteCode::SMulAdd:
+	case EExprByteCode::SMulSub:
+	case EExprByteCode::SMulMul:
+	case EExprByteCode::SMulDiv:
+	case EExprByteCode::IMulAdd:
+	case EExprByteCode::IMulSub:
+	case EExprByteCode::IAddMul:
+	case EExprByteCode::FuncCall2:
+		return -1;
+	case EExprByteCode::MulAdd:
+	case EExprByteCode::MulSub:
+	case EExprByteCode::AddMul:
+	case EExprByteCode::FuncCall3:
+		return -2;
+	case EExprByteCode::FuncCall4:
+		return -3;
+	case EExprByteCode::FuncCall5:
+		return -4;
+	}
+	return 0;
+}
+
+ExprByteCodeBatchExecutor::ExprByteCodeBatchExecutor(ExprByteCodeExecData const& execData)
+	:mExecData(execData)
+{
+	mCodes = execData.codes;
+	int depth = 0;
+	int maxDepth = 0;
+	for (int pos = 0; pos < mCodes.size(); pos += GetNextOpCmdOffset(EExprByteCode::Type(mCodes[pos])))
+	{
+		depth += GetBatchStackOffset(EExprByteCode::Type(mCodes[pos]));
+		maxDepth = std::max(maxDepth, depth);
+	}
+	for (int i = 0; i < EBC_MAX_OP_CMD_SZIE; ++i)
+	{
+		mCodes.push_back(EExprByteCode::None);
+	}
+
+	mNumSlot = execData.getValueBufferSize();
+	mBlocks.resize((mNumSlot + maxDepth + 1) * BatchSize);
+	mSlots.resize(mNumSlot);
+	for (int i = 0; i < mNumSlot; ++i)
+	{
+		mSlots[i] = getBlock(i);
+	}
+	mStack.resize(maxDepth + 1);
+
+	for (int i = 0; i < execData.constValues.size(); ++i)
+	{
+		RealType* block = getBlock(execData.numInput + i);
+		std::fill(block, block + BatchSize, execData.constValues[i]);
+	}
+}
+
+void ExprByteCodeBatchExecutor::execute(RealType const* const inputs[], RealType* output, int numSample)
+{
+	int numInput = mExecData.numInput;
+	int varOffset = numInput + mExecData.constValues.size();
+	for (int i = 0; i < mExecData.vars.size(); ++i)
+	{
+		RealType* block = getBlock(varOffset + i);
+		std::fill(block, block + BatchSize, *mExecData.vars[i]);
+	}
+
+	int index = 0;
+	for (; index + BatchSize <= numSample; index += BatchSize)
+	{
+		for (int i = 0; i < numInput; ++i)
+		{
+			mSlots[i] = inputs[i] + index;
+		}
+		RealType const* result = executeBlock();
+		std::copy(result, result + BatchSize, output + index);
+	}
+
+	if (index < numSample)
+	{
+		//Copy the rest samples to the input blocks , the ops always run over a full block
+		int num = numSample - index;
+		for (int i = 0; i < numInput; ++i)
+		{
+			RealType* block = getBlock(i);
+			std::copy(inputs[i] + index, inputs[i] + numSample, block);
+			std::fill(block + num, block + BatchSize, RealType(0));
+			mSlots[i] = block;
+		}
+		RealType const* result = executeBlock();
+		std::copy(result, result + num, output + index);
+	}
+}
+
+RealType const* ExprByteCodeBatchExecutor::executeBlock()
+{
+	RealType const* const* slots = mSlots.data();
+	RealType const** stack = mStack.data();
+	RealType* stackBlocks = getBlock(mNumSlot);
+	void* const* pointers = mExecData.pointers.data();
+	uint8 const* pCode = mCodes.data();
+
+	//The values pushed to the stack are stack[0, depth) , the result of an op is written to the block of the depth
+	int depth = 0;
+	RealType const* top = nullptr;
+
+	auto PushTop = [&]()
+	{
+		stack[depth] = top;
+		++depth;
+	};
+	auto Apply1 = [&](RealType const* a, auto&& op)
+	{
+		RealType* out = stackBlocks + depth * BatchSize;
+		for (int i = 0; i < BatchSize; ++i)
+			out[i] = op(a[i]);
+		top = out;
+	};
+	auto Apply2 = [&](RealType const* a, RealType const* b, auto&& op)
+	{
+		RealType* out = stackBlocks + depth * BatchSize;
+		for (int i = 0; i < BatchSize; ++i)
+			out[i] = op(a[i], b[i]);
+		top = out;
+	};
+	auto Apply3 = [&](RealType const* a, RealType const* b, RealType const* c, auto&& op)
+	{
+		RealType* out = stackBlocks + depth * BatchSize;
+		for (int i = 0; i < BatchSize; ++i)
+			out[i] = op(a[i], b[i], c[i]);
+		top = out;
+	};
+
+	auto Add = [](RealType a, RealType b) { return a + b; };
+	auto Sub = [](RealType a, RealType b) { return a - b; };
+	auto Mul = [](RealType a, RealType b) { return a * b; };
+	auto Div = [](RealType a, RealType b) { return a / b; };
+
+#define GET_SLOT(CODE) slots[CODE]
+
+#if EBC_USE_COMPUTED_GOTO
+	//Unknown codes end the execution like the None code
+	void* dispatchTable[EExprByteCode::COUNT];
+	for (auto& label : dispatchTable)
+	{
+		label = &&Op_None;
+	}
+#define SET_OP_LABEL(NAME) dispatchTable[EExprByteCode::NAME] = &&Op_##NAME;
+	BATCH_OP_LIST(SET_OP_LABEL)
+#undef SET_OP_LABEL
+#define SET_FUNC_LABEL(SYMBOL, NAME, NUM_ARG) dispatchTable[EExprByteCode::FuncSymbol + EFuncSymbol::SYMBOL] = &&Op_Func##SYMBOL;
+	DEFAULT_FUNC_SYMBOL_LIST(SET_FUNC_LABEL)
+#undef SET_FUNC_LABEL
+
+#define BATCH_OP(NAME) Op_##NAME:
+#define BATCH_FUNC_OP(SYMBOL) Op_Func##SYMBOL:
+#define BATCH_NEXT() pCode += GetNextOpCmdOffset(EExprByteCode::Type(*pCode)); goto *dispatchTable[*pCode]
+
+	goto *dispatchTable[*pCode];
+#else
+#define BATCH_OP(NAME) case EExprByteCode::NAME:
+#define BATCH_FUNC_OP(SYMBOL) case EExprByteCode::FuncSymbol + EFuncSymbol::SYMBOL:
+#define BATCH_NEXT() pCode += GetNextOpCmdOffset(EExprByteCode::Type(*pCode)); continue
+
+	for (;;)
+	{
+		switch (*pCode)
+		{
+#endif
+
+	BATCH_OP(Input)
+		PushTop();
+		top = GET_SLOT(pCode[1]);
+		BATCH_NEXT();
+	BATCH_OP(Store)
+		std::copy(top, top + BatchSize, getBlock(pCode[1]));
+		BATCH_NEXT();
+
+	BATCH_OP(Add)
+		--depth;
+		Apply2(stack[depth], top, Add);
+		BATCH_NEXT();
+	BATCH_OP(IAdd)
+		Apply2(top, GET_SLOT(pCode[1]), Add);
+		BATCH_NEXT();
+	BATCH_OP(Sub)
+		--depth;
+		Apply2(stack[depth], top, Sub);
+		BATCH_NEXT();
+	BATCH_OP(ISub)
+		Apply2(top, GET_SLOT(pCode[1]), Sub);
+		BATCH_NEXT();
+	BATCH_OP(SubR)
+		--depth;
+		Apply2(top, stack[depth], Sub);
+		BATCH_NEXT();
+	BATCH_OP(ISubR)
+		Apply2(GET_SLOT(pCode[1]), top, Sub);
+		BATCH_NEXT();
+	BATCH_OP(Mul)
+		--depth;
+		Apply2(stack[depth], top, Mul);
+		BATCH_NEXT();
+	BATCH_OP(IMul)
+		Apply2(top, GET_SLOT(pCode[1]), Mul);
+		BATCH_NEXT();
+	BATCH_OP(Div)
+		--depth;
+		Apply2(stack[depth], top, Div);
+		BATCH_NEXT();
+	BATCH_OP(IDiv)
+		Apply2(top, GET_SLOT(pCode[1]), Div);
+		BATCH_NEXT();
+	BATCH_OP(DivR)
+		--depth;
+		Apply2(top, stack[depth], Div);
+		BATCH_NEXT();
+	BATCH_OP(IDivR)
+		Apply2(GET_SLOT(pCode[1]), top, Div);
+		BATCH_NEXT();
+	BATCH_OP(Mins)
+		Apply1(top, [](RealType a) { return -a; });
+		BATCH_NEXT();
+
+	BATCH_OP(SMul)
+		Apply1(top, [](RealType a) { return a * a; });
+		BATCH_NEXT();
+	BATCH_OP(SMulAdd)
+		--depth;
+		Apply2(stack[depth], top, [](RealType l, RealType a) { return l + a * a; });
+		BATCH_NEXT();
+	BATCH_OP(SMulSub)
+		--depth;
+		Apply2(stack[depth], top, [](RealType l, RealType a) { return l - a * a; });
+		BATCH_NEXT();
+	BATCH_OP(SMulMul)
+		--depth;
+		Apply2(stack[depth], top, [](RealType l, RealType a) { return l * (a * a); });
+		BATCH_NEXT();
+	BATCH_OP(SMulDiv)
+		--depth;
+		Apply2(stack[depth], top, [](RealType l, RealType a) { return l / (a * a); });
+		BATCH_NEXT();
+
+	BATCH_OP(ISMul)
+		PushTop();
+		Apply1(GET_SLOT(pCode[1]), [](RealType a) { return a * a; });
+		BATCH_NEXT();
+	BATCH_OP(ISMulAdd)
+		Apply2(top, GET_SLOT(pCode[1]), [](RealType l, RealType a) { return l + a * a; });
+		BATCH_NEXT();
+	BATCH_OP(ISMulSub)
+		Apply2(top, GET_SLOT(pCode[1]), [](RealType l, RealType a) { return l - a * a; });
+		BATCH_NEXT();
+	BATCH_OP(ISMulMul)
+		Apply2(top, GET_SLOT(pCode[1]), [](RealType l, RealType a) { return l * (a * a); });
+		BATCH_NEXT();
+	BATCH_OP(ISMulDiv)
+		Apply2(top, GET_SLOT(pCode[1]), [](RealType l, RealType a) { return l / (a * a); });
+		BATCH_NEXT();
+
+	BATCH_OP(IIAdd)
+		PushTop();
+		Apply2(GET_SLOT(pCode[1]), GET_SLOT(pCode[2]), Add);
+		BATCH_NEXT();
+	BATCH_OP(IISub)
+		PushTop();
+		Apply2(GET_SLOT(pCode[1]), GET_SLOT(pCode[2]), Sub);
+		BATCH_NEXT();
+	BATCH_OP(IIMul)
+		PushTop();
+		Apply2(GET_SLOT(pCode[1]), GET_SLOT(pCode[2]), Mul);
+		BATCH_NEXT();
+	BATCH_OP(IIDiv)
+		PushTop();
+		Apply2(GET_SLOT(pCode[1]), GET_SLOT(pCode[2]), Div);
+		BATCH_NEXT();
+
+	BATCH_OP(MulAdd)
+		depth -= 2;
+		Apply3(stack[depth], top, stack[depth + 1], [](RealType l, RealType a, RealType r) { return l + a * r; });
+		BATCH_NEXT();
+	BATCH_OP(IMulAdd)
+		--depth;
+		Apply3(stack[depth], top, GET_SLOT(pCode[1]), [](RealType l, RealType a, RealType r) { return l + a * r; });
+		BATCH_NEXT();
+	BATCH_OP(MulSub)
+		depth -= 2;
+		Apply3(stack[depth], top, stack[depth + 1], [](RealType l, RealType a, RealType r) { return l - a * r; });
+		BATCH_NEXT();
+	BATCH_OP(IMulSub)
+		--depth;
+		Apply3(stack[depth], top, GET_SLOT(pCode[1]), [](RealType l, RealType a, RealType r) { return l - a * r; });
+		BATCH_NEXT();
+	BATCH_OP(AddMul)
+		depth -= 2;
+		Apply3(stack[depth], top, stack[depth + 1], [](RealType l, RealType a, RealType r) { return l * (a + r); });
+		BATCH_NEXT();
+	BATCH_OP(IAddMul)
+		--depth;
+		Apply3(stack[depth], top, GET_SLOT(pCode[1]), [](RealType l, RealType a, RealType r) { return l * (a + r); });
+		BATCH_NEXT();
+
+	BATCH_FUNC_OP(Exp)
+		Apply1(top, [](RealType a) { return std::exp(a); });
+		BATCH_NEXT();
+	BATCH_FUNC_OP(Ln)
+		Apply1(top, [](RealType a) { return std::log(a); });
+		BATCH_NEXT();
+	BATCH_FUNC_OP(Sin)
+		Apply1(top, [](RealType a) { return std::sin(a); });
+		BATCH_NEXT();
+	BATCH_FUNC_OP(Cos)
+		Apply1(top, [](RealType a) { return std::cos(a); });
+		BATCH_NEXT();
+	BATCH_FUNC_OP(Tan)
+		Apply1(top, [](RealType a) { return std::tan(a); });
+		BATCH_NEXT();
+	BATCH_FUNC_OP(Cot)
+		Apply1(top, [](RealType a) { return RealType(1) / std::tan(a); });
+		BATCH_NEXT();
+	BATCH_FUNC_OP(Sec)
+		Apply1(top, [](RealType a) { return RealType(1) / std::cos(a); });
+		BATCH_NEXT();
+	BATCH_FUNC_OP(Csc)
+		Apply1(top, [](RealType a) { return RealType(1) / std::sin(a); });
+		BATCH_NEXT();
+	BATCH_FUNC_OP(Sqrt)
+		Apply1(top, [](RealType a) { return std::sqrt(a); });
+		BATCH_NEXT();
+
+	BATCH_OP(FuncCall0)
+		{
+			PushTop();
+			auto func = static_cast<FuncType0>(pointers[pCode[1]]);
+			RealType* out = stackBlocks + depth * BatchSize;
+			for (int i = 0; i < BatchSize; ++i)
+				out[i] = (*func)();
+			top = out;
+		}
+		BATCH_NEXT();
+	BATCH_OP(FuncCall1)
+		{
+			auto func = static_cast<FuncType1>(pointers[pCode[1]]);
+			Apply1(top, [func](RealType a) { return (*func)(a); });
+		}
+		BATCH_NEXT();
+	BATCH_OP(FuncCall2)
+		{
+			auto func = static_cast<FuncType2>(pointers[pCode[1]]);
+			--depth;
+			Apply2(stack[depth], top, [func](RealType a, RealType b) { return (*func)(a, b); });
+		}
+		BATCH_NEXT();
+	BATCH_OP(FuncCall3)
+		{
+			auto func = static_cast<FuncType3>(pointers[pCode[1]]);
+			depth -= 2;
+			Apply3(stack[depth], stack[depth + 1], top, [func](RealType a, RealType b, RealType c) { return (*func)(a, b, c); });
+		}
+		BATCH_NEXT();
+	BATCH_OP(FuncCall4)
+		{
+			auto func = static_cast<FuncType4>(pointers[pCode[1]]);
+			depth -= 3;
+			RealType const* const* args = stack + depth;
+			RealType* out = stackBlocks + depth * BatchSize;
+			for (int i = 0; i < BatchSize; ++i)
+				out[i] = (*func)(args[0][i], args[1][i], args[2][i], top[i]);
+			top = out;
+		}
+		BATCH_NEXT();
+	BATCH_OP(FuncCall5)
+		{
+			auto func = static_cast<FuncType5>(pointers[pCode[1]]);
+			depth -= 4;
+			RealType const* const* args = stack + depth;
+			RealType* out = stackBlocks + depth * BatchSize;
+			for (int i = 0; i < BatchSize; ++i)
+				out[i] = (*func)(args[0][i], args[1][i], args[2][i], args[3][i], top[i]);
+			top = out;
+		}
+		BATCH_NEXT();
+
+	BATCH_OP(None)
+#if !EBC_USE_COMPUTED_GOTO
+		default:
+#endif
+		return top;
+
+#if !EBC_USE_COMPUTED_GOTO
+		}
+	}
+#endif
+
+#undef BATCH_OP
+#undef BATCH_FUNC_OP
+#undef BATCH_NEXT
+#undef GET_SLOT
+}
+
+#undef BATCH_OP_LIST
+
+#endif
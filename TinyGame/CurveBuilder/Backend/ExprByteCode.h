@@ -15,6 +15,15 @@
 #define EBC_USE_LAZY_STACK_PUSH 1
 #define EBC_MAX_FUNC_ARG_NUM 5
 
+//The batch executor runs the codes of the value buffer mode with the merged ops
+#define EBC_USE_BATCH_EXECUTE (EBC_USE_VALUE_BUFFER && EBC_USE_COMPOSITIVE_CODE_LEVEL >= 2 && EBC_MAX_OP_CMD_SZIE >= 3 && EBC_MAX_FUNC_ARG_NUM >= 5)
+#define EBC_BATCH_SIZE 128
+#if defined(__GNUC__) || defined(__clang__)
+#define EBC_USE_COMPUTED_GOTO 1
+#else
+#define EBC_USE_COMPUTED_GOTO 0
+#endif
+
 namespace EExprByteCode
 {
 	enum Type : uint8
@@ -159,13 +168,19 @@ struct ExprByteCodeExecData
 	int               numTemp;
 	TArray<RealType*> vars;
 
+	// inputs , constants , variables and temps
+	int getValueBufferSize() const
+	{
+		return numInput + constValues.size() + vars.size() + numTemp;
+	}
+
 	template< typename T >
-	void initValueBuffer(T buffer[])
+	void initValueBuffer(T buffer[]) const
 	{
 		std::copy(constValues.begin(), constValues.end(), buffer + numInput);
 
 		T* pValue = buffer + numInput + constValues.size();
-		RealType** pVar = vars.data();
+		RealType* const* pVar = vars.data();
 		for (int i = vars.size(); i; --i)
 		{
 			*pValue = **pVar;
@@ -187,6 +202,12 @@ struct ExprByteCodeExecData
 	}
 };
 
+//The same codes executed by ExprByteCodeBatchExecutor
+struct ExprByteCodeBatchExecData : ExprByteCodeExecData
+{
+
+};
+
 struct ExprByteCodeCompiler : public TCodeGenerator<ExprByteCodeCompiler>
 {
 	ExprByteCodeExecData& mOutput;
@@ -347,4 +368,32 @@ private:
 	TArrayView<TValue const> mInputs;
 };
 
+#if EBC_USE_BATCH_EXECUTE
+// Execute the codes over a block of EBC_BATCH_SIZE samples at a time , the stack values and the value buffer are
+// arrays of the block. The dispatch cost is shared by the samples of the block and the op loops can be vectorized.
+class ExprByteCodeBatchExecutor
+{
+public:
+	static int constexpr BatchSize = EBC_BATCH_SIZE;
+
+	ExprByteCodeBatchExecutor(ExprByteCodeExecData const& execData);
+
+	//inputs[i] points to the numSample values of the input i
+	void execute(RealType const* const inputs[], RealType* output, int numSample);
+
+private:
+	RealType const* executeBlock();
+	RealType* getBlock(int index) { return mBlocks.data() + index * BatchSize; }
+
+	ExprByteCodeExecData const& mExecData;
+	//The codes end with a None op
+	TArray<uint8>    mCodes;
+	int              mNumSlot;
+	//The blocks of the value buffer slots then the blocks of the stack levels
+	TArray<RealType> mBlocks;
+	TArray<RealType const*> mSlots;
+	TArray<RealType const*> mStack;
+};
+#endif
+
 #endif // ExprByteCode_h__
@@ -15,6 +15,15 @@ ExpressionCompiler::ExpressionCompiler()
 	mTargetType = ECodeExecType::Asm;
 }
 
+int ExpressionCompiler::GetMaxSIMDWidth()
+{
+#if ENABLE_ASM_CODE && TARGET_PLATFORM_64BITS
+	if (AVXSIMDCodeGeneratorX64::IsSupported())
+		return AVXSIMDCodeGeneratorX64::SIMDWidth;
+#endif
+	return 4;
+}
+
 bool ExpressionCompiler::compile( char const* expr, SymbolTable const& table, ParseResult&  parseResult, ExecutableCode& data , int numInput , ValueLayout inputLayouts[] )
 {
 	try
@@ -51,9 +60,23 @@ bool ExpressionCompiler::compile( char const* expr, SymbolTable const& table, Pa
 				if (mbGenerateSIMD)
 				{
 #if TARGET_PLATFORM_64BITS
-					SSESIMDCodeGeneratorX64 generator;
-					generator.setCodeData(&data.initAsm());
-					parseResult.generateCode(generator, numInput, inputLayouts);
+					if (mSIMDWidth == AVXSIMDCodeGeneratorX64::SIMDWidth)
+					{
+						if (!AVXSIMDCodeGeneratorX64::IsSupported())
+						{
+							LogWarning(0, "AVX is not supported by the CPU");
+							return false;
+						}
+						AVXSIMDCodeGeneratorX64 generator;
+						generator.setCodeData(&data.initAsm());
+						parseResult.generateCode(generator, numInput, inputLayouts);
+					}
+					else
+					{
+						SSESIMDCodeGeneratorX64 generator;
+						generator.setCodeData(&data.initAsm());
+						parseResult.generateCode(generator, numInput, inputLayouts);
+					}
 #else
 					return false;
 #endif
@@ -81,6 +104,15 @@ bool ExpressionCompiler::compile( char const* expr, SymbolTable const& table, Pa
 			break;
 #endif
 
+#if ENABLE_BYTE_CODE_BATCH
+			case ECodeExecType::ByteCodeBatch:
+			{
+				ExprByteCodeCompiler generator(data.initByteCodeBatch());
+				parseResult.generateCode(generator, numInput, inputLayouts);
+			}
+			break;
+#endif
+
 #if ENABLE_INTERP_CODE
 			case ECodeExecType::Interp:
 			{
@@ -93,7 +125,8 @@ bool ExpressionCompiler::compile( char const* expr, SymbolTable const& table, Pa
 				return false;
 			}
 
-			data.setSIMD(mbGenerateSIMD || mTargetType == ECodeExecType::ByteCode);
+			data.setSIMD(mbGenerateSIMD || mTargetType == ECodeExecType::ByteCode || mTargetType == ECodeExecType::ByteCodeBatch);
+			data.mSIMDWidth = (mbGenerateSIMD && mTargetType == ECodeExecType::Asm) ? mSIMDWidth : FloatVector::Size;
 		}
 		return true;
 	}
@@ -18,6 +18,7 @@
 #if ENABLE_BYTE_CODE
 #include "Backend/ExprByteCode.h"
 #endif
+#define ENABLE_BYTE_CODE_BATCH (ENABLE_BYTE_CODE && EBC_USE_BATCH_EXECUTE)
 #if ENABLE_INTERP_CODE
 #include "ExpressionUtils.h"
 #endif
@@ -31,6 +32,7 @@ enum class ECodeExecType : uint8
 	Asm,
 	ByteCode,
 	Interp,
+	ByteCodeBatch,
 };
 
 struct CodeDataEmpty {};
@@ -38,15 +40,27 @@ struct CodeDataEmpty {};
 namespace ExprInternal
 {
 	template<typename T>
-	using TAsmArgType = std::conditional_t<std::is_same_v<std::decay_t<T>, FloatVector>, __m128, T>;
+	struct TIsFloatVector { static constexpr bool Value = false; };
+	template<int Size>
+	struct TIsFloatVector< SIMD::TFloatVector<Size> > { static constexpr bool Value = true; };
+
+	template<typename T>
+	struct TAsmArg { using Type = T; };
+	template<>
+	struct TAsmArg< SIMD::TFloatVector<4> > { using Type = __m128; };
+	template<>
+	struct TAsmArg< SIMD::TFloatVector<8> > { using Type = __m256; };
+
+	template<typename T>
+	using TAsmArgType = std::conditional_t<TIsFloatVector<std::decay_t<T>>::Value, typename TAsmArg<std::decay_t<T>>::Type, T>;
 
 	template<typename T>
 	FORCEINLINE TAsmArgType<T> ToAsmArg(T&& value)
 	{
 #if TARGET_PLATFORM_64BITS
-		if constexpr (std::is_same_v<std::decay_t<T>, FloatVector>)
+		if constexpr (TIsFloatVector<std::decay_t<T>>::Value)
 		{
-			return (__m128)value;
+			return (TAsmArgType<T>)value;
 		}
 		else
 #endif
@@ -59,9 +73,10 @@ namespace ExprInternal
 	FORCEINLINE RT CallAsm(void const* ptr, Args... args)
 	{
 #if TARGET_PLATFORM_64BITS
-		if constexpr (std::is_same_v<RT, FloatVector>)
+		if constexpr (TIsFloatVector<RT>::Value)
 		{
-			using FuncPtr = __m128(__vectorcall*)(TAsmArgType<Args>...);
+			// The SIMD width of the code must match the vector type
+			using FuncPtr = TAsmArgType<RT>(__vectorcall*)(TAsmArgType<Args>...);
 			return (RT)reinterpret_cast<FuncPtr>(const_cast<void*>(ptr))(ToAsmArg(args)...);
 		}
 		else
@@ -121,6 +136,66 @@ struct TCodeExecutor<ExprByteCodeExecData>
 
 	template<typename RT, typename ...Args>
 	FORCEINLINE RT eval(Args ...args) const
+	{
+#if EBC_USE_VALUE_BUFFER
+		constexpr bool bUseValueBuffer = sizeof...(args) == 1 && (std::is_same_v<Args, TArrayView<RT const>> && ...);
+		if constexpr (!bUseValueBuffer)
+		{
+			//The codes read the constants , variables and temps from the value buffer , the inputs lead it
+			RT valueBuffer[64];
+			int const numValue = mData.getValueBufferSize();
+			CHECK(numValue <= ARRAY_SIZE(valueBuffer));
+			mData.initValueBuffer(valueBuffer);
+			int index = 0;
+			((valueBuffer[index++] = RT(args)), ...);
+			return eval<RT>(TArrayView<RT const>(valueBuffer, numValue));
+		}
+		else
+#endif
+		// The byte code executor only evaluates the FloatVector width , wider vectors are evaluated per lane
+		if constexpr (ExprInternal::TIsFloatVector<RT>::Value && !std::is_same_v<RT, FloatVector>)
+		{
+			RT result;
+#if EBC_USE_VALUE_BUFFER
+			auto const& values = std::get<0>(std::forward_as_tuple(args...));
+			RealType valueBuffer[64];
+			int const numValue = values.size();
+			CHECK(numValue <= ARRAY_SIZE(valueBuffer));
+#endif
+			for (int i = 0; i < RT::Size; ++i)
+			{
+#if EBC_USE_VALUE_BUFFER
+				for (int n = 0; n < numValue; ++n)
+					valueBuffer[n] = values[n][i];
+				result[i] = evalByteCode<RealType>(TArrayView<RealType const>(valueBuffer, numValue));
+#else
+				result[i] = evalByteCode<RealType>(GetLaneValue<RT>(args, i)...);
+#endif
+			}
+			return result;
+		}
+		else
+		{
+			return evalByteCode<RT>(args...);
+		}
+	}
+
+	template<typename RT, typename TArg>
+	static FORCEINLINE RealType GetLaneValue(TArg const& arg, int index)
+	{
+		if constexpr (std::is_same_v<TArg, RT>)
+		{
+			return arg[index];
+		}
+		else
+		{
+			static_assert(std::is_convertible_v<TArg, RealType>, "The argument can't be evaluated per lane");
+			return (RealType)arg;
+		}
+	}
+
+	template<typename RT, typename ...Args>
+	FORCEINLINE RT evalByteCode(Args ...args) const
 	{
 		TByteCodeExecutor<RT> executor;
 		if constexpr (sizeof...(args) == 1)
@@ -146,6 +221,24 @@ struct TCodeExecutor<ExprByteCodeExecData>
 };
 #endif
 
+#if ENABLE_BYTE_CODE_BATCH
+template<>
+struct TCodeExecutor<ExprByteCodeBatchExecData>
+{
+	using DataType = ExprByteCodeBatchExecData;
+	ExprByteCodeBatchExecData const& mData;
+	TCodeExecutor(ExprByteCodeBatchExecData const& data) : mData(data) {}
+
+	//Evaluate one sample or one vector with the scalar executor , the batch data holds the same codes.
+	//Use ExprByteCodeBatchExecutor to evaluate many samples at a time
+	template<typename RT, typename ...Args>
+	FORCEINLINE RT eval(Args ...args) const
+	{
+		return TCodeExecutor<ExprByteCodeExecData>(mData).eval<RT>(args...);
+	}
+};
+#endif
+
 #if ENABLE_INTERP_CODE
 template<>
 struct TCodeExecutor<TArray<ExprParse::Unit>>
@@ -173,14 +266,14 @@ struct TCodeExecutor<TArray<ExprParse::Unit>>
 			return FExpressUtils::template EvalutePosfixCodes<RT>(mData, vals...);
 		};
 
-		if constexpr (std::is_same_v<RT, FloatVector>)
+		if constexpr (ExprInternal::TIsFloatVector<RT>::Value)
 		{
 			RT result;
 			for (int i = 0; i < RT::Size; ++i)
 			{
 				auto get_arg = [&](auto const& arg) -> RealType {
 					using TArg = std::decay_t<decltype(arg)>;
-					if constexpr (std::is_same_v<TArg, FloatVector>)
+					if constexpr (std::is_same_v<TArg, RT>)
 						return arg[i];
 					else if constexpr (std::is_convertible_v<TArg, RealType>)
 						return (RealType)arg;
@@ -210,6 +303,9 @@ public:
 #if ENABLE_BYTE_CODE
 		, ExprByteCodeExecData
 #endif
+#if ENABLE_BYTE_CODE_BATCH
+		, ExprByteCodeBatchExecData
+#endif
 #if ENABLE_INTERP_CODE
 		, TArray<ExprParse::Unit>
 #endif
@@ -226,6 +322,8 @@ public:
 
 	bool isSupportSIMD() const { return mbIsSIMD; }
 	void setSIMD(bool bSIMD) { mbIsSIMD = bSIMD; }
+	//The number of floats evaluated by a call of the SIMD code
+	int  getSIMDWidth() const { return mSIMDWidth; }
 
 	ECodeExecType getActiveType() const
 	{
@@ -239,6 +337,10 @@ public:
 		if (std::holds_alternative<ExprByteCodeExecData>(mData))
 			return ECodeExecType::ByteCode;
 #endif
+#if ENABLE_BYTE_CODE_BATCH
+		if (std::holds_alternative<ExprByteCodeBatchExecData>(mData))
+			return ECodeExecType::ByteCodeBatch;
+#endif
 #if ENABLE_INTERP_CODE
 		if (std::holds_alternative<TArray<ExprParse::Unit>>(mData))
 			return ECodeExecType::Interp;
@@ -263,6 +365,14 @@ public:
 	}
 #endif
 
+#if ENABLE_BYTE_CODE_BATCH
+	ExprByteCodeBatchExecData& initByteCodeBatch()
+	{
+		mData.emplace<ExprByteCodeBatchExecData>();
+		return std::get<ExprByteCodeBatchExecData>(mData);
+	}
+#endif
+
 #if ENABLE_INTERP_CODE
 	TArray<ExprParse::Unit>& initInterp()
 	{
@@ -300,11 +410,22 @@ public:
 	template<typename T>
 	void initValueBuffer(T buffer[])
 	{
+#if ENABLE_BYTE_CODE_BATCH
+		if (std::holds_alternative<ExprByteCodeBatchExecData>(mData))
+		{
+			std::get<ExprByteCodeBatchExecData>(mData).initValueBuffer(buffer);
+			return;
+		}
+#endif
 		std::get<ExprByteCodeExecData>(mData).initValueBuffer(buffer);
 	}
 #endif
 #endif
 
+#if ENABLE_BYTE_CODE_BATCH
+	FORCEINLINE ExprByteCodeBatchExecData const& getByteCodeBatchData() const { return std::get<ExprByteCodeBatchExecData>(mData); }
+#endif
+
 #if ENABLE_INTERP_CODE
 	FORCEINLINE TArray<ExprParse::Unit>& getInterpData() { return std::get<TArray<ExprParse::Unit>>(mData); }
 	FORCEINLINE TArray<ExprParse::Unit> const& getInterpData() const { return std::get<TArray<ExprParse::Unit>>(mData); }
@@ -333,6 +454,9 @@ public:
 #if ENABLE_BYTE_CODE
 			else if constexpr (std::is_same_v<T, ExprByteCodeExecData>) return (int)data.codes.size();
 #endif
+#if ENABLE_BYTE_CODE_BATCH
+			else if constexpr (std::is_same_v<T, ExprByteCodeBatchExecData>) return (int)data.codes.size();
+#endif
 #if ENABLE_INTERP_CODE
 			else if constexpr (std::is_same_v<T, TArray<ExprParse::Unit>>) return (int)data.size();
 #endif
@@ -348,6 +472,7 @@ private:
 	friend class ExpressionCompiler;
 	CodeVariant mData;
 	bool        mbIsSIMD = false;
+	int         mSIMDWidth = FloatVector::Size;
 };
 
 class ExpressionCompiler
@@ -367,10 +492,15 @@ public:
 	void enableOpimization(bool enable = true) { mOptimization = enable; }
 	void enableSIMD(bool bSIMD) { mbGenerateSIMD = bSIMD; }
 	void setTargetType(ECodeExecType type) { mTargetType = type; }
+	//Width 8 generates AVX asm code , the code is evaluated with SIMD::TFloatVector<8>
+	void setSIMDWidth(int width) { mSIMDWidth = width; }
+	//The widest SIMD asm code the CPU can run
+	static int GetMaxSIMDWidth();
 	
 protected:
 	bool  mOptimization;
 	bool  mbGenerateSIMD = false;
+	int   mSIMDWidth = FloatVector::Size;
 	ECodeExecType mTargetType = ECodeExecType::Asm;
 };
 
@@ -457,20 +457,20 @@ bool ExprTreeOptimizer::optimize(ExpressionTreeData& treeData)
 	anyChanged |= changed;
 	logPostfix("ConstFold2");
 
-	// 6. Common Subexpression Elimination (CSE)
-	// Must run before Node Order optimization which assumes final tree structure
+	// 6. Node order optimization (for better register allocation)
+	// Must run before CSE , swapping the children after it could move a temp read before its store
+	changed = false;
+	changed = optimizeNodeOrder();
+	anyChanged |= changed;
+	logPostfix("NodeOrder");
+
+	// 7. Common Subexpression Elimination (CSE)
 	do {
 		changed = eliminateCommonSubexpressions(treeData);
 		anyChanged |= changed;
 	} while (changed);
 	logPostfix("CSE");
 
-	// 7. Node order optimization (for better register allocation)
-	changed = false;
-	changed = optimizeNodeOrder();
-	anyChanged |= changed;
-	logPostfix("NodeOrder");
-
 	return anyChanged;
 }
 
@@ -960,6 +960,23 @@ bool ExprTreeOptimizer::eliminateCommonSubexpressions(ExpressionTreeData& treeDa
 			nextTempIndex = std::max(nextTempIndex, (int)unit.storeIndex + 1);
 	}
 
+	struct PostfixVisitor
+	{
+		void visitValue(ExprParse::Unit const& unit) { codes.push_back(&unit); }
+		void visitOp(ExprParse::Unit const& unit) { codes.push_back(&unit); }
+		std::vector<Unit const*> codes;
+	};
+
+	// The execution order of the operators , the first evaluated occurrence stores the temp
+	std::unordered_map<Unit const*, int> unitOrder;
+	{
+		PostfixVisitor visitor;
+		TExprTreeVisitOp<PostfixVisitor> visitOp(treeData, visitor);
+		visitOp.execute();
+		for (int i = 0; i < (int)visitor.codes.size(); ++i)
+			unitOrder[visitor.codes[i]] = i;
+	}
+
 	// Phase 1: Collect all subtree hashes WITHOUT any modification
 	// Map from hash to list of node indices
 	std::unordered_map<size_t, std::vector<int>> hashToNodes;
@@ -1001,6 +1018,11 @@ bool ExprTreeOptimizer::eliminateCommonSubexpressions(ExpressionTreeData& treeDa
 		for (auto& group : identicalGroups)
 		{
 			if (group.size() < 2) continue;
+
+			std::sort(group.begin(), group.end(), [&](int lhs, int rhs)
+			{
+				return unitOrder[&mExprCodes[mTreeNodes[lhs].indexOp]] < unitOrder[&mExprCodes[mTreeNodes[rhs].indexOp]];
+			});
 			
 			int tempIdx = nextTempIndex++;
 			
@@ -1075,12 +1097,6 @@ bool ExprTreeOptimizer::eliminateCommonSubexpressions(ExpressionTreeData& treeDa
 	
 	// Phase 5: Temp slot reuse based on liveness analysis
 	// Generate postfix codes to analyze execution order
-	struct PostfixVisitor
-	{
-		void visitValue(ExprParse::Unit const& unit) { codes.push_back(&unit); }
-		void visitOp(ExprParse::Unit const& unit) { codes.push_back(&unit); }
-		std::vector<Unit const*> codes;
-	};
 	PostfixVisitor visitor;
 	TExprTreeVisitOp<PostfixVisitor> visitOp(treeData, visitor);
 	visitOp.execute();
@@ -39,6 +39,7 @@ namespace CB
 		ExpressionCompiler  compiler;
 		compiler.setTargetType(mExecType);
 		compiler.enableSIMD(mbGenerateSIMD);
+		compiler.setSIMDWidth(mSIMDWidth);
 		expr.mIsParsed = compiler.compile(expr.getExprString().c_str(), mSymbolDefine, parseResult, expr.acquireEvalResource<ExecutableCode>(), numInput , inputLayouts);
 		return expr.mIsParsed;
 	}
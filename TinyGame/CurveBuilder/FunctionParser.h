@@ -27,10 +27,13 @@ namespace CB
 
 		void         setExecType(ECodeExecType type) { mExecType = type; }
 		void         setGenerateSIMD(bool bSIMD) { mbGenerateSIMD = bSIMD; }
+		void         setSIMDWidth(int width) { mSIMDWidth = width; }
+		int          getSIMDWidth() const { return mSIMDWidth; }
 
 	private:
 		ECodeExecType mExecType = ECodeExecType::Asm;
 		bool         mbGenerateSIMD = true;
+		int          mSIMDWidth = FloatVector::Size;
 		SymbolTable  mSymbolDefine;
 	};
 }//namespace CB
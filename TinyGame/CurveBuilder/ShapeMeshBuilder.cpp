@@ -15,6 +15,8 @@
 #include "RHI/GpuProfiler.h"
 #include "Expression.h"
 #include "Misc/DuffDevice.h"
+#include "Async/AsyncWork.h"
+#include "Async/ParallelFor.h"
 
 namespace CB
 {
@@ -22,6 +24,7 @@ namespace CB
 	static RealType GEmptyTime = 0.0;
 	ShapeMeshBuilder::ShapeMeshBuilder()
 		:mColorMap(1000)
+		, mTaskAllocator(4096)
 		, mParser()
 	{
 		mColorMap.addPoint(0, Color3ub(0, 7, 100));
@@ -56,6 +59,30 @@ namespace CB
 		color[2] = b;
 	}
 
+	//The code compiled with the runtime SIMD width is evaluated with the wide vector , the buffers are aligned to it
+	using WideFloatVector = SIMD::TFloatVector<8>;
+	int constexpr MaxSIMDWidth = WideFloatVector::Size;
+
+	//The sample count of a tile , the tiles except the last one are filled with whole SIMD blocks
+	int constexpr SampleTileSize = 16 * 1024;
+	static_assert(SampleTileSize % MaxSIMDWidth == 0, "Tile size must be a multiple of the SIMD width");
+
+	bool ShapeMeshBuilder::canUseSampleTile(int numData) const
+	{
+		return mThreadPool && numData >= 2 * SampleTileSize;
+	}
+
+	template< typename TFunc >
+	void ShapeMeshBuilder::executeSampleTiles(char const* name, int numData, int tileSize, TFunc&& func)
+	{
+		int numTile = Math::AlignCount(numData, tileSize);
+		ParallelFor(*mThreadPool, mTaskAllocator, name, numTile, [&func, numData, tileSize](int index)
+		{
+			int start = index * tileSize;
+			func(start, Math::Min(tileSize, numData - start));
+		}, 1);
+	}
+
 	void ShapeMeshBuilder::updateCurveData(ShapeUpdateContext const& context, SampleParam const& paramS)
 	{
 		assert(context.func->getFuncType() == TYPE_CURVE_3D);
@@ -77,31 +104,44 @@ namespace CB
 		if (flag & RUF_GEOM)
 		{
 			float ds = paramS.getIncrement();
-			float s = paramS.getRangeMin();
 
 			Curve3DFunc* func = static_cast<Curve3DFunc*>(context.func);
 
 			uint8* posData = data->getVertexData() + data->getPositionOffset();
+			int vertexSize = data->getVertexSize();
 			auto& codeX = func->mCoordExpr[0].getEvalResource<ExecutableCode>();
 			auto& codeY = func->mCoordExpr[1].getEvalResource<ExecutableCode>();
 			auto& codeZ = func->mCoordExpr[2].getEvalResource<ExecutableCode>();
 
-			codeX.visit([&](auto& execX)
+			auto UpdatePositionTile = [&](int start, int num)
 			{
-				using ExecutorType = std::decay_t<decltype(execX)>;
-				auto execY = codeY.getExecutor<ExecutorType>();
-				auto execZ = codeZ.getExecutor<ExecutorType>();
-
-				for (int i = 0; i < paramS.numData; ++i)
+				codeX.visit([&](auto& execX)
 				{
-					Vector3* pPos = (Vector3*)(posData);
-					pPos->x = execX.template eval<RealType>(s);
-					pPos->y = execY.template eval<RealType>(s);
-					pPos->z = execZ.template eval<RealType>(s);
-					s += ds;
-					posData += data->getVertexSize();
-				}
-			});
+					using ExecutorType = std::decay_t<decltype(execX)>;
+					auto execY = codeY.getExecutor<ExecutorType>();
+					auto execZ = codeZ.getExecutor<ExecutorType>();
+
+					uint8* pPosData = posData + start * vertexSize;
+					for (int i = start; i < start + num; ++i)
+					{
+						float s = paramS.getRangeMin() + i * ds;
+						Vector3* pPos = (Vector3*)(pPosData);
+						pPos->x = execX.template eval<RealType>(s);
+						pPos->y = execY.template eval<RealType>(s);
+						pPos->z = execZ.template eval<RealType>(s);
+						pPosData += vertexSize;
+					}
+				});
+			};
+
+			if (canUseSampleTile(paramS.numData))
+			{
+				executeSampleTiles("CB.CurvePosition", paramS.numData, SampleTileSize, UpdatePositionTile);
+			}
+			else
+			{
+				UpdatePositionTile(0, paramS.numData);
+			}
 		}
 		if (flag & RUF_COLOR)
 		{
@@ -138,6 +178,279 @@ namespace CB
 #define UV_X_OP(INDEX) pUV[INDEX].x,
 #define UV_Y_OP(INDEX) pUV[INDEX].y,
 
+	template< typename TVector >
+	FORCEINLINE void LoadSampleUV(Vector2 const* pUV, TVector& outU, TVector& outV)
+	{
+		float us[TVector::Size];
+		float vs[TVector::Size];
+		for (int n = 0; n < TVector::Size; ++n)
+		{
+			us[n] = pUV[n].x;
+			vs[n] = pUV[n].y;
+		}
+		outU = TVector(us);
+		outV = TVector(vs);
+	}
+
+	template< typename TVector >
+	FORCEINLINE void StoreSamplePos(uint8* pPos, int vertexSize, TVector const& x, TVector const& y, TVector const& z)
+	{
+		for (int n = 0; n < TVector::Size; ++n)
+		{
+			*reinterpret_cast<Vector3*>(pPos) = Vector3(x[n], y[n], z[n]);
+			pPos += vertexSize;
+		}
+	}
+
+	template< typename TSurfaceUVFunc >
+	void ShapeMeshBuilder::UpdatePositionTile_SurfaceUV(TSurfaceUVFunc* func, Vector2 const* pUV, uint8* posData, int vertexSize, int numData)
+	{
+		uint8* pPos = posData;
+		if (func->bSupportSIMD)
+		{
+			int numBlock = Math::AlignCount(numData, FloatVector::Size);
+			if constexpr (std::is_same_v<TSurfaceUVFunc, SurfaceUVFunc>)
+			{
+				auto& codeX = func->mAixsExpr[0].getEvalResource<ExecutableCode>();
+				auto& codeY = func->mAixsExpr[1].getEvalResource<ExecutableCode>();
+				auto& codeZ = func->mAixsExpr[2].getEvalResource<ExecutableCode>();
+
+				codeX.visit([&](auto& execX) {
+					using ExecutorType = std::decay_t<decltype(execX)>;
+					auto execY = codeY.getExecutor<ExecutorType>();
+					auto execZ = codeZ.getExecutor<ExecutorType>();
+					if constexpr (FloatVector::Size < WideFloatVector::Size)
+					{
+						if (codeX.getSIMDWidth() == WideFloatVector::Size)
+						{
+							int numWideBlock = Math::AlignCount(numData, WideFloatVector::Size);
+							for (int i = 0; i < numWideBlock; ++i)
+							{
+								WideFloatVector u, v;
+								LoadSampleUV(pUV, u, v);
+								WideFloatVector x = execX.template eval<WideFloatVector>(u, v);
+								WideFloatVector y = execY.template eval<WideFloatVector>(u, v);
+								WideFloatVector z = execZ.template eval<WideFloatVector>(u, v);
+								StoreSamplePos(pPos, vertexSize, x, y, z);
+								pPos += WideFloatVector::Size * vertexSize;
+								pUV += WideFloatVector::Size;
+							}
+							return;
+						}
+					}
+					for (int i = 0; i < numBlock; ++i)
+					{
+						FloatVector u{ SIMD_ELEMENT_LIST(UV_X_OP) };
+						FloatVector v{ SIMD_ELEMENT_LIST(UV_Y_OP) };
+						FloatVector x = execX.template eval<FloatVector>(u, v);
+						FloatVector y = execY.template eval<FloatVector>(u, v);
+						FloatVector z = execZ.template eval<FloatVector>(u, v);
+						SIMD_ELEMENT_LIST(SET_POS_OP);
+						pUV += FloatVector::Size;
+					}
+				});
+			}
+			else
+			{
+				for (int i = 0; i < numBlock; ++i)
+				{
+					FloatVector u{ SIMD_ELEMENT_LIST(UV_X_OP) };
+					FloatVector v{ SIMD_ELEMENT_LIST(UV_Y_OP) };
+					FloatVector x, y, z;
+					func->evalExpr(u, v, x, y, z);
+					SIMD_ELEMENT_LIST(SET_POS_OP);
+					pUV += FloatVector::Size;
+				}
+			}
+		}
+		else
+		{
+			if constexpr (std::is_same_v<TSurfaceUVFunc, SurfaceUVFunc>)
+			{
+				auto& codeX = func->mAixsExpr[0].getEvalResource<ExecutableCode>();
+				auto& codeY = func->mAixsExpr[1].getEvalResource<ExecutableCode>();
+				auto& codeZ = func->mAixsExpr[2].getEvalResource<ExecutableCode>();
+
+				codeX.visit([&](auto& execX) {
+					using ExecutorType = std::decay_t<decltype(execX)>;
+					auto execY = codeY.getExecutor<ExecutorType>();
+					auto execZ = codeZ.getExecutor<ExecutorType>();
+					for (int i = 0; i < numData; ++i)
+					{
+						Vector3* pVal = reinterpret_cast<Vector3*>(pPos);
+						pVal->x = execX.template eval<RealType>(pUV->x, pUV->y);
+						pVal->y = execY.template eval<RealType>(pUV->x, pUV->y);
+						pVal->z = execZ.template eval<RealType>(pUV->x, pUV->y);
+						pPos += vertexSize;
+						++pUV;
+					}
+				});
+			}
+			else
+			{
+				for (int i = 0; i < numData; ++i)
+				{
+					func->evalExpr(pUV->x, pUV->y, *reinterpret_cast<Vector3*>(pPos));
+					pPos += vertexSize;
+					++pUV;
+				}
+			}
+		}
+	}
+
+	template< typename TSurfaceXYFunc >
+	void ShapeMeshBuilder::UpdatePositionTile_SurfaceXY(TSurfaceXYFunc* func, Vector2 const* pUV, uint8* posData, int vertexSize, int numData)
+	{
+		uint8* pPos = posData;
+		if (func->bSupportSIMD)
+		{
+			int numBlock = Math::AlignCount(numData, FloatVector::Size);
+			if constexpr (std::is_same_v<TSurfaceXYFunc, SurfaceXYFunc>)
+			{
+				auto& code = func->mExpr.getEvalResource<ExecutableCode>();
+#if ENABLE_BYTE_CODE_BATCH
+				if (code.getActiveType() == ECodeExecType::ByteCodeBatch)
+				{
+					//The executor owns the slot blocks , every tile creates its own one
+					int const BatchSize = ExprByteCodeBatchExecutor::BatchSize;
+					ExprByteCodeBatchExecutor executor(code.getByteCodeBatchData());
+					RealType xs[BatchSize];
+					RealType ys[BatchSize];
+					RealType zs[BatchSize];
+					RealType const* inputs[] = { xs , ys };
+					for (int index = 0; index < numData; index += BatchSize)
+					{
+						int num = Math::Min(BatchSize, numData - index);
+						for (int i = 0; i < num; ++i)
+						{
+							xs[i] = pUV[i].x;
+							ys[i] = pUV[i].y;
+						}
+						executor.execute(inputs, zs, num);
+						for (int i = 0; i < num; ++i)
+						{
+							*reinterpret_cast<Vector3*>(pPos) = Vector3(xs[i], ys[i], zs[i]);
+							pPos += vertexSize;
+						}
+						pUV += num;
+					}
+					return;
+				}
+#endif
+#if EBC_USE_VALUE_BUFFER
+				if (code.getActiveType() == ECodeExecType::ByteCode)
+				{
+					//The byte code only reads the code data , the value buffer is the context of the tile
+					FloatVector valueBuffer[64];
+					code.initValueBuffer(valueBuffer);
+					code.visit([&](auto& executor)
+					{
+						for (int i = 0; i < numBlock; ++i)
+						{
+							FloatVector x{ SIMD_ELEMENT_LIST(UV_X_OP) };
+							FloatVector y{ SIMD_ELEMENT_LIST(UV_Y_OP) };
+							valueBuffer[0] = x;
+							valueBuffer[1] = y;
+							FloatVector z = executor.template eval<FloatVector>(TArrayView<FloatVector const>(valueBuffer, 64));
+							SIMD_ELEMENT_LIST(SET_POS_OP);
+							pUV += FloatVector::Size;
+						}
+					});
+					return;
+				}
+#endif
+				code.visit([&](auto& executor)
+				{
+					if constexpr (FloatVector::Size < WideFloatVector::Size)
+					{
+						if (code.getSIMDWidth() == WideFloatVector::Size)
+						{
+							int numWideBlock = Math::AlignCount(numData, WideFloatVector::Size);
+							for (int i = 0; i < numWideBlock; ++i)
+							{
+								WideFloatVector x, y;
+								LoadSampleUV(pUV, x, y);
+								WideFloatVector z = executor.template eval<WideFloatVector>(x, y);
+								StoreSamplePos(pPos, vertexSize, x, y, z);
+								pPos += WideFloatVector::Size * vertexSize;
+								pUV += WideFloatVector::Size;
+							}
+							return;
+						}
+					}
+					for (int i = 0; i < numBlock; ++i)
+					{
+						FloatVector x{ SIMD_ELEMENT_LIST(UV_X_OP) };
+						FloatVector y{ SIMD_ELEMENT_LIST(UV_Y_OP) };
+						FloatVector z = executor.template eval<FloatVector>(x, y);
+						SIMD_ELEMENT_LIST(SET_POS_OP);
+						pUV += FloatVector::Size;
+					}
+				});
+			}
+			else
+			{
+				for (int i = 0; i < numBlock; ++i)
+				{
+					FloatVector x{ SIMD_ELEMENT_LIST(UV_X_OP) };
+					FloatVector y{ SIMD_ELEMENT_LIST(UV_Y_OP) };
+					FloatVector z;
+					func->evalExpr(x, y, z);
+					SIMD_ELEMENT_LIST(SET_POS_OP);
+					pUV += FloatVector::Size;
+				}
+			}
+		}
+		else
+		{
+			if constexpr (std::is_same_v<TSurfaceXYFunc, SurfaceXYFunc>)
+			{
+				auto& code = func->mExpr.getEvalResource<ExecutableCode>();
+#if EBC_USE_VALUE_BUFFER
+				if (code.getActiveType() == ECodeExecType::ByteCode)
+				{
+					RealType valueBuffer[64];
+					code.initValueBuffer(valueBuffer);
+					code.visit([&](auto& executor)
+					{
+						for (int i = 0; i < numData; ++i)
+						{
+							valueBuffer[0] = pUV->x;
+							valueBuffer[1] = pUV->y;
+							float z = executor.template eval<float>(TArrayView<RealType const>(valueBuffer, 64));
+							*reinterpret_cast<Vector3*>(pPos) = Vector3(pUV->x, pUV->y, z);
+							pPos += vertexSize;
+							++pUV;
+						}
+					});
+					return;
+				}
+#endif
+				code.visit([&](auto& executor)
+				{
+					for (int i = 0; i < numData; ++i)
+					{
+						float z = executor.template eval<float>(pUV->x, pUV->y);
+						*reinterpret_cast<Vector3*>(pPos) = Vector3(pUV->x, pUV->y, z);
+						pPos += vertexSize;
+						++pUV;
+					}
+				});
+			}
+			else
+			{
+				float z;
+				for (int i = 0; i < numData; ++i)
+				{
+					func->evalExpr(pUV->x, pUV->y, z);
+					*reinterpret_cast<Vector3*>(pPos) = Vector3(pUV->x, pUV->y, z);
+					pPos += vertexSize;
+					++pUV;
+				}
+			}
+		}
+	}
+
 
 	template< typename TSurfaceUVFunc >
 	void ShapeMeshBuilder::updatePositionData_SurfaceUV(TSurfaceUVFunc* func, SampleParam const &paramU, SampleParam const &paramV, RenderData& data)
@@ -367,15 +680,13 @@ namespace CB
 		break;
 		case BIT(0) | BIT(1):
 		{
-			uint8* pPos = posData;
 			int numData = paramV.numData * paramU.numData;
+#if REORDER_CACHE
+			//The cache of the SIMD path is reordered to x x x x y y y y , the tile function reads x y pairs
 			if (func->bSupportSIMD)
 			{
-#if REORDER_CACHE
+				uint8* pPos = posData;
 				float const* pUV = (float*)Math::AlignUp<intptr_t>((intptr_t)data.getCachedData(), CacheAlign);
-#else
-				Vector2 const* pUV = (Vector2 const*)data.getCachedData();
-#endif
 				int numBlock = numData / FloatVector::Size;
 
 				if constexpr (std::is_same_v<TSurfaceUVFunc, SurfaceUVFunc>)
@@ -390,24 +701,15 @@ namespace CB
 						auto execZ = codeZ.getExecutor<ExecutorType>();
 						for (int i = 0; i < numBlock; ++i)
 						{
-#if REORDER_CACHE
 							FloatVector u{ pUV , EAligned::Value };
 							FloatVector v{ pUV + FloatVector::Size , EAligned::Value };
-#else
-							FloatVector u{ SIMD_ELEMENT_LIST(UV_X_OP) };
-							FloatVector v{ SIMD_ELEMENT_LIST(UV_Y_OP) };
-#endif
 							FloatVector x = execX.template eval<FloatVector>(u, v);
 							FloatVector y = execY.template eval<FloatVector>(u, v);
 							FloatVector z = execZ.template eval<FloatVector>(u, v);
 
 							SIMD_ELEMENT_LIST(SET_POS_OP);
 
-#if REORDER_CACHE
 							pUV += 2 * FloatVector::Size;
-#else
-							pUV += FloatVector::Size;
-#endif
 						}
 					});
 				}
@@ -415,58 +717,29 @@ namespace CB
 				{
 					for (int i = 0; i < numBlock; ++i)
 					{
-#if REORDER_CACHE
 						FloatVector u{ pUV , EAligned::Value };
 						FloatVector v{ pUV + FloatVector::Size , EAligned::Value };
-#else
-						FloatVector u{ SIMD_ELEMENT_LIST(UV_X_OP) };
-						FloatVector v{ SIMD_ELEMENT_LIST(UV_Y_OP) };
-#endif
 						FloatVector x, y, z;
 						func->evalExpr(u, v, x, y, z);
 						SIMD_ELEMENT_LIST(SET_POS_OP);
 
-#if REORDER_CACHE
 						pUV += 2 * FloatVector::Size;
-#else
-						pUV += FloatVector::Size;
-#endif
 					}
 				}
+				break;
 			}
-			else
+#endif
+			Vector2 const* pUV = (Vector2 const*)data.getCachedData();
+			if (canUseSampleTile(numData))
 			{
-				Vector2 const* pUV = (Vector2 const*)data.getCachedData();
-				if constexpr (std::is_same_v<TSurfaceUVFunc, SurfaceUVFunc>)
-				{
-					auto& codeX = func->mAixsExpr[0].getEvalResource<ExecutableCode>();
-					auto& codeY = func->mAixsExpr[1].getEvalResource<ExecutableCode>();
-					auto& codeZ = func->mAixsExpr[2].getEvalResource<ExecutableCode>();
-
-					codeX.visit([&](auto& execX) {
-						using ExecutorType = std::decay_t<decltype(execX)>;
-						auto execY = codeY.getExecutor<ExecutorType>();
-						auto execZ = codeZ.getExecutor<ExecutorType>();
-						for (int i = 0; i < numData; ++i)
-						{
-							Vector3* pVal = reinterpret_cast<Vector3*>(pPos);
-							pVal->x = execX.template eval<RealType>(pUV->x, pUV->y);
-							pVal->y = execY.template eval<RealType>(pUV->x, pUV->y);
-							pVal->z = execZ.template eval<RealType>(pUV->x, pUV->y);
-							pPos += vertexSize;
-							++pUV;
-						}
-					});
-				}
-				else
+				executeSampleTiles("CB.SurfacePosition", numData, SampleTileSize, [&](int start, int num)
 				{
-					for (int i = 0; i < numData; ++i)
-					{
-						func->evalExpr(pUV->x, pUV->y, *reinterpret_cast<Vector3*>(pPos));
-						pPos += vertexSize;
-						++pUV;
-					}
-				}
+					UpdatePositionTile_SurfaceUV(func, pUV + start, posData + start * vertexSize, vertexSize, num);
+				});
+			}
+			else
+			{
+				UpdatePositionTile_SurfaceUV(func, pUV, posData, vertexSize, numData);
 			}
 		}
 		break;
@@ -725,15 +998,13 @@ namespace CB
 		break;
 		case BIT(0) | BIT(1):
 		{
-			uint8* pPos = posData;
 			int numData = paramV.numData * paramU.numData;
+#if REORDER_CACHE
+			//The cache of the SIMD path is reordered to x x x x y y y y , the tile function reads x y pairs
 			if (func->bSupportSIMD)
 			{
-#if REORDER_CACHE
+				uint8* pPos = posData;
 				float const* pUV = (float*)Math::AlignUp<intptr_t>((intptr_t)data.getCachedData(), CacheAlign);
-#else
-				Vector2 const* pUV = (Vector2 const*)data.getCachedData();
-#endif
 
 				int numBlock = Math::AlignCount(numData, FloatVector::Size);
 				
@@ -751,22 +1022,13 @@ namespace CB
 						{
 							for (int i = 0; i < numBlock; ++i)
 							{
-#if REORDER_CACHE
 								FloatVector x{ pUV , EAligned::Value };
 								FloatVector y{ pUV + FloatVector::Size , EAligned::Value };
-#else
-								FloatVector x{ SIMD_ELEMENT_LIST(UV_X_OP) };
-								FloatVector y{ SIMD_ELEMENT_LIST(UV_Y_OP) };
-#endif
 								valueBuffer[0] = x;
 								valueBuffer[1] = y;
 								FloatVector z = executor.template eval<FloatVector>(TArrayView<FloatVector const>(valueBuffer, 64));
 								SIMD_ELEMENT_LIST(SET_POS_OP);
-#if REORDER_CACHE
 								pUV += 2 * FloatVector::Size;
-#else
-								pUV += FloatVector::Size;
-#endif
 							}
 						});
 #else
@@ -774,20 +1036,11 @@ namespace CB
 						{
 							for (int i = 0; i < numBlock; ++i)
 							{
-#if REORDER_CACHE
 								FloatVector x{ pUV , EAligned::Value };
 								FloatVector y{ pUV + FloatVector::Size , EAligned::Value };
-#else
-								FloatVector x{ SIMD_ELEMENT_LIST(UV_X_OP) };
-								FloatVector y{ SIMD_ELEMENT_LIST(UV_Y_OP) };
-#endif
 								FloatVector z = executor.template eval<FloatVector>(x, y);
 								SIMD_ELEMENT_LIST(SET_POS_OP);
-#if REORDER_CACHE
 								pUV += 2 * FloatVector::Size;
-#else
-								pUV += FloatVector::Size;
-#endif
 							}
 						});
 #endif
@@ -798,20 +1051,11 @@ namespace CB
 						{
 							for (int i = 0; i < numBlock; ++i)
 							{
-#if REORDER_CACHE
 								FloatVector x{ pUV , EAligned::Value };
 								FloatVector y{ pUV + FloatVector::Size , EAligned::Value };
-#else
-								FloatVector x{ SIMD_ELEMENT_LIST(UV_X_OP) };
-								FloatVector y{ SIMD_ELEMENT_LIST(UV_Y_OP) };
-#endif
 								FloatVector z = executor.template eval<FloatVector>(x, y);
 								SIMD_ELEMENT_LIST(SET_POS_OP);
-#if REORDER_CACHE
 								pUV += 2 * FloatVector::Size;
-#else
-								pUV += FloatVector::Size;
-#endif
 							}
 						});
 					}
@@ -820,88 +1064,28 @@ namespace CB
 				{
 					for (int i = 0; i < numBlock; ++i)
 					{
-#if REORDER_CACHE
 						FloatVector x{ pUV , EAligned::Value };
 						FloatVector y{ pUV + FloatVector::Size , EAligned::Value };
-#else
-						FloatVector x{ SIMD_ELEMENT_LIST(UV_X_OP) };
-						FloatVector y{ SIMD_ELEMENT_LIST(UV_Y_OP) };
-#endif
 						FloatVector z;
 						func->evalExpr(x, y, z);
 						SIMD_ELEMENT_LIST(SET_POS_OP);
-#if REORDER_CACHE
 						pUV += 2 * FloatVector::Size;
-#else
-						pUV += FloatVector::Size;
-#endif
 					}
 				}
+				break;
 			}
-			else
-			{
-				Vector2 const* pUV = (Vector2 const*)data.getCachedData();
-
-				if constexpr (std::is_same_v<TSurfaceXYFunc, SurfaceXYFunc>)
-				{
-					auto& code = func->mExpr.getEvalResource<ExecutableCode>();
-					
-					// ByteCode with valueBuffer optimization
-					if (code.getActiveType() == ECodeExecType::ByteCode)
-					{
-#if EBC_USE_VALUE_BUFFER
-						RealType valueBuffer[64];
-						code.initValueBuffer(valueBuffer);
-						code.visit([&](auto& executor)
-						{
-							for (int i = 0; i < numData; ++i)
-							{
-								valueBuffer[0] = pUV->x;
-								valueBuffer[1] = pUV->y;
-								float z = executor.template eval<float>(TArrayView<RealType const>(valueBuffer, 64));
-								*reinterpret_cast<Vector3*>(pPos) = Vector3(pUV->x, pUV->y, z);
-								pPos += vertexSize;
-								++pUV;
-							}
-						});
-#else
-						code.visit([&](auto& executor)
-						{
-							for (int i = 0; i < numData; ++i)
-							{
-								float z = executor.template eval<float>(pUV->x, pUV->y);
-								*reinterpret_cast<Vector3*>(pPos) = Vector3(pUV->x, pUV->y, z);
-								pPos += vertexSize;
-								++pUV;
-							}
-						});
 #endif
-					}
-					else
-					{
-						code.visit([&](auto& executor)
-						{
-							for (int i = 0; i < numData; ++i)
-							{
-								float z = executor.template eval<float>(pUV->x, pUV->y);
-								*reinterpret_cast<Vector3*>(pPos) = Vector3(pUV->x, pUV->y, z);
-								pPos += vertexSize;
-								++pUV;
-							}
-						});
-					}
-				}
-				else
+			Vector2 const* pUV = (Vector2 const*)data.getCachedData();
+			if (canUseSampleTile(numData))
+			{
+				executeSampleTiles("CB.SurfacePosition", numData, SampleTileSize, [&](int start, int num)
 				{
-					float z;
-					for (int i = 0; i < numData; ++i)
-					{
-						func->evalExpr(pUV->x, pUV->y, z);
-						*reinterpret_cast<Vector3*>(pPos) = Vector3(pUV->x, pUV->y, z);
-						pPos += vertexSize;
-						++pUV;
-					}
-				}
+					UpdatePositionTile_SurfaceXY(func, pUV + start, posData + start * vertexSize, vertexSize, num);
+				});
+			}
+			else
+			{
+				UpdatePositionTile_SurfaceXY(func, pUV, posData, vertexSize, numData);
 			}
 		}
 		break;
@@ -978,6 +1162,51 @@ namespace CB
 		}
 	}
 
+	// Accumulate the face normals of the grid triangles to the vertices of the rows [rowStart, rowEnd) , the quad rows
+	// beside the band are the halo and also computed by the neighbour bands , so the bands can be filled in parallel
+	void FillGirdMeshNormals(Render::VertexElementReader const& posReader, Render::VertexElementWriter& normalWriter, int nx, int ny, int rowStart, int rowEnd)
+	{
+		for (int index = nx * rowStart; index < nx * rowEnd; ++index)
+		{
+			normalWriter[index] = Vector3::Zero();
+		}
+
+		int quadRowStart = Math::Max(rowStart - 1, 0);
+		int quadRowEnd = Math::Min(rowEnd, ny - 1);
+		for (int j = quadRowStart; j < quadRowEnd; ++j)
+		{
+			bool bInBand = j >= rowStart;
+			bool bNextInBand = j + 1 < rowEnd;
+			for (int i = 0; i < nx - 1; ++i)
+			{
+				int index = nx * j + i;
+				int indexN = index + nx;
+
+				Vector3 const& p0 = posReader[index];
+				Vector3 const& p1 = posReader[index + 1];
+				Vector3 const& p2 = posReader[indexN + 1];
+				Vector3 const& p3 = posReader[indexN];
+
+				//Same triangles as FillGirdMeshIndices
+				Vector3 normal0 = (p1 - p0).cross(p2 - p0);
+				normal0.normalize();
+				Vector3 normal1 = (p3 - p2).cross(p0 - p2);
+				normal1.normalize();
+
+				if (bInBand)
+				{
+					normalWriter[index] += normal0 + normal1;
+					normalWriter[index + 1] += normal0;
+				}
+				if (bNextInBand)
+				{
+					normalWriter[indexN + 1] += normal0 + normal1;
+					normalWriter[indexN] += normal1;
+				}
+			}
+		}
+	}
+
 
 	void ShapeMeshBuilder::updateSurfaceData(ShapeUpdateContext const& context, SampleParam const& paramU, SampleParam const& paramV)
 	{
@@ -1007,7 +1236,7 @@ namespace CB
 
 				bool bUseResource = false;
 				bool bUseNormal = true;
-				data->create(vertexNum, bSupportSIMD ? FloatVector::Size : 1, indexNum, bUseNormal, bUseResource);
+				data->create(vertexNum, bSupportSIMD ? MaxSIMDWidth : 1, indexNum, bUseNormal, bUseResource);
 			}
 			flags |= (RUF_GEOM | RUF_COLOR | RUF_INDEX_DATA | RUF_CACHE_DATA);
 		}
@@ -1040,7 +1269,7 @@ namespace CB
 			bool bNeedReorderCache = false;
 			if (bSupportSIMD)
 			{
-				num = Math::AlignUp(num, FloatVector::Size);
+				num = Math::AlignUp(num, MaxSIMDWidth);
 #if REORDER_CACHE
 				bNeedReorderCache = (context.func->getUsedInputMask() == BIT(0) | BIT(1)) || (context.func->getUsedInputMask() == BIT(0));
 #endif
@@ -1163,7 +1392,20 @@ namespace CB
 				}
 			}
 
-			if (data->getNormalOffset() != INDEX_NONE)
+			if (data->getNormalOffset() != INDEX_NONE && canUseSampleTile(vertexNum))
+			{
+				using namespace Render;
+				VertexElementReader posReader{ data->getVertexData() + data->getPositionOffset() , data->getVertexSize() };
+				VertexElementWriter normalWriter{ data->getVertexData() + data->getNormalOffset() , data->getVertexSize() };
+
+				PROFILE_ENTRY("Update Normal", "CB");
+				int numTileRow = Math::Max(1, SampleTileSize / paramU.numData);
+				executeSampleTiles("CB.SurfaceNormal", paramV.numData, numTileRow, [&](int rowStart, int numRow)
+				{
+					FillGirdMeshNormals(posReader, normalWriter, paramU.numData, paramV.numData, rowStart, rowStart + numRow);
+				});
+			}
+			else if (data->getNormalOffset() != INDEX_NONE)
 			{
 				uint32* pIndexData;
 				if (data->resource)
@@ -1252,25 +1494,40 @@ namespace CB
 			int vertexSize = data->getVertexSize();
 			uint8* colorData = data->getVertexData() + data->getColorOffset();
 			uint8* posData = data->getVertexData() + data->getPositionOffset();
-			for (int i = 0; i < vertexNum; ++i)
+			if (canUseSampleTile(vertexNum))
 			{
-				Color4f* pColor = (Color4f*)(colorData);
-				BYTE temp[3];
+				executeSampleTiles("CB.SurfaceColor", vertexNum, SampleTileSize, [&](int start, int num)
+				{
+					uint8* pColorData = colorData + start * vertexSize;
+					for (int i = 0; i < num; ++i)
+					{
+						*reinterpret_cast<Color4f*>(pColorData) = context.color;
+						pColorData += vertexSize;
+					}
+				});
+			}
+			else
+			{
+				for (int i = 0; i < vertexNum; ++i)
+				{
+					Color4f* pColor = (Color4f*)(colorData);
+					BYTE temp[3];
 #if 0
-				float z = reinterpret_cast<Vector3*>(posData)->z;
-				float zMax = 20;
-				float zMin = 10;
-				float posColor = (z - zMin) / (zMax - zMin);
-				Color3f color;
-				mColorMap.getColor(posColor, color);
-				*pColor = Color4f(color, context.color.a);
-				posData += vertexSize;
+					float z = reinterpret_cast<Vector3*>(posData)->z;
+					float zMax = 20;
+					float zMin = 10;
+					float posColor = (z - zMin) / (zMax - zMin);
+					Color3f color;
+					mColorMap.getColor(posColor, color);
+					*pColor = Color4f(color, context.color.a);
+					posData += vertexSize;
 #else
 
-				*pColor = context.color;
+					*pColor = context.color;
 #endif
-				colorData += vertexSize;
+					colorData += vertexSize;
 
+				}
 			}
 		}
 
@@ -1558,6 +1815,11 @@ namespace CB
 		return true;
 	}
 
+	static bool CanUseWideSIMD(ShapeFuncBase const& func)
+	{
+		return !REORDER_CACHE && isSurface(func.getFuncType()) && func.getUsedInputMask() == (BIT(0) | BIT(1));
+	}
+
 	bool ShapeMeshBuilder::parseFunction(ShapeFuncBase& func)
 	{
 		{
@@ -1566,6 +1828,17 @@ namespace CB
 #endif
 			if (!func.parseExpression(mParser))
 				return false;
+
+			//Only the surface tiles of both inputs evaluate the wide code , the others are compiled with the FloatVector width
+			int simdWidth = mParser.getSIMDWidth();
+			if (simdWidth != FloatVector::Size && func.getEvalType() == EEvalType::CPU && !CanUseWideSIMD(func))
+			{
+				mParser.setSIMDWidth(FloatVector::Size);
+				bool bParsed = func.parseExpression(mParser);
+				mParser.setSIMDWidth(simdWidth);
+				if (!bParsed)
+					return false;
+			}
 		}
 
 		if (func.getEvalType() == EEvalType::GPU)
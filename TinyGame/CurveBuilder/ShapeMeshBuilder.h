@@ -7,6 +7,7 @@
 #include "ColorMap.h"
 
 #include "PlatformThread.h"
+#include "Memory/FrameAllocator.h"
 
 #include "RHI/ShaderCore.h"
 #include "RHI/RHICommand.h"
@@ -20,6 +21,8 @@
 
 #define USE_PARALLEL_UPDATE 0
 
+class QueueThreadPool;
+
 namespace CB
 {
 	class ShapeFuncBase;
@@ -74,6 +77,9 @@ namespace CB
 
 		void  setExecType(ECodeExecType type) { mParser.setExecType(type); }
 		void  setGenerateSIMD(bool bSIMD) { mParser.setGenerateSIMD(bSIMD); }
+		void  setSIMDWidth(int width) { mParser.setSIMDWidth(width); }
+		//Large sample grids are evaluated in tiles on the pool , the builder must not be updated from several threads
+		void  setThreadPool(QueueThreadPool* threadPool) { mThreadPool = threadPool; }
 
 		SymbolTable& getSymbolDefine(){ return mParser.getSymbolDefine(); }
 
@@ -87,6 +93,14 @@ namespace CB
 		void updatePositionData_SurfaceUV(TSurfaceUVFunc* func, SampleParam const &paramU, SampleParam const &paramV, RenderData& data);
 		template< typename TSurfaceXYFunc >
 		void updatePositionData_SurfaceXY(TSurfaceXYFunc* func, SampleParam const &paramU, SampleParam const &paramV, RenderData& data);
+		template< typename TSurfaceUVFunc >
+		static void UpdatePositionTile_SurfaceUV(TSurfaceUVFunc* func, Vector2 const* pUV, uint8* posData, int vertexSize, int numData);
+		template< typename TSurfaceXYFunc >
+		static void UpdatePositionTile_SurfaceXY(TSurfaceXYFunc* func, Vector2 const* pUV, uint8* posData, int vertexSize, int numData);
+
+		bool  canUseSampleTile(int numData) const;
+		template< typename TFunc >
+		void  executeSampleTiles(char const* name, int numData, int tileSize, TFunc&& func);
 
 
 		Render::TStructuredBuffer<VertexGenParamsData> mVertexGenParamBuffer;
@@ -97,6 +111,9 @@ namespace CB
 		ColorMap         mColorMap;
 		RealType*        mTimePtr;
 
+		QueueThreadPool* mThreadPool = nullptr;
+		FrameAllocator   mTaskAllocator;
+
 #if USE_PARALLEL_UPDATE
 		Mutex            mParserLock;
 #endif
@@ -96,6 +96,12 @@ namespace GreedySnake
 		void        warpHeadPos( int w , int h );
 
 		void       reset( Vec2i const& pos , DirType dir, size_t length );
+
+		template< class OP >
+		void serialize( OP&& op )
+		{
+			op & Elements & mIdxTail & mIdxHead;
+		}
 	private:	
 		ElementVec  Elements;
 		unsigned mIdxTail;
@@ -146,6 +152,12 @@ namespace GreedySnake
 		bool       changeMoveDir(DirType dir);
 		SnakeBody& getBody() { return mBody; }
 		DirType    getMoveDir() const { return mMoveDir; }
+
+		template< class OP >
+		void serialize( OP&& op )
+		{
+			op & id & stateBit & moveSpeed & moveCountAcc & frameMoveCount & mMoveDir & mBody;
+		}
 	private:
 		DirType    mMoveDir;
 		SnakeBody  mBody;
@@ -232,6 +244,24 @@ namespace GreedySnake
 
 		bool      getMapPos( Vec2i const& pos , DirType dir , Vec2i& result );
 
+		template< class OP >
+		void serialize( OP&& op )
+		{
+			//Reading an empty array keeps the old elements
+			if ( op.IsLoading )
+				mFoodVec.clear();
+
+			op & mFoodVec & mNumSnakePlay & mMoveSpeed & mMapBoundType;
+			for( int i = 0 ; i < mNumSnakePlay ; ++i )
+				op & mSnakes[i];
+
+			//The map size is set up by the mode , only the tiles change
+			size_t mapDataSize = mMap.getRawDataSize() * sizeof( MapTileData );
+			if ( op.IsLoading )
+				op.serializer.read( mMap.getRawData() , mapDataSize );
+			else
+				op.serializer.write( mMap.getRawData() , mapDataSize );
+		}
 
 	private:
 		void      checkMapBoundCondition(Snake& snake);
@@ -3,6 +3,7 @@
 #include "GreedySnakeLevel.h"
 
 #include "GamePlayer.h"
+#include "Serialize/DataStream.h"
 
 namespace GreedySnake
 {
@@ -102,6 +103,16 @@ namespace GreedySnake
 		}
 	}
 
+	void BattleMode::saveState( IStreamSerializer& serializer )
+	{
+		serializer << mCurRound << mWinRound << mNumAlivePlayer << mNumPlayer;
+	}
+
+	void BattleMode::loadState( IStreamSerializer& serializer )
+	{
+		serializer >> mCurRound >> mWinRound >> mNumAlivePlayer >> mNumPlayer;
+	}
+
 	void BattleMode::onCollideSnake( Snake& snake , Snake& colSnake )
 	{
 		//killSnake(snake);
@@ -29,6 +29,8 @@ namespace GreedySnake
 		void setupLevel( IPlayerManager& playerManager );
 		void prevLevelTick(){}
 		void postLevelTick(){}
+		void saveState( IStreamSerializer& serializer );
+		void loadState( IStreamSerializer& serializer );
 	protected:
 		void onEatFood( Snake& snake , FoodInfo& food );
 		void onCollideSnake( Snake& snake , Snake& colSnake );
@@ -3,6 +3,7 @@
 
 #include "RenderUtility.h"
 #include "GameGraphics2D.h"
+#include "Serialize/DataStream.h"
 
 namespace GreedySnake
 {
@@ -11,6 +12,7 @@ namespace GreedySnake
 		,mLevel( this )
 	{
 		mIsOver = true;
+		mbResimulating = false;
 		mMode.mScene = this;
 	}
 
@@ -34,7 +36,8 @@ namespace GreedySnake
 	if ( trigger.detect( port, ACT )  )\
 	{\
 		snake.changeMoveDir( DIR );\
-		LogMsg("%d : %u change dir %d", mFrame, snake.id, (int)DIR);\
+		if ( !mbResimulating )\
+			LogMsg("%d : %u change dir %d", mFrame, snake.id, (int)DIR);\
 	}
 
 		CHECK_MOVE_ACTION( ACT_GS_MOVE_E , DIR_EAST );
@@ -262,6 +265,20 @@ namespace GreedySnake
 	}
 
 
+	void Scene::saveFrameState( IStreamSerializer& serializer )
+	{
+		serializer << mFrame << mIsOver << mLevel;
+		mMode.saveState( serializer );
+		::Global::SaveRandNetState( serializer );
+	}
+
+	void Scene::loadFrameState( IStreamSerializer& serializer )
+	{
+		serializer >> mFrame >> mIsOver >> mLevel;
+		mMode.loadState( serializer );
+		::Global::LoadRandNetState( serializer );
+	}
+
 	void Scene::killSnake( unsigned id )
 	{
 		if ( !mLevel.addSnakeState( id , SS_DEAD ) )
@@ -3,6 +3,7 @@
 
 #include "GreedySnakeLevel.h"
 #include "GameControl.h"
+#include "INetEngine.h"
 
 class IPlayerManager;
 
@@ -41,6 +42,9 @@ namespace GreedySnake
 		virtual void onEatFood( Snake& info , FoodInfo& food ){}
 		virtual void onCollideSnake( Snake& snake , Snake& colSnake ){}
 		virtual void onCollideTerrain( Snake& snake , int type ){}
+		//Rule state of the mode , saved with the frame state of the scene
+		virtual void saveState( IStreamSerializer& serializer ){}
+		virtual void loadState( IStreamSerializer& serializer ){}
 		Scene& getScene(){ return *mScene; }
 
 
@@ -66,6 +70,7 @@ namespace GreedySnake
 
 	class Scene : public Level::Listener
 		        , public IActionLauncher
+		        , public IFrameStateHandler
 	{
 	public:
 	
@@ -89,6 +94,12 @@ namespace GreedySnake
 		void onCollideTerrain( Snake& snake , int type );
 		//~Level::Listener
 
+		//IFrameStateHandler
+		void saveFrameState( IStreamSerializer& serializer );
+		void loadFrameState( IStreamSerializer& serializer );
+		void setResimulating( bool bResimulating ){ mbResimulating = bResimulating; }
+		//~IFrameStateHandler
+
 		void  fireSnakeAction(ActionPort port, ActionTrigger& trigger);
 		void  fireAction( ActionTrigger& trigger );
 
@@ -108,10 +119,12 @@ namespace GreedySnake
 		void   setOver(){ mIsOver = true; }
 
 		bool   isOver(){ return mIsOver; }
+		bool   isResimulating(){ return mbResimulating; }
 
 
 		long    mFrame;
 		bool    mIsOver;
+		bool    mbResimulating;
 		Level   mLevel;
 		Mode&   mMode;
 	};
@@ -11,9 +11,14 @@
 #include "GameMode.h"
 
 #include "CSyncFrameManager.h"
+#include "CPredictFrameManager.h"
+#include "ConsoleSystem.h"
 
 namespace GreedySnake
 {
+	//Every player of the net game must use the same setting
+	TConsoleVariable< bool > CVarUseRollback{ false , "GreedySnake.UseRollback" , CVF_TOGGLEABLE };
+
 	LevelStage::LevelStage()
 	{
 		mGameMode = NULL;
@@ -96,7 +101,8 @@ namespace GreedySnake
 			break;
 		case EGameState::Run:
 			mScene->tick();
-			if ( mScene->isOver() )
+			//A rolled back game over is handled by the next simulated frame
+			if ( mScene->isOver() && !mScene->isResimulating() )
 				changeState( EGameState::End );
 			break;
 		}
@@ -132,6 +138,11 @@ namespace GreedySnake
 		return NULL;
 	}
 
+	IFrameStateHandler* LevelStage::getFrameStateHandler()
+	{
+		return mScene.get();
+	}
+
 	void LevelStage::onChangeState( EGameState state )
 	{
 		switch ( state )
@@ -169,7 +180,17 @@ namespace GreedySnake
 	{
 		IFrameActionTemplate* actionTemplate = createActionTemplate( LAST_VERSION );
 		INetFrameManager* netFrameMgr;
-		if ( netWorker->isServer() )
+		if ( CVarUseRollback )
+		{
+			//Local input is collected like a client and the inputs of all players are merged like the server does
+			ClientFrameCollector* localCollector = new ClientFrameCollector;
+			ServerFrameCollector* mergeCollector = new ServerFrameCollector( gMaxPlayerNum );
+			if ( netWorker->isServer() )
+				netFrameMgr = new SVPredictFrameManager( netWorker , actionTemplate , localCollector , mergeCollector , getFrameStateHandler() );
+			else
+				netFrameMgr = new CLPredictFrameManager( netWorker , actionTemplate , localCollector , mergeCollector , getFrameStateHandler() );
+		}
+		else if ( netWorker->isServer() )
 		{
 			ServerFrameCollector* frameCollector = new ServerFrameCollector( gMaxPlayerNum );
 			netFrameMgr = new SVSyncFrameManager( netWorker , actionTemplate , frameCollector );
@@ -32,6 +32,7 @@ namespace GreedySnake
 		bool                  queryAttribute( GameAttribute& value );
 		bool                  setupAttribute( GameAttribute const& value );
 		IFrameActionTemplate* createActionTemplate( unsigned version );
+		IFrameStateHandler*   getFrameStateHandler();
 		bool                  setupNetwork( NetWorker* netWorker , INetEngine** engine );
 
 		TPtrHolder< Scene >  mScene;
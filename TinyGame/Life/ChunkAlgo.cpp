@@ -1,6 +1,20 @@
 #include "ChunkAlgo.h"
 #include "BitUtility.h"
 #include "ProfileSystem.h"
+#include "Async/ParallelFor.h"
+
+#if defined(__AVX2__)
+#define LIFE_USE_AVX2 1
+#define LIFE_USE_SSE2 1
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(__SSE2__)
+#define LIFE_USE_AVX2 0
+#define LIFE_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define LIFE_USE_AVX2 0
+#define LIFE_USE_SSE2 0
+#endif
 
 namespace Life
 {
@@ -36,27 +50,6 @@ namespace Life
 			return chunkMap(cPos);
 		}
 
-		void AddBitboard(uint64 bits[], uint64 value)
-		{
-			uint64 carry0 = bits[0] & value;
-			bits[0] ^= value;
-			uint64 carry1 = bits[1] & carry0;
-			bits[1] ^= carry0;
-			uint64 carry2 = bits[2] & carry1;
-			bits[2] ^= carry1;
-
-			bits[3] ^= carry2;
-		}
-
-		uint64 BuildCountMask(uint64 bits[], uint32 count)
-		{
-			uint64 const maskBit0 = (count & 0x1) ? bits[0] : ~bits[0];
-			uint64 const maskBit1 = (count & 0x2) ? bits[1] : ~bits[1];
-			uint64 const maskBit2 = (count & 0x4) ? bits[2] : ~bits[2];
-			uint64 const maskBit3 = (count & 0x8) ? bits[3] : ~bits[3];
-			return maskBit0 & maskBit1 & maskBit2 & maskBit3;
-		}
-
 		uint64 GetRowBits(ChunkAlgo::Chunk const* chunk, int index, int row)
 		{
 			return chunk ? chunk->data[index][row] : 0;
@@ -72,82 +65,171 @@ namespace Life
 			return chunk && (chunk->data[index][row] & ChunkAlgo::Chunk::ToBitMask(0)) ? ChunkAlgo::Chunk::ToBitMask(ChunkAlgo::ChunkLength - 1) : 0;
 		}
 
-		uint32 EvolveChunkRowsBitboard(ChunkAlgo::Chunk& chunk, ChunkAlgo::Chunk const* neighbors[NCI_Count], int indexPrev, int indexNext, Rule const& rule)
+		// Counts of neighbors which give a alive cell , bit n is for count n
+		struct RuleMask
 		{
-			uint32 countAlive = 0;
-			uint64* pChunkData = chunk.data[indexNext];
-			uint64 const* pChunkDataPrev = chunk.data[indexPrev];
-
-			ChunkAlgo::Chunk const* chunkL = neighbors[NCI_Left];
-			ChunkAlgo::Chunk const* chunkR = neighbors[NCI_Right];
-			ChunkAlgo::Chunk const* chunkU = neighbors[NCI_Up];
-			ChunkAlgo::Chunk const* chunkD = neighbors[NCI_Down];
-			ChunkAlgo::Chunk const* chunkUL = neighbors[NCI_UpLeft];
-			ChunkAlgo::Chunk const* chunkUR = neighbors[NCI_UpRight];
-			ChunkAlgo::Chunk const* chunkDL = neighbors[NCI_DownLeft];
-			ChunkAlgo::Chunk const* chunkDR = neighbors[NCI_DownRight];
-
-			for (int j = 0; j < ChunkAlgo::ChunkLength; ++j)
+			RuleMask(Rule const& rule)
 			{
-				uint64 const up = (j > 0) ? pChunkDataPrev[j - 1] : GetRowBits(chunkU, indexPrev, ChunkAlgo::ChunkLength - 1);
-				uint64 const mid = pChunkDataPrev[j];
-				uint64 const down = (j + 1 < ChunkAlgo::ChunkLength) ? pChunkDataPrev[j + 1] : GetRowBits(chunkD, indexPrev, 0);
-
-				int const upRow = (j > 0) ? (j - 1) : (ChunkAlgo::ChunkLength - 1);
-				int const downRow = (j + 1 < ChunkAlgo::ChunkLength) ? (j + 1) : 0;
-
-				uint64 const upLeft = (up << 1) | ((j > 0) ? GetCarryLeft(chunkL, indexPrev, upRow) : GetCarryLeft(chunkUL, indexPrev, upRow));
-				uint64 const upRight = (up >> 1) | ((j > 0) ? GetCarryRight(chunkR, indexPrev, upRow) : GetCarryRight(chunkUR, indexPrev, upRow));
-				uint64 const midLeft = (mid << 1) | GetCarryLeft(chunkL, indexPrev, j);
-				uint64 const midRight = (mid >> 1) | GetCarryRight(chunkR, indexPrev, j);
-				uint64 const downLeft = (down << 1) | ((j + 1 < ChunkAlgo::ChunkLength) ? GetCarryLeft(chunkL, indexPrev, downRow) : GetCarryLeft(chunkDL, indexPrev, downRow));
-				uint64 const downRight = (down >> 1) | ((j + 1 < ChunkAlgo::ChunkLength) ? GetCarryRight(chunkR, indexPrev, downRow) : GetCarryRight(chunkDR, indexPrev, downRow));
-
-				uint64 countBits[4] = { 0 };
-
-				AddBitboard(countBits, upLeft);
-				AddBitboard(countBits, up);
-				AddBitboard(countBits, upRight);
-				AddBitboard(countBits, midLeft);
-				AddBitboard(countBits, midRight);
-				AddBitboard(countBits, downLeft);
-				AddBitboard(countBits, down);
-				AddBitboard(countBits, downRight);
-
-				uint64 next = 0;
-				uint64 const aliveMask = mid;
-				uint64 const deadMask = ~mid;
-#if 1
+				birth = 0;
+				survive = 0;
 				for (uint32 count = 0; count <= 8; ++count)
 				{
-					uint64 const countMask = BuildCountMask(countBits, count);
 					if (rule.getEvoluteValue(count, 0))
-					{
-						next |= countMask & deadMask;
-					}
+						birth |= 1 << count;
 					if (rule.getEvoluteValue(count, 1))
-					{
-						next |= countMask & aliveMask;
-					}
+						survive |= 1 << count;
 				}
-#else
+			}
+			uint32 birth;
+			uint32 survive;
+		};
 
-				{
-					uint64 const countMask = BuildCountMask(countBits, 2);
-					next |= countMask & deadMask;
-				}
-				{
-					uint64 const countMask = BuildCountMask(countBits, 3);
-					next |= countMask & deadMask;
-					next |= countMask & aliveMask;
-				}
+		// Rows are evolved Width at a time , each lane holds one 64 cell row
+		struct FScalarLane
+		{
+			using Type = uint64;
+			static constexpr int Width = 1;
+			static Type Load(uint64 const* ptr) { return *ptr; }
+			static void Store(uint64* ptr, Type value) { *ptr = value; }
+			static Type Zero() { return 0; }
+			static Type Ones() { return ~uint64(0); }
+			static Type And(Type a, Type b) { return a & b; }
+			static Type Or(Type a, Type b) { return a | b; }
+			static Type Xor(Type a, Type b) { return a ^ b; }
+			// ~a & b
+			static Type AndNot(Type a, Type b) { return ~a & b; }
+		};
+
+#if LIFE_USE_SSE2
+		struct FSSE2Lane
+		{
+			using Type = __m128i;
+			static constexpr int Width = 2;
+			static Type Load(uint64 const* ptr) { return _mm_loadu_si128((__m128i const*)ptr); }
+			static void Store(uint64* ptr, Type value) { _mm_storeu_si128((__m128i*)ptr, value); }
+			static Type Zero() { return _mm_setzero_si128(); }
+			static Type Ones() { return _mm_set1_epi32(-1); }
+			static Type And(Type a, Type b) { return _mm_and_si128(a, b); }
+			static Type Or(Type a, Type b) { return _mm_or_si128(a, b); }
+			static Type Xor(Type a, Type b) { return _mm_xor_si128(a, b); }
+			static Type AndNot(Type a, Type b) { return _mm_andnot_si128(a, b); }
+		};
 #endif
 
-				pChunkData[j] = next;
-				countAlive += FBitUtility::CountSet(next);
+#if LIFE_USE_AVX2
+		struct FAVX2Lane
+		{
+			using Type = __m256i;
+			static constexpr int Width = 4;
+			static Type Load(uint64 const* ptr) { return _mm256_loadu_si256((__m256i const*)ptr); }
+			static void Store(uint64* ptr, Type value) { _mm256_storeu_si256((__m256i*)ptr, value); }
+			static Type Zero() { return _mm256_setzero_si256(); }
+			static Type Ones() { return _mm256_set1_epi32(-1); }
+			static Type And(Type a, Type b) { return _mm256_and_si256(a, b); }
+			static Type Or(Type a, Type b) { return _mm256_or_si256(a, b); }
+			static Type Xor(Type a, Type b) { return _mm256_xor_si256(a, b); }
+			static Type AndNot(Type a, Type b) { return _mm256_andnot_si256(a, b); }
+		};
+		using FLane = FAVX2Lane;
+#elif LIFE_USE_SSE2
+		using FLane = FSSE2Lane;
+#else
+		using FLane = FScalarLane;
+#endif
+
+		// Rows of the chunk with one halo row on each side , left and right are the rows shifted with the halo column
+		struct ChunkHalo
+		{
+			uint64 rows[ChunkAlgo::ChunkLength + 2];
+			uint64 lefts[ChunkAlgo::ChunkLength + 2];
+			uint64 rights[ChunkAlgo::ChunkLength + 2];
+		};
+
+		void BuildChunkHalo(ChunkAlgo::Chunk const& chunk, ChunkAlgo::Chunk const* neighbors[NCI_Count], int index, ChunkHalo& outHalo)
+		{
+			int const last = ChunkAlgo::ChunkLength - 1;
+
+			outHalo.rows[0] = GetRowBits(neighbors[NCI_Up], index, last);
+			outHalo.lefts[0] = (outHalo.rows[0] << 1) | GetCarryLeft(neighbors[NCI_UpLeft], index, last);
+			outHalo.rights[0] = (outHalo.rows[0] >> 1) | GetCarryRight(neighbors[NCI_UpRight], index, last);
+
+			ChunkAlgo::Chunk const* chunkL = neighbors[NCI_Left];
+			ChunkAlgo::Chunk const* chunkR = neighbors[NCI_Right];
+			for (int j = 0; j < ChunkAlgo::ChunkLength; ++j)
+			{
+				uint64 const row = chunk.data[index][j];
+				outHalo.rows[j + 1] = row;
+				outHalo.lefts[j + 1] = (row << 1) | GetCarryLeft(chunkL, index, j);
+				outHalo.rights[j + 1] = (row >> 1) | GetCarryRight(chunkR, index, j);
+			}
+
+			outHalo.rows[last + 2] = GetRowBits(neighbors[NCI_Down], index, 0);
+			outHalo.lefts[last + 2] = (outHalo.rows[last + 2] << 1) | GetCarryLeft(neighbors[NCI_DownLeft], index, 0);
+			outHalo.rights[last + 2] = (outHalo.rows[last + 2] >> 1) | GetCarryRight(neighbors[NCI_DownRight], index, 0);
+		}
+
+		template< class TLane >
+		FORCEINLINE void AddBitboard(typename TLane::Type bits[], typename TLane::Type value)
+		{
+			auto carry0 = TLane::And(bits[0], value);
+			bits[0] = TLane::Xor(bits[0], value);
+			auto carry1 = TLane::And(bits[1], carry0);
+			bits[1] = TLane::Xor(bits[1], carry0);
+			auto carry2 = TLane::And(bits[2], carry1);
+			bits[2] = TLane::Xor(bits[2], carry1);
+
+			bits[3] = TLane::Xor(bits[3], carry2);
+		}
+
+		template< class TLane >
+		FORCEINLINE typename TLane::Type BuildCountMask(typename TLane::Type const bits[], uint32 count)
+		{
+			auto mask = TLane::Ones();
+			for (int i = 0; i < 4; ++i)
+			{
+				mask = (count & (1 << i)) ? TLane::And(mask, bits[i]) : TLane::AndNot(bits[i], mask);
 			}
+			return mask;
+		}
+
+		// Bit-parallel adder : 64 cells per lane , all counts of a row are summed into 4 bit planes
+		template< class TLane >
+		void EvolveChunkRows(ChunkHalo const& halo, uint64* pOutRows, RuleMask const& rule)
+		{
+			using Type = typename TLane::Type;
+			static_assert(ChunkAlgo::ChunkLength % TLane::Width == 0, "Chunk rows must be multiple of the lane width");
 
-			return countAlive;
+			for (int j = 0; j < ChunkAlgo::ChunkLength; j += TLane::Width)
+			{
+				Type const mid = TLane::Load(halo.rows + j + 1);
+
+				Type countBits[4] = { TLane::Load(halo.lefts + j), TLane::Zero(), TLane::Zero(), TLane::Zero() };
+				AddBitboard<TLane>(countBits, TLane::Load(halo.rows + j));
+				AddBitboard<TLane>(countBits, TLane::Load(halo.rights + j));
+				AddBitboard<TLane>(countBits, TLane::Load(halo.lefts + j + 1));
+				AddBitboard<TLane>(countBits, TLane::Load(halo.rights + j + 1));
+				AddBitboard<TLane>(countBits, TLane::Load(halo.lefts + j + 2));
+				AddBitboard<TLane>(countBits, TLane::Load(halo.rows + j + 2));
+				AddBitboard<TLane>(countBits, TLane::Load(halo.rights + j + 2));
+
+				Type next = TLane::Zero();
+				for (uint32 count = 0; count <= 8; ++count)
+				{
+					bool const bBirth = !!(rule.birth & (1 << count));
+					bool const bSurvive = !!(rule.survive & (1 << count));
+					if (!bBirth && !bSurvive)
+						continue;
+
+					Type const countMask = BuildCountMask<TLane>(countBits, count);
+					if (bBirth && bSurvive)
+						next = TLane::Or(next, countMask);
+					else if (bBirth)
+						next = TLane::Or(next, TLane::AndNot(mid, countMask));
+					else
+						next = TLane::Or(next, TLane::And(mid, countMask));
+				}
+				TLane::Store(pOutRows + j, next);
+			}
 		}
 
 		bool HasAnyBit(uint64 value)
@@ -268,6 +350,59 @@ namespace Life
 		int indexPrev = mIndex;
 		mIndex = 1 - mIndex;
 
+		updateActiveChunks(indexPrev);
+
+		// Each chunk only writes its own next buffer and reads the previous buffer of the neighbors
+		int const numChunk = mActiveChunks.size();
+		Chunk* const* pChunks = mActiveChunks.data();
+		if (mThreadPool && numChunk > 1)
+		{
+			int const indexNext = mIndex;
+			ParallelFor(*mThreadPool, mTaskAllocator, "ChunkAlgo.Evolve", numChunk, [this, pChunks, indexPrev, indexNext](int index)
+			{
+				evolveChunk(*pChunks[index], indexPrev, indexNext);
+			}, 4);
+		}
+		else
+		{
+			for (int index = 0; index < numChunk; ++index)
+			{
+				evolveChunk(*pChunks[index], indexPrev, mIndex);
+			}
+		}
+	}
+
+	void ChunkAlgo::evolveChunk(Chunk& chunk, int indexPrev, int indexNext)
+	{
+		Chunk const* neighbors[NCI_Count] =
+		{
+			ResolveChunk(mChunkMap, mRule, chunk.pos + Vec2i(-1, 0)),
+			ResolveChunk(mChunkMap, mRule, chunk.pos + Vec2i(1, 0)),
+			ResolveChunk(mChunkMap, mRule, chunk.pos + Vec2i(0, -1)),
+			ResolveChunk(mChunkMap, mRule, chunk.pos + Vec2i(0, 1)),
+			ResolveChunk(mChunkMap, mRule, chunk.pos + Vec2i(-1, -1)),
+			ResolveChunk(mChunkMap, mRule, chunk.pos + Vec2i(1, -1)),
+			ResolveChunk(mChunkMap, mRule, chunk.pos + Vec2i(-1, 1)),
+			ResolveChunk(mChunkMap, mRule, chunk.pos + Vec2i(1, 1)),
+		};
+
+		ChunkHalo halo;
+		BuildChunkHalo(chunk, neighbors, indexPrev, halo);
+
+		uint64* pOutRows = chunk.data[indexNext];
+		EvolveChunkRows<FLane>(halo, pOutRows, RuleMask(mRule));
+#if USE_CHUNK_COUNT
+		uint32 countAlive = 0;
+		for (int j = 0; j < ChunkLength; ++j)
+		{
+			countAlive += FBitUtility::CountSet(pOutRows[j]);
+		}
+		chunk.count = countAlive;
+#endif
+	}
+
+	void ChunkAlgo::updateActiveChunks(int indexPrev)
+	{
 		for (int indexChunk = 0; indexChunk < mActiveChunks.size();)
 		{
 			auto chunk = mActiveChunks[indexChunk];
@@ -403,28 +538,7 @@ namespace Life
 				sleepChunk(chunk, mGeneration);
 				continue;
 			}
-			chunk->count = 0;
 	#endif
-
-			{
-				//PROFILE_ENTRY("ChunkAlgo.Evolve");
-				Chunk const* neighbors[NCI_Count] =
-				{
-					ResolveChunk(mChunkMap, mRule, chunk->pos + Vec2i(-1, 0)),
-					ResolveChunk(mChunkMap, mRule, chunk->pos + Vec2i(1, 0)),
-					ResolveChunk(mChunkMap, mRule, chunk->pos + Vec2i(0, -1)),
-					ResolveChunk(mChunkMap, mRule, chunk->pos + Vec2i(0, 1)),
-					ResolveChunk(mChunkMap, mRule, chunk->pos + Vec2i(-1, -1)),
-					ResolveChunk(mChunkMap, mRule, chunk->pos + Vec2i(1, -1)),
-					ResolveChunk(mChunkMap, mRule, chunk->pos + Vec2i(-1, 1)),
-					ResolveChunk(mChunkMap, mRule, chunk->pos + Vec2i(1, 1)),
-				};
-#if USE_CHUNK_COUNT
-				chunk->count = EvolveChunkRowsBitboard(*chunk, neighbors, indexPrev, mIndex, mRule);
-#else
-				EvolveChunkRowsBitboard(*chunk, neighbors, indexPrev, mIndex, mRule);
-#endif
-			}
 			++indexChunk;
 		}
 	}
@@ -5,6 +5,9 @@
 #include "LifeCore.h"
 #include "BitUtility.h"
 #include "DataStructure/Grid2D.h"
+#include "Memory/FrameAllocator.h"
+
+class QueueThreadPool;
 
 #define USE_CHUNK_COUNT 1
 
@@ -20,6 +23,7 @@ namespace Life
 	{
 	public:
 		ChunkAlgo(int32 x, int32 y)
+			:mTaskAllocator(4096)
 		{
 			mChunkMap.resize(AlignCount(x, ChunkLength), AlignCount(y, ChunkLength));
 			mChunkMap.fillValue(nullptr);
@@ -69,6 +73,10 @@ namespace Life
 
 		virtual void step() final;
 
+		// Active chunks are evolved in parallel when a thread pool is set
+		void setThreadPool(QueueThreadPool* threadPool) { mThreadPool = threadPool; }
+		int  getActiveChunkNum() const { return mActiveChunks.size(); }
+
 		virtual void draw(IRenderer& renderer, Viewport const& viewport, BoundBox const& boundRender);
 
 		IRenderProxy* getRenderProxy() { return this; }
@@ -363,6 +371,10 @@ namespace Life
 			return chunk;
 		}
 
+		// Create or wake the chunks next to the active cells and put the dormant chunks to sleep
+		void  updateActiveChunks(int indexPrev);
+		void  evolveChunk(Chunk& chunk, int indexPrev, int indexNext);
+
 		Rule  mRule;
 		int   mIndex = 0;
 		uint32 mGeneration = 0;
@@ -372,6 +384,9 @@ namespace Life
 		TArray< Chunk* > mActiveChunks;
 		TArray< Chunk* > mSleepingChunks;
 		TArray< Chunk* > mFreeChunks;
+
+		QueueThreadPool* mThreadPool = nullptr;
+		FrameAllocator   mTaskAllocator;
 	};
 
 }//namespace Life
@@ -1,6 +1,7 @@
 #include "HashLifeAlgo.h"
 
 #include "ProfileSystem.h"
+#include "Core/Memory.h"
 
 #include <cassert>
 
@@ -20,17 +21,13 @@ namespace Life
 			return level;
 		}
 
-		bool GetLeafValue(HashLifeAlgo::Node* node)
+		uint32 HashNodeChildren(uint32 nw, uint32 ne, uint32 sw, uint32 se)
 		{
-			return node->population != 0;
-		}
-
-		void FillLevel1Cells(HashLifeAlgo::Node* node, bool outCells[2][2])
-		{
-			outCells[0][0] = GetLeafValue(node->nw);
-			outCells[0][1] = GetLeafValue(node->ne);
-			outCells[1][0] = GetLeafValue(node->sw);
-			outCells[1][1] = GetLeafValue(node->se);
+			uint64 hash = uint64(nw) * 0x9E3779B97F4A7C15ull;
+			hash = (hash ^ ne) * 0xC2B2AE3D27D4EB4Full;
+			hash = (hash ^ sw) * 0x165667B19E3779F9ull;
+			hash = (hash ^ se) * 0x9E3779B97F4A7C15ull;
+			return uint32(hash >> 32);
 		}
 	}
 
@@ -41,14 +38,15 @@ namespace Life
 		mRule.bWarpX = false;
 		mRule.bWarpY = false;
 
-		mDeadLeaf = new Node;
-		mAliveLeaf = new Node;
+		rebuildNodeTable(1024);
 
-		mDeadLeaf->population = 0;
-		mAliveLeaf->population = 1;
+		//index 0 is reserved for NullNode
+		mNextNode = 1;
+		mDeadLeaf = allocNode();
+		mAliveLeaf = allocNode();
+		getNode(mDeadLeaf).population = 0;
+		getNode(mAliveLeaf).population = 1;
 
-		mAllNodes.push_back(mDeadLeaf);
-		mAllNodes.push_back(mAliveLeaf);
 		mEmptyCache.push_back(mDeadLeaf);
 
 		mRootLevel = Math::Max(2, CalcPow2Level(Math::Max(x, y)) + 2);
@@ -58,45 +56,228 @@ namespace Life
 
 	HashLifeAlgo::~HashLifeAlgo()
 	{
-		for (Node* node : mAllNodes)
+		for (Node* slab : mSlabs)
 		{
-			delete node;
+			FMemory::Free(slab);
 		}
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::getLeaf(bool bAlive)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::allocNode()
 	{
-		return bAlive ? mAliveLeaf : mDeadLeaf;
+		NodeIndex index;
+		if (mFreeList != NullNode)
+		{
+			index = mFreeList;
+			mFreeList = getNode(index).nw;
+		}
+		else
+		{
+			if ((mNextNode >> SlabBits) >= mSlabs.size())
+			{
+				mSlabs.push_back((Node*)FMemory::Alloc(sizeof(Node) * SlabSize));
+			}
+			index = mNextNode++;
+		}
+
+		Node& node = getNode(index);
+		node.nw = node.ne = node.sw = node.se = NullNode;
+		node.next = NullNode;
+		node.population = 0;
+		node.level = 0;
+		node.flags = 0;
+		++mNumNode;
+		return index;
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::makeNode(Node* nw, Node* ne, Node* sw, Node* se)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::findOrAddNode(NodeIndex nw, NodeIndex ne, NodeIndex sw, NodeIndex se)
 	{
-		assert(nw && ne && sw && se);
-		assert(nw->level == ne->level);
-		assert(nw->level == sw->level);
-		assert(nw->level == se->level);
+		uint32 slot = HashNodeChildren(nw, ne, sw, se) & mNodeTableMask;
+		while (mNodeTable[slot] != NullNode)
+		{
+			Node const& node = getNode(mNodeTable[slot]);
+			if (node.nw == nw && node.ne == ne && node.sw == sw && node.se == se)
+				return mNodeTable[slot];
+			slot = (slot + 1) & mNodeTableMask;
+		}
 
-		NodeKey key{ nw, ne, sw, se };
-		auto iter = mNodeMap.find(key);
-		if (iter != mNodeMap.end())
+		NodeIndex index = allocNode();
+		Node& node = getNode(index);
+		node.level = getNode(nw).level + 1;
+		node.population = getNode(nw).population + getNode(ne).population + getNode(sw).population + getNode(se).population;
+		node.nw = nw;
+		node.ne = ne;
+		node.sw = sw;
+		node.se = se;
+
+		mNodeTable[slot] = index;
+		++mNumTableNode;
+		//keep load factor under 0.5 , probe sequences stay short
+		if (2 * mNumTableNode > mNodeTable.size())
 		{
-			return iter->second;
+			growNodeTable();
 		}
+		return index;
+	}
 
-		Node* node = new Node;
-		node->level = nw->level + 1;
-		node->population = nw->population + ne->population + sw->population + se->population;
-		node->nw = nw;
-		node->ne = ne;
-		node->sw = sw;
-		node->se = se;
+	void HashLifeAlgo::growNodeTable()
+	{
+		rebuildNodeTable(2 * mNodeTable.size());
+	}
 
-		mAllNodes.push_back(node);
-		mNodeMap.emplace(key, node);
-		return node;
+	void HashLifeAlgo::rebuildNodeTable(uint32 capacity)
+	{
+		mNodeTable.clear();
+		mNodeTable.resize(capacity, NullNode);
+		mNodeTableMask = capacity - 1;
+		mNumTableNode = 0;
+
+		for (NodeIndex index = 1; index < mNextNode; ++index)
+		{
+			Node const& node = getNode(index);
+			if (node.level == 0 || (node.flags & NF_Free))
+				continue;
+
+			uint32 slot = HashNodeChildren(node.nw, node.ne, node.sw, node.se) & mNodeTableMask;
+			while (mNodeTable[slot] != NullNode)
+			{
+				slot = (slot + 1) & mNodeTableMask;
+			}
+			mNodeTable[slot] = index;
+			++mNumTableNode;
+		}
+	}
+
+	size_t HashLifeAlgo::getMemoryUsage() const
+	{
+		return mSlabs.size() * SlabSize * sizeof(Node) +
+			mNodeTable.size() * sizeof(NodeIndex) +
+			mAdvanceMap.capacity() * (sizeof(uint64) + sizeof(AdvanceResult) + 1);
+	}
+
+	void HashLifeAlgo::markNode(NodeIndex index, bool bFollowNext)
+	{
+		TArray< NodeIndex > stack;
+		stack.push_back(index);
+		while (!stack.empty())
+		{
+			NodeIndex cur = stack.back();
+			stack.pop_back();
+			if (cur == NullNode)
+				continue;
+
+			Node& node = getNode(cur);
+			if (node.flags & NF_Marked)
+				continue;
+
+			node.flags |= NF_Marked;
+			if (node.level == 0)
+				continue;
+
+			stack.push_back(node.nw);
+			stack.push_back(node.ne);
+			stack.push_back(node.sw);
+			stack.push_back(node.se);
+			if (bFollowNext)
+			{
+				stack.push_back(node.next);
+			}
+		}
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::makeEmpty(uint32 level)
+	void HashLifeAlgo::collectGarbage(bool bKeepCaches)
+	{
+		PROFILE_ENTRY("HashLife.GC");
+
+		markNode(mDeadLeaf, false);
+		markNode(mAliveLeaf, false);
+		markNode(mRoot, bKeepCaches);
+		for (NodeIndex index : mEmptyCache)
+		{
+			markNode(index, bKeepCaches);
+		}
+
+		THashMap< uint64, AdvanceResult > keepResults;
+		if (bKeepCaches)
+		{
+			// Only keep the advance results used by the current and the last call
+			for (auto const& pair : mAdvanceMap)
+			{
+				if (pair.second.epoch + 1 < mEpoch)
+					continue;
+
+				markNode(NodeIndex(pair.first >> 8), true);
+				markNode(pair.second.node, true);
+				keepResults.insert(pair.first, pair.second);
+			}
+		}
+		mAdvanceMap = std::move(keepResults);
+
+		mFreeList = NullNode;
+		for (NodeIndex index = mNextNode - 1; index > 0; --index)
+		{
+			Node& node = getNode(index);
+			if (node.flags & NF_Marked)
+			{
+				node.flags &= ~NF_Marked;
+				if (!bKeepCaches)
+				{
+					node.next = NullNode;
+				}
+			}
+			else
+			{
+				if (!(node.flags & NF_Free))
+				{
+					node.flags = NF_Free;
+					--mNumNode;
+				}
+				node.nw = mFreeList;
+				mFreeList = index;
+			}
+		}
+
+		uint32 capacity = 1024;
+		while (capacity < 2 * uint32(mNumNode))
+		{
+			capacity *= 2;
+		}
+		rebuildNodeTable(capacity);
+	}
+
+	void HashLifeAlgo::collectGarbageIfNeeded()
+	{
+		if (getMemoryUsage() <= mMemoryBudget)
+			return;
+
+		// Slabs are not released , so the budget is checked by the number of live nodes
+		size_t const nodeBudget = mMemoryBudget / (sizeof(Node) + 2 * sizeof(NodeIndex));
+		if (size_t(mNumNode) <= nodeBudget / 2)
+			return;
+
+		collectGarbage(true);
+		if (size_t(mNumNode) > nodeBudget / 2)
+		{
+			// Cached results alone fill the budget , drop all of them
+			collectGarbage(false);
+		}
+	}
+
+	HashLifeAlgo::NodeIndex HashLifeAlgo::getLeaf(bool bAlive)
+	{
+		return bAlive ? mAliveLeaf : mDeadLeaf;
+	}
+
+	HashLifeAlgo::NodeIndex HashLifeAlgo::makeNode(NodeIndex nw, NodeIndex ne, NodeIndex sw, NodeIndex se)
+	{
+		assert(nw && ne && sw && se);
+		assert(getNode(nw).level == getNode(ne).level);
+		assert(getNode(nw).level == getNode(sw).level);
+		assert(getNode(nw).level == getNode(se).level);
+
+		return findOrAddNode(nw, ne, sw, se);
+	}
+
+	HashLifeAlgo::NodeIndex HashLifeAlgo::makeEmpty(uint32 level)
 	{
 		if (level == 0)
 		{
@@ -104,22 +285,22 @@ namespace Life
 		}
 		while (mEmptyCache.size() <= level)
 		{
-			mEmptyCache.push_back(nullptr);
+			mEmptyCache.push_back(NullNode);
 		}
 		for (uint32 i = 1; i <= level; ++i)
 		{
-			if (mEmptyCache[i] == nullptr)
+			if (mEmptyCache[i] == NullNode)
 			{
-				Node* child = makeEmpty(i - 1);
+				NodeIndex child = makeEmpty(i - 1);
 				mEmptyCache[i] = makeNode(child, child, child, child);
 			}
 		}
 		return mEmptyCache[level];
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::setCell(Node* node, uint32 level, int x, int y, bool value)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::setCell(NodeIndex node, uint32 level, int x, int y, bool value)
 	{
-		if (node == nullptr)
+		if (node == NullNode)
 		{
 			node = makeEmpty(level);
 		}
@@ -129,10 +310,11 @@ namespace Life
 		}
 
 		int halfSize = 1 << (level - 1);
-		Node* nw = node->nw;
-		Node* ne = node->ne;
-		Node* sw = node->sw;
-		Node* se = node->se;
+		Node const& data = getNode(node);
+		NodeIndex nw = data.nw;
+		NodeIndex ne = data.ne;
+		NodeIndex sw = data.sw;
+		NodeIndex se = data.se;
 
 		if (y < halfSize)
 		{
@@ -152,87 +334,99 @@ namespace Life
 		return makeNode(nw, ne, sw, se);
 	}
 
-	bool HashLifeAlgo::getCell(Node* node, uint32 level, int x, int y) const
+	bool HashLifeAlgo::getCell(NodeIndex node, uint32 level, int x, int y) const
 	{
-		if (node->population == 0)
+		Node const& data = getNode(node);
+		if (data.population == 0)
 			return false;
 		if (level == 0)
-			return node->population != 0;
+			return data.population != 0;
 
 		int halfSize = 1 << (level - 1);
 		if (y < halfSize)
 		{
 			if (x < halfSize)
-				return getCell(node->nw, level - 1, x, y);
-			return getCell(node->ne, level - 1, x - halfSize, y);
+				return getCell(data.nw, level - 1, x, y);
+			return getCell(data.ne, level - 1, x - halfSize, y);
 		}
 		if (x < halfSize)
-			return getCell(node->sw, level - 1, x, y - halfSize);
-		return getCell(node->se, level - 1, x - halfSize, y - halfSize);
+			return getCell(data.sw, level - 1, x, y - halfSize);
+		return getCell(data.se, level - 1, x - halfSize, y - halfSize);
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::centeredSubnode(Node* node)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::centeredSubnode(NodeIndex node)
 	{
-		return makeNode(node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+		Node const& n = getNode(node);
+		return makeNode(getNode(n.nw).se, getNode(n.ne).sw, getNode(n.sw).ne, getNode(n.se).nw);
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::centeredHorizontal(Node* left, Node* right)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::centeredHorizontal(NodeIndex left, NodeIndex right)
 	{
-		return makeNode(left->ne->se, right->nw->sw, left->se->ne, right->sw->nw);
+		Node const& l = getNode(left);
+		Node const& r = getNode(right);
+		return makeNode(getNode(l.ne).se, getNode(r.nw).sw, getNode(l.se).ne, getNode(r.sw).nw);
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::centeredVertical(Node* top, Node* bottom)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::centeredVertical(NodeIndex top, NodeIndex bottom)
 	{
-		return makeNode(top->sw->se, top->se->sw, bottom->nw->ne, bottom->ne->nw);
+		Node const& t = getNode(top);
+		Node const& b = getNode(bottom);
+		return makeNode(getNode(t.sw).se, getNode(t.se).sw, getNode(b.nw).ne, getNode(b.ne).nw);
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::centeredSubSubnode(Node* node)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::centeredSubSubnode(NodeIndex node)
 	{
-		return makeNode(node->nw->se->se, node->ne->sw->sw, node->sw->ne->ne, node->se->nw->nw);
+		Node const& n = getNode(node);
+		return makeNode(
+			getNode(getNode(n.nw).se).se, getNode(getNode(n.ne).sw).sw,
+			getNode(getNode(n.sw).ne).ne, getNode(getNode(n.se).nw).nw);
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::middleHorizontal(Node* left, Node* right)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::middleHorizontal(NodeIndex left, NodeIndex right)
 	{
-		return makeNode(left->ne, right->nw, left->se, right->sw);
+		Node const& l = getNode(left);
+		Node const& r = getNode(right);
+		return makeNode(l.ne, r.nw, l.se, r.sw);
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::middleVertical(Node* top, Node* bottom)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::middleVertical(NodeIndex top, NodeIndex bottom)
 	{
-		return makeNode(top->sw, top->se, bottom->nw, bottom->ne);
+		Node const& t = getNode(top);
+		Node const& b = getNode(bottom);
+		return makeNode(t.sw, t.se, b.nw, b.ne);
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::expandRoot(Node* node)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::expandRoot(NodeIndex node)
 	{
-		Node* empty = makeEmpty(node->level - 1);
-		Node* nw = makeNode(empty, empty, empty, node->nw);
-		Node* ne = makeNode(empty, empty, node->ne, empty);
-		Node* sw = makeNode(empty, node->sw, empty, empty);
-		Node* se = makeNode(node->se, empty, empty, empty);
+		Node const& n = getNode(node);
+		NodeIndex empty = makeEmpty(n.level - 1);
+		NodeIndex nw = makeNode(empty, empty, empty, n.nw);
+		NodeIndex ne = makeNode(empty, empty, n.ne, empty);
+		NodeIndex sw = makeNode(empty, n.sw, empty, empty);
+		NodeIndex se = makeNode(n.se, empty, empty, empty);
 		return makeNode(nw, ne, sw, se);
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::calcBaseSuccessor(Node* node)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::calcBaseSuccessor(NodeIndex node)
 	{
 		bool cells[4][4] = {};
-		bool block[2][2];
-
-		FillLevel1Cells(node->nw, block);
-		cells[0][0] = block[0][0]; cells[0][1] = block[0][1];
-		cells[1][0] = block[1][0]; cells[1][1] = block[1][1];
-
-		FillLevel1Cells(node->ne, block);
-		cells[0][2] = block[0][0]; cells[0][3] = block[0][1];
-		cells[1][2] = block[1][0]; cells[1][3] = block[1][1];
-
-		FillLevel1Cells(node->sw, block);
-		cells[2][0] = block[0][0]; cells[2][1] = block[0][1];
-		cells[3][0] = block[1][0]; cells[3][1] = block[1][1];
 
-		FillLevel1Cells(node->se, block);
-		cells[2][2] = block[0][0]; cells[2][3] = block[0][1];
-		cells[3][2] = block[1][0]; cells[3][3] = block[1][1];
-
-		Node* result[2][2];
+		auto FillLevel1Cells = [this, &cells](NodeIndex index, int ox, int oy)
+		{
+			Node const& n = getNode(index);
+			cells[oy + 0][ox + 0] = getNode(n.nw).population != 0;
+			cells[oy + 0][ox + 1] = getNode(n.ne).population != 0;
+			cells[oy + 1][ox + 0] = getNode(n.sw).population != 0;
+			cells[oy + 1][ox + 1] = getNode(n.se).population != 0;
+		};
+
+		Node const& n = getNode(node);
+		FillLevel1Cells(n.nw, 0, 0);
+		FillLevel1Cells(n.ne, 2, 0);
+		FillLevel1Cells(n.sw, 0, 2);
+		FillLevel1Cells(n.se, 2, 2);
+
+		NodeIndex result[2][2];
 		for (int y = 0; y < 2; ++y)
 		{
 			for (int x = 0; x < 2; ++x)
@@ -256,67 +450,69 @@ namespace Life
 		return makeNode(result[0][0], result[0][1], result[1][0], result[1][1]);
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::calcSuccessor(Node* node)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::calcSuccessor(NodeIndex node)
 	{
 		assert(node);
-		assert(node->level >= 2);
-
-		if (node->next)
-			return node->next;
-		if (node->population == 0)
-			return node->next = makeEmpty(node->level - 1);
-		if (node->level == 2)
-			return node->next = calcBaseSuccessor(node);
-
-		Node* n00 = centeredSubnode(node->nw);
-		Node* n01 = centeredHorizontal(node->nw, node->ne);
-		Node* n02 = centeredSubnode(node->ne);
-		Node* n10 = centeredVertical(node->nw, node->sw);
-		Node* n11 = centeredSubSubnode(node);
-		Node* n12 = centeredVertical(node->ne, node->se);
-		Node* n20 = centeredSubnode(node->sw);
-		Node* n21 = centeredHorizontal(node->sw, node->se);
-		Node* n22 = centeredSubnode(node->se);
-
-		Node* nodeNW = makeNode(n00, n01, n10, n11);
-		Node* nodeNE = makeNode(n01, n02, n11, n12);
-		Node* nodeSW = makeNode(n10, n11, n20, n21);
-		Node* nodeSE = makeNode(n11, n12, n21, n22);
-
-		assert(nodeNW->level + 1 == node->level);
-		assert(nodeNE->level + 1 == node->level);
-		assert(nodeSW->level + 1 == node->level);
-		assert(nodeSE->level + 1 == node->level);
-
-		Node* nw = calcSuccessor(nodeNW);
-		Node* ne = calcSuccessor(nodeNE);
-		Node* sw = calcSuccessor(nodeSW);
-		Node* se = calcSuccessor(nodeSE);
-
-		node->next = makeNode(nw, ne, sw, se);
-		assert(node->next->level + 1 == node->level);
-		return node->next;
-	}
-
-	HashLifeAlgo::Node* HashLifeAlgo::calcFastSuccessor(Node* node)
+		Node& data = getNode(node);
+		assert(data.level >= 2);
+
+		if (data.next)
+			return data.next;
+		if (data.population == 0)
+			return data.next = makeEmpty(data.level - 1);
+		if (data.level == 2)
+			return data.next = calcBaseSuccessor(node);
+
+		NodeIndex n00 = centeredSubnode(data.nw);
+		NodeIndex n01 = centeredHorizontal(data.nw, data.ne);
+		NodeIndex n02 = centeredSubnode(data.ne);
+		NodeIndex n10 = centeredVertical(data.nw, data.sw);
+		NodeIndex n11 = centeredSubSubnode(node);
+		NodeIndex n12 = centeredVertical(data.ne, data.se);
+		NodeIndex n20 = centeredSubnode(data.sw);
+		NodeIndex n21 = centeredHorizontal(data.sw, data.se);
+		NodeIndex n22 = centeredSubnode(data.se);
+
+		NodeIndex nodeNW = makeNode(n00, n01, n10, n11);
+		NodeIndex nodeNE = makeNode(n01, n02, n11, n12);
+		NodeIndex nodeSW = makeNode(n10, n11, n20, n21);
+		NodeIndex nodeSE = makeNode(n11, n12, n21, n22);
+
+		assert(getNode(nodeNW).level + 1 == data.level);
+		assert(getNode(nodeNE).level + 1 == data.level);
+		assert(getNode(nodeSW).level + 1 == data.level);
+		assert(getNode(nodeSE).level + 1 == data.level);
+
+		NodeIndex nw = calcSuccessor(nodeNW);
+		NodeIndex ne = calcSuccessor(nodeNE);
+		NodeIndex sw = calcSuccessor(nodeSW);
+		NodeIndex se = calcSuccessor(nodeSE);
+
+		data.next = makeNode(nw, ne, sw, se);
+		assert(getNode(data.next).level + 1 == data.level);
+		return data.next;
+	}
+
+	HashLifeAlgo::NodeIndex HashLifeAlgo::calcFastSuccessor(NodeIndex node)
 	{
 		assert(node);
-		assert(node->level >= 2);
+		Node const& data = getNode(node);
+		assert(data.level >= 2);
 
-		if (node->population == 0)
-			return makeEmpty(node->level - 1);
-		if (node->level == 2)
+		if (data.population == 0)
+			return makeEmpty(data.level - 1);
+		if (data.level == 2)
 			return calcBaseSuccessor(node);
 
-		Node* x0 = calcFastSuccessor(node->nw);
-		Node* x1 = calcFastSuccessor(middleHorizontal(node->nw, node->ne));
-		Node* x2 = calcFastSuccessor(node->ne);
-		Node* x3 = calcFastSuccessor(middleVertical(node->nw, node->sw));
-		Node* x4 = calcFastSuccessor(centeredSubnode(node));
-		Node* x5 = calcFastSuccessor(middleVertical(node->ne, node->se));
-		Node* x6 = calcFastSuccessor(node->sw);
-		Node* x7 = calcFastSuccessor(middleHorizontal(node->sw, node->se));
-		Node* x8 = calcFastSuccessor(node->se);
+		NodeIndex x0 = calcFastSuccessor(data.nw);
+		NodeIndex x1 = calcFastSuccessor(middleHorizontal(data.nw, data.ne));
+		NodeIndex x2 = calcFastSuccessor(data.ne);
+		NodeIndex x3 = calcFastSuccessor(middleVertical(data.nw, data.sw));
+		NodeIndex x4 = calcFastSuccessor(centeredSubnode(node));
+		NodeIndex x5 = calcFastSuccessor(middleVertical(data.ne, data.se));
+		NodeIndex x6 = calcFastSuccessor(data.sw);
+		NodeIndex x7 = calcFastSuccessor(middleHorizontal(data.sw, data.se));
+		NodeIndex x8 = calcFastSuccessor(data.se);
 
 		return makeNode(
 			calcFastSuccessor(makeNode(x0, x1, x3, x4)),
@@ -326,50 +522,52 @@ namespace Life
 		);
 	}
 
-	HashLifeAlgo::Node* HashLifeAlgo::calcAdvance(Node* node, uint32 exp)
+	HashLifeAlgo::NodeIndex HashLifeAlgo::calcAdvance(NodeIndex node, uint32 exp)
 	{
 		assert(node);
-		assert(node->level >= exp + 2);
+		Node const& data = getNode(node);
+		assert(data.level >= exp + 2);
 
-		AdvanceKey key{ node, exp };
-		auto iter = mAdvanceMap.find(key);
-		if (iter != mAdvanceMap.end())
+		uint64 key = MakeAdvanceKey(node, exp);
+		AdvanceResult* cached = mAdvanceMap.findValue(key);
+		if (cached)
 		{
-			return iter->second;
+			cached->epoch = mEpoch;
+			return cached->node;
 		}
 
-		if (node->population == 0)
-			return makeEmpty(node->level - 1);
+		if (data.population == 0)
+			return makeEmpty(data.level - 1);
 
-		if (node->level == exp + 2)
+		if (data.level == exp + 2)
 		{
-			Node* result = (exp == 0) ? calcSuccessor(node) : calcFastSuccessor(node);
-			mAdvanceMap.emplace(key, result);
+			NodeIndex result = (exp == 0) ? calcSuccessor(node) : calcFastSuccessor(node);
+			mAdvanceMap.insert(key, AdvanceResult{ result, mEpoch });
 			return result;
 		}
 
-		Node* n00 = centeredSubnode(node->nw);
-		Node* n01 = centeredHorizontal(node->nw, node->ne);
-		Node* n02 = centeredSubnode(node->ne);
-		Node* n10 = centeredVertical(node->nw, node->sw);
-		Node* n11 = centeredSubSubnode(node);
-		Node* n12 = centeredVertical(node->ne, node->se);
-		Node* n20 = centeredSubnode(node->sw);
-		Node* n21 = centeredHorizontal(node->sw, node->se);
-		Node* n22 = centeredSubnode(node->se);
-
-		Node* nodeNW = makeNode(n00, n01, n10, n11);
-		Node* nodeNE = makeNode(n01, n02, n11, n12);
-		Node* nodeSW = makeNode(n10, n11, n20, n21);
-		Node* nodeSE = makeNode(n11, n12, n21, n22);
-
-		Node* nw = calcAdvance(nodeNW, exp);
-		Node* ne = calcAdvance(nodeNE, exp);
-		Node* sw = calcAdvance(nodeSW, exp);
-		Node* se = calcAdvance(nodeSE, exp);
-
-		Node* result = makeNode(nw, ne, sw, se);
-		mAdvanceMap.emplace(key, result);
+		NodeIndex n00 = centeredSubnode(data.nw);
+		NodeIndex n01 = centeredHorizontal(data.nw, data.ne);
+		NodeIndex n02 = centeredSubnode(data.ne);
+		NodeIndex n10 = centeredVertical(data.nw, data.sw);
+		NodeIndex n11 = centeredSubSubnode(node);
+		NodeIndex n12 = centeredVertical(data.ne, data.se);
+		NodeIndex n20 = centeredSubnode(data.sw);
+		NodeIndex n21 = centeredHorizontal(data.sw, data.se);
+		NodeIndex n22 = centeredSubnode(data.se);
+
+		NodeIndex nodeNW = makeNode(n00, n01, n10, n11);
+		NodeIndex nodeNE = makeNode(n01, n02, n11, n12);
+		NodeIndex nodeSW = makeNode(n10, n11, n20, n21);
+		NodeIndex nodeSE = makeNode(n11, n12, n21, n22);
+
+		NodeIndex nw = calcAdvance(nodeNW, exp);
+		NodeIndex ne = calcAdvance(nodeNE, exp);
+		NodeIndex sw = calcAdvance(nodeSW, exp);
+		NodeIndex se = calcAdvance(nodeSE, exp);
+
+		NodeIndex result = makeNode(nw, ne, sw, se);
+		mAdvanceMap.insert(key, AdvanceResult{ result, mEpoch });
 		return result;
 	}
 
@@ -394,6 +592,7 @@ namespace Life
 	{
 		mRoot = makeEmpty(mRootLevel);
 		mBoundDirty = true;
+		collectGarbageIfNeeded();
 	}
 
 	BoundBox HashLifeAlgo::getBound()
@@ -414,9 +613,10 @@ namespace Life
 	}
 
 	template< class Func >
-	void HashLifeAlgo::visitLiveCells(Node* node, int x, int y, int size, Func&& func) const
+	void HashLifeAlgo::visitLiveCells(NodeIndex node, int x, int y, int size, Func&& func) const
 	{
-		if (node->population == 0)
+		Node const& data = getNode(node);
+		if (data.population == 0)
 			return;
 		if (size == 1)
 		{
@@ -425,16 +625,16 @@ namespace Life
 		}
 
 		int half = size / 2;
-		visitLiveCells(node->nw, x, y, half, func);
-		visitLiveCells(node->ne, x + half, y, half, func);
-		visitLiveCells(node->sw, x, y + half, half, func);
-		visitLiveCells(node->se, x + half, y + half, half, func);
+		visitLiveCells(data.nw, x, y, half, func);
+		visitLiveCells(data.ne, x + half, y, half, func);
+		visitLiveCells(data.sw, x, y + half, half, func);
+		visitLiveCells(data.se, x + half, y + half, half, func);
 	}
 
 	void HashLifeAlgo::updateBoundCache()
 	{
 		mBoundCache.invalidate();
-		if (mRoot->population == 0)
+		if (getNode(mRoot).population == 0)
 		{
 			mBoundDirty = false;
 			return;
@@ -480,12 +680,14 @@ namespace Life
 	void HashLifeAlgo::step()
 	{
 		PROFILE_ENTRY("HashLife.Step");
-		if (mRoot->population == 0)
+		if (getNode(mRoot).population == 0)
 			return;
 
+		++mEpoch;
+		collectGarbageIfNeeded();
 		mRoot = expandRoot(mRoot);
 		mRoot = calcSuccessor(mRoot);
-		mRootLevel = mRoot->level;
+		mRootLevel = getNode(mRoot).level;
 		mBoundDirty = true;
 	}
 
@@ -495,11 +697,15 @@ namespace Life
 			return;
 
 		PROFILE_ENTRY("HashLife.Evaluate");
+		++mEpoch;
 		while (nStep > 0)
 		{
-			if (mRoot->population == 0)
+			if (getNode(mRoot).population == 0)
 				break;
 
+			// Only mRoot is alive between two advances , it is safe to collect here
+			collectGarbageIfNeeded();
+
 			uint32 exp = 0;
 			while ((1 << (exp + 1)) <= nStep)
 			{
@@ -512,9 +718,9 @@ namespace Life
 				exp = maxExp;
 			}
 
-			Node* workRoot = expandRoot(mRoot);
+			NodeIndex workRoot = expandRoot(mRoot);
 			mRoot = calcAdvance(workRoot, exp);
-			mRootLevel = mRoot->level;
+			mRootLevel = getNode(mRoot).level;
 			nStep -= (1 << exp);
 		}
 		mBoundDirty = true;
@@ -4,7 +4,9 @@
 
 #include "LifeCore.h"
 
-#include <unordered_map>
+#include "DataStructure/HashMap.h"
+
+#include <cassert>
 
 namespace Life
 {
@@ -27,92 +29,113 @@ namespace Life
 		void draw(IRenderer& renderer, Viewport const& viewport, BoundBox const& boundRender) final;
 		IRenderProxy* getRenderProxy() final { return this; }
 
+		using NodeIndex = uint32;
+		static constexpr NodeIndex NullNode = 0;
+
+		// Children are 32-bit indices into the node arena , a free node links the free list with nw
 		struct Node
 		{
-			uint32 level = 0;
-			uint32 population = 0;
-			Node* nw = nullptr;
-			Node* ne = nullptr;
-			Node* sw = nullptr;
-			Node* se = nullptr;
-			Node* next = nullptr;
+			NodeIndex nw;
+			NodeIndex ne;
+			NodeIndex sw;
+			NodeIndex se;
+			// cached result of calcSuccessor
+			NodeIndex next;
+			uint32 population;
+			uint16 level;
+			uint16 flags;
 		};
 
+		// Garbage collection is triggered when the memory usage exceeds the budget
+		void   setMemoryBudget(size_t budget) { mMemoryBudget = budget; }
+		size_t getMemoryBudget() const { return mMemoryBudget; }
+		size_t getMemoryUsage() const;
+		int    getNodeNum() const { return mNumNode; }
+		void   collectGarbage(bool bKeepCaches = true);
+
 	private:
-		struct NodeKey
+		enum ENodeFlag : uint16
 		{
-			Node* nw;
-			Node* ne;
-			Node* sw;
-			Node* se;
-
-			bool operator == (NodeKey const& rhs) const
-			{
-				return nw == rhs.nw && ne == rhs.ne && sw == rhs.sw && se == rhs.se;
-			}
+			NF_Marked = 0x1,
+			NF_Free = 0x2,
 		};
 
-		struct NodeKeyHash
-		{
-			size_t operator()(NodeKey const& key) const
-			{
-				return HashValues(key.nw, key.ne, key.sw, key.se);
-			}
-		};
+		static constexpr int    SlabBits = 16;
+		static constexpr uint32 SlabSize = 1 << SlabBits;
+		static constexpr uint32 SlabMask = SlabSize - 1;
 
-		struct AdvanceKey
+		Node& getNode(NodeIndex index) const
 		{
-			Node* node;
-			uint32 exp;
-
-			bool operator == (AdvanceKey const& rhs) const
-			{
-				return node == rhs.node && exp == rhs.exp;
-			}
-		};
+			assert(index != NullNode);
+			return mSlabs[index >> SlabBits][index & SlabMask];
+		}
 
-		struct AdvanceKeyHash
+		struct AdvanceResult
 		{
-			size_t operator()(AdvanceKey const& key) const
-			{
-				return HashValues(key.node, key.exp);
-			}
+			NodeIndex node;
+			// advance calls this result was used
+			uint32 epoch;
 		};
 
-		Node* getLeaf(bool bAlive);
-		Node* makeNode(Node* nw, Node* ne, Node* sw, Node* se);
-		Node* makeEmpty(uint32 level);
-		Node* setCell(Node* node, uint32 level, int x, int y, bool value);
-		bool  getCell(Node* node, uint32 level, int x, int y) const;
-
-		Node* centeredSubnode(Node* node);
-		Node* centeredHorizontal(Node* left, Node* right);
-		Node* centeredVertical(Node* top, Node* bottom);
-		Node* centeredSubSubnode(Node* node);
-		Node* middleHorizontal(Node* left, Node* right);
-		Node* middleVertical(Node* top, Node* bottom);
-		Node* calcFastSuccessor(Node* node);
-		Node* expandRoot(Node* node);
-		Node* calcSuccessor(Node* node);
-		Node* calcAdvance(Node* node, uint32 exp);
-		Node* calcBaseSuccessor(Node* node);
+		static uint64 MakeAdvanceKey(NodeIndex node, uint32 exp)
+		{
+			return (uint64(node) << 8) | exp;
+		}
+
+		NodeIndex allocNode();
+		NodeIndex findOrAddNode(NodeIndex nw, NodeIndex ne, NodeIndex sw, NodeIndex se);
+		void      growNodeTable();
+		void      rebuildNodeTable(uint32 capacity);
+		void      markNode(NodeIndex index, bool bFollowNext);
+		void      collectGarbageIfNeeded();
+
+		NodeIndex getLeaf(bool bAlive);
+		NodeIndex makeNode(NodeIndex nw, NodeIndex ne, NodeIndex sw, NodeIndex se);
+		NodeIndex makeEmpty(uint32 level);
+		NodeIndex setCell(NodeIndex node, uint32 level, int x, int y, bool value);
+		bool      getCell(NodeIndex node, uint32 level, int x, int y) const;
+
+		NodeIndex centeredSubnode(NodeIndex node);
+		NodeIndex centeredHorizontal(NodeIndex left, NodeIndex right);
+		NodeIndex centeredVertical(NodeIndex top, NodeIndex bottom);
+		NodeIndex centeredSubSubnode(NodeIndex node);
+		NodeIndex middleHorizontal(NodeIndex left, NodeIndex right);
+		NodeIndex middleVertical(NodeIndex top, NodeIndex bottom);
+		NodeIndex calcFastSuccessor(NodeIndex node);
+		NodeIndex expandRoot(NodeIndex node);
+		NodeIndex calcSuccessor(NodeIndex node);
+		NodeIndex calcAdvance(NodeIndex node, uint32 exp);
+		NodeIndex calcBaseSuccessor(NodeIndex node);
 
 		template< class Func >
-		void visitLiveCells(Node* node, int x, int y, int size, Func&& func) const;
+		void visitLiveCells(NodeIndex node, int x, int y, int size, Func&& func) const;
 
 		void updateBoundCache();
 
 		int mWidth = 0;
 		int mHeight = 0;
 		uint32 mRootLevel = 0;
-		Node* mRoot = nullptr;
-
-		Node* mDeadLeaf = nullptr;
-		Node* mAliveLeaf = nullptr;
-		std::unordered_map<NodeKey, Node*, NodeKeyHash> mNodeMap;
-		std::unordered_map<AdvanceKey, Node*, AdvanceKeyHash> mAdvanceMap;
-		TArray<Node*> mEmptyCache;
-		TArray<Node*> mAllNodes;
+		NodeIndex mRoot = NullNode;
+
+		NodeIndex mDeadLeaf = NullNode;
+		NodeIndex mAliveLeaf = NullNode;
+
+		// Node arena , slabs are never moved so Node& stay valid until the node is collected
+		TArray< Node* > mSlabs;
+		NodeIndex mFreeList = NullNode;
+		NodeIndex mNextNode = 0;
+		int       mNumNode = 0;
+
+		// Open addressing hash-cons table with linear probing , NullNode is empty slot
+		TArray< NodeIndex > mNodeTable;
+		uint32 mNodeTableMask = 0;
+		uint32 mNumTableNode = 0;
+
+		THashMap< uint64, AdvanceResult > mAdvanceMap;
+		TArray< NodeIndex > mEmptyCache;
+
+		size_t mMemoryBudget = size_t(512) << 20;
+		uint32 mEpoch = 0;
 
 		bool mBoundDirty = true;
 		BoundBox mBoundCache;
@@ -0,0 +1,81 @@
+#include "StageRegister.h"
+
+#include "SimpleAlgo.h"
+#include "ChunkAlgo.h"
+
+#include "Async/AsyncWork.h"
+#include "LogSystem.h"
+
+#include <random>
+#include <chrono>
+
+namespace Life
+{
+	namespace
+	{
+		using Clock = std::chrono::high_resolution_clock;
+
+		// Random soup , density 1/3
+		void FillSoup(IAlgorithm& algorithm, int size)
+		{
+			std::mt19937 random(1234);
+			for (int y = 0; y < size; ++y)
+			{
+				for (int x = 0; x < size; ++x)
+				{
+					if (random() % 3 == 0)
+					{
+						algorithm.setCell(x, y, 1);
+					}
+				}
+			}
+		}
+
+		double RunGenerations(IAlgorithm& algorithm, int numGeneration)
+		{
+			auto startTime = Clock::now();
+			for (int i = 0; i < numGeneration; ++i)
+			{
+				algorithm.step();
+			}
+			return std::chrono::duration<double>(Clock::now() - startTime).count();
+		}
+
+		void RunLifeBenchmark()
+		{
+			int const Size = 2048;
+			double const numCell = double(Size) * Size;
+
+			{
+				int const NumGeneration = 10;
+				SimpleAlgo algorithm(Size, Size);
+				FillSoup(algorithm, Size);
+				double time = RunGenerations(algorithm, NumGeneration);
+				LogMsg("SimpleAlgo           : %10.3e cells/s", numCell * NumGeneration / time);
+			}
+
+			int const NumGeneration = 200;
+			double serialTime = 0;
+			{
+				ChunkAlgo algorithm(Size, Size);
+				FillSoup(algorithm, Size);
+				serialTime = RunGenerations(algorithm, NumGeneration);
+				LogMsg("ChunkAlgo Serial     : %10.3e cells/s , active chunks = %d", numCell * NumGeneration / serialTime, algorithm.getActiveChunkNum());
+			}
+
+			for (int numThread = 1; numThread <= 16; numThread *= 2)
+			{
+				QueueThreadPool pool;
+				pool.init(numThread);
+
+				ChunkAlgo algorithm(Size, Size);
+				algorithm.setThreadPool(&pool);
+				FillSoup(algorithm, Size);
+				double time = RunGenerations(algorithm, NumGeneration);
+				LogMsg("ChunkAlgo Threads=%2d : %10.3e cells/s , speedup = %.2f", numThread, numCell * NumGeneration / time, serialTime / time);
+			}
+		}
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Life Benchmark", Life::RunLifeBenchmark);
@@ -13,6 +13,7 @@
 #include "Async/AsyncWork.h"
 #include "RHI/RHIGraphics2D.h"
 #include "ProfileSystem.h"
+#include "SystemPlatform.h"
 
 #include "RHI/DrawUtility.h"
 #include "RHI/RenderContext.h"
@@ -59,6 +60,8 @@ namespace CB
 		std::vector<ShapeBase*> mSurfaceList;
 #if USE_PARALLEL_UPDATE
 		std::unique_ptr< QueueThreadPool > mUpdateThreadPool;
+#else
+		std::unique_ptr< QueueThreadPool > mSampleThreadPool;
 #endif
 
 		TestStage()
@@ -93,6 +96,9 @@ namespace CB
 			int numThread = SystemPlatform::GetProcessorNumber();
 			mUpdateThreadPool = std::make_unique<QueueThreadPool>();
 			mUpdateThreadPool->init(numThread);
+#else
+			mSampleThreadPool = std::make_unique<QueueThreadPool>();
+			mSampleThreadPool->init(SystemPlatform::GetProcessorNumber());
 #endif
 
 
@@ -109,6 +115,10 @@ namespace CB
 			mMeshBuilder->getSymbolDefine().defineFunc("Test", Test);
 			mMeshBuilder->setExecType(mExecType);
 			mMeshBuilder->setGenerateSIMD(mbUseSIMD);
+			mMeshBuilder->setSIMDWidth(ExpressionCompiler::GetMaxSIMDWidth());
+#if !USE_PARALLEL_UPDATE
+			mMeshBuilder->setThreadPool(mSampleThreadPool.get());
+#endif
 	
 			::Global::GUI().cleanupWidget();
 
@@ -143,6 +153,7 @@ namespace CB
 			choice->addItem("Asm");
 			choice->addItem("ByteCode");
 			choice->addItem("Interp");
+			choice->addItem("ByteCode Batch");
 			choice->setSelection((int)mExecType - 1);
 			choice->onEvent = [this](int event, GWidget* widget)
 			{
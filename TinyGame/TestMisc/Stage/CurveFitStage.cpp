@@ -109,7 +109,12 @@ public:
 	}
 
 
+#if USE_NNMODEL
+	NNModel::Sequence::BatchBuffer mBatchBuffer;
+	NNBatchGradient mBatchGradient;
+#else
 	TArray< std::unique_ptr< TrainData > > mThreadTrainDatas;
+#endif
 
 	bool bUseParallelComputing = true;
 	bool bAutoTrain = true;
@@ -160,16 +165,18 @@ public:
 #endif
 
 		int workerNum = 24;
+		mPool.init(workerNum);
+#if USE_NNMODEL
+		//The worker gradient buffers are owned by mBatchGradient
+		mBatchBuffer.init(mModel, mBatchSize);
+		mBatchGradient.init(setupContext.nodeParameterNum, workerNum);
+#else
 		for (int i = 0; i < workerNum; ++i)
 		{
 			mThreadTrainDatas.push_back(std::make_unique<TrainData>());
-#if USE_NNMODEL
-			mThreadTrainDatas.back()->init(setupContext, bUseBatchNormaliztion ? (i == 0 ? mBatchSize : 1) : 1);
-#else
 			mThreadTrainDatas.back()->init(mLayout , bUseBatchNormaliztion ? (i == 0 ? mBatchSize : 1) : 1);
-#endif
 		}
-		mPool.init(workerNum);
+#endif
 
 		DevFrame* frame = WidgetUtility::CreateDevFrame();
 		frame->addCheckBox("bAutoTrain", bAutoTrain);
@@ -363,6 +370,25 @@ public:
 
 	TrainResult trainStep(TArrayView< SampleData* > const& samples, NNScalar learnRate)
 	{
+#if USE_NNMODEL
+		//The samples are split in the same worker ranges with or without the pool , both give the same result
+		SampleData* const* pSamples = samples.data();
+		NNScalar loss = mBatchGradient.compute(bUseParallelComputing ? &mPool : nullptr, int(samples.size()), [this, pSamples](int workerIndex, int index, NNScalar* parameterGrads)
+		{
+			SampleData const& sample = *pSamples[index];
+			return mModel.fitBatchSample(mBatchBuffer, index, mInputSize, mParameters.data(), &sample.input, parameterGrads, [&sample](NNScalar const* outputs, NNScalar* outLossGrads)
+			{
+				outLossGrads[0] = LossFunc::CalcDevivative(outputs[0], sample.label);
+				return LossFunc::Calc(outputs[0], sample.label);
+			});
+		});
+
+		mOptimizer.update(mParameters, mBatchGradient.getParameterGrads(), learnRate);
+
+		TrainResult trainResult;
+		trainResult.loss = loss;
+		return trainResult;
+#else
 		if (bUseParallelComputing)
 		{
 			int numWorker = mPool.getAllThreadNum();
@@ -414,6 +440,7 @@ public:
 		TrainResult trainResult;
 		trainResult.loss = mainTrainData.loss;
 		return trainResult;
+#endif
 	}
 
 	int mBatchSize = 400;
@@ -1717,7 +1717,6 @@ namespace TwentyFortyEight
 				mTargetParameters.resize(model.getParameterLength());
 				mOptimizer.init(model.getParameterLength());
 
-				mMainData.init(model);
 				initThread(model);
 
 
@@ -1996,6 +1995,7 @@ namespace TwentyFortyEight
 				op & mSequenceStride;
 			}
 
+			//The activation buffers of a worker , allocated once for the unroll length
 			struct ThreadData
 			{
 				void init(NetworkModel& model)
@@ -2003,20 +2003,15 @@ namespace TwentyFortyEight
 					outputs.resize(model.getPassOutputLength() * R2D2Unroll);
 					outputLossGrads.resize(model.getOutputLength() * R2D2Unroll);
 					lossGrads.resize(model.getTempLossGradLength());
-					parameterGrads.resize(model.getParameterLength());
 				}
 
-				void reset()
-				{
-					std::fill_n(parameterGrads.data(), parameterGrads.size(), 0);
-				}
-				TArray<NNScalar> parameterGrads;
 				TArray<NNScalar> outputs;
 				TArray<NNScalar> outputLossGrads;
 				TArray<NNScalar> lossGrads;
 			};
 			QueueThreadPool mPool;
 			TArray< ThreadData > mThreadDatas;
+			NNBatchGradient mBatchGradient;
 
 
 			void initThread(NetworkModel& model)
@@ -2027,17 +2022,24 @@ namespace TwentyFortyEight
 				{
 					mThreadDatas[i].init(model);
 				}
+				mBatchGradient.init(model.getParameterLength(), WorkerThreadNum);
 			}
 
+			//A replay can be chosen more than once in a batch , the fit results are kept by the batch index and not written to the replay by the workers
+			struct FitResult
+			{
+				NNScalar loss;
+				NNScalar priorityValue;
+			};
 
-			NNScalar fit(ReplayData& sample, float weight, ThreadData& threadData)
+			NNScalar fit(ReplayData const& sample, float weight, ThreadData& threadData, NNScalar* inoutParameterGrads, FitResult& outResult)
 			{
 				PROFILE_ENTRY("Fit");
 				int const trainLength = Math::Min(R2D2Unroll, sample.stepLength - R2D2BurnIn);
 				if (trainLength <= 0)
 				{
-					sample.loss = 0;
-					sample.priorityValue = MinReplayPriority;
+					outResult.loss = 0;
+					outResult.priorityValue = MinReplayPriority;
 					return 0;
 				}
 
@@ -2058,8 +2060,8 @@ namespace TwentyFortyEight
 
 				RecurrentState prevStates[R2D2Unroll];
 				RecurrentState nextStates[R2D2Unroll];
-				sample.loss = 0;
-				sample.priorityValue = 0;
+				outResult.loss = 0;
+				outResult.priorityValue = 0;
 				FMemory::Zero(threadData.outputLossGrads.data(), sizeof(NNScalar) * agent.mModel->getOutputLength() * R2D2Unroll);
 
 				for (int trainIndex = 0; trainIndex < trainLength; ++trainIndex)
@@ -2142,8 +2144,8 @@ namespace TwentyFortyEight
 						}
 
 						NNScalar stepLoss = LossFunc::Calc(AtomCount, actionDist, targetProjDist);
-						sample.loss += weight * stepLoss;
-						sample.priorityValue = Math::Max(sample.priorityValue, stepLoss);
+						outResult.loss += weight * stepLoss;
+						outResult.priorityValue = Math::Max(outResult.priorityValue, stepLoss);
 						for (int i = 0; i < AtomCount; ++i)
 						{
 							stepOutputLossGrads[step.action.playDir * AtomCount + i] = weight * LossFunc::CalcDevivative(actionDist[i], targetProjDist[i]);
@@ -2153,8 +2155,8 @@ namespace TwentyFortyEight
 					NNScalar TDTarget = step.reward + DiscountRate * Agent::EvalActionValue(*agent.mModel, mTargetParameters.data(), step.stateNext, actionNext) * (1 - float(step.bDone));
 					stepOutputLossGrads[step.action.playDir] = weight * LossFunc::CalcDevivative(actionValue, TDTarget);
 					NNScalar stepLoss = LossFunc::Calc(actionValue, TDTarget);
-					sample.loss += weight * stepLoss;
-					sample.priorityValue = Math::Max(sample.priorityValue, stepLoss);
+					outResult.loss += weight * stepLoss;
+					outResult.priorityValue = Math::Max(outResult.priorityValue, stepLoss);
 #endif
 					targetState = targetStateAfterStep;
 				}
@@ -2173,23 +2175,13 @@ namespace TwentyFortyEight
 						stateLossGrads,
 						prevStateLossGrads,
 						threadData.lossGrads,
-						threadData.parameterGrads.data());
+						inoutParameterGrads);
 					stateLossGrads = prevStateLossGrads;
 				}
 
-				sample.loss /= trainLength;
-				sample.priorityValue = Math::Max(sample.priorityValue, NNScalar(MinReplayPriority));
-
-#if 0
-				for (int i = 0; i < threadData.parameterGrads.size(); ++i)
-				{
-					if (threadData.parameterGrads[i] != 0 && !isnormal(threadData.parameterGrads[i]))
-					{
-						int n = 1;
-					}
-				}
-#endif
-				return sample.loss;
+				outResult.loss /= trainLength;
+				outResult.priorityValue = Math::Max(outResult.priorityValue, NNScalar(MinReplayPriority));
+				return outResult.loss;
 			}
 
 
@@ -2292,55 +2284,14 @@ namespace TwentyFortyEight
 					choiceReplays(samples, weights, BatchSize);
 				}
 
-				NNScalar loss = 0;
-				int const activeWorkerNum = Math::Min(WorkerThreadNum, BatchSize);
-				{
-					PROFILE_ENTRY("Optimize.DispatchFit");
-					for (int i = 0; i < activeWorkerNum; ++i)
-					{
-						auto& threadData = mThreadDatas[i];
-						int index = BatchSize * i / activeWorkerNum;
-						int indexEnd = BatchSize * (i + 1) / activeWorkerNum;
-						int num = indexEnd - index;
-						ReplayData** samplePtr = samples + index;
-						float* weightPtr = weights + index;
-						mPool.addFunctionWork([this, samplePtr, weightPtr, num, &threadData]()
-						{
-							threadData.reset();
-							for (int i = 0; i < num; ++i)
-							{
-								fit(*samplePtr[i], weightPtr[i], threadData);
-							}
-						});
-					}
-				}
-
+				FitResult fitResults[BatchSize];
+				NNScalar loss;
 				{
-					PROFILE_ENTRY("Optimize.WaitWorkers");
-					mPool.waitAllWorkComplete();
-				}
-
-				{
-					PROFILE_ENTRY("Optimize.ReduceGrads");
-					int const numParameter = mMainData.parameterGrads.size();
-					for (int i = 0; i < activeWorkerNum; ++i)
+					PROFILE_ENTRY("Optimize.BatchGradient");
+					loss = mBatchGradient.compute(&mPool, BatchSize, [this, &samples, &weights, &fitResults](int workerIndex, int index, NNScalar* parameterGrads)
 					{
-						int index = numParameter * i / activeWorkerNum;
-						int indexEnd = numParameter * (i + 1) / activeWorkerNum;
-						mPool.addFunctionWork([this, activeWorkerNum, index, indexEnd]()
-						{
-							for (int paramIndex = index; paramIndex < indexEnd; ++paramIndex)
-							{
-								NNScalar value = 0;
-								for (int threadIndex = 0; threadIndex < activeWorkerNum; ++threadIndex)
-								{
-									value += mThreadDatas[threadIndex].parameterGrads[paramIndex];
-								}
-								mMainData.parameterGrads[paramIndex] = value;
-							}
-						});
-					}
-					mPool.waitAllWorkComplete();
+						return fit(*samples[index], weights[index], mThreadDatas[workerIndex], parameterGrads, fitResults[index]);
+					});
 				}
 
 				{
@@ -2348,8 +2299,8 @@ namespace TwentyFortyEight
 					for (int i = 0; i < BatchSize; ++i)
 					{
 						ReplayData& sample = *samples[i];
-						//loss += fit(sample, mMainData);
-						loss += sample.loss;
+						sample.loss = fitResults[i].loss;
+						sample.priorityValue = fitResults[i].priorityValue;
 
 						sample.priority = Math::Max(MinReplayPriority, sample.priorityValue);
 						updateReplayPriority(&sample - mReplay.data(), sample.priority);
@@ -2363,13 +2314,13 @@ namespace TwentyFortyEight
 					}
 				}
 
-
+				TArrayView<NNScalar> parameterGrads = mBatchGradient.getParameterGrads();
 #if 1
 				{
 					PROFILE_ENTRY("Optimize.NormalizeGrads");
-					for (int i = 0; i < mMainData.parameterGrads.size(); ++i)
+					for (int i = 0; i < parameterGrads.size(); ++i)
 					{
-						mMainData.parameterGrads[i] /= BatchSize;
+						parameterGrads[i] /= BatchSize;
 					}
 					loss /= BatchSize;
 				}
@@ -2380,9 +2331,9 @@ namespace TwentyFortyEight
 					return mLoss;
 				}
 
-				for (int i = 0; i < mMainData.parameterGrads.size(); ++i)
+				for (int i = 0; i < parameterGrads.size(); ++i)
 				{
-					if (!FNNMath::IsValid(mMainData.parameterGrads[i]))
+					if (!FNNMath::IsValid(parameterGrads[i]))
 					{
 						return mLoss;
 					}
@@ -2390,12 +2341,12 @@ namespace TwentyFortyEight
 
 				{
 					PROFILE_ENTRY("Optimize.ClipNormalize");
-					FNNMath::ClipNormalize(mMainData.parameterGrads.size(), mMainData.parameterGrads.data(), 0.5);
+					FNNMath::ClipNormalize(parameterGrads.size(), parameterGrads.data(), 0.5);
 				}
 
 				{
 					PROFILE_ENTRY("Optimize.AdamUpdate");
-					mOptimizer.update(agent.parameters, mMainData.parameterGrads, LearnRate);
+					mOptimizer.update(agent.parameters, parameterGrads, LearnRate);
 				}
 				return loss;
 			}
@@ -2490,8 +2441,6 @@ namespace TwentyFortyEight
 
 			TArray<NNScalar> mTargetParameters;
 
-			ThreadData mMainData;
-
 			Agent agent;
 			Environment env;
 			bool bResumeFromCheckpoint = false;
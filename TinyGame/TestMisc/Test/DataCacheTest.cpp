@@ -0,0 +1,213 @@
+#include "MiscTestRegister.h"
+
+#include "DataCacheInterface.h"
+#include "LZCompress.h"
+#include "FileSystem.h"
+#include "LogSystem.h"
+
+#include <chrono>
+#include <random>
+#include <atomic>
+
+// Save shader like blobs to a data cache , then load them from the memory tier , from the pack files
+// after a restart and with the async API. A tiny disk budget must evict the old entries.
+namespace DataCacheTest
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	char const* const CacheDir = "DataCacheTest";
+
+	double GetElapsedMS(Clock::time_point startTime)
+	{
+		return std::chrono::duration< double, std::milli >(Clock::now() - startTime).count();
+	}
+
+	// Byte code like data : opcodes from a small set with repeated operand patterns
+	void GenerateBlob(int index, TArray< uint8 >& outData)
+	{
+		std::mt19937 rand(index);
+		outData.resize(4096 + rand() % 16384);
+		uint8 const opcodes[] = { 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc };
+		for( size_t i = 0; i < outData.size(); i += 4 )
+		{
+			outData[i] = opcodes[rand() % ARRAY_SIZE(opcodes)];
+			for( size_t n = i + 1; n < i + 4 && n < outData.size(); ++n )
+				outData[n] = uint8((rand() % 4) * 16 + n % 4);
+		}
+	}
+
+	DataCacheKey GetKey(int index)
+	{
+		DataCacheKey key;
+		key.typeName = "TEST";
+		key.version = "4A5E3D34-9A3C-4F38-86B5-0A5A1E0F6C5D";
+		key.keySuffix.add(index);
+		return key;
+	}
+
+	void CleanupCacheDir()
+	{
+		InlineString< 512 > path;
+		for( int i = 0; i < 64; ++i )
+		{
+			path.format("%s/Shard%02d.pack", CacheDir, i);
+			FFileSystem::DeleteFile(path);
+			path.format("%s/Shard%02d.index", CacheDir, i);
+			FFileSystem::DeleteFile(path);
+		}
+	}
+
+	bool TestCompress()
+	{
+		bool bPass = true;
+		TArray< uint8 > data;
+		TArray< uint8 > compressedData;
+		TArray< uint8 > decompressedData;
+		for( int i = 0; i < 16; ++i )
+		{
+			GenerateBlob(i, data);
+			//Random data must survive too
+			if( i % 4 == 3 )
+			{
+				std::mt19937 rand(i);
+				for( uint8& value : data )
+					value = uint8(rand());
+			}
+
+			compressedData.resize(FLZCompress::GetMaxCompressedSize(data.size()));
+			size_t compressedSize = FLZCompress::Compress(data.data(), data.size(), compressedData.data(), compressedData.size());
+			decompressedData.resize(data.size());
+			bool bOk = compressedSize != 0 &&
+				FLZCompress::Decompress(compressedData.data(), compressedSize, decompressedData.data(), decompressedData.size()) &&
+				memcmp(data.data(), decompressedData.data(), data.size()) == 0;
+			//Corrupt data must fail without writing out of the buffer
+			if( bOk && compressedSize > 8 )
+			{
+				compressedData[compressedSize / 2] ^= 0xff;
+				FLZCompress::Decompress(compressedData.data(), compressedSize, decompressedData.data(), decompressedData.size());
+				FLZCompress::Decompress(compressedData.data(), compressedSize / 2, decompressedData.data(), decompressedData.size());
+			}
+			bPass &= bOk;
+		}
+		LogMsg("LZ Compress : %s", bPass ? "Pass" : "Fail");
+		return bPass;
+	}
+
+	bool LoadAll(DataCacheInterface& cache, int numBlob, int& outNumLoad)
+	{
+		TArray< uint8 > expectData;
+		TArray< uint8 > data;
+		outNumLoad = 0;
+		for( int i = 0; i < numBlob; ++i )
+		{
+			if( !cache.load(GetKey(i), data) )
+				continue;
+			GenerateBlob(i, expectData);
+			if( data.size() != expectData.size() || memcmp(data.data(), expectData.data(), data.size()) != 0 )
+			{
+				LogMsg("Data mismatch : %d", i);
+				return false;
+			}
+			++outNumLoad;
+		}
+		return true;
+	}
+
+	void Run()
+	{
+		int const NumBlob = 2000;
+		bool bPass = TestCompress();
+
+		CleanupCacheDir();
+
+		TArray< TArray< uint8 > > blobs;
+		blobs.resize(NumBlob);
+		uint64 totalSize = 0;
+		for( int i = 0; i < NumBlob; ++i )
+		{
+			GenerateBlob(i, blobs[i]);
+			totalSize += blobs[i].size();
+		}
+
+		DataCacheSettings settings;
+		{
+			DataCacheInterface* cache = DataCacheInterface::Create(CacheDir, settings);
+			auto startTime = Clock::now();
+			for( int i = 0; i < NumBlob; ++i )
+			{
+				TArray< uint8 > data = blobs[i];
+				cache->saveAsync(GetKey(i), std::move(data));
+			}
+			cache->waitAsyncWorks();
+			double saveTime = GetElapsedMS(startTime);
+
+			startTime = Clock::now();
+			int numLoad;
+			bPass &= LoadAll(*cache, NumBlob, numLoad) && numLoad == NumBlob;
+			double memoryLoadTime = GetElapsedMS(startTime);
+
+			DataCacheStats stats = cache->getStats();
+			LogMsg("Save %d blobs ( %.1f MB ) : %.2f ms , stored %.1f%% , memory load %.2f ms ( memory hit %u )",
+				NumBlob, totalSize / (1024.0 * 1024.0), saveTime, 100.0 * stats.storedSize / stats.rawSize, memoryLoadTime, (unsigned)stats.numMemoryHit);
+			cache->release();
+		}
+
+		{
+			auto startTime = Clock::now();
+			DataCacheInterface* cache = DataCacheInterface::Create(CacheDir, settings);
+			double openTime = GetElapsedMS(startTime);
+
+			startTime = Clock::now();
+			int numLoad;
+			bPass &= LoadAll(*cache, NumBlob, numLoad) && numLoad == NumBlob;
+			double diskLoadTime = GetElapsedMS(startTime);
+
+			std::atomic< int > numAsyncLoad(0);
+			startTime = Clock::now();
+			for( int i = 0; i < NumBlob; ++i )
+			{
+				cache->loadAsync(GetKey(i), [&numAsyncLoad, &blobs, i](bool bSuccess, TArray< uint8 >& data)
+				{
+					if( bSuccess && data == blobs[i] )
+						++numAsyncLoad;
+				});
+			}
+			cache->waitAsyncWorks();
+			double asyncLoadTime = GetElapsedMS(startTime);
+			bPass &= numAsyncLoad == NumBlob;
+
+			DataCacheStats stats = cache->getStats();
+			LogMsg("Warm start : open %.2f ms , load %.2f ms ( disk hit %u ) , async load %.2f ms",
+				openTime, diskLoadTime, (unsigned)stats.numDiskHit, asyncLoadTime);
+			cache->release();
+		}
+
+		CleanupCacheDir();
+		{
+			DataCacheSettings smallSettings;
+			smallSettings.diskBudget = totalSize / 8;
+			smallSettings.memoryBudget = 0;
+			DataCacheInterface* cache = DataCacheInterface::Create(CacheDir, smallSettings);
+			for( int n = 0; n < 4; ++n )
+			{
+				for( int i = 0; i < NumBlob; ++i )
+				{
+					cache->save(GetKey(i), MakeView(blobs[i]));
+				}
+			}
+			int numLoad;
+			bPass &= LoadAll(*cache, NumBlob, numLoad);
+			DataCacheStats stats = cache->getStats();
+			bool bBudgetOk = stats.diskSize <= smallSettings.diskBudget * 3 && numLoad > 0 && numLoad < NumBlob;
+			bPass &= bBudgetOk;
+			LogMsg("Eviction : %s , keep %d / %d , evict %u , pack %.1f MB ( budget %.1f MB )", bBudgetOk ? "Pass" : "Fail",
+				numLoad, NumBlob, (unsigned)stats.numEvict, stats.diskSize / (1024.0 * 1024.0), smallSettings.diskBudget / (1024.0 * 1024.0));
+			cache->release();
+		}
+
+		CleanupCacheDir();
+		LogMsg("Data Cache Test : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Data Cache Test", DataCacheTest::Run);
@@ -0,0 +1,101 @@
+#include "MiscTestRegister.h"
+
+#include "GameFramework/EntityManager.h"
+#include "Async/AsyncWork.h"
+#include "LogSystem.h"
+
+#include <chrono>
+
+namespace ECSBenchmark
+{
+	using namespace ECS;
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct Position { float x, y, z; };
+	struct Velocity { float x, y, z; };
+	struct Health   { float value; };
+
+	static double ElapsedTime(Clock::time_point startTime, int numFrame)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - startTime).count() / numFrame;
+	}
+
+	void Run()
+	{
+		int const NumEntity = 100000;
+		int const NumFrame = 100;
+		float const dt = 1 / 60.0f;
+
+		EntityManager manager;
+		manager.registerToList();
+		manager.registerComponentTypeT< Position >();
+		manager.registerComponentTypeT< Velocity >();
+		manager.registerComponentTypeT< Health >();
+
+		// Two archetypes : { Position , Velocity } and { Position , Velocity , Health }
+		TArray< EntityHandle > entities;
+		for (int i = 0; i < NumEntity; ++i)
+		{
+			EntityHandle handle = manager.createEntity();
+			*manager.addComponentT< Position >(handle) = { float(i), 0, 0 };
+			*manager.addComponentT< Velocity >(handle) = { 1, 2, 3 };
+			if (i % 2)
+			{
+				manager.addComponentT< Health >(handle)->value = 100;
+			}
+			entities.push_back(handle);
+		}
+
+		auto Integrate = [dt](EntityHandle const& handle, Position& pos, Velocity const& vel)
+		{
+			pos.x += vel.x * dt;
+			pos.y += vel.y * dt;
+			pos.z += vel.z * dt;
+		};
+
+		// Lookup by handle , the access pattern of the old per-entity component list
+		auto startTime = Clock::now();
+		for (int frame = 0; frame < NumFrame; ++frame)
+		{
+			for (EntityHandle const& handle : entities)
+			{
+				Integrate(handle, manager.getComponentCheckedT< Position >(handle), manager.getComponentCheckedT< Velocity >(handle));
+			}
+		}
+		double lookupTime = ElapsedTime(startTime, NumFrame);
+
+		startTime = Clock::now();
+		for (int frame = 0; frame < NumFrame; ++frame)
+		{
+			manager.forEach< Position, Velocity >(Integrate);
+		}
+		double forEachTime = ElapsedTime(startTime, NumFrame);
+
+		LogMsg("Entities = %d , Archetypes = %d", NumEntity, manager.getArchetypeNum());
+		LogMsg("Handle Lookup   : %7.3f ms/frame", lookupTime);
+		LogMsg("forEach         : %7.3f ms/frame , speedup = %.2f", forEachTime, lookupTime / forEachTime);
+
+		FrameAllocator allocator(2048);
+		for (int numThread = 1; numThread <= 16; numThread *= 2)
+		{
+			QueueThreadPool pool;
+			pool.init(numThread);
+
+			startTime = Clock::now();
+			for (int frame = 0; frame < NumFrame; ++frame)
+			{
+				manager.parallelForEach< Position, Velocity >(pool, allocator, Integrate);
+			}
+			double parallelTime = ElapsedTime(startTime, NumFrame);
+			LogMsg("parallelForEach : %7.3f ms/frame , Threads = %2d , speedup = %.2f", parallelTime, numThread, forEachTime / parallelTime);
+		}
+
+		for (EntityHandle const& handle : entities)
+		{
+			manager.destroyEntity(handle);
+		}
+		manager.unregisterFromList();
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("ECS Benchmark", ECSBenchmark::Run);
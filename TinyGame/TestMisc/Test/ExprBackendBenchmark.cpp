@@ -0,0 +1,228 @@
+#include "MiscTestRegister.h"
+#include "CurveBuilder/ExpressionCompiler.h"
+
+#include "LogSystem.h"
+
+#include <chrono>
+#include <cmath>
+
+// Evaluate the curve builder test expressions on a grid of samples with each code backend and report the samples
+// per second. The batch byte code executor runs over the whole grid in one call. The results are checked with the
+// interpreter , AVX code is tested only if the CPU supports it.
+namespace ExprBackendBenchmark
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using SSEVector = SIMD::TFloatVector<4>;
+	using AVXVector = SIMD::TFloatVector<8>;
+
+	char const* const TestExprs[] =
+	{
+		"sin(sqrt(x*x + y*y) - 1*t) + cos(sqrt(x*x + y*y) + 3*t)",
+		"sin(0.1*(x*x + y*y) + 0.01*t)",
+		"exp(-(x*x + y*y)) * cos(3*x) + ln(y*y + 1)",
+		"x*y + x/(y+3) - tan(0.3*x)",
+		"pow(x*x + 1, 0.5) + sin(y)",
+	};
+
+	//Must be a multiple of the widest SIMD width
+	int const GridSize = 256;
+	int const NumRepeat = 8;
+
+	RealType GTime = 0.7f;
+
+	RealType Pow(RealType a, RealType b) { return std::pow(a, b); }
+
+	void SetupSymbol(SymbolTable& table)
+	{
+		table.defineVarInput("x", 0);
+		table.defineVarInput("y", 1);
+		table.defineVar("t", &GTime);
+#define DEFINE_FUNC_OP(SYMBOL, NAME, NUM_ARG) table.defineFuncSymbol(NAME, EFuncSymbol::SYMBOL, NUM_ARG);
+		DEFAULT_FUNC_SYMBOL_LIST(DEFINE_FUNC_OP)
+#undef DEFINE_FUNC_OP
+		table.defineFunc("pow", Pow);
+	}
+
+	struct SampleGrid
+	{
+		SampleGrid()
+		{
+			xs.resize(GridSize * GridSize);
+			ys.resize(GridSize * GridSize);
+			for (int j = 0; j < GridSize; ++j)
+			{
+				for (int i = 0; i < GridSize; ++i)
+				{
+					xs[i + j * GridSize] = -4.0f + 8.0f * i / GridSize;
+					ys[i + j * GridSize] = -4.0f + 8.0f * j / GridSize;
+				}
+			}
+		}
+		int getSampleCount() const { return (int)xs.size(); }
+
+		TArray< float > xs;
+		TArray< float > ys;
+	};
+
+	double ToSamplesPerSec(Clock::duration duration, int numSample)
+	{
+		return double(numSample) * NumRepeat / std::chrono::duration< double >(duration).count();
+	}
+
+	double RunScalar(ExecutableCode const& code, SampleGrid const& grid, TArray< float >& outValues)
+	{
+		int numSample = grid.getSampleCount();
+		auto startTime = Clock::now();
+		for (int n = 0; n < NumRepeat; ++n)
+		{
+			for (int i = 0; i < numSample; ++i)
+			{
+				outValues[i] = code.evalT< RealType >(grid.xs[i], grid.ys[i]);
+			}
+		}
+		return ToSamplesPerSec(Clock::now() - startTime, numSample);
+	}
+
+	template< class TVector >
+	double RunVector(ExecutableCode const& code, SampleGrid const& grid, TArray< float >& outValues)
+	{
+		int numSample = grid.getSampleCount();
+		auto startTime = Clock::now();
+		for (int n = 0; n < NumRepeat; ++n)
+		{
+			for (int i = 0; i < numSample; i += TVector::Size)
+			{
+				TVector x(&grid.xs[i]);
+				TVector y(&grid.ys[i]);
+				TVector value = code.evalT< TVector >(x, y);
+				value.store(&outValues[i]);
+			}
+		}
+		return ToSamplesPerSec(Clock::now() - startTime, numSample);
+	}
+
+	double RunByteCode(ExecutableCode& code, SampleGrid const& grid, TArray< float >& outValues)
+	{
+#if EBC_USE_VALUE_BUFFER
+		//The byte code reads the inputs , constants and variables from one value buffer
+		int numSample = grid.getSampleCount();
+		auto executor = code.getExecutor< TCodeExecutor< ExprByteCodeExecData > >();
+		FloatVector valueBuffer[64];
+		code.initValueBuffer(valueBuffer);
+
+		auto startTime = Clock::now();
+		for (int n = 0; n < NumRepeat; ++n)
+		{
+			for (int i = 0; i < numSample; i += FloatVector::Size)
+			{
+				valueBuffer[0] = FloatVector(&grid.xs[i]);
+				valueBuffer[1] = FloatVector(&grid.ys[i]);
+				FloatVector value = executor.eval< FloatVector >(TArrayView< FloatVector const >(valueBuffer, ARRAY_SIZE(valueBuffer)));
+				value.store(&outValues[i]);
+			}
+		}
+		return ToSamplesPerSec(Clock::now() - startTime, numSample);
+#else
+		return RunVector< FloatVector >(code, grid, outValues);
+#endif
+	}
+
+#if ENABLE_BYTE_CODE_BATCH
+	double RunByteCodeBatch(ExecutableCode const& code, SampleGrid const& grid, TArray< float >& outValues)
+	{
+		int numSample = grid.getSampleCount();
+		ExprByteCodeBatchExecutor executor(code.getByteCodeBatchData());
+		RealType const* inputs[] = { grid.xs.data(), grid.ys.data() };
+
+		auto startTime = Clock::now();
+		for (int n = 0; n < NumRepeat; ++n)
+		{
+			executor.execute(inputs, outValues.data(), numSample);
+		}
+		return ToSamplesPerSec(Clock::now() - startTime, numSample);
+	}
+#endif
+
+	double GetMaxError(TArray< float > const& values, TArray< float > const& refValues)
+	{
+		double result = 0;
+		for (int i = 0; i < (int)values.size(); ++i)
+		{
+			double error = std::abs(values[i] - refValues[i]) / (1.0 + std::abs(refValues[i]));
+			if (!(error <= result))
+				result = error;
+		}
+		return result;
+	}
+
+	bool Compile(char const* expr, SymbolTable const& table, ECodeExecType type, int simdWidth, ExecutableCode& outCode)
+	{
+		ExpressionCompiler compiler;
+		compiler.setTargetType(type);
+		compiler.enableSIMD(simdWidth != 0);
+		if (simdWidth)
+			compiler.setSIMDWidth(simdWidth);
+
+		ParseResult parseResult;
+		ValueLayout layouts[] = { ValueLayout::Real, ValueLayout::Real };
+		return compiler.compile(expr, table, parseResult, outCode, ARRAY_SIZE(layouts), layouts);
+	}
+
+	void Run()
+	{
+		SymbolTable table;
+		SetupSymbol(table);
+		SampleGrid grid;
+		bool bHaveAVX = ExpressionCompiler::GetMaxSIMDWidth() >= 8;
+		if (!bHaveAVX)
+		{
+			LogMsg("AVX is not supported , skip the AVX backend");
+		}
+
+		bool bPass = true;
+		for (char const* expr : TestExprs)
+		{
+			ExecutableCode interpCode, byteCode, batchCode, sseCode, avxCode;
+			if (!Compile(expr, table, ECodeExecType::Interp, 0, interpCode) ||
+				!Compile(expr, table, ECodeExecType::ByteCode, FloatVector::Size, byteCode) ||
+#if ENABLE_BYTE_CODE_BATCH
+				!Compile(expr, table, ECodeExecType::ByteCodeBatch, 0, batchCode) ||
+#endif
+				!Compile(expr, table, ECodeExecType::Asm, SSEVector::Size, sseCode) ||
+				(bHaveAVX && !Compile(expr, table, ECodeExecType::Asm, AVXVector::Size, avxCode)))
+			{
+				LogWarning(0, "Compile expr fail : %s", expr);
+				bPass = false;
+				continue;
+			}
+
+			TArray< float > refValues;
+			TArray< float > values;
+			refValues.resize(grid.getSampleCount());
+			values.resize(grid.getSampleCount());
+
+			LogMsg("Expr : %s", expr);
+			double interpRate = RunScalar(interpCode, grid, refValues);
+			LogMsg("  Interp   %8.2f MSamples/s", interpRate * 1e-6);
+
+			auto Report = [&](char const* name, double rate)
+			{
+				double maxError = GetMaxError(values, refValues);
+				bPass &= maxError < 1e-4;
+				LogMsg("  %-8s %8.2f MSamples/s x%5.1f , max error %g", name, rate * 1e-6, rate / interpRate, maxError);
+			};
+			Report("ByteCode", RunByteCode(byteCode, grid, values));
+#if ENABLE_BYTE_CODE_BATCH
+			Report("Batch", RunByteCodeBatch(batchCode, grid, values));
+#endif
+			Report("SSE", RunVector< SSEVector >(sseCode, grid, values));
+			if (bHaveAVX)
+			{
+				Report("AVX", RunVector< AVXVector >(avxCode, grid, values));
+			}
+		}
+		LogMsg("Expr Backend Benchmark : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Expr Backend Benchmark", ExprBackendBenchmark::Run);
@@ -0,0 +1,165 @@
+#include "MiscTestRegister.h"
+
+#include "FrameDataCodec.h"
+#include "LogSystem.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+// Lockstep frame stream of KeyFrameData actions : round trip , resync after a corrupted frame ,
+// and the coded bytes per frame per player.
+namespace FrameDataCodecTest
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct PlayerInput
+	{
+		uint32 port;
+		uint32 keyActBit;
+	};
+
+	// Same layout as TKeyFrameActionTemplate : active port mask then the data of the active ports
+	static void WriteFrame(std::vector< PlayerInput > const& inputs, std::vector< uint8 >& outData)
+	{
+		outData.clear();
+		uint32 activeMask = 0;
+		for( auto const& input : inputs )
+		{
+			if( input.keyActBit )
+				activeMask |= BIT(input.port);
+		}
+		if( activeMask == 0 )
+			return;
+
+		auto Append = [&outData](uint32 value)
+		{
+			uint8 const* ptr = (uint8 const*)&value;
+			outData.insert(outData.end(), ptr, ptr + sizeof(value));
+		};
+		Append(activeMask);
+		for( auto const& input : inputs )
+		{
+			if( input.keyActBit )
+			{
+				Append(input.port);
+				Append(input.keyActBit);
+			}
+		}
+	}
+
+	struct TestResult
+	{
+		FrameDataCodecStats stats;
+		uint32 numError;
+		double encodeTime;
+		double decodeTime;
+	};
+
+	// Inputs are held for several frames like real key presses
+	static TestResult Run(int numPlayer, int numFrame, float changeRate, uint32 seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution< float > changeDist(0.0f, 1.0f);
+
+		std::vector< PlayerInput > inputs(numPlayer);
+		for( int i = 0; i < numPlayer; ++i )
+		{
+			inputs[i].port = i;
+			inputs[i].keyActBit = 0;
+		}
+
+		FrameDataEncoder encoder;
+		FrameDataDecoder decoder;
+		std::vector< uint8 > frameData;
+
+		TestResult result;
+		result.numError = 0;
+		result.encodeTime = 0;
+		result.decodeTime = 0;
+		for( int frame = 0; frame < numFrame; ++frame )
+		{
+			for( auto& input : inputs )
+			{
+				if( changeDist(random) < changeRate )
+					input.keyActBit = ( random() % 3 == 0 ) ? 0 : ( random() & 0x3f );
+			}
+			WriteFrame(inputs, frameData);
+
+			auto startTime = Clock::now();
+			uint32 codedSize = encoder.encode(frameData.data(), (uint32)frameData.size());
+			auto decodeStartTime = Clock::now();
+			bool bOk = decoder.decode(encoder.getCodedData().data(), codedSize);
+			result.encodeTime += std::chrono::duration< double, std::micro >(decodeStartTime - startTime).count();
+			result.decodeTime += std::chrono::duration< double, std::micro >(Clock::now() - decodeStartTime).count();
+
+			auto const& decodedData = decoder.getFrameData();
+			if( !bOk || decodedData.size() != frameData.size() ||
+			    !std::equal(frameData.begin(), frameData.end(), decodedData.begin()) )
+			{
+				++result.numError;
+			}
+		}
+
+		result.stats = encoder.getStats();
+		result.encodeTime /= numFrame;
+		result.decodeTime /= numFrame;
+		return result;
+	}
+
+	// A lost or broken frame drops the stream until the next key frame
+	static bool TestResync()
+	{
+		FrameDataEncoder encoder;
+		FrameDataDecoder decoder;
+
+		uint8 frameData[12] = { 1 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 };
+		int numDecoded = 0;
+		bool bSkipped = false;
+		for( int frame = 0; frame < 2 * FrameDataEncoder::KeyFrameInterval; ++frame )
+		{
+			frameData[8] = uint8(frame);
+			uint32 codedSize = encoder.encode(frameData, sizeof(frameData));
+			if( frame == 10 )
+			{
+				bSkipped = true;
+				continue;
+			}
+
+			if( decoder.decode(encoder.getCodedData().data(), codedSize) )
+			{
+				if( decoder.getFrameData().size() != sizeof(frameData) ||
+				    memcmp(decoder.getFrameData().data(), frameData, sizeof(frameData)) != 0 )
+					return false;
+				++numDecoded;
+			}
+			else if( !bSkipped )
+			{
+				return false;
+			}
+		}
+		//Frames after the gap are dropped until the second key frame
+		return numDecoded == 10 + FrameDataEncoder::KeyFrameInterval && decoder.isSynced();
+	}
+
+	void Run()
+	{
+		LogMsg("Resync Test : %s", TestResync() ? "Pass" : "Fail");
+
+		int const NumFrame = 20000;
+		for( int numPlayer : { 2 , 4 , 8 } )
+		{
+			for( float changeRate : { 0.02f , 0.1f , 0.5f } )
+			{
+				TestResult result = Run(numPlayer, NumFrame, changeRate, 1234);
+				FrameDataCodecStats const& stats = result.stats;
+				LogMsg("Players = %d Change = %.2f : raw %6.2f coded %6.2f bytes/frame ( %5.2f bytes/frame/player , ratio %5.1f%% ) repeat %5.1f%% , encode %.2f us decode %.2f us %s",
+					numPlayer, changeRate, stats.getRawBytesPerFrame(), stats.getCodedBytesPerFrame(), stats.getCodedBytesPerFrame() / numPlayer,
+					stats.rawSize ? 100.0 * stats.codedSize / stats.rawSize : 0.0, 100.0 * stats.numRepeatFrame / stats.numFrame,
+					result.encodeTime, result.decodeTime, result.numError ? "(Decode Error)" : "");
+			}
+		}
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Frame Data Codec Test", FrameDataCodecTest::Run);
@@ -0,0 +1,106 @@
+#include "MiscTestRegister.h"
+
+#include "DataStructure/HashMap.h"
+#include "LogSystem.h"
+
+#include <unordered_map>
+#include <random>
+#include <chrono>
+
+namespace HashMapBenchmark
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct BenchmarkResult
+	{
+		double insertTime;
+		double hitTime;
+		double missTime;
+		double eraseTime;
+	};
+
+	static double ToNanoPerOp(Clock::duration duration, int numOp)
+	{
+		return std::chrono::duration<double, std::nano>(duration).count() / numOp;
+	}
+
+	template< class TMap, class TFindFunc >
+	static BenchmarkResult Run(TArray< uint64 > const& keys, TArray< uint64 > const& missKeys, TFindFunc&& FindFunc)
+	{
+		BenchmarkResult result;
+		int numKey = (int)keys.size();
+		TMap map;
+
+		auto startTime = Clock::now();
+		for (int i = 0; i < numKey; ++i)
+		{
+			map[keys[i]] = i;
+		}
+		result.insertTime = ToNanoPerOp(Clock::now() - startTime, numKey);
+
+		uint64 sum = 0;
+		startTime = Clock::now();
+		for (int i = 0; i < numKey; ++i)
+		{
+			sum += FindFunc(map, keys[numKey - 1 - i]);
+		}
+		result.hitTime = ToNanoPerOp(Clock::now() - startTime, numKey);
+
+		startTime = Clock::now();
+		for (int i = 0; i < numKey; ++i)
+		{
+			sum += FindFunc(map, missKeys[i]);
+		}
+		result.missTime = ToNanoPerOp(Clock::now() - startTime, numKey);
+
+		startTime = Clock::now();
+		for (int i = 0; i < numKey; ++i)
+		{
+			sum += map.erase(keys[i]);
+		}
+		result.eraseTime = ToNanoPerOp(Clock::now() - startTime, numKey);
+
+		if (sum == 0)
+		{
+			LogWarning(0, "Benchmark result is unused");
+		}
+		return result;
+	}
+
+	void Run()
+	{
+		std::mt19937_64 random(1234);
+		for (int numKey = 1000; numKey <= 10000000; numKey *= 10)
+		{
+			TArray< uint64 > keys;
+			TArray< uint64 > missKeys;
+			keys.resize(numKey);
+			missKeys.resize(numKey);
+			for (int i = 0; i < numKey; ++i)
+			{
+				//odd keys hit , even keys miss
+				keys[i] = random() | 1;
+				missKeys[i] = random() & ~uint64(1);
+			}
+
+			auto stdResult = Run< std::unordered_map< uint64, int > >(keys, missKeys, [](auto& map, uint64 key)
+			{
+				auto iter = map.find(key);
+				return iter != map.end() ? iter->second : 0;
+			});
+			auto flatResult = Run< THashMap< uint64, int > >(keys, missKeys, [](auto& map, uint64 key)
+			{
+				int* value = map.findValue(key);
+				return value ? *value : 0;
+			});
+
+			LogMsg("Keys = %8d (ns/op) : insert %6.1f / %6.1f , hit %6.1f / %6.1f , miss %6.1f / %6.1f , erase %6.1f / %6.1f ( std / THashMap )", numKey,
+				stdResult.insertTime, flatResult.insertTime,
+				stdResult.hitTime, flatResult.hitTime,
+				stdResult.missTime, flatResult.missTime,
+				stdResult.eraseTime, flatResult.eraseTime);
+		}
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("HashMap Benchmark", HashMapBenchmark::Run);
@@ -0,0 +1,153 @@
+#include "MiscTestRegister.h"
+
+#include "Core/LockFreeQueue.h"
+#include "PlatformThread.h"
+#include "LogSystem.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+
+namespace LockFreeQueueBenchmark
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	class TaskThread : public RunnableThreadT< TaskThread >
+	{
+	public:
+		unsigned run()
+		{
+			func();
+			return 0;
+		}
+		std::function< void() > func;
+	};
+
+	// Baseline : the mutex guarded hand-off used across the engine
+	class MutexQueue
+	{
+	public:
+		bool tryPush(uint64 value)
+		{
+			Mutex::Locker locker(mMutex);
+			mValues.push_back(value);
+			return true;
+		}
+		bool tryPop(uint64& outValue)
+		{
+			Mutex::Locker locker(mMutex);
+			if (mValues.empty())
+				return false;
+			outValue = mValues.front();
+			mValues.pop_front();
+			return true;
+		}
+		Mutex mMutex;
+		std::deque< uint64 > mValues;
+	};
+
+	class BoundedQueue : public TLockFreeBoundedQueue< uint64 >
+	{
+	public:
+		BoundedQueue() :TLockFreeBoundedQueue< uint64 >(4096) {}
+	};
+
+	class MPSCQueue : public TLockFreeMPSCQueue< uint64 >
+	{
+	public:
+		bool tryPush(uint64 value) { push(value); return true; }
+	};
+
+	struct BenchmarkResult
+	{
+		double opsPerSecond;
+		bool   bValid;
+	};
+
+	int const MaxThreadNum = 64;
+
+	template< class TQueue >
+	static BenchmarkResult Run(int numProducer, int numConsumer, int numValue)
+	{
+		TQueue queue;
+		std::atomic< int > numPopped{ 0 };
+		std::atomic< uint64 > sum{ 0 };
+		int const numValuePerProducer = numValue / numProducer;
+		int const numTotal = numValuePerProducer * numProducer;
+
+		TaskThread threads[MaxThreadNum];
+		int const numThread = numProducer + numConsumer;
+		for (int i = 0; i < numProducer; ++i)
+		{
+			threads[i].func = [&queue, i, numValuePerProducer]()
+			{
+				uint64 base = uint64(i) * numValuePerProducer;
+				for (int n = 0; n < numValuePerProducer; ++n)
+				{
+					while (!queue.tryPush(base + n))
+					{
+						SystemPlatform::Sleep(0);
+					}
+				}
+			};
+		}
+		for (int i = 0; i < numConsumer; ++i)
+		{
+			threads[numProducer + i].func = [&queue, &numPopped, &sum, numTotal]()
+			{
+				uint64 localSum = 0;
+				uint64 value;
+				while (numPopped.load(std::memory_order_relaxed) < numTotal)
+				{
+					if (queue.tryPop(value))
+					{
+						localSum += value;
+						numPopped.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+				sum += localSum;
+			};
+		}
+
+		auto startTime = Clock::now();
+		for (int i = 0; i < numThread; ++i)
+		{
+			threads[i].start();
+		}
+		for (int i = 0; i < numThread; ++i)
+		{
+			threads[i].join();
+		}
+
+		BenchmarkResult result;
+		result.opsPerSecond = numTotal / std::chrono::duration<double>(Clock::now() - startTime).count();
+		result.bValid = sum == uint64(numTotal) * (numTotal - 1) / 2;
+		return result;
+	}
+
+	void Run()
+	{
+		int const NumValue = 1 << 20;
+
+		for (int numThread = 1; numThread <= 32; numThread *= 2)
+		{
+			BenchmarkResult mutexResult = Run< MutexQueue >(numThread, numThread, NumValue);
+			BenchmarkResult boundedResult = Run< BoundedQueue >(numThread, numThread, NumValue);
+			LogMsg("MPMC Producers = Consumers = %2d : Mutex %7.2f Mops/s , Bounded %7.2f Mops/s %s", numThread,
+				mutexResult.opsPerSecond * 1e-6, boundedResult.opsPerSecond * 1e-6,
+				(mutexResult.bValid && boundedResult.bValid) ? "" : "(Invalid Result)");
+		}
+
+		for (int numThread = 1; numThread <= 32; numThread *= 2)
+		{
+			BenchmarkResult mutexResult = Run< MutexQueue >(numThread, 1, NumValue);
+			BenchmarkResult mpscResult = Run< MPSCQueue >(numThread, 1, NumValue);
+			LogMsg("MPSC Producers = %2d : Mutex %7.2f Mops/s , Segmented %7.2f Mops/s %s", numThread,
+				mutexResult.opsPerSecond * 1e-6, mpscResult.opsPerSecond * 1e-6,
+				(mutexResult.bValid && mpscResult.bValid) ? "" : "(Invalid Result)");
+		}
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("LockFree Queue Benchmark", LockFreeQueueBenchmark::Run);
@@ -0,0 +1,200 @@
+#include "MiscTestRegister.h"
+#include "AI/NNModel.h"
+#include "AI/NNTrain.h"
+
+#include "Async/AsyncWork.h"
+#include "SystemPlatform.h"
+#include "LogSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+// Train a MLP on a fixed random data set with the batch gradient for a growing worker count and report the samples
+// per second. The parameters after the training must be the same in two runs with the same worker count , with and
+// without the thread pool. The batch gradients of all worker counts must match the single worker gradients.
+namespace NNBatchTrainBenchmark
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using LossFunc = FRMSELoss;
+
+	int const InputLength = 64;
+	int const OutputLength = 16;
+	int const HiddenNodeNum = 256;
+	int const BatchSize = 256;
+	int const NumSample = 4 * BatchSize;
+	int const NumEpoch = 4;
+	NNScalar const LearnRate = 1e-3;
+
+	struct DataSet
+	{
+		DataSet()
+		{
+			std::mt19937 random(1234);
+			std::uniform_real_distribution< NNScalar > distribution(-1, 1);
+			inputs.resize(NumSample * InputLength);
+			labels.resize(NumSample * OutputLength);
+			for (auto& value : inputs)
+				value = distribution(random);
+			for (auto& value : labels)
+				value = distribution(random);
+		}
+
+		TArray< NNScalar > inputs;
+		TArray< NNScalar > labels;
+	};
+
+	NNLinearLayer MakeLinearLayer(int numNode)
+	{
+		NNLinearLayer layer;
+		layer.numNode = numNode;
+		return layer;
+	}
+
+	NNTransformLayer MakeReLULayer()
+	{
+		NNTransformLayer layer;
+		layer.setFuncionT< NNFunc::ReLU >();
+		return layer;
+	}
+
+	struct Trainer
+	{
+		Trainer()
+		{
+			model.addLayer(MakeLinearLayer(HiddenNodeNum));
+			model.addLayer(MakeReLULayer());
+			model.addLayer(MakeLinearLayer(HiddenNodeNum));
+			model.addLayer(MakeReLULayer());
+			model.addLayer(MakeLinearLayer(OutputLength));
+
+			NNModel::SetupContext setupContext;
+			setupContext.inputSize = inputSize;
+			model.setup(setupContext);
+			numParameter = setupContext.nodeParameterNum;
+			buffer.init(model, BatchSize);
+		}
+
+		void reset(int numWorker)
+		{
+			std::mt19937 random(5678);
+			std::uniform_real_distribution< NNScalar > distribution(-0.1, 0.1);
+			parameters.resize(numParameter);
+			for (auto& value : parameters)
+				value = distribution(random);
+
+			//Init keeps the moments of the last run
+			optimizer = AdamOptimizer();
+			optimizer.init(numParameter);
+			gradient.init(numParameter, numWorker);
+		}
+
+		NNScalar computeGradient(QueueThreadPool* pool, DataSet const& dataSet, int sampleOffset)
+		{
+			return gradient.compute(pool, BatchSize, [this, &dataSet, sampleOffset](int workerIndex, int index, NNScalar* parameterGrads)
+			{
+				NNScalar const* inputs = dataSet.inputs.data() + (sampleOffset + index) * InputLength;
+				NNScalar const* labels = dataSet.labels.data() + (sampleOffset + index) * OutputLength;
+				return model.fitBatchSample(buffer, index, inputSize, parameters.data(), inputs, parameterGrads, [labels](NNScalar const* outputs, NNScalar* outLossGrads)
+				{
+					NNScalar loss = 0;
+					for (int i = 0; i < OutputLength; ++i)
+					{
+						outLossGrads[i] = LossFunc::CalcDevivative(outputs[i], labels[i]);
+						loss += LossFunc::Calc(outputs[i], labels[i]);
+					}
+					return loss;
+				});
+			});
+		}
+
+		NNScalar train(QueueThreadPool* pool, DataSet const& dataSet)
+		{
+			NNScalar loss = 0;
+			for (int epoch = 0; epoch < NumEpoch; ++epoch)
+			{
+				for (int offset = 0; offset < NumSample; offset += BatchSize)
+				{
+					loss = computeGradient(pool, dataSet, offset) / BatchSize;
+					TArrayView< NNScalar > parameterGrads = gradient.getParameterGrads();
+					for (auto& grad : parameterGrads)
+						grad /= BatchSize;
+					optimizer.update(parameters, parameterGrads, LearnRate);
+				}
+			}
+			return loss;
+		}
+
+		NNModel::IntVector3 inputSize = NNModel::IntVector3(InputLength, 0, 0);
+		NNModel::Sequence model;
+		NNModel::Sequence::BatchBuffer buffer;
+		NNBatchGradient gradient;
+		AdamOptimizer optimizer;
+		TArray< NNScalar > parameters;
+		int numParameter = 0;
+	};
+
+	bool IsSameValues(TArray< NNScalar > const& values, TArray< NNScalar > const& otherValues)
+	{
+		return values.size() == otherValues.size() && std::equal(values.begin(), values.end(), otherValues.begin());
+	}
+
+	void Run()
+	{
+		DataSet dataSet;
+		Trainer trainer;
+		int const maxWorkerNum = SystemPlatform::GetProcessorNumber();
+		LogMsg("MLP %d-%d-%d-%d , %d parameters , batch %d", InputLength, HiddenNodeNum, HiddenNodeNum, OutputLength, trainer.numParameter, BatchSize);
+
+		bool bPass = true;
+
+		trainer.reset(1);
+		trainer.computeGradient(nullptr, dataSet, 0);
+		TArrayView< NNScalar > refGradView = trainer.gradient.getParameterGrads();
+		TArray< NNScalar > refGrads(refGradView.begin(), refGradView.end());
+
+		double baseRate = 0;
+		for (int numWorker = 1; numWorker <= maxWorkerNum; numWorker *= 2)
+		{
+			QueueThreadPool pool;
+			pool.init(numWorker);
+
+			trainer.reset(numWorker);
+			trainer.computeGradient(&pool, dataSet, 0);
+			double maxGradError = 0;
+			TArrayView< NNScalar > grads = trainer.gradient.getParameterGrads();
+			for (int i = 0; i < trainer.numParameter; ++i)
+			{
+				double error = Math::Abs(grads[i] - refGrads[i]) / (1.0 + Math::Abs(refGrads[i]));
+				if (!(error <= maxGradError))
+					maxGradError = error;
+			}
+
+			trainer.reset(numWorker);
+			auto startTime = Clock::now();
+			NNScalar loss = trainer.train(&pool, dataSet);
+			double duration = std::chrono::duration< double >(Clock::now() - startTime).count();
+			TArray< NNScalar > parameters = trainer.parameters;
+
+			trainer.reset(numWorker);
+			trainer.train(&pool, dataSet);
+			bool bSameRun = IsSameValues(trainer.parameters, parameters);
+
+			trainer.reset(numWorker);
+			trainer.train(nullptr, dataSet);
+			bool bSameSerial = IsSameValues(trainer.parameters, parameters);
+
+			double rate = double(NumEpoch) * NumSample / duration;
+			if (numWorker == 1)
+				baseRate = rate;
+
+			LogMsg("%2d workers : %9.0f samples/s x%5.2f , loss %g , max grad error %g , same run %s , same serial %s",
+				numWorker, rate, rate / baseRate, loss, maxGradError, bSameRun ? "Yes" : "No", bSameSerial ? "Yes" : "No");
+			bPass &= maxGradError < 1e-4 && bSameRun && bSameSerial;
+		}
+
+		LogMsg("NN Batch Train Benchmark : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("NN Batch Train Benchmark", NNBatchTrainBenchmark::Run);
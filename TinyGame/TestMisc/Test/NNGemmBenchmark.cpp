@@ -0,0 +1,243 @@
+#include "MiscTestRegister.h"
+#include "AI/NeuralNetwork.h"
+
+#include "InlineString.h"
+#include "LogSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+// Compare the blocked GEMM with the dot product loops for matrix shapes , and the implicit GEMM path of the convolution
+// layers with the per slice convolution loops for the layer shapes of AnimeGAN. The results must match the loops ,
+// report the GFLOPS of both.
+namespace NNGemmBenchmark
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	//Repeat a case until it runs long enough to be timed
+	double const MinMeasureTime = 0.2;
+
+	struct GemmShape
+	{
+		int dimRow;
+		int dimCol;
+		int dimCol2;
+	};
+
+	GemmShape const GemmShapes[] =
+	{
+		{ 64, 64, 64 },
+		{ 256, 256, 256 },
+		{ 512, 512, 512 },
+		{ 1024, 256, 1024 },
+		{ 75, 300, 131 },
+	};
+
+	struct ConvShape
+	{
+		IntVector3 inputSize;
+		int numNode;
+		int convSize;
+	};
+
+	ConvShape const ConvShapes[] =
+	{
+		{ IntVector3(64, 64, 32), 64, 3 },
+		{ IntVector3(32, 32, 128), 128, 3 },
+		{ IntVector3(30, 30, 3), 32, 5 },
+	};
+
+	struct ConvTransposeShape
+	{
+		IntVector3 inputSize;
+		int numNode;
+		int convSize;
+		int padding;
+		int stride;
+	};
+
+	ConvTransposeShape const ConvTransposeShapes[] =
+	{
+		//AnimeGAN generator
+		{ IntVector3(4, 4, 512), 256, 4, 1, 2 },
+		{ IntVector3(8, 8, 256), 128, 4, 1, 2 },
+		{ IntVector3(16, 16, 128), 64, 4, 1, 2 },
+		{ IntVector3(32, 32, 64), 3, 4, 1, 2 },
+		{ IntVector3(32, 32, 64), 32, 3, 1, 1 },
+	};
+
+	void FillRandom(TArray< NNScalar >& values, int num)
+	{
+		values.resize(num);
+		for (auto& value : values)
+		{
+			value = NNScalar(2.0 * double(std::rand()) / RAND_MAX - 1.0);
+		}
+	}
+
+	template< class TFunc >
+	double MeasureGFLOPS(double numFlop, TFunc&& func)
+	{
+		int numRepeat = 0;
+		auto startTime = Clock::now();
+		double duration;
+		do
+		{
+			func();
+			++numRepeat;
+			duration = std::chrono::duration< double >(Clock::now() - startTime).count();
+		}
+		while (duration < MinMeasureTime);
+		return numFlop * numRepeat / duration * 1e-9;
+	}
+
+	double GetMaxError(TArray< NNScalar > const& values, TArray< NNScalar > const& refValues)
+	{
+		double result = 0;
+		for (int i = 0; i < (int)values.size(); ++i)
+		{
+			double error = Math::Abs(values[i] - refValues[i]) / (1.0 + Math::Abs(refValues[i]));
+			if (!(error <= result))
+				result = error;
+		}
+		return result;
+	}
+
+	void MatrixMulDot(GemmShape const& shape, NNScalar const* m, NNScalar const* m2, NNScalar* out)
+	{
+		for (int row = 0; row < shape.dimRow; ++row)
+		{
+			for (int col = 0; col < shape.dimCol2; ++col)
+			{
+				*out = FNNMath::VectorDot(shape.dimCol, m, m2 + col, shape.dimCol2);
+				++out;
+			}
+			m += shape.dimCol;
+		}
+	}
+
+	void ConvLoop(NNConv2DLayer const& layer, NNScalar const* parameters, NNScalar const* inputs, NNScalar* outputs)
+	{
+		int const nodeOutputLength = layer.dataSize[0] * layer.dataSize[1];
+		int const convLength = layer.convSize * layer.convSize;
+		for (int idxNode = 0; idxNode < layer.numNode; ++idxNode)
+		{
+			std::fill_n(outputs + idxNode * nodeOutputLength, nodeOutputLength, parameters[layer.biasOffset + idxNode]);
+		}
+
+		NNScalar const* pNodeWeight = parameters + layer.weightOffset;
+		for (int idxSlice = 0; idxSlice < layer.inputSize.z; ++idxSlice)
+		{
+			NNScalar const* pSliceInput = inputs + idxSlice * layer.inputSize.x * layer.inputSize.y;
+			for (int idxNode = 0; idxNode < layer.numNode; ++idxNode)
+			{
+				FNNMath::Conv(layer.inputSize.x, layer.inputSize.y, pSliceInput, layer.convSize, layer.convSize, pNodeWeight, outputs + idxNode * nodeOutputLength);
+				pNodeWeight += convLength;
+			}
+		}
+	}
+
+	void ConvTransposeLoop(NNConvTranspose2DLayer const& layer, NNScalar const* parameters, NNScalar const* inputs, NNScalar* outputs)
+	{
+		int const nodeOutputLength = layer.dataSize[0] * layer.dataSize[1];
+		int const convLength = layer.convSize * layer.convSize;
+		for (int idxNode = 0; idxNode < layer.numNode; ++idxNode)
+		{
+			std::fill_n(outputs + idxNode * nodeOutputLength, nodeOutputLength, parameters[layer.biasOffset + idxNode]);
+		}
+
+		NNScalar const* pNodeWeight = parameters + layer.weightOffset;
+		for (int idxSlice = 0; idxSlice < layer.inputSize.z; ++idxSlice)
+		{
+			NNScalar const* pSliceInput = inputs + idxSlice * layer.inputSize.x * layer.inputSize.y;
+			for (int idxNode = 0; idxNode < layer.numNode; ++idxNode)
+			{
+				NNScalar* pNodeOutput = outputs + idxNode * nodeOutputLength;
+				if (layer.stride > 1)
+					FNNMath::DeConv(layer.inputSize.x, layer.inputSize.y, pSliceInput, layer.convSize, layer.convSize, pNodeWeight, layer.stride, layer.padding, pNodeOutput);
+				else
+					FNNMath::FullConvRotate180(layer.inputSize.x, layer.inputSize.y, pSliceInput, layer.convSize, layer.convSize, pNodeWeight, pNodeOutput, -layer.padding);
+				pNodeWeight += convLength;
+			}
+		}
+	}
+
+	void Run()
+	{
+		std::srand(1234);
+		LogMsg("GEMM kernel : %s", FNNMath::IsGEMMUseAVX2() ? "AVX2/FMA" : "Scalar");
+
+		bool bPass = true;
+		auto Report = [&](char const* name, double loopRate, double rate, TArray< NNScalar > const& values, TArray< NNScalar > const& refValues)
+		{
+			double maxError = GetMaxError(values, refValues);
+			bPass &= maxError < 1e-4;
+			LogMsg("%-28s loop %7.2f GFLOPS , GEMM %7.2f GFLOPS x%5.1f , max error %g", name, loopRate, rate, rate / loopRate, maxError);
+		};
+
+		TArray< NNScalar > m, m2, values, refValues;
+		for (auto const& shape : GemmShapes)
+		{
+			FillRandom(m, shape.dimRow * shape.dimCol);
+			FillRandom(m2, shape.dimCol * shape.dimCol2);
+			values.resize(shape.dimRow * shape.dimCol2);
+			refValues.resize(shape.dimRow * shape.dimCol2);
+
+			double numFlop = 2.0 * shape.dimRow * shape.dimCol * shape.dimCol2;
+			double loopRate = MeasureGFLOPS(numFlop, [&]() { MatrixMulDot(shape, m.data(), m2.data(), refValues.data()); });
+			double rate = MeasureGFLOPS(numFlop, [&]()
+			{
+				FNNMath::GEMM(shape.dimRow, shape.dimCol, shape.dimCol2, m.data(), shape.dimCol, 1, m2.data(), shape.dimCol2, 1, values.data(), shape.dimCol2);
+			});
+
+			InlineString< 64 > name;
+			name.format("GEMM %d x %d x %d", shape.dimRow, shape.dimCol, shape.dimCol2);
+			Report(name, loopRate, rate, values, refValues);
+		}
+
+		TArray< NNScalar > parameters, inputs;
+		for (auto const& shape : ConvShapes)
+		{
+			NNConv2DLayer layer;
+			layer.init(shape.inputSize, shape.convSize, shape.numNode);
+			layer.weightOffset = 0;
+			layer.biasOffset = layer.getWeightLength();
+			FillRandom(parameters, layer.getParameterLength());
+			FillRandom(inputs, shape.inputSize.x * shape.inputSize.y * shape.inputSize.z);
+			values.resize(layer.getOutputLength());
+			refValues.resize(layer.getOutputLength());
+
+			double numFlop = 2.0 * layer.getWeightLength() * layer.dataSize[0] * layer.dataSize[1];
+			double loopRate = MeasureGFLOPS(numFlop, [&]() { ConvLoop(layer, parameters.data(), inputs.data(), refValues.data()); });
+			double rate = MeasureGFLOPS(numFlop, [&]() { FNNAlgo::Forward(layer, parameters.data(), inputs.data(), values.data()); });
+
+			InlineString< 64 > name;
+			name.format("Conv %dx%dx%d k%d -> %d", shape.inputSize.x, shape.inputSize.y, shape.inputSize.z, shape.convSize, shape.numNode);
+			Report(name, loopRate, rate, values, refValues);
+		}
+
+		for (auto const& shape : ConvTransposeShapes)
+		{
+			NNConvTranspose2DLayer layer;
+			layer.init(shape.inputSize, shape.numNode, shape.convSize, shape.padding, shape.stride);
+			layer.setParameterOffset(0);
+			FillRandom(parameters, layer.getParameterLength());
+			FillRandom(inputs, shape.inputSize.x * shape.inputSize.y * shape.inputSize.z);
+			values.resize(layer.getOutputLength());
+			refValues.resize(layer.getOutputLength());
+
+			double numFlop = 2.0 * layer.getWeightLength() * shape.inputSize.x * shape.inputSize.y;
+			double loopRate = MeasureGFLOPS(numFlop, [&]() { ConvTransposeLoop(layer, parameters.data(), inputs.data(), refValues.data()); });
+			double rate = MeasureGFLOPS(numFlop, [&]() { FNNAlgo::Forward(layer, parameters.data(), inputs.data(), values.data()); });
+
+			InlineString< 64 > name;
+			name.format("ConvT %dx%dx%d k%d s%d -> %d", shape.inputSize.x, shape.inputSize.y, shape.inputSize.z, shape.convSize, shape.stride, shape.numNode);
+			Report(name, loopRate, rate, values, refValues);
+		}
+
+		LogMsg("NN GEMM Benchmark : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("NN GEMM Benchmark", NNGemmBenchmark::Run);
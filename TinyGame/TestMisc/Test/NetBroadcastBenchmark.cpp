@@ -0,0 +1,265 @@
+#include "MiscTestRegister.h"
+
+#include "GameConfig.h"
+#include "GameNetConnect.h"
+#include "NetPacketBuffer.h"
+#include "PlatformThread.h"
+#include "LogSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#if SYS_PLATFORM_LINUX
+#include <sys/resource.h>
+#endif
+
+// Broadcast cost : every client serializes its own copy of the packet against
+// one pooled buffer shared by all send queues , sent with a gather write per client.
+namespace NetBroadcastBenchmark
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	unsigned const ServerPort = 17494;
+
+	// Reads and drops everything the broadcaster sends
+	class SinkConnection : public SocketDetector
+	{
+	public:
+		void onReadable(NetSocket& socket, int len) override
+		{
+			char data[16 * 1024];
+			while (len > 0)
+			{
+				int num = socket.recvData(data, std::min< int >(len, sizeof(data)));
+				if (num <= 0)
+					break;
+				len -= num;
+			}
+		}
+
+		NetSocket mSocket;
+	};
+
+	class SinkThread : public RunnableThreadT< SinkThread >
+	{
+	public:
+		bool init()
+		{
+			if (!mEventLoop.initialize())
+				return false;
+
+			for (auto& connection : mConnections)
+			{
+				if (!mEventLoop.addSocket(connection->mSocket, *connection, false))
+					return false;
+			}
+			return true;
+		}
+
+		unsigned run()
+		{
+			while (bRunning.load(std::memory_order_acquire))
+			{
+				mEventLoop.dispatch(1);
+			}
+			mEventLoop.cleanup();
+			return 0;
+		}
+
+		NetEventLoop mEventLoop;
+		std::vector< std::unique_ptr< SinkConnection > > mConnections;
+		std::atomic< bool > bRunning{ true };
+	};
+
+	struct BroadcastClient
+	{
+		BroadcastClient() :sendCtrl(64 * 1024) {}
+		NetSocket         socket;
+		NetBufferOperator sendCtrl;
+	};
+
+	struct BenchmarkResult
+	{
+		double broadcastTime;
+		double sendTime;
+		uint32 numAllocated;
+	};
+
+	static BenchmarkResult Run(std::vector< std::unique_ptr< BroadcastClient > >& clients, int packetSize, int numBroadcast, bool bShared)
+	{
+		std::vector< char > packet(packetSize, 0x5a);
+
+		double broadcastTime = 0;
+		double sendTime = 0;
+		uint32 numAllocated = 0;
+		for (int i = 0; i < numBroadcast; ++i)
+		{
+			auto startTime = Clock::now();
+			if (bShared)
+			{
+				NetPacketBufferRef buffer = NetPacketBufferPool::Get().acquire(packetSize);
+				buffer->getBuffer().fill((void const*)packet.data(), packetSize);
+				NetPacketSlice slice(buffer, 0, packetSize);
+				for (auto& client : clients)
+				{
+					client->sendCtrl.appendShared(slice);
+				}
+			}
+			else
+			{
+				for (auto& client : clients)
+				{
+					client->sendCtrl.fillData(packet.data(), packetSize);
+				}
+			}
+			auto sendStartTime = Clock::now();
+			broadcastTime += std::chrono::duration< double, std::micro >(sendStartTime - startTime).count();
+
+			for (auto& client : clients)
+			{
+				while (!client->sendCtrl.sendData(client->socket))
+				{
+					SystemPlatform::Sleep(0);
+				}
+			}
+			sendTime += std::chrono::duration< double, std::micro >(Clock::now() - sendStartTime).count();
+
+			//The first broadcasts fill the pool
+			if (i == numBroadcast / 2)
+			{
+				numAllocated = NetPacketBufferPool::Get().getAllocatedNum();
+			}
+		}
+
+		BenchmarkResult result;
+		result.broadcastTime = broadcastTime / numBroadcast;
+		result.sendTime = sendTime / numBroadcast;
+		result.numAllocated = NetPacketBufferPool::Get().getAllocatedNum() - numAllocated;
+		return result;
+	}
+
+	static void RunTcp(NetSocket& listenSocket, int numClient)
+	{
+		NetAddress serverAddress;
+		serverAddress.setInternet("127.0.0.1", ServerPort);
+
+		SinkThread sink;
+		std::vector< std::unique_ptr< BroadcastClient > > clients;
+		for (int i = 0; i < numClient; ++i)
+		{
+			auto connection = std::make_unique< SinkConnection >();
+			if (!connection->mSocket.createTCP(false) || !connection->mSocket.connect(serverAddress))
+				break;
+
+			auto client = std::make_unique< BroadcastClient >();
+			NetAddress address;
+			if (!listenSocket.accept(client->socket, address))
+				break;
+			client->socket.setNonBlocking(true);
+			connection->mSocket.setNonBlocking(true);
+
+			sink.mConnections.push_back(std::move(connection));
+			clients.push_back(std::move(client));
+		}
+		if (!sink.start())
+		{
+			LogWarning(0, "Can't start sink thread");
+			return;
+		}
+
+		int const NumBroadcast = 2000;
+		for (int packetSize : { 64 , 1024 , 16 * 1024 })
+		{
+			BenchmarkResult copyResult = Run(clients, packetSize, NumBroadcast, false);
+			BenchmarkResult sharedResult = Run(clients, packetSize, NumBroadcast, true);
+			LogMsg("TCP Clients = %4d Size = %5d : queue copy %8.2f us shared %8.2f us (%.3f us/client) , send copy %8.2f us shared %8.2f us , steady allocations = %u",
+				(int)clients.size(), packetSize, copyResult.broadcastTime, sharedResult.broadcastTime, sharedResult.broadcastTime / std::max< size_t >(clients.size(), 1),
+				copyResult.sendTime, sharedResult.sendTime, sharedResult.numAllocated);
+		}
+
+		sink.bRunning.store(false, std::memory_order_release);
+		sink.join();
+	}
+
+	static void RunUdp(int numClient)
+	{
+		NetSocket recvSocket;
+		if (!recvSocket.createUDP() || !recvSocket.bindPort(ServerPort))
+		{
+			LogWarning(0, "Can't bind UDP port %u", ServerPort);
+			return;
+		}
+		recvSocket.setNonBlocking(true);
+
+		NetSocket sendSocket;
+		sendSocket.createUDP();
+
+		NetAddress address;
+		address.setInternet("127.0.0.1", ServerPort);
+
+		char packet[512] = {};
+		std::vector< NetDatagram > datagrams(numClient, NetDatagram{ packet , sizeof(packet) , &address });
+
+		int const NumBroadcast = 200;
+		char recvData[1024];
+		NetAddress recvAddress;
+		double loopTime = 0;
+		double batchTime = 0;
+		for (int i = 0; i < NumBroadcast; ++i)
+		{
+			auto startTime = Clock::now();
+			for (int n = 0; n < numClient; ++n)
+			{
+				sendSocket.sendData(packet, sizeof(packet), address);
+			}
+			loopTime += std::chrono::duration< double, std::micro >(Clock::now() - startTime).count();
+			while (recvSocket.recvData(recvData, sizeof(recvData), recvAddress) > 0) {}
+
+			startTime = Clock::now();
+			sendSocket.sendDatagrams(datagrams.data(), numClient);
+			batchTime += std::chrono::duration< double, std::micro >(Clock::now() - startTime).count();
+			while (recvSocket.recvData(recvData, sizeof(recvData), recvAddress) > 0) {}
+		}
+
+		LogMsg("UDP Clients = %4d : sendto loop %8.2f us , batch %8.2f us", numClient, loopTime / NumBroadcast, batchTime / NumBroadcast);
+	}
+
+	void Run()
+	{
+		if (!NetSocket::StartupSystem())
+			return;
+
+#if SYS_PLATFORM_LINUX
+		//Both ends of every connection live in this process
+		rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+		{
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &limit);
+		}
+#endif
+		NetSocket listenSocket;
+		if (!listenSocket.listen(ServerPort, SOMAXCONN))
+		{
+			LogWarning(0, "Can't listen port %u", ServerPort);
+			return;
+		}
+
+		int const maxClientNum = std::min(NetEventLoop::GetMaxSocketNum() / 2 - 1, 1000);
+		for (int numClient : { 10 , 100 , 1000 })
+		{
+			RunTcp(listenSocket, std::min(numClient, maxClientNum));
+		}
+		listenSocket.close();
+
+		for (int numClient : { 10 , 100 , 1000 })
+		{
+			RunUdp(numClient);
+		}
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Net Broadcast Benchmark", NetBroadcastBenchmark::Run);
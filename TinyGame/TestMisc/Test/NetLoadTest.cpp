@@ -0,0 +1,348 @@
+#include "MiscTestRegister.h"
+
+#include "NetSocket.h"
+#include "SocketBuffer.h"
+#include "PlatformThread.h"
+#include "SystemPlatform.h"
+#include "LogSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#if SYS_PLATFORM_LINUX
+#include <sys/resource.h>
+#endif
+
+// Loopback load generator : many ping-pong TCP clients against an echo server,
+// both sides driven by NetEventLoop.
+namespace NetLoadTest
+{
+	using Clock = std::chrono::steady_clock;
+
+	unsigned const ServerPort = 17493;
+
+	struct Packet
+	{
+		int64  sendTime;
+		uint32 sequence;
+		uint32 clientId;
+	};
+
+	class EchoConnection : public SocketDetector
+	{
+	public:
+		EchoConnection() :mBuffer(16 * 1024) {}
+
+		void onReadable(NetSocket& socket, int len) override
+		{
+			mBuffer.removeUsedData();
+			size_t readSize = std::min< size_t >(len, mBuffer.getFreeSize());
+			if (readSize)
+			{
+				mBuffer.fill(socket, readSize);
+			}
+			flush(socket);
+		}
+		void onSendable(NetSocket& socket) override
+		{
+			flush(socket);
+		}
+		void onClose(NetSocket& socket, bool beGraceful) override
+		{
+			//Released by the server after the dispatch , like ServerClientManager does
+			removeList->push_back(this);
+		}
+
+		void flush(NetSocket& socket)
+		{
+			if (mBuffer.getAvailableSize())
+			{
+				mBuffer.take(socket);
+			}
+		}
+
+		std::vector< EchoConnection* >* removeList = nullptr;
+		NetSocket    mSocket;
+		SocketBuffer mBuffer;
+	};
+
+	class EchoServer : public SocketDetector
+	                 , public RunnableThreadT< EchoServer >
+	{
+	public:
+		bool init()
+		{
+			if (!mEventLoop.initialize())
+				return false;
+
+			return mEventLoop.addSocket(mListenSocket, *this);
+		}
+
+		unsigned run()
+		{
+			while (bRunning.load(std::memory_order_acquire))
+			{
+				mEventLoop.dispatch(1);
+				processRemoveList();
+			}
+			mEventLoop.cleanup();
+			return 0;
+		}
+
+		void onAcceptable(NetSocket& socket) override
+		{
+			//Listening socket is level-triggered , accept all pending connections
+			for (;;)
+			{
+				auto connection = std::make_unique< EchoConnection >();
+				NetAddress address;
+				if (!socket.accept(connection->mSocket, address))
+					break;
+
+				connection->mSocket.setNonBlocking(true);
+				connection->removeList = &mRemoveList;
+				if (!mEventLoop.addSocket(connection->mSocket, *connection, false))
+					break;
+
+				mConnections.push_back(std::move(connection));
+			}
+			mSessionNum.store((int)mConnections.size(), std::memory_order_release);
+		}
+
+		void processRemoveList()
+		{
+			if (mRemoveList.empty())
+				return;
+
+			for (EchoConnection* connection : mRemoveList)
+			{
+				mEventLoop.removeSocket(connection->mSocket);
+				auto iter = std::find_if(mConnections.begin(), mConnections.end(), [connection](auto const& ptr) { return ptr.get() == connection; });
+				if (iter != mConnections.end())
+				{
+					std::swap(*iter, mConnections.back());
+					mConnections.pop_back();
+				}
+			}
+			mRemoveList.clear();
+			mSessionNum.store((int)mConnections.size(), std::memory_order_release);
+		}
+
+		NetSocket    mListenSocket;
+		NetEventLoop mEventLoop;
+		std::vector< std::unique_ptr< EchoConnection > > mConnections;
+		std::vector< EchoConnection* > mRemoveList;
+		std::atomic< int >  mSessionNum{ 0 };
+		std::atomic< bool > bRunning{ true };
+	};
+
+	class LoadClient : public SocketDetector
+	{
+	public:
+		LoadClient() :mBuffer(1024) {}
+
+		void onConnect(NetSocket& socket) override
+		{
+			bConnected = true;
+			sendPacket(socket);
+		}
+		void onConnectFailed(NetSocket& socket) override
+		{
+			bFailed = true;
+		}
+		void onClose(NetSocket& socket, bool beGraceful) override
+		{
+			bFailed = true;
+		}
+
+		void onReadable(NetSocket& socket, int len) override
+		{
+			mBuffer.removeUsedData();
+			mBuffer.fill(socket, std::min< size_t >(len, mBuffer.getFreeSize()));
+			while (mBuffer.getAvailableSize() >= sizeof(Packet))
+			{
+				Packet packet;
+				mBuffer.take(&packet, sizeof(packet));
+				if (latencies)
+				{
+					latencies->push_back(Clock::now().time_since_epoch().count() - packet.sendTime);
+				}
+				sendPacket(socket);
+			}
+		}
+
+		void sendPacket(NetSocket& socket)
+		{
+			Packet packet;
+			packet.sendTime = Clock::now().time_since_epoch().count();
+			packet.sequence = mSequence++;
+			packet.clientId = id;
+			socket.sendData((char const*)&packet, sizeof(packet));
+		}
+
+		uint32       id = 0;
+		bool         bConnected = false;
+		bool         bFailed = false;
+		std::vector< int64 >* latencies = nullptr;
+		NetSocket    mSocket;
+		SocketBuffer mBuffer;
+		uint32       mSequence = 0;
+	};
+
+	static double ToMicroseconds(int64 ticks)
+	{
+		return std::chrono::duration< double, std::micro >(Clock::duration(ticks)).count();
+	}
+
+	//Wait the server releases the sessions of the closed clients
+	static int WaitSessionNum(EchoServer& server, int expectNum)
+	{
+		auto startTime = Clock::now();
+		int sessionNum = server.mSessionNum.load(std::memory_order_acquire);
+		while (sessionNum != expectNum && Clock::now() - startTime < std::chrono::seconds(5))
+		{
+			SystemPlatform::Sleep(1);
+			sessionNum = server.mSessionNum.load(std::memory_order_acquire);
+		}
+		return sessionNum;
+	}
+
+	static bool Run(int numClient, double duration)
+	{
+		EchoServer server;
+		if (!server.mListenSocket.listen(ServerPort, SOMAXCONN))
+		{
+			LogWarning(0, "Can't listen port %u", ServerPort);
+			return false;
+		}
+		if (!server.start())
+		{
+			LogWarning(0, "Can't start echo server");
+			return false;
+		}
+
+		NetEventLoop eventLoop;
+		eventLoop.initialize();
+
+		NetAddress serverAddress;
+		serverAddress.setInternet("127.0.0.1", ServerPort);
+
+		std::vector< std::unique_ptr< LoadClient > > clients;
+		for (int i = 0; i < numClient; ++i)
+		{
+			auto client = std::make_unique< LoadClient >();
+			client->id = i;
+			try
+			{
+				client->mSocket.createTCP(true);
+			}
+			catch (SocketException&)
+			{
+				LogWarning(0, "Can't create more client sockets : %d", i);
+				break;
+			}
+			if (!client->mSocket.connect(serverAddress) || !eventLoop.addSocket(client->mSocket, *client, false))
+				break;
+			clients.push_back(std::move(client));
+		}
+
+		//Connect phase
+		auto connectTime = Clock::now();
+		int numConnected = 0;
+		while (Clock::now() - connectTime < std::chrono::seconds(10))
+		{
+			eventLoop.dispatch(1);
+			numConnected = (int)std::count_if(clients.begin(), clients.end(), [](auto const& client) { return client->bConnected; });
+			if (numConnected == (int)clients.size())
+				break;
+		}
+
+		//Measure phase
+		std::vector< int64 > latencies;
+		latencies.reserve(1 << 20);
+		for (auto& client : clients)
+		{
+			client->latencies = &latencies;
+		}
+
+		auto startTime = Clock::now();
+		while (Clock::now() - startTime < std::chrono::duration< double >(duration))
+		{
+			eventLoop.dispatch(1);
+		}
+		double elapsedTime = std::chrono::duration< double >(Clock::now() - startTime).count();
+		int numFailed = (int)std::count_if(clients.begin(), clients.end(), [](auto const& client) { return client->bFailed; });
+
+		//Disconnect phase : the server must release the sessions of the closed clients
+		auto CloseClients = [&](int indexStart, int indexEnd)
+		{
+			int numClosed = 0;
+			for (int index = indexStart; index < indexEnd; ++index)
+			{
+				LoadClient& client = *clients[index];
+				client.latencies = nullptr;
+				eventLoop.removeSocket(client.mSocket);
+				client.mSocket.close();
+				if (client.bConnected)
+					++numClosed;
+			}
+			return numClosed;
+		};
+		int const numHalf = (int)clients.size() / 2;
+		int sessionNum = WaitSessionNum(server, numConnected);
+		int halfExpectNum = sessionNum - CloseClients(0, numHalf);
+		int halfSessionNum = WaitSessionNum(server, halfExpectNum);
+		CloseClients(numHalf, (int)clients.size());
+		int endSessionNum = WaitSessionNum(server, 0);
+		bool bSessionReleased = halfSessionNum == halfExpectNum && endSessionNum == 0;
+		LogMsg("Clients = %5d : sessions %d -> %d after closing %d clients -> %d after closing all : %s",
+			numClient, sessionNum, halfSessionNum, numHalf, endSessionNum, bSessionReleased ? "OK" : "Leak");
+
+		eventLoop.cleanup();
+
+		server.bRunning.store(false, std::memory_order_release);
+		server.join();
+
+		if (latencies.empty())
+		{
+			LogWarning(0, "Clients = %d : no packet echoed ( connected = %d , failed = %d )", numClient, numConnected, numFailed);
+			return false;
+		}
+
+		std::sort(latencies.begin(), latencies.end());
+		double p50 = ToMicroseconds(latencies[latencies.size() / 2]);
+		double p99 = ToMicroseconds(latencies[latencies.size() * 99 / 100]);
+		LogMsg("Clients = %5d (connected = %5d , failed = %d) : %9.0f packets/s , RTT p50 = %8.1f us , p99 = %8.1f us",
+			numClient, numConnected, numFailed, latencies.size() / elapsedTime, p50, p99);
+		return bSessionReleased;
+	}
+
+	void Run()
+	{
+		if (!NetSocket::StartupSystem())
+			return;
+
+#if SYS_PLATFORM_LINUX
+		//Both ends of every connection live in this process
+		rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+		{
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &limit);
+		}
+#endif
+		//Client and server sockets share the limit of the select fallback
+		int const maxClientNum = std::min(NetEventLoop::GetMaxSocketNum() / 2 - 1, 4000);
+		bool bPass = true;
+		for (int numClient : { 100, 1000, 4000 })
+		{
+			bPass &= Run(std::min(numClient, maxClientNum), 2.0);
+		}
+		LogMsg("Net Loopback Load Test : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Net Loopback Load Test", NetLoadTest::Run);
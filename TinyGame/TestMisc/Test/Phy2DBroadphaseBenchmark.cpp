@@ -0,0 +1,100 @@
+#include "MiscTestRegister.h"
+
+#include "Phy2D/Broadphase.h"
+#include "LogSystem.h"
+
+#include <random>
+#include <chrono>
+
+namespace Phy2DBroadphaseBenchmark
+{
+	using namespace Phy2D;
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct BenchmarkResult
+	{
+		double frameTime;
+		int    numPair;
+	};
+
+	static BenchmarkResult Run(EBroadphase type, int numBody, int numFrame)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution< float > posDist(0, 1);
+		std::uniform_real_distribution< float > jitterDist(-0.1f, 0.1f);
+
+		// Keep density constant : about 4 bodies per 10x10 area
+		float worldSize = 5.0f * Math::Sqrt(float(numBody));
+
+		CircleShape shape;
+		shape.setRadius(0.5f);
+
+		CollisionManager manager;
+		manager.setBroadphase(type);
+
+		TArray< CollideObject > objects;
+		objects.resize(numBody);
+		for (CollideObject& obj : objects)
+		{
+			obj.mShape = &shape;
+			obj.setPos(Vector2(worldSize * posDist(random), worldSize * posDist(random)));
+			manager.addObject(&obj);
+		}
+
+		auto StepFrame = [&]()
+		{
+			for (CollideObject& obj : objects)
+			{
+				obj.setPos(obj.getPos() + Vector2(jitterDist(random), jitterDist(random)));
+			}
+			manager.mBroadphase->process(manager.mPairManager, 1 / 60.0f);
+		};
+
+		//first frame build the whole pair set
+		StepFrame();
+
+		auto startTime = Clock::now();
+		for (int i = 0; i < numFrame; ++i)
+		{
+			StepFrame();
+		}
+
+		BenchmarkResult result;
+		result.frameTime = std::chrono::duration<double, std::milli>(Clock::now() - startTime).count() / numFrame;
+		result.numPair = manager.mPairManager.getPairNum();
+
+		for (CollideObject& obj : objects)
+		{
+			manager.removeObject(&obj);
+		}
+		return result;
+	}
+
+	void Run()
+	{
+		struct BroadphaseInfo
+		{
+			EBroadphase type;
+			char const* name;
+		};
+		BroadphaseInfo const broadphases[] =
+		{
+			{ EBroadphase::BruteForce , "BruteForce" },
+			{ EBroadphase::SweepAndPrune , "SweepAndPrune" },
+			{ EBroadphase::DynamicTree , "DynamicTree" },
+		};
+
+		for (int numBody : { 1000, 10000 })
+		{
+			for (auto const& info : broadphases)
+			{
+				//O(n^2) is too slow to run many frames
+				int numFrame = (info.type == EBroadphase::BruteForce && numBody > 1000) ? 5 : 100;
+				BenchmarkResult result = Run(info.type, numBody, numFrame);
+				LogMsg("Bodies = %5d %-14s : %8.3f ms/frame , pairs = %d", numBody, info.name, result.frameTime, result.numPair);
+			}
+		}
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Phy2D Broadphase Benchmark", Phy2DBroadphaseBenchmark::Run);
@@ -0,0 +1,127 @@
+#include "MiscTestRegister.h"
+
+#include "Phy2D/World.h"
+#include "Phy2D/RigidBody.h"
+#include "Async/AsyncWork.h"
+#include "LogSystem.h"
+
+#include <chrono>
+
+namespace Phy2DSolverBenchmark
+{
+	using namespace Phy2D;
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct SolverConfig
+	{
+		int  velocityIterations;
+		int  positionIterations;
+		bool bWarmStart;
+	};
+
+	struct BenchmarkResult
+	{
+		double stepTime;
+		float  maxSpeed;
+		int    numIsland;
+	};
+
+	// Independent box stacks on a shared static ground , each stack is one island
+	static BenchmarkResult Run(QueueThreadPool* pool, SolverConfig const& config, int numStack, int stackHeight, int numStep)
+	{
+		BoxShape groundShape;
+		groundShape.mHalfExt = Vector2(3.0f * numStack + 10, 1);
+		BoxShape boxShape;
+		boxShape.mHalfExt = Vector2(1, 1);
+
+		World world;
+		world.setThreadPool(pool);
+		world.mVelocityIterations = config.velocityIterations;
+		world.mPositionIterations = config.positionIterations;
+		world.mbEnableWarmStart = config.bWarmStart;
+		// Sleeping stacks would make the later steps free
+		world.mbEnableSleep = false;
+
+		BodyInfo info;
+		info.linearDamping = 0.2f;
+		info.angularDamping = 0.5f;
+
+		RigidBody* ground = world.createRigidBody(&groundShape, info);
+		ground->setMotionType(BodyMotion::eStatic);
+		ground->setPos(Vector2(0, 0));
+		ground->synTransform();
+
+		for (int i = 0; i < numStack; ++i)
+		{
+			float x = 6.0f * i - 3.0f * numStack;
+			for (int n = 0; n < stackHeight; ++n)
+			{
+				RigidBody* body = world.createRigidBody(&boxShape, info);
+				body->setPos(Vector2(x, 2.0f + 2.05f * n));
+				body->synTransform();
+			}
+		}
+
+		float const dt = 1 / 60.0f;
+		//let stacks settle , contacts are created in the first steps
+		int const numSettleStep = 60;
+		for (int i = 0; i < numSettleStep; ++i)
+		{
+			world.simulate(dt);
+		}
+
+		auto startTime = Clock::now();
+		for (int i = 0; i < numStep; ++i)
+		{
+			world.simulate(dt);
+		}
+
+		BenchmarkResult result;
+		result.stepTime = std::chrono::duration<double, std::milli>(Clock::now() - startTime).count() / numStep;
+		result.numIsland = world.getIslandNum();
+		result.maxSpeed = 0;
+
+		TArray< RigidBody* > bodies;
+		for (RigidBody* body : world.mRigidBodies)
+		{
+			result.maxSpeed = Math::Max(result.maxSpeed, body->mLinearVel.length());
+			bodies.push_back(body);
+		}
+		for (RigidBody* body : bodies)
+		{
+			world.destroyRigidBody(body);
+		}
+		return result;
+	}
+
+	void Run()
+	{
+		int const NumStack = 200;
+		int const StackHeight = 10;
+		int const NumStep = 120;
+
+		SolverConfig const legacyConfig = { 10 , 10 , false };
+		SolverConfig const warmStartConfig = { 8 , 3 , true };
+
+		// Convergence : remaining speed of resting stacks , lower is better
+		for (SolverConfig const& config : { legacyConfig, warmStartConfig })
+		{
+			BenchmarkResult result = Run(nullptr, config, NumStack, StackHeight, NumStep);
+			LogMsg("Iterations = %2d/%2d WarmStart = %d : %7.3f ms/step , max speed = %.4f",
+				config.velocityIterations, config.positionIterations, config.bWarmStart ? 1 : 0, result.stepTime, result.maxSpeed);
+		}
+
+		// Scaling with thread count
+		BenchmarkResult serialResult = Run(nullptr, warmStartConfig, NumStack, StackHeight, NumStep);
+		LogMsg("Islands = %d , Serial : %7.3f ms/step", serialResult.numIsland, serialResult.stepTime);
+		for (int numThread = 1; numThread <= 16; numThread *= 2)
+		{
+			QueueThreadPool pool;
+			pool.init(numThread);
+			BenchmarkResult result = Run(&pool, warmStartConfig, NumStack, StackHeight, NumStep);
+			LogMsg("Threads = %2d : %7.3f ms/step , speedup = %.2f", numThread, result.stepTime, serialResult.stepTime / result.stepTime);
+		}
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Phy2D Solver Benchmark", Phy2DSolverBenchmark::Run);
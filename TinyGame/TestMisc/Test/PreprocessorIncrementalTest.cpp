@@ -0,0 +1,230 @@
+#include "MiscTestRegister.h"
+
+#include "RHI/ShaderFormat.h"
+#include "CPreprocessor.h"
+#include "FileSystem.h"
+#include "LogSystem.h"
+
+#include <chrono>
+#include <string>
+
+// Check the dependencies a translation records : a guarded include is skipped without a scan , a file modification
+// which only changes the value of a macro the translation doesn't read doesn't affect it.
+// Then measure a cold and a warm preprocess of the shader files and how many of them a define change of a common file affects.
+namespace PreprocessorIncrementalTest
+{
+	using namespace Render;
+	using Clock = std::chrono::high_resolution_clock;
+
+	char const* const TestDir = "PreprocessorIncrementalTest";
+	char const* const ShaderDir = "Shader";
+
+	double GetElapsedMS(Clock::time_point startTime)
+	{
+		return std::chrono::duration< double, std::milli >(Clock::now() - startTime).count();
+	}
+
+	bool SaveText(char const* fileName, std::string const& text)
+	{
+		InlineString< 256 > path;
+		path.format("%s/%s", TestDir, fileName);
+		return FFileUtility::SaveFromBuffer(path.c_str(), (uint8 const*)text.data(), (uint32)text.size());
+	}
+
+	std::string GetCommonCode(int lightCount, int unusedValue, bool bAddFunction)
+	{
+		std::string code = "#ifndef COMMON_SGC\n#define COMMON_SGC\n";
+		code += InlineString<>::Make("#define LIGHT_COUNT %d\n", lightCount);
+		code += InlineString<>::Make("#define UNUSED_VALUE %d\n", unusedValue);
+		code += "float GetLightCount(){ return LIGHT_COUNT; }\n";
+		if (bAddFunction)
+			code += "float GetZero(){ return 0; }\n";
+		code += "#endif\n";
+		return code;
+	}
+
+	int CountText(TArray< uint8 > const& code, char const* text)
+	{
+		std::string str((char const*)code.data());
+		int result = 0;
+		for (size_t pos = str.find(text); pos != std::string::npos; pos = str.find(text, pos + 1))
+			++result;
+		return result;
+	}
+
+	bool TestDependency()
+	{
+		FFileSystem::CreateDirectorySequence(TestDir);
+		SaveText("IncrementalCommon.sgc", GetCommonCode(4, 1, false));
+		SaveText("IncrementalMain.sgc", "#include \"IncrementalCommon.sgc\"\n#include \"IncrementalCommon.sgc\"\nfloat Main(){ return GetLightCount(); }\n");
+
+		InlineString< 256 > mainPath;
+		mainPath.format("%s/IncrementalMain.sgc", TestDir);
+		InlineString< 256 > commonPath;
+		commonPath.format("%s/IncrementalCommon.sgc", TestDir);
+
+		CPP::CodeSourceLibrary sourceLibrary;
+		ShaderPreprocessSettings settings;
+		TArray< uint8 > code;
+		std::unordered_set< HashString > files;
+		std::unordered_set< HashString > readMacros;
+		if (!ShaderFormat::PreprocessCode(mainPath.c_str(), StringView(ForceInit), settings, &sourceLibrary, code, &files, &readMacros))
+			return false;
+		files.insert(mainPath.c_str());
+		uint32 serial = sourceLibrary.getChangeSerial();
+
+		CPP::CodeBufferSource* commonSource = sourceLibrary.findOrLoadSource(commonPath.c_str());
+		bool bGuardOk = commonSource && commonSource->includeGuard == HashString("COMMON_SGC", true) && CountText(code, "GetLightCount()") == 2;
+		bool bGraphOk = files.find(commonPath.c_str()) != files.end() && readMacros.find(HashString("LIGHT_COUNT", true)) != readMacros.end() &&
+			readMacros.find(HashString("UNUSED_VALUE", true)) == readMacros.end();
+
+		//The edits change the file size , the modification is found even if the write time is the same
+		SaveText("IncrementalCommon.sgc", GetCommonCode(4, 10, false));
+		int numUnusedChanged = sourceLibrary.refreshModifiedSources();
+		bool bUnusedOk = numUnusedChanged == 1 && !sourceLibrary.isTranslationAffected(serial, files, readMacros);
+
+		SaveText("IncrementalCommon.sgc", GetCommonCode(16, 10, false));
+		sourceLibrary.refreshModifiedSources();
+		bool bUsedOk = sourceLibrary.isTranslationAffected(serial, files, readMacros);
+
+		serial = sourceLibrary.getChangeSerial();
+		SaveText("IncrementalCommon.sgc", GetCommonCode(16, 10, true));
+		sourceLibrary.refreshModifiedSources();
+		bool bTextOk = sourceLibrary.isTranslationAffected(serial, files, readMacros);
+
+		//The reloaded file is used by the next translation
+		bool bReloadOk = ShaderFormat::PreprocessCode(mainPath.c_str(), StringView(ForceInit), settings, &sourceLibrary, code, nullptr, nullptr) && CountText(code, "GetZero()") == 1;
+
+		bool bPass = bGuardOk && bGraphOk && bUnusedOk && bUsedOk && bTextOk && bReloadOk;
+		LogMsg("Dependency : %s ( guard %d , graph %d , unused macro %d , used macro %d , text %d , reload %d )", bPass ? "Pass" : "Fail",
+			(int)bGuardOk, (int)bGraphOk, (int)bUnusedOk, (int)bUsedOk, (int)bTextOk, (int)bReloadOk);
+
+		FFileSystem::DeleteFile(mainPath.c_str());
+		FFileSystem::DeleteFile(commonPath.c_str());
+		return bPass;
+	}
+
+	struct Translation
+	{
+		std::string path;
+		std::string definition;
+		std::unordered_set< HashString > files;
+		std::unordered_set< HashString > readMacros;
+	};
+
+	bool PreprocessAll(TArray< Translation >& translations, CPP::CodeSourceLibrary& sourceLibrary, int& outNumSuccess)
+	{
+		ShaderPreprocessSettings settings;
+		TArray< uint8 > code;
+		outNumSuccess = 0;
+		for (Translation& translation : translations)
+		{
+			translation.files.clear();
+			translation.readMacros.clear();
+			if (!ShaderFormat::PreprocessCode(translation.path.c_str(), translation.definition, settings, &sourceLibrary, code, &translation.files, &translation.readMacros))
+				continue;
+			translation.files.insert(translation.path.c_str());
+			++outNumSuccess;
+		}
+		return outNumSuccess != 0;
+	}
+
+	void Benchmark()
+	{
+		TArray< Translation > translations;
+		FileIterator fileIter;
+		if (!FFileSystem::FindFiles(ShaderDir, ".sgc", fileIter))
+		{
+			LogMsg("Can't find shader files in %s", ShaderDir);
+			return;
+		}
+		for (; fileIter.haveMore(); fileIter.goNext())
+		{
+			for (int stage = 0; stage < 2; ++stage)
+			{
+				Translation* translation = translations.addDefault();
+				translation->path = InlineString< 256 >::Make("%s/%s", ShaderDir, fileIter.getFileName()).c_str();
+				translation->definition = "#define COMPILER_HLSL 1\n#define SHADER_COMPILING 1\n";
+				translation->definition += stage == 0 ? "#define SHADER_ENTRY_MainVS 1\n#define VERTEX_SHADER 1\n" : "#define SHADER_ENTRY_MainPS 1\n#define PIXEL_SHADER 1\n";
+			}
+		}
+
+		CPP::CodeSourceLibrary sourceLibrary;
+		int numSuccess;
+		auto startTime = Clock::now();
+		PreprocessAll(translations, sourceLibrary, numSuccess);
+		double coldTime = GetElapsedMS(startTime);
+
+		startTime = Clock::now();
+		PreprocessAll(translations, sourceLibrary, numSuccess);
+		double warmTime = GetElapsedMS(startTime);
+
+		startTime = Clock::now();
+		sourceLibrary.refreshModifiedSources();
+		double refreshTime = GetElapsedMS(startTime);
+
+		int numGuard = 0;
+		CPP::CodeBufferSource const* commonSource = nullptr;
+		int maxNumUser = 0;
+		for (auto const& pair : sourceLibrary.mSourceMap)
+		{
+			if (!pair.second->includeGuard.empty())
+				++numGuard;
+
+			int numUser = 0;
+			for (Translation const& translation : translations)
+			{
+				if (translation.files.find(pair.first) != translation.files.end())
+					++numUser;
+			}
+			if (numUser > maxNumUser && !pair.second->macroHashes.empty())
+			{
+				maxNumUser = numUser;
+				commonSource = pair.second;
+			}
+		}
+
+		size_t numFile = 0;
+		size_t numReadMacro = 0;
+		for (Translation const& translation : translations)
+		{
+			numFile += translation.files.size();
+			numReadMacro += translation.readMacros.size();
+		}
+
+		LogMsg("Preprocess %d translations ( %d success ) : cold %.2f ms , warm %.2f ms , refresh check %.3f ms , %d / %d files have a guard",
+			(int)translations.size(), numSuccess, coldTime, warmTime, refreshTime, numGuard, (int)sourceLibrary.mSourceMap.size());
+		LogMsg("Average %.1f files , %.1f read macros per translation",
+			double(numFile) / translations.size(), double(numReadMacro) / translations.size());
+
+		if (commonSource == nullptr)
+			return;
+
+		//A change of a define value in the most used file only affects the translations reading it
+		int64 numAffected = 0;
+		for (auto const& pair : commonSource->macroHashes)
+		{
+			CPP::CodeSourceChange change;
+			change.filePath = commonSource->filePath;
+			change.serial = 0;
+			change.bOnlyMacroValue = true;
+			change.changedMacros.push_back(pair.first);
+			for (Translation const& translation : translations)
+			{
+				if (change.isAffected(translation.files, translation.readMacros))
+					++numAffected;
+			}
+		}
+		LogMsg("Define value change of %s ( %d macros , used by %d translations ) : recompile %.1f translations on average",
+			commonSource->filePath.c_str(), (int)commonSource->macroHashes.size(), maxNumUser, double(numAffected) / commonSource->macroHashes.size());
+	}
+
+	void Run()
+	{
+		bool bPass = TestDependency();
+		Benchmark();
+		LogMsg("Preprocessor Incremental Test : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Preprocessor Incremental Test", PreprocessorIncrementalTest::Run);
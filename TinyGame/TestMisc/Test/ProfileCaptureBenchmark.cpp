@@ -0,0 +1,50 @@
+#include "MiscTestRegister.h"
+
+#include "ProfileSystem.h"
+#include "LogSystem.h"
+
+#include <chrono>
+
+namespace ProfileCaptureBenchmark
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	static double MeasureScopeTime(int numScope)
+	{
+		auto startTime = Clock::now();
+		for (int i = 0; i < numScope; ++i)
+		{
+			PROFILE_ENTRY("ProfileCaptureBenchmark.Scope");
+		}
+		return std::chrono::duration<double, std::nano>(Clock::now() - startTime).count() / numScope;
+	}
+
+	void Run()
+	{
+		// Keep the scope count below the ring size so no event is dropped
+		int const NumScope = 30000;
+
+		double sampleTime = MeasureScopeTime(NumScope);
+		LogMsg("Sample tree : %6.2f ns/scope", sampleTime);
+
+		if (!ProfileSystem::Get().startCapture())
+		{
+			LogWarning(0, "Profile capture is already running");
+			return;
+		}
+		double captureTime = MeasureScopeTime(NumScope);
+		ProfileSystem::Get().stopCapture();
+		LogMsg("Capture     : %6.2f ns/scope", captureTime);
+
+		TArray< ProfileCaptureStat > stats;
+		ProfileSystem::Get().getCaptureStats(stats);
+		for (ProfileCaptureStat const& stat : stats)
+		{
+			LogMsg("%s : count = %u , avg = %.3f us , max = %.3f us", stat.name.c_str(), stat.count, stat.totalTime / stat.count, stat.maxTime);
+		}
+
+		ProfileSystem::Get().exportCapture("ProfileCaptureBenchmark.json");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Profile Capture Benchmark", ProfileCaptureBenchmark::Run);
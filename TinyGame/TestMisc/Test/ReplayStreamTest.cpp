@@ -0,0 +1,301 @@
+#include "MiscTestRegister.h"
+
+#include "ReplayStream.h"
+#include "FileSystem.h"
+#include "LogSystem.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+// Record a toy game to a replay stream , then check sequential playback , random seeks with the key frames
+// and a recording which was never closed against the checksums of the recording.
+namespace ReplayStreamTest
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	char const* const RecordPath = "ReplayStreamTest.rpf";
+	char const* const CutPath = "ReplayStreamTestCut.rpf";
+
+	// Toy deterministic game , 16 KB of state
+	class ToyGame : public IFrameStateHandler
+	{
+	public:
+		static int const NumEntity = 1024;
+		struct Entity
+		{
+			int32 x, y;
+			int32 vx, vy;
+		};
+
+		ToyGame()
+		{
+			for( int i = 0; i < NumEntity; ++i )
+			{
+				Entity& e = mEntities[i];
+				e.x = i * 13;
+				e.y = i * 7;
+				e.vx = e.vy = 0;
+			}
+		}
+
+		void saveFrameState(IStreamSerializer& serializer) override
+		{
+			serializer.write(mEntities, sizeof(mEntities));
+		}
+		void loadFrameState(IStreamSerializer& serializer) override
+		{
+			serializer.read(mEntities, sizeof(mEntities));
+		}
+
+		void tick(uint8 const* data, uint32 size)
+		{
+			for( uint32 i = 0; i + 1 < size; i += 2 )
+			{
+				int player = data[i];
+				uint8 keys = data[i + 1];
+				int dx = int((keys >> 0) & 1) - int((keys >> 1) & 1);
+				int dy = int((keys >> 2) & 1) - int((keys >> 3) & 1);
+				for( int n = player; n < NumEntity; n += 4 )
+				{
+					mEntities[n].vx = ( mEntities[n].vx + dx ) % 64;
+					mEntities[n].vy = ( mEntities[n].vy + dy ) % 64;
+				}
+			}
+
+			for( Entity& e : mEntities )
+			{
+				e.x = ( e.x + e.vx ) & 0xffff;
+				e.y = ( e.y + e.vy ) & 0xffff;
+			}
+		}
+
+		uint32 calcChecksum() const
+		{
+			uint32 result = 2166136261u;
+			for( Entity const& e : mEntities )
+			{
+				result = ( result ^ uint32(e.x) ) * 16777619u;
+				result = ( result ^ uint32(e.y) ) * 16777619u;
+			}
+			return result;
+		}
+
+		Entity mEntities[NumEntity];
+	};
+
+	// Four players holding keys for a while , like the frame data of a real game
+	class InputGenerator
+	{
+	public:
+		InputGenerator(uint32 seed) :mRand(seed)
+		{
+			for( uint8& keys : mKeys )
+				keys = 0;
+		}
+
+		void generate(std::vector< uint8 >& outData)
+		{
+			outData.clear();
+			for( int player = 0; player < 4; ++player )
+			{
+				if( mRand() % 16 == 0 )
+					mKeys[player] = uint8(mRand() % 16);
+				if( mKeys[player] )
+				{
+					outData.push_back(uint8(player));
+					outData.push_back(mKeys[player]);
+				}
+			}
+		}
+
+		std::mt19937 mRand;
+		uint8 mKeys[4];
+	};
+
+	struct Recording
+	{
+		int32 totalFrame;
+		//State checksum after the tick of the frame
+		std::vector< uint32 > checksums;
+		uint32 rawSize;
+	};
+
+	// Frames start at 1 like the game modes , the state before the tick is the key frame
+	bool Record(char const* path, int32 totalFrame, int keyFrameInterval, bool bClose, Recording& outRecording)
+	{
+		ReplayStreamWriter writer;
+		char const info[] = "ReplayStreamTest";
+		if( !writer.open(path, 1234, info, sizeof(info), keyFrameInterval) )
+			return false;
+
+		ToyGame game;
+		InputGenerator generator(5678);
+		std::vector< uint8 > input;
+		outRecording.totalFrame = totalFrame;
+		outRecording.checksums.assign(totalFrame + 1, 0);
+		outRecording.rawSize = 0;
+		for( int32 frame = 1; frame <= totalFrame; ++frame )
+		{
+			if( frame == 1 || writer.needKeyFrame(frame) )
+				writer.writeState(frame, game);
+
+			generator.generate(input);
+			writer.recordFrame(frame, input.data(), (uint32)input.size());
+			outRecording.rawSize += (uint32)input.size();
+			game.tick(input.data(), (uint32)input.size());
+			outRecording.checksums[frame] = game.calcChecksum();
+		}
+
+		FrameDataCodecStats const& stats = writer.getRecordStats();
+		LogMsg("Record %d frames : %u nodes , %.1f -> %.1f bytes/node ( key = %u , repeat = %u ) , frame data %u -> file %u bytes",
+			totalFrame, stats.numFrame, stats.getRawBytesPerFrame(), stats.getCodedBytesPerFrame(), stats.numKeyFrame, stats.numRepeatFrame,
+			outRecording.rawSize, (unsigned)writer.getFileSize());
+
+		if( !bClose )
+		{
+			writer.flush();
+			return true;
+		}
+		char const finalInfo[] = "ReplayStreamTest Final";
+		return writer.close(totalFrame, finalInfo, sizeof(finalInfo));
+	}
+
+	bool PlayTo(ReplayStreamReader& reader, ToyGame& game, int32 startFrame, int32 endFrame, Recording const& recording, bool bCheckAll)
+	{
+		for( int32 frame = startFrame; frame <= endFrame; ++frame )
+		{
+			bool bHaveData = reader.advanceFrame(frame);
+			TArray< uint8 > const& data = reader.getFrameData();
+			game.tick(bHaveData ? data.data() : nullptr, bHaveData ? (uint32)data.size() : 0);
+			if( ( bCheckAll || frame == endFrame ) && game.calcChecksum() != recording.checksums[frame] )
+			{
+				LogMsg("Checksum mismatch : frame = %d", frame);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool TestPlayback(Recording const& recording)
+	{
+		ReplayStreamReader reader;
+		if( !reader.open(RecordPath) )
+			return false;
+
+		char const finalInfo[] = "ReplayStreamTest Final";
+		bool bInfoOk = reader.getInfoSize() == sizeof(finalInfo) && memcmp(reader.getInfoData(), finalInfo, sizeof(finalInfo)) == 0;
+		if( !reader.haveIndex() || reader.getTotalFrame() != recording.totalFrame || !bInfoOk )
+		{
+			LogMsg("Bad index : haveIndex = %d totalFrame = %d info = %d", (int)reader.haveIndex(), reader.getTotalFrame(), (int)bInfoOk);
+			return false;
+		}
+
+		ToyGame game;
+		auto startTime = Clock::now();
+		bool bPass = PlayTo(reader, game, 1, recording.totalFrame, recording, true);
+		double time = std::chrono::duration< double, std::milli >(Clock::now() - startTime).count();
+		LogMsg("Playback %d frames : %s , %.2f ms", recording.totalFrame, bPass ? "Pass" : "Fail", time);
+		return bPass;
+	}
+
+	bool TestSeek(Recording const& recording, int numSeek)
+	{
+		ReplayStreamReader reader;
+		if( !reader.open(RecordPath) )
+			return false;
+
+		std::mt19937 rand(4321);
+		double seekTime = 0;
+		double restartTime = 0;
+		int maxSimulateFrames = 0;
+		for( int i = 0; i < numSeek; ++i )
+		{
+			int32 targetFrame = 1 + int32(rand() % recording.totalFrame);
+
+			auto startTime = Clock::now();
+			ToyGame game;
+			int32 keyFrame = reader.findKeyFrame(targetFrame);
+			if( keyFrame == INDEX_NONE || !reader.loadKeyFrame(keyFrame, game) || !reader.seekFrame(keyFrame) )
+			{
+				LogMsg("Seek fail : frame = %d", targetFrame);
+				return false;
+			}
+			if( !PlayTo(reader, game, keyFrame, targetFrame, recording, false) )
+				return false;
+			seekTime += std::chrono::duration< double, std::milli >(Clock::now() - startTime).count();
+			maxSimulateFrames = std::max(maxSimulateFrames, int(targetFrame - keyFrame + 1));
+
+			//Old replays can only restart from the seed
+			startTime = Clock::now();
+			ToyGame restartGame;
+			reader.seekFrame(1);
+			if( !PlayTo(reader, restartGame, 1, targetFrame, recording, false) )
+				return false;
+			restartTime += std::chrono::duration< double, std::milli >(Clock::now() - startTime).count();
+		}
+
+		LogMsg("Seek %d times : key frame %.3f ms/seek ( max %d frames ) , from start %.3f ms/seek",
+			numSeek, seekTime / numSeek, maxSimulateFrames, restartTime / numSeek);
+		return true;
+	}
+
+	bool TestUnclosed(int32 totalFrame, int keyFrameInterval)
+	{
+		Recording recording;
+		if( !Record(RecordPath, totalFrame, keyFrameInterval, false, recording) )
+			return false;
+
+		ReplayStreamReader reader;
+		if( !reader.open(RecordPath) || reader.haveIndex() )
+			return false;
+
+		ToyGame game;
+		bool bPass = reader.getTotalFrame() == totalFrame && PlayTo(reader, game, 1, totalFrame, recording, true);
+
+		//Cut the file in the middle of a chunk like a crash while writing
+		uint64 cutSize = reader.getFileSize() - 7;
+		{
+			MappedFileView file;
+			file.open(RecordPath);
+			std::ofstream fs(CutPath, std::ios::binary | std::ios::trunc);
+			fs.write((char const*)file.getData(), cutSize);
+		}
+		reader.close();
+
+		ReplayStreamReader cutReader;
+		if( !cutReader.open(CutPath) )
+			return false;
+
+		ToyGame cutGame;
+		int32 cutTotalFrame = cutReader.getTotalFrame();
+		bPass &= cutTotalFrame > 0 && cutTotalFrame < totalFrame && PlayTo(cutReader, cutGame, 1, cutTotalFrame, recording, true);
+		LogMsg("Unclosed recording : %s , cut file plays %d / %d frames", bPass ? "Pass" : "Fail", cutTotalFrame, totalFrame);
+		return bPass;
+	}
+
+	void Run()
+	{
+		int32 const TotalFrame = 20000;
+		int const KeyFrameInterval = 600;
+
+		bool bPass = true;
+		Recording recording;
+		if( Record(RecordPath, TotalFrame, KeyFrameInterval, true, recording) )
+		{
+			bPass &= TestPlayback(recording);
+			bPass &= TestSeek(recording, 50);
+		}
+		else
+		{
+			bPass = false;
+		}
+		bPass &= TestUnclosed(5000, KeyFrameInterval);
+
+		FFileSystem::DeleteFile(RecordPath);
+		FFileSystem::DeleteFile(CutPath);
+		LogMsg("Replay Stream Test : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Replay Stream Test", ReplayStreamTest::Run);
@@ -0,0 +1,412 @@
+#include "MiscTestRegister.h"
+
+#include "RollbackSession.h"
+#include "LogSystem.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <deque>
+
+// Rollback sessions of several peers over a loopback transport with latency and jitter.
+// Every peer must end with the same confirmed frame states as a simulation with all inputs known.
+namespace RollbackTest
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	// Toy deterministic game , 16 KB of state
+	class ToyGame : public IRollbackSimulation
+	{
+	public:
+		static int const NumEntity = 1024;
+		struct Entity
+		{
+			int32 x, y;
+			int32 vx, vy;
+		};
+
+		ToyGame()
+		{
+			for( int i = 0; i < NumEntity; ++i )
+			{
+				Entity& e = mEntities[i];
+				e.x = i * 13;
+				e.y = i * 7;
+				e.vx = e.vy = 0;
+			}
+			mSaveTime = mLoadTime = 0;
+			mNumSave = mNumLoad = 0;
+		}
+
+		void saveState(IStreamSerializer& serializer) override
+		{
+			auto startTime = Clock::now();
+			serializer.write(mEntities, sizeof(mEntities));
+			mSaveTime += std::chrono::duration< double, std::micro >(Clock::now() - startTime).count();
+			++mNumSave;
+		}
+		void loadState(IStreamSerializer& serializer) override
+		{
+			auto startTime = Clock::now();
+			serializer.read(mEntities, sizeof(mEntities));
+			mLoadTime += std::chrono::duration< double, std::micro >(Clock::now() - startTime).count();
+			++mNumLoad;
+		}
+
+		void simulateFrame(int32 frame, FrameInput const* inputs[], int numSlot, bool bResimulate) override
+		{
+			for( int slot = 0; slot < numSlot; ++slot )
+			{
+				FrameInput const& input = *inputs[slot];
+				uint8 keys = input.size ? input.getData()[0] : 0;
+				int dx = int((keys >> 0) & 1) - int((keys >> 1) & 1);
+				int dy = int((keys >> 2) & 1) - int((keys >> 3) & 1);
+				for( int i = slot; i < NumEntity; i += numSlot )
+				{
+					mEntities[i].vx = ( mEntities[i].vx + dx ) % 64;
+					mEntities[i].vy = ( mEntities[i].vy + dy ) % 64;
+				}
+			}
+
+			for( Entity& e : mEntities )
+			{
+				e.x = ( e.x + e.vx ) & 0xffff;
+				e.y = ( e.y + e.vy ) & 0xffff;
+			}
+
+			if( frame >= (int32)mChecksums.size() )
+				mChecksums.resize(frame + 1, 0);
+			mChecksums[frame] = calcChecksum();
+		}
+
+		uint32 calcChecksum() const
+		{
+			uint32 result = 2166136261u;
+			uint8 const* ptr = (uint8 const*)mEntities;
+			for( size_t i = 0; i < sizeof(mEntities); ++i )
+				result = ( result ^ ptr[i] ) * 16777619u;
+			return result;
+		}
+
+		Entity mEntities[NumEntity];
+		std::vector< uint32 > mChecksums;
+		double mSaveTime;
+		double mLoadTime;
+		int    mNumSave;
+		int    mNumLoad;
+	};
+
+	// Inputs are held for several frames like real key presses
+	static uint8 GetInput(int slot, int32 frame, uint32 seed)
+	{
+		uint32 value = ( uint32(frame) / 6 ) * 2654435761u ^ uint32(slot + 1) * 40503u ^ seed;
+		value ^= value >> 13;
+		value *= 0x5bd1e995;
+		value ^= value >> 15;
+		return ( value % 3 == 0 ) ? 0 : uint8(value & 0xf);
+	}
+
+	// Reliable in order links , every message is delayed by the latency and a random jitter
+	class LoopbackNetwork
+	{
+	public:
+		LoopbackNetwork(int numPeer, int latency, int jitter, uint32 seed)
+			:mRandom(seed)
+			,mNumPeer(numPeer)
+			,mLatency(latency)
+			,mJitter(jitter)
+			,mTick(0)
+		{
+			mLinks.resize(numPeer * numPeer);
+		}
+
+		struct Message
+		{
+			int   deliverTick;
+			int   slot;
+			FrameInput input;
+		};
+
+		struct Link
+		{
+			int lastDeliverTick = 0;
+			std::deque< Message > messages;
+		};
+
+		void send(int from, int slot, FrameInput const& input)
+		{
+			for( int to = 0; to < mNumPeer; ++to )
+			{
+				if( to == from )
+					continue;
+
+				Link& link = mLinks[from * mNumPeer + to];
+				int deliverTick = mTick + mLatency + ( mJitter ? int(mRandom() % ( mJitter + 1 )) : 0 );
+				//In order delivery : a late message holds back the next ones
+				deliverTick = std::max(deliverTick, link.lastDeliverTick);
+				link.lastDeliverTick = deliverTick;
+
+				Message message;
+				message.deliverTick = deliverTick;
+				message.slot = slot;
+				message.input = input;
+				link.messages.push_back(message);
+			}
+		}
+
+		void receive(int to, RollbackSession& session)
+		{
+			for( int from = 0; from < mNumPeer; ++from )
+			{
+				Link& link = mLinks[from * mNumPeer + to];
+				while( !link.messages.empty() && link.messages.front().deliverTick <= mTick )
+				{
+					Message const& message = link.messages.front();
+					session.addRemoteInput(message.slot, message.input.frame, message.input.getData(), message.input.size);
+					link.messages.pop_front();
+				}
+			}
+		}
+
+		std::mt19937 mRandom;
+		int  mNumPeer;
+		int  mLatency;
+		int  mJitter;
+		int  mTick;
+		std::vector< Link > mLinks;
+	};
+
+	class LoopbackTransport : public IFrameInputTransport
+	{
+	public:
+		LoopbackTransport(LoopbackNetwork& network, int peer) :mNetwork(network), mPeer(peer) {}
+		void sendInput(int slot, FrameInput const& input) override { mNetwork.send(mPeer, slot, input); }
+		void dispatchInputs(RollbackSession& session) override { mNetwork.receive(mPeer, session); }
+
+		LoopbackNetwork& mNetwork;
+		int mPeer;
+	};
+
+	struct Peer
+	{
+		ToyGame game;
+		LoopbackTransport transport;
+		RollbackSession session;
+
+		Peer(LoopbackNetwork& network, int index, int numPeer, int maxRollbackFrames)
+			:transport(network, index)
+			,session(game, transport, numPeer, index, maxRollbackFrames)
+		{
+		}
+	};
+
+	static bool Run(int numPeer, int numFrame, int latency, int jitter, int maxRollbackFrames, uint32 seed)
+	{
+		uint32 const InputSeed = seed * 31 + 7;
+
+		ToyGame reference;
+		{
+			std::vector< FrameInput > inputs(numPeer);
+			std::vector< FrameInput const* > inputPtrs(numPeer);
+			for( int32 frame = 1; frame <= numFrame; ++frame )
+			{
+				for( int slot = 0; slot < numPeer; ++slot )
+				{
+					uint8 key = GetInput(slot, frame, InputSeed);
+					inputs[slot].set(frame, &key, 1, true);
+					inputPtrs[slot] = &inputs[slot];
+				}
+				reference.simulateFrame(frame, inputPtrs.data(), numPeer, false);
+			}
+		}
+
+		LoopbackNetwork network(numPeer, latency, jitter, seed);
+		std::vector< std::unique_ptr< Peer > > peers;
+		for( int i = 0; i < numPeer; ++i )
+			peers.emplace_back(new Peer(network, i, numPeer, maxRollbackFrames));
+
+		size_t warmupMemorySize = 0;
+		double advanceTime = 0;
+		int numTick = 0;
+		for( ;; ++network.mTick )
+		{
+			bool bAllDone = true;
+			for( int i = 0; i < numPeer; ++i )
+			{
+				RollbackSession& session = peers[i]->session;
+				auto startTime = Clock::now();
+				if( session.getFrame() < numFrame )
+				{
+					uint8 key = GetInput(i, session.getFrame() + 1, InputSeed);
+					session.advanceFrame(&key, 1);
+				}
+				else
+				{
+					session.pollInputs();
+				}
+				advanceTime += std::chrono::duration< double, std::micro >(Clock::now() - startTime).count();
+
+				if( session.getConfirmedFrame() < numFrame )
+					bAllDone = false;
+			}
+			++numTick;
+
+			if( network.mTick == 200 )
+			{
+				for( auto& peer : peers )
+					warmupMemorySize += peer->session.getStateMemorySize();
+			}
+			if( bAllDone )
+				break;
+		}
+
+		size_t memorySize = 0;
+		for( auto& peer : peers )
+			memorySize += peer->session.getStateMemorySize();
+
+		bool bPass = true;
+		RollbackStats stats;
+		double saveTime = 0, loadTime = 0;
+		int numSave = 0, numLoad = 0;
+		for( int i = 0; i < numPeer; ++i )
+		{
+			Peer& peer = *peers[i];
+			for( int32 frame = 1; frame <= numFrame; ++frame )
+			{
+				if( peer.game.mChecksums[frame] != reference.mChecksums[frame] )
+				{
+					LogWarning(0, "Peer %d desync at frame %d", i, frame);
+					bPass = false;
+					break;
+				}
+			}
+
+			RollbackStats const& peerStats = peer.session.getStats();
+			stats.numStallFrame += peerStats.numStallFrame;
+			stats.numRollback += peerStats.numRollback;
+			stats.numResimulateFrame += peerStats.numResimulateFrame;
+			stats.maxResimulateFrame = std::max(stats.maxResimulateFrame, peerStats.maxResimulateFrame);
+			stats.numMispredictInput += peerStats.numMispredictInput;
+			saveTime += peer.game.mSaveTime;
+			loadTime += peer.game.mLoadTime;
+			numSave += peer.game.mNumSave;
+			numLoad += peer.game.mNumLoad;
+		}
+
+		LogMsg("Peers = %d Latency = %d Jitter = %d : %s , ticks %d stall %u , rollback %u ( mispredict %u ) resimulate %.2f frames/rollback max %u , save %.2f us load %.2f us , tick %.2f us , snapshot memory %u -> %u",
+			numPeer, latency, jitter, bPass ? "Pass" : "Desync", numTick, stats.numStallFrame, stats.numRollback, stats.numMispredictInput,
+			stats.numRollback ? double(stats.numResimulateFrame) / stats.numRollback : 0.0, stats.maxResimulateFrame,
+			numSave ? saveTime / numSave : 0.0, numLoad ? loadTime / numLoad : 0.0, advanceTime / ( numTick * numPeer ),
+			(unsigned)warmupMemorySize, (unsigned)memorySize);
+		return bPass && warmupMemorySize == memorySize;
+	}
+
+	class NullTransport : public IFrameInputTransport
+	{
+	public:
+		void sendInput(int slot, FrameInput const& input) override {}
+		void dispatchInputs(RollbackSession& session) override {}
+	};
+
+	// Worst case of a tick : restore the oldest snapshot and simulate the whole rollback window again
+	static void RunResimulateCost(int maxRollbackFrames)
+	{
+		ToyGame game;
+		NullTransport transport;
+		RollbackSession session(game, transport, 2, 0, maxRollbackFrames);
+
+		int const NumLoop = 1000;
+		double totalTime = 0;
+		int32 remoteFrame = 0;
+		for( int loop = 0; loop < NumLoop; ++loop )
+		{
+			uint8 key = uint8(loop & 0xf);
+			while( session.advanceFrame(&key, 1) ) {}
+
+			//The remote input of the oldest unconfirmed frame differs from the prediction
+			++remoteFrame;
+			uint8 remoteKey = uint8(1 + ( loop % 15 ));
+			session.addRemoteInput(1, remoteFrame, &remoteKey, 1);
+
+			auto startTime = Clock::now();
+			session.pollInputs();
+			totalTime += std::chrono::duration< double, std::micro >(Clock::now() - startTime).count();
+		}
+
+		RollbackStats const& stats = session.getStats();
+		LogMsg("Rollback %d frames : %.2f us/rollback ( %.2f frames/rollback )",
+			maxRollbackFrames, totalTime / NumLoop, double(stats.numResimulateFrame) / std::max< uint32 >(stats.numRollback, 1));
+	}
+
+	// Remote inputs of any size are kept whole , a truncated or dropped input desyncs or stalls the session
+	static bool RunLargeInput(int maxRollbackFrames)
+	{
+		class InputSumGame : public IRollbackSimulation
+		{
+		public:
+			void saveState(IStreamSerializer& serializer) override { serializer << sum; }
+			void loadState(IStreamSerializer& serializer) override { serializer >> sum; }
+			void simulateFrame(int32 frame, FrameInput const* inputs[], int numSlot, bool bResimulate) override
+			{
+				for( int slot = 0; slot < numSlot; ++slot )
+				{
+					for( uint32 i = 0; i < inputs[slot]->size; ++i )
+						sum += inputs[slot]->getData()[i];
+				}
+			}
+			uint64 sum = 0;
+		};
+
+		InputSumGame game;
+		NullTransport transport;
+		RollbackSession session(game, transport, 2, 0, maxRollbackFrames);
+
+		int const NumFrame = 600;
+		uint8 remoteData[1024];
+		uint64 expectSum = 0;
+		bool bStall = false;
+		for( int32 frame = 1; frame <= NumFrame; ++frame )
+		{
+			uint8 key = uint8(frame);
+			if( !session.advanceFrame(&key, 1) )
+			{
+				bStall = true;
+				break;
+			}
+
+			//The frame is simulated with a predicted remote input first
+			uint32 size = 1 + uint32(frame * 37) % sizeof(remoteData);
+			for( uint32 i = 0; i < size; ++i )
+			{
+				remoteData[i] = uint8(frame + i);
+				expectSum += remoteData[i];
+			}
+			expectSum += key;
+			session.addRemoteInput(1, frame, remoteData, size);
+		}
+		session.pollInputs();
+
+		bool bPass = !bStall && session.getConfirmedFrame() == NumFrame && game.sum == expectSum;
+		LogMsg("Large Input : %s , confirmed frame %d , sum %llu ( expect %llu )",
+			bPass ? "Pass" : "Fail", (int)session.getConfirmedFrame(), game.sum, expectSum);
+		return bPass;
+	}
+
+	void Run()
+	{
+		int const NumFrame = 3000;
+		int const MaxRollbackFrames = 8;
+		bool bPass = true;
+		bPass &= Run(2, NumFrame, 0, 0, MaxRollbackFrames, 1);
+		bPass &= Run(2, NumFrame, 3, 2, MaxRollbackFrames, 2);
+		bPass &= Run(4, NumFrame, 4, 3, MaxRollbackFrames, 3);
+		bPass &= Run(4, NumFrame, 7, 4, MaxRollbackFrames, 4);
+		bPass &= Run(8, NumFrame, 12, 6, MaxRollbackFrames, 5);
+		bPass &= RunLargeInput(MaxRollbackFrames);
+		LogMsg("Rollback Test : %s", bPass ? "Pass" : "Fail");
+
+		RunResimulateCost(MaxRollbackFrames);
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Rollback Test", RollbackTest::Run);
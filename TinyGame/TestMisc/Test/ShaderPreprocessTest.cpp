@@ -0,0 +1,126 @@
+#include "MiscTestRegister.h"
+
+#include "RHI/ShaderFormat.h"
+#include "CPreprocessor.h"
+#include "Async/AsyncWork.h"
+#include "FileSystem.h"
+#include "SystemPlatform.h"
+#include "LogSystem.h"
+
+#include <chrono>
+#include <string>
+
+// Preprocess the permutations of the shader files like a cold start without a GPU : one by one on the calling thread,
+// then as a batch on a thread pool. The batch must output the same codes and find the identical permutations.
+namespace ShaderPreprocessTest
+{
+	using namespace Render;
+	using Clock = std::chrono::high_resolution_clock;
+
+	char const* const ShaderDir = "Shader";
+	int const NumPermutation = 8;
+
+	double GetElapsedMS(Clock::time_point startTime)
+	{
+		return std::chrono::duration< double, std::milli >(Clock::now() - startTime).count();
+	}
+
+	// Half of the permutations only change a define the shader doesn't read , the stage codes of them are identical
+	void SetupDescs(TArray< ShaderCompileDesc >& outDescs)
+	{
+		FileIterator fileIter;
+		if (!FFileSystem::FindFiles(ShaderDir, ".sgc", fileIter))
+			return;
+
+		for (; fileIter.haveMore(); fileIter.goNext())
+		{
+			InlineString< 256 > path;
+			path.format("%s/%s", ShaderDir, fileIter.getFileName());
+			for (int permutation = 0; permutation < NumPermutation; ++permutation)
+			{
+				bool bVertex = permutation % 2 == 0;
+				std::string headCode = "#define COMPILER_HLSL 1\n#define SHADER_COMPILING 1\n";
+				headCode += bVertex ? "#define SHADER_ENTRY_MainVS 1\n#define VERTEX_SHADER 1\n" : "#define SHADER_ENTRY_MainPS 1\n#define PIXEL_SHADER 1\n";
+				headCode += InlineString<>::Make("#define USE_INVERSE_ZBUFFER %d\n", permutation / 4);
+				headCode += InlineString<>::Make("#define TEST_PERMUTATION_UNUSED %d\n", permutation);
+				outDescs.push_back(ShaderCompileDesc(bVertex ? EShader::Vertex : EShader::Pixel, path.c_str(), std::move(headCode), bVertex ? "MainVS" : "MainPS"));
+			}
+		}
+	}
+
+	void Run()
+	{
+		TArray< ShaderCompileDesc > descs;
+		SetupDescs(descs);
+		if (descs.empty())
+		{
+			LogMsg("Shader Preprocess Test : Can't find shader files in %s", ShaderDir);
+			return;
+		}
+
+		ShaderPreprocessSettings settings;
+
+		//The shader manager preprocesses a shader at a time , the loaded include files are shared
+		TArray< TArray< uint8 > > serialCodes;
+		serialCodes.resize(descs.size());
+		int numSerialSuccess = 0;
+		double serialTime;
+		{
+			CPP::CodeSourceLibrary sourceLibrary;
+			auto startTime = Clock::now();
+			for (int i = 0; i < (int)descs.size(); ++i)
+			{
+				if (ShaderFormat::PreprocessCode(descs[i].filePath.c_str(), descs[i].headCode, settings, &sourceLibrary, serialCodes[i], nullptr))
+					++numSerialSuccess;
+				else
+					serialCodes[i].clear();
+			}
+			serialTime = GetElapsedMS(startTime);
+		}
+
+		TArray< ShaderPreprocessJob > jobs;
+		jobs.resize(descs.size());
+		for (int i = 0; i < (int)descs.size(); ++i)
+		{
+			jobs[i].desc = &descs[i];
+		}
+
+		QueueThreadPool threadPool;
+		int numThread = Math::Max(1, SystemPlatform::GetProcessorNumber() - 1);
+		threadPool.init(numThread);
+
+		double batchTime;
+		{
+			CPP::CodeSourceLibrary sourceLibrary;
+			auto startTime = Clock::now();
+			ShaderFormat::PreprocessCodes(MakeView(jobs), settings, sourceLibrary, &threadPool);
+			batchTime = GetElapsedMS(startTime);
+		}
+
+		bool bPass = true;
+		int numUnique = 0;
+		for (int i = 0; i < (int)descs.size(); ++i)
+		{
+			ShaderPreprocessJob const& job = jobs[i];
+			if (job.bSuccess != !serialCodes[i].empty() || (job.bSuccess && job.code != serialCodes[i]))
+			{
+				LogMsg("Preprocess mismatch : %s", descs[i].filePath.c_str());
+				bPass = false;
+			}
+			if (job.bSuccess && job.duplicateIndex == INDEX_NONE)
+				++numUnique;
+			//Only the permutation define is different
+			if (job.bSuccess && i % 4 >= 2 && job.duplicateIndex != i - 2 && job.duplicateIndex != jobs[i - 2].duplicateIndex)
+			{
+				LogMsg("Duplicate not found : %s", descs[i].filePath.c_str());
+				bPass = false;
+			}
+		}
+
+		LogMsg("Preprocess %d permutations ( %d success ) : serial %.2f ms , batch %.2f ms with %d threads ( x%.2f ) , %d unique codes",
+			(int)descs.size(), numSerialSuccess, serialTime, batchTime, numThread, serialTime / batchTime, numUnique);
+		LogMsg("Shader Preprocess Test : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Shader Preprocess Test", ShaderPreprocessTest::Run);
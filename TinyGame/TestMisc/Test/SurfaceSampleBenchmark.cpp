@@ -0,0 +1,130 @@
+#include "MiscTestRegister.h"
+#include "CurveBuilder/ShapeMeshBuilder.h"
+#include "CurveBuilder/ShapeFunction.h"
+#include "CurveBuilder/Surface.h"
+
+#include "Async/AsyncWork.h"
+#include "SystemPlatform.h"
+#include "LogSystem.h"
+
+#include <chrono>
+
+// Rebuild a large surface on one thread and in tiles on the thread pool for each code backend. The positions and
+// normals of the tiled update must match the single thread update , report the rebuild time of both.
+namespace SurfaceSampleBenchmark
+{
+	using namespace CB;
+	using Clock = std::chrono::high_resolution_clock;
+
+	char const* const TestExpr = "sin(sqrt(x*x + y*y) - 1*t) + cos(sqrt(x*x + y*y) + 3*t)";
+
+	int const GridSize = 1024;
+	int const NumRepeat = 4;
+
+	RealType GTime = 0.7f;
+
+	struct MeshSnapshot
+	{
+		TArray< Vector3 > positions;
+		TArray< Vector3 > normals;
+	};
+
+	double RebuildSurface(ShapeMeshBuilder& builder, Surface3D& surface, MeshSnapshot& outSnapshot)
+	{
+		auto startTime = Clock::now();
+		for (int n = 0; n < NumRepeat; ++n)
+		{
+			surface.addUpdateBits(RUF_GEOM);
+			surface.update(builder);
+		}
+		double result = std::chrono::duration< double, std::milli >(Clock::now() - startTime).count() / NumRepeat;
+
+		RenderData& data = *surface.getRenderData();
+		outSnapshot.positions.resize(data.getVertexNum());
+		outSnapshot.normals.resize(data.getVertexNum());
+		for (int i = 0; i < data.getVertexNum(); ++i)
+		{
+			uint8* pVertex = data.getVertexData() + i * data.getVertexSize();
+			outSnapshot.positions[i] = *reinterpret_cast<Vector3*>(pVertex + data.getPositionOffset());
+			outSnapshot.normals[i] = *reinterpret_cast<Vector3*>(pVertex + data.getNormalOffset());
+		}
+		return result;
+	}
+
+	bool CheckSnapshot(MeshSnapshot const& snapshot, MeshSnapshot const& refSnapshot)
+	{
+		float maxPosError = 0;
+		float maxNormalError = 0;
+		for (int i = 0; i < (int)refSnapshot.positions.size(); ++i)
+		{
+			Vector3 offset = snapshot.positions[i] - refSnapshot.positions[i];
+			maxPosError = Math::Max(maxPosError, Math::Max(Math::Abs(offset.x), Math::Max(Math::Abs(offset.y), Math::Abs(offset.z))));
+
+			//The tiles sum the face normals in other order
+			Vector3 normal = snapshot.normals[i];
+			Vector3 refNormal = refSnapshot.normals[i];
+			normal.normalize();
+			refNormal.normalize();
+			maxNormalError = Math::Max(maxNormalError, (normal - refNormal).length());
+		}
+		LogMsg("  max position error %g , max normal error %g", maxPosError, maxNormalError);
+		return maxPosError < 1e-5f && maxNormalError < 1e-4f;
+	}
+
+	void Run()
+	{
+		QueueThreadPool threadPool;
+		threadPool.init(SystemPlatform::GetProcessorNumber());
+
+		struct ExecTypeInfo
+		{
+			ECodeExecType type;
+			char const*   name;
+		};
+		ExecTypeInfo const execTypes[] =
+		{
+			{ ECodeExecType::Asm , "Asm" },
+			{ ECodeExecType::ByteCode , "ByteCode" },
+#if ENABLE_BYTE_CODE_BATCH
+			{ ECodeExecType::ByteCodeBatch , "ByteCode Batch" },
+#endif
+		};
+
+		LogMsg("Surface %d x %d , %d threads", GridSize, GridSize, threadPool.getAllThreadNum());
+		bool bPass = true;
+		for (auto const& info : execTypes)
+		{
+			ShapeMeshBuilder builder;
+			builder.bindTime(GTime);
+			builder.setExecType(info.type);
+			builder.setGenerateSIMD(true);
+
+			Surface3D surface;
+			SurfaceXYFunc* func = new SurfaceXYFunc(false);
+			func->setExpr(TestExpr);
+			surface.setFunction(func);
+			surface.setRangeU(Range(-10, 10));
+			surface.setRangeV(Range(-10, 10));
+			surface.setDataSampleNum(GridSize, GridSize);
+			if (!surface.update(builder))
+			{
+				LogWarning(0, "Parse surface function fail : %s", TestExpr);
+				bPass = false;
+				continue;
+			}
+
+			MeshSnapshot refSnapshot;
+			MeshSnapshot snapshot;
+			builder.setThreadPool(nullptr);
+			double singleTime = RebuildSurface(builder, surface, refSnapshot);
+			builder.setThreadPool(&threadPool);
+			double tileTime = RebuildSurface(builder, surface, snapshot);
+
+			LogMsg("%-14s single thread %8.2f ms , tiles %8.2f ms x%4.1f", info.name, singleTime, tileTime, singleTime / tileTime);
+			bPass &= CheckSnapshot(snapshot, refSnapshot);
+		}
+		LogMsg("Surface Sample Benchmark : %s", bPass ? "Pass" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("Surface Sample Benchmark", SurfaceSampleBenchmark::Run);
@@ -0,0 +1,89 @@
+#include "MiscTestRegister.h"
+
+#include "Async/TaskGraph.h"
+#include "LogSystem.h"
+
+#include <chrono>
+
+namespace TaskGraphTest
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	// The root is cancelled while the only worker is busy , its successors must not run
+	static bool RunAbandon()
+	{
+		QueueThreadPool pool;
+		pool.init(1);
+
+		std::atomic< bool > bGateOpen(false);
+		std::atomic< bool > bGateEntered(false);
+		QueuedWorkGroup gateGroup;
+		pool.addFunctionWork(gateGroup, [&]()
+		{
+			bGateEntered = true;
+			while (!bGateOpen) {}
+		});
+		while (!bGateEntered) {}
+
+		std::atomic< int > numRun(0);
+		TaskGraph graph;
+		auto root = graph.addNode("Root", [&]() { ++numRun; });
+		auto stage = graph.addNode("Stage", [&]() { ++numRun; }, { root });
+		graph.addNode("Final", [&]() { ++numRun; }, { stage, root });
+
+		QueuedWorkGroup group;
+		graph.dispatch(pool, group);
+		pool.cencelAllWorks();
+		bGateOpen = true;
+		pool.waitWorkGroup(gateGroup);
+		pool.waitWorkGroup(group);
+		return numRun == 0;
+	}
+
+	void Run()
+	{
+		QueueThreadPool pool;
+		pool.init(8);
+
+		//  Move -> Neighbor -> Solve -> Walls
+		//                           \-> Queries
+		std::atomic< int > stamp(0);
+		int moveStamp, neighborStamp, solveStamp, wallStamp, queryStamp;
+
+		TaskGraph graph;
+		auto move = graph.addNode("Move", [&]() { moveStamp = stamp++; });
+		auto neighbor = graph.addNode("Neighbor", [&]() { neighborStamp = stamp++; }, { move });
+		auto solve = graph.addNode("Solve", [&]() { solveStamp = stamp++; }, { neighbor });
+		graph.addNode("Walls", [&]() { wallStamp = stamp++; }, { solve });
+		graph.addNode("Queries", [&]() { queryStamp = stamp++; }, { solve });
+
+		int const NumRun = 10000;
+		bool bOrderOK = true;
+		auto startTime = Clock::now();
+		for (int i = 0; i < NumRun; ++i)
+		{
+			stamp = 0;
+			graph.run(pool);
+			bOrderOK &= moveStamp < neighborStamp && neighborStamp < solveStamp && solveStamp < wallStamp && solveStamp < queryStamp;
+		}
+		double graphTime = std::chrono::duration<double, std::micro>(Clock::now() - startTime).count() / NumRun;
+
+		// Same chain with pool barriers between stages
+		startTime = Clock::now();
+		for (int i = 0; i < NumRun; ++i)
+		{
+			for (int stage = 0; stage < 5; ++stage)
+			{
+				pool.addFunctionWork([&]() { ++stamp; });
+				pool.waitAllWorkComplete();
+			}
+		}
+		double barrierTime = std::chrono::duration<double, std::micro>(Clock::now() - startTime).count() / NumRun;
+
+		LogMsg("TaskGraph order %s : graph = %.2f us/run , barrier = %.2f us/run", bOrderOK ? "OK" : "Fail", graphTime, barrierTime);
+
+		LogMsg("TaskGraph abandon %s", RunAbandon() ? "OK" : "Fail");
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("TaskGraph Test", TaskGraphTest::Run);
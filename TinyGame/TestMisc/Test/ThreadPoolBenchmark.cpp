@@ -0,0 +1,345 @@
+#include "MiscTestRegister.h"
+
+#include "Async/AsyncWork.h"
+#include "Async/ParallelFor.h"
+#include "Memory/FrameAllocator.h"
+#include "LogSystem.h"
+#include "SystemPlatform.h"
+
+#include <chrono>
+#include <intrin.h>
+
+namespace ThreadPoolBenchmark
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	static double ToMicroseconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+
+	static void DoDummyWork(int count)
+	{
+		volatile int sum = 0;
+		for (int i = 0; i < count; ++i)
+			sum += i;
+	}
+
+	class DummyWork : public IQueuedWork
+	{
+	public:
+		void executeWork() override { DoDummyWork(workLoad); }
+		void release() override {}
+		int workLoad = 0;
+	};
+
+	// The QueueThreadPool before the work stealing : one shared queue , idle threads are handed the works directly
+	// and the callers can only wait the whole pool idle. Kept as the baseline of the benchmark.
+	class LegacyThreadPool
+	{
+	public:
+		~LegacyThreadPool()
+		{
+			waitAllWorkComplete();
+			for (LegacyThread* runThread : mAllThreads)
+			{
+				runThread->waitToKill();
+				delete runThread;
+			}
+		}
+
+		void init(int numThread)
+		{
+			for (int i = 0; i < numThread; ++i)
+			{
+				LegacyThread* runThread = new LegacyThread;
+				runThread->mOwningPool = this;
+				runThread->start();
+				mAllThreads.push_back(runThread);
+				mQueuedThreads.push_back(runThread);
+			}
+		}
+
+		void addWork(IQueuedWork* work)
+		{
+			LegacyThread* runThread = nullptr;
+			{
+				SpinLock::Locker locker(mQueueLock);
+				if (mQueuedThreads.empty())
+				{
+					mQueuedWorks.push_back(work);
+					return;
+				}
+				runThread = mQueuedThreads.back();
+				mQueuedThreads.pop_back();
+			}
+			runThread->doWork(work);
+		}
+
+		void addWorks(IQueuedWork* works[], int count)
+		{
+			TArray< LegacyThread*, TInlineAllocator<64> > dispatched;
+			{
+				SpinLock::Locker locker(mQueueLock);
+				int workIdx = 0;
+				while (!mQueuedThreads.empty() && workIdx < count)
+				{
+					LegacyThread* runThread = mQueuedThreads.back();
+					mQueuedThreads.pop_back();
+					runThread->mWork.store(works[workIdx++], std::memory_order_release);
+					dispatched.push_back(runThread);
+				}
+				if (workIdx < count)
+				{
+					mQueuedWorks.addRange(works + workIdx, works + count);
+				}
+			}
+
+			for (LegacyThread* runThread : dispatched)
+			{
+				Mutex::Locker locker(runThread->mWaitWorkMutex);
+				runThread->mWaitWorkCV.notifyOne();
+			}
+		}
+
+		template< class TFunc >
+		void addFunctionWork(TFunc&& func)
+		{
+			class TFuncWork : public IQueuedWork
+			{
+			public:
+				TFuncWork(TFunc&& func) :mFunc(std::forward<TFunc>(func)) {}
+				void executeWork() override { mFunc(); }
+				void release() override { delete this; }
+				std::decay_t<TFunc> mFunc;
+			};
+			addWork(new TFuncWork(std::forward<TFunc>(func)));
+		}
+
+		void waitAllWorkComplete()
+		{
+			Mutex::Locker locker(mQueueMutex);
+			mWaitCompleteCV.wait(locker, [this]()
+			{
+				SpinLock::Locker spinLock(mQueueLock);
+				return mAllThreads.size() == mQueuedThreads.size() && mQueuedWorks.empty();
+			});
+		}
+
+	private:
+		class LegacyThread : public RunnableThreadT< LegacyThread >
+		{
+		public:
+			unsigned run()
+			{
+				while (!mWantDie)
+				{
+					for (int i = 0; i < 1000; ++i)
+					{
+						if (mWork.load(std::memory_order_relaxed) != nullptr || mWantDie)
+							break;
+						_mm_pause();
+					}
+					if (mWork.load(std::memory_order_relaxed) == nullptr && !mWantDie)
+					{
+						Mutex::Locker locker(mWaitWorkMutex);
+						mWaitWorkCV.wait(locker, [this]()->bool { return mWork.load(std::memory_order_relaxed) != nullptr || mWantDie; });
+					}
+
+					IQueuedWork* currentWork = mWork.exchange(nullptr, std::memory_order_acq_rel);
+					while (currentWork)
+					{
+						currentWork->executeWork();
+						currentWork->release();
+						currentWork = mOwningPool->doWorkCompleted(this);
+					}
+				}
+				return 0;
+			}
+
+			void doWork(IQueuedWork* work)
+			{
+				mWork.store(work, std::memory_order_release);
+				Mutex::Locker locker(mWaitWorkMutex);
+				mWaitWorkCV.notifyOne();
+			}
+
+			void waitToKill()
+			{
+				{
+					Mutex::Locker locker(mWaitWorkMutex);
+					SystemPlatform::AtomExchange(&mWantDie, 1);
+					mWaitWorkCV.notifyOne();
+				}
+				join();
+			}
+
+			LegacyThreadPool* mOwningPool = nullptr;
+			std::atomic< IQueuedWork* > mWork{ nullptr };
+			ConditionVariable mWaitWorkCV;
+			Mutex             mWaitWorkMutex;
+			volatile int32    mWantDie = 0;
+		};
+
+		IQueuedWork* doWorkCompleted(LegacyThread* runThread)
+		{
+			IQueuedWork* outWork = nullptr;
+			{
+				SpinLock::Locker locker(mQueueLock);
+				if (mQueuedWorks.empty())
+				{
+					mQueuedThreads.push_back(runThread);
+				}
+				else
+				{
+					outWork = mQueuedWorks.front();
+					mQueuedWorks.pop_front();
+				}
+			}
+			if (outWork == nullptr)
+			{
+				Mutex::Locker lock(mQueueMutex);
+				mWaitCompleteCV.notifyAll();
+			}
+			return outWork;
+		}
+
+		Mutex        mQueueMutex;
+		SpinLock     mQueueLock;
+		TCycleQueue< IQueuedWork* > mQueuedWorks;
+		TArray< LegacyThread* > mQueuedThreads;
+		TArray< LegacyThread* > mAllThreads;
+		ConditionVariable       mWaitCompleteCV;
+	};
+
+	// Time from submit to the work start running
+	static double MeasureSubmitLatency(QueueThreadPool& pool, int numSample)
+	{
+		double totalTime = 0;
+		for (int i = 0; i < numSample; ++i)
+		{
+			QueuedWorkGroup group;
+			Clock::time_point startTime;
+			Clock::time_point runTime;
+			startTime = Clock::now();
+			pool.addFunctionWork(group, [&runTime]()
+			{
+				runTime = Clock::now();
+			});
+			pool.waitWorkGroup(group);
+			totalTime += ToMicroseconds(runTime - startTime);
+		}
+		return totalTime / numSample;
+	}
+
+	static double MeasureSubmitLatency(LegacyThreadPool& pool, int numSample)
+	{
+		double totalTime = 0;
+		for (int i = 0; i < numSample; ++i)
+		{
+			Clock::time_point startTime;
+			Clock::time_point runTime;
+			startTime = Clock::now();
+			pool.addFunctionWork([&runTime]()
+			{
+				runTime = Clock::now();
+			});
+			pool.waitAllWorkComplete();
+			totalTime += ToMicroseconds(runTime - startTime);
+		}
+		return totalTime / numSample;
+	}
+
+	// Legacy way : queue works and wait whole pool idle
+	template< typename TPool >
+	static double MeasureBarrierThroughput(TPool& pool, int numWork, int workLoad)
+	{
+		TArray< DummyWork > works;
+		works.resize(numWork);
+		TArray< IQueuedWork* > workPtrs;
+		for (auto& work : works)
+		{
+			work.workLoad = workLoad;
+			workPtrs.push_back(&work);
+		}
+
+		auto startTime = Clock::now();
+		pool.addWorks(workPtrs.data(), numWork);
+		pool.waitAllWorkComplete();
+		return numWork / (ToMicroseconds(Clock::now() - startTime) * 1e-6);
+	}
+
+	static double MeasureGroupThroughput(QueueThreadPool& pool, FrameAllocator& allocator, int numWork, int workLoad)
+	{
+		auto startTime = Clock::now();
+		ParallelFor(pool, allocator, "Benchmark", numWork, [workLoad](int index)
+		{
+			DoDummyWork(workLoad);
+		}, 1);
+		return numWork / (ToMicroseconds(Clock::now() - startTime) * 1e-6);
+	}
+
+	// Nested batches submitted in workers, the case pool barrier can't handle
+	static double MeasureNestedThroughput(QueueThreadPool& pool, int numOuter, int numInner, int workLoad)
+	{
+		auto startTime = Clock::now();
+		QueuedWorkGroup outerGroup;
+		for (int i = 0; i < numOuter; ++i)
+		{
+			pool.addFunctionWork(outerGroup, [&pool, numInner, workLoad]()
+			{
+				QueuedWorkGroup innerGroup;
+				for (int n = 0; n < numInner; ++n)
+				{
+					pool.addFunctionWork(innerGroup, [workLoad]()
+					{
+						DoDummyWork(workLoad);
+					});
+				}
+				pool.waitWorkGroup(innerGroup);
+			});
+		}
+		pool.waitWorkGroup(outerGroup);
+		return numOuter * numInner / (ToMicroseconds(Clock::now() - startTime) * 1e-6);
+	}
+
+	void Run()
+	{
+		int const NumWork = 20000;
+		int const WorkLoad = 200;
+
+		FrameAllocator allocator(1024 * 1024);
+		for (int numThread = 1; numThread <= 64; numThread *= 2)
+		{
+			double legacyLatency;
+			double legacyBarrierRate;
+			{
+				LegacyThreadPool pool;
+				pool.init(numThread);
+
+				//warm up
+				MeasureBarrierThroughput(pool, 1000, WorkLoad);
+
+				legacyLatency = MeasureSubmitLatency(pool, 1000);
+				legacyBarrierRate = MeasureBarrierThroughput(pool, NumWork, WorkLoad);
+			}
+
+			QueueThreadPool pool;
+			pool.init(numThread);
+
+			//warm up
+			MeasureBarrierThroughput(pool, 1000, WorkLoad);
+
+			double latency = MeasureSubmitLatency(pool, 1000);
+			double barrierRate = MeasureBarrierThroughput(pool, NumWork, WorkLoad);
+			double groupRate = MeasureGroupThroughput(pool, allocator, NumWork, WorkLoad);
+			double nestedRate = MeasureNestedThroughput(pool, 64, NumWork / 64, WorkLoad);
+
+			//The legacy pool has no work group , the group and nested batches need the new pool
+			LogMsg("Threads = %2d : Submit Latency = %.2f us (legacy %.2f us) , Barrier = %.0f works/s (legacy %.0f works/s) , Group = %.0f works/s , Nested = %.0f works/s",
+				numThread, latency, legacyLatency, barrierRate, legacyBarrierRate, groupRate, nestedRate);
+		}
+	}
+}
+
+REGISTER_MISC_TEST_ENTRY("ThreadPool Benchmark", ThreadPoolBenchmark::Run);
@@ -0,0 +1,327 @@
+#include "TinyGamePCH.h"
+#include "CPredictFrameManager.h"
+
+#include "GameServer.h"
+#include "GameClient.h"
+#include "GameAction.h"
+#include "GameNetPacket.h"
+
+#include <algorithm>
+
+int const UseChannel = CHANNEL_GAME_NET_UDP_CHAIN;
+int const StatsReportFrameNum = 600;
+
+CPredictFrameManager::CPredictFrameManager( NetWorker* worker , IFrameActionTemplate* actionTemp ,
+	                                        INetFrameCollector* localCollector , INetFrameCollector* mergeCollector ,
+	                                        IFrameStateHandler* stateHandler , int maxRollbackFrames )
+	:mInputPacket( new GDPFrameInput )
+{
+	mWorker = worker;
+	mActionTemplate = actionTemp;
+	mLocalCollector = localCollector;
+	mMergeCollector = mergeCollector;
+	mStateHandler = stateHandler;
+	mNumPendingInput = 0;
+	mbHaveFrameData = false;
+
+	//Every end build the same slot order from the player ids.
+	//Computer players are driven by the simulation and never send input , they have no slot
+	IPlayerManager* playerManager = mWorker->getPlayerManager();
+	for( auto iter = playerManager->createIterator(); iter; ++iter )
+	{
+		GamePlayer* player = iter.getElement();
+		if( player->getType() == PT_COMPUTER )
+			continue;
+		mSlotPlayers.push_back( player->getId() );
+	}
+	std::sort( mSlotPlayers.begin() , mSlotPlayers.end() );
+
+	mUserPlayer = playerManager->getUser();
+	int localSlot = findSlot( playerManager->getUserID() );
+	assert( localSlot != INDEX_NONE );
+
+	mMergeCollector->reflashPlayer( *playerManager );
+
+	// Setup own processor for collection phase
+	mProcessor.setLanucher( this );
+	mLocalCollector->setupAction( mProcessor );
+
+	mSession.reset( new RollbackSession( *this , *this , (int)mSlotPlayers.size() , localSlot , maxRollbackFrames ) );
+}
+
+CPredictFrameManager::~CPredictFrameManager()
+{
+	mWorker->removeProcesserFunc( this );
+}
+
+int CPredictFrameManager::findSlot( PlayerId id ) const
+{
+	for( int i = 0; i < (int)mSlotPlayers.size(); ++i )
+	{
+		if( mSlotPlayers[i] == id )
+			return i;
+	}
+	return INDEX_NONE;
+}
+
+void CPredictFrameManager::attachTo( ActionProcessor& processor )
+{
+	mMainProcessor = &processor;
+	processor.addInput( *this );
+}
+
+int CPredictFrameManager::evalFrame( IFrameUpdater& updater , int updateFrames , int maxDelayFrames )
+{
+	mUpdater = &updater;
+
+	int frameCount = 0;
+	while( frameCount < updateFrames )
+	{
+		mProcessor.beginAction( CTF_BLOCK_ACTION );
+		mProcessor.endAction();
+
+		mInputBuffer.clear();
+		if( mLocalCollector->haveFrameData( mSession->getFrame() + 1 ) )
+		{
+			auto serializer = CreateSerializer( mInputBuffer );
+			mLocalCollector->collectFrameData( serializer );
+		}
+
+		//The input stays in the collector , the same input is used when the frame is stalled
+		if( !mSession->advanceFrame( mInputBuffer.getData() , (uint32)mInputBuffer.getFillSize() ) )
+			break;
+
+		++frameCount;
+	}
+
+	updater.updateFrame( frameCount );
+	reportStats();
+	return mSession->getFrame();
+}
+
+void CPredictFrameManager::resetFrameData()
+{
+	mNumPendingInput = 0;
+	mSession->reset();
+}
+
+void CPredictFrameManager::fireAction( ActionTrigger& trigger )
+{
+	if( mUserPlayer == nullptr || mUserPlayer->getActionPort() == ERROR_ACTION_PORT )
+		return;
+
+	mActionTemplate->firePortAction( mUserPlayer->getActionPort() , trigger );
+}
+
+bool CPredictFrameManager::scanInput( bool beUpdateFrame )
+{
+	if( !beUpdateFrame || !mbHaveFrameData )
+		return false;
+
+	mFrameDataBuffer.setUseSize( 0 );
+	auto serializer = CreateSerializer( mFrameDataBuffer );
+	mActionTemplate->restoreFrameData( serializer , mFrameDataBuffer.getAvailableSize() != 0 );
+	return true;
+}
+
+bool CPredictFrameManager::checkAction( ActionParam& param )
+{
+	return mActionTemplate->checkAction( param );
+}
+
+void CPredictFrameManager::saveState( IStreamSerializer& serializer )
+{
+	mStateHandler->saveFrameState( serializer );
+}
+
+void CPredictFrameManager::loadState( IStreamSerializer& serializer )
+{
+	mStateHandler->loadFrameState( serializer );
+}
+
+void CPredictFrameManager::simulateFrame( int32 frame , FrameInput const* inputs[] , int numSlot , bool bResimulate )
+{
+	assert( mUpdater );
+
+	//Merge the slot inputs like the server merges the client frame data
+	mMergeCollector->prevProcCommand();
+	for( int slot = 0; slot < numSlot; ++slot )
+	{
+		FrameInput const& input = *inputs[slot];
+		if( input.size == 0 )
+			continue;
+
+		mSlotDataBuffer.clear();
+		mSlotDataBuffer.fill( (void const*)input.getData() , input.size );
+		try
+		{
+			mMergeCollector->processClientFrameData( mSlotPlayers[slot] , mSlotDataBuffer );
+		}
+		catch( BufferException& )
+		{
+			LogWarning(0, "Bad frame input : slot = %d , frame = %d", slot, (int)frame);
+		}
+	}
+
+	mFrameDataBuffer.clear();
+	if( mMergeCollector->haveFrameData( frame ) )
+	{
+		auto serializer = CreateSerializer( mFrameDataBuffer );
+		mMergeCollector->collectFrameData( serializer );
+	}
+
+	if( bResimulate )
+		mStateHandler->setResimulating( true );
+
+	mbHaveFrameData = true;
+	mUpdater->tick();
+	mbHaveFrameData = false;
+
+	if( bResimulate )
+		mStateHandler->setResimulating( false );
+}
+
+void CPredictFrameManager::queueInput( int slot , int32 frame , DataStreamBuffer& buffer )
+{
+	if( slot == INDEX_NONE )
+		return;
+
+	if( mNumPendingInput == (int)mPendingInputs.size() )
+		mPendingInputs.resize( mNumPendingInput + 1 );
+
+	PendingInput& pending = mPendingInputs[mNumPendingInput];
+	pending.slot = slot;
+	pending.input.set( frame , buffer.getData() + buffer.getUseSize() , (uint32)buffer.getAvailableSize() , true );
+	++mNumPendingInput;
+}
+
+void CPredictFrameManager::dispatchInputs( RollbackSession& session )
+{
+	for( int i = 0; i < mNumPendingInput; ++i )
+	{
+		PendingInput const& pending = mPendingInputs[i];
+		session.addRemoteInput( pending.slot , pending.input.frame , pending.input.getData() , pending.input.size );
+	}
+	mNumPendingInput = 0;
+}
+
+void CPredictFrameManager::reportStats()
+{
+	RollbackStats const& stats = mSession->getStats();
+	if( stats.numFrame < StatsReportFrameNum )
+		return;
+
+	LogDevMsg(0, "Rollback : stall = %u , rollback = %u , resimulate = %u frames ( max = %u ) , mispredict = %u , state memory = %u",
+		stats.numStallFrame, stats.numRollback, stats.numResimulateFrame, stats.maxResimulateFrame, stats.numMispredictInput, (unsigned)mSession->getStateMemorySize());
+	mSession->resetStats();
+}
+
+SVPredictFrameManager::SVPredictFrameManager( NetWorker* worker , IFrameActionTemplate* actionTemp ,
+	                                          INetFrameCollector* localCollector , INetFrameCollector* mergeCollector ,
+	                                          IFrameStateHandler* stateHandler , int maxRollbackFrames )
+	:CPredictFrameManager( worker , actionTemp , localCollector , mergeCollector , stateHandler , maxRollbackFrames )
+{
+	assert( worker->isServer() );
+	mServerWorker = static_cast< ServerWorker* >( worker );
+	mServerWorker->setUserFunc< GDPFrameInput >( this , &SVPredictFrameManager::procFrameInput );
+
+	//Local players besides the user have no end to send their input
+	IPlayerManager* playerManager = mWorker->getPlayerManager();
+	for( int slot = 0; slot < (int)mSlotPlayers.size(); ++slot )
+	{
+		ServerPlayer* player = static_cast< ServerPlayer* >( playerManager->getPlayer( mSlotPlayers[slot] ) );
+		if( player->getId() != playerManager->getUserID() && !player->isNetwork() )
+			mLocalInputSlots.push_back( slot );
+	}
+	mLocalInputFrame = 0;
+}
+
+SVPredictFrameManager::~SVPredictFrameManager()
+{
+
+}
+
+void SVPredictFrameManager::resetFrameData()
+{
+	CPredictFrameManager::resetFrameData();
+	mLocalInputFrame = 0;
+}
+
+void SVPredictFrameManager::dispatchInputs( RollbackSession& session )
+{
+	//Confirm an empty input of the next frame for the local slots and relay it to the clients
+	int32 frame = session.getFrame() + 1;
+	if( frame > mLocalInputFrame )
+	{
+		for( int slot : mLocalInputSlots )
+		{
+			mLocalInput.set( frame , nullptr , 0 , true );
+			session.addRemoteInput( slot , frame , nullptr , 0 );
+			sendInput( slot , mLocalInput );
+		}
+		mLocalInputFrame = frame;
+	}
+	CPredictFrameManager::dispatchInputs( session );
+}
+
+void SVPredictFrameManager::sendInput( int slot , FrameInput const& input )
+{
+	mInputPacket->frame = input.frame;
+	mInputPacket->slot = uint8( slot );
+	mInputPacket->buffer.clear();
+	if( input.size )
+		mInputPacket->buffer.fill( (void const*)input.getData() , input.size );
+
+	mServerWorker->sendCommand( UseChannel , mInputPacket.get() , WSF_IGNORE_LOCAL );
+}
+
+void SVPredictFrameManager::procFrameInput( IComPacket* cp )
+{
+	NetClientData* info = static_cast< NetClientData* >( cp->getUserData() );
+	if( !info )
+		return;
+
+	GDPFrameInput* packet = cp->cast< GDPFrameInput >();
+	//The slot is taken from the connection , a client only sends its own input
+	int slot = findSlot( info->ownerId );
+	if( slot == INDEX_NONE )
+		return;
+
+	packet->slot = uint8( slot );
+	queueInput( slot , packet->frame , packet->buffer );
+
+	//Clients ignore their own input and the inputs they already have
+	packet->buffer.setUseSize( 0 );
+	mServerWorker->sendCommand( UseChannel , packet , WSF_IGNORE_LOCAL );
+}
+
+CLPredictFrameManager::CLPredictFrameManager( NetWorker* worker , IFrameActionTemplate* actionTemp ,
+	                                          INetFrameCollector* localCollector , INetFrameCollector* mergeCollector ,
+	                                          IFrameStateHandler* stateHandler , int maxRollbackFrames )
+	:CPredictFrameManager( worker , actionTemp , localCollector , mergeCollector , stateHandler , maxRollbackFrames )
+{
+	assert( !worker->isServer() );
+	mWorker->setUserFunc< GDPFrameInput >( this , &CLPredictFrameManager::procFrameInput );
+}
+
+CLPredictFrameManager::~CLPredictFrameManager()
+{
+
+}
+
+void CLPredictFrameManager::sendInput( int slot , FrameInput const& input )
+{
+	mInputPacket->frame = input.frame;
+	mInputPacket->slot = uint8( slot );
+	mInputPacket->buffer.clear();
+	if( input.size )
+		mInputPacket->buffer.fill( (void const*)input.getData() , input.size );
+
+	mWorker->sendCommand( UseChannel , mInputPacket.get() , WSF_NONE );
+}
+
+void CLPredictFrameManager::procFrameInput( IComPacket* cp )
+{
+	GDPFrameInput* packet = cp->cast< GDPFrameInput >();
+	queueInput( packet->slot < mSlotPlayers.size() ? packet->slot : INDEX_NONE , packet->frame , packet->buffer );
+}
@@ -2,12 +2,126 @@
 #define CPredictFrameManager_h__
 
 #include "CFrameActionNetEngine.h"
+#include "GameControl.h"
+#include "DataStreamBuffer.h"
+#include "RollbackSession.h"
+#include "Holder.h"
+
+class IFrameActionTemplate;
+class INetFrameCollector;
+class GDPFrameInput;
+class ServerWorker;
+class GamePlayer;
+
+// Rollback frame manager : the local input is applied at once and remote inputs are predicted.
+// Every human player is an input slot of the RollbackSession , the inputs of the slots are merged with a
+// server style collector and restored to the action template for each simulated frame.
 class CPredictFrameManager : public INetFrameManager
+	                       , public IActionLauncher
+	                       , public IActionInput
+	                       , public IRollbackSimulation
+	                       , public IFrameInputTransport
 {
 public:
+	CPredictFrameManager( NetWorker* worker , IFrameActionTemplate* actionTemp ,
+		                  INetFrameCollector* localCollector , INetFrameCollector* mergeCollector ,
+		                  IFrameStateHandler* stateHandler , int maxRollbackFrames );
+	~CPredictFrameManager();
+
+	// INetFrameManager
+	void  attachTo( ActionProcessor& processor ) override;
+	ActionProcessor& getCollectionProcessor() override { return mProcessor; }
+	int   evalFrame( IFrameUpdater& updater , int updateFrames , int maxDelayFrames ) override;
+	void  resetFrameData() override;
+	void  release() override { delete this; }
+
+	// IActionLauncher
+	void  fireAction( ActionTrigger& trigger ) override;
+
+	// IActionInput - provides the merged inputs of the simulated frame
+	bool  scanInput( bool beUpdateFrame ) override;
+	bool  checkAction( ActionParam& param ) override;
+
+	// IRollbackSimulation
+	void  saveState( IStreamSerializer& serializer ) override;
+	void  loadState( IStreamSerializer& serializer ) override;
+	void  simulateFrame( int32 frame , FrameInput const* inputs[] , int numSlot , bool bResimulate ) override;
 
+	// IFrameInputTransport
+	void  dispatchInputs( RollbackSession& session ) override;
 
+	RollbackSession& getSession() { return *mSession; }
+
+protected:
+	int   findSlot( PlayerId id ) const;
+	void  queueInput( int slot , int32 frame , DataStreamBuffer& buffer );
+	void  reportStats();
+
+	NetWorker*            mWorker;
+	IFrameActionTemplate* mActionTemplate;
+	INetFrameCollector*   mLocalCollector;
+	INetFrameCollector*   mMergeCollector;
+	IFrameStateHandler*   mStateHandler;
+	GamePlayer*           mUserPlayer;
+
+	TPtrHolder< RollbackSession > mSession;
+	TPtrHolder< GDPFrameInput >   mInputPacket;
+	TArray< PlayerId >    mSlotPlayers;
+
+	//Received inputs wait here until the next dispatch , the entries are reused
+	struct PendingInput
+	{
+		int        slot;
+		FrameInput input;
+	};
+	TArray< PendingInput > mPendingInputs;
+	int                   mNumPendingInput;
+
+	ActionProcessor       mProcessor;
+	ActionProcessor*      mMainProcessor = nullptr;
+	IFrameUpdater*        mUpdater = nullptr;
+	DataStreamBuffer      mInputBuffer;
+	//Inputs are merged during a rollback too , don't share the local input buffer
+	DataStreamBuffer      mSlotDataBuffer;
+	DataStreamBuffer      mFrameDataBuffer;
+	bool                  mbHaveFrameData;
 };
 
+class SVPredictFrameManager : public CPredictFrameManager
+{
+public:
+	TINY_API SVPredictFrameManager( NetWorker* worker , IFrameActionTemplate* actionTemp ,
+		                            INetFrameCollector* localCollector , INetFrameCollector* mergeCollector ,
+		                            IFrameStateHandler* stateHandler , int maxRollbackFrames = 8 );
+	TINY_API ~SVPredictFrameManager();
+
+	void  resetFrameData() override;
+	void  dispatchInputs( RollbackSession& session ) override;
+	void  sendInput( int slot , FrameInput const& input ) override;
+
+private:
+	// Client inputs are relayed to the other clients
+	void  procFrameInput( IComPacket* cp );
+
+	ServerWorker* mServerWorker;
+	// Slots of the local players besides the user , their empty inputs are confirmed by the server
+	TArray< int > mLocalInputSlots;
+	int32         mLocalInputFrame;
+	FrameInput    mLocalInput;
+};
+
+class CLPredictFrameManager : public CPredictFrameManager
+{
+public:
+	TINY_API CLPredictFrameManager( NetWorker* worker , IFrameActionTemplate* actionTemp ,
+		                            INetFrameCollector* localCollector , INetFrameCollector* mergeCollector ,
+		                            IFrameStateHandler* stateHandler , int maxRollbackFrames = 8 );
+	TINY_API ~CLPredictFrameManager();
+
+	void  sendInput( int slot , FrameInput const& input ) override;
+
+private:
+	void  procFrameInput( IComPacket* cp );
+};
 
 #endif // CPredictFrameManager_h__
@@ -9,6 +9,7 @@
 #define USE_UDP_FRAME_DATA 1
 #define RESET_DATA_FRAME (-1)
 int const UseChannel = CHANNEL_GAME_NET_UDP_CHAIN;
+int const CodecStatsReportFrameNum = 600;
 
 
 FrameDataManager::FrameDataManager()
@@ -126,6 +127,38 @@ bool CSyncFrameManager::checkAction( ActionParam& param )
 	return mActionTemplate->checkAction( param );
 }
 
+void CSyncFrameManager::encodeFrameData( int32 frame , DataStreamBuffer& outBuffer )
+{
+	mFrameDataBuffer.clear();
+	if( mFrameCollector->haveFrameData(frame) )
+	{
+		auto dataStream = CreateSerializer(mFrameDataBuffer);
+		mFrameCollector->collectFrameData(dataStream);
+	}
+
+	outBuffer.clear();
+	uint32 codedSize = mFrameEncoder.encode( mFrameDataBuffer.getData() , (uint32)mFrameDataBuffer.getFillSize() );
+	if( codedSize )
+	{
+		outBuffer.fill( (void const*)mFrameEncoder.getCodedData().data() , codedSize );
+	}
+}
+
+bool CSyncFrameManager::DecodeFrameData( FrameDataDecoder& decoder , DataStreamBuffer& buffer )
+{
+	bool bOk = decoder.decode( buffer.getData() + buffer.getUseSize() , (uint32)buffer.getAvailableSize() );
+	buffer.clear();
+	if( !bOk )
+		return false;
+
+	auto const& frameData = decoder.getFrameData();
+	if( !frameData.empty() )
+	{
+		buffer.fill( (void const*)frameData.data() , frameData.size() );
+	}
+	return true;
+}
+
 int CSyncFrameManager::evalFrame( IFrameUpdater& updater , int updateFrames , int maxDelayFrames )
 {
 	if( bClearData )
@@ -298,33 +331,50 @@ bool SVSyncFrameManager::sendFrameData()
 	mCountDataDelay = 0;
 
 	int32 frame = mFrameMgr.getFrame() + 1;
-	mFrameStream->buffer.clear();
 	mFrameStream->frame = frame;
-
-	auto dataSteam = CreateSerializer(mFrameStream->buffer);
-	if( mFrameCollector->haveFrameData(frame) )
-	{
-		mFrameCollector->collectFrameData(dataSteam);
-	}
+	mFrameStream->bRequestKeyFrame = mbRequestKeyFrame;
+	mbRequestKeyFrame = false;
+	encodeFrameData( frame , mFrameStream->buffer );
 #if DEBUG_SHOW_FRAME_DATA_TRANSITION
 	//LogDevMsg( 0 ,"Send Frame Data : frame = %u" , frame);
 #endif
 	mWorker->sendCommand( UseChannel , mFrameStream.get() , WSF_IGNORE_LOCAL );
 
 	DataStreamBuffer buffer;
-	buffer.copy( mFrameStream->buffer );
+	buffer.copy( mFrameDataBuffer );
 
 	mFrameMgr.addFrameData( mFrameStream->frame , buffer );
 	mUpdateDataBits = 0;
 
+	reportCodecStats();
 	return true;
 }
 
-void SVSyncFrameManager::procFrameData( IComPacket* cp )
+void SVSyncFrameManager::reportCodecStats()
 {
-	if( bClearData )
+	FrameDataCodecStats const& stats = mFrameEncoder.getStats();
+	if( stats.numFrame < CodecStatsReportFrameNum )
 		return;
 
+	size_t numPlayer = std::max< size_t >( mWorker->getPlayerManager()->getPlayerNum() , 1 );
+	LogDevMsg(0, "Frame Data Send : %.1f -> %.1f bytes/frame , %.2f bytes/frame/player ( key = %u , repeat = %u )",
+		stats.getRawBytesPerFrame(), stats.getCodedBytesPerFrame(), stats.getCodedBytesPerFrame() / numPlayer, stats.numKeyFrame, stats.numRepeatFrame);
+	mFrameEncoder.resetStats();
+
+	for( auto& pair : mClientStreams )
+	{
+		FrameDataCodecStats const& clientStats = pair.second.decoder.getStats();
+		if( clientStats.numFrame == 0 )
+			continue;
+
+		LogDevMsg(0, "Frame Data Recv Player %u : %.1f -> %.1f bytes/frame ( key = %u , repeat = %u )",
+			(unsigned)pair.first, clientStats.getRawBytesPerFrame(), clientStats.getCodedBytesPerFrame(), clientStats.numKeyFrame, clientStats.numRepeatFrame);
+		pair.second.decoder.resetStats();
+	}
+}
+
+void SVSyncFrameManager::procFrameData( IComPacket* cp )
+{
 	NetClientData* info = static_cast< NetClientData* >( cp->getUserData() );
 	if ( !info )
 	{
@@ -334,6 +384,29 @@ void SVSyncFrameManager::procFrameData( IComPacket* cp )
 
 	PlayerId id = info->ownerId;
 	GDPFrameStream* fp = cp->cast< GDPFrameStream >();
+
+	//The client stream restarts from a key frame , the broadcast stream is shared by every client
+	if ( fp->bRequestKeyFrame )
+		mFrameEncoder.reset();
+
+	//Decode before any discard , the decoder must follow the whole stream
+	ClientStream& stream = mClientStreams[id];
+	if ( !DecodeFrameData( stream.decoder , fp->buffer ) )
+	{
+		LogWarning(0, "Can't decode frame data : player = %u , frame = %d", (unsigned)id, (int)fp->frame);
+		//Request once , the frames sent before the key frame fail too
+		if ( !stream.bKeyFrameRequested )
+		{
+			stream.bKeyFrameRequested = true;
+			mbRequestKeyFrame = true;
+		}
+		return;
+	}
+	stream.bKeyFrameRequested = false;
+
+	if( bClearData )
+		return;
+
 	ServerPlayer* player = mWorker->getPlayerManager()->getPlayer( id );
 
 #if 1 || DEBUG_SHOW_FRAME_DATA_TRANSITION
@@ -427,6 +500,7 @@ void SVSyncFrameManager::resetFrameData()
 {
 	mFrameDataList.clear();
 	mFrameMgr.clearData();
+	mFrameEncoder.reset();
 	mCountDataDelay = 0;
 }
 
@@ -447,6 +521,7 @@ CLSyncFrameManager::CLSyncFrameManager( NetWorker* worker , IFrameActionTemplate
 
 	mLastSendDataFrame = 0;
 	mLastRecvDataFrame = 0;
+	mbKeyFrameRequested = false;
 }
 
 CLSyncFrameManager::~CLSyncFrameManager()
@@ -461,18 +536,13 @@ bool CLSyncFrameManager::sendFrameData()
 
 	int32 frame = mFrameMgr.getFrame() + 1;
 	mFrameStream->frame = frame;
-	mFrameStream->buffer.clear();
-
-	if ( mFrameCollector->haveFrameData(frame) )
-	{
-		auto dataStream = CreateSerializer(mFrameStream->buffer);
-		mFrameCollector->collectFrameData(dataStream);
-	}
-
+	mFrameStream->bRequestKeyFrame = mbRequestKeyFrame;
+	mbRequestKeyFrame = false;
+	encodeFrameData( frame , mFrameStream->buffer );
 
 #if DEBUG_SHOW_FRAME_DATA_TRANSITION
 	//if( (mFrameStream->frame % 40) == 0 )
-	if ( mFrameStream->buffer.getAvailableSize() )
+	if ( mFrameDataBuffer.getAvailableSize() )
 	{
 		LogDevMsg(0, "Send Frame Data : frame = %d", mFrameStream->frame);
 	}
@@ -487,13 +557,44 @@ bool CLSyncFrameManager::sendFrameData()
 		mLastSendDataFrame = mFrameMgr.getFrame();
 	}
 
+	reportCodecStats();
 	return true;
 }
 
+void CLSyncFrameManager::reportCodecStats()
+{
+	FrameDataCodecStats const& sendStats = mFrameEncoder.getStats();
+	if( sendStats.numFrame < CodecStatsReportFrameNum )
+		return;
+
+	FrameDataCodecStats const& recvStats = mFrameDecoder.getStats();
+	LogDevMsg(0, "Frame Data : send %.1f -> %.1f bytes/frame , recv %.1f -> %.1f bytes/frame",
+		sendStats.getRawBytesPerFrame(), sendStats.getCodedBytesPerFrame(), recvStats.getRawBytesPerFrame(), recvStats.getCodedBytesPerFrame());
+	mFrameEncoder.resetStats();
+	mFrameDecoder.resetStats();
+}
+
 void CLSyncFrameManager::procFrameData( IComPacket* cp)
 {
 	GDPFrameStream* data = cp->cast< GDPFrameStream >();
 
+	if ( data->bRequestKeyFrame )
+		mFrameEncoder.reset();
+
+	//Decode before any discard , the decoder must follow the whole stream
+	if ( !DecodeFrameData( mFrameDecoder , data->buffer ) )
+	{
+		LogWarning(0, "Can't decode frame data : frame = %d", (int)data->frame);
+		//Don't wait the periodic key frame , request once until the stream is decoded again
+		if ( !mbKeyFrameRequested )
+		{
+			mbKeyFrameRequested = true;
+			mbRequestKeyFrame = true;
+		}
+		return;
+	}
+	mbKeyFrameRequested = false;
+
 	if( bClearData )
 		return;
 
@@ -533,6 +634,7 @@ void CLSyncFrameManager::resetFrameData()
 {
 	bClearData = true;
 	mFrameMgr.clearData();
+	mFrameEncoder.reset();
 	mLastSendDataFrame = 0;
 	mLastRecvDataFrame = 0;
 }
@@ -5,10 +5,12 @@
 #include "GameControl.h"
 #include "GamePlayer.h"
 #include "DataStreamBuffer.h"
+#include "FrameDataCodec.h"
 #include "Holder.h"
 
 #include <vector>
 #include <queue>
+#include <map>
 
 class INetFrameHelper;
 class IFrameActionTemplate;
@@ -91,6 +93,10 @@ public:
 
 protected:
 	void collectInputs();  // Trigger collection via own processor (launcher pattern)
+
+	// Frame data is sent coded against the previous frame of the stream
+	void encodeFrameData( int32 frame , DataStreamBuffer& outBuffer );
+	static bool DecodeFrameData( FrameDataDecoder& decoder , DataStreamBuffer& buffer );
 	
 	bool  bClearData;
 
@@ -102,6 +108,11 @@ protected:
 	FrameDataManager      mFrameMgr;
 	IFrameActionTemplate* mActionTemplate;
 	INetFrameCollector*   mFrameCollector;
+
+	DataStreamBuffer      mFrameDataBuffer;
+	FrameDataEncoder      mFrameEncoder;
+	//Sent with the next frame stream after a decode failure , the other end restarts its stream with a key frame
+	bool                  mbRequestKeyFrame = false;
 };
 
 class SVSyncFrameManager : public CSyncFrameManager
@@ -128,6 +139,7 @@ public:
 private:
 	unsigned calcLocalPlayerBit();
 	void     procFrameData( IComPacket* cp);
+	void     reportCodecStats();
 
 	TPtrHolder< GDPFrameStream >   mFrameStream;
 	unsigned         mCountDataDelay;
@@ -156,6 +168,15 @@ private:
 	typedef std::list< ClientFrameData > ClientFrameDataList;
 	ClientFrameDataList mFrameDataList;
 
+	//Client streams are decoded in arrival order , reset only by the key frames of the stream
+	struct ClientStream
+	{
+		FrameDataDecoder decoder;
+		//A key frame is requested , the frames until it can't be decoded
+		bool             bKeyFrameRequested = false;
+	};
+	std::map< PlayerId , ClientStream > mClientStreams;
+
 	ServerWorker*     mWorker;
 };
 
@@ -176,8 +197,11 @@ public:
 	}
 private:
 	void procFrameData( IComPacket* cp);
+	void reportCodecStats();
 
 	TPtrHolder< GDPFrameStream >  mFrameStream;
+	FrameDataDecoder  mFrameDecoder;
+	bool              mbKeyFrameRequested;
 	LatencyCalculator mCalcuator;
 	long              mLastSendDataFrame;
 	long              mLastRecvDataFrame;
@@ -0,0 +1,306 @@
+#include "TinyGamePCH.h"
+#include "FrameDataCodec.h"
+
+#include "Serialize/StreamBuffer.h"
+
+namespace
+{
+	class CodedDataBuffer
+	{
+	public:
+		CodedDataBuffer(TArray< uint8 >& data) :mData(data) {}
+		void fill(uint8 value) { mData.push_back(value); }
+		TArray< uint8 >& mData;
+	};
+
+	typedef TStreamBuffer< ThrowCheckPolicy > CodedDataReadBuffer;
+
+	template< class TWriter >
+	void WriteVarUInt(TWriter& writer, uint32 value, uint32 groupBits)
+	{
+		for(;;)
+		{
+			writer.fill(uint32(value & ( BIT(groupBits) - 1 )), groupBits);
+			value >>= groupBits;
+			writer.fill(uint8(value != 0), 1);
+			if( value == 0 )
+				break;
+		}
+	}
+
+	template< class TReader >
+	uint32 ReadVarUInt(TReader& reader, uint32 groupBits)
+	{
+		uint32 result = 0;
+		for( uint32 offset = 0; ; offset += groupBits )
+		{
+			if( offset >= 32 )
+				throw BufferException("Bad VarUInt");
+
+			uint32 value;
+			reader.take(value, groupBits);
+			result |= value << offset;
+			if( reader.takeBit() == 0 )
+				break;
+		}
+		return result;
+	}
+
+	uint8 GetRefByte(TArray< uint8 > const& refData, uint32 index)
+	{
+		return index < refData.size() ? refData[index] : 0;
+	}
+}
+
+FrameDataCodecBase::FrameDataCodecBase()
+{
+	mbHaveRef = false;
+	mSequence = 0;
+	mNumFrameSinceKey = 0;
+	resetModel();
+}
+
+bool FrameDataCodecBase::isRepeatFrame(void const* data, uint32 size) const
+{
+	return mbHaveRef && size != 0 && mRefData.size() == size && memcmp(mRefData.data(), data, size) == 0;
+}
+
+void FrameDataCodecBase::resetModel()
+{
+	//Deltas are mostly zero runs
+	std::fill_n(mSymbolCounts, NumSymbol, 0);
+	mSymbolCounts[ZeroRunSymbol] = 32;
+	mNumCodedSinceRebuild = RebuildTableInterval;
+	updateModel();
+}
+
+void FrameDataCodecBase::updateModel()
+{
+	++mNumCodedSinceRebuild;
+	if( mNumCodedSinceRebuild < RebuildTableInterval )
+		return;
+
+	mNumCodedSinceRebuild = 0;
+
+	//Keep the total weight small : recent frames dominate and code length stay in the 16 bits code of the tree
+	uint32 const MaxTotalCount = 2048;
+	for(;;)
+	{
+		uint32 totalCount = 0;
+		for( uint32 count : mSymbolCounts )
+			totalCount += count;
+		if( totalCount <= MaxTotalCount )
+			break;
+		for( uint32& count : mSymbolCounts )
+			count >>= 1;
+	}
+
+	//Every symbol needs a code , a delta can hold any byte
+	HuffmanTree::WeightType weights[NumSymbol];
+	for( int i = 0; i < NumSymbol; ++i )
+		weights[i] = 1 + mSymbolCounts[i];
+
+	mTree.buildFromWeights(weights, NumSymbol);
+}
+
+FrameDataEncoder::FrameDataEncoder()
+{
+	mbLastRepeated = false;
+}
+
+void FrameDataEncoder::reset()
+{
+	mbHaveRef = false;
+	mRefData.clear();
+	mCodedData.clear();
+	mbLastRepeated = false;
+}
+
+uint32 FrameDataEncoder::encode(void const* data, uint32 size)
+{
+	mCodedData.clear();
+	mbLastRepeated = false;
+	if( size == 0 )
+	{
+		mStats.add(0, 0);
+		return 0;
+	}
+
+	assert(size <= MaxFrameSize);
+	uint8 const* pData = (uint8 const*)data;
+
+	CodedDataBuffer buffer(mCodedData);
+	auto writer = MakeBitWriter(buffer);
+
+	bool bKeyFrame = !mbHaveRef || mNumFrameSinceKey >= KeyFrameInterval;
+	writer.fill(uint8(bKeyFrame), 1);
+	writer.fill(uint8(mSequence & ( BIT(SequenceBits) - 1 )), SequenceBits);
+	++mSequence;
+
+	if( bKeyFrame )
+	{
+		resetModel();
+		mRefData.clear();
+		mbHaveRef = true;
+		mNumFrameSinceKey = 0;
+		++mStats.numKeyFrame;
+		WriteVarUInt(writer, size, SizeBits);
+	}
+	else
+	{
+		bool bSameSize = mRefData.size() == size;
+		bool bRepeat = isRepeatFrame(pData, size);
+		writer.fill(uint8(bRepeat), 1);
+		if( bRepeat )
+		{
+			writer.finalize();
+			++mNumFrameSinceKey;
+			++mStats.numRepeatFrame;
+			mbLastRepeated = true;
+			mStats.add(size, (uint32)mCodedData.size());
+			return (uint32)mCodedData.size();
+		}
+
+		writer.fill(uint8(bSameSize), 1);
+		if( !bSameSize )
+		{
+			WriteVarUInt(writer, size, SizeBits);
+		}
+	}
+
+	for( uint32 index = 0; index < size; )
+	{
+		uint8 delta = pData[index] ^ GetRefByte(mRefData, index);
+		if( delta == 0 )
+		{
+			uint32 runLength = 1;
+			while( index + runLength < size && pData[index + runLength] == GetRefByte(mRefData, index + runLength) )
+				++runLength;
+
+			HuffmanTree::Node const& node = mTree.alphabetNodes[ZeroRunSymbol];
+			writer.fill(uint32(node.code), node.codeLength);
+			WriteVarUInt(writer, runLength - 1, RunLengthBits);
+			++mSymbolCounts[ZeroRunSymbol];
+			index += runLength;
+		}
+		else
+		{
+			HuffmanTree::Node const& node = mTree.alphabetNodes[delta];
+			writer.fill(uint32(node.code), node.codeLength);
+			++mSymbolCounts[delta];
+			++index;
+		}
+	}
+	writer.finalize();
+
+	mRefData.assign(pData, pData + size);
+	++mNumFrameSinceKey;
+	updateModel();
+
+	mStats.add(size, (uint32)mCodedData.size());
+	return (uint32)mCodedData.size();
+}
+
+FrameDataDecoder::FrameDataDecoder()
+{
+
+}
+
+void FrameDataDecoder::reset()
+{
+	mbHaveRef = false;
+	mRefData.clear();
+	mFrameData.clear();
+}
+
+bool FrameDataDecoder::decode(void const* data, uint32 size)
+{
+	mFrameData.clear();
+	if( size == 0 )
+	{
+		mStats.add(0, 0);
+		return true;
+	}
+
+	CodedDataReadBuffer buffer((char*)data, size);
+	buffer.setFillSize(size);
+	auto reader = MakeBitReader(buffer);
+
+	try
+	{
+		bool bKeyFrame = reader.takeBit() != 0;
+		uint32 sequence;
+		reader.take(sequence, SequenceBits);
+
+		uint32 frameSize;
+		if( bKeyFrame )
+		{
+			resetModel();
+			mRefData.clear();
+			mbHaveRef = true;
+			mNumFrameSinceKey = 0;
+			++mStats.numKeyFrame;
+			frameSize = ReadVarUInt(reader, SizeBits);
+		}
+		else
+		{
+			if( !mbHaveRef || sequence != (mSequence & ( BIT(SequenceBits) - 1 )) )
+			{
+				mbHaveRef = false;
+				return false;
+			}
+
+			if( reader.takeBit() )
+			{
+				mFrameData = mRefData;
+				mSequence = sequence + 1;
+				++mNumFrameSinceKey;
+				++mStats.numRepeatFrame;
+				mStats.add((uint32)mFrameData.size(), size);
+				return true;
+			}
+
+			frameSize = reader.takeBit() ? (uint32)mRefData.size() : ReadVarUInt(reader, SizeBits);
+		}
+
+		if( frameSize == 0 || frameSize > MaxFrameSize )
+			throw BufferException("Bad Frame Size");
+
+		mFrameData.resize(frameSize);
+		for( uint32 index = 0; index < frameSize; )
+		{
+			uint8 symbol = mTree.getNode(reader)->alphabet;
+			if( symbol == ZeroRunSymbol )
+			{
+				uint32 runLength = ReadVarUInt(reader, RunLengthBits) + 1;
+				if( runLength > frameSize - index )
+					throw BufferException("Bad Run Length");
+
+				for( uint32 end = index + runLength; index < end; ++index )
+					mFrameData[index] = GetRefByte(mRefData, index);
+				++mSymbolCounts[ZeroRunSymbol];
+			}
+			else
+			{
+				mFrameData[index] = symbol ^ GetRefByte(mRefData, index);
+				++mSymbolCounts[symbol];
+				++index;
+			}
+		}
+
+		mSequence = sequence + 1;
+	}
+	catch( BufferException& )
+	{
+		mFrameData.clear();
+		mbHaveRef = false;
+		return false;
+	}
+
+	mRefData = mFrameData;
+	++mNumFrameSinceKey;
+	updateModel();
+
+	mStats.add((uint32)mFrameData.size(), size);
+	return true;
+}
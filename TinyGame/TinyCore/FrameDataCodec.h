@@ -0,0 +1,119 @@
+#pragma once
+#ifndef FrameDataCodec_H_7B78D55A_013A_48D6_8688_78AB01EFFF53
+#define FrameDataCodec_H_7B78D55A_013A_48D6_8688_78AB01EFFF53
+
+#include "GameConfig.h"
+#include "Serialize/DataBitSerialize.h"
+#include "CompressAlgo.h"
+#include "DataStructure/Array.h"
+
+// Bit packed frame data stream for lockstep sync and replays.
+//
+// Every frame is coded against the previous frame of the same stream :
+//   - a frame equal to the previous one costs a single repeat token
+//   - otherwise the XOR delta is coded as zero runs and literals with a Huffman table
+//     rebuilt from the symbol statistics of the stream , both ends adapt identically
+//   - key frames reset the reference and the statistics , a decoder can join or resync at them
+// The stream must be delivered in order ( UdpChain , replay file ), a gap is detected by the
+// sequence number and the decoder drops frames until the next key frame.
+// Empty frames stay empty and don't take part in the stream.
+
+struct FrameDataCodecStats
+{
+	uint32 numFrame;
+	uint32 numRepeatFrame;
+	uint32 numKeyFrame;
+	uint64 rawSize;
+	uint64 codedSize;
+
+	FrameDataCodecStats() { reset(); }
+	void  reset()
+	{
+		numFrame = numRepeatFrame = numKeyFrame = 0;
+		rawSize = codedSize = 0;
+	}
+	void  add(uint32 inRawSize, uint32 inCodedSize)
+	{
+		++numFrame;
+		rawSize += inRawSize;
+		codedSize += inCodedSize;
+	}
+	float getRawBytesPerFrame() const { return numFrame ? float(rawSize) / numFrame : 0.0f; }
+	float getCodedBytesPerFrame() const { return numFrame ? float(codedSize) / numFrame : 0.0f; }
+};
+
+class TINY_API FrameDataCodecBase
+{
+public:
+	static int const KeyFrameInterval = 120;
+	static int const RebuildTableInterval = 8;
+	static int const SequenceBits = 4;
+
+	//True when the frame equals the reference of the stream
+	bool  isRepeatFrame(void const* data, uint32 size) const;
+
+	FrameDataCodecStats const& getStats() const { return mStats; }
+	void  resetStats() { mStats.reset(); }
+
+protected:
+	FrameDataCodecBase();
+
+	void  resetModel();
+	void  updateModel();
+
+	static int const NumSymbol = 256;
+	//Symbol 0 starts a zero run , other symbols are literal delta bytes
+	static int const ZeroRunSymbol = 0;
+	static int const RunLengthBits = 3;
+	static int const SizeBits = 5;
+	static uint32 const MaxFrameSize = 64 * 1024;
+
+	typedef THuffmanTree< uint8 > HuffmanTree;
+	HuffmanTree    mTree;
+	uint32         mSymbolCounts[NumSymbol];
+	int            mNumCodedSinceRebuild;
+
+	TArray< uint8 > mRefData;
+	bool           mbHaveRef;
+	uint32         mSequence;
+	int            mNumFrameSinceKey;
+
+	FrameDataCodecStats mStats;
+};
+
+class TINY_API FrameDataEncoder : public FrameDataCodecBase
+{
+public:
+	FrameDataEncoder();
+
+	//Next frame is coded as a key frame
+	void  reset();
+
+	//Return the coded size , the coded data is valid until the next call
+	uint32  encode(void const* data, uint32 size);
+	TArray< uint8 > const& getCodedData() const { return mCodedData; }
+	bool    isLastFrameRepeated() const { return mbLastRepeated; }
+
+private:
+	TArray< uint8 > mCodedData;
+	bool           mbLastRepeated;
+};
+
+class TINY_API FrameDataDecoder : public FrameDataCodecBase
+{
+public:
+	FrameDataDecoder();
+
+	//Drop the reference , wait for a key frame
+	void  reset();
+
+	//Return false when the frame can't be decoded ( corrupted , or out of sync until the next key frame )
+	bool  decode(void const* data, uint32 size);
+	TArray< uint8 > const& getFrameData() const { return mFrameData; }
+	bool  isSynced() const { return mbHaveRef; }
+
+private:
+	TArray< uint8 > mFrameData;
+};
+
+#endif // FrameDataCodec_H_7B78D55A_013A_48D6_8688_78AB01EFFF53
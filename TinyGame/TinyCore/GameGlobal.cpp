@@ -12,6 +12,7 @@
 #include "Asset.h"
 
 #include "PacketFactory.h"
+#include "Serialize/DataStream.h"
 
 
 #include <cstdlib>
@@ -87,6 +88,16 @@ void Global::RandSeedNet( uint64 seed )
 	GRandCount = 0;
 }
 
+void Global::SaveRandNetState( IStreamSerializer& serializer )
+{
+	serializer << GWellRng.index << GWellRng.state << GRandCount;
+}
+
+void Global::LoadRandNetState( IStreamSerializer& serializer )
+{
+	serializer >> GWellRng.index >> GWellRng.state >> GRandCount;
+}
+
 int Global::Random()
 {
 	++GRandCount;
@@ -44,6 +44,7 @@ class NetWorker;
 class DataCacheInterface;
 
 class IEditor;
+class IStreamSerializer;
 
 TINY_API uint64 GenerateRandSeed();
 
@@ -76,6 +77,9 @@ public:
 
 	static TINY_API int  RandomNet();
 	static TINY_API void RandSeedNet( uint64 seed );
+	//RandomNet is part of the game state , frame state handlers save it with the game
+	static TINY_API void SaveRandNetState( IStreamSerializer& serializer );
+	static TINY_API void LoadRandNetState( IStreamSerializer& serializer );
 	static TINY_API int  Random();
 	static TINY_API void RandSeed(unsigned seed );
 
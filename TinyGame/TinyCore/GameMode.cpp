@@ -122,8 +122,17 @@ bool GameLevelMode::buildReplayRecorder(GameStageBase* stage)
 	if( IFrameActionTemplate* actionTemplate = stage->createActionTemplate(LAST_VERSION) )
 	{
 		actionTemplate->setupPlayer(*playerManager);
-		mReplayRecorder.reset(
-			new ReplayRecorder(actionTemplate, mReplayFrame));
+		if( IFrameStateHandler* stateHandler = stage->getFrameStateHandler() )
+		{
+			//The stream is written while playing , save copies it
+			mReplayRecorder.reset(
+				new StreamReplayRecorder(actionTemplate, mReplayFrame, stateHandler, REPLAY_DIR "/~Recording" REPLAY_SUB_FILE_NAME));
+		}
+		else
+		{
+			mReplayRecorder.reset(
+				new ReplayRecorder(actionTemplate, mReplayFrame));
+		}
 
 		GameAttribute dataValue(ATTR_REPLAY_INFO_DATA, &mReplayRecorder->getReplay().getInfo());
 		if( !stage->queryAttribute(dataValue) )
@@ -182,10 +182,7 @@ void TcpClient::connect( char const* addrName , unsigned port )
 
 void TcpClient::clearBuffer()
 {
-	{
-		TLockedObject< SocketBuffer > buffer = getSendCtrl().lockBuffer();
-		buffer->clear();
-	}
+	getSendCtrl().clear();
 	{
 		TLockedObject< SocketBuffer > buffer = getRecvCtrl().lockBuffer();
 		buffer->clear();
@@ -250,10 +247,37 @@ void NetBufferOperator::fillBuffer( SocketBuffer& buffer , unsigned num )
 	}
 }
 
+void NetBufferOperator::fillData( void const* data , size_t num )
+{
+	NET_MUTEX_LOCK( mMutexBuffer );
+
+	if ( mBuffer.getFreeSize() < num )
+	{
+		mBuffer.grow( std::max( ( mBuffer.getMaxSize() * 3 ) / 2 , mBuffer.getFillSize() + num ) );
+	}
+	mBuffer.fill( data , num );
+}
+
+void NetBufferOperator::appendShared( NetPacketSlice const& slice )
+{
+	NET_MUTEX_LOCK( mMutexBuffer );
+
+	SharedData data;
+	data.slice = slice;
+	data.bufferPos = mBuffer.getFillSize();
+	mSharedDataList.push_back( data );
+}
+
 bool NetBufferOperator::sendData( NetSocket& socket , NetAddress* addr )
 {
 	NET_MUTEX_LOCK( mMutexBuffer );
 
+	if ( !mSharedDataList.empty() )
+	{
+		assert( addr == NULL );
+		return sendSharedData( socket );
+	}
+
 	int count = 0;
 
 	while ( mBuffer.getAvailableSize() )
@@ -291,6 +315,94 @@ bool NetBufferOperator::sendData( NetSocket& socket , NetAddress* addr )
 	return true;
 }
 
+bool NetBufferOperator::sendSharedData( NetSocket& socket )
+{
+	int const MaxSendBufferNum = 64;
+	NetSendBuffer sendBuffers[ MaxSendBufferNum ];
+
+	for(;;)
+	{
+		//Interleave the own bytes and the shared slices in queue order
+		int    numBuffer = 0;
+		size_t sendSize  = 0;
+		size_t bufferPos = mBuffer.getUseSize();
+		uint32 sharedOffset = mSharedSendOffset;
+		int    index = mIndexSendShared;
+		for( ; index < (int)mSharedDataList.size() && numBuffer + 2 <= MaxSendBufferNum ; ++index )
+		{
+			SharedData const& data = mSharedDataList[ index ];
+			if ( data.bufferPos > bufferPos )
+			{
+				sendBuffers[ numBuffer++ ] = { mBuffer.getData() + bufferPos , data.bufferPos - bufferPos };
+				sendSize += data.bufferPos - bufferPos;
+				bufferPos = data.bufferPos;
+			}
+			sendBuffers[ numBuffer++ ] = { data.slice.getData() + sharedOffset , data.slice.size - sharedOffset };
+			sendSize += data.slice.size - sharedOffset;
+			sharedOffset = 0;
+		}
+		if ( index == (int)mSharedDataList.size() && mBuffer.getFillSize() > bufferPos )
+		{
+			sendBuffers[ numBuffer++ ] = { mBuffer.getData() + bufferPos , mBuffer.getFillSize() - bufferPos };
+			sendSize += mBuffer.getFillSize() - bufferPos;
+		}
+
+		int numSend = socket.sendData( sendBuffers , numBuffer );
+		if ( numSend == SOCKET_ERROR || numSend == 0 )
+			return false;
+
+		consumeSendData( numSend );
+
+		if ( mIndexSendShared == (int)mSharedDataList.size() && mBuffer.getAvailableSize() == 0 )
+		{
+			mSharedDataList.clear();
+			mIndexSendShared = 0;
+			mSharedSendOffset = 0;
+			mBuffer.clear();
+			return true;
+		}
+
+		//Socket buffer is full
+		if ( size_t( numSend ) < sendSize )
+			return false;
+	}
+}
+
+void NetBufferOperator::consumeSendData( size_t num )
+{
+	while( num )
+	{
+		if ( mIndexSendShared < (int)mSharedDataList.size() )
+		{
+			SharedData& data = mSharedDataList[ mIndexSendShared ];
+			if ( mBuffer.getUseSize() < data.bufferPos )
+			{
+				size_t size = std::min( num , data.bufferPos - mBuffer.getUseSize() );
+				mBuffer.shiftUseSize( (int)size );
+				num -= size;
+				continue;
+			}
+
+			size_t size = std::min< size_t >( num , data.slice.size - mSharedSendOffset );
+			mSharedSendOffset += (uint32)size;
+			num -= size;
+			if ( mSharedSendOffset == data.slice.size )
+			{
+				//Give the buffer back to the pool as soon as possible
+				data.slice.buffer.release();
+				mSharedSendOffset = 0;
+				++mIndexSendShared;
+			}
+		}
+		else
+		{
+			assert( num <= mBuffer.getAvailableSize() );
+			mBuffer.shiftUseSize( (int)num );
+			num = 0;
+		}
+	}
+}
+
 bool NetBufferOperator::recvData(NetSocket& socket, int len, NetAddress* addr /*= NULL */)
 {
 	NET_MUTEX_LOCK(mMutexBuffer);
@@ -331,6 +443,9 @@ void NetBufferOperator::clear()
 {
 	NET_MUTEX_LOCK( mMutexBuffer )
 	mBuffer.clear();
+	mSharedDataList.clear();
+	mIndexSendShared = 0;
+	mSharedSendOffset = 0;
 }
 
 UdpChain::UdpChain() 
@@ -376,7 +491,7 @@ int checkBuffer( char const* buf , int num )
 	return num;
 }
 
-bool UdpChain::sendPacket( long time , NetSocket& socket , SocketBuffer& buffer , NetAddress* addr  )
+bool UdpChain::preparePacket( long time , SocketBuffer& buffer )
 {
 
 	bool bNeedSendRelData = mBufferRel.getFillSize() && ( time - mTimeLastUpdate > mTimeResendRel );
@@ -427,36 +542,6 @@ bool UdpChain::sendPacket( long time , NetSocket& socket , SocketBuffer& buffer
 			mBufferCache.fill( mIncomingAck );
 			mBufferCache.fill( 0 );
 		}
-
-		int count = 0;
-		while( mBufferCache.getAvailableSize() )
-		{
-			int numSend;
-			if (addr)
-			{
-				numSend = mBufferCache.take(socket, *addr);
-			}
-			else
-			{
-				numSend = mBufferCache.take(socket);
-			}
-
-			if( numSend )
-			{
-				//LogDevMsg(0, "Send UDP Data : size = %d", numSend);
-			}
-			else
-			{
-				LogDevMsg(0, "Can't send UDP Data");
-			}
-
-			++count;
-			if ( count == 10 )
-			{
-				return false;
-			}
-		}
-		mTimeLastUpdate = time;
 	}
 	catch ( BufferException& )
 	{
@@ -464,6 +549,44 @@ bool UdpChain::sendPacket( long time , NetSocket& socket , SocketBuffer& buffer
 		return false;
 	}
 
+	return true;
+}
+
+bool UdpChain::sendPacket( long time , NetSocket& socket , SocketBuffer& buffer , NetAddress* addr  )
+{
+	if ( !preparePacket( time , buffer ) )
+		return false;
+
+	int count = 0;
+	while( mBufferCache.getAvailableSize() )
+	{
+		int numSend;
+		if (addr)
+		{
+			numSend = mBufferCache.take(socket, *addr);
+		}
+		else
+		{
+			numSend = mBufferCache.take(socket);
+		}
+
+		if( numSend )
+		{
+			//LogDevMsg(0, "Send UDP Data : size = %d", numSend);
+		}
+		else
+		{
+			LogDevMsg(0, "Can't send UDP Data");
+		}
+
+		++count;
+		if ( count == 10 )
+		{
+			return false;
+		}
+	}
+	mTimeLastUpdate = time;
+
 	//LogMsg( "sendPacket %u %u %u" , outgoing , incoming , bufSize );
 	return true;
 
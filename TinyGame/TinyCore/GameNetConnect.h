@@ -4,6 +4,7 @@
 #include "PlatformThread.h"
 #include "NetSocket.h"
 #include "SocketBuffer.h"
+#include "NetPacketBuffer.h"
 #include "Core/IntegerType.h"
 #include "SystemPlatform.h"
 
@@ -79,12 +80,28 @@ public:
 #endif
 	}
 	void     fillBuffer( SocketBuffer& buffer , unsigned num );
+	void     fillData( void const* data , size_t num );
+	//Queue shared data after the bytes already in the buffer , it is sent without copy (TCP only)
+	void     appendShared( NetPacketSlice const& slice );
 
 	bool     sendData( NetSocket& socket , NetAddress* addr = NULL );
 	bool     recvData( NetSocket& socket , int len , NetAddress* addr = NULL );
 private:
 
+	bool     sendSharedData( NetSocket& socket );
+	void     consumeSendData( size_t num );
+
+	struct SharedData
+	{
+		NetPacketSlice slice;
+		//Fill size of mBuffer when the slice was queued , the bytes before it are sent first
+		size_t         bufferPos;
+	};
+
 	SocketBuffer   mBuffer;
+	TArray< SharedData > mSharedDataList;
+	int            mIndexSendShared = 0;
+	uint32         mSharedSendOffset = 0;
 	NET_MUTEX( mMutexBuffer )
 };
 
@@ -134,6 +151,11 @@ public:
 	bool sendPacket( long time , NetSocket& socket , SocketBuffer& buffer , NetAddress* csaddr );
 	bool readPacket( SocketBuffer& buffer , uint32& readSize );
 
+	//Split of sendPacket for batch send : build the datagram , send getPacketData() , then markPacketSent
+	bool preparePacket( long time , SocketBuffer& buffer );
+	SocketBuffer const& getPacketData() const { return mBufferCache; }
+	void markPacketSent( long time ){ mTimeLastUpdate = time; }
+
 
 	UdpChain( UdpChain const& ) = delete;
 	UdpChain& operator = ( UdpChain const& ) = delete;
@@ -298,6 +320,12 @@ public:
 			TLockedObject< SocketBuffer > buffer = mSendCtrl.lockBuffer();
 			return mChain.sendPacket(time, socket, *buffer, &addr);
 		}
+
+		bool prepareSendData(long time)
+		{
+			TLockedObject< SocketBuffer > buffer = mSendCtrl.lockBuffer();
+			return mChain.preparePacket(time, *buffer);
+		}
 		operator UdpChain&(){ return mChain; } 
 
 		void clearBuffer()
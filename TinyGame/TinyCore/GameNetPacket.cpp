@@ -8,6 +8,7 @@
 
 // Game Data Protocol - Frame Stream Packets
 REGISTER_GAME_PACKET(GDPFrameStream)
+REGISTER_GAME_PACKET(GDPFrameInput)
 
 // Game Data Protocol - Stream Packets
 REGISTER_GAME_PACKET(GDPStream)
@@ -58,6 +58,7 @@ enum NetPacketID
 	GDP_START_ID = 400 ,
 	GDP_FARME_STREAM ,
 	GDP_STREAM  ,
+	GDP_FRAME_INPUT ,
 	GDP_NEXT_ID ,
 
 	////
@@ -228,12 +229,28 @@ public:
 class GDPFrameStream : public GameFramePacketT< GDPFrameStream , GDP_FARME_STREAM >
 {
 public:
+	//The receiver can't decode the stream of the other end , the next sent frame is a key frame
+	uint8            bRequestKeyFrame = 0;
 	DataStreamBuffer buffer;
 
 	template < class BufferOP >
 	void  operateBuffer( BufferOP& op )
 	{
-		op  & buffer;
+		op  & bRequestKeyFrame & buffer;
+	}
+};
+
+//Input of a rollback slot , sent on every frame
+class GDPFrameInput : public GameFramePacketT< GDPFrameInput , GDP_FRAME_INPUT >
+{
+public:
+	uint8            slot;
+	DataStreamBuffer buffer;
+
+	template < class BufferOP >
+	void  operateBuffer( BufferOP& op )
+	{
+		op & slot & buffer;
 	}
 };
 
@@ -4,6 +4,8 @@
 #include "GameAction.h"
 
 #include "Serialize/FileStream.h"
+#include "Serialize/StreamBuffer.h"
+#include "FileSystem.h"
 
 struct ReplayInfoV0_0_1
 {
@@ -55,8 +57,37 @@ void ReplayHeader::clear( uint32 version )
 	dataOffset = 0;
 }
 
+static bool LoadStreamReplayInfo( ReplayStreamReader& reader , ReplayHeader& header , ReplayInfo& info )
+{
+	header.clear( reader.getHeader().version );
+	header.version = reader.getHeader().version;
+	header.seed = reader.getHeader().seed;
+	header.totalFrame = reader.getTotalFrame();
+	header.totalSize = (uint32)reader.getFileSize();
+
+	TStreamBuffer< ThrowCheckPolicy > buffer( (char*)reader.getInfoData() , reader.getInfoSize() );
+	buffer.setFillSize( reader.getInfoSize() );
+	try
+	{
+		auto serializer = CreateSerializer( buffer );
+		IStreamSerializer::ReadOp op( serializer );
+		op & info;
+	}
+	catch( BufferException& )
+	{
+		return false;
+	}
+	return true;
+}
+
 bool ReplayBase::LoadReplayInfo( char const* path , ReplayHeader& header , ReplayInfo& info )
 {
+	{
+		ReplayStreamReader reader;
+		if( reader.open( path ) )
+			return LoadStreamReplayInfo( reader , header , info );
+	}
+
 	InputFileSerializer fs;
 	if( !fs.open(path) )
 		return false;
@@ -94,12 +125,35 @@ bool ReplayTemplate::getReplayInfo( ReplayInfo& info )
 	return false;
 }
 
+struct FrameNodeV0_1_0
+{
+	int32  frame;
+	uint32 pos;
+};
+
 template< class T >
 void Replay::serialize( T& op )
 {
 	op & mHeader;
 	op & mInfo;
-	op & mFrameNodeVec;
+	if( T::IsLoading && mHeader.version < CodedDataVersion )
+	{
+		TArray< FrameNodeV0_1_0 > oldNodes;
+		op & oldNodes;
+
+		mFrameNodeVec.resize(oldNodes.size());
+		for( size_t i = 0; i < oldNodes.size(); ++i )
+		{
+			mFrameNodeVec[i].frame  = oldNodes[i].frame;
+			mFrameNodeVec[i].pos    = oldNodes[i].pos;
+			mFrameNodeVec[i].repeat = 0;
+		}
+		mbCodedData = false;
+	}
+	else
+	{
+		op & mFrameNodeVec;
+	}
 	op & mData;
 }
 
@@ -129,19 +183,50 @@ bool Replay::load( char const* path )
 
 void Replay::recordFrame( long frame , IFrameActionTemplate* actionTemp)
 {
-	if ( actionTemp->haveFrameData(frame) )
+	if ( !actionTemp->haveFrameData(frame) )
+		return;
+
+	mRecordData.clear();
+	actionTemp->collectFrameData(*this);
+	if( mRecordData.empty() )
+		return;
+
+	//Consecutive equal frames extend the run of the last node
+	if( !mFrameNodeVec.empty() )
 	{
-		size_t oldPos = mData.size();
-		actionTemp->collectFrameData(*this);
-		if( oldPos != mData.size() )
+		FrameNode& lastNode = mFrameNodeVec.back();
+		if( long( lastNode.frame ) + long( lastNode.repeat ) + 1 == frame &&
+			mEncoder.isRepeatFrame( mRecordData.data() , (uint32)mRecordData.size() ) )
 		{
-			FrameNode node;
-			node.frame = frame;
-			node.pos = (uint32)oldPos;
-
-			mFrameNodeVec.push_back(node);
+			++lastNode.repeat;
+			return;
 		}
 	}
+
+	uint32 codedSize = mEncoder.encode( mRecordData.data() , (uint32)mRecordData.size() );
+
+	FrameNode node;
+	node.frame = frame;
+	node.pos = (uint32)mData.size();
+	node.repeat = 0;
+	mFrameNodeVec.push_back(node);
+
+	char const* pCodedData = (char const*)mEncoder.getCodedData().data();
+	mData.insert( mData.end() , pCodedData , pCodedData + codedSize );
+}
+
+bool Replay::decodeNode( size_t index )
+{
+	//Nodes are coded against each other and must be decoded in order
+	assert( index == mNumDecodedNode );
+	++mNumDecodedNode;
+
+	uint32 pos = mFrameNodeVec[index].pos;
+	uint32 endPos = ( index + 1 < mFrameNodeVec.size() ) ? mFrameNodeVec[index + 1].pos : (uint32)mData.size();
+	if ( pos > endPos || endPos > mData.size() )
+		return false;
+
+	return mDecoder.decode( mData.data() + pos , endPos - pos );
 }
 
 bool Replay::advanceFrame( long frame )
@@ -153,10 +238,24 @@ bool Replay::advanceFrame( long frame )
 		if( node.frame > frame )
 			break;
 
-		if ( node.frame == frame )
+		bool bDecodeOk = true;
+		if( mbCodedData && mNumDecodedNode == mNextNodePos )
 		{
-			++mNextNodePos;
-			mLoadPos = node.pos;
+			bDecodeOk = decodeNode( mNextNodePos );
+		}
+
+		if ( frame <= node.frame + (long)node.repeat )
+		{
+			if ( frame == node.frame + (long)node.repeat )
+				++mNextNodePos;
+
+			if ( !bDecodeOk )
+			{
+				LogWarning( 0, "Replay Error : can't decode frame %ld", frame );
+				return false;
+			}
+
+			mLoadPos = mbCodedData ? 0 : node.pos;
 			return true;
 		}
 		else
@@ -171,16 +270,26 @@ bool Replay::advanceFrame( long frame )
 
 void Replay::read( void* ptr , size_t num )
 {
-	if ( mLoadPos + num > mData.size() )
-		return;
-	memcpy( ptr , &mData[ mLoadPos ], num );
+	if ( mbCodedData )
+	{
+		auto const& frameData = mDecoder.getFrameData();
+		if ( mLoadPos + num > frameData.size() )
+			return;
+		memcpy( ptr , &frameData[ mLoadPos ], num );
+	}
+	else
+	{
+		if ( mLoadPos + num > mData.size() )
+			return;
+		memcpy( ptr , &mData[ mLoadPos ], num );
+	}
 	mLoadPos += num;
 }
 
 void Replay::write( void const* ptr , size_t num )
 {
 	char const* pData = ( char const* ) ptr ;
-	mData.insert( mData.end() , pData , pData + num );
+	mRecordData.insert( mRecordData.end() , pData , pData + num );
 }
 
 void Replay::clear()
@@ -188,6 +297,10 @@ void Replay::clear()
 	mData.clear();
 	mFrameNodeVec.clear();
 	mHeader.clear( LastVersion );
+	mbCodedData = true;
+	mEncoder.reset();
+	mEncoder.resetStats();
+	resetTrackPos();
 }
 
 void Replay::setupHeader()
@@ -208,6 +321,8 @@ void Replay::resetTrackPos()
 {
 	mLoadPos = 0;
 	mNextNodePos = 0;
+	mNumDecodedNode = 0;
+	mDecoder.reset();
 }
 
 bool Replay::isValid() const
@@ -237,6 +352,10 @@ void ReplayRecorder::start( uint64 seed )
 void ReplayRecorder::stop()
 {
 	mReplay.getHeader().totalFrame = mGameFrame;
+
+	FrameDataCodecStats const& stats = mReplay.getRecordStats();
+	LogDevMsg(0, "Replay Frame Data : %u nodes , %.1f -> %.1f bytes/node ( key = %u , repeat = %u )", stats.numFrame,
+		stats.getRawBytesPerFrame(), stats.getCodedBytesPerFrame(), stats.numKeyFrame, stats.numRepeatFrame);
 }
 
 bool ReplayRecorder::save( char const* path )
@@ -335,6 +454,187 @@ void ReplayInput::restart()
 	mPrevFrame = -1;
 }
 
+StreamReplayRecorder::StreamReplayRecorder( IFrameActionTemplate* actionTemp , long& gameFrame , IFrameStateHandler* stateHandler , char const* recordPath )
+	:mTemplate( actionTemp )
+	,mStateHandler( stateHandler )
+	,mRecordPath( recordPath )
+	,mGameFrame( gameFrame )
+{
+
+}
+
+StreamReplayRecorder::~StreamReplayRecorder()
+{
+
+}
+
+void StreamReplayRecorder::serializeInfo( TArray< uint8 >& outData )
+{
+	outData.clear();
+	auto serializer = CreateBufferSerializer< ArrayWriteBuffer >( outData );
+	IStreamSerializer::WriteOp op( serializer );
+	op & mReplay.getInfo();
+}
+
+void StreamReplayRecorder::start( uint64 seed )
+{
+	if( mWriter.isOpen() )
+		mWriter.close( mGameFrame );
+
+	mReplay.getHeader().clear( ReplayStreamWriter::Version );
+	mReplay.getHeader().version = ReplayStreamWriter::Version;
+	mReplay.getHeader().seed = seed;
+	mPrevFrame = -1;
+
+	serializeInfo( mRecordData );
+	if( !mWriter.open( mRecordPath.c_str() , seed , mRecordData.data() , (uint32)mRecordData.size() ) )
+	{
+		LogWarning( 0 , "Can't open replay stream %s" , mRecordPath.c_str() );
+	}
+}
+
+void StreamReplayRecorder::stop()
+{
+	mReplay.getHeader().totalFrame = mGameFrame;
+	if( !mWriter.isOpen() )
+		return;
+
+	mWriter.flush();
+
+	FrameDataCodecStats const& stats = mWriter.getRecordStats();
+	LogDevMsg(0, "Replay Stream : %u nodes , %.1f -> %.1f bytes/node ( key = %u , repeat = %u ) , file = %u bytes", stats.numFrame,
+		stats.getRawBytesPerFrame(), stats.getCodedBytesPerFrame(), stats.numKeyFrame, stats.numRepeatFrame, (unsigned)mWriter.getFileSize());
+}
+
+bool StreamReplayRecorder::save( char const* path )
+{
+	if( mWriter.isOpen() )
+	{
+		//The info can change until the game is over , the header keeps the info at the start
+		serializeInfo( mRecordData );
+		if( !mWriter.close( mReplay.getHeader().totalFrame , mRecordData.data() , (uint32)mRecordData.size() ) )
+			return false;
+	}
+
+	if( mRecordPath == path )
+		return true;
+	return FFileSystem::CopyFile( mRecordPath.c_str() , path );
+}
+
+void StreamReplayRecorder::onScanActionStart( bool bUpdateFrame )
+{
+	mbUpdateFrame = bUpdateFrame;
+	//The first frame is a key frame too , seeking never needs to restart the game
+	if( bUpdateFrame && mStateHandler && mWriter.isOpen() && ( mPrevFrame == -1 || mWriter.needKeyFrame( mGameFrame ) ) )
+	{
+		mWriter.writeState( mGameFrame , *mStateHandler );
+		mWriter.flush();
+	}
+	mTemplate->prevListenAction();
+}
+
+void StreamReplayRecorder::onFireAction( ActionParam& param )
+{
+	assert(mbUpdateFrame);
+	mTemplate->listenAction( param );
+}
+
+void StreamReplayRecorder::onScanActionEnd()
+{
+	if( !mbUpdateFrame )
+		return;
+
+	if( mPrevFrame != -1 )
+	{
+		assert(mGameFrame - mPrevFrame == 1);
+	}
+	mPrevFrame = mGameFrame;
+
+	if( !mWriter.isOpen() || !mTemplate->haveFrameData( mGameFrame ) )
+		return;
+
+	mRecordData.clear();
+	auto serializer = CreateBufferSerializer< ArrayWriteBuffer >( mRecordData );
+	mTemplate->collectFrameData( serializer );
+	mWriter.recordFrame( mGameFrame , mRecordData.data() , (uint32)mRecordData.size() );
+}
+
+StreamReplayInput::StreamReplayInput( IFrameActionTemplate* actionTemp , long& gameFrame )
+	:mTemplate( actionTemp )
+	,mGameFrame( gameFrame )
+{
+
+}
+
+StreamReplayInput::~StreamReplayInput()
+{
+
+}
+
+bool StreamReplayInput::load( char const* path )
+{
+	if( !mReader.open( path ) )
+		return false;
+
+	if( !LoadStreamReplayInfo( mReader , mReplay.getHeader() , mReplay.getInfo() ) )
+	{
+		mReader.close();
+		return false;
+	}
+	mPrevFrame = -1;
+	return true;
+}
+
+bool StreamReplayInput::scanInput( bool beUpdateFrame )
+{
+	if( !beUpdateFrame )
+		return false;
+
+	if( mPrevFrame != -1 )
+	{
+		assert(mGameFrame - mPrevFrame == 1);
+	}
+	mPrevFrame = mGameFrame;
+
+	bool bHaveData = mReader.advanceFrame( mGameFrame );
+	mTemplate->restoreFrameData( mReader , bHaveData );
+	return bHaveData;
+}
+
+bool StreamReplayInput::checkAction( ActionParam& param )
+{
+	return mTemplate->checkAction( param );
+}
+
+long StreamReplayInput::seekFrame( long frame , IFrameStateHandler& handler )
+{
+	mPrevFrame = -1;
+
+	int32 keyFrame = mReader.findKeyFrame( frame );
+	if( keyFrame != INDEX_NONE && !mReader.loadKeyFrame( keyFrame , handler ) )
+		keyFrame = INDEX_NONE;
+
+	mReader.seekFrame( keyFrame == INDEX_NONE ? 0 : keyFrame );
+	return keyFrame;
+}
+
+bool StreamReplayInput::isPlayEnd()
+{
+	long totalFrame = mReplay.getHeader().totalFrame;
+	return totalFrame < mGameFrame;
+}
+
+bool StreamReplayInput::isValid()
+{
+	return mReader.isOpen();
+}
+
+void StreamReplayInput::restart()
+{
+	mReader.seekFrame( 0 );
+	mPrevFrame = -1;
+}
+
 
 namespace OldVersion
 {
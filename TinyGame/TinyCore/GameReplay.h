@@ -3,6 +3,8 @@
 
 #include "GameGlobal.h"
 #include "GameControl.h"
+#include "FrameDataCodec.h"
+#include "ReplayStream.h"
 
 #include "Serialize/DataStream.h"
 #include "InlineString.h"
@@ -16,6 +18,7 @@
 
 
 class IFrameActionTemplate;
+class IFrameStateHandler;
 
 struct ReplayInfo
 {
@@ -118,7 +121,9 @@ class  Replay : public ReplayBase
 	          , public IStreamSerializer
 {
 public:
-	static uint32 const LastVersion = MAKE_VERSION(0,1,0);
+	static uint32 const LastVersion = MAKE_VERSION(0,2,0);
+	//Versions before keep the raw frame data
+	static uint32 const CodedDataVersion = MAKE_VERSION(0,2,0);
 
 	bool save( char const* path );
 	bool load( char const* path );
@@ -133,21 +138,33 @@ public:
 	void resetTrackPos();
 	bool isValid() const;
 
+	FrameDataCodecStats const& getRecordStats() const { return mEncoder.getStats(); }
+
 protected:
 
 	template< class OP >
 	void serialize( OP& op );
 
 	void setupHeader();
+	bool decodeNode( size_t index );
+
+	//Frames [ frame , frame + repeat ] share the node data
 	struct FrameNode
 	{
 		int32  frame;
 		uint32 pos;
+		uint32 repeat;
 	};
 	TArray< FrameNode > mFrameNodeVec;
 	TArray< char >      mData;
 	size_t      mNextNodePos;
 	size_t      mLoadPos;
+
+	bool        mbCodedData;
+	TArray< char >   mRecordData;
+	FrameDataEncoder mEncoder;
+	FrameDataDecoder mDecoder;
+	size_t      mNumDecodedNode;
 };
 
 class  ReplayRecorder : public IReplayRecorder
@@ -196,6 +213,67 @@ protected:
 	long   mPrevFrame = -1;
 };
 
+//Appends the replay to a seekable stream file while recording , see ReplayStream.h
+class  StreamReplayRecorder : public IReplayRecorder
+{
+public:
+	TINY_API StreamReplayRecorder( IFrameActionTemplate* actionTemp , long& gameFrame , IFrameStateHandler* stateHandler , char const* recordPath );
+	TINY_API ~StreamReplayRecorder();
+
+	virtual void start( uint64 seed );
+	virtual void stop();
+	virtual bool save( char const* path );
+	virtual ReplayBase& getReplay(){ return mReplay;  }
+
+	ReplayStreamWriter& getWriter(){ return mWriter; }
+
+protected:
+
+	void onScanActionStart( bool bUpdateFrame );
+	void onFireAction( ActionParam& param );
+	void onScanActionEnd();
+
+	void serializeInfo( TArray< uint8 >& outData );
+
+	IFrameActionTemplate* mTemplate;
+	IFrameStateHandler*   mStateHandler;
+	ReplayBase  mReplay;
+	ReplayStreamWriter mWriter;
+	std::string mRecordPath;
+	TArray< uint8 > mRecordData;
+	long&       mGameFrame;
+	long        mPrevFrame = -1;
+	bool        mbUpdateFrame;
+};
+
+class  StreamReplayInput : public IReplayInput
+{
+public:
+	TINY_API StreamReplayInput( IFrameActionTemplate* actionTemp , long& gameFrame );
+	TINY_API ~StreamReplayInput();
+
+	void    restart();
+	bool    isValid();
+	bool    isPlayEnd();
+	bool    load( char const* path );
+	bool    scanInput( bool beUpdateFrame );
+	bool    checkAction( ActionParam& param );
+	ReplayBase& getReplay(){ return mReplay;  }
+
+	//Load the closest key frame before the frame , the next scanned frame is the key frame.
+	//Return the key frame or INDEX_NONE when the game must restart from the seed ( input is reset to frame 0 ).
+	TINY_API long seekFrame( long frame , IFrameStateHandler& handler );
+
+	ReplayStreamReader& getReader(){ return mReader; }
+
+protected:
+	IFrameActionTemplate* mTemplate;
+	ReplayBase mReplay;
+	ReplayStreamReader mReader;
+	long&  mGameFrame;
+	long   mPrevFrame = -1;
+};
+
 
 class ReplayTemplate;
 
@@ -56,8 +56,10 @@ bool ServerWorker::doStartNetwork()
 	{
 		mTcpServer.run( TG_TCP_PORT );
 		mUdpServer.run( TG_UDP_PORT );
-		mNetSelect.addSocket(mTcpServer.getSocket());
-		mNetSelect.addSocket(mUdpServer.getSocket());
+		if ( !mNetEventLoop.initialize() )
+			return false;
+		mNetEventLoop.addSocket(mTcpServer.getSocket(), mTcpServer);
+		mNetEventLoop.addSocket(mUdpServer.getSocket(), mUdpServer);
 	}
 	catch ( ... )
 	{
@@ -104,6 +106,7 @@ void ServerWorker::doCloseNetwork()
 
 void ServerWorker::clenupNetResource()
 {
+	mNetEventLoop.cleanup();
 	mClientManager.cleanup();
 	mTcpServer.close();
 	mUdpServer.close();
@@ -219,12 +222,10 @@ bool ServerWorker::update_NetThread( long time )
 	if( mLocalWorker )
 		mLocalWorker->update_NetThread(time);
 
-	if ( mNetSelect.select(0))
-	{
-		mTcpServer.updateSocket(time, mNetSelect);
-		mUdpServer.updateSocket(time, mNetSelect);
-		mClientManager.updateSocket(time, mNetSelect);
-	}
+	mClientManager.updateNetTime(time);
+	mNetEventLoop.dispatch(0);
+	//Clients removed in the socket callbacks are released after the dispatch
+	mClientManager.processRemoveList();
 
 	return true;
 }
@@ -255,6 +256,8 @@ void ServerWorker::notifyConnectionAccpet( NetConnection* con )
 	if( client )
 	{
 		client->reconnect(conSocket);
+		//The channel socket got a new handle
+		mNetEventLoop.addSocket(client->tcpChannel.getSocket(), client->tcpChannel);
 		if( client->ownerId != ERROR_PLAYER_ID )
 		{
 			if( mEventResolver )
@@ -272,7 +275,7 @@ void ServerWorker::notifyConnectionAccpet( NetConnection* con )
 		if( client )
 		{
 			client->tcpChannel.setListener(this);
-			mNetSelect.addSocket(client->tcpChannel.getSocket());
+			mNetEventLoop.addSocket(client->tcpChannel.getSocket(), client->tcpChannel);
 			SPConnectMsg com;
 			com.result = SPConnectMsg::eNEW_CON;
 			com.id = client->id;
@@ -357,7 +360,7 @@ void ServerWorker::procUdpCon_NetThread( IComPacket* cp )
 		NetClientData* client = mClientManager.setClientUdpAddr(com->id, *sendAddr);
 		if (client)
 		{
-			mNetSelect.addSocket(client->udpChannel.getSocket());
+			mNetEventLoop.addSocket(client->udpChannel.getSocket(), *client);
 		}
 	}
 	//::Msg("procUdpConNet");
@@ -935,11 +938,26 @@ bool SVPlayerManager::sendCommand(int channel, IComPacket* cp, EWorkerSendFlag f
 {
 	NET_MUTEX_LOCK( mMutexPlayerTable );
 	bool result = false;
+	//Serialize once , every network player queues the same data
+	NetPacketSlice sharedData;
 	for(ServerPlayer* player : mPlayerTable)
 	{
-		if ( ( flag & WSF_IGNORE_LOCAL ) && !player->isNetwork() )
-			continue;
-		player->sendCommand( channel , cp );
+		if ( player->isNetwork() )
+		{
+			if ( !sharedData.isValid() )
+			{
+				sharedData = FNetCommand::WriteShared( cp );
+				if ( !sharedData.isValid() )
+					continue;
+			}
+			static_cast< SNetPlayer* >( player )->sendShared( channel , sharedData );
+		}
+		else
+		{
+			if ( flag & WSF_IGNORE_LOCAL )
+				continue;
+			player->sendCommand( channel , cp );
+		}
 		result = true;
 	}
 	return result;
@@ -1015,11 +1033,47 @@ void ServerClientManager::sendUdpData(long time, UdpServer& server)
 {
 	assert(IsInNetThread());
 
+	//Build the datagrams of all clients first , then send them with as few system calls as possible
+	size_t const MaxUdpDataSize = 65507u;
+	mUdpDatagrams.clear();
+	mUdpDatagramClients.clear();
 	for (SessionMap::iterator iter = mSessionMap.begin();
 		iter != mSessionMap.end(); ++iter)
 	{
 		NetClientData* client = iter->second;
-		server.sendPacket(time, client->udpChannel,client->udpAddr);
+		if (!client->udpChannel.prepareSendData(time))
+			continue;
+
+		UdpChain& chain = client->udpChannel;
+		SocketBuffer const& data = chain.getPacketData();
+		for (size_t offset = 0; offset < data.getFillSize(); offset += MaxUdpDataSize)
+		{
+			NetDatagram datagram;
+			datagram.data = data.getData() + offset;
+			datagram.size = std::min(data.getFillSize() - offset, MaxUdpDataSize);
+			datagram.addr = &client->udpAddr;
+			mUdpDatagrams.push_back(datagram);
+			mUdpDatagramClients.push_back(client);
+		}
+	}
+
+	if (mUdpDatagrams.empty())
+		return;
+
+	int numSend = server.getSocket().sendDatagrams(mUdpDatagrams.data(), (int)mUdpDatagrams.size());
+	if (numSend < (int)mUdpDatagrams.size())
+	{
+		LogDevMsg(0, "Can't send UDP Data : %d/%d", numSend, (int)mUdpDatagrams.size());
+	}
+
+	//Clients with unsent datagrams resend them with the reliable data later
+	for (int i = 0; i < numSend; ++i)
+	{
+		if (i + 1 == (int)mUdpDatagramClients.size() || mUdpDatagramClients[i + 1] != mUdpDatagramClients[i])
+		{
+			UdpChain& chain = mUdpDatagramClients[i]->udpChannel;
+			chain.markPacketSent(time);
+		}
 	}
 }
 
@@ -1093,44 +1147,24 @@ NetClientData* ServerClientManager::findClient( SessionId id )
 	return NULL;
 }
 
-void ServerClientManager::updateSocket( long time , NetSelectSet& netSelect)
+void ServerClientManager::updateNetTime(long time)
 {
 	assert(IsInNetThread());
-#if 1
-#if SERVER_USE_CONNECTED_UDP
-	if (CVarSvUseConnectedUDP)
-	{
-		for (auto& pair : mSessionMap)
-		{
-			NetClientData* client = pair.second;
-			client->updateUdpSocket(time, netSelect);
-		}
-	}
-#endif
-	for (auto& pair : mSessionMap)
-	{
-		NetClientData* client = pair.second;
-		client->tcpChannel.updateSocket( time , netSelect);
-	}
-#else
-
 #if SERVER_USE_CONNECTED_UDP
+	//Connected udp channels send data in onSendable with the client time
 	if (CVarSvUseConnectedUDP)
 	{
 		for (auto& pair : mSessionMap)
 		{
-			NetClientData* client = pair.second;
-			client->updateUdpSocket(time);
+			pair.second->mTime = time;
 		}
 	}
 #endif
-	for (auto& pair : mSessionMap)
-	{
-		NetClientData* client = pair.second;
-		client->tcpChannel.updateSocket(time);
-	}
-#endif
+}
 
+void ServerClientManager::processRemoveList()
+{
+	assert(IsInNetThread());
 	for( ClientList::iterator iter = mRemoveList.begin() ;
 		 iter != mRemoveList.end() ; ++iter )
 	{
@@ -1143,22 +1177,37 @@ void ServerClientManager::updateSocket( long time , NetSelectSet& netSelect)
 void ServerClientManager::sendTcpCommand( ComEvaluator& evaluator , IComPacket* cp )
 {
 	assert(IsInNetThread());
+	if ( mSessionMap.empty() )
+		return;
+
+	NetPacketSlice sharedData = FNetCommand::WriteShared( cp );
+	if ( !sharedData.isValid() )
+		return;
+
 	for( SessionMap::iterator iter = mSessionMap.begin();
 		iter != mSessionMap.end(); ++iter )
 	{
 		NetClientData* client = iter->second;
-		FNetCommand::Write( client->tcpChannel.getSendCtrl() , cp );
+		client->tcpChannel.getSendCtrl().appendShared( sharedData );
 	}
 }
 
 void ServerClientManager::sendUdpCommand( ComEvaluator& evaluator , IComPacket* cp )
 {
 	assert(IsInNetThread());
+	if ( mSessionMap.empty() )
+		return;
+
+	//Every chain frames its own datagram , only the serialization is shared
+	NetPacketSlice sharedData = FNetCommand::WriteShared( cp );
+	if ( !sharedData.isValid() )
+		return;
+
 	for( SessionMap::iterator iter = mSessionMap.begin();
 		iter != mSessionMap.end(); ++iter )
 	{
 		NetClientData* client = iter->second;
-		FNetCommand::Write( client->udpChannel.getSendCtrl() , cp );
+		client->udpChannel.getSendCtrl().fillData( sharedData.getData() , sharedData.size );
 	}
 }
 
@@ -1347,6 +1396,21 @@ void SNetPlayer::sendCommand( int channel , IComPacket* cp )
 	}
 }
 
+void SNetPlayer::sendShared( int channel , NetPacketSlice const& slice )
+{
+	switch( channel )
+	{
+	case CHANNEL_GAME_NET_TCP:
+		if (mTcpChannel)
+			mTcpChannel->sendShared(slice);
+		break;
+	case CHANNEL_GAME_NET_UDP_CHAIN:
+		if (mUdpChannel)
+			mUdpChannel->sendShared(slice);
+		break;
+	}
+}
+
 void SNetPlayer::sendTcpCommand( IComPacket* cp )
 {
 	if (mTcpChannel)
@@ -147,6 +147,8 @@ public:
 	void  sendTcpCommand( IComPacket* cp );
 	void  sendUdpCommand( IComPacket* cp );
 	void  sendCommand( int channel , IComPacket* cp );
+	//Data serialized once for all players
+	void  sendShared( int channel , NetPacketSlice const& slice );
 	
 	// Channel-based interface
 	INetChannel* getTcpChannel() { return mTcpChannel.get(); }
@@ -191,7 +193,8 @@ public:
 	ServerClientManager();
 	~ServerClientManager();
 
-	void        updateSocket( long time , NetSelectSet& netSelect);
+	void        updateNetTime( long time );
+	void        processRemoveList();
 	void        sendUdpData( long time , UdpServer& server );
 	NetClientData* findClient( NetAddress const& addr );
 	NetClientData* findClient( SessionId id );
@@ -233,6 +236,10 @@ protected:
 	ClientList mRemoveList;
 	AddrMap    mAddrMap;
 	SessionMap mSessionMap;
+
+	//Reused by sendUdpData
+	TArray< NetDatagram >    mUdpDatagrams;
+	TArray< NetClientData* > mUdpDatagramClients;
 };
 
 
@@ -390,8 +397,8 @@ public:
 
 	void removeClient(NetClientData* client)
 	{
-		mNetSelect.removeSocket(client->tcpChannel.getSocket());
-		mNetSelect.removeSocket(client->udpChannel.getSocket());
+		mNetEventLoop.removeSocket(client->tcpChannel.getSocket());
+		mNetEventLoop.removeSocket(client->udpChannel.getSocket());
 		mClientManager.removeClient(client);
 	}
 
@@ -418,7 +425,7 @@ protected:
 	TPtrHolder< LocalWorker >      mLocalWorker;
 
 	bool                 mbEnableUDPChain;
-	NetSelectSet         mNetSelect;
+	NetEventLoop         mNetEventLoop;
 	TcpServer            mTcpServer;
 	UdpServer            mUdpServer;
 	TcpClient            mGuideClient;
@@ -42,6 +42,7 @@ class LocalPlayerManager;
 class GameModeBase;
 class INetEngine;
 class IFrameActionTemplate;
+class IFrameStateHandler;
 
 class IFrameUpdater
 {
@@ -86,6 +87,8 @@ public:
 
 	virtual void onChangeState(EGameState state) {}
 	virtual IFrameActionTemplate* createActionTemplate(unsigned version) { return nullptr; }           
+	// A stage providing the state hooks records seekable replays
+	virtual IFrameStateHandler*   getFrameStateHandler() { return nullptr; }
 
 	void            setupStageMode(GameModeBase* mode);
 	GameModeBase*   getStageMode() { return mStageMode; }
@@ -353,3 +353,17 @@ unsigned FNetCommand::Write( SocketBuffer& buffer , IComPacket* cp )
 	}
 	return result;
 }
+
+NetPacketSlice FNetCommand::WriteShared( IComPacket* cp )
+{
+	//Start from the size of the last packet , consecutive broadcasts (frame data) have similar size
+	static std::atomic< uint32 > SizeHint{ 1024 };
+
+	NetPacketBufferRef buffer = NetPacketBufferPool::Get().acquire( SizeHint.load( std::memory_order_relaxed ) );
+	if ( !Write( buffer->getBuffer() , cp ) )
+		return NetPacketSlice();
+
+	uint32 size = (uint32)buffer->getBuffer().getFillSize();
+	SizeHint.store( size , std::memory_order_relaxed );
+	return NetPacketSlice( buffer , 0 , size );
+}
@@ -355,6 +355,8 @@ public:
 	
 	static unsigned Write(NetBufferOperator& bufferCtrl, IComPacket* cp);
 	static unsigned Write(SocketBuffer& buffer, IComPacket* cp);
+	//Serialize once into a pooled buffer , the slice can be queued to many channels
+	static NetPacketSlice WriteShared(IComPacket* cp);
 };
 
 
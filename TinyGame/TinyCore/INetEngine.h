@@ -7,6 +7,7 @@ class ActionProcessor;
 class IPlayerManager;
 class IGameModule;
 class IFrameUpdater;
+class IStreamSerializer;
 
 using FrameStateHandle = int;
 class IFameStateContainer
@@ -17,6 +18,20 @@ public:
 	virtual void  freeState(FrameStateHandle handle) = 0;
 };
 
+// Game state hooks for rollback and replay key frames , the whole simulation state must be written :
+// the game is restored from it and ticked again from that frame.
+// IFrameUpdater::tick must be deterministic and only change the saved state.
+class IFrameStateHandler
+{
+public:
+	virtual ~IFrameStateHandler(){}
+	virtual void saveFrameState( IStreamSerializer& serializer ) = 0;
+	virtual void loadFrameState( IStreamSerializer& serializer ) = 0;
+	// Set while the frames are simulated again after a rollback , sounds , effects and messages
+	// were already played by the first simulation of the frames
+	virtual void setResimulating( bool bResimulating ){}
+};
+
 class INetEngine
 {
 public:
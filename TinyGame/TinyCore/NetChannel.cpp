@@ -2,6 +2,17 @@
 #include "NetChannel.h"
 #include "GameWorker.h"  // For FNetCommand
 
+//=============================================================================
+// INetChannel Implementation
+//=============================================================================
+
+size_t INetChannel::sendShared(NetPacketSlice const& slice)
+{
+	getSendCtrl().fillData(slice.getData(), slice.size);
+	return slice.size;
+}
+
+
 //=============================================================================
 // TcpNetChannel Implementation
 //=============================================================================
@@ -21,6 +32,12 @@ size_t TcpNetChannel::send(IComPacket* packet)
 	return FNetCommand::Write(mClient.getSendCtrl(), packet);
 }
 
+size_t TcpNetChannel::sendShared(NetPacketSlice const& slice)
+{
+	mClient.getSendCtrl().appendShared(slice);
+	return slice.size;
+}
+
 void TcpNetChannel::flush(long time)
 {
 	// TCP sends data automatically when the socket is sendable
@@ -57,6 +74,12 @@ size_t TcpServerClientChannel::send(IComPacket* packet)
 	return FNetCommand::Write(mClient.getSendCtrl(), packet);
 }
 
+size_t TcpServerClientChannel::sendShared(NetPacketSlice const& slice)
+{
+	mClient.getSendCtrl().appendShared(slice);
+	return slice.size;
+}
+
 void TcpServerClientChannel::flush(long time)
 {
 	// TCP sends data automatically when the socket is sendable
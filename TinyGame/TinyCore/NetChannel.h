@@ -52,6 +52,10 @@ public:
 	// Queues a packet for sending. The packet is serialized immediately.
 	// Returns the number of bytes written, or 0 on failure.
 	virtual size_t send(IComPacket* packet) = 0;
+
+	// Queues packet data serialized once by FNetCommand::WriteShared for many channels.
+	// The default copies the bytes, TCP channels queue the slice itself.
+	virtual size_t sendShared(NetPacketSlice const& slice);
 	
 	// Processes pending data (send buffered data to network)
 	// Should be called periodically, typically from the network thread
@@ -85,6 +89,7 @@ public:
 	bool isConnected() const override;
 	
 	size_t send(IComPacket* packet) override;
+	size_t sendShared(NetPacketSlice const& slice) override;
 	void flush(long time) override;
 	void clearBuffer() override;
 	
@@ -114,6 +119,7 @@ public:
 	bool isConnected() const override;
 
 	size_t send(IComPacket* packet) override;
+	size_t sendShared(NetPacketSlice const& slice) override;
 	void flush(long time) override;
 	void clearBuffer() override;
 
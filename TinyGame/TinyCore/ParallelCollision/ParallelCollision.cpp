@@ -170,6 +170,7 @@ namespace ParallelCollision
 	void ParallelCollisionSolver::schedule(float dt, int entityCount, int bulletCount, QueueThreadPool& threadPool)
 	{
 		mTaskAllocator.clearFrame();
+		mBulletTaskAllocator.clearFrame();
 		mSolveEvent.reset();
 		CHECK(mThreadPool == nullptr);
 		mThreadPool = &threadPool;
@@ -206,7 +207,6 @@ namespace ParallelCollision
 			for (int i = 0; i < stepCount; ++i)
 			{
 				solveInternal(stepDt, threadPool);
-				solveQueries(threadPool);
 			}
 
 			auto Deduplicate = [](TArray<TVector2<int>>& pairs)
@@ -316,11 +316,43 @@ namespace ParallelCollision
 		}, 512);
 	}
 
+	void ParallelCollisionSolver::buildStepGraph()
+	{
+		//  Move -> EntityGrid -> NeighborCache -> Contacts -> Walls -> EntityQuery
+		//                                                           \-> BulletQuery
+		//  BulletGrid -> BulletBulletQuery -------------------------------/
+		// The bullet grid and the bullet pairs only read the bullets , they overlap the entity stages
+		auto move = mStepGraph.addNode("UpdateMove", [this]() { updateMove(mStepDt, *mThreadPool); });
+		auto entityGrid = mStepGraph.addNode("BuildEntityGrid", [this]() { buildEntityGrid(); }, { move });
+		auto neighborCache = mStepGraph.addNode("FillNeighborCache", [this]() { fillNeighborCache(*mThreadPool); }, { entityGrid });
+		auto contacts = mStepGraph.addNode("SolveContacts", [this]()
+		{
+			if (settings.useXPBD) solveXPBD(mStepDt, *mThreadPool);
+			else solveLegacy(mStepDt, *mThreadPool);
+		}, { neighborCache });
+		auto walls = mStepGraph.addNode("SolveWalls", [this]() { solveWalls(mStepDt, *mThreadPool); }, { contacts });
+		mStepGraph.addNode("EntityQuery", [this]() { solveEntityQueries(*mThreadPool); }, { walls });
+
+		auto bulletGrid = mStepGraph.addNode("BuildBulletGrid", [this]() { grid.buildBullets(bulletPositions, mBulletCount); });
+		auto bulletBulletQuery = mStepGraph.addNode("BulletBulletQuery", [this]() { solveBulletBulletQueries(*mThreadPool); }, { bulletGrid });
+		mStepGraph.addNode("BulletQuery", [this]() { solveBulletQueries(*mThreadPool); }, { walls, bulletBulletQuery });
+
+		mStepGraph.compile();
+	}
+
 	void ParallelCollisionSolver::solveInternal(float dt, QueueThreadPool& threadPool)
 	{
-		updateMove(dt, threadPool);
+		if (mStepGraph.getNodeNum() == 0)
+		{
+			buildStepGraph();
+		}
+		mStepDt = dt;
+		mStepGraph.run(threadPool);
+	}
+
+	void ParallelCollisionSolver::buildEntityGrid()
+	{
 		grid.buildEntities(positions, mEntityCount);
-		grid.buildBullets(bulletPositions, mBulletCount);
 #if USE_COLLISION_COLORING
 		for (int i = 0; i < 4; ++i) mColorEntities[i].clear();
 		for (int i = 0; i < mEntityCount; ++i)
@@ -330,10 +362,6 @@ namespace ParallelCollision
 			mColorEntities[color].push_back(i);
 		}
 #endif
-		fillNeighborCache(threadPool);
-		if (settings.useXPBD) solveXPBD(dt, threadPool);
-		else solveLegacy(dt, threadPool);
-		solveWalls(dt, threadPool);
 	}
 
 	void ParallelCollisionSolver::solveWalls(float dt, QueueThreadPool& threadPool)
@@ -669,9 +697,9 @@ namespace ParallelCollision
 		return (int)results.size();
 	}
 
-	void ParallelCollisionSolver::solveQueries(QueueThreadPool& threadPool)
+	void ParallelCollisionSolver::solveEntityQueries(QueueThreadPool& threadPool)
 	{
-		std::mutex entityHitMutex, bulletHitMutex, bulletBulletHitMutex;
+		std::mutex entityHitMutex;
 		const int batch = 1024;
 		int const* pLIdx = largeEntityIndices.data();
 		int lCount = (int)largeEntityIndices.size();
@@ -712,106 +740,132 @@ namespace ParallelCollision
 				entityHitPairs.append(hits.begin(), hits.end());
 			}
 		}, 1);
+	}
 
-		if (mBulletCount > 0)
+	void ParallelCollisionSolver::solveBulletQueries(QueueThreadPool& threadPool)
+	{
+		if (mBulletCount <= 0)
+			return;
+
+		std::mutex bulletHitMutex;
+		const int batch = 1024;
+		int const* pLIdx = largeEntityIndices.data();
+		int lCount = (int)largeEntityIndices.size();
+
+		ParallelForInWorker(threadPool, mBulletTaskAllocator, "BulletQuery", (mBulletCount + batch - 1) / batch, [this, batch, &bulletHitMutex, pLIdx, lCount](int tId)
 		{
-			ParallelForInWorker(threadPool, mTaskAllocator, "BulletQuery", (mBulletCount + batch - 1) / batch, [this, batch, &bulletHitMutex, &bulletBulletHitMutex, pLIdx, lCount](int tId)
+			int start = tId * batch, end = Math::Min(start + batch, mBulletCount);
+			TArray<TVector2<int>, TInlineAllocator<16>> bhits;
+			for (int i = start; i < end; ++i)
 			{
-				int start = tId * batch, end = Math::Min(start + batch, mBulletCount);
-				TArray<TVector2<int>, TInlineAllocator<16>> bhits, bbhits;
-				for (int i = start; i < end; ++i)
+				Vector2 bP = bulletPositions[i];
+				float bR = bulletRadii[i];
+				int bM = bulletTargetMasks[i];
+				int cxMin = Math::Clamp((int)((bP.x - bR - grid.minBound.x) * grid.invCellSize), 0, grid.gridWidth - 1);
+				int cxMax = Math::Clamp((int)((bP.x + bR - grid.minBound.x) * grid.invCellSize), 0, grid.gridWidth - 1);
+				int cyMin = Math::Clamp((int)((bP.y - bR - grid.minBound.y) * grid.invCellSize), 0, grid.gridHeight - 1);
+				int cyMax = Math::Clamp((int)((bP.y + bR - grid.minBound.y) * grid.invCellSize), 0, grid.gridHeight - 1);
+
+				for (int ny = cyMin; ny <= cyMax; ++ny)
 				{
-					Vector2 bP = bulletPositions[i];
-					float bR = bulletRadii[i];
-					int bM = bulletTargetMasks[i], bC = bulletCategoryIds[i];
-					int cxMin = Math::Clamp((int)((bP.x - bR - grid.minBound.x) * grid.invCellSize), 0, grid.gridWidth - 1);
-					int cxMax = Math::Clamp((int)((bP.x + bR - grid.minBound.x) * grid.invCellSize), 0, grid.gridWidth - 1);
-					int cyMin = Math::Clamp((int)((bP.y - bR - grid.minBound.y) * grid.invCellSize), 0, grid.gridHeight - 1);
-					int cyMax = Math::Clamp((int)((bP.y + bR - grid.minBound.y) * grid.invCellSize), 0, grid.gridHeight - 1);
-
-					for (int ny = cyMin; ny <= cyMax; ++ny)
+					int row = ny * grid.gridWidth;
+					for (int nx = cxMin; nx <= cxMax; ++nx)
 					{
-						int row = ny * grid.gridWidth;
-						for (int nx = cxMin; nx <= cxMax; ++nx)
+						int eIdx = grid.cellHeads[nx + row];
+						while (eIdx != -1)
 						{
-							int eIdx = grid.cellHeads[nx + row];
-							while (eIdx != -1)
+							if ((bM & categoryIds[eIdx]) != 0)
 							{
-								if ((bM & categoryIds[eIdx]) != 0)
+								// Broadphase (using max possible radius from param.x)
+								float rSum = bR + radii[eIdx];
+								if ((bP - positions[eIdx]).length2() < rSum * rSum)
 								{
-									// Broadphase (using max possible radius from param.x)
-									float rSum = bR + radii[eIdx];
-									if ((bP - positions[eIdx]).length2() < rSum * rSum)
+									bool hit = true;
+									// Narrowphase for non-circle shapes
+									if (bulletShapeTypes[i] == ShapeType::Arc)
 									{
-										bool hit = true;
-										// Narrowphase for non-circle shapes
-										if (bulletShapeTypes[i] == ShapeType::Arc)
-										{
-											hit = IntersectionTests::IntersectArcCircle(bP, bulletShapeParams[i].x, bulletRotations[i], bulletShapeParams[i].y * 0.5f, positions[eIdx], radii[eIdx]);
-										}
-										else if (bulletShapeTypes[i] == ShapeType::Rect)
-										{
-											hit = IntersectionTests::IntersectRectCircle(bP, Vector2(bulletShapeParams[i].x, bulletShapeParams[i].y), bulletRotations[i], positions[eIdx], radii[eIdx]);
-										}
-										
-										if (hit) bhits.emplace_back(i, eIdx);
+										hit = IntersectionTests::IntersectArcCircle(bP, bulletShapeParams[i].x, bulletRotations[i], bulletShapeParams[i].y * 0.5f, positions[eIdx], radii[eIdx]);
 									}
+									else if (bulletShapeTypes[i] == ShapeType::Rect)
+									{
+										hit = IntersectionTests::IntersectRectCircle(bP, Vector2(bulletShapeParams[i].x, bulletShapeParams[i].y), bulletRotations[i], positions[eIdx], radii[eIdx]);
+									}
+									
+									if (hit) bhits.emplace_back(i, eIdx);
 								}
-								eIdx = grid.nextIndices[eIdx];
 							}
+							eIdx = grid.nextIndices[eIdx];
 						}
 					}
-					for (int k = 0; k < lCount; ++k)
+				}
+				for (int k = 0; k < lCount; ++k)
+				{
+					int lIdx = pLIdx[k];
+					if ((bM & categoryIds[lIdx]) != 0)
 					{
-						int lIdx = pLIdx[k];
-						if ((bM & categoryIds[lIdx]) != 0)
+						float rSum = bR + radii[lIdx];
+						if ((bP - positions[lIdx]).length2() < rSum * rSum)
 						{
-							float rSum = bR + radii[lIdx];
-							if ((bP - positions[lIdx]).length2() < rSum * rSum)
+							bool hit = true;
+							if (bulletShapeTypes[i] == ShapeType::Arc)
 							{
-								bool hit = true;
-								if (bulletShapeTypes[i] == ShapeType::Arc)
-								{
-									hit = IntersectionTests::IntersectArcCircle(bP, bulletShapeParams[i].x, bulletRotations[i], bulletShapeParams[i].y * 0.5f, positions[lIdx], radii[lIdx]);
-								}
-								else if (bulletShapeTypes[i] == ShapeType::Rect)
-								{
-									hit = IntersectionTests::IntersectRectCircle(bP, Vector2(bulletShapeParams[i].x, bulletShapeParams[i].y), bulletRotations[i], positions[lIdx], radii[lIdx]);
-								}
-
-								if (hit) bhits.emplace_back(i, lIdx);
+								hit = IntersectionTests::IntersectArcCircle(bP, bulletShapeParams[i].x, bulletRotations[i], bulletShapeParams[i].y * 0.5f, positions[lIdx], radii[lIdx]);
 							}
+							else if (bulletShapeTypes[i] == ShapeType::Rect)
+							{
+								hit = IntersectionTests::IntersectRectCircle(bP, Vector2(bulletShapeParams[i].x, bulletShapeParams[i].y), bulletRotations[i], positions[lIdx], radii[lIdx]);
+							}
+
+							if (hit) bhits.emplace_back(i, lIdx);
 						}
 					}
+				}
+			}
+			if (!bhits.empty()) { std::lock_guard<std::mutex> lock(bulletHitMutex); bulletHitPairs.append(bhits.begin(), bhits.end()); }
+		}, 1);
+	}
+
+	void ParallelCollisionSolver::solveBulletBulletQueries(QueueThreadPool& threadPool)
+	{
+		if (mBulletCount <= 0)
+			return;
 
-					if (bulletQueryFlags[i])
+		std::mutex bulletBulletHitMutex;
+		const int batch = 1024;
+		ParallelForInWorker(threadPool, mBulletTaskAllocator, "BulletBulletQuery", (mBulletCount + batch - 1) / batch, [this, batch, &bulletBulletHitMutex](int tId)
+		{
+			int start = tId * batch, end = Math::Min(start + batch, mBulletCount);
+			TArray<TVector2<int>, TInlineAllocator<16>> bbhits;
+			for (int i = start; i < end; ++i)
+			{
+				if (!bulletQueryFlags[i]) continue;
+
+				Vector2 bP = bulletPositions[i];
+				float bR = bulletRadii[i];
+				int bM = bulletTargetMasks[i], bC = bulletCategoryIds[i];
+				int bcx = Math::Clamp((int)((bP.x - grid.minBound.x) * grid.invCellSize), 0, grid.gridWidth - 1);
+				int bcy = Math::Clamp((int)((bP.y - grid.minBound.y) * grid.invCellSize), 0, grid.gridHeight - 1);
+				for (int bny = Math::Max(bcy - 1, 0); bny <= Math::Min(bcy + 1, grid.gridHeight - 1); ++bny)
+				{
+					int brow = bny * grid.gridWidth;
+					for (int bnx = Math::Max(bcx - 1, 0); bnx <= Math::Min(bcx + 1, grid.gridWidth - 1); ++bnx)
 					{
-						int bcx = Math::Clamp((int)((bP.x - grid.minBound.x) * grid.invCellSize), 0, grid.gridWidth - 1);
-						int bcy = Math::Clamp((int)((bP.y - grid.minBound.y) * grid.invCellSize), 0, grid.gridHeight - 1);
-						for (int bny = Math::Max(bcy - 1, 0); bny <= Math::Min(bcy + 1, grid.gridHeight - 1); ++bny)
+						int bIdx = grid.bulletHeads[bnx + brow];
+						while (bIdx != -1)
 						{
-							int brow = bny * grid.gridWidth;
-							for (int bnx = Math::Max(bcx - 1, 0); bnx <= Math::Min(bcx + 1, grid.gridWidth - 1); ++bnx)
+							// Only check pairs where i < bIdx to avoid duplicate pairs
+							if (i < bIdx && ((bM & bulletCategoryIds[bIdx]) != 0 || (bulletTargetMasks[bIdx] & bC) != 0))
 							{
-								int bIdx = grid.bulletHeads[bnx + brow];
-								while (bIdx != -1)
-								{
-									// Only check pairs where i < bIdx to avoid duplicate pairs
-									if (i < bIdx && ((bM & bulletCategoryIds[bIdx]) != 0 || (bulletTargetMasks[bIdx] & bC) != 0))
-									{
-										float rSum = bR + bulletRadii[bIdx];
-										if ((bP - bulletPositions[bIdx]).length2() < rSum * rSum) bbhits.emplace_back(i, bIdx);
-									}
-									bIdx = grid.bulletNextIndices[bIdx];
-								}
+								float rSum = bR + bulletRadii[bIdx];
+								if ((bP - bulletPositions[bIdx]).length2() < rSum * rSum) bbhits.emplace_back(i, bIdx);
 							}
+							bIdx = grid.bulletNextIndices[bIdx];
 						}
 					}
 				}
-				if (!bhits.empty()) { std::lock_guard<std::mutex> lock(bulletHitMutex); bulletHitPairs.append(bhits.begin(), bhits.end()); }
-				if (!bbhits.empty()) { std::lock_guard<std::mutex> lock(bulletBulletHitMutex); bulletBulletHitPairs.append(bbhits.begin(), bbhits.end()); }
-			}, 1);
-		}
+			}
+			if (!bbhits.empty()) { std::lock_guard<std::mutex> lock(bulletBulletHitMutex); bulletBulletHitPairs.append(bbhits.begin(), bbhits.end()); }
+		}, 1);
 	}
 
 	ParallelCollisionManager::ParallelCollisionManager(QueueThreadPool& threadPool) : mThreadPool(threadPool)
@@ -4,6 +4,7 @@
 #include "Math/Vector3.h"
 #include "DataStructure/Array.h"
 #include "Async/AsyncWork.h"
+#include "Async/TaskGraph.h"
 #include "Memory/FrameAllocator.h"
 #include "PlatformThread.h"
 #include <mutex>
@@ -147,7 +148,7 @@ namespace ParallelCollision
 	class ParallelCollisionSolver
 	{
 	public:
-		ParallelCollisionSolver() : mTaskAllocator(16 * 1024 * 1024) {}
+		ParallelCollisionSolver() : mTaskAllocator(16 * 1024 * 1024), mBulletTaskAllocator(1024 * 1024) {}
 
 		CollisionSettings settings;
 		SpatialHashGrid   grid;
@@ -201,20 +202,30 @@ namespace ParallelCollision
 
 	private:
 		friend class ParallelCollisionManager;
+		void buildStepGraph();
 		void solveInternal(float dt, QueueThreadPool& threadPool);
 		void updateMove(float dt, QueueThreadPool& threadPool);
+		void buildEntityGrid();
 		void fillNeighborCache(QueueThreadPool& threadPool);
 		void solveXPBD(float dt, QueueThreadPool& threadPool);
 		void solveLegacy(float dt, QueueThreadPool& threadPool);
 		void solveWalls(float dt, QueueThreadPool& threadPool);
-		void solveQueries(QueueThreadPool& threadPool);
+		void solveEntityQueries(QueueThreadPool& threadPool);
+		void solveBulletQueries(QueueThreadPool& threadPool);
+		void solveBulletBulletQueries(QueueThreadPool& threadPool);
 		void solveDeferredQueries(QueueThreadPool& threadPool);
 		int  queryEntities(Vector2 const& pos, float rot, ShapeType type, Vector3 const& params, int mask, TArray<int>& results);
 
 		ThreadEvent mSolveEvent;
 		float       mLastSolveTime = 0.0f;
 		FrameAllocator mTaskAllocator;
+		//The bullet stages run beside the entity stages , they can't share the stack marks of mTaskAllocator
+		FrameAllocator mBulletTaskAllocator;
 		QueueThreadPool* mThreadPool = nullptr;
+
+		//The stages of a sub step , built once and run for every sub step
+		TaskGraph mStepGraph;
+		float     mStepDt = 0.0f;
 	};
 
 	class ParallelCollisionManager
@@ -272,13 +272,22 @@ bool ReplayGameMode::initializeStage(GameStageBase* stage)
 	//// Replay Input////////////
 
 	actionTemplate = NULL;
+	mStreamInput = nullptr;
 	if( header.version >= MAKE_VERSION(0, 1, 0) )
 	{
 		actionTemplate = stage->createActionTemplate(info.templateVersion);
 		if( !actionTemplate )
 			return false;
 
-		mReplayInput.reset(new ReplayInput(actionTemplate, mReplayFrame));
+		if( header.version >= ReplayStreamWriter::Version )
+		{
+			mStreamInput = new StreamReplayInput(actionTemplate, mReplayFrame);
+			mReplayInput.reset(mStreamInput);
+		}
+		else
+		{
+			mReplayInput.reset(new ReplayInput(actionTemplate, mReplayFrame));
+		}
 	}
 	else if ( getGame() )
 	{
@@ -337,7 +346,7 @@ bool ReplayGameMode::initializeStage(GameStageBase* stage)
 	int px = broader;
 	int py = 12;
 
-	mProgressSlider = new GSlider(0, Vec2i(px, py), baseSize.x, true, frame);
+	mProgressSlider = new GSlider(UI_REPLAY_PROGRESS, Vec2i(px, py), baseSize.x, true, frame);
 
 	Vec2i replayBtnSize(baseSize.x / 4, baseSize.y);
 
@@ -429,7 +438,39 @@ void ReplayGameMode::updateTime(GameTimeSpan deltaTime)
 	}
 
 	int totalFrame = mReplayInput->getRecordFrame();
-	mProgressSlider->setValue(totalFrame ? int(1000 * mReplayFrame / totalFrame) : 0);
+	if( mProgressSlider->canRefresh() )
+		mProgressSlider->setValue(totalFrame ? int(1000 * mReplayFrame / totalFrame) : 0);
+}
+
+void ReplayGameMode::seekReplay(long frame)
+{
+	IFrameStateHandler* stateHandler = getStage()->getFrameStateHandler();
+	if( mStreamInput == nullptr || stateHandler == nullptr )
+		return;
+
+	frame = clamp(frame, 1, long(mReplayInput->getRecordFrame()));
+
+	long keyFrame = mStreamInput->seekFrame(frame, *stateHandler);
+	if( keyFrame == INDEX_NONE )
+	{
+		restart(false);
+		return;
+	}
+
+	if( getGameState() == EGameState::End )
+		changeState(EGameState::Run);
+
+	//The key frame state is the state before the input of the frame , simulate up to the frame
+	mReplayFrame = keyFrame - 1;
+	ActionProcessor& processor = getStage()->getActionProcessor();
+	while( mReplayFrame + 1 < frame )
+	{
+		++mReplayFrame;
+		processor.beginAction();
+		getStage()->tick();
+		processor.endAction();
+	}
+	getStage()->updateFrame(0);
 }
 
 bool ReplayGameMode::onWidgetEvent(int event, int id, GWidget* ui)
@@ -454,6 +495,13 @@ bool ReplayGameMode::onWidgetEvent(int event, int id, GWidget* ui)
 		mIndexSpeed = clamp(mIndexSpeed - 1, 0, ARRAY_SIZE(gReplaySpeed) - 1);
 		mReplaySpeed = gReplaySpeed[mIndexSpeed];
 		return false;
+	case UI_REPLAY_PROGRESS:
+		if( event == EVT_SLIDER_CHANGE )
+		{
+			int value = GUI::CastFast< GSlider >(ui)->getValue();
+			seekReplay(long(int64(mReplayInput->getRecordFrame()) * value / 1000));
+		}
+		return false;
 	case UI_GAME_MENU:
 		togglePause();
 		::Global::GUI().showMessageBox(UI_MAIN_MENU, LOCTEXT("back Main Menu?"));
@@ -87,6 +87,7 @@ public:
 		UI_REPLAY_RESTART,
 		UI_REPLAY_FAST,
 		UI_REPLAY_SLOW,
+		UI_REPLAY_PROGRESS,
 
 		NEXT_UI_ID,
 	};
@@ -109,8 +110,11 @@ protected:
 	void updateTime(GameTimeSpan deltaTime);
 	bool onWidgetEvent(int event, int id, GWidget* ui);
 	void onRestart(uint64& seed);
+	//Jump to the frame with the key frames of a replay stream
+	void seekReplay(long frame);
 
 	TPtrHolder< IReplayInput >         mReplayInput;
+	StreamReplayInput*                 mStreamInput = nullptr;
 	TPtrHolder< LocalPlayerManager >   mPlayerManager;
 	IFrameActionTemplate* actionTemplate;
 
@@ -0,0 +1,500 @@
+#include "TinyGamePCH.h"
+#include "ReplayStream.h"
+
+#include "Serialize/StreamBuffer.h"
+#include "LogSystem.h"
+
+#include <algorithm>
+
+ReplayStreamWriter::ReplayStreamWriter()
+{
+	mOffset = 0;
+	mKeyFrameInterval = 0;
+	mChunkFrameNum = 0;
+	mLastStateFrame = INDEX_NONE;
+}
+
+ReplayStreamWriter::~ReplayStreamWriter()
+{
+	if( mFile.is_open() )
+	{
+		flush();
+		mFile.close();
+	}
+}
+
+bool ReplayStreamWriter::open( char const* path , uint64 seed , void const* infoData , uint32 infoSize , int keyFrameInterval , int chunkFrameNum )
+{
+	mFile.open( path , std::ios::binary | std::ios::trunc );
+	if( !mFile.is_open() )
+		return false;
+
+	mKeyFrameInterval = keyFrameInterval;
+	mChunkFrameNum = std::max( chunkFrameNum , 1 );
+	mLastStateFrame = INDEX_NONE;
+	mChunkNodes.clear();
+	mChunkData.clear();
+	mIndex.clear();
+	mEncoder.reset();
+	mEncoder.resetStats();
+
+	ReplayStreamHeader header;
+	header.magic = ReplayStreamHeader::Magic;
+	header.version = Version;
+	header.seed = seed;
+	header.keyFrameInterval = keyFrameInterval;
+	header.chunkFrameNum = mChunkFrameNum;
+	header.infoSize = infoSize;
+	header.reserved = 0;
+
+	mFile.write( (char const*)&header , sizeof( header ) );
+	if( infoSize )
+		mFile.write( (char const*)infoData , infoSize );
+	mOffset = sizeof( header ) + infoSize;
+	return mFile.good();
+}
+
+bool ReplayStreamWriter::close( int32 totalFrame , void const* infoData , uint32 infoSize )
+{
+	if( !mFile.is_open() )
+		return false;
+
+	flushActionChunk();
+	if( infoData )
+	{
+		writeChunk( EReplayChunk::Info , 0 , 0 , infoData , infoSize );
+	}
+
+	ReplayChunkHeader chunk;
+	chunk.type = (uint32)EReplayChunk::Index;
+	chunk.frame = 0;
+	chunk.numFrame = 0;
+	chunk.size = uint32( mIndex.size() * sizeof( ReplayIndexEntry ) );
+
+	ReplayStreamTrailer trailer;
+	trailer.indexOffset = mOffset;
+	trailer.totalFrame = totalFrame;
+	trailer.magic = ReplayStreamTrailer::Magic;
+
+	mFile.write( (char const*)&chunk , sizeof( chunk ) );
+	mFile.write( (char const*)mIndex.data() , chunk.size );
+	mFile.write( (char const*)&trailer , sizeof( trailer ) );
+	mOffset += sizeof( chunk ) + chunk.size + sizeof( trailer );
+
+	bool bOk = mFile.good();
+	mFile.close();
+	return bOk;
+}
+
+bool ReplayStreamWriter::needKeyFrame( int32 frame ) const
+{
+	return mKeyFrameInterval > 0 && ( frame % mKeyFrameInterval ) == 0 && frame != mLastStateFrame;
+}
+
+void ReplayStreamWriter::writeState( int32 frame , IFrameStateHandler& handler )
+{
+	//Action chunks never cross a key frame , seeking decodes the chunks after it only
+	flushActionChunk();
+
+	mWriteData.clear();
+	auto serializer = CreateBufferSerializer< ArrayWriteBuffer >( mWriteData );
+	handler.saveFrameState( serializer );
+	writeChunk( EReplayChunk::State , frame , 1 , mWriteData.data() , (uint32)mWriteData.size() );
+	mLastStateFrame = frame;
+}
+
+void ReplayStreamWriter::recordFrame( int32 frame , void const* data , uint32 size )
+{
+	if( size == 0 )
+		return;
+
+	if( !mChunkNodes.empty() && frame - mChunkNodes[0].frame >= mChunkFrameNum )
+		flushActionChunk();
+
+	if( !mChunkNodes.empty() )
+	{
+		ReplayFrameNode& lastNode = mChunkNodes.back();
+		if( lastNode.frame + int32( lastNode.repeat ) + 1 == frame && mEncoder.isRepeatFrame( data , size ) )
+		{
+			++lastNode.repeat;
+			return;
+		}
+	}
+	else
+	{
+		//Every chunk starts with a key frame of the codec
+		mEncoder.reset();
+	}
+
+	uint32 codedSize = mEncoder.encode( data , size );
+
+	ReplayFrameNode node;
+	node.frame = frame;
+	node.pos = (uint32)mChunkData.size();
+	node.repeat = 0;
+	mChunkNodes.push_back( node );
+
+	uint8 const* pCodedData = mEncoder.getCodedData().data();
+	mChunkData.insert( mChunkData.end() , pCodedData , pCodedData + codedSize );
+}
+
+void ReplayStreamWriter::flush()
+{
+	flushActionChunk();
+	mFile.flush();
+}
+
+void ReplayStreamWriter::flushActionChunk()
+{
+	if( mChunkNodes.empty() )
+		return;
+
+	uint32 numNode = (uint32)mChunkNodes.size();
+	mWriteData.clear();
+	mWriteData.insert( mWriteData.end() , (uint8 const*)&numNode , (uint8 const*)( &numNode + 1 ) );
+	mWriteData.insert( mWriteData.end() , (uint8 const*)mChunkNodes.data() , (uint8 const*)( mChunkNodes.data() + numNode ) );
+	mWriteData.insert( mWriteData.end() , mChunkData.begin() , mChunkData.end() );
+
+	ReplayFrameNode const& firstNode = mChunkNodes.front();
+	ReplayFrameNode const& lastNode = mChunkNodes.back();
+	uint32 numFrame = uint32( lastNode.frame + int32( lastNode.repeat ) + 1 - firstNode.frame );
+	writeChunk( EReplayChunk::Action , firstNode.frame , numFrame , mWriteData.data() , (uint32)mWriteData.size() );
+
+	mChunkNodes.clear();
+	mChunkData.clear();
+}
+
+void ReplayStreamWriter::writeChunk( EReplayChunk type , int32 frame , uint32 numFrame , void const* data , uint32 size )
+{
+	ReplayChunkHeader chunk;
+	chunk.type = (uint32)type;
+	chunk.frame = frame;
+	chunk.numFrame = numFrame;
+	chunk.size = size;
+	mFile.write( (char const*)&chunk , sizeof( chunk ) );
+	if( size )
+		mFile.write( (char const*)data , size );
+
+	ReplayIndexEntry entry;
+	entry.type = (uint32)type;
+	entry.frame = frame;
+	entry.numFrame = numFrame;
+	entry.reserved = 0;
+	entry.offset = mOffset;
+	mIndex.push_back( entry );
+
+	mOffset += sizeof( chunk ) + size;
+}
+
+ReplayStreamReader::ReplayStreamReader()
+{
+	mDataOffset = 0;
+	mInfoOffset = 0;
+	mInfoSize = 0;
+	mTotalFrame = 0;
+	mbHaveIndex = false;
+	mChunkIndex = 0;
+	mChunkData = nullptr;
+	mChunkDataSize = 0;
+	mNextNode = 0;
+	mNumDecodedNode = 0;
+	mbNodeDecodeOk = false;
+	mLoadPos = 0;
+}
+
+bool ReplayStreamReader::open( char const* path )
+{
+	close();
+	if( !mFile.open( path ) )
+		return false;
+
+	if( mFile.getSize() < sizeof( ReplayStreamHeader ) )
+	{
+		close();
+		return false;
+	}
+
+	memcpy( &mHeader , mFile.getData() , sizeof( mHeader ) );
+	if( mHeader.magic != ReplayStreamHeader::Magic || mHeader.version > ReplayStreamWriter::Version ||
+	    sizeof( ReplayStreamHeader ) + uint64( mHeader.infoSize ) > mFile.getSize() )
+	{
+		LogWarning( 0 , "Replay Stream : %s is not a replay stream" , path );
+		close();
+		return false;
+	}
+
+	mDataOffset = sizeof( ReplayStreamHeader ) + mHeader.infoSize;
+	mInfoOffset = sizeof( ReplayStreamHeader );
+	mInfoSize = mHeader.infoSize;
+	if( !readIndex() )
+	{
+		scanChunks();
+	}
+
+	seekFrame( 0 );
+	return true;
+}
+
+void ReplayStreamReader::close()
+{
+	mFile.close();
+	mStateChunks.clear();
+	mActionChunks.clear();
+	mChunkNodes.clear();
+	mChunkIndex = 0;
+	mChunkData = nullptr;
+	mChunkDataSize = 0;
+	mNextNode = 0;
+	mNumDecodedNode = 0;
+	mInfoOffset = 0;
+	mInfoSize = 0;
+	mTotalFrame = 0;
+	mbHaveIndex = false;
+	mDecoder.reset();
+}
+
+bool ReplayStreamReader::readChunkHeader( uint64 offset , ReplayChunkHeader& outHeader ) const
+{
+	uint64 fileSize = mFile.getSize();
+	if( offset + sizeof( ReplayChunkHeader ) > fileSize )
+		return false;
+
+	memcpy( &outHeader , mFile.getData() + offset , sizeof( outHeader ) );
+	//A chunk cut by an unfinished recording is ignored
+	return offset + sizeof( ReplayChunkHeader ) + outHeader.size <= fileSize;
+}
+
+bool ReplayStreamReader::readIndex()
+{
+	uint64 fileSize = mFile.getSize();
+	if( fileSize < mDataOffset + sizeof( ReplayStreamTrailer ) )
+		return false;
+
+	ReplayStreamTrailer trailer;
+	memcpy( &trailer , mFile.getData() + fileSize - sizeof( trailer ) , sizeof( trailer ) );
+	if( trailer.magic != ReplayStreamTrailer::Magic || trailer.indexOffset < mDataOffset )
+		return false;
+
+	ReplayChunkHeader chunk;
+	if( !readChunkHeader( trailer.indexOffset , chunk ) ||
+	    chunk.type != (uint32)EReplayChunk::Index || ( chunk.size % sizeof( ReplayIndexEntry ) ) != 0 )
+		return false;
+
+	uint32 numEntry = chunk.size / sizeof( ReplayIndexEntry );
+	uint8 const* pEntryData = mFile.getData() + trailer.indexOffset + sizeof( chunk );
+	for( uint32 i = 0; i < numEntry; ++i )
+	{
+		ReplayIndexEntry entry;
+		memcpy( &entry , pEntryData + i * sizeof( entry ) , sizeof( entry ) );
+		addChunk( entry );
+	}
+
+	mTotalFrame = trailer.totalFrame;
+	mbHaveIndex = true;
+	return true;
+}
+
+void ReplayStreamReader::scanChunks()
+{
+	mStateChunks.clear();
+	mActionChunks.clear();
+	mTotalFrame = 0;
+
+	uint64 offset = mDataOffset;
+	ReplayChunkHeader chunk;
+	while( readChunkHeader( offset , chunk ) )
+	{
+		ReplayIndexEntry entry;
+		entry.type = chunk.type;
+		entry.frame = chunk.frame;
+		entry.numFrame = chunk.numFrame;
+		entry.reserved = 0;
+		entry.offset = offset;
+
+		if( chunk.type == (uint32)EReplayChunk::Index )
+			break;
+
+		addChunk( entry );
+		mTotalFrame = std::max< int32 >( mTotalFrame , chunk.frame + int32( chunk.numFrame ) - 1 );
+		offset += sizeof( chunk ) + chunk.size;
+	}
+	mbHaveIndex = false;
+}
+
+void ReplayStreamReader::addChunk( ReplayIndexEntry const& entry )
+{
+	switch( EReplayChunk( entry.type ) )
+	{
+	case EReplayChunk::Action:
+		mActionChunks.push_back( entry );
+		break;
+	case EReplayChunk::State:
+		mStateChunks.push_back( entry );
+		break;
+	case EReplayChunk::Info:
+		{
+			ReplayChunkHeader chunk;
+			if( readChunkHeader( entry.offset , chunk ) )
+			{
+				mInfoOffset = entry.offset + sizeof( chunk );
+				mInfoSize = chunk.size;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+int32 ReplayStreamReader::findKeyFrame( int32 frame ) const
+{
+	auto iter = std::upper_bound( mStateChunks.begin() , mStateChunks.end() , frame ,
+		[]( int32 value , ReplayIndexEntry const& entry ) { return value < entry.frame; } );
+	if( iter == mStateChunks.begin() )
+		return INDEX_NONE;
+	return ( iter - 1 )->frame;
+}
+
+bool ReplayStreamReader::loadKeyFrame( int32 keyFrame , IFrameStateHandler& handler )
+{
+	auto iter = std::lower_bound( mStateChunks.begin() , mStateChunks.end() , keyFrame ,
+		[]( ReplayIndexEntry const& entry , int32 value ) { return entry.frame < value; } );
+	if( iter == mStateChunks.end() || iter->frame != keyFrame )
+		return false;
+
+	ReplayChunkHeader chunk;
+	if( !readChunkHeader( iter->offset , chunk ) )
+		return false;
+
+	char* pStateData = (char*)( mFile.getData() + iter->offset + sizeof( chunk ) );
+	TStreamBuffer< ThrowCheckPolicy > buffer( pStateData , chunk.size );
+	buffer.setFillSize( chunk.size );
+	try
+	{
+		auto serializer = CreateSerializer( buffer );
+		handler.loadFrameState( serializer );
+	}
+	catch( BufferException& )
+	{
+		LogWarning( 0 , "Replay Stream : can't load key frame %d" , keyFrame );
+		return false;
+	}
+	return true;
+}
+
+bool ReplayStreamReader::seekFrame( int32 frame )
+{
+	//First chunk ending after the frame
+	auto iter = std::upper_bound( mActionChunks.begin() , mActionChunks.end() , frame ,
+		[]( int32 value , ReplayIndexEntry const& entry ) { return value < entry.frame + int32( entry.numFrame ); } );
+
+	if( !loadActionChunk( iter - mActionChunks.begin() ) )
+		return iter == mActionChunks.end();
+
+	//Nodes are coded against each other , decode the nodes before the frame
+	while( mNextNode < mChunkNodes.size() )
+	{
+		ReplayFrameNode const& node = mChunkNodes[mNextNode];
+		if( node.frame + int32( node.repeat ) >= frame )
+			break;
+
+		mbNodeDecodeOk = decodeNode( mNextNode );
+		++mNextNode;
+	}
+	return true;
+}
+
+bool ReplayStreamReader::loadActionChunk( size_t chunkIndex )
+{
+	mChunkIndex = chunkIndex;
+	mChunkNodes.clear();
+	mChunkData = nullptr;
+	mChunkDataSize = 0;
+	mNextNode = 0;
+	mNumDecodedNode = 0;
+	mDecoder.reset();
+
+	if( chunkIndex >= mActionChunks.size() )
+		return false;
+
+	ReplayChunkHeader chunk;
+	uint64 offset = mActionChunks[chunkIndex].offset;
+	uint32 numNode;
+	if( !readChunkHeader( offset , chunk ) || chunk.size < sizeof( numNode ) )
+		return false;
+
+	uint8 const* pChunkData = mFile.getData() + offset + sizeof( chunk );
+	memcpy( &numNode , pChunkData , sizeof( numNode ) );
+	uint64 nodeDataSize = uint64( numNode ) * sizeof( ReplayFrameNode );
+	if( sizeof( numNode ) + nodeDataSize > chunk.size )
+		return false;
+
+	mChunkNodes.resize( numNode );
+	memcpy( mChunkNodes.data() , pChunkData + sizeof( numNode ) , nodeDataSize );
+	mChunkData = pChunkData + sizeof( numNode ) + nodeDataSize;
+	mChunkDataSize = chunk.size - uint32( sizeof( numNode ) + nodeDataSize );
+	return true;
+}
+
+bool ReplayStreamReader::decodeNode( size_t nodeIndex )
+{
+	assert( nodeIndex == mNumDecodedNode );
+	++mNumDecodedNode;
+
+	uint32 pos = mChunkNodes[nodeIndex].pos;
+	uint32 endPos = ( nodeIndex + 1 < mChunkNodes.size() ) ? mChunkNodes[nodeIndex + 1].pos : mChunkDataSize;
+	if( pos > endPos || endPos > mChunkDataSize )
+		return false;
+
+	return mDecoder.decode( mChunkData + pos , endPos - pos );
+}
+
+bool ReplayStreamReader::advanceFrame( int32 frame )
+{
+	while( mChunkIndex < mActionChunks.size() )
+	{
+		if( mNextNode >= mChunkNodes.size() )
+		{
+			loadActionChunk( mChunkIndex + 1 );
+			continue;
+		}
+
+		ReplayFrameNode const& node = mChunkNodes[mNextNode];
+		if( node.frame > frame )
+			break;
+
+		if( mNumDecodedNode == mNextNode )
+		{
+			mbNodeDecodeOk = decodeNode( mNextNode );
+		}
+
+		if( frame <= node.frame + int32( node.repeat ) )
+		{
+			if( frame == node.frame + int32( node.repeat ) )
+				++mNextNode;
+
+			if( !mbNodeDecodeOk )
+			{
+				LogWarning( 0 , "Replay Stream Error : can't decode frame %d" , frame );
+				return false;
+			}
+
+			mLoadPos = 0;
+			return true;
+		}
+
+		LogWarning( 0 , "Replay Stream Error : skip frame %d" , node.frame );
+		++mNextNode;
+	}
+
+	return false;
+}
+
+void ReplayStreamReader::read( void* ptr , size_t num )
+{
+	auto const& frameData = mDecoder.getFrameData();
+	if( mLoadPos + num > frameData.size() )
+		return;
+	memcpy( ptr , frameData.data() + mLoadPos , num );
+	mLoadPos += num;
+}
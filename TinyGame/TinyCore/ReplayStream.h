@@ -0,0 +1,186 @@
+#pragma once
+#ifndef ReplayStream_H_604CED7F_0399_4248_ADCF_470B7DE2FF21
+#define ReplayStream_H_604CED7F_0399_4248_ADCF_470B7DE2FF21
+
+#include "GameConfig.h"
+#include "FrameDataCodec.h"
+#include "INetEngine.h"
+#include "FileSystem.h"
+
+#include "Serialize/DataStream.h"
+#include "DataStructure/Array.h"
+
+#include <fstream>
+
+// Seekable replay stream.
+//
+// The file is a header followed by chunks appended while recording , the header is never rewritten :
+//   - action chunk : frame data nodes coded with FrameDataCodec , the codec restarts on every chunk
+//   - state chunk  : full game state before the input of the frame , written every key frame interval
+//   - info chunk   : replay info known at the end of the recording , it replaces the info of the header
+//   - index chunk  : frame -> offset of every chunk , followed by a trailer at the end of the file
+// A file without the trailer ( recording still running or not closed ) is indexed by scanning the chunks.
+// Seeking loads the closest state chunk and decodes one action chunk ,
+// the game then simulates at most a key frame interval to reach the frame.
+
+struct ReplayStreamHeader
+{
+	static uint32 const Magic = 0x53505254; // "TRPS"
+
+	uint32  magic;
+	uint32  version;
+	uint64  seed;
+	uint32  keyFrameInterval;
+	uint32  chunkFrameNum;
+	uint32  infoSize;
+	uint32  reserved;
+};
+
+enum class EReplayChunk : uint32
+{
+	Action ,
+	State ,
+	//Info known at the end of the recording , replaces the info of the header
+	Info ,
+	Index ,
+};
+
+struct ReplayChunkHeader
+{
+	uint32  type;
+	int32   frame;
+	//Frames [ frame , frame + numFrame ) , the node data of an action chunk follows
+	uint32  numFrame;
+	uint32  size;
+};
+
+struct ReplayIndexEntry
+{
+	uint32  type;
+	int32   frame;
+	uint32  numFrame;
+	uint32  reserved;
+	uint64  offset;
+};
+
+//Frames [ frame , frame + repeat ] share the node data , pos is relative to the coded data of the chunk
+struct ReplayFrameNode
+{
+	int32   frame;
+	uint32  pos;
+	uint32  repeat;
+};
+
+struct ReplayStreamTrailer
+{
+	static uint32 const Magic = 0x49505254; // "TRPI"
+
+	uint64  indexOffset;
+	int32   totalFrame;
+	uint32  magic;
+};
+
+class TINY_API ReplayStreamWriter
+{
+public:
+	static uint32 const Version = MAKE_VERSION(0,3,0);
+
+	ReplayStreamWriter();
+	~ReplayStreamWriter();
+
+	bool  open( char const* path , uint64 seed , void const* infoData , uint32 infoSize ,
+		        int keyFrameInterval = 600 , int chunkFrameNum = 120 );
+	//Write the final info , the index and the trailer
+	bool  close( int32 totalFrame , void const* infoData = nullptr , uint32 infoSize = 0 );
+	bool  isOpen() const { return mFile.is_open(); }
+
+	bool  needKeyFrame( int32 frame ) const;
+	//State before the input of the frame is applied
+	void  writeState( int32 frame , IFrameStateHandler& handler );
+	void  recordFrame( int32 frame , void const* data , uint32 size );
+
+	//Write the pending action chunk , the file can be read up to it
+	void  flush();
+
+	FrameDataCodecStats const& getRecordStats() const { return mEncoder.getStats(); }
+	uint64 getFileSize() const { return mOffset; }
+
+private:
+	void  flushActionChunk();
+	void  writeChunk( EReplayChunk type , int32 frame , uint32 numFrame , void const* data , uint32 size );
+
+	std::ofstream      mFile;
+	uint64             mOffset;
+	int                mKeyFrameInterval;
+	int                mChunkFrameNum;
+	int32              mLastStateFrame;
+
+	TArray< ReplayFrameNode > mChunkNodes;
+	TArray< uint8 >     mChunkData;
+	TArray< uint8 >     mWriteData;
+	FrameDataEncoder    mEncoder;
+
+	TArray< ReplayIndexEntry > mIndex;
+};
+
+class TINY_API ReplayStreamReader : public IStreamSerializer
+{
+public:
+	ReplayStreamReader();
+
+	bool  open( char const* path );
+	void  close();
+	bool  isOpen() const { return mFile.isOpen(); }
+
+	ReplayStreamHeader const& getHeader() const { return mHeader; }
+	uint8 const* getInfoData() const { return mFile.getData() + mInfoOffset; }
+	uint32       getInfoSize() const { return mInfoSize; }
+	int32        getTotalFrame() const { return mTotalFrame; }
+	uint64       getFileSize() const { return mFile.getSize(); }
+	//False when the chunks were scanned , the recording was not closed
+	bool         haveIndex() const { return mbHaveIndex; }
+
+	//Closest key frame before the frame , INDEX_NONE if the game must start from the seed
+	int32 findKeyFrame( int32 frame ) const;
+	bool  loadKeyFrame( int32 keyFrame , IFrameStateHandler& handler );
+
+	//Next advanceFrame starts at the frame
+	bool  seekFrame( int32 frame );
+	//Return true when the frame has data , read it with the IStreamSerializer interface
+	bool  advanceFrame( int32 frame );
+	TArray< uint8 > const& getFrameData() const { return mDecoder.getFrameData(); }
+
+	void  read( void* ptr , size_t num ) override;
+	void  write( void const* ptr , size_t num ) override {}
+
+private:
+	bool  readIndex();
+	void  scanChunks();
+	void  addChunk( ReplayIndexEntry const& entry );
+	bool  loadActionChunk( size_t chunkIndex );
+	bool  decodeNode( size_t nodeIndex );
+	bool  readChunkHeader( uint64 offset , ReplayChunkHeader& outHeader ) const;
+
+	MappedFileView      mFile;
+	ReplayStreamHeader  mHeader;
+	uint64              mDataOffset;
+	uint64              mInfoOffset;
+	uint32              mInfoSize;
+	int32               mTotalFrame;
+	bool                mbHaveIndex;
+
+	TArray< ReplayIndexEntry > mStateChunks;
+	TArray< ReplayIndexEntry > mActionChunks;
+
+	size_t              mChunkIndex;
+	TArray< ReplayFrameNode > mChunkNodes;
+	uint8 const*        mChunkData;
+	uint32              mChunkDataSize;
+	size_t              mNextNode;
+	size_t              mNumDecodedNode;
+	bool                mbNodeDecodeOk;
+	FrameDataDecoder    mDecoder;
+	size_t              mLoadPos;
+};
+
+#endif // ReplayStream_H_604CED7F_0399_4248_ADCF_470B7DE2FF21
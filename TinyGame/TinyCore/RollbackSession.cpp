@@ -0,0 +1,210 @@
+#include "TinyGamePCH.h"
+#include "RollbackSession.h"
+
+#include <algorithm>
+#include <limits>
+
+int32 const NoMispredictFrame = std::numeric_limits< int32 >::max();
+
+void FrameInput::set(int32 inFrame, void const* inData, uint32 inSize, bool bInConfirmed)
+{
+	frame = inFrame;
+	size = inSize;
+	bConfirmed = bInConfirmed;
+	if( size )
+	{
+		if( buffer.size() < size )
+			buffer.resize(size);
+		memcpy(buffer.data(), inData, size);
+	}
+}
+
+RollbackSession::RollbackSession(IRollbackSimulation& simulation, IFrameInputTransport& transport, int numSlot, int localSlot, int maxRollbackFrames)
+	:mSimulation(simulation)
+	,mTransport(transport)
+{
+	assert(0 <= localSlot && localSlot < numSlot);
+	mNumSlot = numSlot;
+	mLocalSlot = localSlot;
+	mMaxRollbackFrames = maxRollbackFrames;
+
+	//Remote inputs can arrive up to a rollback window ahead of the local frame
+	mInputWindowSize = 1;
+	while( mInputWindowSize < 4 * (maxRollbackFrames + 2) )
+		mInputWindowSize <<= 1;
+
+	mInputs.resize(numSlot * mInputWindowSize);
+	mConfirmedFrames.resize(numSlot);
+	mFrameInputs.resize(numSlot);
+	mSnapshots.resize(maxRollbackFrames + 2);
+
+	reset();
+}
+
+void RollbackSession::reset()
+{
+	for( FrameInput& input : mInputs )
+	{
+		input.frame = -1;
+		input.size = 0;
+		input.bConfirmed = false;
+	}
+	for( int32& frame : mConfirmedFrames )
+		frame = 0;
+	for( StateSnapshot& snapshot : mSnapshots )
+		snapshot.frame = -1;
+
+	mFrame = 0;
+	mFirstMispredictFrame = NoMispredictFrame;
+	saveSnapshot(0);
+}
+
+int32 RollbackSession::getConfirmedFrame() const
+{
+	int32 result = mFrame;
+	for( int slot = 0; slot < mNumSlot; ++slot )
+	{
+		if( slot != mLocalSlot )
+			result = std::min(result, mConfirmedFrames[slot]);
+	}
+	return result;
+}
+
+size_t RollbackSession::getStateMemorySize() const
+{
+	size_t result = 0;
+	for( StateSnapshot const& snapshot : mSnapshots )
+		result += snapshot.buffer.getMaxSize();
+	return result;
+}
+
+void RollbackSession::pollInputs()
+{
+	mTransport.dispatchInputs(*this);
+	if( mFirstMispredictFrame <= mFrame )
+	{
+		rollback();
+	}
+}
+
+bool RollbackSession::advanceFrame(void const* localData, uint32 localSize)
+{
+	pollInputs();
+
+	int32 frame = mFrame + 1;
+	if( frame - getConfirmedFrame() > mMaxRollbackFrames )
+	{
+		++mStats.numStallFrame;
+		return false;
+	}
+
+	FrameInput& input = getInput(mLocalSlot, frame);
+	input.set(frame, localData, localSize, true);
+	mConfirmedFrames[mLocalSlot] = frame;
+	mTransport.sendInput(mLocalSlot, input);
+
+	simulateFrame(frame, false);
+	saveSnapshot(frame);
+	mFrame = frame;
+	++mStats.numFrame;
+	return true;
+}
+
+void RollbackSession::addRemoteInput(int slot, int32 frame, void const* data, uint32 size)
+{
+	if( slot < 0 || slot >= mNumSlot || slot == mLocalSlot )
+		return;
+	if( frame <= mConfirmedFrames[slot] )
+		return;
+	if( frame - mFrame >= mInputWindowSize / 2 )
+	{
+		LogWarning(0, "Rollback : drop input of slot %d frame %d ( local frame = %d )", slot, frame, mFrame);
+		return;
+	}
+
+	FrameInput& input = getInput(slot, frame);
+	if( input.frame == frame )
+	{
+		if( input.bConfirmed )
+			return;
+
+		//The frame was simulated with a predicted input
+		if( !input.isSameData(data, size) )
+		{
+			++mStats.numMispredictInput;
+			mFirstMispredictFrame = std::min(mFirstMispredictFrame, frame);
+		}
+	}
+	input.set(frame, data, size, true);
+
+	int32& confirmedFrame = mConfirmedFrames[slot];
+	for(;;)
+	{
+		FrameInput const& nextInput = getInput(slot, confirmedFrame + 1);
+		if( nextInput.frame != confirmedFrame + 1 || !nextInput.bConfirmed )
+			break;
+		++confirmedFrame;
+	}
+}
+
+void RollbackSession::simulateFrame(int32 frame, bool bResimulate)
+{
+	for( int slot = 0; slot < mNumSlot; ++slot )
+	{
+		FrameInput& input = getInput(slot, frame);
+		if( input.frame != frame || !input.bConfirmed )
+		{
+			//Predict the input holds the last confirmed one
+			int32 confirmedFrame = mConfirmedFrames[slot];
+			if( confirmedFrame > 0 && confirmedFrame < frame )
+			{
+				FrameInput const& lastInput = getInput(slot, confirmedFrame);
+				input.set(frame, lastInput.getData(), lastInput.size, false);
+			}
+			else
+			{
+				input.set(frame, nullptr, 0, false);
+			}
+		}
+		mFrameInputs[slot] = &input;
+	}
+
+	mSimulation.simulateFrame(frame, mFrameInputs.data(), mNumSlot, bResimulate);
+}
+
+void RollbackSession::rollback()
+{
+	int32 startFrame = mFirstMispredictFrame;
+	mFirstMispredictFrame = NoMispredictFrame;
+
+	loadSnapshot(startFrame - 1);
+	for( int32 frame = startFrame; frame <= mFrame; ++frame )
+	{
+		simulateFrame(frame, true);
+		saveSnapshot(frame);
+	}
+
+	uint32 numFrame = uint32(mFrame - startFrame + 1);
+	++mStats.numRollback;
+	mStats.numResimulateFrame += numFrame;
+	mStats.maxResimulateFrame = std::max(mStats.maxResimulateFrame, numFrame);
+}
+
+void RollbackSession::saveSnapshot(int32 frame)
+{
+	StateSnapshot& snapshot = mSnapshots[frame % mSnapshots.size()];
+	snapshot.frame = frame;
+	//Clear keeps the memory , the ring is allocation free once every slot is used
+	snapshot.buffer.clear();
+	auto serializer = CreateSerializer(snapshot.buffer);
+	mSimulation.saveState(serializer);
+}
+
+void RollbackSession::loadSnapshot(int32 frame)
+{
+	StateSnapshot& snapshot = mSnapshots[frame % mSnapshots.size()];
+	CHECK(snapshot.frame == frame);
+	snapshot.buffer.setUseSize(0);
+	auto serializer = CreateSerializer(snapshot.buffer);
+	mSimulation.loadState(serializer);
+}
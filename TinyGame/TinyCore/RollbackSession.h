@@ -0,0 +1,132 @@
+#pragma once
+#ifndef RollbackSession_H_16A24D83_5F08_4946_836C_F1B0650DE5F8
+#define RollbackSession_H_16A24D83_5F08_4946_836C_F1B0650DE5F8
+
+#include "GameConfig.h"
+#include "DataStreamBuffer.h"
+#include "DataStructure/Array.h"
+
+// Rollback frame sync : the local frame never waits for remote inputs inside the rollback window.
+// Missing remote inputs are predicted from the last confirmed input of the slot , when the real
+// input differs the game state is restored from the snapshot ring and the frames are simulated again.
+
+struct FrameInput
+{
+	int32  frame;
+	uint32 size;
+	uint8  bConfirmed;
+
+	uint8 const* getData() const { return buffer.data(); }
+	void  set(int32 inFrame, void const* inData, uint32 inSize, bool bInConfirmed);
+	bool  isSameData(void const* inData, uint32 inSize) const
+	{
+		return size == inSize && ( size == 0 || memcmp(buffer.data(), inData, size) == 0 );
+	}
+
+	//Only grows , the input ring stops allocating once a slot has seen its largest input
+	TArray< uint8 > buffer;
+};
+
+class IRollbackSimulation
+{
+public:
+	virtual ~IRollbackSimulation() {}
+	// Snapshots are written to preallocated buffers , keep the serialized size stable between frames
+	virtual void saveState(IStreamSerializer& serializer) = 0;
+	virtual void loadState(IStreamSerializer& serializer) = 0;
+	// Simulate one frame , bResimulate is set when the frame is simulated again after a rollback
+	virtual void simulateFrame(int32 frame, FrameInput const* inputs[], int numSlot, bool bResimulate) = 0;
+};
+
+class RollbackSession;
+
+class IFrameInputTransport
+{
+public:
+	virtual ~IFrameInputTransport() {}
+	// Send the local input to every remote slot , the transport must be reliable
+	virtual void sendInput(int slot, FrameInput const& input) = 0;
+	// Deliver the received remote inputs with RollbackSession::addRemoteInput
+	virtual void dispatchInputs(RollbackSession& session) = 0;
+};
+
+struct RollbackStats
+{
+	uint32 numFrame;
+	uint32 numStallFrame;
+	uint32 numRollback;
+	uint32 numResimulateFrame;
+	uint32 maxResimulateFrame;
+	uint32 numMispredictInput;
+
+	RollbackStats() { reset(); }
+	void reset()
+	{
+		numFrame = numStallFrame = 0;
+		numRollback = numResimulateFrame = maxResimulateFrame = 0;
+		numMispredictInput = 0;
+	}
+};
+
+class TINY_API RollbackSession
+{
+public:
+	RollbackSession(IRollbackSimulation& simulation, IFrameInputTransport& transport, int numSlot, int localSlot, int maxRollbackFrames = 8);
+
+	// Restart from frame 0 with the current game state
+	void  reset();
+
+	// Simulate the next frame with the local input , return false when the frame is too far ahead
+	// of the confirmed remote inputs and the caller must retry with the same input later
+	bool  advanceFrame(void const* localData, uint32 localSize);
+
+	// Receive inputs and roll back the mispredicted frames , done by advanceFrame too
+	void  pollInputs();
+
+	void  addRemoteInput(int slot, int32 frame, void const* data, uint32 size);
+
+	int32 getFrame() const { return mFrame; }
+	// Every frame up to it is simulated with confirmed inputs only
+	int32 getConfirmedFrame() const;
+	int   getMaxRollbackFrames() const { return mMaxRollbackFrames; }
+	int   getLocalSlot() const { return mLocalSlot; }
+
+	RollbackStats const& getStats() const { return mStats; }
+	void  resetStats() { mStats.reset(); }
+
+	// Memory of the snapshot ring , it stops growing once every snapshot slot has been used
+	size_t getStateMemorySize() const;
+
+private:
+	FrameInput& getInput(int slot, int32 frame) { return mInputs[slot * mInputWindowSize + (frame & (mInputWindowSize - 1))]; }
+	void  simulateFrame(int32 frame, bool bResimulate);
+	void  rollback();
+	void  saveSnapshot(int32 frame);
+	void  loadSnapshot(int32 frame);
+
+	struct StateSnapshot
+	{
+		int32            frame;
+		DataStreamBuffer buffer;
+	};
+
+	IRollbackSimulation&  mSimulation;
+	IFrameInputTransport& mTransport;
+
+	int    mNumSlot;
+	int    mLocalSlot;
+	int    mMaxRollbackFrames;
+	int    mInputWindowSize;
+
+	int32  mFrame;
+	int32  mFirstMispredictFrame;
+
+	TArray< FrameInput >    mInputs;
+	TArray< int32 >         mConfirmedFrames;
+	TArray< FrameInput const* > mFrameInputs;
+	TArray< StateSnapshot > mSnapshots;
+
+	RollbackStats mStats;
+};
+
+#endif // RollbackSession_H_16A24D83_5F08_4946_836C_F1B0650DE5F8
@@ -106,6 +106,25 @@ void ToggleGraphics()
 }
 AutoConsoleCommand CmdToggleRHISystem("g.ToggleRHI", ToggleGraphics);
 
+void StartProfileCapture()
+{
+	if (!ProfileSystem::Get().startCapture())
+	{
+		LogWarning(0, "Profile capture is already running");
+	}
+}
+AutoConsoleCommand CmdStartProfileCapture("Profile.StartCapture", StartProfileCapture);
+
+void StopProfileCapture()
+{
+	ProfileSystem::Get().stopCapture();
+	if (ProfileSystem::Get().exportCapture("ProfileCapture.json"))
+	{
+		LogMsg("Profile capture is exported to ProfileCapture.json");
+	}
+}
+AutoConsoleCommand CmdStopProfileCapture("Profile.StopCapture", StopProfileCapture);
+
 void Foo(int a, int b)
 {
 	LogMsg("%d+%d=%d", a, b, a + b);
@@ -0,0 +1,107 @@
+#include "UnitTest.h"
+#include "DataStructure/HashMap.h"
+
+#include <unordered_map>
+#include <string>
+#include <random>
+
+class HashMapTest
+{
+public:
+	static EUTRunResult run()
+	{
+		// 1. Basic insert / find / erase
+		{
+			THashMap< int, int > map;
+			UT_ASSERT(map.empty());
+			UT_ASSERT(map.insert(1, 10).second);
+			UT_ASSERT(!map.insert(1, 20).second);
+			UT_ASSERT_EQ(*map.findValue(1), 10);
+			map[2] = 20;
+			UT_ASSERT_EQ(map.size(), 2);
+			UT_ASSERT(map.contains(2));
+			UT_ASSERT(map.findValue(3) == nullptr);
+			UT_ASSERT_EQ(map.erase(1), 1);
+			UT_ASSERT_EQ(map.erase(1), 0);
+			UT_ASSERT(map.find(1) == map.end());
+			UT_ASSERT_EQ(map.size(), 1);
+		}
+
+		// 2. Random operations compare with std::unordered_map
+		{
+			THashMap< int, int > map;
+			std::unordered_map< int, int > expect;
+			std::mt19937 random(1);
+			for (int i = 0; i < 200000; ++i)
+			{
+				int key = random() % 5000;
+				switch (random() % 3)
+				{
+				case 0: map[key] = i; expect[key] = i; break;
+				case 1: UT_ASSERT_EQ(map.erase(key), expect.erase(key)); break;
+				case 2:
+					{
+						int* value = map.findValue(key);
+						auto iter = expect.find(key);
+						UT_ASSERT_EQ(value != nullptr, iter != expect.end());
+						if (value)
+							UT_ASSERT_EQ(*value, iter->second);
+					}
+					break;
+				}
+			}
+			UT_ASSERT_EQ(map.size(), expect.size());
+
+			size_t count = 0;
+			for (auto const& pair : map)
+			{
+				UT_ASSERT_EQ(expect[pair.first], pair.second);
+				++count;
+			}
+			UT_ASSERT_EQ(count, expect.size());
+		}
+
+		// 3. Reserve / rehash / copy
+		{
+			THashMap< std::string, int > map;
+			map.reserve(1000);
+			size_t capacity = map.capacity();
+			for (int i = 0; i < 1000; ++i)
+				map[std::to_string(i)] = i;
+			UT_ASSERT_EQ(map.capacity(), capacity);
+
+			THashMap< std::string, int > copyMap = map;
+			UT_ASSERT_EQ(copyMap.size(), 1000);
+			UT_ASSERT_EQ(*copyMap.findValue(std::string("999")), 999);
+
+			map.clear();
+			map.rehash(0);
+			UT_ASSERT_EQ(map.capacity(), 0);
+			UT_ASSERT_EQ(copyMap.size(), 1000);
+		}
+
+		// 4. Set
+		{
+			THashSet< int > set = { 1, 2, 3 };
+			UT_ASSERT(!set.insert(2).second);
+			UT_ASSERT_EQ(set.size(), 3);
+			UT_ASSERT(set.contains(3));
+		}
+
+		// 5. 64 bit keys only different in the high bits
+		{
+			THashMap< uint64, int > map;
+			for (int i = 0; i < 4096; ++i)
+				map[uint64(i) << 32] = i;
+			UT_ASSERT_EQ(map.size(), 4096);
+			for (int i = 0; i < 4096; ++i)
+				UT_ASSERT_EQ(*map.findValue(uint64(i) << 32), i);
+			UT_ASSERT(map.findValue(uint64(4096) << 32) == nullptr);
+			UT_ASSERT(DefaultHasher()(uint64(1) << 32) != DefaultHasher()(uint64(2) << 32));
+		}
+
+		return RR_SUCCESS;
+	}
+};
+
+UT_REG_TEST(HashMapTest, "DataStructure.HashMap")